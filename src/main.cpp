@@ -7,6 +7,13 @@
 // - Geen grote GUI. Alleen overlay + kleine preview + popup menu’s.
 // - Instellingen worden runtime aangepast en blijven bewaard tussen sessies.
 
+// SNIP_CORE_ONLY=1: alleen de portable secties (tests/ bouwt zo op elk platform);
+// alle Win32-code en -headers vallen dan weg.
+#ifndef SNIP_CORE_ONLY
+#define SNIP_CORE_ONLY 0
+#endif
+
+#if !SNIP_CORE_ONLY
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <windowsx.h>     // GET_X_LPARAM / GET_Y_LPARAM
@@ -14,22 +21,67 @@
 #include <shellapi.h>     // ShellExecuteW / ShellExecuteExW
 #include <shlobj.h>
 #include <shobjidl.h>     // IFileDialog (folder picker / exe picker)
-#include <cstring>        // memcpy / memset
-#include <string>
-#include <vector>
-#include <algorithm>
-#include <cmath>
 #include <wincodec.h>     // PNG/JPEG via WIC
 #pragma comment(lib, "windowscodecs.lib")
 #include <dwmapi.h>
 #pragma comment(lib, "dwmapi.lib")
 #include <strsafe.h>
-#include <cstdlib>
 #include "resource.h"
+#endif
+#include <cstring>        // memcpy / memset
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <string_view>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <climits>
+#include <cstdarg>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+#if defined(_WIN32) && SNIP_CORE_ONLY
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>      // CreateFileW / MoveFileExW in de portable bestandscode (--optimize)
+#endif
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>     // gedeelde laatste capture via shm_open
+#include <sys/socket.h>   // command-kanaal over een Unix-socket (POSIX-bouw van de kern)
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>    // SSE2 (baseline op x64)
+#define SNIP_HAS_SSE2 1
+#else
+#define SNIP_HAS_SSE2 0
+#endif
 
+#if !SNIP_CORE_ONLY
 #ifndef MF_RADIOCHECK
 #define MF_RADIOCHECK MFT_RADIOCHECK
 #endif
+#ifndef PW_RENDERFULLCONTENT
+#define PW_RENDERFULLCONTENT 0x00000002   // Windows 8.1+, ontbreekt in oudere SDK-headers
+#endif
+#ifndef WDA_EXCLUDEFROMCAPTURE
+#define WDA_EXCLUDEFROMCAPTURE 0x00000011 // Windows 10 2004+
+#endif
 
 // -----------------------------
 // Hotkey
@@ -38,12 +90,18 @@ static constexpr int  HOTKEY_ID = 1;
 static constexpr UINT HOTKEY_MOD = MOD_CONTROL | MOD_ALT;
 static constexpr UINT HOTKEY_VK = 'S';            // Ctrl+Alt+S
 
+#endif // !SNIP_CORE_ONLY
+
 // -----------------------------
 // Modes
 // -----------------------------
-enum class Mode { Region = 0, Window = 1, Monitor = 2, Freestyle = 3, Polygon = 4 };
+enum class Mode { Region = 0, Window = 1, Monitor = 2, Freestyle = 3, Polygon = 4, Burst = 5, Record = 6, Scroll = 7 };
 static Mode g_mode = Mode::Region;
 static Mode g_lastMode = Mode::Region; // onthoudt de laatst gekozen mode (tray/overlay)
+// Region, Burst en Record delen de rubberband-selectie
+static bool IsRectSelectMode(Mode m) {
+    return m == Mode::Region || m == Mode::Burst || m == Mode::Record;
+}
 static const wchar_t* ModeText(Mode m) {
     switch (m) {
     case Mode::Region:  return L"Mode: Region";
@@ -51,10 +109,14 @@ static const wchar_t* ModeText(Mode m) {
     case Mode::Monitor: return L"Mode: Monitor";
 	case Mode::Freestyle: return L"Mode: Freestyle";
     case Mode::Polygon: return L"Mode: Polygon";
+    case Mode::Burst:   return L"Mode: Burst (drag region, hotkey stops)";
+    case Mode::Record:  return L"Mode: Record (drag region, hotkey stops)";
+    case Mode::Scroll:  return L"Mode: Scrolling window (click window)";
     default:            return L"Mode: ?";
     }
 }
 
+#if !SNIP_CORE_ONLY
 // -----------------------------
 // Single Instance
 // -----------------------------
@@ -93,6 +155,12 @@ static constexpr UINT TRAY_CAP_WINDOW = 4002;
 static constexpr UINT TRAY_CAP_MONITOR = 4003;
 static constexpr UINT TRAY_CAP_FREE = 4004;
 static constexpr UINT TRAY_CAP_POLY   = 4005;
+static constexpr UINT TRAY_CAP_BURST  = 4006;
+static constexpr UINT TRAY_BURST_STOP = 4007;
+static constexpr UINT TRAY_BURST_EXPORT = 4008;
+static constexpr UINT TRAY_CAP_RECORD = 4010;
+static constexpr UINT TRAY_REC_STOP   = 4011;
+static constexpr UINT TRAY_CAP_SCROLL = 4012;
 
 static constexpr UINT TRAY_NAME_PRESET1 = 4051;
 static constexpr UINT TRAY_NAME_PRESET2 = 4052;
@@ -101,14 +169,41 @@ static constexpr UINT TRAY_NAME_PRESET4 = 4054;
 static constexpr UINT TRAY_FMT_PNG = 4060;
 static constexpr UINT TRAY_FMT_JPEG = 4061;
 static constexpr UINT TRAY_FMT_BMP = 4062;
+static constexpr UINT TRAY_FMT_AUTO = 4063;
 
 static constexpr UINT TRAY_TOGGLE_AUTODISMISS = 4070;
+static constexpr UINT TRAY_TOGGLE_SHM = 4071;
 
 static constexpr UINT TRAY_OPEN_SAVEDIR = 4080;
 static constexpr UINT TRAY_SET_SAVEDIR = 4081;
+static constexpr UINT TRAY_FIND_CAPTURE = 4082;
+static constexpr UINT TRAY_SIMILAR_INDEX = 4083;
 
 static constexpr UINT TRAY_EXIT = 4099;
 
+static constexpr UINT TRAY_BURST_INT1 = 4110;   // 4110..4114: burst-interval presets
+static constexpr UINT TRAY_BURST_INT5 = 4114;
+static constexpr int  kBurstIntervalsMs[] = { 1000, 2000, 5000, 10000, 30000 };
+static constexpr UINT TRAY_REC_FPS1 = 4120;     // 4120..4123: record-fps presets
+static constexpr UINT TRAY_REC_FPS4 = 4123;
+static constexpr int  kRecordFpsPresets[] = { 5, 10, 15, 30 };
+static constexpr UINT TRAY_OUTPUT1 = 4130;      // 4130..4135: output-schaling presets
+static constexpr UINT TRAY_OUTPUT6 = 4135;
+static constexpr int  kOutputPresets[][2] = {   // { OutputScaleMode, waarde }
+    { 0, 0 }, { 1, 0 }, { 2, 75 }, { 2, 50 }, { 3, 1920 }, { 3, 1280 } };
+
+static constexpr UINT WM_RECORD_STOP = WM_APP + 11; // encode-thread -> g_hwndMsg (fout: stoppen)
+static constexpr UINT WM_PREVIEW_PREENCODE = WM_APP + 12; // preview staat -> snapshot + pre-encode starten
+static constexpr UINT WM_SESSIONS_SHOW = WM_APP + 13;     // overlay weg -> verborgen previews terug (als er niets loopt)
+static constexpr UINT WM_RECOMPRESS_DONE = WM_APP + 14;   // recompressie-thread -> UI (lParam = RecompressDone*)
+static constexpr UINT WM_PIPE_COMMAND = WM_APP + 15;      // pipe-thread -> UI (lParam = std::shared_ptr<PipeJob>*)
+static constexpr UINT WM_PREVIEW_SPARE = WM_APP + 16;     // reserve-preview aanvullen (als de UI even niets doet)
+static constexpr UINT WM_CAPTURE_COMPOSED = WM_APP + 17;  // DwmFlush-worker -> UI (wParam = gen, lParam = 1 ok / 0 geen DWM)
+static constexpr UINT WM_CAPTURE_PROCESSED = WM_APP + 18; // nabewerk-worker -> UI (lParam = CaptureJob*)
+static constexpr UINT WM_SIMILAR_INDEXED = WM_APP + 19;   // bulk-indexer -> UI (lParam = SimilarIndexed*)
+static constexpr UINT WM_DIFF_LOADED = WM_APP + 20;       // diff-lader -> UI (lParam = DiffLoaded*)
+static constexpr UINT WM_DESKTOP_CACHED = WM_APP + 21;    // desktop-cache-worker -> UI (wParam = generatie)
+
 static NOTIFYICONDATAW g_nid{};
 static bool g_trayAdded = false;
 static bool g_hotkeyOk = false;
@@ -118,8 +213,10 @@ static bool g_hotkeyOk = false;
 // -----------------------------
 static HINSTANCE g_hInst = nullptr;
 static HWND g_hwndMsg = nullptr;   // message-only window (hotkey)
-static HWND g_hwndOverlay = nullptr;   // capture overlay
-static HWND g_hwndPreview = nullptr;   // preview window
+static HWND g_hwndOverlay = nullptr;   // capture overlay (alleen zolang die actief is)
+static HWND g_hwndOverlaySpare = nullptr;   // verborgen overlay, klaar voor de volgende hotkey
+static HWND g_hwndPreviewSpare = nullptr;   // verborgen preview zonder sessie, voor de volgende capture
+static HWND g_hwndCatalog = nullptr;   // zoekvenster (Find capture)
 
 // -----------------------------
 // Selectie state (overlay)
@@ -142,8 +239,10 @@ static RECT  g_hoverRectScreen{};
 static RECT  g_hoverRectClient{};
 
 // -----------------------------
-// Capture state (bitmap)
+// Capture state (bitmap in opbouw)
 // -----------------------------
+// Alleen tijdens het capturen (mask/feather/clipboard); OpenCaptureSession
+// neemt bitmap + hash over en zet deze globals weer leeg.
 static HBITMAP g_captureBmp = nullptr;
 static int     g_captureW = 0;
 static int     g_captureH = 0;
@@ -163,11 +262,17 @@ static POINT g_polyHoverClient{};
 static bool g_polyHoverValid = false;
 
 static bool g_captureHasAlpha = false;   // straks voor preview + save
+static uint64_t g_captureHash = 0;        // content hash (pixels + afmetingen), zie UpdateCaptureHash
+static bool g_captureHashValid = false;
+static RECT g_captureSrcRect{};          // schermrechthoek van de capture (catalogus)
+static HWND g_captureSrcHwnd = nullptr;   // bronvenster als dat bekend is (Window-mode)
+
+#endif // !SNIP_CORE_ONLY
 
 // -----------------------------
 // Save format (persistent)
 // -----------------------------
-enum class SaveFormat { Png = 0, Jpeg = 1, Bmp = 2 };
+enum class SaveFormat { Png = 0, Jpeg = 1, Bmp = 2, Auto = 3 };
 static SaveFormat g_saveFormat = SaveFormat::Png; // default = PNG
 
 static const wchar_t* SaveFormatText(SaveFormat f) {
@@ -175,33 +280,73 @@ static const wchar_t* SaveFormatText(SaveFormat f) {
     case SaveFormat::Png:  return L"PNG";
     case SaveFormat::Jpeg: return L"JPEG";
     case SaveFormat::Bmp:  return L"BMP";
+    case SaveFormat::Auto: return L"Auto";
     default:               return L"?";
     }
 }
 
+#if !SNIP_CORE_ONLY
 // -----------------------------
 // Preview UI state
 // -----------------------------
-static RECT g_rcImage{};
-static RECT g_btnSave{};
-static RECT g_btnEdit{};
-static RECT g_btnDismiss{};
-static RECT g_rcStatus{};
-static std::wstring g_statusText;
 static bool g_autoDismissAfterSave = false;
 
 static std::wstring g_saveDir;         // persistent
 static std::wstring g_lastSavedFile;   // persistent
 static std::wstring g_editorExe;       // persistent: "Open in..." program
-static std::wstring g_tempEditFile;    // alleen voor huidige preview/capture
 // -----------------------------
 // Filename format (persistent)
 // -----------------------------
 static int g_namePreset = 1;              // 1..4
-static ULONGLONG g_lastNameKey = 0;       // yyyymmddhhmmss
-static int g_nameCounter = 0;             // 1..999 (reset per second)
 
 static constexpr UINT_PTR TIMER_STATUS_CLEAR = 1;
+static constexpr UINT_PTR TIMER_BURST = 2;        // op g_hwndMsg
+static constexpr UINT_PTR TIMER_SCROLL = 3;       // op g_hwndMsg
+static constexpr UINT_PTR TIMER_PREENCODE = 4;    // op de preview: pre-encode opnieuw starten (debounce)
+static constexpr UINT_PTR TIMER_CAPTURE_SEQ = 5;  // op g_hwndMsg: capture-sequencer (deadline / vaste wachttijd)
+static constexpr UINT_PTR TIMER_DIFF_EXPIRE = 6;  // op g_hwndMsg: oude gesloten captures (diff) opruimen
+
+// -----------------------------
+// Burst (persistent)
+// -----------------------------
+static int g_burstIntervalMs = 5000;
+static std::wstring g_lastBurstFile;
+
+// -----------------------------
+// Record (persistent)
+// -----------------------------
+static int g_recordFps = 10;
+
+// -----------------------------
+// Overlay loupe (persistent)
+// -----------------------------
+static bool g_loupeEnabled = true;
+static int  g_loupeZoom = 8;               // 4..16, muiswiel in de overlay
+static bool g_snapEnabled = true;          // Region-rand naar UI-randen snappen
+
+// -----------------------------
+// Temp-edit cache (persistent)
+// -----------------------------
+static int g_tempMaxAgeHours = 72;         // ouder -> sweeper ruimt op
+static int g_tempMaxMB = 512;              // totaal in de temp-map
+
+// -----------------------------
+// Recompressie van opgeslagen PNG's (idle)
+// -----------------------------
+static bool g_recompressEnabled = true;
+static int  g_recompressIdleSeconds = 120; // zo lang geen invoer -> exhaustieve pass mag draaien
+
+// -----------------------------
+// Output-schaling (persistent)
+// -----------------------------
+static int g_outputScale = 0;              // OutputScaleMode: 0 uit, 1 logisch, 2 procent, 3 max. lange zijde
+static int g_outputPercent = 50;           // 10..100
+static int g_outputMaxEdge = 1920;         // px
+
+// -----------------------------
+// Gedeelde laatste capture (persistent)
+// -----------------------------
+static bool g_publishShm = false;          // elke capture naar Local\snip-lite-latest
 
 // -----------------------------
 // Filename format (persistent)
@@ -210,6 +355,42 @@ static HICON AppIconBig();
 static HICON AppIconSmall();
 static HICON TrayIconSmall();
 
+#endif // !SNIP_CORE_ONLY
+
+// =========================================================
+// Diagnostiek: DebugLog + timing (portable)
+// =========================================================
+// Alleen met [Debug] Log=1 in settings.ini (of in een debug-build); een
+// release-build stuurt anders niets naar OutputDebugString.
+#ifdef _DEBUG
+static bool g_debugLog = true;
+#else
+static bool g_debugLog = false;
+#endif
+
+// diagnostiek: zichtbaar in DebugView / VS Output-venster
+static void DebugLog(const wchar_t* fmt, ...) {
+    if (!g_debugLog) return;
+#if !SNIP_CORE_ONLY
+    wchar_t buf[512]{};
+    va_list args;
+    va_start(args, fmt);
+    vswprintf(buf, _countof(buf) - 1, fmt, args);
+    va_end(args);
+    std::wstring line = L"snip-lite: ";
+    line += buf;
+    line += L"\n";
+    OutputDebugStringW(line.c_str());
+#else
+    (void)fmt;
+#endif
+}
+
+static double MsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+#if !SNIP_CORE_ONLY
 // =========================================================
 // Helpers: strings, directories, INI settings
 // =========================================================
@@ -269,6 +450,7 @@ static std::wstring TimestampedFileName(SaveFormat fmt) {
     case SaveFormat::Png:  ext = L".png"; break;
     case SaveFormat::Jpeg: ext = L".jpg"; break;
     case SaveFormat::Bmp:  ext = L".bmp"; break;
+    default:               break; // Auto is hier al opgelost naar PNG/JPEG
     }
 
     wchar_t buf[128]{};
@@ -279,87 +461,78 @@ static std::wstring TimestampedFileName(SaveFormat fmt) {
     return buf;
 }
 
-static ULONGLONG DateKey(const SYSTEMTIME& st) {
-    // yyyymmdd
-    return (ULONGLONG)st.wYear * 10000ULL +
-        (ULONGLONG)st.wMonth * 100ULL +
-        (ULONGLONG)st.wDay;
-}
-
-static int NextNameCounter(ULONGLONG key) {
-    if (key == g_lastNameKey) g_nameCounter++;
-    else { g_lastNameKey = key; g_nameCounter = 1; }
-
-    if (g_nameCounter > 9999) g_nameCounter = 9999;
-    return g_nameCounter;
-}
-
-static std::wstring SavedFileNamePreset(SaveFormat fmt) {
-    SYSTEMTIME st{};
-    GetLocalTime(&st);
-
-    const wchar_t* ext = L".png";
+static const wchar_t* SaveFormatExt(SaveFormat fmt) {
     switch (fmt) {
-    case SaveFormat::Png:  ext = L".png"; break;
-    case SaveFormat::Jpeg: ext = L".jpg"; break;
-    case SaveFormat::Bmp:  ext = L".bmp"; break;
+    case SaveFormat::Jpeg: return L".jpg";
+    case SaveFormat::Bmp:  return L".bmp";
+    default:               return L".png"; // Auto is hier al opgelost naar PNG/JPEG
     }
+}
 
-    const ULONGLONG key = DateKey(st);
-    const int c = NextNameCounter(key);
-
-    wchar_t buf[160]{};
+#endif // !SNIP_CORE_ONLY
 
-    // modeName: short folder/name friendly representation of current mode
-    const wchar_t* modeName = L"unknown";
-    switch (g_mode) {
-    case Mode::Region:   modeName = L"region";   break;
-    case Mode::Window:   modeName = L"window";   break;
-    case Mode::Monitor:  modeName = L"monitor";  break;
-    case Mode::Freestyle:modeName = L"freestyle";break;
-    case Mode::Polygon:  modeName = L"polygon";  break;
-    default:             modeName = L"unknown";  break;
+static const wchar_t* ModeFileName(Mode m) {
+    // short folder/name friendly representation of a mode
+    switch (m) {
+    case Mode::Region:   return L"region";
+    case Mode::Window:   return L"window";
+    case Mode::Monitor:  return L"monitor";
+    case Mode::Freestyle:return L"freestyle";
+    case Mode::Polygon:  return L"polygon";
+    case Mode::Burst:    return L"burst";
+    case Mode::Record:   return L"record";
+    case Mode::Scroll:   return L"scroll";
+    default:             return L"unknown";
     }
+}
 
-    // dateFolder for preset 3: "YYYY-MM-DD"
-    wchar_t dateFolderBuf[64]{};
-    swprintf_s(dateFolderBuf, L"%04u-%02u-%02u", st.wYear, st.wMonth, st.wDay);
-    const wchar_t* dateFolder = dateFolderBuf;
-
-    switch (g_namePreset) {
+// ---- Bestandsnaam-presets (portable) ----
+// Naam = prefix + teller (%04d, groeit door na 9999) + extensie. De prefix kan een
+// datummap bevatten ("2026-02-23\snip_"); de teller loopt per map + prefix, los van
+// de extensie.
+static std::wstring NamePresetPrefix(int preset, int year, int month, int day, const wchar_t* modeName) {
+    wchar_t buf[128]{};
+    switch (preset) {
     default:
-    case 1:
-        // snip_YYYY-MM-DD_####.png
-        swprintf_s(buf, L"snip_%04u-%02u-%02u_%04d%s",
-            st.wYear, st.wMonth, st.wDay, c, ext);
+    case 1: // snip_YYYY-MM-DD_####.png
+        swprintf(buf, 128, L"snip_%04d-%02d-%02d_", year, month, day);
         break;
-
-    case 2:
-        // snip_mode_YYYY-MM-DD_####.png
-        swprintf_s(buf, L"snip_%s_%04u-%02u-%02u_%04d%s",
-            modeName, st.wYear, st.wMonth, st.wDay, c, ext);
+    case 2: // snip_mode_YYYY-MM-DD_####.png
+        swprintf(buf, 128, L"snip_%ls_%04d-%02d-%02d_", modeName, year, month, day);
         break;
-
-    case 3:
-        // YYYY-MM-DD\snip_####.png   (no mode-folder)
-        swprintf_s(buf, L"%s\\snip_%04d%s",
-            dateFolder, c, ext);
+    case 3: // YYYY-MM-DD\snip_####.png   (no mode-folder)
+        swprintf(buf, 128, L"%04d-%02d-%02d\\snip_", year, month, day);
         break;
-
-    case 4:
-        // snip_YYYYMMDD_####.png
-        swprintf_s(buf, L"snip_%04u%02u%02u_%04d%s",
-            st.wYear, st.wMonth, st.wDay, c, ext);
+    case 4: // snip_YYYYMMDD_####.png
+        swprintf(buf, 128, L"snip_%04d%02d%02d_", year, month, day);
         break;
     }
-
     return buf;
 }
 
-static std::wstring SavedRelativePathPreset(SaveFormat fmt) {
-    return SavedFileNamePreset(fmt);
+static std::wstring NameWithCounter(const std::wstring& filePrefix, int counter, const wchar_t* ext) {
+    wchar_t num[16]{};
+    swprintf(num, 16, L"%04d", counter);
+    return filePrefix + num + ext;
+}
+
+// "<filePrefix><cijfers>.<ext>" -> teller, anders -1. Prefix hoofdletterongevoelig (NTFS).
+static int ParseNameCounter(const wchar_t* name, const wchar_t* filePrefix, size_t prefixLen) {
+    for (size_t i = 0; i < prefixLen; ++i) {
+        if (!name[i] || towlower(name[i]) != towlower(filePrefix[i])) return -1;
+    }
+    const wchar_t* p = name + prefixLen;
+    int v = 0, digits = 0;
+    while (*p >= L'0' && *p <= L'9') {
+        if (++digits > 9) return -1;
+        v = v * 10 + (*p - L'0');
+        ++p;
+    }
+    if (digits == 0 || *p != L'.') return -1;
+    return v;
 }
 
+#if !SNIP_CORE_ONLY
 static int IniReadInt(const wchar_t* section, const wchar_t* key, int defVal) {
     return GetPrivateProfileIntW(section, key, defVal, SettingsFile().c_str());
 }
@@ -409,29 +582,47 @@ static void LoadSettings() {
 
     int m = IniReadInt(L"General", L"Mode", 0);
     if (m < 0) m = 0;
-    if (m > 4) m = 4;
+    if (m > 7) m = 7;
     g_mode = (Mode)m;
     // na het laden van Mode uit settings:
     g_lastMode = g_mode;
 
     int sf = IniReadInt(L"General", L"SaveFormat", 0); // default = PNG
     if (sf < 0) sf = 0;
-    if (sf > 2) sf = 2;
+    if (sf > 3) sf = 3;
     g_saveFormat = (SaveFormat)sf;
 
+    g_burstIntervalMs = IniReadInt(L"Burst", L"IntervalMs", 5000);
+    if (g_burstIntervalMs < 250) g_burstIntervalMs = 250;
+    g_lastBurstFile = IniReadStr(L"Burst", L"LastFile", L"");
+
+    g_recordFps = IniReadInt(L"Record", L"Fps", 10);
+    if (g_recordFps < 1) g_recordFps = 1;
+    if (g_recordFps > 30) g_recordFps = 30;
+
+    g_loupeEnabled = IniReadInt(L"Overlay", L"Loupe", 1) != 0;
+    g_loupeZoom = IniReadInt(L"Overlay", L"LoupeZoom", 8);
+    if (g_loupeZoom < 4) g_loupeZoom = 4;
+    if (g_loupeZoom > 16) g_loupeZoom = 16;
+    g_snapEnabled = IniReadInt(L"Overlay", L"Snap", 1) != 0;
+
+    g_tempMaxAgeHours = std::clamp(IniReadInt(L"TempCache", L"MaxAgeHours", 72), 1, 24 * 365);
+    g_tempMaxMB = std::clamp(IniReadInt(L"TempCache", L"MaxMB", 512), 16, 1024 * 1024);
+
+    g_recompressEnabled = IniReadInt(L"Recompress", L"Enabled", 1) != 0;
+    g_recompressIdleSeconds = std::clamp(IniReadInt(L"Recompress", L"IdleSeconds", 120), 10, 24 * 3600);
+
+    g_outputScale = std::clamp(IniReadInt(L"Output", L"Scale", 0), 0, 3);
+    g_outputPercent = std::clamp(IniReadInt(L"Output", L"Percent", 50), 10, 100);
+    g_outputMaxEdge = std::clamp(IniReadInt(L"Output", L"MaxEdge", 1920), 64, 16384);
+
+    g_publishShm = IniReadInt(L"Publish", L"SharedMemory", 0) != 0;
+    if (IniReadInt(L"Debug", L"Log", 0) != 0) g_debugLog = true; // debug-build logt altijd
+
     int np = IniReadInt(L"General", L"NamePreset", 1);
     if (np < 1) np = 1;
     if (np > 4) np = 4;
     g_namePreset = np;
-
-    {
-        std::wstring sKey = IniReadStr(L"General", L"LastNameKey", L"0");
-        g_lastNameKey = (ULONGLONG)wcstoull(sKey.c_str(), nullptr, 10);
-
-        g_nameCounter = IniReadInt(L"General", L"NameCounter", 0);
-        if (g_nameCounter < 0) g_nameCounter = 0;
-        if (g_nameCounter > 9999) g_nameCounter = 9999;
-    }
 }
 
 static void SaveSettings() {
@@ -442,13 +633,20 @@ static void SaveSettings() {
     IniWriteInt(L"General", L"Mode", (int)g_mode);
     IniWriteInt(L"General", L"SaveFormat", (int)g_saveFormat);
     IniWriteInt(L"General", L"NamePreset", g_namePreset);
-
-    {
-        wchar_t buf[32]{};
-        swprintf_s(buf, L"%llu", (unsigned long long)g_lastNameKey);
-        IniWriteStr(L"General", L"LastNameKey", buf);
-        IniWriteInt(L"General", L"NameCounter", g_nameCounter);
-    }
+    IniWriteInt(L"Burst", L"IntervalMs", g_burstIntervalMs);
+    IniWriteStr(L"Burst", L"LastFile", g_lastBurstFile);
+    IniWriteInt(L"Record", L"Fps", g_recordFps);
+    IniWriteInt(L"Overlay", L"Loupe", g_loupeEnabled ? 1 : 0);
+    IniWriteInt(L"Overlay", L"LoupeZoom", g_loupeZoom);
+    IniWriteInt(L"Overlay", L"Snap", g_snapEnabled ? 1 : 0);
+    IniWriteInt(L"TempCache", L"MaxAgeHours", g_tempMaxAgeHours);
+    IniWriteInt(L"TempCache", L"MaxMB", g_tempMaxMB);
+    IniWriteInt(L"Recompress", L"Enabled", g_recompressEnabled ? 1 : 0);
+    IniWriteInt(L"Recompress", L"IdleSeconds", g_recompressIdleSeconds);
+    IniWriteInt(L"Output", L"Scale", g_outputScale);
+    IniWriteInt(L"Output", L"Percent", g_outputPercent);
+    IniWriteInt(L"Output", L"MaxEdge", g_outputMaxEdge);
+    IniWriteInt(L"Publish", L"SharedMemory", g_publishShm ? 1 : 0);
 }
 
 static std::wstring DirName(const std::wstring& path) {
@@ -500,8 +698,11 @@ static void ClearHover() {
     ZeroMemory(&g_hoverRectClient, sizeof(g_hoverRectClient));
 }
 
+static bool IsPreviewWindow(HWND h);
+
 static bool IsSnipLiteWindow(HWND h) {
-    return (h == g_hwndOverlay) || (h == g_hwndPreview) || (h == g_hwndMsg);
+    return (h == g_hwndOverlay) || (h == g_hwndMsg) || (h == g_hwndCatalog) || IsPreviewWindow(h) ||
+        (h && (h == g_hwndOverlaySpare || h == g_hwndPreviewSpare));
 }
 
 static bool IsDesktopOrShellWindow(HWND h) {
@@ -608,6 +809,20 @@ static bool GetMonitorRectAtPoint(POINT ptScreen, RECT& outRectScreen) {
     return (outRectScreen.right > outRectScreen.left) && (outRectScreen.bottom > outRectScreen.top);
 }
 
+// Schaalfactor (1.0 = 96 dpi) van de monitor met het grootste deel van de rechthoek.
+// GetDpiForMonitor zit in Shcore.dll (Windows 8.1+); zonder: 1.0.
+static double MonitorDpiScaleForRect(const RECT& screenRect) {
+    using Fn = HRESULT(WINAPI*)(HMONITOR, int, UINT*, UINT*);
+    static const Fn getDpi = [] {
+        HMODULE shcore = LoadLibraryW(L"Shcore.dll");
+        return shcore ? (Fn)GetProcAddress(shcore, "GetDpiForMonitor") : nullptr;
+    }();
+    HMONITOR mon = MonitorFromRect(&screenRect, MONITOR_DEFAULTTONEAREST);
+    UINT dx = 96, dy = 96;
+    if (!getDpi || !mon || FAILED(getDpi(mon, 0 /* MDT_EFFECTIVE_DPI */, &dx, &dy)) || dx == 0) return 1.0;
+    return dx / 96.0;
+}
+
 static void SetHoverFromScreenRect(HWND hwndOverlay, HWND hoverHwnd, const RECT& screenRect) {
     g_hoverHwnd = hoverHwnd;
     g_hoverRectScreen = screenRect;
@@ -631,13 +846,11 @@ static void FreeCapture() {
     }
     g_captureW = 0;
     g_captureH = 0;
+    g_captureHashValid = false;
+    g_captureSrcRect = {};
+    g_captureSrcHwnd = nullptr;
 }
 
-static void SetStatus(HWND hwndPreview, const std::wstring& s) {
-    g_statusText = s;
-    InvalidateRect(hwndPreview, nullptr, TRUE);
-    SetTimer(hwndPreview, TIMER_STATUS_CLEAR, 1500, nullptr);
-}
 
 // =========================================================
 // Dialog helpers: Pick folder / Pick exe
@@ -781,15 +994,8 @@ static bool CaptureRectToBitmap(const RECT& screenRect, HBITMAP& outBmp, int& ou
 
     const DWORD rop = SRCCOPY | CAPTUREBLT;
     const BOOL ok = BitBlt(hdcMem, 0, 0, w, h, hdcScreen, screenRect.left, screenRect.top, rop);
-    // Zorg dat alpha standaard opaque is (anders wordt PNG vaak "transparant")
-    if (bits) {
-        BYTE* p = (BYTE*)bits;
-        const size_t stride = (size_t)w * 4;
-        for (int y = 0; y < h; ++y) {
-            BYTE* row = p + (size_t)y * stride;
-            for (int x = 0; x < w; ++x) row[x * 4 + 3] = 255;
-        }
-    }
+    // alpha blijft zoals BitBlt hem laat (meestal 0): de nabewerking zet hem op 255,
+    // in dezelfde pass als masker/schalen/clipboard (BandAddOpaque)
 
     SelectObject(hdcMem, old);
     DeleteDC(hdcMem);
@@ -806,43 +1012,135 @@ static bool CaptureRectToBitmap(const RECT& screenRect, HBITMAP& outBmp, int& ou
     return true;
 }
 
-static bool CopyBitmapToClipboard(HBITMAP hbmp) {
-    if (!hbmp) return false;
+// Lege 32bpp DIB met dezelfde layout als CaptureRectToBitmap (bottom-up); nullptr bij een fout.
+static HBITMAP CreateDib32(int w, int h, void*& outBits) {
+    outBits = nullptr;
+    if (w <= 0 || h <= 0) return nullptr;
 
-    DIBSECTION ds{};
-    if (GetObjectW(hbmp, sizeof(ds), &ds) == 0 || ds.dsBm.bmBits == nullptr) {
-        return false;
+    BITMAPINFO bmi{};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = w;
+    bmi.bmiHeader.biHeight = h;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    HBITMAP hbmp = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &outBits, nullptr, 0);
+    if (!hbmp || !outBits) {
+        if (hbmp) DeleteObject(hbmp);
+        outBits = nullptr;
+        return nullptr;
     }
+    return hbmp;
+}
 
-    const int w = ds.dsBmih.biWidth;
-    const int absH = (ds.dsBmih.biHeight < 0) ? -ds.dsBmih.biHeight : ds.dsBmih.biHeight;
+// Top-down BGRA-pixels -> DIB met dezelfde layout als CaptureRectToBitmap (bottom-up, 32bpp).
+static HBITMAP CreateDibFromPixels(const uint8_t* topDown, int w, int h, size_t srcStride, bool forceOpaque) {
+    if (!topDown) return nullptr;
 
-    const int srcStride = ds.dsBm.bmWidthBytes;
-    const int dstStride = w * 4;
+    void* bits = nullptr;
+    HBITMAP hbmp = CreateDib32(w, h, bits);
+    if (!hbmp) return nullptr;
+
+    const size_t dstStride = (size_t)w * 4;
+    for (int y = 0; y < h; ++y) {
+        uint8_t* dst = (uint8_t*)bits + (size_t)(h - 1 - y) * dstStride;
+        std::memcpy(dst, topDown + (size_t)y * srcStride, dstStride);
+        if (forceOpaque) {
+            for (int x = 0; x < w; ++x) dst[x * 4 + 3] = 255;
+        }
+    }
+    return hbmp;
+}
+
+// Top-down view op een 32bpp DIB (bottom-up -> laatste rij + negatieve stride).
+static bool DibTopDownView(HBITMAP hbmp, uint8_t*& outTop, ptrdiff_t& outStride, int& outW, int& outH) {
+    DIBSECTION ds{};
+    if (!hbmp || GetObjectW(hbmp, sizeof(ds), &ds) == 0 || !ds.dsBm.bmBits) return false;
+    if (ds.dsBm.bmBitsPixel != 32) return false;
+
+    outW = ds.dsBmih.biWidth;
+    outH = (ds.dsBmih.biHeight < 0) ? -ds.dsBmih.biHeight : ds.dsBmih.biHeight;
+    const ptrdiff_t stride = ds.dsBm.bmWidthBytes;
+    if (ds.dsBmih.biHeight > 0) {
+        outTop = (uint8_t*)ds.dsBm.bmBits + (ptrdiff_t)(outH - 1) * stride;
+        outStride = -stride;
+    }
+    else {
+        outTop = (uint8_t*)ds.dsBm.bmBits;
+        outStride = stride;
+    }
+    return true;
+}
+
+// Lege clipboard-DIB van w x h in een HGLOBAL, met BITMAPINFOHEADER (CF_DIB) of
+// BITMAPV5HEADER met alpha (CF_DIBV5). Komt gelockt terug; outBits = de bottom-up
+// pixels (w * 4 per rij) na de header. nullptr bij een fout.
+static HGLOBAL ClipboardDibAlloc(int w, int h, bool alphaV5, uint8_t*& outBits) {
+    outBits = nullptr;
+    if (w <= 0 || h <= 0) return nullptr;
 
-    const SIZE_T headerSize = sizeof(BITMAPINFOHEADER);
-    const SIZE_T bitsSize = (SIZE_T)dstStride * (SIZE_T)absH;
+    const SIZE_T headerSize = alphaV5 ? sizeof(BITMAPV5HEADER) : sizeof(BITMAPINFOHEADER);
+    const SIZE_T bitsSize = (SIZE_T)w * 4 * (SIZE_T)h;
     const SIZE_T totalSize = headerSize + bitsSize;
 
     HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, totalSize);
-    if (!hMem) return false;
+    if (!hMem) return nullptr;
 
     BYTE* p = (BYTE*)GlobalLock(hMem);
-    if (!p) { GlobalFree(hMem); return false; }
+    if (!p) { GlobalFree(hMem); return nullptr; }
+
+    if (alphaV5) {
+        BITMAPV5HEADER bvh{};
+        bvh.bV5Size = sizeof(BITMAPV5HEADER);
+        bvh.bV5Width = w;
+        bvh.bV5Height = h; // bottom-up
+        bvh.bV5Planes = 1;
+        bvh.bV5BitCount = 32;
+        bvh.bV5Compression = BI_BITFIELDS;
+        bvh.bV5RedMask = 0x00FF0000;
+        bvh.bV5GreenMask = 0x0000FF00;
+        bvh.bV5BlueMask = 0x000000FF;
+        bvh.bV5AlphaMask = 0xFF000000;
+        bvh.bV5CSType = LCS_sRGB;
+        std::memcpy(p, &bvh, sizeof(bvh));
+    }
+    else {
+        BITMAPINFOHEADER bih{};
+        bih.biSize = sizeof(BITMAPINFOHEADER);
+        bih.biWidth = w;
+        bih.biHeight = h;                  // bottom-up
+        bih.biPlanes = 1;
+        bih.biBitCount = 32;
+        bih.biCompression = BI_RGB;
+        bih.biSizeImage = (DWORD)bitsSize;
+        std::memcpy(p, &bih, sizeof(bih));
+    }
+    outBits = p + headerSize;
+    return hMem;
+}
 
-    BITMAPINFOHEADER bih{};
-    bih.biSize = sizeof(BITMAPINFOHEADER);
-    bih.biWidth = w;
-    bih.biHeight = absH;               // bottom-up
-    bih.biPlanes = 1;
-    bih.biBitCount = 32;
-    bih.biCompression = BI_RGB;
-    bih.biSizeImage = (DWORD)bitsSize;
+// Zwaar deel van een clipboard-copy (mag op een worker): de pixels van hbmp als
+// bottom-up DIB in een HGLOBAL (zie ClipboardDibAlloc).
+static HGLOBAL ClipboardDibGlobal(HBITMAP hbmp, bool alphaV5) {
+    if (!hbmp) return nullptr;
+
+    DIBSECTION ds{};
+    if (GetObjectW(hbmp, sizeof(ds), &ds) == 0 || ds.dsBm.bmBits == nullptr) {
+        return nullptr;
+    }
+
+    const int w = ds.dsBmih.biWidth;
+    const int absH = (ds.dsBmih.biHeight < 0) ? -ds.dsBmih.biHeight : ds.dsBmih.biHeight;
 
-    std::memcpy(p, &bih, sizeof(bih));
+    const int srcStride = ds.dsBm.bmWidthBytes;
+    const int dstStride = w * 4;
+
+    BYTE* dstBits = nullptr;
+    HGLOBAL hMem = ClipboardDibAlloc(w, absH, alphaV5, dstBits);
+    if (!hMem) return nullptr;
 
     const BYTE* srcBits = (const BYTE*)ds.dsBm.bmBits;
-    BYTE* dstBits = p + headerSize;
 
     const bool srcTopDown = (ds.dsBmih.biHeight < 0);
     const int copyBytes = (srcStride < dstStride) ? srcStride : dstStride;
@@ -862,108 +1160,70 @@ static bool CopyBitmapToClipboard(HBITMAP hbmp) {
     }
 
     GlobalUnlock(hMem);
+    return hMem;
+}
 
-    if (!OpenClipboard(nullptr)) {
-        GlobalFree(hMem);
+// Licht deel (UI-thread): clipboard open/leeg/zetten. Neemt hMem en copyBmp over, ook
+// bij een fout. copyBmp = extra CF_BITMAP voor compatibiliteit (mag nullptr zijn).
+static bool ClipboardPublish(HGLOBAL hMem, UINT fmt, HBITMAP copyBmp) {
+    if (!hMem || !OpenClipboard(nullptr)) {
+        if (hMem) GlobalFree(hMem);
+        if (copyBmp) DeleteObject(copyBmp);
         return false;
     }
 
     EmptyClipboard();
 
-    bool ok = (SetClipboardData(CF_DIB, hMem) != nullptr);
-    if (!ok) {
+    if (!SetClipboardData(fmt, hMem)) {
         CloseClipboard();
         GlobalFree(hMem);
+        if (copyBmp) DeleteObject(copyBmp);
         return false;
     }
 
-    // Extra compatibiliteit: CF_BITMAP ook aanbieden
-    HBITMAP copyBmp = (HBITMAP)CopyImage(hbmp, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION);
     if (copyBmp) {
-        if (!SetClipboardData(CF_BITMAP, copyBmp)) {
-            DeleteObject(copyBmp);
-        }
+        if (!SetClipboardData(CF_BITMAP, copyBmp)) DeleteObject(copyBmp);
     }
 
     CloseClipboard();
     return true;
 }
 
+static bool CopyBitmapToClipboard(HBITMAP hbmp) {
+    HGLOBAL hMem = ClipboardDibGlobal(hbmp, false);
+    if (!hMem) return false;
+    return ClipboardPublish(hMem, CF_DIB, (HBITMAP)CopyImage(hbmp, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION));
+}
+
 #pragma comment(lib, "Msimg32.lib")
 
 static bool CopyBitmapToClipboardAlphaV5(HBITMAP hbmp) {
-    if (!hbmp) return false;
-
-    DIBSECTION ds{};
-    if (GetObjectW(hbmp, sizeof(ds), &ds) == 0 || ds.dsBm.bmBits == nullptr) return false;
-
-    const int w = ds.dsBmih.biWidth;
-    const int absH = (ds.dsBmih.biHeight < 0) ? -ds.dsBmih.biHeight : ds.dsBmih.biHeight;
-
-    const int srcStride = ds.dsBm.bmWidthBytes;
-    const int dstStride = w * 4;
-
-    const SIZE_T headerSize = sizeof(BITMAPV5HEADER);
-    const SIZE_T bitsSize = (SIZE_T)dstStride * (SIZE_T)absH;
-    const SIZE_T totalSize = headerSize + bitsSize;
-
-    HGLOBAL hMemV5 = GlobalAlloc(GMEM_MOVEABLE, totalSize);
-    if (!hMemV5) return false;
-
-    BYTE* p = (BYTE*)GlobalLock(hMemV5);
-    if (!p) { GlobalFree(hMemV5); return false; }
-
-    BITMAPV5HEADER bvh{};
-    bvh.bV5Size = sizeof(BITMAPV5HEADER);
-    bvh.bV5Width = w;
-    bvh.bV5Height = absH; // bottom-up
-    bvh.bV5Planes = 1;
-    bvh.bV5BitCount = 32;
-    bvh.bV5Compression = BI_BITFIELDS;
-    bvh.bV5RedMask = 0x00FF0000;
-    bvh.bV5GreenMask = 0x0000FF00;
-    bvh.bV5BlueMask = 0x000000FF;
-    bvh.bV5AlphaMask = 0xFF000000;
-    bvh.bV5CSType = LCS_sRGB;
-
-    std::memcpy(p, &bvh, sizeof(bvh));
-
-    const BYTE* srcBits = (const BYTE*)ds.dsBm.bmBits;
-    BYTE* dstBits = p + headerSize;
-
-    const bool srcTopDown = (ds.dsBmih.biHeight < 0);
-    const int copyBytes = (srcStride < dstStride) ? srcStride : dstStride;
-
-    for (int y = 0; y < absH; ++y) {
-        const int srcY = srcTopDown ? y : (absH - 1 - y);
-        const int dstY = (absH - 1 - y);
-
-        const BYTE* srcRow = srcBits + (SIZE_T)srcY * (SIZE_T)srcStride;
-        BYTE* dstRow = dstBits + (SIZE_T)dstY * (SIZE_T)dstStride;
-
-        std::memcpy(dstRow, srcRow, (size_t)copyBytes);
-        if (copyBytes < dstStride) std::memset(dstRow + copyBytes, 0, (size_t)(dstStride - copyBytes));
-    }
-
-    GlobalUnlock(hMemV5);
-
-    if (!OpenClipboard(nullptr)) { GlobalFree(hMemV5); return false; }
-    EmptyClipboard();
+    HGLOBAL hMem = ClipboardDibGlobal(hbmp, true);
+    if (!hMem) return false;
+    return ClipboardPublish(hMem, CF_DIBV5, (HBITMAP)CopyImage(hbmp, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION));
+}
 
-    bool ok = (SetClipboardData(CF_DIBV5, hMemV5) != nullptr);
+static bool WriteWholeFile(const std::wstring& path, const void* data, size_t bytes) {
+    HANDLE hf = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hf == INVALID_HANDLE_VALUE) return false;
 
-    // fallback: ook CF_BITMAP aanbieden
-    HBITMAP copyBmp = (HBITMAP)CopyImage(hbmp, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION);
-    if (copyBmp) {
-        if (!SetClipboardData(CF_BITMAP, copyBmp)) DeleteObject(copyBmp);
+    bool ok = true;
+    const uint8_t* p = (const uint8_t*)data;
+    while (ok && bytes > 0) {
+        const DWORD chunk = (DWORD)std::min<size_t>(bytes, 1u << 30);
+        DWORD written = 0;
+        ok = WriteFile(hf, p, chunk, &written, nullptr) && written == chunk;
+        p += chunk;
+        bytes -= chunk;
     }
-
-    CloseClipboard();
-    if (!ok) { GlobalFree(hMemV5); return false; }
-    return true;
+    CloseHandle(hf);
+    if (!ok) DeleteFileW(path.c_str());
+    return ok;
 }
 
-static bool SaveBitmapAsBmpFile(HBITMAP hbmp, const std::wstring& filePath) {
+// 32bpp BMP (bottom-up) in geheugen; zelfde bytes als voorheen rechtstreeks naar bestand.
+static bool EncodeBitmapBmpToMemory(HBITMAP hbmp, std::vector<uint8_t>& out) {
+    out.clear();
     if (!hbmp) return false;
 
     DIBSECTION ds{};
@@ -990,71 +1250,219 @@ static bool SaveBitmapAsBmpFile(HBITMAP hbmp, const std::wstring& filePath) {
     bfh.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
     bfh.bfSize = bfh.bfOffBits + imageSize;
 
-    HANDLE hf = CreateFileW(filePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
-        FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (hf == INVALID_HANDLE_VALUE) return false;
-
-    DWORD written = 0;
-    bool ok = true;
-
-    ok = ok && WriteFile(hf, &bfh, sizeof(bfh), &written, nullptr);
-    ok = ok && WriteFile(hf, &bih, sizeof(bih), &written, nullptr);
+    out.resize((size_t)bfh.bfSize);
+    std::memcpy(out.data(), &bfh, sizeof(bfh));
+    std::memcpy(out.data() + sizeof(bfh), &bih, sizeof(bih));
 
     const BYTE* bits = (const BYTE*)ds.dsBm.bmBits;
+    uint8_t* dst = out.data() + bfh.bfOffBits;
 
     // BMP (bottom-up) verwacht eerst onderste scanline.
-    if (ok) {
-        for (int row = 0; row < h; ++row) {
-            const int srcRow = srcTopDown ? (h - 1 - row) : row;
-            const BYTE* pRow = bits + (SIZE_T)srcRow * stride;
-            ok = ok && WriteFile(hf, pRow, stride, &written, nullptr);
-            if (!ok) break;
-        }
+    if (srcTopDown) {
+        for (int row = 0; row < h; ++row) std::memcpy(dst + (size_t)row * stride, bits + (SIZE_T)(h - 1 - row) * stride, stride);
     }
+    else {
+        std::memcpy(dst, bits, imageSize);
+    }
+    return true;
+}
 
-    CloseHandle(hf);
-    return ok;
+static bool SaveBitmapAsBmpFile(HBITMAP hbmp, const std::wstring& filePath) {
+    std::vector<uint8_t> bytes;
+    return EncodeBitmapBmpToMemory(hbmp, bytes) && WriteWholeFile(filePath, bytes.data(), bytes.size());
 }
 
-static bool SaveBitmapWic(HBITMAP hbmp, const std::wstring& filePath, SaveFormat fmt) {
-    if (!hbmp) return false;
-    if (fmt != SaveFormat::Png && fmt != SaveFormat::Jpeg) return false;
+#endif // !SNIP_CORE_ONLY
 
-    bool needUninit = false;
-    CoInitForDialog(needUninit);
+// =========================================================
+// Auto format: goedkope content-analyse (portable, geen Win32)
+// =========================================================
+// Screenshots van UI hebben weinig kleuren en grote vlakke stukken (PNG wint),
+// foto's/video hebben veel kleuren en ruis (JPEG wint). We samplen een sparse
+// grid zodat de analyse binnen een vast tijdsbudget blijft, ook op 8K.
+struct ContentStats {
+    int    samples = 0;
+    int    distinctColors = 0;  // geteld op de samples, afgekapt op kAutoMaxColors
+    double edgeDensity = 0.0;   // fractie samples met sterke gradient
+    double flatRatio = 0.0;     // fractie samples zonder gradient
+    double gradEntropy = 0.0;   // Shannon-entropie (bits) van gradient-histogram
+    bool   timedOut = false;
+};
+
+static constexpr int kAutoMaxColors = 1024;
+static constexpr int kAutoTargetSamples = 40000;
+
+static inline int Luma8(const uint8_t* px) {
+    // BGRA -> Y (BT.601, integer)
+    return (px[2] * 77 + px[1] * 150 + px[0] * 29) >> 8;
+}
 
-    IWICImagingFactory* factory = nullptr;
-    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
-        IID_PPV_ARGS(&factory));
-    if (FAILED(hr) || !factory) {
-        if (needUninit) CoUninitialize();
-        return false;
-    }
+static ContentStats AnalyzeContentSampled(const uint8_t* bits, int w, int h, int stride, double budgetMs) {
+    ContentStats st{};
+    if (!bits || w < 2 || h < 2) return st;
 
-    IWICStream* stream = nullptr;
-    hr = factory->CreateStream(&stream);
-    if (SUCCEEDED(hr)) hr = stream->InitializeFromFilename(filePath.c_str(), GENERIC_WRITE);
+    const auto t0 = std::chrono::steady_clock::now();
 
-    const GUID container = (fmt == SaveFormat::Png) ? GUID_ContainerFormatPng : GUID_ContainerFormatJpeg;
+    int step = (int)std::sqrt((double)w * (double)h / (double)kAutoTargetSamples);
+    if (step < 1) step = 1;
 
-    IWICBitmapEncoder* encoder = nullptr;
-    if (SUCCEEDED(hr)) hr = factory->CreateEncoder(container, nullptr, &encoder);
-    if (SUCCEEDED(hr)) hr = encoder->Initialize(stream, WICBitmapEncoderNoCache);
+    // open addressing set voor 24-bit kleuren (0 = leeg, daarom kleur | 0x01000000)
+    static constexpr uint32_t kSetSize = 4096; // > 2 * kAutoMaxColors
+    uint32_t set[kSetSize]{};
+    int distinct = 0;
 
-    IWICBitmapFrameEncode* frame = nullptr;
-    IPropertyBag2* bag = nullptr;
-    if (SUCCEEDED(hr)) hr = encoder->CreateNewFrame(&frame, &bag);
+    int hist[32]{};  // bins van 8 luma-stappen, laatste bin = alles >= 248
+    int edges = 0, flat = 0, n = 0;
 
-    // JPEG quality (0..1)
-    if (SUCCEEDED(hr) && fmt == SaveFormat::Jpeg && bag) {
-        PROPBAG2 pb{};
-        pb.pstrName = const_cast<LPOLESTR>(L"ImageQuality");
-        VARIANT v{};
-        VariantInit(&v);
-        v.vt = VT_R4;
-        v.fltVal = 0.92f;
-        bag->Write(1, &pb, &v);
-        VariantClear(&v);
+    for (int y = 0; y + 1 < h; y += step) {
+        const uint8_t* row = bits + (size_t)y * (size_t)stride;
+        const uint8_t* next = row + stride;
+
+        for (int x = 0; x + 1 < w; x += step) {
+            const uint8_t* p = row + (size_t)x * 4;
+            const int l = Luma8(p);
+            const int g = std::abs(Luma8(p + 4) - l) + std::abs(Luma8(next + (size_t)x * 4) - l); // 0..510
+
+            hist[(g >> 3) < 31 ? (g >> 3) : 31]++;
+            if (g == 0) flat++;
+            if (g > 48) edges++;
+            n++;
+
+            if (distinct < kAutoMaxColors) {
+                const uint32_t c = ((uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]) | 0x01000000u;
+                uint32_t i = (c * 2654435761u) >> 20; // 12 bits
+                while (set[i] != 0 && set[i] != c) i = (i + 1) & (kSetSize - 1);
+                if (set[i] == 0) { set[i] = c; distinct++; }
+            }
+        }
+
+        if (MsSince(t0) > budgetMs) { st.timedOut = true; break; }
+    }
+
+    if (n == 0) return st;
+
+    double entropy = 0.0;
+    for (int b = 0; b < 32; ++b) {
+        if (!hist[b]) continue;
+        const double pb = (double)hist[b] / (double)n;
+        entropy -= pb * std::log2(pb);
+    }
+
+    st.samples = n;
+    st.distinctColors = distinct;
+    st.edgeDensity = (double)edges / (double)n;
+    st.flatRatio = (double)flat / (double)n;
+    st.gradEntropy = entropy;
+    return st;
+}
+
+enum class AutoEncoding { PngIndexed, PngTrue, Jpeg };
+
+struct AutoChoice {
+    SaveFormat   fmt = SaveFormat::Png;
+    AutoEncoding enc = AutoEncoding::PngTrue;
+    float        jpegQuality = 0.90f;
+};
+
+static AutoChoice ClassifyContent(const ContentStats& st) {
+    AutoChoice c{};
+    if (st.samples < 64) return c; // te weinig data (of budget op): veilige keuze
+
+    // weinig kleuren: palette-PNG (encoder controleert exact en valt terug op truecolour)
+    if (st.distinctColors <= 256) {
+        c.enc = AutoEncoding::PngIndexed;
+        return c;
+    }
+
+    // foto-achtig: veel kleuren, weinig vlak, brede gradient-verdeling. Zachte foto's
+    // (lucht, onscherpe achtergrond) hebben alleen kleine gradients en dus een lage
+    // entropie, maar bijna niets is vlak: dat comprimeert PNG ook slecht.
+    if (st.distinctColors >= kAutoMaxColors && st.flatRatio < 0.35 && (st.gradEntropy > 2.0 || st.flatRatio < 0.10)) {
+        c.fmt = SaveFormat::Jpeg;
+        c.enc = AutoEncoding::Jpeg;
+        c.jpegQuality = (st.edgeDensity > 0.25) ? 0.92f : 0.88f; // veel randen: iets hoger
+        return c;
+    }
+
+    return c;
+}
+
+static const wchar_t* AutoEncodingText(AutoEncoding e) {
+    switch (e) {
+    case AutoEncoding::PngIndexed: return L"PNG-8";
+    case AutoEncoding::PngTrue:    return L"PNG";
+    case AutoEncoding::Jpeg:       return L"JPEG";
+    default:                       return L"?";
+    }
+}
+
+// Exacte palette (max 256 kleuren) + index-buffer (top-down). false = te veel kleuren.
+// bits/stride mogen negatief "lopen": firstRow wijst naar de bovenste rij.
+static bool BuildExactPalette(const uint8_t* firstRow, int w, int h, ptrdiff_t rowStep,
+    std::vector<uint32_t>& outPalette, std::vector<uint8_t>& outIndices) {
+    outPalette.clear();
+    outIndices.assign((size_t)w * (size_t)h, 0);
+
+    static constexpr uint32_t kSetSize = 1024;
+    uint32_t keys[kSetSize]{};   // 0 = leeg (kleur | 0x01000000)
+    uint8_t  vals[kSetSize]{};
+
+    uint32_t lastKey = 0;
+    uint8_t  lastIdx = 0;
+
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* row = firstRow + (ptrdiff_t)y * rowStep;
+        uint8_t* dst = outIndices.data() + (size_t)y * (size_t)w;
+
+        for (int x = 0; x < w; ++x) {
+            const uint8_t* p = row + (size_t)x * 4;
+            const uint32_t c = ((uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]) | 0x01000000u;
+
+            // runs van dezelfde kleur zijn in UI-captures de normale situatie
+            if (c == lastKey) { dst[x] = lastIdx; continue; }
+
+            uint32_t i = (c * 2654435761u) >> 22; // 10 bits
+            while (keys[i] != 0 && keys[i] != c) i = (i + 1) & (kSetSize - 1);
+            if (keys[i] == 0) {
+                if (outPalette.size() >= 256) return false;
+                keys[i] = c;
+                vals[i] = (uint8_t)outPalette.size();
+                outPalette.push_back(0xFF000000u | (c & 0x00FFFFFFu)); // WICColor = ARGB
+            }
+            lastKey = c;
+            lastIdx = vals[i];
+            dst[x] = lastIdx;
+        }
+    }
+    return true;
+}
+
+#if !SNIP_CORE_ONLY
+// tryIndexed: PNG als 8-bit palette schrijven als de capture <= 256 kleuren heeft.
+// Schrijft naar 'stream' (bestand of geheugen): zelfde bytes in beide gevallen.
+static HRESULT EncodeBitmapWic(IWICImagingFactory* factory, HBITMAP hbmp, IStream* stream, SaveFormat fmt,
+    float jpegQuality, bool tryIndexed, bool* outIndexed) {
+    HRESULT hr = S_OK;
+    const GUID container = (fmt == SaveFormat::Png) ? GUID_ContainerFormatPng : GUID_ContainerFormatJpeg;
+
+    IWICBitmapEncoder* encoder = nullptr;
+    if (SUCCEEDED(hr)) hr = factory->CreateEncoder(container, nullptr, &encoder);
+    if (SUCCEEDED(hr)) hr = encoder->Initialize(stream, WICBitmapEncoderNoCache);
+
+    IWICBitmapFrameEncode* frame = nullptr;
+    IPropertyBag2* bag = nullptr;
+    if (SUCCEEDED(hr)) hr = encoder->CreateNewFrame(&frame, &bag);
+
+    // JPEG quality (0..1)
+    if (SUCCEEDED(hr) && fmt == SaveFormat::Jpeg && bag) {
+        PROPBAG2 pb{};
+        pb.pstrName = const_cast<LPOLESTR>(L"ImageQuality");
+        VARIANT v{};
+        VariantInit(&v);
+        v.vt = VT_R4;
+        v.fltVal = jpegQuality;
+        bag->Write(1, &pb, &v);
+        VariantClear(&v);
     }
 
     if (SUCCEEDED(hr)) hr = frame->Initialize(bag);
@@ -1068,1614 +1476,12037 @@ static bool SaveBitmapWic(HBITMAP hbmp, const std::wstring& filePath, SaveFormat
 
     if (SUCCEEDED(hr)) hr = frame->SetSize((UINT)w, (UINT)h);
 
-    GUID pf = (fmt == SaveFormat::Jpeg) ? GUID_WICPixelFormat24bppBGR : GUID_WICPixelFormat32bppBGRA;
-    if (SUCCEEDED(hr)) {
-        GUID setPf = pf;
-        frame->SetPixelFormat(&setPf);
+    // palette-PNG alleen als het exact past (lossless), anders gewoon truecolour
+    std::vector<uint32_t> palette;
+    std::vector<uint8_t> indices;
+    bool useIndexed = false;
+    if (SUCCEEDED(hr) && tryIndexed && fmt == SaveFormat::Png && ds.dsBm.bmBits) {
+        const bool topDown = (ds.dsBmih.biHeight < 0);
+        const ptrdiff_t stride = ds.dsBm.bmWidthBytes;
+        const uint8_t* base = (const uint8_t*)ds.dsBm.bmBits;
+        const uint8_t* first = topDown ? base : base + (ptrdiff_t)(h - 1) * stride;
+        useIndexed = BuildExactPalette(first, w, h, topDown ? stride : -stride, palette, indices);
     }
 
+    IWICPalette* wicPal = nullptr;
     IWICBitmap* wicBmp = nullptr;
-    if (SUCCEEDED(hr)) hr = factory->CreateBitmapFromHBITMAP(hbmp, nullptr, WICBitmapUseAlpha, &wicBmp);
-
     IWICFormatConverter* conv = nullptr;
-    if (SUCCEEDED(hr)) hr = factory->CreateFormatConverter(&conv);
 
-    if (SUCCEEDED(hr)) {
-        hr = conv->Initialize(wicBmp, pf, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+    if (useIndexed) {
+        if (SUCCEEDED(hr)) hr = factory->CreatePalette(&wicPal);
+        if (SUCCEEDED(hr)) hr = wicPal->InitializeCustom(palette.data(), (UINT)palette.size());
+        if (SUCCEEDED(hr)) {
+            GUID setPf = GUID_WICPixelFormat8bppIndexed;
+            hr = frame->SetPixelFormat(&setPf);
+        }
+        if (SUCCEEDED(hr)) hr = frame->SetPalette(wicPal);
+        if (SUCCEEDED(hr)) hr = frame->WritePixels((UINT)h, (UINT)w, (UINT)indices.size(), indices.data());
+        if (SUCCEEDED(hr) && outIndexed) *outIndexed = true;
     }
+    else {
+        GUID pf = (fmt == SaveFormat::Jpeg) ? GUID_WICPixelFormat24bppBGR : GUID_WICPixelFormat32bppBGRA;
+        if (SUCCEEDED(hr)) {
+            GUID setPf = pf;
+            frame->SetPixelFormat(&setPf);
+        }
 
-    if (SUCCEEDED(hr)) hr = frame->WriteSource(conv, nullptr);
+        if (SUCCEEDED(hr)) hr = factory->CreateBitmapFromHBITMAP(hbmp, nullptr, WICBitmapUseAlpha, &wicBmp);
+        if (SUCCEEDED(hr)) hr = factory->CreateFormatConverter(&conv);
+
+        if (SUCCEEDED(hr)) {
+            hr = conv->Initialize(wicBmp, pf, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+        }
+
+        if (SUCCEEDED(hr)) hr = frame->WriteSource(conv, nullptr);
+    }
     if (SUCCEEDED(hr)) hr = frame->Commit();
     if (SUCCEEDED(hr)) hr = encoder->Commit();
 
     if (conv) conv->Release();
     if (wicBmp) wicBmp->Release();
+    if (wicPal) wicPal->Release();
     if (bag) bag->Release();
     if (frame) frame->Release();
     if (encoder) encoder->Release();
-    if (stream) stream->Release();
-    if (factory) factory->Release();
-    if (needUninit) CoUninitialize();
-
-    return SUCCEEDED(hr);
+    return hr;
 }
 
-static bool SaveBitmapFile(HBITMAP hbmp, const std::wstring& filePath, SaveFormat fmt) {
-    switch (fmt) {
-    case SaveFormat::Png:  return SaveBitmapWic(hbmp, filePath, fmt);
-    case SaveFormat::Jpeg: return SaveBitmapWic(hbmp, filePath, fmt);
-    case SaveFormat::Bmp:  return SaveBitmapAsBmpFile(hbmp, filePath);
-    default:               return false;
-    }
+// Inhoud van een CreateStreamOnHGlobal-stream -> bytes.
+static HRESULT HGlobalStreamToBytes(IStream* stream, std::vector<uint8_t>& out) {
+    STATSTG stat{};
+    HGLOBAL hg = nullptr;
+    HRESULT hr = stream->Stat(&stat, STATFLAG_NONAME);
+    if (SUCCEEDED(hr)) hr = GetHGlobalFromStream(stream, &hg);
+    const void* p = SUCCEEDED(hr) ? GlobalLock(hg) : nullptr;
+    if (!p) return E_FAIL;
+    out.assign((const uint8_t*)p, (const uint8_t*)p + (size_t)stat.cbSize.QuadPart);
+    GlobalUnlock(hg);
+    return S_OK;
 }
 
-static std::vector<POINT> LassoSmoothClosed_Chaikin(std::vector<POINT> pts, int iterations)
-{
-    if (pts.size() < 3 || iterations <= 0) return pts;
+static bool SaveBitmapWic(HBITMAP hbmp, const std::wstring& filePath, SaveFormat fmt,
+    float jpegQuality = 0.92f, bool tryIndexed = false, bool* outIndexed = nullptr) {
+    if (outIndexed) *outIndexed = false;
+    if (!hbmp) return false;
+    if (fmt != SaveFormat::Png && fmt != SaveFormat::Jpeg) return false;
 
-    // verwijder dubbele opeenvolgende punten
-    {
-        std::vector<POINT> clean;
-        clean.reserve(pts.size());
-        for (auto p : pts) {
-            if (clean.empty() || p.x != clean.back().x || p.y != clean.back().y) clean.push_back(p);
-        }
-        pts.swap(clean);
+    bool needUninit = false;
+    CoInitForDialog(needUninit);
+
+    IWICImagingFactory* factory = nullptr;
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+        IID_PPV_ARGS(&factory));
+    if (FAILED(hr) || !factory) {
+        if (needUninit) CoUninitialize();
+        return false;
     }
-    if (pts.size() < 3) return pts;
 
-    for (int it = 0; it < iterations; ++it) {
-        // rem: voorkom explosie
-        if (pts.size() > 4096) break;
+    IWICStream* stream = nullptr;
+    hr = factory->CreateStream(&stream);
+    if (SUCCEEDED(hr)) hr = stream->InitializeFromFilename(filePath.c_str(), GENERIC_WRITE);
+    if (SUCCEEDED(hr)) hr = EncodeBitmapWic(factory, hbmp, stream, fmt, jpegQuality, tryIndexed, outIndexed);
 
-        std::vector<POINT> out;
-        out.reserve(pts.size() * 2);
+    if (stream) stream->Release();
+    factory->Release();
+    if (needUninit) CoUninitialize();
 
-        const int n = (int)pts.size();
-        for (int i = 0; i < n; ++i) {
-            const POINT p0 = pts[i];
-            const POINT p1 = pts[(i + 1) % n];
+    return SUCCEEDED(hr);
+}
 
-            // Q = 0.75 p0 + 0.25 p1
-            POINT q{ (3 * p0.x + p1.x) / 4, (3 * p0.y + p1.y) / 4 };
-            // R = 0.25 p0 + 0.75 p1
-            POINT r{ (p0.x + 3 * p1.x) / 4, (p0.y + 3 * p1.y) / 4 };
+// Zelfde encode als SaveBitmapWic, maar naar geheugen (pre-encode op een worker).
+static bool EncodeBitmapWicToMemory(HBITMAP hbmp, SaveFormat fmt, std::vector<uint8_t>& out,
+    float jpegQuality = 0.92f, bool tryIndexed = false, bool* outIndexed = nullptr) {
+    out.clear();
+    if (outIndexed) *outIndexed = false;
+    if (!hbmp) return false;
+    if (fmt != SaveFormat::Png && fmt != SaveFormat::Jpeg) return false;
 
-            out.push_back(q);
-            out.push_back(r);
-        }
+    bool needUninit = false;
+    CoInitForDialog(needUninit);
 
-        pts.swap(out);
+    IWICImagingFactory* factory = nullptr;
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+        IID_PPV_ARGS(&factory));
+    if (FAILED(hr) || !factory) {
+        if (needUninit) CoUninitialize();
+        return false;
     }
 
-    return pts;
+    IStream* stream = nullptr;
+    hr = CreateStreamOnHGlobal(nullptr, TRUE, &stream);
+    if (SUCCEEDED(hr)) hr = EncodeBitmapWic(factory, hbmp, stream, fmt, jpegQuality, tryIndexed, outIndexed);
+    if (SUCCEEDED(hr)) hr = HGlobalStreamToBytes(stream, out);
+
+    if (stream) stream->Release();
+    factory->Release();
+    if (needUninit) CoUninitialize();
+
+    return SUCCEEDED(hr);
 }
 
-static bool ApplyLassoAlphaMask(HBITMAP hbmp, const std::vector<POINT>& ptsClient, const RECT& boundsClient) {
-    if (!hbmp || ptsClient.size() < 3) return false;
+static bool SaveBitmapFile(HBITMAP hbmp, const std::wstring& filePath, SaveFormat fmt) {
+    switch (fmt) {
+    case SaveFormat::Png:  return SaveBitmapWic(hbmp, filePath, fmt);
+    case SaveFormat::Jpeg: return SaveBitmapWic(hbmp, filePath, fmt);
+    case SaveFormat::Bmp:  return SaveBitmapAsBmpFile(hbmp, filePath);
+    default:               return false; // Auto: eerst ChooseAutoFormat
+    }
+}
+
+// Auto: analyse (max ~3 ms) -> keuze. Alpha-captures blijven altijd truecolour PNG
+// (de palette is opaque).
+static AutoChoice ChooseAutoFormat(HBITMAP hbmp, bool hasAlpha) {
+    AutoChoice c{};
+    if (!hbmp || hasAlpha) return c;
 
     DIBSECTION ds{};
-    if (GetObjectW(hbmp, sizeof(ds), &ds) == 0 || !ds.dsBm.bmBits) return false;
+    if (GetObjectW(hbmp, sizeof(ds), &ds) == 0 || !ds.dsBm.bmBits) return c;
 
     const int w = ds.dsBmih.biWidth;
     const int h = (ds.dsBmih.biHeight < 0) ? -ds.dsBmih.biHeight : ds.dsBmih.biHeight;
-    const int stride = ds.dsBm.bmWidthBytes;
 
-    // polygon naar "local" coords (0..w/h)
-    std::vector<POINT> poly;
-    poly.reserve(ptsClient.size());
-    for (auto p : ptsClient) {
-        poly.push_back({ p.x - boundsClient.left, p.y - boundsClient.top });
+    const auto t0 = std::chrono::steady_clock::now();
+    const ContentStats st = AnalyzeContentSampled((const uint8_t*)ds.dsBm.bmBits, w, h, ds.dsBm.bmWidthBytes, 3.0);
+    c = ClassifyContent(st);
+
+    DebugLog(L"auto-format: %dx%d samples=%d colors=%d edges=%.3f flat=%.3f entropy=%.2f%s -> %s (%.2f ms)",
+        w, h, st.samples, st.distinctColors, st.edgeDensity, st.flatRatio, st.gradEntropy,
+        st.timedOut ? L" (budget)" : L"", AutoEncodingText(c.enc), MsSince(t0));
+    return c;
+}
+
+static bool SaveBitmapAuto(HBITMAP hbmp, const std::wstring& filePath, const AutoChoice& c, bool* outIndexed) {
+    if (c.fmt == SaveFormat::Jpeg) {
+        if (outIndexed) *outIndexed = false;
+        return SaveBitmapWic(hbmp, filePath, SaveFormat::Jpeg, c.jpegQuality);
     }
+    return SaveBitmapWic(hbmp, filePath, SaveFormat::Png, 0.92f, c.enc == AutoEncoding::PngIndexed, outIndexed);
+}
 
-    BYTE* bits = (BYTE*)ds.dsBm.bmBits;
-    std::vector<double> xs;
-    xs.reserve(poly.size());
+// Pixels (top-down BGRA) -> gecodeerd bestand in geheugen via WIC.
+// Thread-safe zolang elke thread zijn eigen factory gebruikt.
+static bool EncodePixelsWicToMemory(IWICImagingFactory* factory, const uint8_t* topDown, int w, int h, size_t stride,
+    SaveFormat fmt, std::vector<uint8_t>& out, float jpegQuality = 0.92f) {
+    out.clear();
+    if (!factory || !topDown || w <= 0 || h <= 0) return false;
+    if (fmt != SaveFormat::Png && fmt != SaveFormat::Jpeg) return false;
 
-    for (int y = 0; y < h; ++y) {
-        // DIB is bottom-up: y=0 (top) zit in memory op rij (h-1)
-        BYTE* row = bits + (size_t)(h - 1 - y) * (size_t)stride;
+    IStream* stream = nullptr;
+    HRESULT hr = CreateStreamOnHGlobal(nullptr, TRUE, &stream);
 
-        // bewaar originele rij (we gaan buitengebied leegmaken)
-        std::vector<BYTE> backup((size_t)w * 4);
-        std::memcpy(backup.data(), row, (size_t)w * 4);
+    IWICBitmapEncoder* encoder = nullptr;
+    const GUID container = (fmt == SaveFormat::Png) ? GUID_ContainerFormatPng : GUID_ContainerFormatJpeg;
+    if (SUCCEEDED(hr)) hr = factory->CreateEncoder(container, nullptr, &encoder);
+    if (SUCCEEDED(hr)) hr = encoder->Initialize(stream, WICBitmapEncoderNoCache);
 
-        // behoud overal RGB (dus geen zwarte rand later)
-        std::memcpy(row, backup.data(), (size_t)w * 4);
+    IWICBitmapFrameEncode* frame = nullptr;
+    IPropertyBag2* bag = nullptr;
+    if (SUCCEEDED(hr)) hr = encoder->CreateNewFrame(&frame, &bag);
 
-        // zet overal alpha = 0 (transparant)
-        for (int x = 0; x < w; ++x) {
-            row[x * 4 + 3] = 0;
-        }
+    if (SUCCEEDED(hr) && fmt == SaveFormat::Jpeg && bag) {
+        PROPBAG2 pb{};
+        pb.pstrName = const_cast<LPOLESTR>(L"ImageQuality");
+        VARIANT v{};
+        VariantInit(&v);
+        v.vt = VT_R4;
+        v.fltVal = jpegQuality;
+        bag->Write(1, &pb, &v);
+        VariantClear(&v);
+    }
 
-        // maak hele rij transparant
-        std::memset(row, 0, (size_t)w * 4);
+    if (SUCCEEDED(hr)) hr = frame->Initialize(bag);
+    if (SUCCEEDED(hr)) hr = frame->SetSize((UINT)w, (UINT)h);
 
-        xs.clear();
+    // opaque captures: 24bpp (kleiner), anders BGRA
+    GUID pf = GUID_WICPixelFormat24bppBGR;
+    if (SUCCEEDED(hr)) {
+        GUID setPf = pf;
+        frame->SetPixelFormat(&setPf);
+    }
 
-        // snijpunten met scanline (even-odd rule)
-        const int n = (int)poly.size();
-        for (int i = 0; i < n; i++) {
-            POINT a = poly[i];
-            POINT b = poly[(i + 1) % n];
-            if (a.y == b.y) continue;
+    IWICBitmap* wicBmp = nullptr;
+    const UINT bufBytes = (UINT)(stride * (size_t)(h - 1) + (size_t)w * 4);
+    if (SUCCEEDED(hr)) {
+        hr = factory->CreateBitmapFromMemory((UINT)w, (UINT)h, GUID_WICPixelFormat32bppBGRA, (UINT)stride,
+            bufBytes, const_cast<BYTE*>(topDown), &wicBmp);
+    }
 
-            int ymin = (a.y < b.y) ? a.y : b.y;
-            int ymax = (a.y < b.y) ? b.y : a.y;
+    IWICFormatConverter* conv = nullptr;
+    if (SUCCEEDED(hr)) hr = factory->CreateFormatConverter(&conv);
+    if (SUCCEEDED(hr)) hr = conv->Initialize(wicBmp, pf, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
 
-            if (y < ymin || y >= ymax) continue;
+    if (SUCCEEDED(hr)) hr = frame->WriteSource(conv, nullptr);
+    if (SUCCEEDED(hr)) hr = frame->Commit();
+    if (SUCCEEDED(hr)) hr = encoder->Commit();
+    if (SUCCEEDED(hr)) hr = HGlobalStreamToBytes(stream, out);
 
-            double t = (double)(y - a.y) / (double)(b.y - a.y);
-            double x = (double)a.x + t * (double)(b.x - a.x);
-            xs.push_back(x);
-        }
+    if (conv) conv->Release();
+    if (wicBmp) wicBmp->Release();
+    if (bag) bag->Release();
+    if (frame) frame->Release();
+    if (encoder) encoder->Release();
+    if (stream) stream->Release();
+
+    return SUCCEEDED(hr);
+}
+
+#endif // !SNIP_CORE_ONLY
 
-        if (xs.size() < 2) continue;
-        std::sort(xs.begin(), xs.end());
+// =========================================================
+// Content hash (portable; SSE2 waar beschikbaar)
+// =========================================================
+// XXH3-achtige 64-bit hash: 8 lanes, 64-byte stripes, 32x32->64 multiply per lane.
+// De SSE2- en scalar-variant geven exact dezelfde uitkomst (de index is persistent).
+static constexpr uint64_t kHashPrime32_1 = 0x9E3779B1ull;
+static constexpr uint64_t kHashPrime64_1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t kHashPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr size_t   kHashStripe = 64;
+static constexpr size_t   kHashStripesPerBlock = 16;
+
+alignas(16) static const uint64_t kHashSecret[8] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+    0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+};
+
+static inline uint64_t Read64LE(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8); // x86/x64: little-endian
+    return v;
+}
 
-        for (size_t k = 0; k + 1 < xs.size(); k += 2) {
-            int x0 = (int)std::ceil(xs[k]);
-            int x1 = (int)std::floor(xs[k + 1]);
+static inline uint64_t HashMulFold64(uint64_t a, uint64_t b) {
+    // 64x64 -> 128, lo ^ hi (portable, zonder __int128/_umul128)
+    const uint64_t aLo = a & 0xFFFFFFFFull, aHi = a >> 32;
+    const uint64_t bLo = b & 0xFFFFFFFFull, bHi = b >> 32;
+    const uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+    const uint64_t mid = (ll >> 32) + (lh & 0xFFFFFFFFull) + (hl & 0xFFFFFFFFull);
+    const uint64_t lo = (mid << 32) | (ll & 0xFFFFFFFFull);
+    const uint64_t hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    return lo ^ hi;
+}
 
-            if (x0 < 0) x0 = 0;
-            if (x1 > w) x1 = w;
+static inline uint64_t HashAvalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ull;
+    h ^= h >> 32;
+    return h;
+}
 
-            for (int x = x0; x < x1; ++x) {
-                // BGRA
-                row[x * 4 + 0] = backup[x * 4 + 0];
-                row[x * 4 + 1] = backup[x * 4 + 1];
-                row[x * 4 + 2] = backup[x * 4 + 2];
-                row[x * 4 + 3] = 255; // alpha
-            }
+static void HashAccumulateScalar(uint64_t acc[8], const uint8_t* p, size_t stripes) {
+    for (size_t s = 0; s < stripes; ++s, p += kHashStripe) {
+        for (int i = 0; i < 8; ++i) {
+            const uint64_t data = Read64LE(p + (size_t)i * 8);
+            const uint64_t key = data ^ kHashSecret[i];
+            acc[i ^ 1] += data;
+            acc[i] += (key & 0xFFFFFFFFull) * (key >> 32);
         }
     }
+}
 
-    return true;
+static void HashScrambleScalar(uint64_t acc[8]) {
+    for (int i = 0; i < 8; ++i) {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= kHashSecret[i];
+        acc[i] = a * kHashPrime32_1;
+    }
 }
 
-static void FeatherAlpha3x3(HBITMAP hbmp, int passes)
-{
-    if (!hbmp || passes <= 0) return;
+#if SNIP_HAS_SSE2
+static void HashAccumulateSse2(__m128i acc[4], const uint8_t* p, size_t stripes) {
+    const __m128i* sec = (const __m128i*)kHashSecret;
+    for (size_t s = 0; s < stripes; ++s, p += kHashStripe) {
+        for (int i = 0; i < 4; ++i) {
+            const __m128i data = _mm_loadu_si128((const __m128i*)(p + (size_t)i * 16));
+            const __m128i key = _mm_xor_si128(data, _mm_load_si128(sec + i));
+            const __m128i prod = _mm_mul_epu32(key, _mm_srli_epi64(key, 32));
+            const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(prod, swapped));
+        }
+    }
+}
 
-    DIBSECTION ds{};
-    if (GetObjectW(hbmp, sizeof(ds), &ds) == 0 || !ds.dsBm.bmBits) return;
+static void HashScrambleSse2(__m128i acc[4]) {
+    const __m128i* sec = (const __m128i*)kHashSecret;
+    const __m128i prime = _mm_set1_epi32((int)kHashPrime32_1);
+    for (int i = 0; i < 4; ++i) {
+        __m128i a = acc[i];
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_load_si128(sec + i));
+        const __m128i lo = _mm_mul_epu32(a, prime);
+        const __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        acc[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+    }
+}
+#endif
 
-    const int w = ds.dsBmih.biWidth;
-    const int h = (ds.dsBmih.biHeight < 0) ? -ds.dsBmih.biHeight : ds.dsBmih.biHeight;
-    const int stride = ds.dsBm.bmWidthBytes;
+// allowSse2 = false: altijd de scalar-variant (tests vergelijken de twee).
+static uint64_t ContentHash64(const void* data, size_t len, uint64_t seed, bool allowSse2 = true) {
+    const uint8_t* p = (const uint8_t*)data;
 
-    BYTE* bits = (BYTE*)ds.dsBm.bmBits;
+    alignas(16) uint64_t acc[8] = {
+        kHashPrime32_1, kHashPrime64_1 ^ seed, kHashPrime64_2, seed,
+        kHashPrime64_1, kHashPrime32_1 ^ seed, kHashPrime64_2 ^ seed, kHashPrime64_1 + seed,
+    };
 
-    std::vector<uint8_t> a((size_t)w * h);
-    auto readAlpha = [&]() {
-        for (int y = 0; y < h; ++y) {
-            BYTE* row = bits + (size_t)(h - 1 - y) * (size_t)stride;
-            for (int x = 0; x < w; ++x) a[(size_t)y * w + x] = row[x * 4 + 3];
+    const size_t blockBytes = kHashStripe * kHashStripesPerBlock;
+    const size_t fullBlocks = len / blockBytes;
+    const size_t tailStripes = (len % blockBytes) / kHashStripe;
+    const size_t tailBytes = len % kHashStripe;
+
+#if SNIP_HAS_SSE2
+    if (allowSse2) {
+        __m128i v[4];
+        for (int i = 0; i < 4; ++i) v[i] = _mm_load_si128((const __m128i*)(acc + i * 2));
+        for (size_t b = 0; b < fullBlocks; ++b, p += blockBytes) {
+            HashAccumulateSse2(v, p, kHashStripesPerBlock);
+            HashScrambleSse2(v);
         }
-        };
-    auto writeAlpha = [&](const std::vector<uint8_t>& src) {
-        for (int y = 0; y < h; ++y) {
-            BYTE* row = bits + (size_t)(h - 1 - y) * (size_t)stride;
-            for (int x = 0; x < w; ++x) row[x * 4 + 3] = src[(size_t)y * w + x];
+        HashAccumulateSse2(v, p, tailStripes);
+        for (int i = 0; i < 4; ++i) _mm_store_si128((__m128i*)(acc + i * 2), v[i]);
+    } else
+#else
+    (void)allowSse2;
+#endif
+    {
+        for (size_t b = 0; b < fullBlocks; ++b, p += blockBytes) {
+            HashAccumulateScalar(acc, p, kHashStripesPerBlock);
+            HashScrambleScalar(acc);
         }
-        };
+        HashAccumulateScalar(acc, p, tailStripes);
+    }
+    p += tailStripes * kHashStripe;
 
-    readAlpha();
-
-    std::vector<uint8_t> tmp((size_t)w * h);
-
-    for (int p = 0; p < passes; ++p) {
-        for (int y = 0; y < h; ++y) {
-            for (int x = 0; x < w; ++x) {
-                int sum = 0, cnt = 0;
-                for (int dy = -1; dy <= 1; ++dy) {
-                    int yy = y + dy;
-                    if (yy < 0 || yy >= h) continue;
-                    for (int dx = -1; dx <= 1; ++dx) {
-                        int xx = x + dx;
-                        if (xx < 0 || xx >= w) continue;
-                        sum += a[(size_t)yy * w + xx];
-                        cnt++;
-                    }
-                }
-                tmp[(size_t)y * w + x] = (uint8_t)(sum / cnt);
-            }
-        }
-        a.swap(tmp);
+    if (tailBytes) {
+        uint8_t last[kHashStripe]{};
+        std::memcpy(last, p, tailBytes);
+        HashAccumulateScalar(acc, last, 1);
     }
 
-    writeAlpha(a);
+    uint64_t h = (uint64_t)len * kHashPrime64_1;
+    for (int i = 0; i < 8; i += 2) {
+        h += HashMulFold64(acc[i] ^ kHashSecret[(i + 1) & 7], acc[i + 1] ^ kHashSecret[(i + 2) & 7]);
+    }
+    return HashAvalanche(h);
 }
 
-static bool OpenInEditor(const std::wstring& editorExe, const std::wstring& filePath) {
-    if (editorExe.empty() || filePath.empty()) return false;
-
-    SHELLEXECUTEINFOW sei{};
-    sei.cbSize = sizeof(sei);
-    sei.fMask = SEE_MASK_NOASYNC;
-    sei.lpVerb = L"open";
-    sei.lpFile = editorExe.c_str();
-
-    std::wstring params = L"\"" + filePath + L"\"";
-    sei.lpParameters = params.c_str();
-    sei.nShow = SW_SHOWNORMAL;
-
-    return ShellExecuteExW(&sei) != FALSE;
+// Duplicate index, één regel per opgeslagen capture (UTF-16LE):
+// <hash hex> <format> <bytes> <write time> <pad>\r\n
+// Oudere regels zonder write time lezen met writeTime = 0 en vallen bij het
+// opzoeken af (het bestand heeft altijd een echte write time).
+struct HashIndexEntry {
+    int          fmt = 0;       // gevraagde SaveFormat (Auto blijft Auto: de keuze is deterministisch)
+    uint64_t     bytes = 0;     // bestandsgrootte bij opslaan: goedkope check of het nog hetzelfde is
+    uint64_t     writeTime = 0; // ftLastWriteTime bij opslaan: vangt overschrijven met gelijke grootte
+    std::wstring path;
+};
+
+static std::wstring FormatHashIndexLine(uint64_t hash, const HashIndexEntry& e) {
+    wchar_t head[96]{};
+    swprintf(head, 96, L"%016llx %d %llu %llu ", (unsigned long long)hash, e.fmt, (unsigned long long)e.bytes,
+        (unsigned long long)e.writeTime);
+    return head + e.path + L"\r\n";
 }
 
-static void OpenPath(const std::wstring& path) {
-    if (path.empty()) return;
-    ShellExecuteW(nullptr, L"open", path.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
+// line zonder \r\n
+static bool ParseHashIndexLine(const std::wstring& line, uint64_t& hash, HashIndexEntry& e) {
+    wchar_t* p = nullptr;
+    hash = wcstoull(line.c_str(), &p, 16);
+    if (!p || *p != L' ') return false;
+    e.fmt = (int)wcstol(p + 1, &p, 10);
+    if (!p || *p != L' ') return false;
+    e.bytes = wcstoull(p + 1, &p, 10);
+    if (!p || *p != L' ' || !p[1]) return false;
+    // write time is optioneel (oud formaat); een absoluut pad begint nooit met een cijfer
+    wchar_t* q = nullptr;
+    const uint64_t wt = wcstoull(p + 1, &q, 10);
+    e.writeTime = 0;
+    if (q && q != p + 1 && *q == L' ' && q[1]) {
+        e.writeTime = wt;
+        p = q;
+    }
+    e.path = p + 1;
+    return true;
 }
 
+#if !SNIP_CORE_ONLY
 // =========================================================
-// Menus
+// Duplicate index (persistent): hash -> eerder opgeslagen bestand
 // =========================================================
-static void ShowModeMenu(HWND hwndOwner) {
-    HMENU menu = CreatePopupMenu();
-    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Region ? MF_CHECKED : 0), 1001, L"Region");
-    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Window ? MF_CHECKED : 0), 1002, L"Window");
-    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Monitor ? MF_CHECKED : 0), 1003, L"Monitor");
-    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Freestyle ? MF_CHECKED : 0), 1004, L"Freestyle (Lasso)");
-    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Polygon ? MF_CHECKED : 0), 1005, L"Polygon");
+static std::unordered_multimap<uint64_t, HashIndexEntry> g_hashIndex;
+static bool   g_hashIndexLoaded = false;
+static size_t g_hashIndexLines = 0;
 
-    POINT pt{};
-    GetCursorPos(&pt);
-    TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_NOANIMATION, pt.x, pt.y, 0, hwndOwner, nullptr);
-    DestroyMenu(menu);
+static std::wstring HashIndexFile() {
+    return SettingsDir() + L"\\hash-index.txt";
 }
 
-static void ShowSaveMenu(HWND hwnd) {
-    HMENU menu = CreatePopupMenu();
-    AppendMenuW(menu, MF_STRING, 2001, L"Open capture folder");
-    AppendMenuW(menu, MF_STRING, 2003, L"Choose capture folder...");
+static bool ReadWholeFile(const std::wstring& path, std::vector<uint8_t>& out) {
+    out.clear();
+    HANDLE hf = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hf == INVALID_HANDLE_VALUE) return false;
 
-    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    LARGE_INTEGER size{};
+    bool ok = GetFileSizeEx(hf, &size) != FALSE && size.QuadPart < (LONGLONG)1 << 30;
+    if (ok) {
+        out.resize((size_t)size.QuadPart);
+        DWORD read = 0;
+        ok = out.empty() || (ReadFile(hf, out.data(), (DWORD)out.size(), &read, nullptr) && read == out.size());
+    }
+    CloseHandle(hf);
+    return ok;
+}
 
-    HMENU fmt = CreatePopupMenu();
-    AppendMenuW(fmt, MF_STRING | (g_saveFormat == SaveFormat::Png ? MF_CHECKED : 0), 2010, L"PNG");
-    AppendMenuW(fmt, MF_STRING | (g_saveFormat == SaveFormat::Jpeg ? MF_CHECKED : 0), 2011, L"JPEG");
-    AppendMenuW(fmt, MF_STRING | (g_saveFormat == SaveFormat::Bmp ? MF_CHECKED : 0), 2012, L"BMP");
-    AppendMenuW(menu, MF_POPUP, (UINT_PTR)fmt, L"Save format");
+static bool AppendToFile(const std::wstring& path, const void* data, DWORD bytes) {
+    HANDLE hf = CreateFileW(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hf == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    const bool ok = WriteFile(hf, data, bytes, &written, nullptr) && written == bytes;
+    CloseHandle(hf);
+    return ok;
+}
 
-    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
-    AppendMenuW(menu, MF_STRING | (g_autoDismissAfterSave ? MF_CHECKED : 0), 2002, L"Auto-dismiss after Save");
+static bool QueryFileSize(const std::wstring& path, uint64_t& outBytes, uint64_t* outWriteTime = nullptr) {
+    WIN32_FILE_ATTRIBUTE_DATA fad{};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) return false;
+    if (fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) return false;
+    outBytes = ((uint64_t)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+    if (outWriteTime) *outWriteTime = ((uint64_t)fad.ftLastWriteTime.dwHighDateTime << 32) | fad.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
 
-    POINT pt{};
-    GetCursorPos(&pt);
-    TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_NOANIMATION, pt.x, pt.y, 0, hwnd, nullptr);
-    DestroyMenu(menu);
+// Bestand is bewust vervangen (recompress, --optimize): grootte en write time opnieuw vastleggen.
+static bool HashIndexRestamp(HashIndexEntry& e) {
+    return QueryFileSize(e.path, e.bytes, &e.writeTime);
 }
 
-static void ShowEditMenu(HWND hwnd) {
-    HMENU menu = CreatePopupMenu();
-    AppendMenuW(menu, MF_STRING, 2101, L"Open in (last program)");
-    AppendMenuW(menu, MF_STRING, 2102, L"Choose program...");
+static void LoadHashIndex() {
+    if (g_hashIndexLoaded) return;
+    g_hashIndexLoaded = true;
 
-    POINT pt{};
-    GetCursorPos(&pt);
-    TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_NOANIMATION, pt.x, pt.y, 0, hwnd, nullptr);
-    DestroyMenu(menu);
-}
+    std::vector<uint8_t> raw;
+    if (!ReadWholeFile(HashIndexFile(), raw)) return;
 
-// =========================================================
-// Preview layout + lifecycle
-// =========================================================
-static void LayoutPreview(HWND hwnd) {
-    RECT rc{};
-    GetClientRect(hwnd, &rc);
+    const wchar_t* s = (const wchar_t*)raw.data();
+    const size_t n = raw.size() / sizeof(wchar_t);
 
-    const int pad = 12;
-    const int barH = 52;       // knoppenbalk
-    const int statusH = 22;    // statusbar onderaan
-    const int btnW = 110;
-    const int btnH = 34;
-    const int gap = 10;
+    size_t i = 0;
+    while (i < n) {
+        size_t end = i;
+        while (end < n && s[end] != L'\n') ++end;
 
-    // statusbar (hele onderrand)
-    g_rcStatus = rc;
-    g_rcStatus.top = rc.bottom - statusH;
+        std::wstring line(s + i, s + end);
+        if (!line.empty() && line.back() == L'\r') line.pop_back();
+        i = end + 1;
 
-    // image area
-    g_rcImage = rc;
-    g_rcImage.left += pad;
-    g_rcImage.top += pad;
-    g_rcImage.right -= pad;
-    g_rcImage.bottom -= (barH + statusH + pad);
+        uint64_t hash = 0;
+        HashIndexEntry e{};
+        if (!ParseHashIndexLine(line, hash, e)) continue;
 
-    // buttons (boven statusbar)
-    int totalW = btnW * 3 + gap * 2;
-    int x0 = (rc.right - totalW) / 2;
-    int y0 = rc.bottom - statusH - barH + (barH - btnH) / 2;
+        g_hashIndex.emplace(hash, std::move(e));
+        g_hashIndexLines++;
+    }
+}
 
-    g_btnSave = { x0,                      y0, x0 + btnW,                   y0 + btnH };
-    g_btnEdit = { x0 + (btnW + gap) * 1,   y0, x0 + (btnW + gap) * 1 + btnW, y0 + btnH };
-    g_btnDismiss = { x0 + (btnW + gap) * 2,   y0, x0 + (btnW + gap) * 2 + btnW, y0 + btnH };
+static void RewriteHashIndex() {
+    std::wstring all;
+    for (const auto& kv : g_hashIndex) all += FormatHashIndexLine(kv.first, kv.second);
+
+    const std::wstring file = HashIndexFile();
+    const std::wstring tmp = file + L".tmp";
+    DeleteFileW(tmp.c_str());
+    if (!all.empty() && !AppendToFile(tmp, all.data(), (DWORD)(all.size() * sizeof(wchar_t)))) return;
+    if (all.empty()) DeleteFileW(file.c_str());
+    else MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    g_hashIndexLines = g_hashIndex.size();
 }
 
-static void DestroyOverlay();
+static bool PathIsInDir(const std::wstring& path, const std::wstring& dir) {
+    if (dir.empty() || path.size() <= dir.size()) return false;
+    if (_wcsnicmp(path.c_str(), dir.c_str(), dir.size()) != 0) return false;
+    const wchar_t c = path[dir.size()];
+    return c == L'\\' || c == L'/' || dir.back() == L'\\';
+}
 
-static void DestroyPreview() {
-    if (g_hwndPreview) {
-        DestroyWindow(g_hwndPreview);
-        g_hwndPreview = nullptr;
+// Zoek een bestaand bestand met dezelfde pixels + hetzelfde formaat in saveDir.
+// Verdwenen of gewijzigde bestanden (andere grootte of write time) worden meteen
+// uit de index gehaald.
+static bool FindDuplicateCapture(uint64_t hash, int fmt, const std::wstring& saveDir, std::wstring& outPath) {
+    LoadHashIndex();
+
+    bool stale = false;
+    auto range = g_hashIndex.equal_range(hash);
+    for (auto it = range.first; it != range.second; ) {
+        uint64_t bytes = 0, writeTime = 0;
+        if (!QueryFileSize(it->second.path, bytes, &writeTime) || bytes != it->second.bytes ||
+            writeTime != it->second.writeTime) {
+            it = g_hashIndex.erase(it);
+            stale = true;
+            continue;
+        }
+        if (it->second.fmt == fmt && PathIsInDir(it->second.path, saveDir)) {
+            outPath = it->second.path;
+            return true;
+        }
+        ++it;
     }
-    FreeCapture();
-    g_statusText.clear();
+
+    if (stale && g_hashIndexLines > 2 * g_hashIndex.size() + 64) RewriteHashIndex();
+    return false;
 }
 
-// =========================================================
-// Preview WindowProc
-// =========================================================
-static LRESULT CALLBACK PreviewProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-    switch (msg) {
-    case WM_CREATE:
-        LayoutPreview(hwnd);
-        return 0;
+static void RecordSavedCapture(uint64_t hash, int fmt, const std::wstring& path) {
+    LoadHashIndex();
 
-    case WM_SIZE:
-        LayoutPreview(hwnd);
-        InvalidateRect(hwnd, nullptr, TRUE);
-        return 0;
+    HashIndexEntry e{};
+    e.fmt = fmt;
+    e.path = path;
+    if (!QueryFileSize(path, e.bytes, &e.writeTime)) return;
 
-    case WM_TIMER:
-        if (wParam == TIMER_STATUS_CLEAR) {
-            KillTimer(hwnd, TIMER_STATUS_CLEAR);
-            g_statusText.clear();
-            InvalidateRect(hwnd, nullptr, TRUE);
-        }
-        return 0;
+    EnsureDirectoryRecursive(SettingsDir() + L"\\");
+    const std::wstring line = FormatHashIndexLine(hash, e);
+    AppendToFile(HashIndexFile(), line.data(), (DWORD)(line.size() * sizeof(wchar_t)));
 
-    case WM_KEYDOWN:
-        if (wParam == VK_ESCAPE) { DestroyPreview(); return 0; }
-        return 0;
+    g_hashIndex.emplace(hash, std::move(e));
+    g_hashIndexLines++;
+}
 
-    case WM_SETCURSOR: {
-        // Windows geeft in lParam de hit-test code mee (HTCLIENT / HTCAPTION / etc.)
-        const WORD ht = LOWORD(lParam);
+// Hash over de uiteindelijke pixels (na mask/feather, na annotaties).
+static bool BitmapContentHash(HBITMAP bmp, bool hasAlpha, uint64_t& outHash) {
+    if (!bmp) return false;
 
-        // Als wij sleepgebied teruggeven als HTCAPTION -> maak cursor een handje
-        if (ht == HTCAPTION) {
-            SetCursor(LoadCursorW(nullptr, IDC_HAND));
-            return TRUE;
-        }
+    DIBSECTION ds{};
+    if (GetObjectW(bmp, sizeof(ds), &ds) == 0 || !ds.dsBm.bmBits) return false;
 
-        // Als het client-area is (buttons), ook handje
-        if (ht == HTCLIENT) {
-            POINT pt{};
-            GetCursorPos(&pt);
-            ScreenToClient(hwnd, &pt);
+    const int h = (ds.dsBmih.biHeight < 0) ? -ds.dsBmih.biHeight : ds.dsBmih.biHeight;
+    const size_t bytes = (size_t)ds.dsBm.bmWidthBytes * (size_t)h;
+    const uint64_t seed = ((uint64_t)ds.dsBmih.biWidth << 32) ^ (uint64_t)h ^ (hasAlpha ? 1ull << 63 : 0);
 
-            if (PtInRectEx(g_btnSave, pt) || PtInRectEx(g_btnEdit, pt) || PtInRectEx(g_btnDismiss, pt)) {
-                SetCursor(LoadCursorW(nullptr, IDC_HAND));
-                return TRUE;
-            }
+    const auto t0 = std::chrono::steady_clock::now();
+    outHash = ContentHash64(ds.dsBm.bmBits, bytes, seed);
 
-            // Overige client-area: normale pijl
-            SetCursor(LoadCursorW(nullptr, IDC_ARROW));
-            return TRUE;
-        }
+    const double ms = MsSince(t0);
+    DebugLog(L"content hash %016llx: %.1f MB in %.2f ms (%.1f GB/s)", (unsigned long long)outHash,
+        bytes / 1048576.0, ms, ms > 0.0 ? bytes / (ms * 1e6) : 0.0);
+    return true;
+}
 
-        return DefWindowProcW(hwnd, msg, wParam, lParam);
-    }
+// Na elke capture (en na mask/feather), vóór de overdracht aan een sessie.
+static void UpdateCaptureHash() {
+    g_captureHashValid = BitmapContentHash(g_captureBmp, g_captureHasAlpha, g_captureHash);
+}
 
-    // === drag window by clicking anywhere except buttons
-    case WM_NCHITTEST: {
-        LRESULT hit = DefWindowProcW(hwnd, msg, wParam, lParam);
-        if (hit != HTCLIENT) return hit;
+#endif // !SNIP_CORE_ONLY
 
-        POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-        ScreenToClient(hwnd, &pt);
+// =========================================================
+// Temp-edit cache: index + sweep-policy (portable, geen Win32)
+// =========================================================
+// Edit-bestanden heten naar hun inhoud: dezelfde capture (hash + formaat) geeft
+// hetzelfde bestand, dat dan direct hergebruikt wordt. Het index houdt per bestand
+// grootte + schrijftijd bij: wijkt een van beide af, dan heeft de editor het
+// bestand aangepast en wordt het niet meer als "schone" kopie gezien.
+// Tijden zijn FILETIME-ticks (100 ns) als uint64.
+struct TempCacheEntry {
+    uint64_t     hash = 0;
+    int          fmt = 0;          // SaveFormat van het bestand (Png/Bmp)
+    uint64_t     bytes = 0;
+    uint64_t     writeTime = 0;    // bij het schrijven
+    uint64_t     lastUse = 0;      // laatste keer geopend/hergebruikt (voor de sweeper)
+    std::wstring name;             // bestandsnaam in de temp-map
+};
+
+static constexpr uint64_t kTicksPerSecond = 10000000ull;
+
+// Regel-formaat (UTF-16LE): <hash hex> <fmt> <bytes> <writeTime> <lastUse> <name>\r\n
+static std::wstring FormatTempCacheLine(const TempCacheEntry& e) {
+    wchar_t head[128]{};
+    swprintf(head, 128, L"%016llx %d %llu %llu %llu ", (unsigned long long)e.hash, e.fmt,
+        (unsigned long long)e.bytes, (unsigned long long)e.writeTime, (unsigned long long)e.lastUse);
+    return head + e.name + L"\r\n";
+}
 
-        if (PtInRectEx(g_btnSave, pt) || PtInRectEx(g_btnEdit, pt) || PtInRectEx(g_btnDismiss, pt)) {
-            return HTCLIENT;
-        }
-        return HTCAPTION;
+static bool ParseTempCacheLine(const std::wstring& line, TempCacheEntry& e) {
+    wchar_t* p = nullptr;
+    e.hash = wcstoull(line.c_str(), &p, 16);
+    if (!p || *p != L' ') return false;
+    e.fmt = (int)wcstol(p + 1, &p, 10);
+    if (!p || *p != L' ') return false;
+    e.bytes = wcstoull(p + 1, &p, 10);
+    if (!p || *p != L' ') return false;
+    e.writeTime = wcstoull(p + 1, &p, 10);
+    if (!p || *p != L' ') return false;
+    e.lastUse = wcstoull(p + 1, &p, 10);
+    if (!p || *p != L' ' || !p[1]) return false;
+    e.name = p + 1;
+    // alleen kale bestandsnamen: het index mag nooit buiten de temp-map wijzen
+    return e.name.find_first_of(L"\\/:") == std::wstring::npos && e.name != L"." && e.name != L"..";
+}
+
+static std::vector<TempCacheEntry> ParseTempCacheIndex(const wchar_t* s, size_t n) {
+    std::vector<TempCacheEntry> out;
+    size_t i = 0;
+    while (i < n) {
+        size_t end = i;
+        while (end < n && s[end] != L'\n') ++end;
+        std::wstring line(s + i, s + end);
+        if (!line.empty() && line.back() == L'\r') line.pop_back();
+        i = end + 1;
+
+        TempCacheEntry e{};
+        if (!ParseTempCacheLine(line, e)) continue;
+        // latere regel voor dezelfde naam wint
+        auto it = std::find_if(out.begin(), out.end(), [&](const TempCacheEntry& o) { return o.name == e.name; });
+        if (it != out.end()) *it = std::move(e);
+        else out.push_back(std::move(e));
     }
+    return out;
+}
 
-    // === remember position/size after move/resize
-    case WM_EXITSIZEMOVE: {
-        RECT wr{};
-        GetWindowRect(hwnd, &wr);
-        IniWriteInt(L"Preview", L"X", wr.left);
-        IniWriteInt(L"Preview", L"Y", wr.top);
-        IniWriteInt(L"Preview", L"W", wr.right - wr.left);
-        IniWriteInt(L"Preview", L"H", wr.bottom - wr.top);
-        return 0;
+// Basisnaam voor (hash, fmt); bezet door een gewijzigde kopie -> "-2", "-3", ...
+static std::wstring TempCacheFileName(uint64_t hash, const wchar_t* ext, int variant) {
+    wchar_t buf[64]{};
+    if (variant <= 1) swprintf(buf, 64, L"edit_%016llx%ls", (unsigned long long)hash, ext);
+    else swprintf(buf, 64, L"edit_%016llx-%d%ls", (unsigned long long)hash, variant, ext);
+    return buf;
+}
+
+struct TempFileInfo {
+    std::wstring name;
+    uint64_t bytes = 0;
+    uint64_t lastUse = 0;   // index.lastUse, anders schrijftijd van het bestand
+    bool pinned = false;    // in gebruik (open preview/editor): nooit weg
+};
+
+// Welke bestanden weg moeten: eerst alles ouder dan maxAge, daarna de oudste tot
+// het totaal onder maxBytes zit. Geeft indices in 'files' terug (oudste eerst).
+static std::vector<size_t> PlanTempSweep(const std::vector<TempFileInfo>& files, uint64_t now, uint64_t maxAgeTicks, uint64_t maxBytes) {
+    std::vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        if (files[a].lastUse != files[b].lastUse) return files[a].lastUse < files[b].lastUse;
+        return files[a].name < files[b].name;
+        });
+
+    uint64_t total = 0;
+    for (const TempFileInfo& f : files) total += f.bytes;
+
+    std::vector<size_t> del;
+    for (size_t i : order) {
+        const TempFileInfo& f = files[i];
+        if (f.pinned) continue;
+        const bool tooOld = now > f.lastUse && now - f.lastUse > maxAgeTicks;
+        if (tooOld || total > maxBytes) {
+            del.push_back(i);
+            total -= f.bytes;
+        }
     }
+    return del;
+}
 
-    case WM_LBUTTONUP: {
-        POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+#if !SNIP_CORE_ONLY
+// =========================================================
+// Temp-edit cache + sweeper
+// =========================================================
+// Index: <TempDir>\index.txt (herschreven via .tmp + MoveFileEx, het is klein).
+// De sweeper draait op een eigen thread met background-prioriteit (CPU + IO):
+// kort na de start, na elk nieuw temp-bestand en verder elk half uur.
+struct TempCacheState {
+    std::mutex mu;                        // index + pinned (UI-thread en sweeper)
+    std::vector<TempCacheEntry> index;
+    bool loaded = false;
+    std::vector<std::wstring> pinned;     // laatst aan een editor gegeven bestanden (per sessie één)
+
+    std::thread sweeper;
+    std::condition_variable cv;
+    bool sweepRequested = false;
+    bool stop = false;
+};
+static TempCacheState g_tempCache;
+static constexpr size_t kTempPinMax = 16;   // ruim boven het aantal open sessies
+
+static constexpr DWORD kTempSweepPeriodMs = 30 * 60 * 1000;
+static constexpr DWORD kTempSweepStartDelayMs = 15 * 1000; // niet tijdens het opstarten
+
+static std::wstring TempCacheIndexFile() {
+    return TempDir() + L"\\index.txt";
+}
 
-        // Save
-        if (PtInRectEx(g_btnSave, p)) {
-            if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
-            EnsureDirectoryRecursive(g_saveDir + L"\\");
+static uint64_t FileTimeTicks(const FILETIME& ft) {
+    return ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
 
-            const bool forcePng = g_captureHasAlpha;
-            const SaveFormat actual = forcePng ? SaveFormat::Png : g_saveFormat;
+static uint64_t NowTicks() {
+    FILETIME ft{};
+    GetSystemTimeAsFileTime(&ft);
+    return FileTimeTicks(ft);
+}
 
-            // basis save-dir
-            if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
-            EnsureDirectoryRecursive(g_saveDir + L"\\");
+static bool QueryFileSizeAndTime(const std::wstring& path, uint64_t& outBytes, uint64_t& outWrite) {
+    WIN32_FILE_ATTRIBUTE_DATA fad{};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) return false;
+    if (fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) return false;
+    outBytes = ((uint64_t)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+    outWrite = FileTimeTicks(fad.ftLastWriteTime);
+    return true;
+}
 
-            // preset kan subfolders bevatten, bv: "2026-02-23\\snip_0001.png"
-            std::wstring rel = SavedRelativePathPreset(actual);
+// mu moet vastgehouden worden.
+static void TempCacheLoadLocked() {
+    if (g_tempCache.loaded) return;
+    g_tempCache.loaded = true;
 
-            // full path bouwen (veilig met/zonder trailing \)
-            std::wstring filePath = g_saveDir;
-            if (!filePath.empty() && filePath.back() != L'\\') filePath += L"\\";
-            filePath += rel;
+    std::vector<uint8_t> raw;
+    if (!ReadWholeFile(TempCacheIndexFile(), raw)) return;
+    g_tempCache.index = ParseTempCacheIndex((const wchar_t*)raw.data(), raw.size() / sizeof(wchar_t));
+}
 
-            // als rel een subfolder bevat: die map eerst aanmaken
-            auto pos = rel.find_last_of(L"\\/");
-            if (pos != std::wstring::npos) {
-                std::wstring subDir = g_saveDir;
-                if (!subDir.empty() && subDir.back() != L'\\') subDir += L"\\";
-                subDir += rel.substr(0, pos);
-                EnsureDirectoryRecursive(subDir + L"\\");
-            }
+// mu moet vastgehouden worden.
+static void TempCacheWriteLocked() {
+    std::wstring all;
+    for (const TempCacheEntry& e : g_tempCache.index) all += FormatTempCacheLine(e);
+
+    const std::wstring file = TempCacheIndexFile();
+    const std::wstring tmp = file + L".tmp";
+    DeleteFileW(tmp.c_str());
+    if (all.empty()) { DeleteFileW(file.c_str()); return; }
+    if (!AppendToFile(tmp, all.data(), (DWORD)(all.size() * sizeof(wchar_t)))) return;
+    MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING);
+}
 
-            if (SaveBitmapFile(g_captureBmp, filePath, actual)) {
-                g_lastSavedFile = filePath;
-                SaveSettings();
+// mu moet vastgehouden worden. Nieuwste achteraan; de oudste pin vervalt.
+static void TempCachePinLocked(const std::wstring& name) {
+    auto& pins = g_tempCache.pinned;
+    pins.erase(std::remove_if(pins.begin(), pins.end(),
+        [&](const std::wstring& p) { return _wcsicmp(p.c_str(), name.c_str()) == 0; }), pins.end());
+    pins.push_back(name);
+    if (pins.size() > kTempPinMax) pins.erase(pins.begin());
+}
 
-                std::wstring statusText = L"Saved ";
-                statusText += SaveFormatText(actual);
-                SetStatus(hwnd, statusText);
+static void TempSweepRequest();
 
-                if (g_autoDismissAfterSave) DestroyPreview();
-            }
-            else {
-                SetStatus(hwnd, L"Save failed");
-            }
-            return 0;
+// Temp-bestand voor bmp (met content hash) in fmt: bestaand (ongewijzigd) bestand met
+// dezelfde pixels, anders nu schrijven. Zonder geldige hash: oud gedrag (vers bestand).
+// pin: het bestand gaat naar de editor, de sweeper laat het staan. Thread-safe.
+static bool TempEditFileForBitmap(HBITMAP bmp, uint64_t hash, bool hashValid, SaveFormat fmt, bool pin,
+    std::wstring& outPath, bool* outReused) {
+    if (outReused) *outReused = false;
+    if (!bmp) return false;
+
+    if (!hashValid) {
+        outPath = MakeTempEditPath(fmt);
+        return SaveBitmapFile(bmp, outPath, fmt);
+    }
+
+    const std::wstring dir = TempDir();
+    EnsureDirectoryRecursive(dir + L"\\");
+    const wchar_t* ext = (fmt == SaveFormat::Png) ? L".png" : (fmt == SaveFormat::Jpeg) ? L".jpg" : L".bmp";
+
+    std::unique_lock<std::mutex> lock(g_tempCache.mu);
+    TempCacheLoadLocked();
+
+    // 1) schone kopie al aanwezig?
+    bool dirty = false;
+    for (auto it = g_tempCache.index.begin(); it != g_tempCache.index.end(); ) {
+        if (it->hash != hash || it->fmt != (int)fmt) { ++it; continue; }
+        uint64_t bytes = 0, wt = 0;
+        if (QueryFileSizeAndTime(dir + L"\\" + it->name, bytes, wt) && bytes == it->bytes && wt == it->writeTime) {
+            it->lastUse = NowTicks();
+            outPath = dir + L"\\" + it->name;
+            if (pin) TempCachePinLocked(it->name);
+            TempCacheWriteLocked();
+            if (outReused) *outReused = true;
+            return true;
         }
+        // weg of door de editor aangepast: niet meer van ons (sweeper ruimt het op leeftijd op)
+        it = g_tempCache.index.erase(it);
+        dirty = true;
+    }
 
-        // Edit (open in chosen program)
-        if (PtInRectEx(g_btnEdit, p)) {
-            // 1) Zorg dat we een editor hebben
-            if (g_editorExe.empty()) {
-                std::wstring exe;
-                if (!PickExe(hwnd, exe)) { SetStatus(hwnd, L"Canceled"); return 0; }
-                g_editorExe = exe;
-                SaveSettings();
-            }
+    // 2) vrije naam (een gewijzigde kopie blijft staan)
+    std::wstring name;
+    for (int v = 1; v < 100; ++v) {
+        name = TempCacheFileName(hash, ext, v);
+        if (GetFileAttributesW((dir + L"\\" + name).c_str()) == INVALID_FILE_ATTRIBUTES) break;
+    }
+    lock.unlock(); // encode buiten de lock: de sweeper hoeft niet te wachten
 
-            // 2) Schrijf HUIDIGE capture naar een temp bestand
-            SaveFormat tmpFmt = g_captureHasAlpha ? SaveFormat::Png : SaveFormat::Bmp;
+    const std::wstring path = dir + L"\\" + name;
+    if (!SaveBitmapFile(bmp, path, fmt)) {
+        if (dirty) { std::lock_guard<std::mutex> g(g_tempCache.mu); TempCacheWriteLocked(); }
+        return false;
+    }
 
-            std::wstring tempPath = MakeTempEditPath(tmpFmt);
-            if (!SaveBitmapFile(g_captureBmp, tempPath, tmpFmt)) {
-                SetStatus(hwnd, L"Save failed");
-                return 0;
-            }
-            g_tempEditFile = tempPath;
+    TempCacheEntry e{};
+    e.hash = hash;
+    e.fmt = (int)fmt;
+    e.name = name;
+    e.lastUse = NowTicks();
+    QueryFileSizeAndTime(path, e.bytes, e.writeTime);
+
+    lock.lock();
+    g_tempCache.index.push_back(std::move(e));
+    if (pin) TempCachePinLocked(name);
+    TempCacheWriteLocked();
+    lock.unlock();
+
+    outPath = path;
+    TempSweepRequest();
+    return true;
+}
 
+static void TempSweepOnce() {
+    const std::wstring dir = TempDir();
+    const uint64_t maxAge = (uint64_t)g_tempMaxAgeHours * 3600ull * kTicksPerSecond;
+    const uint64_t maxBytes = (uint64_t)g_tempMaxMB * 1024ull * 1024ull;
 
-            // 3) Open temp in editor
-            PreviewDropTopmost(hwnd);   // (als je die helper al hebt)
-            if (OpenInEditor(g_editorExe, g_tempEditFile)) SetStatus(hwnd, L"Opened");
-            else SetStatus(hwnd, L"Open failed");
+    // 1) directory + index -> plan
+    std::vector<TempFileInfo> files;
+    {
+        std::lock_guard<std::mutex> lock(g_tempCache.mu);
+        TempCacheLoadLocked();
+
+        WIN32_FIND_DATAW fd{};
+        HANDLE hf = FindFirstFileW((dir + L"\\*").c_str(), &fd);
+        if (hf == INVALID_HANDLE_VALUE) return;
+        do {
+            if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+            TempFileInfo f{};
+            f.name = fd.cFileName;
+            if (_wcsicmp(f.name.c_str(), L"index.txt") == 0 || _wcsicmp(f.name.c_str(), L"index.txt.tmp") == 0) continue;
+            f.bytes = ((uint64_t)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+            f.lastUse = FileTimeTicks(fd.ftLastWriteTime);
+            for (const TempCacheEntry& e : g_tempCache.index) {
+                if (_wcsicmp(e.name.c_str(), f.name.c_str()) == 0) { f.lastUse = std::max(f.lastUse, e.lastUse); break; }
+            }
+            for (const std::wstring& p : g_tempCache.pinned) {
+                if (_wcsicmp(f.name.c_str(), p.c_str()) == 0) { f.pinned = true; break; }
+            }
+            files.push_back(std::move(f));
+        } while (FindNextFileW(hf, &fd));
+        FindClose(hf);
+    }
 
-            return 0;
-        }
+    const auto t0 = std::chrono::steady_clock::now();
+    const std::vector<size_t> del = PlanTempSweep(files, NowTicks(), maxAge, maxBytes);
 
-        // Dismiss
-        if (PtInRectEx(g_btnDismiss, p)) {
-            DestroyPreview();
-            return 0;
+    // 2) verwijderen zonder lock (een bestand dat de editor open heeft faalt gewoon)
+    std::vector<std::wstring> gone;
+    uint64_t freed = 0;
+    for (size_t i : del) {
+        if (DeleteFileW((dir + L"\\" + files[i].name).c_str())) {
+            gone.push_back(files[i].name);
+            freed += files[i].bytes;
         }
+    }
 
-        return 0;
+    // 3) index bijwerken
+    if (!gone.empty()) {
+        std::lock_guard<std::mutex> lock(g_tempCache.mu);
+        auto& idx = g_tempCache.index;
+        idx.erase(std::remove_if(idx.begin(), idx.end(), [&](const TempCacheEntry& e) {
+            for (const std::wstring& n : gone) if (_wcsicmp(n.c_str(), e.name.c_str()) == 0) return true;
+            return false;
+            }), idx.end());
+        TempCacheWriteLocked();
     }
+    DebugLog(L"temp sweep: %zu files, %zu deleted (%.1f MB) in %.2f ms", files.size(), gone.size(), freed / 1048576.0, MsSince(t0));
+}
 
-    case WM_RBUTTONUP: {
-        POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-        if (PtInRectEx(g_btnSave, p)) { ShowSaveMenu(hwnd); return 0; }
-        if (PtInRectEx(g_btnEdit, p)) { ShowEditMenu(hwnd); return 0; }
-        return 0;
+static void TempSweepThread() {
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN); // CPU + IO laag
+
+    std::unique_lock<std::mutex> lock(g_tempCache.mu);
+    g_tempCache.cv.wait_for(lock, std::chrono::milliseconds(kTempSweepStartDelayMs), [] { return g_tempCache.stop; });
+    while (!g_tempCache.stop) {
+        g_tempCache.sweepRequested = false;
+        lock.unlock();
+        TempSweepOnce();
+        lock.lock();
+        g_tempCache.cv.wait_for(lock, std::chrono::milliseconds(kTempSweepPeriodMs),
+            [] { return g_tempCache.stop || g_tempCache.sweepRequested; });
     }
+}
 
-    case WM_COMMAND: {
-        switch (LOWORD(wParam)) {
-        case 2001: { // open capture folder
-            PreviewDropTopmost(hwnd);
-            if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
-            OpenPath(g_saveDir);
-            return 0;
-        }
-        case 2003: { // choose capture folder
-            PreviewDropTopmost(hwnd);
-            std::wstring picked;
-            std::wstring start = g_saveDir.empty() ? DefaultSaveDir() : g_saveDir;
-            if (PickFolder(hwnd, start, picked)) {
-                g_saveDir = picked;
-                EnsureDirectoryRecursive(g_saveDir + L"\\");
-                SaveSettings();
-                SetStatus(hwnd, L"Folder set");
-            }
-            else {
-                SetStatus(hwnd, L"Canceled");
-            }
-            return 0;
-        }
-        case 2002: { // toggle auto-dismiss
-            PreviewDropTopmost(hwnd);
-            g_autoDismissAfterSave = !g_autoDismissAfterSave;
-            SaveSettings();
-            return 0;
-        }
+// Start de sweeper bij de eerste aanroep (opstart), daarna: extra ronde aanvragen.
+static void TempSweepRequest() {
+    std::lock_guard<std::mutex> lock(g_tempCache.mu);
+    if (!g_tempCache.sweeper.joinable()) {
+        g_tempCache.stop = false;
+        g_tempCache.sweeper = std::thread(TempSweepThread);
+        return;
+    }
+    g_tempCache.sweepRequested = true;
+    g_tempCache.cv.notify_one();
+}
 
-        case 2010: g_saveFormat = SaveFormat::Png;  SaveSettings(); SetStatus(hwnd, L"Format: PNG");  return 0;
-        case 2011: g_saveFormat = SaveFormat::Jpeg; SaveSettings(); SetStatus(hwnd, L"Format: JPEG"); return 0;
-        case 2012: g_saveFormat = SaveFormat::Bmp;  SaveSettings(); SetStatus(hwnd, L"Format: BMP");  return 0;
+static void TempSweepStop() {
+    {
+        std::lock_guard<std::mutex> lock(g_tempCache.mu);
+        g_tempCache.stop = true;
+    }
+    g_tempCache.cv.notify_one();
+    if (g_tempCache.sweeper.joinable()) g_tempCache.sweeper.join();
+}
 
-        case 2102: { // choose program (en meteen openen)
-            PreviewDropTopmost(hwnd);
+// =========================================================
+// Speculatief pre-encoden (preview)
+// =========================================================
+// Zodra de preview staat, schrijft een idle-thread eerst het Edit-temp-bestand in de
+// temp-cache (goedkoop) en encodeert daarna een snapshot van de capture in het huidige
+// save-formaat (bytes in geheugen). Save schrijft daarna alleen nog bytes weg, Edit
+// vindt het bestand in de cache. Loopt de job nog bij een klik, dan wacht de UI erop (met
+// normale prioriteit) in plaats van opnieuw te beginnen.
+// De job is gedeeld (shared_ptr): annuleren = cancel zetten en loslaten; de thread
+// ruimt zijn eigen snapshot op. Resultaten gelden alleen bij dezelfde hash.
+struct PreEncodeJob {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::atomic<bool> cancel{ false };
+    bool editDone = false;
+    bool done = false;
+    HANDLE thread = nullptr;        // echte handle (prioriteit verhogen bij wachten)
+
+    uint64_t hash = 0;
+    bool hasAlpha = false;
+    SaveFormat requested = SaveFormat::Png;   // g_saveFormat bij de start (alpha -> PNG)
+    SaveFormat editFmt = SaveFormat::Bmp;
+    HBITMAP snapshot = nullptr;
+
+    // resultaat Save
+    bool saveOk = false;
+    SaveFormat actual = SaveFormat::Png;
+    AutoChoice autoChoice{};
+    bool indexed = false;
+    std::vector<uint8_t> bytes;
+    // resultaat Edit
+    bool editOk = false;
+    std::wstring editPath;
+
+    ~PreEncodeJob() {
+        if (snapshot) DeleteObject(snapshot);
+        if (thread) CloseHandle(thread);
+    }
+};
+static void PreEncodeThread(std::shared_ptr<PreEncodeJob> job) {
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+    const auto t0 = std::chrono::steady_clock::now();
+
+    // 1) Edit-temp in de cache (niet gepind: pas bij een echte Edit)
+    if (!job->cancel) {
+        std::wstring path;
+        const bool ok = TempEditFileForBitmap(job->snapshot, job->hash, true, job->editFmt, false, path, nullptr);
+        std::lock_guard<std::mutex> lock(job->mu);
+        job->editOk = ok;
+        job->editPath = path;
+    }
+    {
+        std::lock_guard<std::mutex> lock(job->mu);
+        job->editDone = true;
+    }
+    job->cv.notify_all();
+    const double editMs = MsSince(t0);
+
+    // 2) save-formaat (Auto: dezelfde keuze als de Save-knop zou maken)
+    if (!job->cancel) {
+        SaveFormat fmt = job->requested;
+        AutoChoice c{};
+        if (fmt == SaveFormat::Auto) {
+            c = ChooseAutoFormat(job->snapshot, job->hasAlpha);
+            fmt = c.fmt;
+        }
+        // zelfde parameters als SaveBitmapFile / SaveBitmapAuto -> byte-identiek bestand
+        const bool isAuto = (job->requested == SaveFormat::Auto);
+        const float quality = (isAuto && fmt == SaveFormat::Jpeg) ? c.jpegQuality : 0.92f;
+        const bool tryIndexed = isAuto && c.enc == AutoEncoding::PngIndexed;
+
+        bool indexed = false;
+        std::vector<uint8_t> bytes;
+        const bool ok = (fmt == SaveFormat::Bmp)
+            ? EncodeBitmapBmpToMemory(job->snapshot, bytes)
+            : EncodeBitmapWicToMemory(job->snapshot, fmt, bytes, quality, tryIndexed, &indexed);
+
+        std::lock_guard<std::mutex> lock(job->mu);
+        job->saveOk = ok && !job->cancel;
+        job->actual = fmt;
+        job->autoChoice = c;
+        job->indexed = indexed;
+        job->bytes = std::move(bytes);
+    }
+    DebugLog(L"pre-encode %016llx: edit %.1f ms, save %s %.1f ms%s", (unsigned long long)job->hash,
+        editMs, SaveFormatText(job->actual), MsSince(t0) - editMs, job->cancel ? L" (cancelled)" : L"");
 
-            std::wstring exe;
-            if (!PickExe(hwnd, exe)) {
-                SetStatus(hwnd, L"Canceled");
-                return 0;
-            }
+    {
+        std::lock_guard<std::mutex> lock(job->mu);
+        job->done = true;
+        if (job->snapshot) { DeleteObject(job->snapshot); job->snapshot = nullptr; }
+    }
+    job->cv.notify_all();
+}
 
-            g_editorExe = exe;
-            SaveSettings();
+// slot = de job van één capture-sessie (de sessie is de enige eigenaar).
+static void PreEncodeCancel(std::shared_ptr<PreEncodeJob>& slot) {
+    if (!slot) return;
+    slot->cancel = true;
+    slot.reset();
+}
 
-            // Direct dezelfde actie uitvoeren als "Open in (last program)"
-            SendMessageW(hwnd, WM_COMMAND, MAKEWPARAM(2101, 0), 0);
-            return 0;
-        }
-        case 2101: { // Open in (last program) - voorkeur: huidige capture
-            // 1) Zorg dat er een editor gekozen is
-            if (g_editorExe.empty()) {
-                std::wstring exe;
-                if (!PickExe(hwnd, exe)) { SetStatus(hwnd, L"Canceled"); return 0; }
-                g_editorExe = exe;
-                SaveSettings();
-            }
-            std::wstring target;
+// UI-thread: snapshot (memcpy van de DIB) + thread starten. Vorige job in slot vervalt.
+static void PreEncodeStart(std::shared_ptr<PreEncodeJob>& slot, HBITMAP bmp, uint64_t hash, bool hashValid, bool hasAlpha) {
+    PreEncodeCancel(slot);
+    if (!bmp || !hashValid) return;
 
-            // 2) Probeer eerst het HUIDIGE knipsel (preview) als temp-bestand
-            if (g_captureBmp) {
-                SaveFormat tmpFmt = g_captureHasAlpha ? SaveFormat::Png : SaveFormat::Bmp;
-
-                // Maak altijd een verse temp als:
-                // - er nog geen temp is
-                // - of alpha aanwezig is (dan wil je zeker PNG)
-                if (g_tempEditFile.empty() || g_captureHasAlpha) {
-                    std::wstring tempPath = MakeTempEditPath(tmpFmt);
-                    if (SaveBitmapFile(g_captureBmp, tempPath, tmpFmt)) {
-                        g_tempEditFile = tempPath;
-                    }
-                }
+    DIBSECTION ds{};
+    if (GetObjectW(bmp, sizeof(ds), &ds) == 0 || !ds.dsBm.bmBits) return;
+
+    auto job = std::make_shared<PreEncodeJob>();
+    job->hash = hash;
+    job->hasAlpha = hasAlpha;
+    job->requested = hasAlpha ? SaveFormat::Png : g_saveFormat;
+    job->editFmt = hasAlpha ? SaveFormat::Png : SaveFormat::Bmp;
 
-                target = g_tempEditFile;
+    const auto t0 = std::chrono::steady_clock::now();
+    GdiFlush();
+    job->snapshot = (HBITMAP)CopyImage(bmp, IMAGE_BITMAP, 0, 0, LR_CREATEDIBSECTION);
+    if (!job->snapshot) return;
+    DebugLog(L"pre-encode snapshot: %.2f ms", MsSince(t0));
+
+    try {
+        std::thread t([job] {
+            HANDLE self = nullptr;
+            DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &self, THREAD_SET_INFORMATION, FALSE, 0);
+            {
+                std::lock_guard<std::mutex> lock(job->mu);
+                job->thread = self;
             }
+            PreEncodeThread(job);
+            });
+        t.detach();
+    }
+    catch (...) {
+        return;
+    }
+    slot = std::move(job);
+}
 
-            // 3) Fallback: laatst opgeslagen bestand (als er geen capture/temp is)
-            if (target.empty()) target = g_lastSavedFile;
-            if (target.empty()) { SetStatus(hwnd, L"No file"); return 0; }
-            // 4) Open in editor
-            PreviewDropTopmost(hwnd); // als je die helper al gebruikt
-            if (OpenInEditor(g_editorExe, target)) SetStatus(hwnd, L"Opened");
-            else SetStatus(hwnd, L"Open failed");
+// Lopende of klare job voor deze capture? Wacht tot het gevraagde deel klaar is.
+// Save: alleen als de job hetzelfde formaat encodeert (anders is wachten verspilling).
+static std::shared_ptr<PreEncodeJob> PreEncodeWaitImpl(const std::shared_ptr<PreEncodeJob>& slot, uint64_t hash,
+    bool forSave, SaveFormat requested) {
+    std::shared_ptr<PreEncodeJob> job = slot;
+    if (!job || job->hash != hash) return nullptr;
+    if (forSave && job->requested != requested) return nullptr;
+
+    std::unique_lock<std::mutex> lock(job->mu);
+    auto ready = [&] { return forSave ? job->done : job->editDone; };
+    if (!ready()) {
+        if (job->thread) SetThreadPriority(job->thread, THREAD_PRIORITY_NORMAL);
+        const auto t0 = std::chrono::steady_clock::now();
+        job->cv.wait(lock, ready);
+        DebugLog(L"pre-encode: waited %.1f ms for running job (%s)", MsSince(t0), forSave ? L"save" : L"edit");
+    }
+    return job;
+}
 
-            return 0;
-        }
-        }
-        return 0;
+static std::shared_ptr<PreEncodeJob> PreEncodeWaitForSave(const std::shared_ptr<PreEncodeJob>& slot, uint64_t hash,
+    SaveFormat requested) {
+    return PreEncodeWaitImpl(slot, hash, true, requested);
+}
+
+static void PreEncodeWaitForEdit(const std::shared_ptr<PreEncodeJob>& slot, uint64_t hash) {
+    PreEncodeWaitImpl(slot, hash, false, SaveFormat::Png);
+}
+
+// =========================================================
+// Bestandsnamen: high-water mark + exclusief aanmaken
+// =========================================================
+// Per (map + prefix) de hoogste uitgegeven teller, bewaard in
+// <SettingsDir>\name-index.txt (<teller> <map\prefix>\r\n, UTF-16LE, klein: de
+// laatst gebruikte kNameHwmMax families). Onbekende familie: één keer de map
+// scannen met een prefix-patroon (NTFS zoekt dat in de directory-index).
+// Het bestand wordt daarna met CREATE_NEW gereserveerd: bestaat de naam al
+// (andere tool, tweede instance, klok teruggezet), dan gewoon de volgende.
+struct NameHwmEntry {
+    std::wstring key;   // lowercase "<map>\<prefix>"
+    int counter = 0;
+};
+
+struct NameEngineState {
+    std::vector<NameHwmEntry> hwm;            // laatst gebruikt achteraan
+    bool loaded = false;
+    std::vector<std::wstring> knownDirs;      // lowercase, bestaan zeker
+};
+static NameEngineState g_names;
+
+static constexpr size_t kNameHwmMax = 128;
+static constexpr int kNameMaxAttempts = 1000;
+
+static std::wstring NameHwmFile() {
+    return SettingsDir() + L"\\name-index.txt";
+}
+
+static std::wstring LowerPath(std::wstring s) {
+    for (wchar_t& c : s) c = (wchar_t)towlower(c);
+    return s;
+}
+
+static void NameHwmLoad() {
+    if (g_names.loaded) return;
+    g_names.loaded = true;
+
+    std::vector<uint8_t> raw;
+    if (!ReadWholeFile(NameHwmFile(), raw)) return;
+
+    const wchar_t* s = (const wchar_t*)raw.data();
+    const size_t n = raw.size() / sizeof(wchar_t);
+    size_t i = 0;
+    while (i < n) {
+        size_t end = i;
+        while (end < n && s[end] != L'\n') ++end;
+        std::wstring line(s + i, s + end);
+        if (!line.empty() && line.back() == L'\r') line.pop_back();
+        i = end + 1;
+
+        wchar_t* p = nullptr;
+        const long c = wcstol(line.c_str(), &p, 10);
+        if (!p || *p != L' ' || !p[1] || c < 0) continue;
+        g_names.hwm.push_back({ LowerPath(p + 1), (int)c });
     }
+}
 
-    case WM_PAINT: {
-        PAINTSTRUCT ps{};
-        HDC hdc = BeginPaint(hwnd, &ps);
+static void NameHwmWrite() {
+    std::wstring all;
+    for (const NameHwmEntry& e : g_names.hwm) all += std::to_wstring(e.counter) + L" " + e.key + L"\r\n";
 
-        RECT rc{};
-        GetClientRect(hwnd, &rc);
+    EnsureDirectoryRecursive(SettingsDir() + L"\\");
+    const std::wstring file = NameHwmFile();
+    const std::wstring tmp = file + L".tmp";
+    DeleteFileW(tmp.c_str());
+    if (!AppendToFile(tmp, all.data(), (DWORD)(all.size() * sizeof(wchar_t)))) return;
+    MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING);
+}
 
-        // background
-        HBRUSH bg = CreateSolidBrush(RGB(30, 30, 30));
-        FillRect(hdc, &rc, bg);
-        DeleteObject(bg);
+static int NameHwmGet(const std::wstring& key) {
+    NameHwmLoad();
+    for (const NameHwmEntry& e : g_names.hwm) if (e.key == key) return e.counter;
+    return -1;
+}
 
-        // draw image (scaled to fit)
-        if (g_captureBmp) {
-            HDC mem = CreateCompatibleDC(hdc);
-            HGDIOBJ old = SelectObject(mem, g_captureBmp);
+static void NameHwmSet(const std::wstring& key, int counter) {
+    auto it = std::find_if(g_names.hwm.begin(), g_names.hwm.end(), [&](const NameHwmEntry& e) { return e.key == key; });
+    if (it != g_names.hwm.end()) {
+        counter = std::max(counter, it->counter);
+        g_names.hwm.erase(it);
+    }
+    g_names.hwm.push_back({ key, counter });
+    if (g_names.hwm.size() > kNameHwmMax) g_names.hwm.erase(g_names.hwm.begin());
+    NameHwmWrite();
+}
 
-            BITMAP bm{};
-            GetObjectW(g_captureBmp, sizeof(bm), &bm);
+// Hoogste teller van "<filePrefix><n>.*" in dir (0 = geen).
+static int ScanNameCounter(const std::wstring& dir, const std::wstring& filePrefix) {
+    const auto t0 = std::chrono::steady_clock::now();
+    int best = 0;
+    size_t seen = 0;
+
+    WIN32_FIND_DATAW fd{};
+    HANDLE h = FindFirstFileExW((dir + L"\\" + filePrefix + L"*").c_str(), FindExInfoBasic, &fd,
+        FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (h != INVALID_HANDLE_VALUE) {
+        do {
+            ++seen;
+            const int c = ParseNameCounter(fd.cFileName, filePrefix.c_str(), filePrefix.size());
+            if (c > best) best = c;
+        } while (FindNextFileW(h, &fd));
+        FindClose(h);
+    }
+    DebugLog(L"name scan %s\\%s*: %zu files, max %d (%.2f ms)", dir.c_str(), filePrefix.c_str(), seen, best, MsSince(t0));
+    return best;
+}
 
-            int iw = bm.bmWidth;
-            int ih = bm.bmHeight;
-            int aw = g_rcImage.right - g_rcImage.left;
-            int ah = g_rcImage.bottom - g_rcImage.top;
+// mkdir -p, maar elke map maar één keer per sessie.
+static bool EnsureDirectoryCached(const std::wstring& dir) {
+    const std::wstring key = LowerPath(dir);
+    for (const std::wstring& d : g_names.knownDirs) if (d == key) return true;
 
-            double sx = (iw > 0) ? (double)aw / (double)iw : 1.0;
-            double sy = (ih > 0) ? (double)ah / (double)ih : 1.0;
-            double s = (sx < sy) ? sx : sy;
-            if (s > 1.0) s = 1.0;
+    EnsureDirectoryRecursive(dir + L"\\");
+    const DWORD attr = GetFileAttributesW(dir.c_str());
+    if (attr == INVALID_FILE_ATTRIBUTES || !(attr & FILE_ATTRIBUTE_DIRECTORY)) return false;
+    g_names.knownDirs.push_back(key);
+    return true;
+}
 
-            int dw = (int)(iw * s);
-            int dh = (int)(ih * s);
+static void ForgetDirectory(const std::wstring& dir) {
+    const std::wstring key = LowerPath(dir);
+    auto& v = g_names.knownDirs;
+    v.erase(std::remove(v.begin(), v.end(), key), v.end());
+}
 
-            int dx = g_rcImage.left + (aw - dw) / 2;
-            int dy = g_rcImage.top + (ah - dh) / 2;
+// Volgende vrije naam volgens g_namePreset in saveDir; het (lege) bestand bestaat
+// daarna al, zodat niemand anders die naam kan pakken. Mislukt de save: DeleteFileW.
+static bool ReserveSavePath(const std::wstring& saveDir, SaveFormat fmt, std::wstring& outPath) {
+    SYSTEMTIME st{};
+    GetLocalTime(&st);
 
-            if (g_captureHasAlpha) {
-                BLENDFUNCTION bf{};
-                bf.BlendOp = AC_SRC_OVER;
-                bf.SourceConstantAlpha = 255;
-                bf.AlphaFormat = AC_SRC_ALPHA;
+    const std::wstring prefix = NamePresetPrefix(g_namePreset, st.wYear, st.wMonth, st.wDay, ModeFileName(g_mode));
+    const size_t slash = prefix.find_last_of(L'\\');
+    const std::wstring filePrefix = (slash == std::wstring::npos) ? prefix : prefix.substr(slash + 1);
+
+    std::wstring dir = saveDir;
+    while (!dir.empty() && (dir.back() == L'\\' || dir.back() == L'/')) dir.pop_back();
+    if (slash != std::wstring::npos) dir += L"\\" + prefix.substr(0, slash);
+    if (!EnsureDirectoryCached(dir)) return false;
+
+    const std::wstring key = LowerPath(dir + L"\\" + filePrefix);
+    int last = NameHwmGet(key);
+    if (last < 0) last = ScanNameCounter(dir, filePrefix);
+
+    bool rescanned = false, remade = false;
+    for (int attempt = 0; attempt < kNameMaxAttempts; ++attempt) {
+        const int c = last + 1;
+        const std::wstring path = dir + L"\\" + NameWithCounter(filePrefix, c, SaveFormatExt(fmt));
+
+        HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h != INVALID_HANDLE_VALUE) {
+            CloseHandle(h);
+            NameHwmSet(key, c);
+            outPath = path;
+            return true;
+        }
 
-                AlphaBlend(hdc, dx, dy, dw, dh, mem, 0, 0, iw, ih, bf);
+        const DWORD err = GetLastError();
+        if (err == ERROR_FILE_EXISTS || err == ERROR_ALREADY_EXISTS) {
+            // een paar botsingen: iemand anders schrijft hier ook -> één keer echt kijken
+            if (attempt == 4 && !rescanned) {
+                rescanned = true;
+                last = std::max(c, ScanNameCounter(dir, filePrefix));
             }
             else {
-                SetStretchBltMode(hdc, HALFTONE);
-                StretchBlt(hdc, dx, dy, dw, dh, mem, 0, 0, iw, ih, SRCCOPY);
+                last = c;
             }
-
-            SelectObject(mem, old);
-            DeleteDC(mem);
-
-            // border
-            HPEN pen = CreatePen(PS_SOLID, 1, RGB(70, 70, 70));
-            HGDIOBJ oldPen = SelectObject(hdc, pen);
-            HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
-            Rectangle(hdc, g_rcImage.left, g_rcImage.top, g_rcImage.right, g_rcImage.bottom);
-            SelectObject(hdc, oldBrush);
-            SelectObject(hdc, oldPen);
-            DeleteObject(pen);
+            continue;
         }
+        if (err == ERROR_PATH_NOT_FOUND && !remade) {
+            // map is intussen weg (verwijderd/verplaatst): opnieuw aanmaken
+            remade = true;
+            ForgetDirectory(dir);
+            if (!EnsureDirectoryCached(dir)) return false;
+            continue;
+        }
+        return false;
+    }
+    return false;
+}
 
-        auto drawBtn = [&](const RECT& r, const wchar_t* text) {
-            HBRUSH b = CreateSolidBrush(RGB(50, 50, 50));
-            FillRect(hdc, &r, b);
-            DeleteObject(b);
-
-            HPEN pen = CreatePen(PS_SOLID, 1, RGB(90, 90, 90));
-            HGDIOBJ oldPen = SelectObject(hdc, pen);
-            HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
-            Rectangle(hdc, r.left, r.top, r.right, r.bottom);
-            SelectObject(hdc, oldBrush);
-            SelectObject(hdc, oldPen);
-            DeleteObject(pen);
+static std::vector<POINT> LassoSmoothClosed_Chaikin(std::vector<POINT> pts, int iterations)
+{
+    if (pts.size() < 3 || iterations <= 0) return pts;
 
-            SetBkMode(hdc, TRANSPARENT);
-            SetTextColor(hdc, RGB(240, 240, 240));
-            RECT t = r;
-            DrawTextW(hdc, text, -1, &t, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
-            };
+    // verwijder dubbele opeenvolgende punten
+    {
+        std::vector<POINT> clean;
+        clean.reserve(pts.size());
+        for (auto p : pts) {
+            if (clean.empty() || p.x != clean.back().x || p.y != clean.back().y) clean.push_back(p);
+        }
+        pts.swap(clean);
+    }
+    if (pts.size() < 3) return pts;
 
-        drawBtn(g_btnSave, L"Save");
-        drawBtn(g_btnEdit, L"Edit");
-        drawBtn(g_btnDismiss, L"Dismiss");
+    for (int it = 0; it < iterations; ++it) {
+        // rem: voorkom explosie
+        if (pts.size() > 4096) break;
 
-        // statusbar
-        {
-            RECT sb = g_rcStatus;
+        std::vector<POINT> out;
+        out.reserve(pts.size() * 2);
 
-            // achtergrond
-            HBRUSH b = CreateSolidBrush(RGB(45, 45, 45));
-            FillRect(hdc, &sb, b);
-            DeleteObject(b);
+        const int n = (int)pts.size();
+        for (int i = 0; i < n; ++i) {
+            const POINT p0 = pts[i];
+            const POINT p1 = pts[(i + 1) % n];
 
-            // scheidingslijn boven statusbar
-            HPEN pen = CreatePen(PS_SOLID, 1, RGB(70, 70, 70));
-            HGDIOBJ oldPen = SelectObject(hdc, pen);
-            MoveToEx(hdc, sb.left, sb.top, nullptr);
-            LineTo(hdc, sb.right, sb.top);
-            SelectObject(hdc, oldPen);
-            DeleteObject(pen);
+            // Q = 0.75 p0 + 0.25 p1
+            POINT q{ (3 * p0.x + p1.x) / 4, (3 * p0.y + p1.y) / 4 };
+            // R = 0.25 p0 + 0.75 p1
+            POINT r{ (p0.x + 3 * p1.x) / 4, (p0.y + 3 * p1.y) / 4 };
 
-            // icoon links
-            int iw = GetSystemMetrics(SM_CXSMICON);
-            int ih = GetSystemMetrics(SM_CYSMICON);
-            int ix = sb.left + 8;
-            int iy = sb.top + (sb.bottom - sb.top - ih) / 2;
+            out.push_back(q);
+            out.push_back(r);
+        }
 
-            HICON hi = AppIconSmall(); // bestaat al bij jou
-            if (hi) DrawIconEx(hdc, ix, iy, hi, iw, ih, 0, nullptr, DI_NORMAL);
+        pts.swap(out);
+    }
 
-            // tekst
-            std::wstring txt = g_statusText.empty() ? L"Ready" : g_statusText;
+    return pts;
+}
 
-            RECT tr = sb;
-            tr.left = ix + iw + 8;
-            tr.right -= 8;
+static bool OpenInEditor(const std::wstring& editorExe, const std::wstring& filePath) {
+    if (editorExe.empty() || filePath.empty()) return false;
 
-            SetBkMode(hdc, TRANSPARENT);
-            SetTextColor(hdc, RGB(210, 210, 210));
-            DrawTextW(hdc, txt.c_str(), -1, &tr, DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS);
-        }
+    SHELLEXECUTEINFOW sei{};
+    sei.cbSize = sizeof(sei);
+    sei.fMask = SEE_MASK_NOASYNC;
+    sei.lpVerb = L"open";
+    sei.lpFile = editorExe.c_str();
 
-        EndPaint(hwnd, &ps);
-        return 0;
-    }
+    std::wstring params = L"\"" + filePath + L"\"";
+    sei.lpParameters = params.c_str();
+    sei.nShow = SW_SHOWNORMAL;
 
-    case WM_DESTROY:
-        return 0;
-    }
+    return ShellExecuteExW(&sei) != FALSE;
+}
 
-    return DefWindowProcW(hwnd, msg, wParam, lParam);
+static void OpenPath(const std::wstring& path) {
+    if (path.empty()) return;
+    ShellExecuteW(nullptr, L"open", path.c_str(), nullptr, nullptr, SW_SHOWNORMAL);
 }
 
 // =========================================================
-// Preview creation
+// Menus
 // =========================================================
-static void CreatePreviewWindow() {
-    if (g_hwndPreview) return;
+static void ShowModeMenu(HWND hwndOwner) {
+    HMENU menu = CreatePopupMenu();
+    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Region ? MF_CHECKED : 0), 1001, L"Region");
+    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Window ? MF_CHECKED : 0), 1002, L"Window");
+    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Monitor ? MF_CHECKED : 0), 1003, L"Monitor");
+    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Freestyle ? MF_CHECKED : 0), 1004, L"Freestyle (Lasso)");
+    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Polygon ? MF_CHECKED : 0), 1005, L"Polygon");
+    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Burst ? MF_CHECKED : 0), 1006, L"Burst (interval)");
+    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Record ? MF_CHECKED : 0), 1007, L"Record (APNG)");
+    AppendMenuW(menu, MF_STRING | (g_mode == Mode::Scroll ? MF_CHECKED : 0), 1008, L"Scrolling window");
 
-    static bool registered = false;
-    if (!registered) {
-        WNDCLASSW wc{};
-        wc.lpfnWndProc = PreviewProc;
-        wc.hInstance = g_hInst;
-        wc.lpszClassName = L"SnipLitePreview";
-        wc.hCursor = LoadCursorW(nullptr, IDC_ARROW);
-        RegisterClassW(&wc);
-        registered = true;
-    }
+    POINT pt{};
+    GetCursorPos(&pt);
+    TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_NOANIMATION, pt.x, pt.y, 0, hwndOwner, nullptr);
+    DestroyMenu(menu);
+}
 
-    RECT wa{};
-    SystemParametersInfoW(SPI_GETWORKAREA, 0, &wa, 0);
+static void ShowSaveMenu(HWND hwnd) {
+    HMENU menu = CreatePopupMenu();
+    AppendMenuW(menu, MF_STRING, 2001, L"Open capture folder");
+    AppendMenuW(menu, MF_STRING, 2003, L"Choose capture folder...");
 
-    int maxW = (int)((wa.right - wa.left) * 0.70);
-    int maxH = (int)((wa.bottom - wa.top) * 0.70);
+    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
 
-    int w = (g_captureW > 0) ? g_captureW : 600;
-    int h = (g_captureH > 0) ? g_captureH : 400;
+    HMENU fmt = CreatePopupMenu();
+    AppendMenuW(fmt, MF_STRING | (g_saveFormat == SaveFormat::Png ? MF_CHECKED : 0), 2010, L"PNG");
+    AppendMenuW(fmt, MF_STRING | (g_saveFormat == SaveFormat::Jpeg ? MF_CHECKED : 0), 2011, L"JPEG");
+    AppendMenuW(fmt, MF_STRING | (g_saveFormat == SaveFormat::Bmp ? MF_CHECKED : 0), 2012, L"BMP");
+    AppendMenuW(fmt, MF_STRING | (g_saveFormat == SaveFormat::Auto ? MF_CHECKED : 0), 2013, L"Auto (by content)");
+    AppendMenuW(menu, MF_POPUP, (UINT_PTR)fmt, L"Save format");
 
-    int winW = w + 24;
-    int winH = h + 24 + 52;
+    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    AppendMenuW(menu, MF_STRING | (g_autoDismissAfterSave ? MF_CHECKED : 0), 2002, L"Auto-dismiss after Save");
 
-    double sx = (winW > 0) ? (double)maxW / (double)winW : 1.0;
-    double sy = (winH > 0) ? (double)maxH / (double)winH : 1.0;
-    double s = (sx < sy) ? sx : sy;
-    if (s > 1.0) s = 1.0;
+    POINT pt{};
+    GetCursorPos(&pt);
+    TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_NOANIMATION, pt.x, pt.y, 0, hwnd, nullptr);
+    DestroyMenu(menu);
+}
 
-    winW = (int)(winW * s);
-    winH = (int)(winH * s);
+static void ShowEditMenu(HWND hwnd) {
+    HMENU menu = CreatePopupMenu();
+    AppendMenuW(menu, MF_STRING, 2101, L"Open in (last program)");
+    AppendMenuW(menu, MF_STRING, 2102, L"Choose program...");
 
-    int x = wa.left + ((wa.right - wa.left) - winW) / 2;
-    int y = wa.top + ((wa.bottom - wa.top) - winH) / 2;
-
-    // restore vorige positie/grootte (als aanwezig)
-    int rx = IniReadInt(L"Preview", L"X", x);
-    int ry = IniReadInt(L"Preview", L"Y", y);
-    int rw = IniReadInt(L"Preview", L"W", winW);
-    int rh = IniReadInt(L"Preview", L"H", winH);
-
-    if (rw < 300) rw = winW;
-    if (rh < 200) rh = winH;
-
-    g_hwndPreview = CreateWindowExW(
-        WS_EX_TOPMOST | WS_EX_TOOLWINDOW,
-        L"SnipLitePreview",
-        L"",
-        WS_POPUP,
-        rx, ry, rw, rh,
-        nullptr, nullptr, g_hInst, nullptr
-    );
-
-    if (!g_hwndPreview) {
-        MessageBeep(MB_ICONERROR);
-        return;
-    }
-
-    HICON hBig = AppIconBig();
-    HICON hSmall = AppIconSmall();
-    if (hBig)   SendMessageW(g_hwndPreview, WM_SETICON, ICON_BIG, (LPARAM)hBig);
-    if (hSmall) SendMessageW(g_hwndPreview, WM_SETICON, ICON_SMALL, (LPARAM)hSmall);
-
-    ShowWindow(g_hwndPreview, SW_SHOW);
-    SetForegroundWindow(g_hwndPreview);
-    SetFocus(g_hwndPreview);
+    POINT pt{};
+    GetCursorPos(&pt);
+    TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_NOANIMATION, pt.x, pt.y, 0, hwnd, nullptr);
+    DestroyMenu(menu);
 }
 
+#endif // !SNIP_CORE_ONLY
+
 // =========================================================
-// Overlay
+// Annotaties: scene + rasterizer (portable, geen Win32)
 // =========================================================
-static RECT CursorDirtyRect(POINT p) {
-    const int L = 14;     // lengte van crosshair
-    const int pad = 6;    // extra marge voor dikke lijn
-    RECT rc{ p.x - L - pad, p.y - L - pad, p.x + L + pad + 1, p.y + L + pad + 1 };
-    return rc;
+// Vector-shapes in een lijst (volgorde = tekenvolgorde). De capture zelf is het
+// composiet: bij een wijziging wordt alleen de beschadigde rechthoek uit de
+// originele pixels (base) teruggezet en opnieuw beschilderd met de shapes die
+// hem raken. Buffers zijn top-down views met een (eventueel negatieve) stride,
+// zodat een bottom-up DIB zonder kopie gebruikt kan worden.
+struct PixRect {
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0; // [x0,x1) x [y0,y1)
+    int Width() const { return x1 - x0; }
+    int Height() const { return y1 - y0; }
+    bool Empty() const { return x1 <= x0 || y1 <= y0; }
+};
+
+static PixRect PixRectUnion(const PixRect& a, const PixRect& b) {
+    if (a.Empty()) return b;
+    if (b.Empty()) return a;
+    return { std::min(a.x0, b.x0), std::min(a.y0, b.y0), std::max(a.x1, b.x1), std::max(a.y1, b.y1) };
 }
 
-static void DrawOutlinedCrosshair(HDC hdc, int x, int y)
-{
-    const int L = 14;
-
-    // zwarte "rand" (dikker)
-    HPEN penB = CreatePen(PS_SOLID, 3, RGB(0, 0, 0));
-    HGDIOBJ oldPen = SelectObject(hdc, penB);
-
-    MoveToEx(hdc, x - L, y, nullptr); LineTo(hdc, x + L + 1, y);
-    MoveToEx(hdc, x, y - L, nullptr); LineTo(hdc, x, y + L + 1);
+static PixRect PixRectIntersect(const PixRect& a, const PixRect& b) {
+    PixRect r{ std::max(a.x0, b.x0), std::max(a.y0, b.y0), std::min(a.x1, b.x1), std::min(a.y1, b.y1) };
+    if (r.Empty()) r = PixRect{};
+    return r;
+}
 
-    // witte kern (dun)
-    HPEN penW = CreatePen(PS_SOLID, 1, RGB(255, 255, 255));
-    SelectObject(hdc, penW);
+enum class AnnotKind { Arrow, Box, Highlight };
 
-    MoveToEx(hdc, x - L, y, nullptr); LineTo(hdc, x + L + 1, y);
-    MoveToEx(hdc, x, y - L, nullptr); LineTo(hdc, x, y + L + 1);
+struct AnnotShape {
+    AnnotKind kind = AnnotKind::Arrow;
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;    // Arrow: staart -> punt; Box/Highlight: hoeken
+    uint32_t color = 0xFFE53935u;           // 0xAARRGGBB
+    int thickness = 4;
+};
 
-    // klein centrum-puntje (extra zichtbaar)
-    SetPixel(hdc, x, y, RGB(255, 255, 255));
+struct AnnotScene {
+    std::vector<AnnotShape> shapes;
+};
 
-    SelectObject(hdc, oldPen);
-    DeleteObject(penB);
-    DeleteObject(penW);
+static int AnnotHeadLen(const AnnotShape& s) {
+    return std::max(10, s.thickness * 4);
 }
 
-static void LassoReset() {
-    g_lassoSelecting = false;
-    g_lassoPtsClient.clear();
-    ZeroMemory(&g_lassoBoundsClient, sizeof(g_lassoBoundsClient));
+// Alles wat de shape kan raken (incl. anti-aliasing en pijlpunt).
+static PixRect AnnotBounds(const AnnotShape& s) {
+    int pad = 0;
+    switch (s.kind) {
+    case AnnotKind::Arrow:     pad = AnnotHeadLen(s) + s.thickness + 2; break;
+    case AnnotKind::Box:       pad = s.thickness + 1; break;
+    case AnnotKind::Highlight: pad = 0; break;
+    }
+    return { std::min(s.x0, s.x1) - pad, std::min(s.y0, s.y1) - pad,
+             std::max(s.x0, s.x1) + pad + 1, std::max(s.y0, s.y1) + pad + 1 };
 }
-static bool IsShiftDown() {
-    return (GetKeyState(VK_SHIFT) & 0x8000) != 0;
+
+// cov 0..256
+static inline void AnnotBlendPx(uint8_t* p, uint32_t argb, int cov) {
+    if (cov <= 0) return;
+    if (cov > 256) cov = 256;
+    const int inv = 256 - cov;
+    p[0] = (uint8_t)((p[0] * inv + (int)(argb & 0xFF) * cov) >> 8);
+    p[1] = (uint8_t)((p[1] * inv + (int)((argb >> 8) & 0xFF) * cov) >> 8);
+    p[2] = (uint8_t)((p[2] * inv + (int)((argb >> 16) & 0xFF) * cov) >> 8);
+    p[3] = (uint8_t)((p[3] * inv + 255 * cov) >> 8);
 }
 
-static bool NearPoint(POINT a, POINT b, int rPx) {
-    int dx = a.x - b.x;
-    int dy = a.y - b.y;
-    return (dx * dx + dy * dy) <= (rPx * rPx);
+static void AnnotFillRect(uint8_t* dst, ptrdiff_t stride, const PixRect& r, const PixRect& clip, uint32_t argb) {
+    const PixRect c = PixRectIntersect(r, clip);
+    for (int y = c.y0; y < c.y1; ++y) {
+        uint8_t* row = dst + (ptrdiff_t)y * stride;
+        for (int x = c.x0; x < c.x1; ++x) AnnotBlendPx(row + (size_t)x * 4, argb, 256);
+    }
 }
 
-static POINT SnapPoint45(POINT origin, POINT raw) {
-    const double dx = (double)raw.x - (double)origin.x;
-    const double dy = (double)raw.y - (double)origin.y;
+// Dikke lijn A->B (anti-aliased via afstand tot het segment). Per rij alleen het
+// x-bereik waar het segment in de buurt komt.
+static void AnnotStrokeSegment(uint8_t* dst, ptrdiff_t stride, const PixRect& clip,
+    float ax, float ay, float bx, float by, float halfW, uint32_t argb) {
+    const float dx = bx - ax, dy = by - ay;
+    const float len2 = dx * dx + dy * dy;
+    const float reach = halfW + 1.0f;
+
+    const int yMin = std::max(clip.y0, (int)std::floor(std::min(ay, by) - reach));
+    const int yMax = std::min(clip.y1 - 1, (int)std::ceil(std::max(ay, by) + reach));
+
+    for (int y = yMin; y <= yMax; ++y) {
+        const float py = y + 0.5f;
+
+        // t-bereik waarvoor het segment binnen 'reach' van deze rij ligt
+        float xa, xb;
+        if (std::fabs(dy) > 1e-3f) {
+            float t0 = (py - reach - ay) / dy, t1 = (py + reach - ay) / dy;
+            if (t0 > t1) std::swap(t0, t1);
+            t0 = std::clamp(t0, 0.0f, 1.0f);
+            t1 = std::clamp(t1, 0.0f, 1.0f);
+            xa = std::min(ax + dx * t0, ax + dx * t1) - reach;
+            xb = std::max(ax + dx * t0, ax + dx * t1) + reach;
+        }
+        else {
+            xa = std::min(ax, bx) - reach;
+            xb = std::max(ax, bx) + reach;
+        }
+        const int x0 = std::max(clip.x0, (int)std::floor(xa));
+        const int x1 = std::min(clip.x1 - 1, (int)std::ceil(xb));
+
+        uint8_t* row = dst + (ptrdiff_t)y * stride;
+        for (int x = x0; x <= x1; ++x) {
+            const float px = x + 0.5f;
+            float t = (len2 > 0.0f) ? ((px - ax) * dx + (py - ay) * dy) / len2 : 0.0f;
+            t = std::clamp(t, 0.0f, 1.0f);
+            const float ex = px - (ax + dx * t), ey = py - (ay + dy * t);
+            const float d = std::sqrt(ex * ex + ey * ey);
+            const int cov = (int)((halfW + 0.5f - d) * 256.0f);
+            AnnotBlendPx(row + (size_t)x * 4, argb, cov);
+        }
+    }
+}
 
-    const double len = std::sqrt(dx * dx + dy * dy);
-    if (len < 1.0) return raw;
+static void AnnotFillTriangle(uint8_t* dst, ptrdiff_t stride, const PixRect& clip,
+    const float (&vx)[3], const float (&vy)[3], uint32_t argb) {
+    // rand-functies genormaliseerd -> waarde = afstand tot de rand (AA over 1 px)
+    float ex[3], ey[3], ec[3];
+    const float area = (vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]);
+    const float sign = (area < 0.0f) ? -1.0f : 1.0f;
+    for (int i = 0; i < 3; ++i) {
+        const int j = (i + 1) % 3;
+        const float nx = -(vy[j] - vy[i]) * sign, ny = (vx[j] - vx[i]) * sign;
+        const float n = std::sqrt(nx * nx + ny * ny);
+        ex[i] = (n > 0.0f) ? nx / n : 0.0f;
+        ey[i] = (n > 0.0f) ? ny / n : 0.0f;
+        ec[i] = -(ex[i] * vx[i] + ey[i] * vy[i]);
+    }
 
-    const double ang = std::atan2(dy, dx);
-    const double PI = 3.14159265358979323846;
-    const double step = PI / 4.0; // 45 graden
+    const PixRect bb{ (int)std::floor(std::min({ vx[0], vx[1], vx[2] })) - 1, (int)std::floor(std::min({ vy[0], vy[1], vy[2] })) - 1,
+                      (int)std::ceil(std::max({ vx[0], vx[1], vx[2] })) + 2, (int)std::ceil(std::max({ vy[0], vy[1], vy[2] })) + 2 };
+    const PixRect c = PixRectIntersect(bb, clip);
+    for (int y = c.y0; y < c.y1; ++y) {
+        uint8_t* row = dst + (ptrdiff_t)y * stride;
+        const float py = y + 0.5f;
+        for (int x = c.x0; x < c.x1; ++x) {
+            const float px = x + 0.5f;
+            float m = 1.0f;
+            for (int i = 0; i < 3; ++i) m = std::min(m, ex[i] * px + ey[i] * py + ec[i] + 0.5f);
+            AnnotBlendPx(row + (size_t)x * 4, argb, (int)(m * 256.0f));
+        }
+    }
+}
 
-    const double snapped = std::round(ang / step) * step;
+static void AnnotRasterize(const AnnotShape& s, uint8_t* dst, ptrdiff_t stride, const PixRect& clip) {
+    switch (s.kind) {
+    case AnnotKind::Box: {
+        const int t = s.thickness;
+        const PixRect r{ std::min(s.x0, s.x1), std::min(s.y0, s.y1), std::max(s.x0, s.x1) + 1, std::max(s.y0, s.y1) + 1 };
+        // rand valt half buiten, half binnen de rechthoek
+        const int o = t / 2;
+        AnnotFillRect(dst, stride, { r.x0 - o, r.y0 - o, r.x1 + o, r.y0 - o + t }, clip, s.color);
+        AnnotFillRect(dst, stride, { r.x0 - o, r.y1 + o - t, r.x1 + o, r.y1 + o }, clip, s.color);
+        AnnotFillRect(dst, stride, { r.x0 - o, r.y0 - o + t, r.x0 - o + t, r.y1 + o - t }, clip, s.color);
+        AnnotFillRect(dst, stride, { r.x1 + o - t, r.y0 - o + t, r.x1 + o, r.y1 + o - t }, clip, s.color);
+        break;
+    }
+    case AnnotKind::Highlight: {
+        // markeerstift: vermenigvuldigen (tekst blijft leesbaar)
+        const PixRect r{ std::min(s.x0, s.x1), std::min(s.y0, s.y1), std::max(s.x0, s.x1) + 1, std::max(s.y0, s.y1) + 1 };
+        const PixRect c = PixRectIntersect(r, clip);
+        const int cb = (int)(s.color & 0xFF), cg = (int)((s.color >> 8) & 0xFF), cr = (int)((s.color >> 16) & 0xFF);
+        for (int y = c.y0; y < c.y1; ++y) {
+            uint8_t* row = dst + (ptrdiff_t)y * stride;
+            for (int x = c.x0; x < c.x1; ++x) {
+                uint8_t* p = row + (size_t)x * 4;
+                p[0] = (uint8_t)(p[0] * cb / 255);
+                p[1] = (uint8_t)(p[1] * cg / 255);
+                p[2] = (uint8_t)(p[2] * cr / 255);
+            }
+        }
+        break;
+    }
+    case AnnotKind::Arrow: {
+        const float ax = s.x0 + 0.5f, ay = s.y0 + 0.5f, bx = s.x1 + 0.5f, by = s.y1 + 0.5f;
+        const float dx = bx - ax, dy = by - ay;
+        const float len = std::sqrt(dx * dx + dy * dy);
+        const float halfW = s.thickness * 0.5f;
+        if (len < 1.0f) {
+            AnnotStrokeSegment(dst, stride, clip, ax, ay, bx, by, halfW, s.color);
+            break;
+        }
+        const float ux = dx / len, uy = dy / len;
+        const float head = std::min((float)AnnotHeadLen(s), len);
+        const float headW = head * 0.5f;
+        // schacht stopt onder de punt, anders steekt hij erdoor (AA-randen)
+        const float sx = bx - ux * head * 0.8f, sy = by - uy * head * 0.8f;
+        AnnotStrokeSegment(dst, stride, clip, ax, ay, sx, sy, halfW, s.color);
+
+        const float hx = bx - ux * head, hy = by - uy * head;
+        const float vx[3] = { bx, hx - uy * headW, hx + uy * headW };
+        const float vy[3] = { by, hy + ux * headW, hy - ux * headW };
+        AnnotFillTriangle(dst, stride, clip, vx, vy, s.color);
+        break;
+    }
+    }
+}
 
-    const double nx = std::cos(snapped) * len;
-    const double ny = std::sin(snapped) * len;
+// damage: base -> dst terugzetten en alle shapes die het raken opnieuw tekenen.
+static void AnnotRecomposite(const AnnotScene& scene, const uint8_t* base, ptrdiff_t baseStride,
+    uint8_t* dst, ptrdiff_t dstStride, int w, int h, const PixRect& damage) {
+    const PixRect d = PixRectIntersect(damage, PixRect{ 0, 0, w, h });
+    if (d.Empty()) return;
 
-    POINT out{
-        origin.x + (int)std::lround(nx),
-        origin.y + (int)std::lround(ny)
-    };
-    return out;
+    for (int y = d.y0; y < d.y1; ++y) {
+        std::memcpy(dst + (ptrdiff_t)y * dstStride + (size_t)d.x0 * 4,
+            base + (ptrdiff_t)y * baseStride + (size_t)d.x0 * 4, (size_t)d.Width() * 4);
+    }
+    for (const AnnotShape& s : scene.shapes) {
+        if (!PixRectIntersect(AnnotBounds(s), d).Empty()) AnnotRasterize(s, dst, dstStride, d);
+    }
 }
 
-static void PolyReset() {
-    g_polySelecting = false;
-    g_polyPtsClient.clear();
-    ZeroMemory(&g_polyBoundsClient, sizeof(g_polyBoundsClient));
-    g_polyHoverValid = false;
-    g_polyHoverClient = { 0,0 };
+// Bovenste shape onder (x,y) (op de bounding box), -1 = geen.
+static int AnnotHitTest(const AnnotScene& scene, int x, int y) {
+    for (int i = (int)scene.shapes.size() - 1; i >= 0; --i) {
+        const PixRect b = AnnotBounds(scene.shapes[(size_t)i]);
+        if (x >= b.x0 && x < b.x1 && y >= b.y0 && y < b.y1) return i;
+    }
+    return -1;
 }
 
-static void PolyRecalcBounds() {
-    if (g_polyPtsClient.empty()) {
-        ZeroMemory(&g_polyBoundsClient, sizeof(g_polyBoundsClient));
-        return;
+// =========================================================
+// Redactie: pixelate + blur (portable, geen Win32)
+// =========================================================
+// Werkt in-place op een rechthoek van een BGRA-buffer (top-down view, signed
+// stride). Alleen pixels binnen de rechthoek worden gelezen: randen worden
+// geklemd op de rechthoek zelf, zodat er niets van buitenaf "terugloopt".
+// Rijbanden worden over threads verdeeld; per pixel SSE2 (4 kanalen tegelijk).
+
+// fn(begin, end) over [0, count) in banden van minstens minPerBand.
+template <class Fn>
+static void ParallelForBands(int count, int minPerBand, Fn&& fn) {
+    const int hw = (int)std::max(1u, std::thread::hardware_concurrency());
+    const int bands = std::clamp(count / std::max(1, minPerBand), 1, hw);
+    if (bands <= 1) { fn(0, count); return; }
+
+    std::vector<std::thread> workers;
+    workers.reserve((size_t)bands - 1);
+    for (int b = 1; b < bands; ++b) {
+        const int b0 = (int)((long long)count * b / bands), b1 = (int)((long long)count * (b + 1) / bands);
+        workers.emplace_back([&fn, b0, b1] { fn(b0, b1); });
     }
-    int minx = g_polyPtsClient[0].x, maxx = g_polyPtsClient[0].x;
-    int miny = g_polyPtsClient[0].y, maxy = g_polyPtsClient[0].y;
+    fn(0, (int)((long long)count / bands));
+    for (std::thread& t : workers) t.join();
+}
 
-    for (auto p : g_polyPtsClient) {
-        if (p.x < minx) minx = p.x;
-        if (p.x > maxx) maxx = p.x;
-        if (p.y < miny) miny = p.y;
-        if (p.y > maxy) maxy = p.y;
+static constexpr int kRedactMinRows = 32; // per band; kleiner loont het starten van een thread niet
+
+// Afgerond BGRA-gemiddelde (als één pixel) van rows rijen vanaf px, kolommen [x0, x1).
+static uint32_t PixelateBlockAvg(const uint8_t* px, ptrdiff_t stride, int x0, int x1, int rows) {
+    uint32_t sum[4] = {};
+#if SNIP_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc32 = _mm_setzero_si128();
+    for (int y = 0; y < rows; ++y) {
+        const uint8_t* row = px + (ptrdiff_t)y * stride + (size_t)x0 * 4;
+        // 16-bit lanes: max 64 loads * 2 px * 255 per rij -> geen overflow
+        __m128i acc16 = _mm_setzero_si128();
+        int x = x0;
+        for (; x + 4 <= x1; x += 4, row += 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)row);
+            acc16 = _mm_add_epi16(acc16, _mm_add_epi16(_mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero)));
+        }
+        // px0+px2 en px1+px3 staan in de twee helften -> samenvoegen
+        acc16 = _mm_add_epi16(acc16, _mm_srli_si128(acc16, 8));
+        acc32 = _mm_add_epi32(acc32, _mm_unpacklo_epi16(acc16, zero));
+        for (; x < x1; ++x, row += 4) {
+            sum[0] += row[0]; sum[1] += row[1]; sum[2] += row[2]; sum[3] += row[3];
+        }
     }
-    g_polyBoundsClient = { minx, miny, maxx + 1, maxy + 1 };
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128((__m128i*)lanes, acc32);
+    for (int c = 0; c < 4; ++c) sum[c] += lanes[c];
+#else
+    for (int y = 0; y < rows; ++y) {
+        const uint8_t* row = px + (ptrdiff_t)y * stride + (size_t)x0 * 4;
+        for (int x = x0; x < x1; ++x, row += 4) {
+            sum[0] += row[0]; sum[1] += row[1]; sum[2] += row[2]; sum[3] += row[3];
+        }
+    }
+#endif
+    const uint32_t n = (uint32_t)((x1 - x0) * rows);
+    uint32_t avg = 0;
+    for (int c = 0; c < 4; ++c) avg |= ((sum[c] + n / 2) / n) << (8 * c);
+    return avg;
 }
 
-static void PolyAddPoint(POINT p) {
-    if (!g_polyPtsClient.empty()) {
-        POINT last = g_polyPtsClient.back();
-        if (last.x == p.x && last.y == p.y) return;
-    }
-    g_polyPtsClient.push_back(p);
+// Gemiddelde per blok (uitgelijnd op de linkerbovenhoek van r), daarna het hele blok vullen.
+static void PixelateRect(uint8_t* px, ptrdiff_t stride, int w, int h, const PixRect& rIn, int block) {
+    const PixRect r = PixRectIntersect(rIn, PixRect{ 0, 0, w, h });
+    if (r.Empty() || block < 2) return;
+    block = std::min(block, 256);
+    const int blockRows = (r.Height() + block - 1) / block;
+
+    ParallelForBands(blockRows, std::max(1, kRedactMinRows / block), [&](int br0, int br1) {
+        for (int br = br0; br < br1; ++br) {
+            const int y0 = r.y0 + br * block, y1 = std::min(r.y1, y0 + block);
+            for (int x0 = r.x0; x0 < r.x1; x0 += block) {
+                const int x1 = std::min(r.x1, x0 + block);
+                const uint32_t avg = PixelateBlockAvg(px + (ptrdiff_t)y0 * stride, stride, x0, x1, y1 - y0);
+                for (int y = y0; y < y1; ++y) {
+                    uint32_t* row = (uint32_t*)(px + (ptrdiff_t)y * stride) + x0;
+                    for (int x = 0; x < x1 - x0; ++x) row[x] = avg;
+                }
+            }
+        }
+        });
+}
 
-    if (g_polyPtsClient.size() == 1) {
-        g_polyBoundsClient = { p.x, p.y, p.x + 1, p.y + 1 };
+// Horizontale box-pass (straal r) over één rij van n pixels: src -> dst.
+// Sliding sum, randen geklemd: O(n) ongeacht r.
+static void BoxRow(const uint8_t* src, uint8_t* dst, int n, int r) {
+    const float inv = 1.0f / (float)(2 * r + 1);
+    const uint8_t* last = src + (size_t)(n - 1) * 4;
+#if SNIP_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vinv = _mm_set1_ps(inv);
+    auto load = [&](const uint8_t* p) {
+        return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)p), zero), zero);
+        };
+    __m128i acc = _mm_setzero_si128();
+    for (int i = -r; i <= r; ++i) acc = _mm_add_epi32(acc, load(src + (size_t)std::clamp(i, 0, n - 1) * 4));
+    for (int i = 0; i < n; ++i) {
+        const __m128i q = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(acc), vinv));
+        const __m128i p16 = _mm_packs_epi32(q, q);
+        *(int*)(dst + (size_t)i * 4) = _mm_cvtsi128_si32(_mm_packus_epi16(p16, p16));
+        const uint8_t* in = (i + r + 1 < n) ? src + (size_t)(i + r + 1) * 4 : last;
+        const uint8_t* out = (i - r > 0) ? src + (size_t)(i - r) * 4 : src;
+        acc = _mm_add_epi32(acc, _mm_sub_epi32(load(in), load(out)));
     }
-    else {
-        if (p.x < g_polyBoundsClient.left) g_polyBoundsClient.left = p.x;
-        if (p.y < g_polyBoundsClient.top) g_polyBoundsClient.top = p.y;
-        if (p.x + 1 > g_polyBoundsClient.right) g_polyBoundsClient.right = p.x + 1;
-        if (p.y + 1 > g_polyBoundsClient.bottom) g_polyBoundsClient.bottom = p.y + 1;
+#else
+    int acc[4] = {};
+    for (int i = -r; i <= r; ++i) {
+        const uint8_t* p = src + (size_t)std::clamp(i, 0, n - 1) * 4;
+        for (int c = 0; c < 4; ++c) acc[c] += p[c];
     }
+    for (int i = 0; i < n; ++i) {
+        uint8_t* d = dst + (size_t)i * 4;
+        for (int c = 0; c < 4; ++c) d[c] = (uint8_t)std::lround(acc[c] * inv);
+        const uint8_t* in = (i + r + 1 < n) ? src + (size_t)(i + r + 1) * 4 : last;
+        const uint8_t* out = (i - r > 0) ? src + (size_t)(i - r) * 4 : src;
+        for (int c = 0; c < 4; ++c) acc[c] += in[c] - out[c];
+    }
+#endif
 }
 
-static void PolyUndoLast() {
-    if (g_polyPtsClient.empty()) return;
-    g_polyPtsClient.pop_back();
-    if (g_polyPtsClient.empty()) {
-        PolyReset();
-        return;
+// Verticale box-pass voor rijen [y0,y1) van een strook van n pixels breed (rh rijen totaal).
+// Per kolom-kanaal een lopende som (acc, 4*n int32); rij voor rij -> sequentieel geheugen.
+static void BoxColumnsBand(const uint8_t* src, ptrdiff_t srcStride, uint8_t* dst, ptrdiff_t dstStride,
+    int n, int rh, int r, int y0, int y1, std::vector<int32_t>& acc) {
+    const float inv = 1.0f / (float)(2 * r + 1);
+    auto row = [&](int y) { return src + (ptrdiff_t)std::clamp(y, 0, rh - 1) * srcStride; };
+    const int lanes = n * 4;
+    acc.assign((size_t)lanes, 0);
+    for (int y = y0 - r; y <= y0 + r; ++y) {
+        const uint8_t* s = row(y);
+        for (int i = 0; i < lanes; ++i) acc[(size_t)i] += s[i];
+    }
+
+    for (int y = y0; y < y1; ++y) {
+        uint8_t* d = dst + (ptrdiff_t)y * dstStride;
+        const uint8_t* in = row(y + r + 1);
+        const uint8_t* out = row(y - r);
+        int i = 0;
+#if SNIP_HAS_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 vinv = _mm_set1_ps(inv);
+        for (; i + 16 <= lanes; i += 16) {
+            __m128i* a = (__m128i*)(acc.data() + i);
+            __m128i a0 = _mm_loadu_si128(a + 0), a1 = _mm_loadu_si128(a + 1), a2 = _mm_loadu_si128(a + 2), a3 = _mm_loadu_si128(a + 3);
+
+            const __m128i q0 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(a0), vinv));
+            const __m128i q1 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(a1), vinv));
+            const __m128i q2 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(a2), vinv));
+            const __m128i q3 = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(a3), vinv));
+            _mm_storeu_si128((__m128i*)(d + i), _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, q3)));
+
+            const __m128i vi = _mm_loadu_si128((const __m128i*)(in + i));
+            const __m128i vo = _mm_loadu_si128((const __m128i*)(out + i));
+            const __m128i il = _mm_unpacklo_epi8(vi, zero), ih = _mm_unpackhi_epi8(vi, zero);
+            const __m128i ol = _mm_unpacklo_epi8(vo, zero), oh = _mm_unpackhi_epi8(vo, zero);
+            // verschil in 16-bit (signed, |d| <= 255), dan sign-extend naar 32-bit
+            const __m128i dl = _mm_sub_epi16(il, ol), dh = _mm_sub_epi16(ih, oh);
+            a0 = _mm_add_epi32(a0, _mm_srai_epi32(_mm_unpacklo_epi16(dl, dl), 16));
+            a1 = _mm_add_epi32(a1, _mm_srai_epi32(_mm_unpackhi_epi16(dl, dl), 16));
+            a2 = _mm_add_epi32(a2, _mm_srai_epi32(_mm_unpacklo_epi16(dh, dh), 16));
+            a3 = _mm_add_epi32(a3, _mm_srai_epi32(_mm_unpackhi_epi16(dh, dh), 16));
+            _mm_storeu_si128(a + 0, a0); _mm_storeu_si128(a + 1, a1); _mm_storeu_si128(a + 2, a2); _mm_storeu_si128(a + 3, a3);
+        }
+#endif
+        for (; i < lanes; ++i) {
+            d[i] = (uint8_t)std::min(255L, std::lround(acc[(size_t)i] * inv));
+            acc[(size_t)i] += in[i] - out[i];
+        }
     }
-    PolyRecalcBounds();
 }
 
-static void DestroyOverlay() {
-    LassoReset();
-	PolyReset();
-    g_selecting = false;
-    g_hasSelection = false;
-    ZeroMemory(&g_selRectClient, sizeof(g_selRectClient));
-	ClearHover();
+// 3x horizontaal + 3x verticaal box ~ Gauss met sigma (box-passes zijn onderling
+// verwisselbaar). Horizontaal: per rij 3 passes in een L1-regelbuffer. Verticaal:
+// rijbanden die elk met hun eigen lopende som beginnen, dus onafhankelijk zijn.
+static void BlurRect(uint8_t* px, ptrdiff_t stride, int w, int h, const PixRect& rIn, float sigma) {
+    const PixRect r = PixRectIntersect(rIn, PixRect{ 0, 0, w, h });
+    if (r.Empty() || sigma <= 0.0f) return;
+
+    // box-straal voor 3 passes: sigma^2 = 3 * ((2r+1)^2 - 1) / 12
+    const int rw = r.Width(), rh = r.Height();
+    const int radius = std::clamp((int)std::lround((std::sqrt(4.0f * sigma * sigma + 1.0f) - 1.0f) * 0.5f), 1, std::max(rw, rh));
+
+    std::vector<uint8_t> tmp((size_t)rw * rh * 4);
+    const ptrdiff_t tStride = (ptrdiff_t)rw * 4;
+    uint8_t* base = px + (ptrdiff_t)r.y0 * stride + (size_t)r.x0 * 4;
+
+    ParallelForBands(rh, kRedactMinRows, [&](int y0, int y1) {
+        std::vector<uint8_t> line((size_t)rw * 4);
+        for (int y = y0; y < y1; ++y) {
+            uint8_t* t = tmp.data() + (ptrdiff_t)y * tStride;
+            BoxRow(base + (ptrdiff_t)y * stride, t, rw, radius);
+            BoxRow(t, line.data(), rw, radius);
+            BoxRow(line.data(), t, rw, radius);
+        }
+        });
+
+    // tmp -> base -> tmp -> base
+    for (int pass = 0; pass < 3; ++pass) {
+        const bool toBase = (pass != 1);
+        const uint8_t* src = toBase ? tmp.data() : base;
+        uint8_t* dst = toBase ? base : tmp.data();
+        const ptrdiff_t ss = toBase ? tStride : stride, ds = toBase ? stride : tStride;
+        ParallelForBands(rh, kRedactMinRows, [&](int y0, int y1) {
+            std::vector<int32_t> acc;
+            BoxColumnsBand(src, ss, dst, ds, rw, rh, radius, y0, y1, acc);
+            });
+    }
+}
 
-    if (g_hwndOverlay) {
-        DestroyWindow(g_hwndOverlay);
-        g_hwndOverlay = nullptr;
+// =========================================================
+// Output-schaling: Lanczos-resampler (portable, geen Win32)
+// =========================================================
+// Captures zijn fysieke pixels; op een 200%-scherm is dat 4x zoveel als wat je ziet.
+// Optioneel wordt de capture vóór clipboard/preview/opslaan verkleind (alleen
+// verkleinen): naar logische pixels, een percentage of een maximale lange zijde.
+// Separabel Lanczos-3 (bij verkleinen met factor s een s keer bredere kernel, dus
+// anti-aliased): eerst horizontaal (alle bronrijen -> tussenbuffer), dan verticaal.
+// Gewichten Q14 (som precies 1 << 14), SSE2 per tap-paar via madd, rijbanden over
+// threads. De tussenbuffer is int16 met 6 fractiebits per kanaal: de negatieve lobben
+// schieten bij harde randen onder 0 en boven 255 uit, en dat moet de verticale pass
+// nog zien (8-bit afkappen gaf tot 45 niveaus fout). Alleen het eindresultaat wordt
+// naar 0..255 geklemd. Alpha (Freestyle/Polygon): voorvermenigvuldigd resamplen, anders lekt de
+// kleur van transparante pixels de rand in.
+enum class OutputScaleMode { Off = 0, Logical = 1, Percent = 2, MaxEdge = 3 };
+
+static constexpr int kResampleShift = 14;
+static constexpr int kResampleMidFrac = 6;                 // fractiebits in de tussenbuffer
+static constexpr int kResampleMidBytes = 4 * 2;            // per pixel: 4 x int16
+static constexpr int kResampleMinRows = 32;   // per band
+
+// Doelmaat; gelijk aan de bron als er niets te verkleinen valt.
+static void OutputScaleSize(OutputScaleMode mode, int value, double dpiScale, int w, int h, int& outW, int& outH) {
+    double f = 1.0;
+    switch (mode) {
+    case OutputScaleMode::Logical:
+        if (dpiScale > 1.0) f = 1.0 / dpiScale;
+        break;
+    case OutputScaleMode::Percent:
+        f = std::clamp(value, 1, 100) / 100.0;
+        break;
+    case OutputScaleMode::MaxEdge: {
+        const int edge = std::max(w, h);
+        if (value > 0 && edge > value) f = (double)value / (double)edge;
+        break;
+    }
+    default:
+        break;
     }
+    outW = w;
+    outH = h;
+    if (f >= 1.0) return;
+    outW = std::clamp((int)std::lround(w * f), 1, w);
+    outH = std::clamp((int)std::lround(h * f), 1, h);
 }
 
-static void BringWindowToFrontForCapture(HWND h) {
-    if (!h) return;
+// Per doelpixel: eerste bronindex + taps gewichten. Het venster ligt altijd binnen
+// [0, n): aan de randen schuift het op en krijgen de taps buiten de kernel gewicht 0.
+struct ResampleTaps {
+    int taps = 0;
+    std::vector<int> first;
+    std::vector<int16_t> w;   // dst * taps
+};
+
+static double Lanczos3(double x) {
+    x = std::fabs(x);
+    if (x < 1e-9) return 1.0;
+    if (x >= 3.0) return 0.0;
+    const double pi = 3.14159265358979323846;
+    return 3.0 * std::sin(pi * x) * std::sin(pi * x / 3.0) / (pi * pi * x * x);
+}
 
-    // pak root window
-    h = GetAncestor(h, GA_ROOT);
-    if (!h) return;
+static ResampleTaps ResampleBuildTaps(int src, int dst) {
+    ResampleTaps t;
+    const double scale = (double)src / (double)dst;
+    const double stretch = std::max(1.0, scale);          // kernel-breedte bij verkleinen
+    const double support = 3.0 * stretch;
+    t.taps = std::min(src, (int)std::ceil(support) * 2 + 1);
+    t.first.resize((size_t)dst);
+    t.w.assign((size_t)dst * t.taps, 0);
+
+    std::vector<double> f((size_t)t.taps);
+    for (int i = 0; i < dst; ++i) {
+        const double center = (i + 0.5) * scale - 0.5;
+        const int first = std::clamp((int)std::floor(center - support) + 1, 0, src - t.taps);
+        t.first[(size_t)i] = first;
+
+        double sum = 0.0;
+        for (int k = 0; k < t.taps; ++k) {
+            f[(size_t)k] = Lanczos3((first + k - center) / stretch);
+            sum += f[(size_t)k];
+        }
+        if (sum == 0.0) {   // kan niet bij Lanczos-3 met >= 1 tap, maar nooit door 0 delen
+            f.assign(f.size(), 0.0);
+            f[(size_t)std::clamp((int)std::lround(center) - first, 0, t.taps - 1)] = sum = 1.0;
+        }
 
-    // als geminimaliseerd -> herstellen
-    if (IsIconic(h)) ShowWindow(h, SW_RESTORE);
+        // quantiseren; de afrondingsrest gaat naar het grootste gewicht (som exact 1.0)
+        int16_t* w = t.w.data() + (size_t)i * t.taps;
+        int total = 0, big = 0;
+        for (int k = 0; k < t.taps; ++k) {
+            w[k] = (int16_t)std::lround(f[(size_t)k] / sum * (1 << kResampleShift));
+            total += w[k];
+            if (w[k] > w[big]) big = k;
+        }
+        w[big] = (int16_t)(w[big] + ((1 << kResampleShift) - total));
+    }
+    return t;
+}
 
-    // naar top in z-order (boven normale windows)
-    SetWindowPos(h, HWND_TOP, 0, 0, 0, 0,
-        SWP_NOMOVE | SWP_NOSIZE | SWP_NOOWNERZORDER | SWP_SHOWWINDOW);
+// horizontaal: Q14-som -> int16 met kResampleMidFrac fractiebits (verzadigd)
+static inline int16_t ResampleMid(int32_t acc) {
+    constexpr int shift = kResampleShift - kResampleMidFrac;
+    return (int16_t)std::clamp((acc + (1 << (shift - 1))) >> shift, -32768, 32767);
+}
 
-    // activeer (meestal toegestaan omdat jij net klikte in jouw overlay)
-    SetForegroundWindow(h);
+// verticaal: Q14-som van tussenwaarden -> 0..255
+static inline uint8_t ResampleClamp(int32_t acc) {
+    constexpr int shift = kResampleShift + kResampleMidFrac;
+    return (uint8_t)std::clamp((acc + (1 << (shift - 1))) >> shift, 0, 255);
+}
 
-    // even tijd geven om te repainten
-    Sleep(80);
-    GdiFlush();
+// Eén rij horizontaal: src (sw pixels, BGRA) -> dst (dw pixels, 4 x int16 elk).
+static void ResampleRowH(const uint8_t* src, uint8_t* dst, int dw, const ResampleTaps& t) {
+    for (int x = 0; x < dw; ++x) {
+        const uint8_t* s = src + (size_t)t.first[(size_t)x] * 4;
+        const int16_t* w = t.w.data() + (size_t)x * t.taps;
+        int k = 0;
+#if SNIP_HAS_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = _mm_setzero_si128();
+        for (; k + 2 <= t.taps; k += 2) {
+            // [b0 g0 r0 a0 b1 g1 r1 a1] -> [b0 b1 g0 g1 r0 r1 a0 a1], madd met [w0 w1] per kanaal
+            const __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(s + (size_t)k * 4)), zero);
+            const __m128i pairs = _mm_unpacklo_epi16(p, _mm_srli_si128(p, 8));
+            const __m128i wk = _mm_set1_epi32((int)((uint32_t)(uint16_t)w[k] | ((uint32_t)(uint16_t)w[k + 1] << 16)));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pairs, wk));
+        }
+        if (k < t.taps) {
+            int32_t px;
+            std::memcpy(&px, s + (size_t)k * 4, 4);
+            const __m128i p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(px), zero), zero);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32((uint16_t)w[k])));
+        }
+        constexpr int shift = kResampleShift - kResampleMidFrac;
+        acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(1 << (shift - 1))), shift);
+        _mm_storel_epi64((__m128i*)(dst + (size_t)x * kResampleMidBytes), _mm_packs_epi32(acc, zero));
+#else
+        int32_t acc[4] = {};
+        for (; k < t.taps; ++k) {
+            for (int c = 0; c < 4; ++c) acc[c] += s[(size_t)k * 4 + c] * w[k];
+        }
+        int16_t out[4];
+        for (int c = 0; c < 4; ++c) out[c] = ResampleMid(acc[c]);
+        std::memcpy(dst + (size_t)x * kResampleMidBytes, out, sizeof(out));
+#endif
+    }
 }
 
-static bool CaptureScreenRectAndShowPreview(HWND hwndOverlay, const RECT& sr, HWND bringHwnd = nullptr) {
-    ShowWindow(hwndOverlay, SW_HIDE);
-    Sleep(20);
+// Eén doelrij verticaal: taps rijen van de tussenbuffer (elk n pixels, 4 x int16) -> dst.
+// |tussenwaarde| < 2^15 en de som van |gewichten| blijft ruim onder 2^16: past in int32.
+static void ResampleRowV(const uint8_t* mid, ptrdiff_t midStride, int first, const int16_t* w, int taps,
+    uint8_t* dst, int n) {
+    const uint8_t* base = mid + (ptrdiff_t)first * midStride;
+    int x = 0;
+#if SNIP_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    constexpr int shift = kResampleShift + kResampleMidFrac;
+    const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+    for (; x + 4 <= n; x += 4) {
+        __m128i acc0 = _mm_setzero_si128(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+        for (int k = 0; k < taps; k += 2) {
+            // a0/b0: pixels x, x+1 van rij k resp. k+1; a1/b1: x+2, x+3
+            const uint8_t* ra = base + (ptrdiff_t)k * midStride + (size_t)x * kResampleMidBytes;
+            const __m128i a0 = _mm_loadu_si128((const __m128i*)ra);
+            const __m128i a1 = _mm_loadu_si128((const __m128i*)(ra + 16));
+            __m128i b0 = zero, b1 = zero;
+            if (k + 1 < taps) {
+                b0 = _mm_loadu_si128((const __m128i*)(ra + midStride));
+                b1 = _mm_loadu_si128((const __m128i*)(ra + midStride + 16));
+            }
+            const int16_t w1 = (k + 1 < taps) ? w[k + 1] : 0;
+            const __m128i wk = _mm_set1_epi32((int)((uint32_t)(uint16_t)w[k] | ((uint32_t)(uint16_t)w1 << 16)));
+            acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a0, b0), wk));
+            acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a0, b0), wk));
+            acc2 = _mm_add_epi32(acc2, _mm_madd_epi16(_mm_unpacklo_epi16(a1, b1), wk));
+            acc3 = _mm_add_epi32(acc3, _mm_madd_epi16(_mm_unpackhi_epi16(a1, b1), wk));
+        }
+        acc0 = _mm_srai_epi32(_mm_add_epi32(acc0, round), shift);
+        acc1 = _mm_srai_epi32(_mm_add_epi32(acc1, round), shift);
+        acc2 = _mm_srai_epi32(_mm_add_epi32(acc2, round), shift);
+        acc3 = _mm_srai_epi32(_mm_add_epi32(acc3, round), shift);
+        const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(acc0, acc1), _mm_packs_epi32(acc2, acc3));
+        _mm_storeu_si128((__m128i*)(dst + (size_t)x * 4), packed);
+    }
+#endif
+    for (; x < n; ++x) {
+        int32_t acc[4] = {};
+        for (int k = 0; k < taps; ++k) {
+            int16_t p[4];
+            std::memcpy(p, base + (ptrdiff_t)k * midStride + (size_t)x * kResampleMidBytes, sizeof(p));
+            for (int c = 0; c < 4; ++c) acc[c] += p[c] * w[k];
+        }
+        for (int c = 0; c < 4; ++c) dst[(size_t)x * 4 + c] = ResampleClamp(acc[c]);
+    }
+}
 
-    if (bringHwnd) {
-        BringWindowToFrontForCapture(bringHwnd);
+// Voorvermenigvuldigen (alpha) en terug; /255 en /a via afronding resp. een reciproke-tabel.
+static void PremultiplyRow(const uint8_t* src, uint8_t* dst, int n) {
+    for (int x = 0; x < n; ++x, src += 4, dst += 4) {
+        const uint32_t a = src[3];
+        for (int c = 0; c < 3; ++c) {
+            const uint32_t v = src[c] * a + 128;
+            dst[c] = (uint8_t)((v + (v >> 8)) >> 8);
+        }
+        dst[3] = (uint8_t)a;
     }
+}
 
-    GdiFlush();
+static void UnpremultiplyRow(uint8_t* px, int n) {
+    static const std::vector<uint32_t> recip = [] {
+        std::vector<uint32_t> r(256, 0);
+        for (uint32_t a = 1; a < 256; ++a) r[a] = ((255u << 16) + a / 2) / a;
+        return r;
+    }();
+    for (int x = 0; x < n; ++x, px += 4) {
+        const uint32_t a = px[3];
+        if (a == 255) continue;
+        if (a == 0) { px[0] = px[1] = px[2] = 0; continue; }
+        for (int c = 0; c < 3; ++c) px[c] = (uint8_t)std::min<uint32_t>(255, (px[c] * recip[a] + (1u << 15)) >> 16);
+    }
+}
 
-    FreeCapture();
-    g_captureHasAlpha = false;  // belangrijk: normale captures zijn opaque
-    const bool capOk = CaptureRectToBitmap(sr, g_captureBmp, g_captureW, g_captureH);
-    const bool clipOk = capOk ? CopyBitmapToClipboard(g_captureBmp) : false;
+// src/dst: top-down BGRA views (signed stride), dw <= sw en dh <= sh.
+// alpha = voorvermenigvuldigd resamplen (anders is alpha overal 255 en blijft dat).
+static void ResampleLanczos(const uint8_t* src, ptrdiff_t srcStride, int sw, int sh,
+    uint8_t* dst, ptrdiff_t dstStride, int dw, int dh, bool alpha) {
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return;
+    const ResampleTaps tx = ResampleBuildTaps(sw, dw);
+    const ResampleTaps ty = ResampleBuildTaps(sh, dh);
+
+    // alleen de bronrijen die de verticale pass leest
+    const int rowFirst = ty.first.front();
+    const int rowLast = ty.first.back() + ty.taps;
+    const int rows = rowLast - rowFirst;
+    const ptrdiff_t midStride = (ptrdiff_t)dw * kResampleMidBytes;
+    std::vector<uint8_t> mid((size_t)midStride * rows);
+
+    ParallelForBands(rows, kResampleMinRows, [&](int r0, int r1) {
+        std::vector<uint8_t> pre(alpha ? (size_t)sw * 4 : 0);
+        for (int r = r0; r < r1; ++r) {
+            const uint8_t* s = src + (ptrdiff_t)(rowFirst + r) * srcStride;
+            if (alpha) {
+                PremultiplyRow(s, pre.data(), sw);
+                s = pre.data();
+            }
+            ResampleRowH(s, mid.data() + (ptrdiff_t)r * midStride, dw, tx);
+        }
+        });
+
+    ParallelForBands(dh, kResampleMinRows, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            uint8_t* d = dst + (ptrdiff_t)y * dstStride;
+            ResampleRowV(mid.data(), midStride, ty.first[(size_t)y] - rowFirst,
+                ty.w.data() + (size_t)y * ty.taps, ty.taps, d, dw);
+            if (alpha) UnpremultiplyRow(d, dw);
+        }
+        });
+}
 
-    if (clipOk) {
-        DestroyOverlay();
-        g_tempEditFile.clear();
-        CreatePreviewWindow();
-        return true;
-    }
+// =========================================================
+// Nabewerking: rijband-pipeline (portable, geen Win32)
+// =========================================================
+// Na de grab liep elke stap (alpha, lasso-masker, feather, schalen, clipboard-kopieën)
+// als eigen pass over het hele beeld; vanaf 4K past dat niet in de cache en komt elke
+// pass weer uit RAM. Hier gaat een band van ~kBandBytes bronpixels door alle stappen en
+// naar de sinks voordat de volgende band gelezen wordt; banden lopen parallel.
+// Een stap kent zijn uitvoermaat en zegt welke invoerrijen hij voor uitvoerrijen
+// [y0, y1) nodig heeft (feather: een rij per pass, Lanczos: de taps). Elke thread doet
+// aaneengesloten banden en een stap mag onthouden wat hij voor de vorige band al deed
+// (BandWork); alleen op de grens tussen threads wordt zo'n rand dubbel gerekend, wat
+// goedkoper is dan op elkaar wachten. Pointwise stappen (rij y alleen uit invoerrij y)
+// mogen in-place op de bron.
+// Encoderen hoort er niet bij: dat gebeurt later, op de sessie (pre-encode/opslaan).
+static constexpr size_t kBandBytes = 512 * 1024;   // bron per band, ruim binnen L2
+static constexpr int kBandMinRows = 16;
+
+struct PixPoint { int x = 0, y = 0; };
+
+// Rijen [y0, y1) van een top-down BGRA-beeld van w pixels breed; px = rij y0.
+struct BandRows {
+    uint8_t* px = nullptr;
+    ptrdiff_t stride = 0;
+    int w = 0, y0 = 0, y1 = 0;
+    uint8_t* Row(int y) const { return px + (ptrdiff_t)(y - y0) * stride; }
+};
+
+// Per worker en stap; blijft staan over de opeenvolgende banden van die worker, zodat
+// een stap buffers en al berekende rijen (Lanczos: de horizontale pass) hergebruikt.
+struct BandWork {
+    std::vector<uint8_t> buf, aux;
+    int y0 = 0, y1 = 0;           // rijen die in buf klaarstaan (betekenis per stap)
+};
+
+struct BandStage {
+    const char* name = "";
+    int outW = 0, outH = 0;
+    bool pointwise = false;
+    std::function<void(int y0, int y1, int& in0, int& in1)> need;   // uitvoer- -> invoerrijen
+    std::function<void(const BandRows& in, const BandRows& out, BandWork& work)> run;
+};
+
+// Krijgt elke eindband, parallel (elke aanroep een eigen rijbereik).
+using BandSink = std::function<void(const BandRows& band)>;
+
+struct BandPipeline {
+    int w = 0, h = 0;                      // bron
+    std::vector<BandStage> stages;
+    std::vector<BandSink> sinks;
+    int OutW() const { return stages.empty() ? w : stages.back().outW; }
+    int OutH() const { return stages.empty() ? h : stages.back().outH; }
+};
+
+static void BandNeedSame(int y0, int y1, int& in0, int& in1) {
+    in0 = y0;
+    in1 = y1;
+}
 
-    MessageBeep(MB_ICONERROR);
-    ShowWindow(hwndOverlay, SW_SHOW);
-    InvalidateRect(hwndOverlay, nullptr, TRUE);
-    return false;
+static bool BandPipelineInPlace(const BandPipeline& p) {
+    for (const BandStage& s : p.stages) if (!s.pointwise) return false;
+    return true;
 }
 
-static void LassoAddPoint(POINT p) {
-    // punten uitdunnen: scheelt CPU bij masken
-    if (!g_lassoPtsClient.empty()) {
-        POINT last = g_lassoPtsClient.back();
-        int dx = p.x - last.x, dy = p.y - last.y;
-        if (dx * dx + dy * dy < 9) return; // <3px: negeren
+static std::string BandPipelineDescribe(const BandPipeline& p) {
+    std::string s;
+    for (const BandStage& st : p.stages) {
+        if (!s.empty()) s += '+';
+        s += st.name;
     }
+    return s.empty() ? "copy" : s;
+}
 
-    g_lassoPtsClient.push_back(p);
+// Uitsnede r (geklemd op het beeld). false = leeg.
+static bool BandAddCrop(BandPipeline& p, const PixRect& rIn) {
+    const PixRect r = PixRectIntersect(rIn, PixRect{ 0, 0, p.OutW(), p.OutH() });
+    if (r.Empty()) return false;
+    BandStage s;
+    s.name = "crop";
+    s.outW = r.Width();
+    s.outH = r.Height();
+    s.need = [r](int y0, int y1, int& in0, int& in1) { in0 = y0 + r.y0; in1 = y1 + r.y0; };
+    s.run = [r](const BandRows& in, const BandRows& out, BandWork&) {
+        for (int y = out.y0; y < out.y1; ++y) std::memcpy(out.Row(y), in.Row(y + r.y0) + (size_t)r.x0 * 4, (size_t)out.w * 4);
+        };
+    p.stages.push_back(std::move(s));
+    return true;
+}
 
-    if (g_lassoPtsClient.size() == 1) {
-        g_lassoBoundsClient = { p.x, p.y, p.x + 1, p.y + 1 };
+// n pixels kopiëren met alpha 255 (src == dst mag).
+static void BandCopyOpaque(const uint8_t* src, uint8_t* dst, int n) {
+    int x = 0;
+#if SNIP_HAS_SSE2
+    const __m128i a = _mm_set1_epi32((int)0xFF000000u);
+    for (; x + 4 <= n; x += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(src + (size_t)x * 4));
+        _mm_storeu_si128((__m128i*)(dst + (size_t)x * 4), _mm_or_si128(v, a));
     }
-    else {
-        if (p.x < g_lassoBoundsClient.left)   g_lassoBoundsClient.left = p.x;
-        if (p.y < g_lassoBoundsClient.top)    g_lassoBoundsClient.top = p.y;
-        if (p.x + 1 > g_lassoBoundsClient.right)  g_lassoBoundsClient.right = p.x + 1;
-        if (p.y + 1 > g_lassoBoundsClient.bottom) g_lassoBoundsClient.bottom = p.y + 1;
+#endif
+    for (; x < n; ++x) {
+        for (int c = 0; c < 3; ++c) dst[(size_t)x * 4 + c] = src[(size_t)x * 4 + c];
+        dst[(size_t)x * 4 + 3] = 255;
     }
 }
 
-static void PolygonFinalize(HWND hwnd) {
-    ReleaseCapture();
-    g_polySelecting = false;
-
-    if (g_polyPtsClient.size() < 3) {
-        MessageBeep(MB_ICONWARNING);
-        PolyReset();
-        InvalidateRect(hwnd, nullptr, TRUE);
-        return;
+// Alpha op 255: BitBlt in een 32bpp DIB laat alpha meestal op 0 (PNG wordt dan "transparant").
+static void BandAddOpaque(BandPipeline& p) {
+    BandStage s;
+    s.name = "opaque";
+    s.outW = p.OutW();
+    s.outH = p.OutH();
+    s.pointwise = true;
+    s.need = BandNeedSame;
+    s.run = [](const BandRows& in, const BandRows& out, BandWork&) {
+        for (int y = out.y0; y < out.y1; ++y) BandCopyOpaque(in.Row(y), out.Row(y), out.w);
+        };
+    p.stages.push_back(std::move(s));
+}
+
+// Lasso (lokale coördinaten, even-odd): binnen de polygoon RGB met alpha 255, erbuiten
+// alles 0. Per rij de snijpunten met de scanline; [ceil(x0), floor(x1)) is binnen.
+static bool BandAddMask(BandPipeline& p, std::vector<PixPoint> poly) {
+    if (poly.size() < 3) return false;
+    auto pts = std::make_shared<const std::vector<PixPoint>>(std::move(poly));
+    BandStage s;
+    s.name = "mask";
+    s.outW = p.OutW();
+    s.outH = p.OutH();
+    s.pointwise = true;
+    s.need = BandNeedSame;
+    s.run = [pts](const BandRows& in, const BandRows& out, BandWork&) {
+        const std::vector<PixPoint>& poly = *pts;
+        const size_t n = poly.size();
+        const int w = out.w;
+        std::vector<double> xs;
+        xs.reserve(n);
+        for (int y = out.y0; y < out.y1; ++y) {
+            xs.clear();
+            for (size_t i = 0; i < n; ++i) {
+                const PixPoint a = poly[i], b = poly[(i + 1) % n];
+                if (a.y == b.y || y < std::min(a.y, b.y) || y >= std::max(a.y, b.y)) continue;
+                const double t = (double)(y - a.y) / (double)(b.y - a.y);
+                xs.push_back((double)a.x + t * (double)(b.x - a.x));
+            }
+            std::sort(xs.begin(), xs.end());
+
+            // spans van links naar rechts: ertussen leegmaken, erin alpha zetten
+            // (leest elke pixel vóór hij geschreven wordt, dus in-place kan)
+            const uint8_t* src = in.Row(y);
+            uint8_t* dst = out.Row(y);
+            int done = 0;
+            for (size_t k = 0; k + 1 < xs.size(); k += 2) {
+                const int x0 = std::max(done, (int)std::ceil(xs[k]));
+                const int x1 = std::min(w, (int)std::floor(xs[k + 1]));
+                if (x0 >= x1) continue;
+                std::memset(dst + (size_t)done * 4, 0, (size_t)(x0 - done) * 4);
+                BandCopyOpaque(src + (size_t)x0 * 4, dst + (size_t)x0 * 4, x1 - x0);
+                done = x1;
+            }
+            std::memset(dst + (size_t)done * 4, 0, (size_t)(w - done) * 4);
+        }
+        };
+    p.stages.push_back(std::move(s));
+    return true;
+}
+
+// Alpha-vlak van n BGRA-pixels eruit halen, en terugzetten naast de RGB van src.
+static void AlphaExtract(const uint8_t* px, uint8_t* a, int n) {
+    int x = 0;
+#if SNIP_HAS_SSE2
+    for (; x + 8 <= n; x += 8) {
+        const __m128i lo = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(px + (size_t)x * 4)), 24);
+        const __m128i hi = _mm_srli_epi32(_mm_loadu_si128((const __m128i*)(px + (size_t)x * 4 + 16)), 24);
+        const __m128i v = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i*)(a + x), _mm_packus_epi16(v, v));
     }
+#endif
+    for (; x < n; ++x) a[x] = px[(size_t)x * 4 + 3];
+}
 
-    // bounds iets ruimer
-    RECT b = g_polyBoundsClient;
-    b.left -= 2; b.top -= 2; b.right += 2; b.bottom += 2;
+static void AlphaMerge(const uint8_t* src, const uint8_t* a, uint8_t* dst, int n) {
+    int x = 0;
+#if SNIP_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+    for (; x + 8 <= n; x += 8) {
+        const __m128i a16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a + x)), zero);
+        const __m128i lo = _mm_slli_epi32(_mm_unpacklo_epi16(a16, zero), 24);
+        const __m128i hi = _mm_slli_epi32(_mm_unpackhi_epi16(a16, zero), 24);
+        const __m128i s0 = _mm_loadu_si128((const __m128i*)(src + (size_t)x * 4));
+        const __m128i s1 = _mm_loadu_si128((const __m128i*)(src + (size_t)x * 4 + 16));
+        _mm_storeu_si128((__m128i*)(dst + (size_t)x * 4), _mm_or_si128(_mm_and_si128(s0, rgb), lo));
+        _mm_storeu_si128((__m128i*)(dst + (size_t)x * 4 + 16), _mm_or_si128(_mm_and_si128(s1, rgb), hi));
+    }
+#endif
+    for (; x < n; ++x) {
+        for (int c = 0; c < 3; ++c) dst[(size_t)x * 4 + c] = src[(size_t)x * 4 + c];
+        dst[(size_t)x * 4 + 3] = a[x];
+    }
+}
 
-    if ((b.right - b.left) < 5 || (b.bottom - b.top) < 5) {
-        MessageBeep(MB_ICONWARNING);
-        PolyReset();
-        InvalidateRect(hwnd, nullptr, TRUE);
-        return;
+// Eén feather-rij: 3x3-gemiddelde uit de rijen boven/op/onder (none = buiten het beeld).
+// Binnenstuk: deler 3 * nr, als 16-bit reciproke (1 << 16) / d + 1, exact voor
+// sommen <= 9 * 255.
+static void FeatherRow(const uint8_t* r0, const uint8_t* r1, const uint8_t* r2, int nr,
+    uint16_t* col, uint8_t* dst, int w) {
+    int x = 0;
+#if SNIP_HAS_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= w; x += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(r0 + x));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(r1 + x));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(r2 + x));
+        const __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)), _mm_unpacklo_epi8(c, zero));
+        const __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)), _mm_unpackhi_epi8(c, zero));
+        _mm_storeu_si128((__m128i*)(col + x), lo);
+        _mm_storeu_si128((__m128i*)(col + x + 8), hi);
     }
+#endif
+    for (; x < w; ++x) col[x] = (uint16_t)(r0[x] + r1[x] + r2[x]);
 
-    RECT ow{};
-    GetWindowRect(hwnd, &ow);
+    auto edge = [&](int e) {
+        const int x0 = std::max(0, e - 1), x1 = std::min(w - 1, e + 1);
+        int sum = 0;
+        for (int i = x0; i <= x1; ++i) sum += col[i];
+        dst[e] = (uint8_t)(sum / (nr * (x1 - x0 + 1)));
+        };
+    edge(0);
+    if (w == 1) return;
+    const uint32_t m = (1u << 16) / (uint32_t)(3 * nr) + 1;
+    x = 1;
+#if SNIP_HAS_SSE2
+    const __m128i vm = _mm_set1_epi16((short)m);
+    for (; x + 9 <= w; x += 8) {
+        const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i*)(col + x - 1)),
+            _mm_loadu_si128((const __m128i*)(col + x))), _mm_loadu_si128((const __m128i*)(col + x + 1)));
+        const __m128i q = _mm_mulhi_epu16(sum, vm);
+        _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(q, q));
+    }
+#endif
+    for (; x < w - 1; ++x) dst[x] = (uint8_t)(((uint32_t)col[x - 1] + col[x] + col[x + 1]) * m >> 16);
+    edge(w - 1);
+}
 
-    RECT sr{
-        ow.left + b.left,
-        ow.top + b.top,
-        ow.left + b.right,
-        ow.top + b.bottom
-    };
+// Zachte maskerrand: passes keer een 3x3-gemiddelde over alpha (alleen buren binnen het
+// beeld tellen mee). Per pass krimpt het geldige deel van de band een rij aan elke kant
+// die niet op de beeldrand ligt; need() vraagt daarom passes rijen extra.
+static void BandAddFeather(BandPipeline& p, int passes) {
+    if (passes <= 0) return;
+    const int h = p.OutH();
+    BandStage s;
+    s.name = "feather";
+    s.outW = p.OutW();
+    s.outH = h;
+    s.need = [h, passes](int y0, int y1, int& in0, int& in1) {
+        in0 = std::max(0, y0 - passes);
+        in1 = std::min(h, y1 + passes);
+        };
+    s.run = [h, passes](const BandRows& in, const BandRows& out, BandWork& work) {
+        const int w = out.w, rows = in.y1 - in.y0;
+        std::vector<uint8_t>& a = work.buf;
+        std::vector<uint8_t>& next = work.aux;
+        a.resize((size_t)w * rows);
+        next.resize(a.size());
+        std::vector<uint8_t> none((size_t)w, 0);
+        std::vector<uint16_t> col((size_t)w);
+        for (int y = in.y0; y < in.y1; ++y) AlphaExtract(in.Row(y), a.data() + (size_t)(y - in.y0) * w, w);
+        int lo = in.y0, hi = in.y1;
+        for (int pass = 0; pass < passes; ++pass) {
+            const int nlo = lo > 0 ? lo + 1 : 0, nhi = hi < h ? hi - 1 : h;
+            for (int y = nlo; y < nhi; ++y) {
+                const uint8_t* r0 = y > 0 ? a.data() + (size_t)(y - 1 - in.y0) * w : none.data();
+                const uint8_t* r2 = y + 1 < h ? a.data() + (size_t)(y + 1 - in.y0) * w : none.data();
+                FeatherRow(r0, a.data() + (size_t)(y - in.y0) * w, r2, 1 + (y > 0) + (y + 1 < h),
+                    col.data(), next.data() + (size_t)(y - in.y0) * w, w);
+            }
+            lo = nlo;
+            hi = nhi;
+            a.swap(next);
+        }
+        for (int y = out.y0; y < out.y1; ++y) AlphaMerge(in.Row(y), a.data() + (size_t)(y - in.y0) * w, out.Row(y), w);
+        };
+    p.stages.push_back(std::move(s));
+}
 
-    ShowWindow(hwnd, SW_HIDE);
-    Sleep(20);
-    GdiFlush();
+// Pixelate r (blokken uitgelijnd op r, zoals PixelateRect); een band leest de hele
+// blokrijen die hij raakt. false = niets te doen.
+static bool BandAddPixelate(BandPipeline& p, const PixRect& rIn, int block) {
+    const PixRect r = PixRectIntersect(rIn, PixRect{ 0, 0, p.OutW(), p.OutH() });
+    if (r.Empty() || block < 2) return false;
+    block = std::min(block, 256);
+    BandStage s;
+    s.name = "redact";
+    s.outW = p.OutW();
+    s.outH = p.OutH();
+    s.need = [r, block](int y0, int y1, int& in0, int& in1) {
+        in0 = y0;
+        in1 = y1;
+        if (y1 <= r.y0 || y0 >= r.y1) return;
+        in0 = std::min(y0, r.y0 + (std::max(y0, r.y0) - r.y0) / block * block);
+        in1 = std::max(y1, std::min(r.y1, r.y0 + (std::min(y1, r.y1) - r.y0 + block - 1) / block * block));
+        };
+    s.run = [r, block](const BandRows& in, const BandRows& out, BandWork&) {
+        for (int y = out.y0; y < out.y1; ++y) std::memcpy(out.Row(y), in.Row(y), (size_t)out.w * 4);
+        const int ya = std::max(out.y0, r.y0), yb = std::min(out.y1, r.y1);
+        if (ya >= yb) return;
+        for (int by0 = r.y0 + (ya - r.y0) / block * block; by0 < yb; by0 += block) {
+            const int by1 = std::min(r.y1, by0 + block);
+            for (int x0 = r.x0; x0 < r.x1; x0 += block) {
+                const int x1 = std::min(r.x1, x0 + block);
+                const uint32_t avg = PixelateBlockAvg(in.Row(by0), in.stride, x0, x1, by1 - by0);
+                for (int y = std::max(by0, out.y0); y < std::min(by1, out.y1); ++y) {
+                    uint32_t* row = (uint32_t*)out.Row(y) + x0;
+                    for (int x = 0; x < x1 - x0; ++x) row[x] = avg;
+                }
+            }
+        }
+        };
+    p.stages.push_back(std::move(s));
+    return true;
+}
 
-    FreeCapture();
-    g_captureHasAlpha = false;
+// Lanczos-verkleining naar dw x dh (zelfde rekenwerk als ResampleLanczos, dus bit-gelijk):
+// de band resamplet horizontaal alleen de bronrijen die zijn eigen doelrijen lezen.
+static bool BandAddScale(BandPipeline& p, int dw, int dh, bool alpha) {
+    const int sw = p.OutW(), sh = p.OutH();
+    if (dw <= 0 || dh <= 0 || dw > sw || dh > sh) return false;
+    auto tx = std::make_shared<const ResampleTaps>(ResampleBuildTaps(sw, dw));
+    auto ty = std::make_shared<const ResampleTaps>(ResampleBuildTaps(sh, dh));
+    BandStage s;
+    s.name = "scale";
+    s.outW = dw;
+    s.outH = dh;
+    s.need = [ty](int y0, int y1, int& in0, int& in1) {
+        in0 = ty->first[(size_t)y0];
+        in1 = ty->first[(size_t)y1 - 1] + ty->taps;
+        };
+    s.run = [tx, ty, sw, alpha](const BandRows& in, const BandRows& out, BandWork& work) {
+        // work.buf = horizontaal geresamplede rijen [work.y0, work.y1); de taps die de
+        // vorige band van deze worker al deed, schuiven door
+        const ptrdiff_t midStride = (ptrdiff_t)out.w * kResampleMidBytes;
+        int from = in.y0;
+        if (in.y0 >= work.y0 && in.y0 < work.y1 && in.y1 >= work.y1) {
+            std::memmove(work.buf.data(), work.buf.data() + (ptrdiff_t)(in.y0 - work.y0) * midStride,
+                (size_t)midStride * (size_t)(work.y1 - in.y0));
+            from = work.y1;
+        }
+        work.buf.resize((size_t)midStride * (size_t)(in.y1 - in.y0));
+        work.aux.resize(alpha ? (size_t)sw * 4 : 0);
+        for (int r = from; r < in.y1; ++r) {
+            const uint8_t* src = in.Row(r);
+            if (alpha) {
+                PremultiplyRow(src, work.aux.data(), sw);
+                src = work.aux.data();
+            }
+            ResampleRowH(src, work.buf.data() + (ptrdiff_t)(r - in.y0) * midStride, out.w, *tx);
+        }
+        work.y0 = in.y0;
+        work.y1 = in.y1;
+        for (int y = out.y0; y < out.y1; ++y) {
+            uint8_t* dst = out.Row(y);
+            ResampleRowV(work.buf.data(), midStride, ty->first[(size_t)y] - in.y0,
+                ty->w.data() + (size_t)y * ty->taps, ty->taps, dst, out.w);
+            if (alpha) UnpremultiplyRow(dst, out.w);
+        }
+        };
+    p.stages.push_back(std::move(s));
+    return true;
+}
 
-    bool capOk = CaptureRectToBitmap(sr, g_captureBmp, g_captureW, g_captureH);
-    if (!capOk) {
-        MessageBeep(MB_ICONERROR);
-        ShowWindow(hwnd, SW_SHOW);
-        InvalidateRect(hwnd, nullptr, TRUE);
-        return;
+// Sink: eindrijen kopiëren naar een top-down view (bottom-up DIB/HGLOBAL: negatieve stride).
+static BandSink BandCopySink(uint8_t* top, ptrdiff_t stride) {
+    return [top, stride](const BandRows& b) {
+        for (int y = b.y0; y < b.y1; ++y) std::memcpy(top + (ptrdiff_t)y * stride, b.Row(y), (size_t)b.w * 4);
+        };
+}
+
+// Alle stappen band voor band. src = top-down view van de bron (p.w x p.h); dst (mag
+// nullptr) krijgt het eindbeeld (OutW x OutH), dst == src alleen als alles pointwise is.
+// bandRows 0 = uit kBandBytes. Geeft het aantal banden terug, 0 = niets gedaan.
+static int BandPipelineRun(const BandPipeline& p, const uint8_t* src, ptrdiff_t srcStride,
+    uint8_t* dst, ptrdiff_t dstStride, int bandRows = 0) {
+    const int oh = p.OutH();
+    if (!src || p.w <= 0 || p.h <= 0 || p.OutW() <= 0 || oh <= 0) return 0;
+    if (dst == src && !BandPipelineInPlace(p)) return 0;
+    if (bandRows <= 0) {
+        int widest = p.w;
+        for (const BandStage& s : p.stages) widest = std::max(widest, s.outW);
+        bandRows = std::max(kBandMinRows, (int)(kBandBytes / ((size_t)widest * 4)));
     }
+    const size_t n = p.stages.size();
+    const int bands = (oh + bandRows - 1) / bandRows;
+
+    ParallelForBands(bands, 1, [&](int b0, int b1) {
+        std::vector<std::vector<uint8_t>> scratch(n);
+        std::vector<BandWork> work(n);
+        std::vector<int> r0(n + 1), r1(n + 1);
+        for (int b = b0; b < b1; ++b) {
+            r0[n] = b * bandRows;
+            r1[n] = std::min(oh, r0[n] + bandRows);
+            for (size_t i = n; i-- > 0;) p.stages[i].need(r0[i + 1], r1[i + 1], r0[i], r1[i]);
+
+            BandRows in{ const_cast<uint8_t*>(src) + (ptrdiff_t)r0[0] * srcStride, srcStride, p.w, r0[0], r1[0] };
+            for (size_t i = 0; i < n; ++i) {
+                const BandStage& s = p.stages[i];
+                BandRows out{ nullptr, (ptrdiff_t)s.outW * 4, s.outW, r0[i + 1], r1[i + 1] };
+                if (i + 1 == n && dst) {
+                    out.px = dst + (ptrdiff_t)out.y0 * dstStride;
+                    out.stride = dstStride;
+                }
+                else {
+                    scratch[i].resize((size_t)out.stride * (size_t)(out.y1 - out.y0));
+                    out.px = scratch[i].data();
+                }
+                s.run(in, out, work[i]);
+                in = out;
+            }
+            if (n == 0 && dst && dst != src) BandCopySink(dst, dstStride)(in);
+            for (const BandSink& sink : p.sinks) sink(in);
+        }
+        });
+    return bands;
+}
 
-    // mask: alpha buiten polygon = 0
-    if (!ApplyLassoAlphaMask(g_captureBmp, g_polyPtsClient, b)) {
-        MessageBeep(MB_ICONERROR);
-        ShowWindow(hwnd, SW_SHOW);
-        InvalidateRect(hwnd, nullptr, TRUE);
-        return;
+// Dezelfde stappen zoals de nabewerking vroeger liep: elke stap een pass over het hele
+// beeld naar een volledig tussenbeeld, daarna een pass per sink. Voor snip_bench pipeline.
+static bool BandPipelineRunStaged(const BandPipeline& p, const uint8_t* src, ptrdiff_t srcStride,
+    uint8_t* dst, ptrdiff_t dstStride) {
+    if (!src || dst == src) return false;
+    const int hw = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint8_t> cur, next;
+    const uint8_t* in = src;
+    ptrdiff_t inStride = srcStride;
+    int w = p.w, h = p.h;
+    for (size_t i = 0; i < p.stages.size(); ++i) {
+        const BandStage& s = p.stages[i];
+        BandPipeline one{ w, h, { s }, {} };
+        uint8_t* out = dst;
+        ptrdiff_t outStride = dstStride;
+        if (i + 1 < p.stages.size() || !dst) {
+            next.resize((size_t)s.outW * 4 * (size_t)s.outH);
+            out = next.data();
+            outStride = (ptrdiff_t)s.outW * 4;
+        }
+        if (!BandPipelineRun(one, in, inStride, out, outStride, (s.outH + hw - 1) / hw)) return false;
+        if (out == next.data()) {
+            cur.swap(next);
+            out = cur.data();
+        }
+        in = out;
+        inStride = outStride;
+        w = s.outW;
+        h = s.outH;
+    }
+    if (p.stages.empty() && dst) BandPipelineRun(BandPipeline{ w, h, {}, {} }, in, inStride, dst, dstStride, (h + hw - 1) / hw);
+    for (const BandSink& sink : p.sinks) {
+        if (!BandPipelineRun(BandPipeline{ w, h, {}, { sink } }, in, inStride, nullptr, 0, (h + hw - 1) / hw)) return false;
     }
+    return true;
+}
 
-    g_captureHasAlpha = true;
-    // Polygon is “strak”; feather optioneel. Zet op 1 als je het net iets zachter wil.
-    // FeatherAlpha3x3(g_captureBmp, 1);
+struct BandBenchResult {
+    std::string chain;
+    int outW = 0, outH = 0;
+    int bands = 0;
+    double fusedMs = 0, stagedMs = 0;   // beste van de herhalingen
+    bool identical = false;             // eindbeeld en sinks bit-gelijk
+};
+
+// Schermachtig testbeeld (vlakken, verlopen, "tekst") door een keten met twee kopie-
+// sinks zoals de capture (clipboard-DIB + CF_BITMAP). lasso = rand eraf, lasso-ellips,
+// feather, redactie en naar 50%; anders wat een gewone rechthoek-capture doet (alpha).
+static BandBenchResult BandPipelineBenchmark(int w, int h, bool lasso, int reps) {
+    BandBenchResult res;
+    w = std::max(w, 64);
+    h = std::max(h, 64);
+    const ptrdiff_t stride = (ptrdiff_t)w * 4;
+    std::vector<uint8_t> src((size_t)stride * h);
+    uint32_t rng = 0x9E3779B9u;
+    for (int y = 0; y < h; ++y) {
+        uint8_t* row = src.data() + (ptrdiff_t)y * stride;
+        for (int x = 0; x < w; ++x) {
+            rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+            const bool text = ((x / 7 + y / 11) & 3) == 0 && (rng & 7) < 3;
+            const uint8_t base = (uint8_t)(((x >> 6) + (y >> 6)) & 1 ? 240 : 200 + (x * 40) / w);
+            row[x * 4 + 0] = text ? (uint8_t)(rng >> 8) : base;
+            row[x * 4 + 1] = text ? (uint8_t)(rng >> 16) : base;
+            row[x * 4 + 2] = text ? (uint8_t)(rng >> 24) : (uint8_t)(base - 20);
+            row[x * 4 + 3] = 0;
+        }
+    }
 
-    bool clipOk = CopyBitmapToClipboardAlphaV5(g_captureBmp);
-    if (clipOk) {
-        DestroyOverlay();
-        g_tempEditFile.clear();
-        CreatePreviewWindow();
+    BandPipeline p{ w, h, {}, {} };
+    if (lasso) {
+        BandAddCrop(p, PixRect{ 2, 2, w - 2, h - 2 });
+        std::vector<PixPoint> ellipse;
+        const int cw = p.OutW(), ch = p.OutH();
+        for (int i = 0; i < 256; ++i) {
+            const double t = i * (2.0 * 3.14159265358979323846 / 256);
+            ellipse.push_back({ (int)std::lround(cw / 2 + cw * 0.48 * std::cos(t)), (int)std::lround(ch / 2 + ch * 0.48 * std::sin(t)) });
+        }
+        BandAddMask(p, std::move(ellipse));
+        BandAddFeather(p, 2);
+        BandAddPixelate(p, PixRect{ cw / 4, ch / 3, cw * 3 / 4, ch / 2 }, 12);
+        BandAddScale(p, std::max(1, cw / 2), std::max(1, ch / 2), true);
     }
-    else {
-        MessageBeep(MB_ICONERROR);
-        ShowWindow(hwnd, SW_SHOW);
-        InvalidateRect(hwnd, nullptr, TRUE);
+    else BandAddOpaque(p);
+    res.chain = BandPipelineDescribe(p);
+    res.outW = p.OutW();
+    res.outH = p.OutH();
+
+    const size_t outBytes = (size_t)res.outW * 4 * res.outH;
+    const ptrdiff_t outStride = (ptrdiff_t)res.outW * 4;
+    std::vector<uint8_t> fused(outBytes), staged(outBytes), sinkA[2], sinkB[2];
+    for (auto* v : { &sinkA[0], &sinkA[1], &sinkB[0], &sinkB[1] }) v->assign(outBytes, 0);
+
+    auto timeBest = [&](auto&& fn) {
+        double best = 1e30;
+        for (int i = 0; i < std::max(1, reps); ++i) {
+            const auto t0 = std::chrono::steady_clock::now();
+            fn();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        }
+        return best;
+    };
+    // sinks als clipboard (bottom-up) en CF_BITMAP
+    p.sinks = { BandCopySink(sinkA[0].data() + (ptrdiff_t)(res.outH - 1) * outStride, -outStride),
+        BandCopySink(sinkA[1].data(), outStride) };
+    res.fusedMs = timeBest([&] { res.bands = BandPipelineRun(p, src.data(), stride, fused.data(), outStride); });
+    p.sinks = { BandCopySink(sinkB[0].data() + (ptrdiff_t)(res.outH - 1) * outStride, -outStride),
+        BandCopySink(sinkB[1].data(), outStride) };
+    res.stagedMs = timeBest([&] { BandPipelineRunStaged(p, src.data(), stride, staged.data(), outStride); });
+    res.identical = res.bands > 0 && fused == staged && sinkA[0] == sinkB[0] && sinkA[1] == sinkB[1];
+    return res;
+}
+
+// =========================================================
+// Capture-sessies: eigenaarschap (portable, geen Win32)
+// =========================================================
+// Elke capture wordt een sessie met eigen bitmap, annotaties, pre-encode job en
+// preview-venster, zodat meerdere previews tegelijk open kunnen staan. De lijst is
+// de enige eigenaar (unique_ptr); vensters kennen alleen een pointer die geldig
+// blijft tot SessionTake. Ids worden niet hergebruikt: een verlopen id vindt niets.
+template <class S>
+struct SessionList {
+    std::vector<std::unique_ptr<S>> items;  // oudste eerst
+    uint32_t nextId = 1;
+};
+
+template <class S>
+static S* SessionAdd(SessionList<S>& list, std::unique_ptr<S> s) {
+    if (!s) return nullptr;
+    s->id = list.nextId++;
+    list.items.push_back(std::move(s));
+    return list.items.back().get();
+}
+
+// Uit de lijst halen; de aanroeper wordt eigenaar (loslaten = opruimen).
+template <class S>
+static std::unique_ptr<S> SessionTake(SessionList<S>& list, uint32_t id) {
+    for (auto it = list.items.begin(); it != list.items.end(); ++it) {
+        if ((*it)->id != id) continue;
+        std::unique_ptr<S> s = std::move(*it);
+        list.items.erase(it);
+        return s;
     }
+    return nullptr;
+}
 
-    PolyReset();
+template <class S>
+static S* SessionFind(const SessionList<S>& list, uint32_t id) {
+    for (const auto& s : list.items) {
+        if (s->id == id) return s.get();
+    }
+    return nullptr;
 }
 
-static LRESULT CALLBACK OverlayProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-    switch (msg) {
-    case WM_SETCURSOR:
-        if ((HWND)wParam == hwnd && LOWORD(lParam) == HTCLIENT) {
-            SetCursor(nullptr); // cursor verbergen
-            return TRUE;
-        }
-        break;
+// Ruimte maken voor één nieuwe sessie binnen maxOpen. Alleen sessies zonder onbewaard
+// werk (keep(s) == false) mogen wijken, oudste eerst. Lukt dat niet, dan is outClose
+// leeg en false: er sluit niets en de aanroeper weigert de nieuwe sessie.
+template <class S, class KeepFn>
+static bool SessionMakeRoom(const SessionList<S>& list, size_t maxOpen, KeepFn&& keep, std::vector<uint32_t>& outClose) {
+    outClose.clear();
+    if (maxOpen == 0) return false;
+    size_t excess = list.items.size() >= maxOpen ? list.items.size() - maxOpen + 1 : 0;
+    for (const auto& s : list.items) {
+        if (excess == 0) break;
+        if (keep(*s)) continue;
+        outClose.push_back(s->id);
+        --excess;
+    }
+    if (excess == 0) return true;
+    outClose.clear();
+    return false;
+}
 
-    case WM_MOUSELEAVE:
-        g_cursorValid = false;
-        g_trackLeave = false;
-        InvalidateRect(hwnd, nullptr, FALSE);
-        return 0;
+#if !SNIP_CORE_ONLY
+// =========================================================
+// Annotaties (preview)
+// =========================================================
+// De capture-DIB is zelf het platgeslagen resultaat: Save, Edit en clipboard
+// hoeven niets te weten van de scene. 'base' is de kopie van de originele
+// pixels (pas bij de eerste shape gemaakt) waaruit beschadigde stukken
+// worden hersteld.
+// Redactie gaat niet via de scene: pixelate/blur worden in base zelf
+// toegepast (onomkeerbaar, ook niet via Undo) en daarna opnieuw samengesteld.
+static constexpr int kAnnotToolPixelate = 16;  // naast (int)AnnotKind
+static constexpr int kAnnotToolBlur = 17;
+static constexpr int kRedactBlock = 16;        // image-pixels
+static constexpr float kRedactSigma = 10.0f;
+
+struct AnnotState {
+    AnnotScene scene;
+    std::vector<uint8_t> base;      // top-down, w*4 per rij
+    HBITMAP bmp = nullptr;          // capture waar base bij hoort
+    int w = 0, h = 0;
+    int tool = -1;                  // (int)AnnotKind of kAnnotTool*, -1 = geen
+    int active = -1;                // shape die gesleept/getekend wordt
+    bool moving = false;
+    bool redacting = false;         // rechthoek voor pixelate/blur wordt gesleept
+    PixRect redactRect{};
+    int anchorX = 0, anchorY = 0;   // image coords bij mousedown
+    AnnotShape orig{};              // shape bij mousedown (verplaatsen)
+};
 
-    case WM_RBUTTONUP:
-        if (g_polySelecting) {
-            PolyUndoLast();
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return 0;
-        }
-        if (g_lassoSelecting) return 0;
-        if (g_selecting) return 0;
-        ShowModeMenu(hwnd);
-        InvalidateRect(hwnd, nullptr, TRUE);
-        return 0;
+// =========================================================
+// Capture-sessies (preview)
+// =========================================================
+// Een sessie ontstaat uit de capture-globals (OpenCaptureSession neemt de bitmap
+// over) en leeft precies zo lang als zijn preview-venster: WM_NCDESTROY haalt hem
+// uit g_sessions. Een lopende pre-encode job heeft zijn eigen snapshot en stopt
+// vanzelf zodra cancel staat.
+static constexpr size_t kMaxCaptureSessions = 8;   // daarboven sluit de oudste bewaarde preview
+
+struct CaptureSession {
+    uint32_t id = 0;
+    HWND hwnd = nullptr;
+
+    HBITMAP bmp = nullptr;          // eigendom van de sessie
+    int w = 0, h = 0;
+    bool hasAlpha = false;
+    bool unsaved = true;            // capture (of laatste bewerking) staat nog niet in een bestand
+    uint64_t hash = 0;
+    bool hashValid = false;
+    std::wstring tempEditFile;      // laatst naar de editor gegeven temp-bestand
+
+    // bron (voor de catalogus)
+    Mode mode = Mode::Region;
+    RECT srcRect{};
+    std::wstring srcTitle;
+    std::wstring srcProcess;
+
+    // layout (LayoutPreview)
+    RECT rcImage{};
+    RECT btnSave{};
+    RECT btnEdit{};
+    RECT btnDismiss{};
+    RECT rcStatus{};
+    std::wstring statusText;
+
+    AnnotState annot;
+    std::shared_ptr<PreEncodeJob> preEncode;
+
+    // diff met de vorige capture van hetzelfde doel (D)
+    HBITMAP diffBmp = nullptr;      // heat-map, zelfde maat als bmp
+    std::vector<PixRect> diffBoxes;
+    std::wstring diffText;
+    bool diffShown = false;
+
+    // capture klaar -> eerste paint van de preview (DebugLog)
+    std::chrono::steady_clock::time_point openedAt{};
+    bool warmWindow = false;
+    bool firstPaintLogged = false;
+
+    CaptureSession() = default;
+    CaptureSession(const CaptureSession&) = delete;
+    CaptureSession& operator=(const CaptureSession&) = delete;
+    ~CaptureSession() {
+        PreEncodeCancel(preEncode);
+        if (bmp) DeleteObject(bmp);
+        if (diffBmp) DeleteObject(diffBmp);
+    }
+};
+static SessionList<CaptureSession> g_sessions;
 
-    case WM_LBUTTONDOWN:
-        if (g_mode == Mode::Polygon) {
-            SetFocus(hwnd);
+static CaptureSession* SessionFromHwnd(HWND hwnd) {
+    return hwnd ? (CaptureSession*)GetWindowLongPtrW(hwnd, GWLP_USERDATA) : nullptr;
+}
 
-            POINT raw{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+static bool IsPreviewWindow(HWND h) {
+    if (!h) return false;
+    for (const auto& s : g_sessions.items) {
+        if (s->hwnd == h) return true;
+    }
+    return false;
+}
 
-            if (!g_polySelecting) {
-                SetCapture(hwnd);
-                PolyReset();
-                g_polySelecting = true;
+static void SetStatus(CaptureSession& ses, const std::wstring& s) {
+    ses.statusText = s;
+    InvalidateRect(ses.hwnd, nullptr, TRUE);
+    SetTimer(ses.hwnd, TIMER_STATUS_CLEAR, 1500, nullptr);
+}
 
-                g_polyHoverClient = raw;
-                g_polyHoverValid = true;
+static void SessionUpdateHash(CaptureSession& ses) {
+    ses.hashValid = BitmapContentHash(ses.bmp, ses.hasAlpha, ses.hash);
+}
 
-                PolyAddPoint(raw);
-                InvalidateRect(hwnd, nullptr, TRUE);
-                return 0;
-            }
+static void SessionPreEncode(CaptureSession& ses) {
+    PreEncodeStart(ses.preEncode, ses.bmp, ses.hash, ses.hashValid, ses.hasAlpha);
+}
 
-            // bestaand polygon: bepaal klikpunt (Shift = snap 45° t.o.v. laatste punt)
-            POINT p = raw;
-            if (!g_polyPtsClient.empty() && IsShiftDown()) {
-                p = SnapPoint45(g_polyPtsClient.back(), raw);
-            }
+static bool TempEditFileForSession(CaptureSession& ses, SaveFormat fmt, std::wstring& outPath, bool* outReused) {
+    return TempEditFileForBitmap(ses.bmp, ses.hash, ses.hashValid, fmt, true, outPath, outReused);
+}
 
-            // close door te klikken dichtbij het eerste punt
-            if (g_polyPtsClient.size() >= 3 && NearPoint(p, g_polyPtsClient.front(), 10)) {
-                PolygonFinalize(hwnd);
-                return 0;
-            }
+// Previews verbergen zolang de overlay er is (anders staan ze in de volgende capture).
+static void SessionsShow(bool show) {
+    for (const auto& s : g_sessions.items) {
+        if (s->hwnd) ShowWindow(s->hwnd, show ? SW_SHOWNOACTIVATE : SW_HIDE);
+    }
+}
 
-            PolyAddPoint(p);
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return 0;
-        }
+// Terugzetten gebeurt via g_hwndMsg: direct na DestroyOverlay kan nog een burst,
+// opname of scroll-capture starten, en die mogen de previews niet meenemen.
+static void SessionsShowLater() {
+    if (g_hwndMsg) PostMessageW(g_hwndMsg, WM_SESSIONS_SHOW, 0, 0);
+}
 
-        if (g_mode == Mode::Freestyle) {
-            SetCapture(hwnd);
-            LassoReset();
-            g_lassoSelecting = true;
+static void AnnotReset(CaptureSession& ses) {
+    ses.annot.scene.shapes.clear();
+    ses.annot.base.clear();
+    ses.annot.base.shrink_to_fit();
+    ses.annot.bmp = nullptr;
+    ses.annot.w = ses.annot.h = 0;
+    ses.annot.active = -1;
+    ses.annot.moving = false;
+    ses.annot.redacting = false;
+}
 
-            POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-            LassoAddPoint(p);
+// Top-down view op de capture-DIB.
+static bool AnnotCaptureView(const CaptureSession& ses, uint8_t*& outTop, ptrdiff_t& outStride, int& outW, int& outH) {
+    return DibTopDownView(ses.bmp, outTop, outStride, outW, outH);
+}
 
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return 0;
-        }
+// Base bij de bitmap van de sessie (pas bij de eerste shape of redactie).
+static bool AnnotEnsureBase(CaptureSession& ses) {
+    if (ses.annot.bmp == ses.bmp && !ses.annot.base.empty()) return true;
+    AnnotReset(ses);
 
-        if (g_mode != Mode::Region) return 0;
+    uint8_t* top = nullptr; ptrdiff_t stride = 0; int w = 0, h = 0;
+    if (!AnnotCaptureView(ses, top, stride, w, h)) return false;
 
-        ClearHover();
-        SetCapture(hwnd);
-        g_selecting = true;
-        g_hasSelection = false;
-        g_selStart = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-        g_selCur = g_selStart;
-        g_selRectClient = MakeNormalizedRect(g_selStart, g_selCur);
-        InvalidateRect(hwnd, nullptr, TRUE);
-        return 0;
+    GdiFlush();
+    const size_t rowBytes = (size_t)w * 4;
+    ses.annot.base.resize(rowBytes * (size_t)h);
+    for (int y = 0; y < h; ++y) std::memcpy(ses.annot.base.data() + rowBytes * (size_t)y, top + (ptrdiff_t)y * stride, rowBytes);
+    ses.annot.bmp = ses.bmp;
+    ses.annot.w = w;
+    ses.annot.h = h;
+    return true;
+}
 
-    case WM_MOUSEMOVE: {
-        POINT newPt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+// Waar de capture in de preview staat (zelfde schaal als WM_PAINT).
+static bool PreviewImageDestRect(const CaptureSession& ses, RECT& out, int& outIw, int& outIh) {
+    if (!ses.bmp) return false;
+    BITMAP bm{};
+    GetObjectW(ses.bmp, sizeof(bm), &bm);
 
-        RECT r1{};
-        if (g_cursorValid) r1 = CursorDirtyRect(g_cursorPt);
+    const int iw = bm.bmWidth;
+    const int ih = bm.bmHeight < 0 ? -bm.bmHeight : bm.bmHeight;
+    const int aw = ses.rcImage.right - ses.rcImage.left;
+    const int ah = ses.rcImage.bottom - ses.rcImage.top;
+    if (iw <= 0 || ih <= 0 || aw <= 0 || ah <= 0) return false;
 
-        g_cursorPt = newPt;
-        g_cursorValid = true;
+    const double sx = (double)aw / (double)iw;
+    const double sy = (double)ah / (double)ih;
+    double s = (sx < sy) ? sx : sy;
+    if (s > 1.0) s = 1.0;
 
-        RECT r2 = CursorDirtyRect(g_cursorPt);
+    const int dw = (int)(iw * s);
+    const int dh = (int)(ih * s);
+    out.left = ses.rcImage.left + (aw - dw) / 2;
+    out.top = ses.rcImage.top + (ah - dh) / 2;
+    out.right = out.left + dw;
+    out.bottom = out.top + dh;
+    outIw = iw;
+    outIh = ih;
+    return dw > 0 && dh > 0;
+}
 
-        // mouse-leave aanzetten (zodat cursor verdwijnt als je overlay verlaat)
-        if (!g_trackLeave) {
-            TRACKMOUSEEVENT tme{};
-            tme.cbSize = sizeof(tme);
-            tme.dwFlags = TME_LEAVE;
-            tme.hwndTrack = hwnd;
-            TrackMouseEvent(&tme);
-            g_trackLeave = true;
-        }
+static bool PreviewClientToImage(const CaptureSession& ses, POINT p, int& ix, int& iy) {
+    RECT d{}; int iw = 0, ih = 0;
+    if (!PreviewImageDestRect(ses, d, iw, ih)) return false;
+    ix = (int)((long long)(p.x - d.left) * iw / (d.right - d.left));
+    iy = (int)((long long)(p.y - d.top) * ih / (d.bottom - d.top));
+    ix = std::clamp(ix, 0, iw - 1);
+    iy = std::clamp(iy, 0, ih - 1);
+    return true;
+}
 
-        // repaint alleen oude + nieuwe cursor-plek
-        InvalidateRect(hwnd, &r2, FALSE);
-        if (r1.right > r1.left) InvalidateRect(hwnd, &r1, FALSE);
+// Image-rect -> client-rect (ruim afgerond) en alleen dat stuk opnieuw tekenen.
+static void PreviewInvalidateImageRect(const CaptureSession& ses, const PixRect& r) {
+    RECT d{}; int iw = 0, ih = 0;
+    if (r.Empty() || !PreviewImageDestRect(ses, d, iw, ih)) return;
+    const int dw = d.right - d.left, dh = d.bottom - d.top;
+    RECT c{};
+    c.left = d.left + (int)((long long)r.x0 * dw / iw) - 2;
+    c.top = d.top + (int)((long long)r.y0 * dh / ih) - 2;
+    c.right = d.left + (int)(((long long)r.x1 * dw + iw - 1) / iw) + 2;
+    c.bottom = d.top + (int)(((long long)r.y1 * dh + ih - 1) / ih) + 2;
+    InvalidateRect(ses.hwnd, &c, FALSE);
+}
 
-        if (g_mode == Mode::Polygon && g_polySelecting) {
-            POINT raw{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-            POINT h = raw;
+static void AnnotApplyDamage(CaptureSession& ses, const PixRect& damage) {
+    uint8_t* top = nullptr; ptrdiff_t stride = 0; int w = 0, h = 0;
+    if (damage.Empty() || !AnnotCaptureView(ses, top, stride, w, h)) return;
+    if (w != ses.annot.w || h != ses.annot.h) return;
 
-            if (!g_polyPtsClient.empty() && IsShiftDown()) {
-                h = SnapPoint45(g_polyPtsClient.back(), raw);
-            }
+    GdiFlush();
+    const auto t0 = std::chrono::steady_clock::now();
+    AnnotRecomposite(ses.annot.scene, ses.annot.base.data(), (ptrdiff_t)w * 4, top, stride, w, h, damage);
+    DebugLog(L"annot recomposite %dx%d: %.3f ms", damage.Width(), damage.Height(), MsSince(t0));
+    PreviewInvalidateImageRect(ses, damage);
+}
 
-            g_polyHoverClient = h;
-            g_polyHoverValid = true;
+// Dikte in image-pixels: ongeveer even dik op het scherm, ongeacht de preview-schaal.
+static int AnnotThicknessForPreview(const CaptureSession& ses) {
+    RECT d{}; int iw = 0, ih = 0;
+    if (!PreviewImageDestRect(ses, d, iw, ih)) return 4;
+    const double s = (double)(d.right - d.left) / (double)iw;
+    return std::clamp((int)std::lround(3.0 / s), 2, 64);
+}
 
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return 0;
-        }
+// Na elke afgeronde bewerking: clipboard + hash volgen het nieuwe composiet.
+static void AnnotCommit(CaptureSession& ses) {
+    ses.unsaved = true;
+    const bool clipOk = ses.hasAlpha ? CopyBitmapToClipboardAlphaV5(ses.bmp) : CopyBitmapToClipboard(ses.bmp);
+    if (!clipOk) MessageBeep(MB_ICONWARNING);
+    SessionUpdateHash(ses);
+    ses.tempEditFile.clear(); // "Open in" moet de geannoteerde versie schrijven
+
+    // pre-encode hoort bij de oude pixels; opnieuw zodra er even niets gebeurt
+    PreEncodeCancel(ses.preEncode);
+    SetTimer(ses.hwnd, TIMER_PREENCODE, 700, nullptr);
+}
 
-        if (g_mode == Mode::Freestyle && g_lassoSelecting) {
-            POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-            LassoAddPoint(p);
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return 0;
-        }
+static void AnnotSetTool(CaptureSession& ses, int tool) {
+    ses.annot.tool = tool;
+    switch (tool) {
+    case (int)AnnotKind::Arrow:     SetStatus(ses, L"Tool: Arrow"); break;
+    case (int)AnnotKind::Box:       SetStatus(ses, L"Tool: Box"); break;
+    case (int)AnnotKind::Highlight: SetStatus(ses, L"Tool: Highlight"); break;
+    case kAnnotToolPixelate:        SetStatus(ses, L"Tool: Pixelate (redact)"); break;
+    case kAnnotToolBlur:            SetStatus(ses, L"Tool: Blur (redact)"); break;
+    default:                        SetStatus(ses, L"Tool: none"); break;
+    }
+}
 
-        // Region: rubberband rectangle
-        if (g_mode == Mode::Region) {
-            if (!g_selecting) return 0;
-            g_selCur = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-            g_selRectClient = MakeNormalizedRect(g_selStart, g_selCur);
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return 0;
-        }
+static void AnnotUndo(CaptureSession& ses) {
+    if (ses.annot.bmp != ses.bmp || ses.annot.scene.shapes.empty()) return;
+    const PixRect dmg = AnnotBounds(ses.annot.scene.shapes.back());
+    ses.annot.scene.shapes.pop_back();
+    ses.annot.active = -1;
+    AnnotApplyDamage(ses, dmg);
+    AnnotCommit(ses);
+}
 
-        // Window/Monitor: hover highlight under cursor
-        POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-        ClientToScreen(hwnd, &pt);
+static void AnnotClear(CaptureSession& ses) {
+    if (ses.annot.bmp != ses.bmp || ses.annot.scene.shapes.empty()) return;
+    PixRect dmg{};
+    for (const AnnotShape& s : ses.annot.scene.shapes) dmg = PixRectUnion(dmg, AnnotBounds(s));
+    ses.annot.scene.shapes.clear();
+    ses.annot.active = -1;
+    AnnotApplyDamage(ses, dmg);
+    AnnotCommit(ses);
+}
 
-        if (g_mode == Mode::Window) {
-            RECT wr{};
-            HWND h = PickTopWindowAtPoint(pt, wr);
-            if (h) SetHoverFromScreenRect(hwnd, h, wr);
-            else ClearHover();
-        }
-        else if (g_mode == Mode::Monitor) {
-            RECT mr{};
-            if (GetMonitorRectAtPoint(pt, mr)) SetHoverFromScreenRect(hwnd, nullptr, mr);
-            else ClearHover();
+// Ctrl = bestaande shape verplaatsen, anders nieuwe shape met het huidige tool.
+static bool AnnotBeginDrag(CaptureSession& ses, POINT clientPt) {
+    int ix = 0, iy = 0;
+    if (!PreviewClientToImage(ses, clientPt, ix, iy)) return false;
+
+    const bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+    if (ctrl) {
+        if (ses.annot.bmp != ses.bmp) return false;
+        const int hit = AnnotHitTest(ses.annot.scene, ix, iy);
+        if (hit < 0) return false;
+        ses.annot.active = hit;
+        ses.annot.moving = true;
+        ses.annot.orig = ses.annot.scene.shapes[(size_t)hit];
+    }
+    else if (ses.annot.tool == kAnnotToolPixelate || ses.annot.tool == kAnnotToolBlur) {
+        ses.annot.redacting = true;
+        ses.annot.redactRect = PixRect{ ix, iy, ix, iy };
+    }
+    else {
+        if (ses.annot.tool < 0 || !AnnotEnsureBase(ses)) return false;
+        AnnotShape s{};
+        s.kind = (AnnotKind)ses.annot.tool;
+        s.x0 = s.x1 = ix;
+        s.y0 = s.y1 = iy;
+        s.thickness = AnnotThicknessForPreview(ses);
+        s.color = (s.kind == AnnotKind::Highlight) ? 0xFFFFEB3Bu : 0xFFE53935u;
+        ses.annot.scene.shapes.push_back(s);
+        ses.annot.active = (int)ses.annot.scene.shapes.size() - 1;
+        ses.annot.moving = false;
+    }
+    ses.annot.anchorX = ix;
+    ses.annot.anchorY = iy;
+    SetCapture(ses.hwnd);
+    return true;
+}
+
+static bool AnnotDragging(const CaptureSession& ses) {
+    return ses.annot.active >= 0 || ses.annot.redacting;
+}
+
+// Sleeprechthoek in image coords (inclusief de pixel onder de cursor).
+static PixRect AnnotRedactSelection(const CaptureSession& ses) {
+    const PixRect& r = ses.annot.redactRect;
+    return { std::min(r.x0, r.x1), std::min(r.y0, r.y1), std::max(r.x0, r.x1) + 1, std::max(r.y0, r.y1) + 1 };
+}
+
+static void AnnotDragTo(CaptureSession& ses, POINT clientPt) {
+    int ix = 0, iy = 0;
+    if (!AnnotDragging(ses) || !PreviewClientToImage(ses, clientPt, ix, iy)) return;
+
+    if (ses.annot.redacting) {
+        const PixRect before = AnnotRedactSelection(ses);
+        ses.annot.redactRect.x1 = ix;
+        ses.annot.redactRect.y1 = iy;
+        PreviewInvalidateImageRect(ses, PixRectUnion(before, AnnotRedactSelection(ses)));
+        return;
+    }
+
+    AnnotShape& s = ses.annot.scene.shapes[(size_t)ses.annot.active];
+    const PixRect before = AnnotBounds(s);
+    if (ses.annot.moving) {
+        const int dx = ix - ses.annot.anchorX, dy = iy - ses.annot.anchorY;
+        s.x0 = ses.annot.orig.x0 + dx; s.x1 = ses.annot.orig.x1 + dx;
+        s.y0 = ses.annot.orig.y0 + dy; s.y1 = ses.annot.orig.y1 + dy;
+    }
+    else {
+        s.x1 = ix;
+        s.y1 = iy;
+    }
+    AnnotApplyDamage(ses, PixRectUnion(before, AnnotBounds(s)));
+}
+
+// Pixelate/blur in base, daarna dat stuk opnieuw samenstellen (shapes blijven erboven).
+static void DiffInvalidate(CaptureSession& ses);
+
+static void AnnotRedact(CaptureSession& ses, const PixRect& r, bool blur) {
+    if (r.Width() < 2 || r.Height() < 2 || !AnnotEnsureBase(ses)) return;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    if (blur) BlurRect(ses.annot.base.data(), (ptrdiff_t)ses.annot.w * 4, ses.annot.w, ses.annot.h, r, kRedactSigma);
+    else PixelateRect(ses.annot.base.data(), (ptrdiff_t)ses.annot.w * 4, ses.annot.w, ses.annot.h, r, kRedactBlock);
+    DebugLog(L"redact %s %dx%d: %.2f ms", blur ? L"blur" : L"pixelate", r.Width(), r.Height(), MsSince(t0));
+
+    DiffInvalidate(ses);   // heat-map toont nog de pixels van voor de redactie
+    AnnotApplyDamage(ses, r);
+    AnnotCommit(ses);
+    SetStatus(ses, blur ? L"Blurred (copied)" : L"Pixelated (copied)");
+}
+
+static void AnnotEndDrag(CaptureSession& ses) {
+    if (ses.annot.redacting) {
+        const PixRect r = AnnotRedactSelection(ses);
+        ses.annot.redacting = false;
+        ReleaseCapture();
+        PreviewInvalidateImageRect(ses, r);
+        AnnotRedact(ses, r, ses.annot.tool == kAnnotToolBlur);
+        return;
+    }
+    if (ses.annot.active < 0) return;
+    const AnnotShape s = ses.annot.scene.shapes[(size_t)ses.annot.active];
+    ses.annot.active = -1;
+    ReleaseCapture(); // WM_CAPTURECHANGED ziet active == -1
+    // klik zonder slepen: geen lege shape achterlaten
+    if (!ses.annot.moving && s.x0 == s.x1 && s.y0 == s.y1) {
+        ses.annot.scene.shapes.pop_back();
+        AnnotApplyDamage(ses, AnnotBounds(s));
+        return;
+    }
+    AnnotCommit(ses);
+    SetStatus(ses, L"Copied (annotated)");
+}
+
+static void ShowAnnotateMenu(CaptureSession& ses) {
+    const bool any = (ses.annot.bmp == ses.bmp) && !ses.annot.scene.shapes.empty();
+    HMENU menu = CreatePopupMenu();
+    AppendMenuW(menu, MF_STRING | (ses.annot.tool == (int)AnnotKind::Arrow ? MF_CHECKED : 0), 2201, L"Arrow\tA");
+    AppendMenuW(menu, MF_STRING | (ses.annot.tool == (int)AnnotKind::Box ? MF_CHECKED : 0), 2202, L"Box\tB");
+    AppendMenuW(menu, MF_STRING | (ses.annot.tool == (int)AnnotKind::Highlight ? MF_CHECKED : 0), 2203, L"Highlight\tH");
+    AppendMenuW(menu, MF_STRING | (ses.annot.tool == kAnnotToolPixelate ? MF_CHECKED : 0), 2207, L"Pixelate (redact)\tP");
+    AppendMenuW(menu, MF_STRING | (ses.annot.tool == kAnnotToolBlur ? MF_CHECKED : 0), 2208, L"Blur (redact)\tU");
+    AppendMenuW(menu, MF_STRING | (ses.annot.tool < 0 ? MF_CHECKED : 0), 2204, L"No tool (drag window)");
+    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    AppendMenuW(menu, MF_STRING | (any ? 0 : MF_GRAYED), 2205, L"Undo\tCtrl+Z");
+    AppendMenuW(menu, MF_STRING | (any ? 0 : MF_GRAYED), 2206, L"Clear annotations");
+    AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    AppendMenuW(menu, MF_STRING | (ses.diffShown ? MF_CHECKED : 0), 2209, L"Diff with previous\tD");
+    AppendMenuW(menu, MF_STRING, 2210, L"Find similar captures\tF");
+
+    POINT pt{};
+    GetCursorPos(&pt);
+    TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_NOANIMATION, pt.x, pt.y, 0, ses.hwnd, nullptr);
+    DestroyMenu(menu);
+}
+
+// =========================================================
+// Preview layout + lifecycle
+// =========================================================
+static void LayoutPreview(CaptureSession& ses) {
+    RECT rc{};
+    GetClientRect(ses.hwnd, &rc);
+
+    const int pad = 12;
+    const int barH = 52;       // knoppenbalk
+    const int statusH = 22;    // statusbar onderaan
+    const int btnW = 110;
+    const int btnH = 34;
+    const int gap = 10;
+
+    // statusbar (hele onderrand)
+    ses.rcStatus = rc;
+    ses.rcStatus.top = rc.bottom - statusH;
+
+    // image area
+    ses.rcImage = rc;
+    ses.rcImage.left += pad;
+    ses.rcImage.top += pad;
+    ses.rcImage.right -= pad;
+    ses.rcImage.bottom -= (barH + statusH + pad);
+
+    // buttons (boven statusbar)
+    int totalW = btnW * 3 + gap * 2;
+    int x0 = (rc.right - totalW) / 2;
+    int y0 = rc.bottom - statusH - barH + (barH - btnH) / 2;
+
+    ses.btnSave = { x0,                      y0, x0 + btnW,                   y0 + btnH };
+    ses.btnEdit = { x0 + (btnW + gap) * 1,   y0, x0 + (btnW + gap) * 1 + btnW, y0 + btnH };
+    ses.btnDismiss = { x0 + (btnW + gap) * 2,   y0, x0 + (btnW + gap) * 2 + btnW, y0 + btnH };
+}
+
+static void DestroyOverlay();
+static void DiffToggle(CaptureSession& ses);
+static void DiffRememberClosed(CaptureSession& ses);
+static void SimilarFindFor(CaptureSession& ses);
+static void SimilarRecordSave(const CaptureSession& ses, const std::wstring& path);
+static void RecompressEnqueue(const std::wstring& path);
+static void CatalogRecordSave(const CaptureSession& ses, const std::wstring& path, SaveFormat fmt);
+
+// Sluit het venster; WM_NCDESTROY geeft de sessie vrij (ses is daarna ongeldig).
+static void DestroyPreview(CaptureSession& ses) {
+    if (ses.hwnd && DestroyWindow(ses.hwnd)) return;
+    SessionTake(g_sessions, ses.id);
+}
+
+static void DestroyAllPreviews() {
+    while (!g_sessions.items.empty()) DestroyPreview(*g_sessions.items.back());
+}
+
+// [Preview] X/Y/W/H: één keer uit de INI, daarna bijgehouden bij verplaatsen/resizen
+// (CreatePreviewWindow hoeft dan niet per capture vier keys te lezen).
+struct PreviewPlacement {
+    bool loaded = false;
+    int x = INT_MIN, y = INT_MIN, w = INT_MIN, h = INT_MIN;   // INT_MIN = niet opgeslagen
+};
+static PreviewPlacement g_previewPlacement;
+
+static const PreviewPlacement& PreviewPlacementCached() {
+    PreviewPlacement& p = g_previewPlacement;
+    if (!p.loaded) {
+        p.loaded = true;
+        p.x = IniReadInt(L"Preview", L"X", INT_MIN);
+        p.y = IniReadInt(L"Preview", L"Y", INT_MIN);
+        p.w = IniReadInt(L"Preview", L"W", INT_MIN);
+        p.h = IniReadInt(L"Preview", L"H", INT_MIN);
+    }
+    return p;
+}
+
+static void PreviewPlacementRemember(const RECT& wr) {
+    g_previewPlacement = { true, (int)wr.left, (int)wr.top, (int)(wr.right - wr.left), (int)(wr.bottom - wr.top) };
+}
+
+// =========================================================
+// Preview WindowProc
+// =========================================================
+// Save-knop (en het command-kanaal). true = opgeslagen of al aanwezig (outPath = dat
+// bestand). De preview blijft open; sluiten is aan de aanroeper.
+static bool SaveSession(CaptureSession& ses, std::wstring* outPath) {
+    if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
+
+    const bool forcePng = ses.hasAlpha;
+    SaveFormat actual = forcePng ? SaveFormat::Png : g_saveFormat;
+    const int requestedFmt = (int)actual;
+
+    // zelfde pixels + formaat al in deze map? Dan geen tweede encode/bestand.
+    std::wstring dupPath;
+    if (ses.hashValid) {
+        const auto t0 = std::chrono::steady_clock::now();
+        const bool dup = FindDuplicateCapture(ses.hash, requestedFmt, g_saveDir, dupPath);
+        DebugLog(L"duplicate lookup: %.3f ms (%zu entries)", MsSince(t0), g_hashIndex.size());
+        if (dup) {
+            ses.unsaved = false;
+            g_lastSavedFile = dupPath;
+            SaveSettings();
+
+            const size_t slash = dupPath.find_last_of(L"\\/");
+            SetStatus(ses, L"Duplicate of " + (slash == std::wstring::npos ? dupPath : dupPath.substr(slash + 1)));
+            if (outPath) *outPath = dupPath;
+            return true;
         }
-        else {
-            // Freestyle: later
-            ClearHover();
+    }
+
+    const auto tSave = std::chrono::steady_clock::now();
+
+    // al speculatief ge-encodeerd (zelfde pixels + formaat)? Dan alleen nog bytes wegschrijven.
+    std::shared_ptr<PreEncodeJob> pre = ses.hashValid ? PreEncodeWaitForSave(ses.preEncode, ses.hash, actual) : nullptr;
+    if (pre && !pre->saveOk) pre.reset();
+
+    // Auto: kies PNG-8 / PNG / JPEG op basis van de inhoud
+    AutoChoice autoChoice{};
+    const bool isAuto = (actual == SaveFormat::Auto);
+    if (isAuto) {
+        autoChoice = pre ? pre->autoChoice : ChooseAutoFormat(ses.bmp, ses.hasAlpha);
+        actual = autoChoice.fmt;
+    }
+
+    // naam volgens preset (kan een datummap bevatten, bv "2026-02-23\\snip_0001.png"),
+    // exclusief gereserveerd: nooit een bestaand bestand overschrijven
+    const auto tName = std::chrono::steady_clock::now();
+    std::wstring filePath;
+    if (!ReserveSavePath(g_saveDir, actual, filePath)) {
+        SetStatus(ses, L"Save failed");
+        return false;
+    }
+    DebugLog(L"name reserve: %.3f ms", MsSince(tName));
+
+    bool savedIndexed = false;
+    bool saved = false;
+    if (pre) {
+        saved = WriteWholeFile(filePath, pre->bytes.data(), pre->bytes.size());
+        savedIndexed = pre->indexed;
+    }
+    else {
+        saved = isAuto
+            ? SaveBitmapAuto(ses.bmp, filePath, autoChoice, &savedIndexed)
+            : SaveBitmapFile(ses.bmp, filePath, actual);
+    }
+    DebugLog(L"save latency: %.1f ms (%s)", MsSince(tSave), pre ? L"pre-encoded" : L"encoded on click");
+
+    if (saved) {
+        ses.unsaved = false;
+        g_lastSavedFile = filePath;
+        SaveSettings();
+        if (ses.hashValid) RecordSavedCapture(ses.hash, requestedFmt, filePath);
+        if (actual == SaveFormat::Png) RecompressEnqueue(filePath); // na het duplicate-index (grootte)
+        CatalogRecordSave(ses, filePath, actual);
+        SimilarRecordSave(ses, filePath);
+
+        std::wstring statusText = L"Saved ";
+        statusText += savedIndexed ? L"PNG-8" : SaveFormatText(actual);
+        if (isAuto) statusText += L" (auto)";
+        SetStatus(ses, statusText);
+        if (outPath) *outPath = filePath;
+    }
+    else {
+        DeleteFileW(filePath.c_str()); // gereserveerde (lege) naam vrijgeven
+        SetStatus(ses, L"Save failed");
+    }
+    return saved;
+}
+
+static LRESULT CALLBACK PreviewProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    if (msg == WM_NCCREATE) {
+        // reserve-preview: nog zonder sessie (die komt pas bij CreatePreviewWindow)
+        if (CaptureSession* created = (CaptureSession*)((CREATESTRUCTW*)lParam)->lpCreateParams) {
+            created->hwnd = hwnd;
+            SetWindowLongPtrW(hwnd, GWLP_USERDATA, (LONG_PTR)created);
         }
+    }
+    CaptureSession* sp = SessionFromHwnd(hwnd);
+    if (!sp) return DefWindowProcW(hwnd, msg, wParam, lParam);
+    CaptureSession& ses = *sp;
+
+    switch (msg) {
+    case WM_CREATE:
+        LayoutPreview(ses);
+        return 0;
 
+    case WM_SIZE:
+        LayoutPreview(ses);
         InvalidateRect(hwnd, nullptr, TRUE);
         return 0;
+
+    case WM_TIMER:
+        if (wParam == TIMER_STATUS_CLEAR) {
+            KillTimer(hwnd, TIMER_STATUS_CLEAR);
+            ses.statusText.clear();
+            InvalidateRect(hwnd, nullptr, TRUE);
+        }
+        if (wParam == TIMER_PREENCODE) {
+            KillTimer(hwnd, TIMER_PREENCODE);
+            if (!AnnotDragging(ses)) SessionPreEncode(ses);
+            else SetTimer(hwnd, TIMER_PREENCODE, 700, nullptr);
+        }
+        return 0;
+
+    case WM_PREVIEW_PREENCODE:
+        SessionPreEncode(ses);
+        return 0;
+
+    case WM_KEYDOWN:
+        if (wParam == VK_ESCAPE) { DestroyPreview(ses); return 0; }
+        if (wParam == 'Z' && (GetKeyState(VK_CONTROL) & 0x8000)) { AnnotUndo(ses); return 0; }
+        if (wParam == 'A') { AnnotSetTool(ses, ses.annot.tool == (int)AnnotKind::Arrow ? -1 : (int)AnnotKind::Arrow); return 0; }
+        if (wParam == 'B') { AnnotSetTool(ses, ses.annot.tool == (int)AnnotKind::Box ? -1 : (int)AnnotKind::Box); return 0; }
+        if (wParam == 'H') { AnnotSetTool(ses, ses.annot.tool == (int)AnnotKind::Highlight ? -1 : (int)AnnotKind::Highlight); return 0; }
+        if (wParam == 'P') { AnnotSetTool(ses, ses.annot.tool == kAnnotToolPixelate ? -1 : kAnnotToolPixelate); return 0; }
+        if (wParam == 'U') { AnnotSetTool(ses, ses.annot.tool == kAnnotToolBlur ? -1 : kAnnotToolBlur); return 0; }
+        if (wParam == 'D') { DiffToggle(ses); return 0; }
+        if (wParam == 'F') { SimilarFindFor(ses); return 0; }
+        return 0;
+
+    case WM_SETCURSOR: {
+        // Windows geeft in lParam de hit-test code mee (HTCLIENT / HTCAPTION / etc.)
+        const WORD ht = LOWORD(lParam);
+
+        // Als wij sleepgebied teruggeven als HTCAPTION -> maak cursor een handje
+        if (ht == HTCAPTION) {
+            SetCursor(LoadCursorW(nullptr, IDC_HAND));
+            return TRUE;
+        }
+
+        // Als het client-area is (buttons), ook handje
+        if (ht == HTCLIENT) {
+            POINT pt{};
+            GetCursorPos(&pt);
+            ScreenToClient(hwnd, &pt);
+
+            if (PtInRectEx(ses.btnSave, pt) || PtInRectEx(ses.btnEdit, pt) || PtInRectEx(ses.btnDismiss, pt)) {
+                SetCursor(LoadCursorW(nullptr, IDC_HAND));
+                return TRUE;
+            }
+
+            // Image met annotatie-tool (of Ctrl = verplaatsen)
+            RECT img{}; int iw = 0, ih = 0;
+            if (PreviewImageDestRect(ses, img, iw, ih) && PtInRectEx(img, pt)) {
+                const bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+                SetCursor(LoadCursorW(nullptr, ctrl ? IDC_SIZEALL : IDC_CROSS));
+                return TRUE;
+            }
+
+            // Overige client-area: normale pijl
+            SetCursor(LoadCursorW(nullptr, IDC_ARROW));
+            return TRUE;
+        }
+
+        return DefWindowProcW(hwnd, msg, wParam, lParam);
+    }
+
+    // === drag window by clicking anywhere except buttons
+    case WM_NCHITTEST: {
+        LRESULT hit = DefWindowProcW(hwnd, msg, wParam, lParam);
+        if (hit != HTCLIENT) return hit;
+
+        POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        ScreenToClient(hwnd, &pt);
+
+        if (PtInRectEx(ses.btnSave, pt) || PtInRectEx(ses.btnEdit, pt) || PtInRectEx(ses.btnDismiss, pt)) {
+            return HTCLIENT;
+        }
+
+        // annoteren: tool actief, of Ctrl boven de image om een shape te verplaatsen
+        RECT img{}; int iw = 0, ih = 0;
+        if (PreviewImageDestRect(ses, img, iw, ih) && PtInRectEx(img, pt)) {
+            const bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+            if (ses.annot.tool >= 0 || (ctrl && ses.annot.bmp == ses.bmp && !ses.annot.scene.shapes.empty())) return HTCLIENT;
+        }
+        return HTCAPTION;
+    }
+
+    // === remember position/size after move/resize
+    case WM_EXITSIZEMOVE: {
+        RECT wr{};
+        GetWindowRect(hwnd, &wr);
+        PreviewPlacementRemember(wr);
+        IniWriteInt(L"Preview", L"X", wr.left);
+        IniWriteInt(L"Preview", L"Y", wr.top);
+        IniWriteInt(L"Preview", L"W", wr.right - wr.left);
+        IniWriteInt(L"Preview", L"H", wr.bottom - wr.top);
+        return 0;
+    }
+
+    case WM_LBUTTONDOWN: {
+        POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        RECT img{}; int iw = 0, ih = 0;
+        if (ses.diffShown && PreviewImageDestRect(ses, img, iw, ih) && PtInRectEx(img, p)) { DiffToggle(ses); return 0; }
+        if (PreviewImageDestRect(ses, img, iw, ih) && PtInRectEx(img, p)) AnnotBeginDrag(ses, p);
+        return 0;
     }
 
+    case WM_MOUSEMOVE:
+        if (AnnotDragging(ses)) AnnotDragTo(ses, POINT{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) });
+        return 0;
+
+    case WM_CAPTURECHANGED:
+        if (AnnotDragging(ses)) AnnotEndDrag(ses);
+        return 0;
+
     case WM_LBUTTONUP: {
-        if (g_mode == Mode::Polygon) {
+        POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+
+        if (AnnotDragging(ses)) {
+            AnnotDragTo(ses, p);
+            AnnotEndDrag(ses);
             return 0;
         }
-        if (g_mode == Mode::Freestyle && g_lassoSelecting) {
-            ReleaseCapture();
-            g_lassoSelecting = false;
 
-            if (g_lassoPtsClient.size() < 3) {
-                MessageBeep(MB_ICONWARNING);
-                LassoReset();
-                InvalidateRect(hwnd, nullptr, TRUE);
+        // Save
+        if (PtInRectEx(ses.btnSave, p)) {
+            if (SaveSession(ses, nullptr) && g_autoDismissAfterSave) DestroyPreview(ses);
+            return 0;
+        }
+
+        // Edit (open in chosen program)
+        if (PtInRectEx(ses.btnEdit, p)) {
+            // 1) Zorg dat we een editor hebben
+            if (g_editorExe.empty()) {
+                std::wstring exe;
+                if (!PickExe(hwnd, exe)) { SetStatus(ses, L"Canceled"); return 0; }
+                g_editorExe = exe;
+                SaveSettings();
+            }
+
+            // 2) HUIDIGE capture als temp bestand (zelfde pixels: bestaand bestand hergebruiken)
+            SaveFormat tmpFmt = ses.hasAlpha ? SaveFormat::Png : SaveFormat::Bmp;
+
+            std::wstring tempPath;
+            bool reused = false;
+            const auto t0 = std::chrono::steady_clock::now();
+            PreEncodeWaitForEdit(ses.preEncode, ses.hash); // loopt de pre-encode nog: die schrijft dit bestand al
+            if (!TempEditFileForSession(ses, tmpFmt, tempPath, &reused)) {
+                SetStatus(ses, L"Save failed");
                 return 0;
             }
+            DebugLog(L"edit temp %s: %.2f ms", reused ? L"reused" : L"written", MsSince(t0));
+            ses.tempEditFile = tempPath;
 
-            // bounds iets ruimer
-            RECT b = g_lassoBoundsClient;
-            b.left -= 2; b.top -= 2; b.right += 2; b.bottom += 2;
 
-            if ((b.right - b.left) < 5 || (b.bottom - b.top) < 5) {
-                MessageBeep(MB_ICONWARNING);
-                LassoReset();
-                InvalidateRect(hwnd, nullptr, TRUE);
-                return 0;
-            }
+            // 3) Open temp in editor
+            PreviewDropTopmost(hwnd);   // (als je die helper al hebt)
+            if (OpenInEditor(g_editorExe, ses.tempEditFile)) SetStatus(ses, L"Opened");
+            else SetStatus(ses, L"Open failed");
+
+            return 0;
+        }
+
+        // Dismiss
+        if (PtInRectEx(ses.btnDismiss, p)) {
+            DestroyPreview(ses);
+            return 0;
+        }
+
+        return 0;
+    }
+
+    case WM_RBUTTONUP: {
+        POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        if (PtInRectEx(ses.btnSave, p)) { ShowSaveMenu(hwnd); return 0; }
+        if (PtInRectEx(ses.btnEdit, p)) { ShowEditMenu(hwnd); return 0; }
+
+        RECT img{}; int iw = 0, ih = 0;
+        if (PreviewImageDestRect(ses, img, iw, ih) && PtInRectEx(img, p)) ShowAnnotateMenu(ses);
+        return 0;
+    }
+
+    // rechtsklik op de image zonder tool (HTCAPTION) komt hier binnen
+    case WM_CONTEXTMENU: {
+        POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        ScreenToClient(hwnd, &p);
+        RECT img{}; int iw = 0, ih = 0;
+        if (PreviewImageDestRect(ses, img, iw, ih) && PtInRectEx(img, p)) { ShowAnnotateMenu(ses); return 0; }
+        return DefWindowProcW(hwnd, msg, wParam, lParam);
+    }
+
+    case WM_COMMAND: {
+        switch (LOWORD(wParam)) {
+        case 2001: { // open capture folder
+            PreviewDropTopmost(hwnd);
+            if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
+            OpenPath(g_saveDir);
+            return 0;
+        }
+        case 2003: { // choose capture folder
+            PreviewDropTopmost(hwnd);
+            std::wstring picked;
+            std::wstring start = g_saveDir.empty() ? DefaultSaveDir() : g_saveDir;
+            if (PickFolder(hwnd, start, picked)) {
+                g_saveDir = picked;
+                EnsureDirectoryRecursive(g_saveDir + L"\\");
+                SaveSettings();
+                SetStatus(ses, L"Folder set");
+            }
+            else {
+                SetStatus(ses, L"Canceled");
+            }
+            return 0;
+        }
+        case 2002: { // toggle auto-dismiss
+            PreviewDropTopmost(hwnd);
+            g_autoDismissAfterSave = !g_autoDismissAfterSave;
+            SaveSettings();
+            return 0;
+        }
+
+        case 2010: g_saveFormat = SaveFormat::Png;  SaveSettings(); SetStatus(ses, L"Format: PNG"); SetTimer(hwnd, TIMER_PREENCODE, 700, nullptr);  return 0;
+        case 2011: g_saveFormat = SaveFormat::Jpeg; SaveSettings(); SetStatus(ses, L"Format: JPEG"); SetTimer(hwnd, TIMER_PREENCODE, 700, nullptr); return 0;
+        case 2012: g_saveFormat = SaveFormat::Bmp;  SaveSettings(); SetStatus(ses, L"Format: BMP"); SetTimer(hwnd, TIMER_PREENCODE, 700, nullptr);  return 0;
+        case 2013: g_saveFormat = SaveFormat::Auto; SaveSettings(); SetStatus(ses, L"Format: Auto"); SetTimer(hwnd, TIMER_PREENCODE, 700, nullptr); return 0;
+
+        case 2201: AnnotSetTool(ses, (int)AnnotKind::Arrow);     return 0;
+        case 2202: AnnotSetTool(ses, (int)AnnotKind::Box);       return 0;
+        case 2203: AnnotSetTool(ses, (int)AnnotKind::Highlight); return 0;
+        case 2204: AnnotSetTool(ses, -1);                        return 0;
+        case 2205: AnnotUndo(ses);  return 0;
+        case 2206: AnnotClear(ses); return 0;
+        case 2207: AnnotSetTool(ses, kAnnotToolPixelate); return 0;
+        case 2208: AnnotSetTool(ses, kAnnotToolBlur);     return 0;
+        case 2209: DiffToggle(ses); return 0;
+        case 2210: SimilarFindFor(ses); return 0;
+
+        case 2102: { // choose program (en meteen openen)
+            PreviewDropTopmost(hwnd);
+
+            std::wstring exe;
+            if (!PickExe(hwnd, exe)) {
+                SetStatus(ses, L"Canceled");
+                return 0;
+            }
+
+            g_editorExe = exe;
+            SaveSettings();
+
+            // Direct dezelfde actie uitvoeren als "Open in (last program)"
+            SendMessageW(hwnd, WM_COMMAND, MAKEWPARAM(2101, 0), 0);
+            return 0;
+        }
+        case 2101: { // Open in (last program) - voorkeur: huidige capture
+            // 1) Zorg dat er een editor gekozen is
+            if (g_editorExe.empty()) {
+                std::wstring exe;
+                if (!PickExe(hwnd, exe)) { SetStatus(ses, L"Canceled"); return 0; }
+                g_editorExe = exe;
+                SaveSettings();
+            }
+            std::wstring target;
+
+            // 2) Probeer eerst het HUIDIGE knipsel (preview) als temp-bestand
+            if (ses.bmp) {
+                SaveFormat tmpFmt = ses.hasAlpha ? SaveFormat::Png : SaveFormat::Bmp;
+
+                // Temp uit de cache: zelfde pixels + formaat -> bestaand bestand, anders nu schrijven
+                PreEncodeWaitForEdit(ses.preEncode, ses.hash);
+                std::wstring tempPath;
+                if (TempEditFileForSession(ses, tmpFmt, tempPath, nullptr)) {
+                    ses.tempEditFile = tempPath;
+                }
+
+                target = ses.tempEditFile;
+            }
+
+            // 3) Fallback: laatst opgeslagen bestand (als er geen capture/temp is)
+            if (target.empty()) target = g_lastSavedFile;
+            if (target.empty()) { SetStatus(ses, L"No file"); return 0; }
+            // 4) Open in editor
+            PreviewDropTopmost(hwnd); // als je die helper al gebruikt
+            if (OpenInEditor(g_editorExe, target)) SetStatus(ses, L"Opened");
+            else SetStatus(ses, L"Open failed");
+
+            return 0;
+        }
+        }
+        return 0;
+    }
+
+    case WM_PAINT: {
+        PAINTSTRUCT ps{};
+        HDC hdc = BeginPaint(hwnd, &ps);
+
+        RECT rc{};
+        GetClientRect(hwnd, &rc);
+
+        // background
+        HBRUSH bg = CreateSolidBrush(RGB(30, 30, 30));
+        FillRect(hdc, &rc, bg);
+        DeleteObject(bg);
+
+        // draw image (scaled to fit)
+        if (ses.bmp) {
+            const bool diff = ses.diffShown && ses.diffBmp;
+            HDC mem = CreateCompatibleDC(hdc);
+            HGDIOBJ old = SelectObject(mem, diff ? ses.diffBmp : ses.bmp);
+
+            RECT dst{}; int iw = 0, ih = 0;
+            PreviewImageDestRect(ses, dst, iw, ih);
+
+            int dw = dst.right - dst.left;
+            int dh = dst.bottom - dst.top;
+
+            int dx = dst.left;
+            int dy = dst.top;
+
+            if (ses.hasAlpha && !diff) {
+                BLENDFUNCTION bf{};
+                bf.BlendOp = AC_SRC_OVER;
+                bf.SourceConstantAlpha = 255;
+                bf.AlphaFormat = AC_SRC_ALPHA;
+
+                AlphaBlend(hdc, dx, dy, dw, dh, mem, 0, 0, iw, ih, bf);
+            }
+            else {
+                SetStretchBltMode(hdc, HALFTONE);
+                StretchBlt(hdc, dx, dy, dw, dh, mem, 0, 0, iw, ih, SRCCOPY);
+            }
+
+            SelectObject(mem, old);
+            DeleteDC(mem);
+
+            // diff: gewijzigde gebieden als kaders (op schermschaal, dus altijd zichtbaar)
+            if (diff && !ses.diffBoxes.empty()) {
+                HPEN pen = CreatePen(PS_SOLID, 2, RGB(255, 40, 40));
+                HGDIOBJ oldPen = SelectObject(hdc, pen);
+                HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+                for (const PixRect& r : ses.diffBoxes) {
+                    Rectangle(hdc, dx + (int)((long long)r.x0 * dw / iw) - 2, dy + (int)((long long)r.y0 * dh / ih) - 2,
+                        dx + (int)(((long long)r.x1 * dw + iw - 1) / iw) + 2, dy + (int)(((long long)r.y1 * dh + ih - 1) / ih) + 2);
+                }
+                SelectObject(hdc, oldBrush);
+                SelectObject(hdc, oldPen);
+                DeleteObject(pen);
+            }
+
+            // redactie-rechthoek tijdens slepen
+            if (ses.annot.redacting) {
+                const PixRect r = AnnotRedactSelection(ses);
+                RECT fr{ dx + (int)((long long)r.x0 * dw / iw), dy + (int)((long long)r.y0 * dh / ih),
+                         dx + (int)((long long)r.x1 * dw / iw), dy + (int)((long long)r.y1 * dh / ih) };
+                if (fr.right <= fr.left) fr.right = fr.left + 1;
+                if (fr.bottom <= fr.top) fr.bottom = fr.top + 1;
+                DrawFocusRect(hdc, &fr);
+            }
+
+            // border
+            HPEN pen = CreatePen(PS_SOLID, 1, RGB(70, 70, 70));
+            HGDIOBJ oldPen = SelectObject(hdc, pen);
+            HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+            Rectangle(hdc, ses.rcImage.left, ses.rcImage.top, ses.rcImage.right, ses.rcImage.bottom);
+            SelectObject(hdc, oldBrush);
+            SelectObject(hdc, oldPen);
+            DeleteObject(pen);
+        }
+
+        auto drawBtn = [&](const RECT& r, const wchar_t* text) {
+            HBRUSH b = CreateSolidBrush(RGB(50, 50, 50));
+            FillRect(hdc, &r, b);
+            DeleteObject(b);
+
+            HPEN pen = CreatePen(PS_SOLID, 1, RGB(90, 90, 90));
+            HGDIOBJ oldPen = SelectObject(hdc, pen);
+            HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+            Rectangle(hdc, r.left, r.top, r.right, r.bottom);
+            SelectObject(hdc, oldBrush);
+            SelectObject(hdc, oldPen);
+            DeleteObject(pen);
+
+            SetBkMode(hdc, TRANSPARENT);
+            SetTextColor(hdc, RGB(240, 240, 240));
+            RECT t = r;
+            DrawTextW(hdc, text, -1, &t, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+            };
+
+        drawBtn(ses.btnSave, L"Save");
+        drawBtn(ses.btnEdit, L"Edit");
+        drawBtn(ses.btnDismiss, L"Dismiss");
+
+        // statusbar
+        {
+            RECT sb = ses.rcStatus;
+
+            // achtergrond
+            HBRUSH b = CreateSolidBrush(RGB(45, 45, 45));
+            FillRect(hdc, &sb, b);
+            DeleteObject(b);
+
+            // scheidingslijn boven statusbar
+            HPEN pen = CreatePen(PS_SOLID, 1, RGB(70, 70, 70));
+            HGDIOBJ oldPen = SelectObject(hdc, pen);
+            MoveToEx(hdc, sb.left, sb.top, nullptr);
+            LineTo(hdc, sb.right, sb.top);
+            SelectObject(hdc, oldPen);
+            DeleteObject(pen);
+
+            // icoon links
+            int iw = GetSystemMetrics(SM_CXSMICON);
+            int ih = GetSystemMetrics(SM_CYSMICON);
+            int ix = sb.left + 8;
+            int iy = sb.top + (sb.bottom - sb.top - ih) / 2;
+
+            HICON hi = AppIconSmall(); // bestaat al bij jou
+            if (hi) DrawIconEx(hdc, ix, iy, hi, iw, ih, 0, nullptr, DI_NORMAL);
+
+            // tekst
+            std::wstring txt = ses.statusText.empty() ? L"Ready" : ses.statusText;
+
+            RECT tr = sb;
+            tr.left = ix + iw + 8;
+            tr.right -= 8;
+
+            SetBkMode(hdc, TRANSPARENT);
+            SetTextColor(hdc, RGB(210, 210, 210));
+            DrawTextW(hdc, txt.c_str(), -1, &tr, DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS);
+        }
+
+        EndPaint(hwnd, &ps);
+        if (!ses.firstPaintLogged) {
+            ses.firstPaintLogged = true;
+            DebugLog(L"preview first paint: %.1f ms after session open (%s window)", MsSince(ses.openedAt), ses.warmWindow ? L"warm" : L"cold");
+        }
+        return 0;
+    }
+
+    case WM_DESTROY:
+        return 0;
+
+    case WM_NCDESTROY:
+        // laatste bericht: de sessie (bitmap, annotaties, job) gaat hier weg
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, 0);
+        ses.hwnd = nullptr;
+        DiffRememberClosed(ses);
+        SessionTake(g_sessions, ses.id);
+        return DefWindowProcW(hwnd, msg, wParam, lParam);
+    }
+
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+// =========================================================
+// Preview creation
+// =========================================================
+static void RegisterPreviewClass() {
+    static bool registered = false;
+    if (!registered) {
+        WNDCLASSW wc{};
+        wc.lpfnWndProc = PreviewProc;
+        wc.hInstance = g_hInst;
+        wc.lpszClassName = L"SnipLitePreview";
+        wc.hCursor = LoadCursorW(nullptr, IDC_ARROW);
+        RegisterClassW(&wc);
+        registered = true;
+    }
+}
+
+static HWND CreatePreviewHwnd(int x, int y, int w, int h, CaptureSession* ses) {
+    RegisterPreviewClass();
+    // WM_NCCREATE koppelt ses aan het venster (GWLP_USERDATA + ses.hwnd)
+    HWND hwnd = CreateWindowExW(
+        WS_EX_TOPMOST | WS_EX_TOOLWINDOW,
+        L"SnipLitePreview",
+        L"",
+        WS_POPUP,
+        x, y, w, h,
+        nullptr, nullptr, g_hInst, ses
+    );
+    if (!hwnd) return nullptr;
+
+    HICON hBig = AppIconBig();
+    HICON hSmall = AppIconSmall();
+    if (hBig)   SendMessageW(hwnd, WM_SETICON, ICON_BIG, (LPARAM)hBig);
+    if (hSmall) SendMessageW(hwnd, WM_SETICON, ICON_SMALL, (LPARAM)hSmall);
+    return hwnd;
+}
+
+// Eén verborgen preview-venster op voorraad: CreateWindowEx + class/icoon-werk zit dan
+// niet tussen de capture en de eerste paint. Alleen vers aangemaakt, nooit een gesloten
+// preview hergebruikt (geen oude inhoud of state die doorlekt).
+static void PreviewEnsureSpare() {
+    if (g_hwndPreviewSpare && IsWindow(g_hwndPreviewSpare)) return;
+    g_hwndPreviewSpare = CreatePreviewHwnd(0, 0, 600, 400, nullptr);
+}
+
+static bool CreatePreviewWindow(CaptureSession& ses) {
+
+    RECT wa{};
+    SystemParametersInfoW(SPI_GETWORKAREA, 0, &wa, 0);
+
+    int maxW = (int)((wa.right - wa.left) * 0.70);
+    int maxH = (int)((wa.bottom - wa.top) * 0.70);
+
+    int w = (ses.w > 0) ? ses.w : 600;
+    int h = (ses.h > 0) ? ses.h : 400;
+
+    int winW = w + 24;
+    int winH = h + 24 + 52;
+
+    double sx = (winW > 0) ? (double)maxW / (double)winW : 1.0;
+    double sy = (winH > 0) ? (double)maxH / (double)winH : 1.0;
+    double s = (sx < sy) ? sx : sy;
+    if (s > 1.0) s = 1.0;
+
+    winW = (int)(winW * s);
+    winH = (int)(winH * s);
+
+    int x = wa.left + ((wa.right - wa.left) - winW) / 2;
+    int y = wa.top + ((wa.bottom - wa.top) - winH) / 2;
+
+    // restore vorige positie/grootte (als aanwezig)
+    const PreviewPlacement& pl = PreviewPlacementCached();
+    int rx = pl.x != INT_MIN ? pl.x : x;
+    int ry = pl.y != INT_MIN ? pl.y : y;
+    int rw = pl.w != INT_MIN ? pl.w : winW;
+    int rh = pl.h != INT_MIN ? pl.h : winH;
+
+    if (rw < 300) rw = winW;
+    if (rh < 200) rh = winH;
+
+    // al andere previews open: trapsgewijs, niet precies eroverheen
+    const int others = (int)g_sessions.items.size() - 1;
+    if (others > 0) {
+        rx += 28 * (others % 8);
+        ry += 28 * (others % 8);
+    }
+
+    HWND hwnd = nullptr;
+    if (g_hwndPreviewSpare && IsWindow(g_hwndPreviewSpare)) {
+        // warm: het reservevenster krijgt de sessie, daarna in de idle-tijd een nieuwe reserve
+        hwnd = g_hwndPreviewSpare;
+        g_hwndPreviewSpare = nullptr;
+        ses.hwnd = hwnd;
+        ses.warmWindow = true;
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, (LONG_PTR)&ses);
+        SetWindowPos(hwnd, HWND_TOPMOST, rx, ry, rw, rh, SWP_NOACTIVATE);
+        LayoutPreview(ses);
+        PostMessageW(g_hwndMsg, WM_PREVIEW_SPARE, 0, 0);
+    }
+    else {
+        hwnd = CreatePreviewHwnd(rx, ry, rw, rh, &ses);
+    }
+
+    if (!hwnd) {
+        MessageBeep(MB_ICONERROR);
+        return false;
+    }
+
+    ShowWindow(hwnd, SW_SHOW);
+    SetForegroundWindow(hwnd);
+    SetFocus(hwnd);
+
+    // na de eerste paint: snapshot + pre-encode op de achtergrond
+    PostMessageW(hwnd, WM_PREVIEW_PREENCODE, 0, 0);
+    return true;
+}
+
+// Titel + exe-naam van het bronvenster: het opgegeven venster (Window-mode), anders
+// het top-level venster onder het midden van de capture. Leeg als dat niet lukt.
+static void CaptureSourceInfo(HWND hint, const RECT& rc, std::wstring& title, std::wstring& process) {
+    HWND h = hint;
+    if (!h && rc.right > rc.left && rc.bottom > rc.top) {
+        const POINT c{ (rc.left + rc.right) / 2, (rc.top + rc.bottom) / 2 };
+        h = WindowFromPoint(c);
+        if (h) h = GetAncestor(h, GA_ROOT);
+    }
+    if (!h || IsSnipLiteWindow(h) || IsDesktopOrShellWindow(h)) return;
+
+    wchar_t buf[512]{};   // de catalogus kapt toch af
+    const int n = GetWindowTextW(h, buf, _countof(buf));
+    title.assign(buf, n > 0 ? (size_t)n : 0);
+
+    DWORD pid = 0;
+    GetWindowThreadProcessId(h, &pid);
+    if (HANDLE hp = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid)) {
+        wchar_t exe[MAX_PATH]{};
+        DWORD len = MAX_PATH;
+        if (QueryFullProcessImageNameW(hp, 0, exe, &len)) {
+            const std::wstring full(exe, len);
+            const size_t slash = full.find_last_of(L"\\/");
+            process = slash == std::wstring::npos ? full : full.substr(slash + 1);
+        }
+        CloseHandle(hp);
+    }
+}
+
+// Overdracht: de capture-globals gaan naar een nieuwe sessie (en zijn daarna leeg).
+// Oudere previews blijven open; hun pre-encode loopt gewoon door.
+static void ShmPublishCapture(const CaptureSession& ses);
+static void TrayNotify(const wchar_t* title, const wchar_t* text);
+
+static CaptureSession* OpenCaptureSession() {
+    if (!g_captureBmp) return nullptr;
+
+    // vol: alleen opgeslagen, onbewerkte previews sluiten; anders weigeren (de capture
+    // staat al op het clipboard) in plaats van onbewaard werk weg te gooien
+    std::vector<uint32_t> close;
+    if (!SessionMakeRoom(g_sessions, kMaxCaptureSessions,
+        [](const CaptureSession& s) { return s.unsaved || AnnotDragging(s); }, close)) {
+        DebugLog(L"capture session refused: %zu previews with unsaved captures", g_sessions.items.size());
+        TrayNotify(L"snip-lite", L"Too many previews with unsaved captures. The capture is on the clipboard; save or close a preview to open new ones.");
+        FreeCapture();
+        return nullptr;
+    }
+    for (uint32_t id : close) {
+        if (CaptureSession* old = SessionFind(g_sessions, id)) DestroyPreview(*old);
+    }
+
+    auto owned = std::make_unique<CaptureSession>();
+    owned->openedAt = std::chrono::steady_clock::now();
+    owned->bmp = g_captureBmp;
+    owned->w = g_captureW;
+    owned->h = g_captureH;
+    owned->hasAlpha = g_captureHasAlpha;
+    owned->hash = g_captureHash;
+    owned->hashValid = g_captureHashValid;
+    owned->mode = g_mode;
+    owned->srcRect = g_captureSrcRect;
+    CaptureSourceInfo(g_captureSrcHwnd, g_captureSrcRect, owned->srcTitle, owned->srcProcess);
+    g_captureBmp = nullptr;
+    FreeCapture();
+
+    CaptureSession* ses = SessionAdd(g_sessions, std::move(owned));
+    SessionsShow(true);
+    if (!CreatePreviewWindow(*ses)) {
+        SessionTake(g_sessions, ses->id);
+        return nullptr;
+    }
+    DebugLog(L"capture session %u opened (%zu open)", ses->id, g_sessions.items.size());
+    ShmPublishCapture(*ses);
+    return ses;
+}
+
+#endif // !SNIP_CORE_ONLY
+
+// =========================================================
+// Burst: tile-diff + delta container (portable, geen Win32)
+// =========================================================
+// Bestand (.snipburst, little-endian):
+//   header: "SNIPBST1", u32 version, u32 width, u32 height, u32 tileSize
+//   frame:  u32 'FRME', u32 frameIndex, u64 timeMs, u32 tileCount,
+//           per tile: u32 (tileIndex << 1) | solid, dan 4 bytes (solid) of tw*th*4 bytes (top-down BGRA)
+// Het eerste frame bevat alle tiles, daarna alleen gewijzigde tiles.
+// Identieke frames worden helemaal niet geschreven.
+static constexpr uint32_t kBurstVersion = 1;
+static constexpr uint32_t kBurstFrameTag = 0x454D5246; // "FRME"
+static constexpr int kBurstTile = 32;
+static const char kBurstMagic[8] = { 'S','N','I','P','B','S','T','1' };
+
+static bool RowBytesEqual(const uint8_t* a, const uint8_t* b, size_t n) {
+#if SNIP_HAS_SSE2
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF) return false;
+    }
+    return std::memcmp(a + i, b + i, n - i) == 0;
+#else
+    return std::memcmp(a, b, n) == 0;
+#endif
+}
+
+// changed[ty * cols + tx] = 1 als de tile verschilt. Return: aantal gewijzigde tiles.
+static int DiffTiles(const uint8_t* cur, const uint8_t* prev, int w, int h, size_t stride, int tile,
+    std::vector<uint8_t>& changed) {
+    const int cols = (w + tile - 1) / tile;
+    const int rows = (h + tile - 1) / tile;
+    changed.assign((size_t)cols * (size_t)rows, 0);
+
+    int count = 0;
+    for (int ty = 0; ty < rows; ++ty) {
+        uint8_t* flags = changed.data() + (size_t)ty * cols;
+        const int y1 = std::min(h, (ty + 1) * tile);
+        int open = cols; // tiles in deze band die nog gelijk zijn
+
+        for (int y = ty * tile; y < y1 && open > 0; ++y) {
+            const uint8_t* a = cur + (size_t)y * stride;
+            const uint8_t* b = prev + (size_t)y * stride;
+            for (int tx = 0; tx < cols; ++tx) {
+                if (flags[tx]) continue;
+                const int x0 = tx * tile;
+                const int tw = std::min(tile, w - x0);
+                if (!RowBytesEqual(a + (size_t)x0 * 4, b + (size_t)x0 * 4, (size_t)tw * 4)) {
+                    flags[tx] = 1;
+                    open--;
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+template <class T> static void PutLE(std::string& buf, T v) {
+    for (size_t i = 0; i < sizeof(T); ++i) buf.push_back((char)((uint64_t)v >> (8 * i)));
+}
+
+template <class T> static bool GetLE(std::istream& in, T& v) {
+    unsigned char b[sizeof(T)];
+    if (!in.read((char*)b, sizeof(T))) return false;
+    uint64_t x = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) x |= (uint64_t)b[i] << (8 * i);
+    v = (T)x;
+    return true;
+}
+
+struct DeltaWriter {
+    std::ofstream out;
+    int w = 0, h = 0, tile = kBurstTile;
+    uint32_t frames = 0;
+    uint64_t bytes = 0;
+    std::string buf; // hergebruikt per frame
+};
+
+static bool DeltaWriterOpen(DeltaWriter& dw, const std::filesystem::path& path, int w, int h, int tile) {
+    dw.out.open(path, std::ios::binary | std::ios::trunc);
+    if (!dw.out) return false;
+    dw.w = w; dw.h = h; dw.tile = tile;
+    dw.frames = 0;
+
+    dw.buf.assign(kBurstMagic, kBurstMagic + 8);
+    PutLE<uint32_t>(dw.buf, kBurstVersion);
+    PutLE<uint32_t>(dw.buf, (uint32_t)w);
+    PutLE<uint32_t>(dw.buf, (uint32_t)h);
+    PutLE<uint32_t>(dw.buf, (uint32_t)tile);
+    dw.out.write(dw.buf.data(), (std::streamsize)dw.buf.size());
+    dw.bytes = dw.buf.size();
+    return (bool)dw.out;
+}
+
+// changed == nullptr: alle tiles (keyframe).
+static bool DeltaWriterAddFrame(DeltaWriter& dw, const uint8_t* px, size_t stride,
+    const std::vector<uint8_t>* changed, uint64_t timeMs) {
+    const int cols = (dw.w + dw.tile - 1) / dw.tile;
+    const int rows = (dw.h + dw.tile - 1) / dw.tile;
+
+    uint32_t n = 0;
+    for (int i = 0; i < cols * rows; ++i) if (!changed || (*changed)[i]) n++;
+
+    dw.buf.clear();
+    PutLE<uint32_t>(dw.buf, kBurstFrameTag);
+    PutLE<uint32_t>(dw.buf, dw.frames);
+    PutLE<uint64_t>(dw.buf, timeMs);
+    PutLE<uint32_t>(dw.buf, n);
+
+    for (int ty = 0; ty < rows; ++ty) {
+        for (int tx = 0; tx < cols; ++tx) {
+            const int idx = ty * cols + tx;
+            if (changed && !(*changed)[idx]) continue;
+
+            const int x0 = tx * dw.tile, y0 = ty * dw.tile;
+            const int tw = std::min(dw.tile, dw.w - x0);
+            const int th = std::min(dw.tile, dw.h - y0);
+
+            // effen tile (achtergrond, vlakke UI): 4 bytes i.p.v. tw*th*4
+            uint32_t first;
+            std::memcpy(&first, px + (size_t)y0 * stride + (size_t)x0 * 4, 4);
+            bool solid = true;
+            for (int y = 0; y < th && solid; ++y) {
+                const uint8_t* r = px + (size_t)(y0 + y) * stride + (size_t)x0 * 4;
+                for (int x = 0; x < tw; ++x) {
+                    uint32_t v;
+                    std::memcpy(&v, r + (size_t)x * 4, 4);
+                    if (v != first) { solid = false; break; }
+                }
+            }
+
+            PutLE<uint32_t>(dw.buf, ((uint32_t)idx << 1) | (solid ? 1u : 0u));
+            if (solid) {
+                PutLE<uint32_t>(dw.buf, first);
+                continue;
+            }
+            for (int y = 0; y < th; ++y) {
+                const char* r = (const char*)(px + (size_t)(y0 + y) * stride + (size_t)x0 * 4);
+                dw.buf.append(r, (size_t)tw * 4);
+            }
+        }
+    }
+
+    dw.out.write(dw.buf.data(), (std::streamsize)dw.buf.size());
+    dw.bytes += dw.buf.size();
+    dw.frames++;
+    return (bool)dw.out;
+}
+
+static bool DeltaWriterClose(DeltaWriter& dw) {
+    dw.out.flush();
+    const bool ok = (bool)dw.out;
+    dw.out.close();
+    return ok;
+}
+
+struct DeltaReader {
+    std::ifstream in;
+    int w = 0, h = 0, tile = kBurstTile;
+    std::vector<uint8_t> canvas; // top-down BGRA, w * 4 stride
+    uint32_t frameIndex = 0;
+    uint64_t timeMs = 0;
+};
+
+static bool DeltaReaderOpen(DeltaReader& dr, const std::filesystem::path& path) {
+    dr.in.open(path, std::ios::binary);
+    if (!dr.in) return false;
+
+    char magic[8]{};
+    uint32_t ver = 0, w = 0, h = 0, tile = 0;
+    if (!dr.in.read(magic, 8) || std::memcmp(magic, kBurstMagic, 8) != 0) return false;
+    if (!GetLE(dr.in, ver) || ver != kBurstVersion) return false;
+    if (!GetLE(dr.in, w) || !GetLE(dr.in, h) || !GetLE(dr.in, tile)) return false;
+    if (w == 0 || h == 0 || w > 65535 || h > 65535 || tile == 0 || tile > 1024) return false;
+
+    dr.w = (int)w; dr.h = (int)h; dr.tile = (int)tile;
+    dr.canvas.assign((size_t)w * h * 4, 0);
+    return true;
+}
+
+// Leest het volgende frame en past het toe op canvas. false = einde of corrupt.
+static bool DeltaReaderNext(DeltaReader& dr) {
+    uint32_t tag = 0, n = 0;
+    if (!GetLE(dr.in, tag) || tag != kBurstFrameTag) return false;
+    if (!GetLE(dr.in, dr.frameIndex) || !GetLE(dr.in, dr.timeMs) || !GetLE(dr.in, n)) return false;
+
+    const int cols = (dr.w + dr.tile - 1) / dr.tile;
+    const int rows = (dr.h + dr.tile - 1) / dr.tile;
+    if (n > (uint32_t)(cols * rows)) return false;
+
+    const size_t stride = (size_t)dr.w * 4;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t key = 0;
+        if (!GetLE(dr.in, key)) return false;
+        const uint32_t idx = key >> 1;
+        if (idx >= (uint32_t)(cols * rows)) return false;
+
+        const int x0 = (int)(idx % cols) * dr.tile, y0 = (int)(idx / cols) * dr.tile;
+        const int tw = std::min(dr.tile, dr.w - x0);
+        const int th = std::min(dr.tile, dr.h - y0);
+
+        if (key & 1) {
+            uint32_t v = 0;
+            if (!GetLE(dr.in, v)) return false;
+            for (int y = 0; y < th; ++y) {
+                uint8_t* r = dr.canvas.data() + (size_t)(y0 + y) * stride + (size_t)x0 * 4;
+                for (int x = 0; x < tw; ++x) std::memcpy(r + (size_t)x * 4, &v, 4);
+            }
+            continue;
+        }
+        for (int y = 0; y < th; ++y) {
+            char* r = (char*)(dr.canvas.data() + (size_t)(y0 + y) * stride + (size_t)x0 * 4);
+            if (!dr.in.read(r, (std::streamsize)tw * 4)) return false;
+        }
+    }
+    return true;
+}
+
+// =========================================================
+// APNG writer + frame differ (portable, geen Win32)
+// =========================================================
+// Elk frame wordt als losse PNG aangeleverd (encoder naar keuze); de writer
+// haalt de IDAT-data eruit en verpakt die als IDAT (frame 0) of fdAT (rest).
+// Frames na het eerste beslaan alleen de gewijzigde bounding box (fcTL x/y offset,
+// dispose NONE + blend SOURCE: de rest van het canvas blijft staan).
+
+static uint32_t Crc32Update(uint32_t crc, const uint8_t* p, size_t n) {
+    // function-local static: thread-safe initialisatie (--optimize draait parallel)
+    static const struct Table {
+        uint32_t t[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+                t[i] = c;
+            }
+        }
+    } table;
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i) crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// Bounding box van alle pixels die verschillen. false = frames identiek.
+static bool DiffBounds(const uint8_t* cur, const uint8_t* prev, int w, int h, size_t stride, PixRect& out) {
+    const size_t rowBytes = (size_t)w * 4;
+
+    int top = 0;
+    while (top < h && RowBytesEqual(cur + (size_t)top * stride, prev + (size_t)top * stride, rowBytes)) ++top;
+    if (top == h) return false;
+
+    int bottom = h;
+    while (bottom > top + 1 && RowBytesEqual(cur + (size_t)(bottom - 1) * stride, prev + (size_t)(bottom - 1) * stride, rowBytes)) --bottom;
+
+    int left = w, right = 0;
+    for (int y = top; y < bottom; ++y) {
+        const uint32_t* a = (const uint32_t*)(cur + (size_t)y * stride);
+        const uint32_t* b = (const uint32_t*)(prev + (size_t)y * stride);
+        // links: alleen zoeken voor de huidige grens; rechts idem vanaf het eind
+        int x = 0;
+        while (x < left && a[x] == b[x]) ++x;
+        if (x < left) left = x;
+        int xr = w;
+        while (xr > right && a[xr - 1] == b[xr - 1]) --xr;
+        if (xr > right) right = xr;
+    }
+    if (right <= left) { left = 0; right = w; } // kan niet, maar blijf veilig
+
+    out = { left, top, right, bottom };
+    return true;
+}
+
+struct ApngWriter {
+    std::ofstream out;
+    int w = 0, h = 0;
+    uint32_t seq = 0;          // sequence number voor fcTL/fdAT
+    uint32_t frames = 0;
+    std::streamoff actlPos = 0;
+    uint64_t bytes = 0;
+
+    // frame dat nog wacht op zijn delay (bekend zodra het volgende frame komt)
+    bool hasPending = false;
+    PixRect pendingRect{};
+    uint64_t pendingTimeMs = 0;
+    std::vector<uint8_t> pendingIdat;
+};
+
+static void ApngPutBE32(std::string& b, uint32_t v) {
+    b.push_back((char)(v >> 24)); b.push_back((char)(v >> 16));
+    b.push_back((char)(v >> 8));  b.push_back((char)v);
+}
+
+static void ApngWriteChunk(ApngWriter& aw, const char type[4], const std::string& data) {
+    std::string c;
+    ApngPutBE32(c, (uint32_t)data.size());
+    c.append(type, 4);
+    c += data;
+    const uint32_t crc = Crc32Update(0, (const uint8_t*)c.data() + 4, c.size() - 4);
+    ApngPutBE32(c, crc);
+    aw.out.write(c.data(), (std::streamsize)c.size());
+    aw.bytes += c.size();
+}
+
+// Losse PNG -> IHDR-data en aaneengesloten IDAT-data.
+static bool PngSplitIdat(const std::vector<uint8_t>& png, std::string* outIhdr, std::vector<uint8_t>& outIdat) {
+    static const uint8_t sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    outIdat.clear();
+    if (png.size() < 8 || std::memcmp(png.data(), sig, 8) != 0) return false;
+
+    size_t p = 8;
+    while (p + 12 <= png.size()) {
+        const uint32_t len = (uint32_t)png[p] << 24 | (uint32_t)png[p + 1] << 16 | (uint32_t)png[p + 2] << 8 | png[p + 3];
+        if (len > png.size() - p - 12) return false;
+        const char* type = (const char*)&png[p + 4];
+        const uint8_t* data = &png[p + 8];
+        if (std::memcmp(type, "IHDR", 4) == 0 && outIhdr) outIhdr->assign((const char*)data, len);
+        if (std::memcmp(type, "IDAT", 4) == 0) outIdat.insert(outIdat.end(), data, data + len);
+        if (std::memcmp(type, "IEND", 4) == 0) break;
+        p += 12 + len;
+    }
+    return !outIdat.empty();
+}
+
+static bool ApngWriterOpen(ApngWriter& aw, const std::filesystem::path& path, int w, int h) {
+    aw.out.open(path, std::ios::binary | std::ios::trunc);
+    if (!aw.out) return false;
+    aw.w = w; aw.h = h;
+    aw.seq = 0; aw.frames = 0; aw.bytes = 0;
+    aw.hasPending = false;
+    return true;
+}
+
+static void ApngFlushPending(ApngWriter& aw, uint64_t nextTimeMs) {
+    if (!aw.hasPending) return;
+
+    uint64_t delay = (nextTimeMs > aw.pendingTimeMs) ? nextTimeMs - aw.pendingTimeMs : 1;
+    if (delay > 65535) delay = 65535;
+
+    std::string fc;
+    ApngPutBE32(fc, aw.seq++);
+    ApngPutBE32(fc, (uint32_t)aw.pendingRect.Width());
+    ApngPutBE32(fc, (uint32_t)aw.pendingRect.Height());
+    ApngPutBE32(fc, (uint32_t)aw.pendingRect.x0);
+    ApngPutBE32(fc, (uint32_t)aw.pendingRect.y0);
+    fc.push_back((char)(delay >> 8)); fc.push_back((char)delay);   // delay_num (ms)
+    fc.push_back((char)(1000 >> 8));  fc.push_back((char)(1000 & 0xFF)); // delay_den
+    fc.push_back(0); // dispose_op: NONE
+    fc.push_back(0); // blend_op: SOURCE
+    ApngWriteChunk(aw, "fcTL", fc);
+
+    if (aw.frames == 0) {
+        ApngWriteChunk(aw, "IDAT", std::string(aw.pendingIdat.begin(), aw.pendingIdat.end()));
+    }
+    else {
+        std::string fd;
+        ApngPutBE32(fd, aw.seq++);
+        fd.append(aw.pendingIdat.begin(), aw.pendingIdat.end());
+        ApngWriteChunk(aw, "fdAT", fd);
+    }
+    aw.frames++;
+    aw.hasPending = false;
+}
+
+// png = losse PNG van precies rect (frame 0: het hele canvas).
+static bool ApngWriterAddFrame(ApngWriter& aw, const std::vector<uint8_t>& png, const PixRect& rect, uint64_t timeMs) {
+    std::string ihdr;
+    std::vector<uint8_t> idat;
+    if (!PngSplitIdat(png, aw.frames == 0 && !aw.hasPending ? &ihdr : nullptr, idat)) return false;
+
+    if (aw.frames == 0 && !aw.hasPending) {
+        if (ihdr.size() != 13 || rect.Width() != aw.w || rect.Height() != aw.h) return false;
+
+        static const char sig[8] = { (char)137, 80, 78, 71, 13, 10, 26, 10 };
+        aw.out.write(sig, 8);
+        aw.bytes += 8;
+        ApngWriteChunk(aw, "IHDR", ihdr);
+
+        aw.actlPos = (std::streamoff)aw.bytes;
+        std::string ac;
+        ApngPutBE32(ac, 0); // num_frames: bij Close ingevuld
+        ApngPutBE32(ac, 0); // num_plays: oneindig
+        ApngWriteChunk(aw, "acTL", ac);
+    }
+
+    ApngFlushPending(aw, timeMs);
+
+    aw.pendingIdat.swap(idat);
+    aw.pendingRect = rect;
+    aw.pendingTimeMs = timeMs;
+    aw.hasPending = true;
+    return (bool)aw.out;
+}
+
+static bool ApngWriterClose(ApngWriter& aw, uint64_t endTimeMs) {
+    if (!aw.out.is_open()) return false;
+    ApngFlushPending(aw, endTimeMs);
+    ApngWriteChunk(aw, "IEND", std::string());
+
+    // acTL.num_frames + CRC achteraf invullen
+    if (aw.frames > 0) {
+        std::string ac;
+        ApngPutBE32(ac, 8);
+        ac += "acTL";
+        ApngPutBE32(ac, aw.frames);
+        ApngPutBE32(ac, 0);
+        ApngPutBE32(ac, Crc32Update(0, (const uint8_t*)ac.data() + 4, ac.size() - 4));
+        aw.out.seekp(aw.actlPos);
+        aw.out.write(ac.data(), (std::streamsize)ac.size());
+    }
+    const bool ok = (bool)aw.out && aw.frames > 0;
+    aw.out.close();
+    return ok;
+}
+
+// =========================================================
+// Visuele diff: uitlijnen, verschilmasker, gebieden (portable, geen Win32)
+// =========================================================
+// Vergelijkt een capture met een eerdere van hetzelfde doel (QA: voor/na een build).
+// Uitlijnen: alleen translatie, via helderheidsprofielen (rij- en kolomgemiddelden)
+// die binnen +-maxShift tegen elkaar worden geschoven; een verschuiving telt alleen
+// als die duidelijk beter past dan (0,0).
+// Verschil: per pixel het grootste kanaalverschil (SSE2, 16 pixels per stap), tot en met
+// tolerance telt als gelijk; waar de vorige capture niet ligt is alles gewijzigd (255).
+// Gebieden: per tegel van kDiffTile de bounding box van gewijzigde pixels (in dezelfde
+// pass), daarna tegels die elkaar op <= kDiffGapTiles raken samenvoegen.
+static constexpr int kDiffTile = 16;
+static constexpr int kDiffGapTiles = 1;      // tussenruimte die nog één gebied is
+static constexpr int kDiffMinTileRows = 4;   // per band
+static constexpr int kDiffProfileStep = 4;
+
+struct DiffOffset { int dx = 0, dy = 0; };   // prev(x + dx, y + dy) hoort bij cur(x, y)
+
+struct DiffResult {
+    int w = 0, h = 0;                // = cur
+    std::vector<uint8_t> mag;        // w * h; 0 = gelijk (binnen tolerantie)
+    std::vector<PixRect> boxes;      // gewijzigde gebieden, groot -> klein
+    size_t changed = 0;              // pixels
+    DiffOffset offset;
+};
+
+// Helderheidsprofielen: rows[y] = gemiddelde byte over de hele rij (SSE2 sad), cols[x] =
+// gemiddelde over de kolom op elke kDiffProfileStep-de rij. Rijen niet subsamplen: bij
+// een horizontale verschuiving zouden dan andere pixels geteld worden.
+static void DiffProfiles(const uint8_t* px, ptrdiff_t stride, int w, int h, std::vector<double>& rows, std::vector<double>& cols) {
+    rows.assign((size_t)h, 0.0);
+    std::vector<uint32_t> colSum((size_t)w, 0);
+    const size_t rowBytes = (size_t)w * 4;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* p = px + (ptrdiff_t)y * stride;
+        uint64_t sum = 0;
+        size_t i = 0;
+#if SNIP_HAS_SSE2
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 16 <= rowBytes; i += 16) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(p + i)), _mm_setzero_si128()));
+        }
+        sum = (uint64_t)_mm_cvtsi128_si32(acc) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+#endif
+        for (; i < rowBytes; ++i) sum += p[i];
+        rows[(size_t)y] = (double)sum / (double)rowBytes;
+        if (y % kDiffProfileStep) continue;
+        for (int x = 0; x < w; ++x) colSum[(size_t)x] += p[x * 4] + p[x * 4 + 1] + p[x * 4 + 2] + p[x * 4 + 3];
+    }
+    const double colRows = (double)((h + kDiffProfileStep - 1) / kDiffProfileStep);
+    cols.resize((size_t)w);
+    for (int x = 0; x < w; ++x) cols[(size_t)x] = colSum[(size_t)x] / (4.0 * colRows);
+}
+
+// Beste verschuiving van b t.o.v. a (a[i] ~ b[i + d]); minstens de helft moet overlappen.
+static int DiffBestShift(const std::vector<double>& a, const std::vector<double>& b, int maxShift) {
+    const int na = (int)a.size(), nb = (int)b.size();
+    auto cost = [&](int d) {
+        const int i0 = std::max(0, -d), i1 = std::min(na, nb - d);
+        if (i1 - i0 < std::max(1, std::min(na, nb) / 2)) return -1.0;
+        double s = 0.0;
+        for (int i = i0; i < i1; ++i) s += std::fabs(a[(size_t)i] - b[(size_t)(i + d)]);
+        return s / (i1 - i0);
+    };
+    const double zero = cost(0);
+    int best = 0;
+    double bestCost = zero;
+    for (int d = -maxShift; d <= maxShift; ++d) {
+        const double c = cost(d);
+        if (c < 0.0 || d == 0) continue;
+        if (bestCost < 0.0 || c < bestCost || (c == bestCost && std::abs(d) < std::abs(best))) { best = d; bestCost = c; }
+    }
+    // alleen verschuiven als dat echt beter past (anders is de inhoud zelf veranderd)
+    if (zero >= 0.0 && !(bestCost < zero * 0.5)) return 0;
+    return best;
+}
+
+static DiffOffset DiffAlign(const uint8_t* cur, ptrdiff_t curStride, int cw, int ch,
+    const uint8_t* prev, ptrdiff_t prevStride, int pw, int ph, int maxShift) {
+    std::vector<double> cr, cc, pr, pc;
+    DiffProfiles(cur, curStride, cw, ch, cr, cc);
+    DiffProfiles(prev, prevStride, pw, ph, pr, pc);
+    return { DiffBestShift(cc, pc, maxShift), DiffBestShift(cr, pr, maxShift) };
+}
+
+// Eén rij: mag[x] = max |cur - prev| over de 4 kanalen, 0 als <= tol.
+static void DiffRow(const uint8_t* a, const uint8_t* b, uint8_t* mag, int n, uint8_t tol) {
+    int x = 0;
+#if SNIP_HAS_SSE2
+    const __m128i lowByte = _mm_set1_epi32(0xFF);
+    const __m128i vtol = _mm_set1_epi8((char)tol);
+    const __m128i zero = _mm_setzero_si128();
+    auto maxOf4 = [&](const uint8_t* pa, const uint8_t* pb) {
+        const __m128i va = _mm_loadu_si128((const __m128i*)pa);
+        const __m128i vb = _mm_loadu_si128((const __m128i*)pb);
+        const __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        __m128i m = _mm_max_epu8(d, _mm_srli_epi32(d, 8));
+        m = _mm_max_epu8(m, _mm_srli_epi32(m, 16));
+        return _mm_and_si128(m, lowByte);   // per pixel 0..255 in het lage byte
+    };
+    for (; x + 16 <= n; x += 16) {
+        const __m128i m0 = maxOf4(a + (size_t)x * 4, b + (size_t)x * 4);
+        const __m128i m1 = maxOf4(a + (size_t)x * 4 + 16, b + (size_t)x * 4 + 16);
+        const __m128i m2 = maxOf4(a + (size_t)x * 4 + 32, b + (size_t)x * 4 + 32);
+        const __m128i m3 = maxOf4(a + (size_t)x * 4 + 48, b + (size_t)x * 4 + 48);
+        const __m128i m = _mm_packus_epi16(_mm_packs_epi32(m0, m1), _mm_packs_epi32(m2, m3));
+        const __m128i same = _mm_cmpeq_epi8(_mm_subs_epu8(m, vtol), zero);
+        _mm_storeu_si128((__m128i*)(mag + x), _mm_andnot_si128(same, m));
+    }
+#endif
+    for (; x < n; ++x) {
+        int m = 0;
+        for (int c = 0; c < 4; ++c) m = std::max(m, std::abs((int)a[(size_t)x * 4 + c] - (int)b[(size_t)x * 4 + c]));
+        mag[x] = m > tol ? (uint8_t)m : 0;
+    }
+}
+
+struct DiffTileBox {
+    PixRect r{ INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+    uint32_t count = 0;
+};
+
+// Gewijzigde pixels van één mag-rij in de tegels zetten (tegel-uitgelijnd per 16).
+static void DiffRowTiles(const uint8_t* mag, int w, int y, DiffTileBox* tileRow) {
+    for (int x0 = 0; x0 < w; x0 += kDiffTile) {
+        const int n = std::min(kDiffTile, w - x0);
+        int first = -1, last = -1;
+        uint32_t count = 0;
+        int x = 0;
+#if SNIP_HAS_SSE2
+        if (n == 16) {
+            const unsigned bits = 0xFFFFu & ~(unsigned)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(mag + x0)), _mm_setzero_si128()));
+            if (!bits) continue;
+            unsigned long lo = 0;
+#if defined(_MSC_VER)
+            _BitScanForward(&lo, bits);
+#else
+            lo = (unsigned long)__builtin_ctz(bits);
+#endif
+            int hi = 15;
+            while (!(bits & (1u << hi))) --hi;
+            first = (int)lo;
+            last = hi;
+            for (unsigned v = bits; v; v &= v - 1) ++count;
+            x = n;
+        }
+#endif
+        for (; x < n; ++x) {
+            if (!mag[x0 + x]) continue;
+            if (first < 0) first = x;
+            last = x;
+            ++count;
+        }
+        if (first < 0) continue;
+        DiffTileBox& t = tileRow[x0 / kDiffTile];
+        t.r.x0 = std::min(t.r.x0, x0 + first);
+        t.r.x1 = std::max(t.r.x1, x0 + last + 1);
+        t.r.y0 = std::min(t.r.y0, y);
+        t.r.y1 = std::max(t.r.y1, y + 1);
+        t.count += count;
+    }
+}
+
+// Tegels -> gebieden: flood fill over gewijzigde tegels (buren tot kDiffGapTiles + 1 ver),
+// daarna overlappende boxen samenvoegen.
+static std::vector<PixRect> DiffBoxesFromTiles(const std::vector<DiffTileBox>& tiles, int tx, int ty) {
+    std::vector<PixRect> boxes;
+    std::vector<uint8_t> seen(tiles.size(), 0);
+    std::vector<int> stack;
+    const int reach = kDiffGapTiles + 1;
+    for (int i = 0; i < tx * ty; ++i) {
+        if (seen[(size_t)i] || !tiles[(size_t)i].count) continue;
+        PixRect box{};
+        seen[(size_t)i] = 1;
+        stack.push_back(i);
+        while (!stack.empty()) {
+            const int t = stack.back();
+            stack.pop_back();
+            box = PixRectUnion(box, tiles[(size_t)t].r);
+            const int cx = t % tx, cy = t / tx;
+            for (int y = std::max(0, cy - reach); y <= std::min(ty - 1, cy + reach); ++y) {
+                for (int x = std::max(0, cx - reach); x <= std::min(tx - 1, cx + reach); ++x) {
+                    const int n = y * tx + x;
+                    if (seen[(size_t)n] || !tiles[(size_t)n].count) continue;
+                    seen[(size_t)n] = 1;
+                    stack.push_back(n);
+                }
+            }
+        }
+        boxes.push_back(box);
+    }
+    for (bool merged = true; merged; ) {
+        merged = false;
+        for (size_t i = 0; i < boxes.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < boxes.size(); ++j) {
+                if (PixRectIntersect(boxes[i], boxes[j]).Empty()) continue;
+                boxes[i] = PixRectUnion(boxes[i], boxes[j]);
+                boxes.erase(boxes.begin() + (ptrdiff_t)j);
+                merged = true;
+                break;
+            }
+        }
+    }
+    std::sort(boxes.begin(), boxes.end(), [](const PixRect& a, const PixRect& b) {
+        return (int64_t)a.Width() * a.Height() > (int64_t)b.Width() * b.Height();
+        });
+    return boxes;
+}
+
+// cur/prev: top-down BGRA views (signed stride). Banden per tegelrij over threads.
+static void DiffImages(const uint8_t* cur, ptrdiff_t curStride, int cw, int ch,
+    const uint8_t* prev, ptrdiff_t prevStride, int pw, int ph, DiffOffset off, uint8_t tol, DiffResult& out) {
+    out.w = cw;
+    out.h = ch;
+    out.offset = off;
+    out.mag.assign((size_t)cw * ch, 0);
+    out.boxes.clear();
+    out.changed = 0;
+    if (cw <= 0 || ch <= 0) return;
+
+    // deel van cur waar prev ligt
+    const PixRect ov = PixRectIntersect(PixRect{ 0, 0, cw, ch }, PixRect{ -off.dx, -off.dy, pw - off.dx, ph - off.dy });
+    const int tx = (cw + kDiffTile - 1) / kDiffTile, ty = (ch + kDiffTile - 1) / kDiffTile;
+    std::vector<DiffTileBox> tiles((size_t)tx * ty);
+
+    ParallelForBands(ty, kDiffMinTileRows, [&](int t0, int t1) {
+        for (int y = t0 * kDiffTile; y < std::min(ch, t1 * kDiffTile); ++y) {
+            uint8_t* mag = out.mag.data() + (size_t)y * cw;
+            if (ov.Empty() || y < ov.y0 || y >= ov.y1) std::memset(mag, 255, (size_t)cw);
+            else {
+                std::memset(mag, 255, (size_t)ov.x0);
+                std::memset(mag + ov.x1, 255, (size_t)(cw - ov.x1));
+                DiffRow(cur + (ptrdiff_t)y * curStride + (ptrdiff_t)ov.x0 * 4,
+                    prev + (ptrdiff_t)(y + off.dy) * prevStride + (ptrdiff_t)(ov.x0 + off.dx) * 4,
+                    mag + ov.x0, ov.Width(), tol);
+            }
+            DiffRowTiles(mag, cw, y, tiles.data() + (size_t)(y / kDiffTile) * tx);
+        }
+        });
+
+    for (const DiffTileBox& t : tiles) out.changed += t.count;
+    out.boxes = DiffBoxesFromTiles(tiles, tx, ty);
+}
+
+// Heat-map: gelijke pixels als gedimd grijs, gewijzigde geel (klein verschil) -> rood.
+static void DiffHeatmap(const uint8_t* cur, ptrdiff_t curStride, const DiffResult& d, uint8_t* out, ptrdiff_t outStride) {
+    static const std::vector<uint32_t> ramp = [] {
+        std::vector<uint32_t> r(256);
+        for (int m = 0; m < 256; ++m) {
+            const int g = 230 - m * 230 / 255;          // geel -> rood
+            r[(size_t)m] = 0xFF000000u | (255u << 16) | ((uint32_t)g << 8) | 32u;
+        }
+        return r;
+    }();
+    ParallelForBands(d.h, 32, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) {
+            const uint8_t* s = cur + (ptrdiff_t)y * curStride;
+            const uint8_t* m = d.mag.data() + (size_t)y * d.w;
+            uint32_t* o = (uint32_t*)(out + (ptrdiff_t)y * outStride);
+            for (int x = 0; x < d.w; ++x) {
+                const uint32_t lum = (s[x * 4] + 2u * s[x * 4 + 1] + s[x * 4 + 2]) >> 2;
+                if (!m[x]) {
+                    const uint32_t g = 24 + lum * 2 / 5;
+                    o[x] = 0xFF000000u | (g << 16) | (g << 8) | g;
+                    continue;
+                }
+                // 75% kleur over het grijs: de inhoud blijft herkenbaar
+                const uint32_t c = ramp[m[x]], g = lum / 4;
+                o[x] = 0xFF000000u | ((((c >> 16) & 0xFF) * 3 / 4 + g) << 16)
+                    | ((((c >> 8) & 0xFF) * 3 / 4 + g) << 8) | ((c & 0xFF) * 3 / 4 + g);
+            }
+        }
+        });
+}
+
+// Bewaarde "vorige captures" (oud -> nieuw, met .bytes en .closedAt in ms): hoeveel
+// van de oudste weg moeten om binnen maxCount, maxBytes en maxAgeMs te blijven.
+template <class Item>
+static size_t DiffKeepExcess(const std::deque<Item>& items, uint64_t nowMs, size_t maxCount, uint64_t maxBytes, uint64_t maxAgeMs) {
+    uint64_t total = 0;
+    for (const Item& c : items) total += c.bytes;
+    size_t drop = 0;
+    for (; drop < items.size(); ++drop) {
+        const Item& c = items[drop];
+        const bool young = nowMs <= c.closedAt || nowMs - c.closedAt <= maxAgeMs;
+        if (items.size() - drop <= maxCount && total <= maxBytes && young) break;
+        total -= c.bytes;
+    }
+    return drop;
+}
+
+// =========================================================
+// Scroll: row-hash stitching (portable, geen Win32)
+// =========================================================
+// Opeenvolgende viewport-frames van een scrollend window worden aan elkaar gezet.
+// Per rij een 64-bit hash (scrollbar-kolommen rechts niet meegenomen); sticky
+// header/footer = rijen die op dezelfde plek gelijk bleven. In de band daartussen
+// wordt de scroll-offset gezocht met een rolling hash over K rijen: één zeldzaam
+// venster uit het nieuwe frame opzoeken in het vorige, kandidaten verifiëren.
+// Output gaat naar een buffer van vaste chunks: groeien kopieert nooit oude rijen.
+struct RowChunkBuffer {
+    size_t rowBytes = 0;
+    int rowsPerChunk = 256;
+    int rows = 0;
+    std::vector<std::vector<uint8_t>> chunks;
+};
+
+static uint8_t* RowBufRow(RowChunkBuffer& rb, int y) {
+    return rb.chunks[(size_t)(y / rb.rowsPerChunk)].data() + (size_t)(y % rb.rowsPerChunk) * rb.rowBytes;
+}
+
+static void RowBufAppend(RowChunkBuffer& rb, const uint8_t* row) {
+    if (rb.rows == (int)rb.chunks.size() * rb.rowsPerChunk) {
+        rb.chunks.emplace_back((size_t)rb.rowsPerChunk * rb.rowBytes);
+    }
+    std::memcpy(RowBufRow(rb, rb.rows), row, rb.rowBytes);
+    rb.rows++;
+}
+
+// Laatste n rijen vervallen (chunks blijven gereserveerd voor de volgende append).
+static void RowBufTruncate(RowChunkBuffer& rb, int n) {
+    rb.rows = (n >= rb.rows) ? 0 : rb.rows - n;
+}
+
+static void RowBufFlatten(RowChunkBuffer& rb, std::vector<uint8_t>& out) {
+    out.resize((size_t)rb.rows * rb.rowBytes);
+    for (int y = 0; y < rb.rows; y += rb.rowsPerChunk) {
+        const int n = std::min(rb.rowsPerChunk, rb.rows - y);
+        std::memcpy(out.data() + (size_t)y * rb.rowBytes, RowBufRow(rb, y), (size_t)n * rb.rowBytes);
+    }
+}
+
+enum class StitchResult { Appended, NoMovement, NoMatch };
+
+struct ScrollStitcher {
+    int w = 0, h = 0;
+    int hashX0 = 0, hashX1 = 0;     // kolommen die in de row-hash meetellen
+    int maxRows = 30000;
+    std::vector<uint64_t> prevHashes;
+    std::vector<uint64_t> curHashes;
+    std::vector<std::pair<uint64_t, int>> windows; // (venster-hash, rij) van het vorige frame, gesorteerd
+    RowChunkBuffer out;
+    int frames = 0;
+    int lastHeader = 0, lastFooter = 0, lastDy = 0;
+};
+
+static constexpr int kStitchWindowRows = 8;
+static constexpr uint64_t kStitchRollBase = 0x100000001B3ull;
+
+static void StitchInit(ScrollStitcher& st, int w, int h, int maxRows) {
+    st = ScrollStitcher{};
+    st.w = w;
+    st.h = h;
+    st.maxRows = maxRows;
+    // rechter strook = scrollbar (thumb verschuift elk frame)
+    const int sb = (w > 128) ? 32 : 0;
+    st.hashX0 = 0;
+    st.hashX1 = w - sb;
+    st.out.rowBytes = (size_t)w * 4;
+}
+
+static void StitchRowHashes(const ScrollStitcher& st, const uint8_t* px, size_t stride, std::vector<uint64_t>& out) {
+    out.resize((size_t)st.h);
+    const size_t off = (size_t)st.hashX0 * 4;
+    const size_t len = (size_t)(st.hashX1 - st.hashX0) * 4;
+    for (int y = 0; y < st.h; ++y) out[(size_t)y] = ContentHash64(px + (size_t)y * stride + off, len, 0);
+}
+
+// Rolling hash over K opeenvolgende row-hashes: out[j] dekt rijen [a+j, a+j+K).
+static void StitchWindowHashes(const std::vector<uint64_t>& rows, int a, int b, std::vector<uint64_t>& out) {
+    out.clear();
+    const int K = kStitchWindowRows;
+    if (b - a < K) return;
+
+    uint64_t pow = 1;
+    for (int k = 1; k < K; ++k) pow *= kStitchRollBase;
+
+    uint64_t wh = 0;
+    for (int k = 0; k < K; ++k) wh = wh * kStitchRollBase + rows[(size_t)(a + k)];
+    out.push_back(wh);
+    for (int j = a + 1; j + K <= b; ++j) {
+        wh = (wh - rows[(size_t)(j - 1)] * pow) * kStitchRollBase + rows[(size_t)(j + K - 1)];
+        out.push_back(wh);
+    }
+}
+
+static StitchResult StitchAddFrame(ScrollStitcher& st, const uint8_t* px, size_t stride) {
+    StitchRowHashes(st, px, stride, st.curHashes);
+    const std::vector<uint64_t>& H = st.curHashes;
+
+    if (st.frames == 0) {
+        for (int y = 0; y < st.h; ++y) RowBufAppend(st.out, px + (size_t)y * stride);
+        st.prevHashes.swap(st.curHashes);
+        st.frames = 1;
+        return StitchResult::Appended;
+    }
+    const std::vector<uint64_t>& P = st.prevHashes;
+
+    // sticky header/footer
+    int header = 0;
+    while (header < st.h && H[(size_t)header] == P[(size_t)header]) ++header;
+    if (header == st.h) return StitchResult::NoMovement;
+    int footer = 0;
+    while (footer < st.h - header - 1 && H[(size_t)(st.h - 1 - footer)] == P[(size_t)(st.h - 1 - footer)]) ++footer;
+
+    const int a = header, b = st.h - footer, n = b - a;
+    const int minOverlap = std::max(kStitchWindowRows, n / 16);
+    if (n <= minOverlap) return StitchResult::NoMatch;
+
+    // vensters van het vorige frame, gesorteerd voor equal_range
+    std::vector<uint64_t> wp, wc;
+    StitchWindowHashes(P, a, b, wp);
+    StitchWindowHashes(H, a, b, wc);
+    if (wp.empty() || wc.empty()) return StitchResult::NoMatch;
+
+    st.windows.clear();
+    for (size_t j = 0; j < wp.size(); ++j) st.windows.emplace_back(wp[j], a + (int)j);
+    std::sort(st.windows.begin(), st.windows.end());
+
+    auto range = [&](uint64_t key) {
+        return std::equal_range(st.windows.begin(), st.windows.end(), std::make_pair(key, INT32_MIN),
+            [](const std::pair<uint64_t, int>& x, const std::pair<uint64_t, int>& y) { return x.first < y.first; });
+    };
+
+    // sleutels: zeldzaamste vensters bovenin het nieuwe frame (lege vlakken komen vaak
+    // voor). Een sleutel kan buiten de echte overlap liggen -> een paar proberen.
+    const int searchTop = std::max(1, std::min((int)wc.size(), n - minOverlap));
+    std::vector<std::pair<size_t, int>> keys; // (aantal kandidaten, rij)
+    for (int i = 0; i < searchTop; ++i) {
+        auto r = range(wc[(size_t)i]);
+        const size_t c = (size_t)(r.second - r.first);
+        if (c > 0 && c <= 64) keys.emplace_back(c, a + i);
+    }
+    std::sort(keys.begin(), keys.end());
+    if (keys.size() > 8) keys.resize(8);
+
+    // per sleutel: kleinste dy waarbij de hele overlap klopt
+    int dy = 0;
+    for (const auto& key : keys) {
+        const int keyRow = key.second;
+        auto r = range(wc[(size_t)(keyRow - a)]);
+        for (auto it = r.first; it != r.second; ++it) {
+            const int d = it->second - keyRow;
+            if (d < 1 || n - d < minOverlap || (dy != 0 && d >= dy)) continue;
+            bool ok = true;
+            for (int y = a; y < b - d && ok; ++y) ok = (H[(size_t)y] == P[(size_t)(y + d)]);
+            if (ok) dy = d;
+        }
+        if (dy != 0) break;
+    }
+    if (dy == 0) return StitchResult::NoMatch;
+
+    // footer van het vorige frame eraf, nieuwe rijen + footer erachter
+    const int room = st.maxRows - (st.out.rows - footer) - footer;
+    const int add = std::min(dy, std::max(0, room));
+    RowBufTruncate(st.out, footer);
+    for (int y = b - dy; y < b - dy + add; ++y) RowBufAppend(st.out, px + (size_t)y * stride);
+    for (int y = b; y < st.h; ++y) RowBufAppend(st.out, px + (size_t)y * stride);
+
+    st.lastHeader = header;
+    st.lastFooter = footer;
+    st.lastDy = dy;
+    st.prevHashes.swap(st.curHashes);
+    st.frames++;
+    return (add > 0) ? StitchResult::Appended : StitchResult::NoMovement;
+}
+
+// =========================================================
+// Deflate + inflate (portable, geen Win32)
+// =========================================================
+// Voor --optimize: WIC geeft geen controle over de compressie, dus hier een eigen
+// zlib-stream. Encoder: LZ77 met hash-ketens en lazy matching; per blok dynamische
+// Huffman-codes (package-merge, max 15 bits), vaste codes of stored, wat het kleinst
+// is. Decoder: tabel-gestuurd en begrensd op de verwachte uitvoer (corrupte data
+// geeft false, nooit meer geheugen dan gevraagd).
+static const uint16_t kDeflateLenBase[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+static const uint8_t kDeflateLenExtra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const uint16_t kDeflateDistBase[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+static const uint8_t kDeflateDistExtra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+static const uint8_t kDeflateClOrder[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+static constexpr int kDeflateWindow = 32768;
+static constexpr int kDeflateMaxChain = 128;     // langer = kleiner, trager
+static constexpr int kDeflateLazyLimit = 64;     // match zo lang: niet nog eens zoeken op i+1
+static constexpr size_t kDeflateBlockTokens = 1 << 15;
+
+static uint32_t Adler32(const uint8_t* p, size_t n) {
+    uint32_t a = 1, b = 0;
+    while (n > 0) {
+        const size_t k = n < 5552 ? n : 5552;   // geen overflow vóór de modulo
+        for (size_t i = 0; i < k; ++i) { a += p[i]; b += a; }
+        a %= 65521;
+        b %= 65521;
+        p += k;
+        n -= k;
+    }
+    return (b << 16) | a;
+}
+
+// ---- inflate
+struct InflateTable {
+    std::vector<uint16_t> t;   // index = volgende maxLen bits (LSB eerst), waarde = sym << 4 | len (0 = ongeldig)
+    int maxLen = 0;
+};
+
+// Canonieke codes uit lengtes. false = te veel codes voor de lengtes (corrupt).
+static bool InflateBuild(InflateTable& tab, const uint8_t* lens, int n) {
+    int count[16] = {};
+    for (int i = 0; i < n; ++i) count[lens[i]]++;
+    count[0] = 0;
+
+    int left = 1, maxLen = 0;
+    for (int l = 1; l < 16; ++l) {
+        left = (left << 1) - count[l];
+        if (left < 0) return false;
+        if (count[l]) maxLen = l;
+    }
+
+    int next[16] = {};
+    for (int l = 1, code = 0; l < 16; ++l) {
+        code = (code + count[l - 1]) << 1;
+        next[l] = code;
+    }
+
+    tab.maxLen = maxLen;
+    tab.t.assign((size_t)1 << maxLen, 0);
+    for (int s = 0; s < n; ++s) {
+        const int l = lens[s];
+        if (!l) continue;
+        const int c = next[l]++;
+        size_t rev = 0;
+        for (int i = 0; i < l; ++i) rev |= (size_t)((c >> i) & 1) << (l - 1 - i);
+        for (size_t k = rev; k < tab.t.size(); k += (size_t)1 << l) tab.t[k] = (uint16_t)(s << 4 | l);
+    }
+    return true;
+}
+
+struct InflateBits {
+    const uint8_t* p = nullptr;
+    size_t n = 0;
+    size_t pos = 0;      // volgende byte voor buf (voorbij n: nullen)
+    uint64_t buf = 0;
+    int cnt = 0;
+
+    size_t ConsumedBits() const { return pos * 8 - (size_t)cnt; }
+};
+
+static inline void InflateFill(InflateBits& b) {
+    while (b.cnt <= 56) {
+        const uint64_t byte = b.pos < b.n ? b.p[b.pos] : 0;
+        b.buf |= byte << b.cnt;
+        b.cnt += 8;
+        ++b.pos;
+    }
+}
+
+static inline uint32_t InflateGet(InflateBits& b, int k) {
+    InflateFill(b);
+    const uint32_t v = (uint32_t)(b.buf & ((1ull << k) - 1));
+    b.buf >>= k;
+    b.cnt -= k;
+    return v;
+}
+
+static inline int InflateDecode(InflateBits& b, const InflateTable& tab) {
+    InflateFill(b);
+    const uint16_t e = tab.t[(size_t)(b.buf & ((1ull << tab.maxLen) - 1))];
+    const int l = e & 15;
+    if (l == 0) return -1;
+    b.buf >>= l;
+    b.cnt -= l;
+    return e >> 4;
+}
+
+// zlib-stream -> out. Meer dan maxOut bytes of een foute Adler-32 = corrupt.
+static bool InflateZlib(const uint8_t* p, size_t n, std::vector<uint8_t>& out, size_t maxOut) {
+    out.clear();
+    if (n < 6) return false;
+    const int cmf = p[0], flg = p[1];
+    if ((cmf & 15) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flg) % 31 != 0 || (flg & 0x20)) return false;
+    // maxOut is een bovengrens uit een (onbetrouwbare) header: niet vooraf reserveren,
+    // de buffer groeit met wat de stream echt oplevert
+    out.reserve(std::min(maxOut, n * 4));
+
+    InflateBits b{};
+    b.p = p + 2;
+    b.n = n - 2;
+
+    InflateTable lit, dist, clt;
+    bool last = false;
+    while (!last) {
+        last = InflateGet(b, 1) != 0;
+        const uint32_t type = InflateGet(b, 2);
+
+        if (type == 0) {
+            const int drop = b.cnt & 7;
+            b.buf >>= drop;
+            b.cnt -= drop;
+            const uint32_t len = InflateGet(b, 16), nlen = InflateGet(b, 16);
+            if ((len ^ 0xFFFFu) != nlen || out.size() + len > maxOut) return false;
+            for (uint32_t i = 0; i < len; ++i) out.push_back((uint8_t)InflateGet(b, 8));
+        }
+        else if (type == 1 || type == 2) {
+            uint8_t lens[320] = {};
+            int hlit = 288, hdist = 30;
+            if (type == 1) {
+                for (int i = 0; i < 288; ++i) lens[i] = (uint8_t)(i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+                for (int i = 0; i < 30; ++i) lens[288 + i] = 5;
+            }
+            else {
+                hlit = (int)InflateGet(b, 5) + 257;
+                hdist = (int)InflateGet(b, 5) + 1;
+                const int hclen = (int)InflateGet(b, 4) + 4;
+                if (hlit > 286 || hdist > 30) return false;
+
+                uint8_t cl[19] = {};
+                for (int i = 0; i < hclen; ++i) cl[kDeflateClOrder[i]] = (uint8_t)InflateGet(b, 3);
+                if (!InflateBuild(clt, cl, 19)) return false;
+
+                for (int i = 0; i < hlit + hdist; ) {
+                    const int sym = InflateDecode(b, clt);
+                    if (sym < 0) return false;
+                    if (sym < 16) { lens[i++] = (uint8_t)sym; continue; }
+                    int rep = 0;
+                    uint8_t v = 0;
+                    if (sym == 16) {
+                        if (i == 0) return false;
+                        v = lens[i - 1];
+                        rep = 3 + (int)InflateGet(b, 2);
+                    }
+                    else if (sym == 17) rep = 3 + (int)InflateGet(b, 3);
+                    else rep = 11 + (int)InflateGet(b, 7);
+                    if (i + rep > hlit + hdist) return false;
+                    while (rep-- > 0) lens[i++] = v;
+                }
+                if (lens[256] == 0) return false;
+            }
+            if (!InflateBuild(lit, lens, hlit) || !InflateBuild(dist, lens + hlit, hdist)) return false;
+
+            for (;;) {
+                const int sym = InflateDecode(b, lit);
+                if (sym < 0) return false;
+                if (sym < 256) {
+                    if (out.size() >= maxOut) return false;
+                    out.push_back((uint8_t)sym);
+                    continue;
+                }
+                if (sym == 256) break;
+                const int li = sym - 257;
+                if (li >= 29) return false;
+                const size_t len = kDeflateLenBase[li] + InflateGet(b, kDeflateLenExtra[li]);
+                const int ds = InflateDecode(b, dist);
+                if (ds < 0 || ds >= 30) return false;
+                const size_t d = kDeflateDistBase[ds] + InflateGet(b, kDeflateDistExtra[ds]);
+                if (d > out.size() || out.size() + len > maxOut) return false;
+                const size_t from = out.size() - d;
+                for (size_t k = 0; k < len; ++k) out.push_back(out[from + k]);
+            }
+        }
+        else {
+            return false;
+        }
+        if (b.ConsumedBits() > b.n * 8) return false;
+    }
+
+    const size_t end = (b.ConsumedBits() + 7) / 8;
+    if (end + 4 > b.n) return false;
+    const uint8_t* a = b.p + end;
+    const uint32_t adler = ((uint32_t)a[0] << 24) | ((uint32_t)a[1] << 16) | ((uint32_t)a[2] << 8) | a[3];
+    return adler == Adler32(out.data(), out.size());
+}
+
+// ---- deflate
+struct DeflateBitWriter {
+    std::vector<uint8_t>* out = nullptr;
+    uint64_t buf = 0;
+    int cnt = 0;
+};
+
+static inline void DeflatePut(DeflateBitWriter& w, uint32_t v, int n) {
+    w.buf |= (uint64_t)v << w.cnt;
+    w.cnt += n;
+    while (w.cnt >= 8) {
+        w.out->push_back((uint8_t)w.buf);
+        w.buf >>= 8;
+        w.cnt -= 8;
+    }
+}
+
+static void DeflateAlign(DeflateBitWriter& w) {
+    if (w.cnt > 0) w.out->push_back((uint8_t)w.buf);
+    w.buf = 0;
+    w.cnt = 0;
+}
+
+// Lengtes (max maxBits) voor freq via package-merge; freq 0 -> lengte 0.
+static void HuffmanLengths(const uint32_t* freq, int n, int maxBits, uint8_t* lens) {
+    std::fill(lens, lens + n, (uint8_t)0);
+    std::vector<int> syms;
+    for (int i = 0; i < n; ++i) if (freq[i]) syms.push_back(i);
+    if (syms.empty()) return;
+    if (syms.size() == 1) { lens[syms[0]] = 1; return; }
+    std::sort(syms.begin(), syms.end(), [&](int a, int b) { return freq[a] != freq[b] ? freq[a] < freq[b] : a < b; });
+
+    struct Item { uint64_t w; int leaf; int a, b; };   // leaf >= 0, of een pakket van a+b uit het vorige niveau
+    std::vector<std::vector<Item>> levels((size_t)maxBits);
+    std::vector<Item> leaves;
+    for (int s : syms) leaves.push_back({ freq[s], s, -1, -1 });
+    levels[0] = leaves;
+    for (int L = 1; L < maxBits; ++L) {
+        const std::vector<Item>& prev = levels[(size_t)L - 1];
+        std::vector<Item>& cur = levels[(size_t)L];
+        size_t li = 0, pi = 0;
+        while (li < leaves.size() || pi + 1 < prev.size()) {
+            const bool takeLeaf = pi + 1 >= prev.size() ||
+                (li < leaves.size() && leaves[li].w <= prev[pi].w + prev[pi + 1].w);
+            if (takeLeaf) cur.push_back(leaves[li++]);
+            else { cur.push_back({ prev[pi].w + prev[pi + 1].w, -1, (int)pi, (int)pi + 1 }); pi += 2; }
+        }
+    }
+
+    // elk blad krijgt één bit per keer dat het in de eerste 2m-2 items (uitgeklapt) voorkomt
+    std::vector<std::pair<int, int>> stack;   // (niveau, index)
+    const int take = 2 * (int)syms.size() - 2;
+    for (int i = 0; i < take; ++i) stack.push_back({ maxBits - 1, i });
+    while (!stack.empty()) {
+        const auto [L, i] = stack.back();
+        stack.pop_back();
+        const Item& it = levels[(size_t)L][(size_t)i];
+        if (it.leaf >= 0) lens[it.leaf]++;
+        else { stack.push_back({ L - 1, it.a }); stack.push_back({ L - 1, it.b }); }
+    }
+}
+
+// Canonieke codes, al bit-omgekeerd (deflate schrijft Huffman-codes MSB eerst).
+static void HuffmanCodes(const uint8_t* lens, int n, uint16_t* codes) {
+    int count[16] = {}, next[16] = {};
+    for (int i = 0; i < n; ++i) count[lens[i]]++;
+    count[0] = 0;
+    for (int l = 1, code = 0; l < 16; ++l) {
+        code = (code + count[l - 1]) << 1;
+        next[l] = code;
+    }
+    for (int s = 0; s < n; ++s) {
+        const int l = lens[s];
+        codes[s] = 0;
+        if (!l) continue;
+        const int c = next[l]++;
+        uint16_t rev = 0;
+        for (int i = 0; i < l; ++i) rev |= (uint16_t)(((c >> i) & 1) << (l - 1 - i));
+        codes[s] = rev;
+    }
+}
+
+struct DeflateToken {
+    uint16_t litlen;   // literal (dist == 0) of matchlengte
+    uint16_t dist;
+};
+
+static inline int DeflateLenCode(int len) {
+    int i = 28;
+    while (kDeflateLenBase[i] > len) --i;
+    return i;
+}
+
+static inline int DeflateDistCode(int d) {
+    int i = 29;
+    while (kDeflateDistBase[i] > d) --i;
+    return i;
+}
+
+// Code-length-reeks (lit + dist) -> symbolen 0..18 met extra bits (RLE zoals RFC 1951).
+static void DeflateClRle(const uint8_t* lens, int n, std::vector<std::pair<uint8_t, uint8_t>>& out) {
+    out.clear();
+    for (int i = 0; i < n; ) {
+        const uint8_t v = lens[i];
+        int run = 1;
+        while (i + run < n && lens[i + run] == v) ++run;
+        int left = run;
+        if (v == 0) {
+            while (left >= 11) { const int k = std::min(left, 138); out.push_back({ 18, (uint8_t)(k - 11) }); left -= k; }
+            if (left >= 3) { out.push_back({ 17, (uint8_t)(left - 3) }); left = 0; }
+        }
+        else {
+            out.push_back({ v, 0 });
+            --left;
+            while (left >= 3) { const int k = std::min(left, 6); out.push_back({ 16, (uint8_t)(k - 3) }); left -= k; }
+        }
+        while (left-- > 0) out.push_back({ v, 0 });
+        i += run;
+    }
+}
+
+static void DeflateFixedLens(uint8_t* lit, uint8_t* dist) {
+    for (int i = 0; i < 288; ++i) lit[i] = (uint8_t)(i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8);
+    for (int i = 0; i < 30; ++i) dist[i] = 5;
+}
+
+// Eén blok: tokens [t0,t1) die bytes [b0,b1) van data beslaan. Kiest dynamisch, vast of stored.
+static void DeflateEmitBlock(DeflateBitWriter& w, const uint8_t* data, size_t b0, size_t b1,
+    const DeflateToken* tok, size_t nt, bool last) {
+    uint32_t lf[286] = {}, df[30] = {};
+    for (size_t i = 0; i < nt; ++i) {
+        if (tok[i].dist == 0) lf[tok[i].litlen]++;
+        else { lf[257 + DeflateLenCode(tok[i].litlen)]++; df[DeflateDistCode(tok[i].dist)]++; }
+    }
+    lf[256] = 1;
+
+    uint8_t dl[288] = {}, dd[30] = {};
+    HuffmanLengths(lf, 286, 15, dl);
+    uint32_t dfUsed[30];
+    std::memcpy(dfUsed, df, sizeof(df));
+    int usedDist = 0;
+    for (int i = 0; i < 30; ++i) if (df[i]) ++usedDist;
+    if (usedDist < 2) { if (!dfUsed[0]) dfUsed[0] = 1; if (!dfUsed[1]) dfUsed[1] = 1; } // altijd een complete afstandscode
+    HuffmanLengths(dfUsed, 30, 15, dd);
+
+    int hlit = 286, hdist = 30;
+    while (hlit > 257 && dl[hlit - 1] == 0) --hlit;
+    while (hdist > 1 && dd[hdist - 1] == 0) --hdist;
+
+    uint8_t all[316];
+    std::memcpy(all, dl, (size_t)hlit);
+    std::memcpy(all + hlit, dd, (size_t)hdist);
+    std::vector<std::pair<uint8_t, uint8_t>> rle;
+    DeflateClRle(all, hlit + hdist, rle);
+    uint32_t cf[19] = {};
+    for (const auto& r : rle) cf[r.first]++;
+    uint8_t cl[19] = {};
+    HuffmanLengths(cf, 19, 7, cl);
+    int hclen = 19;
+    while (hclen > 4 && cl[kDeflateClOrder[hclen - 1]] == 0) --hclen;
+
+    uint8_t fl[288], fd[30];
+    DeflateFixedLens(fl, fd);
+
+    // kosten in bits
+    uint64_t dataDyn = 0, dataFix = 0;
+    for (int s = 0; s < 286; ++s) {
+        const uint64_t extra = s >= 257 ? kDeflateLenExtra[s - 257] : 0;
+        dataDyn += (uint64_t)lf[s] * (dl[s] + extra);
+        dataFix += (uint64_t)lf[s] * (fl[s] + extra);
+    }
+    for (int s = 0; s < 30; ++s) {
+        dataDyn += (uint64_t)df[s] * (dd[s] + kDeflateDistExtra[s]);
+        dataFix += (uint64_t)df[s] * (fd[s] + kDeflateDistExtra[s]);
+    }
+    uint64_t hdr = 14 + 3ull * (uint64_t)hclen;
+    for (const auto& r : rle) hdr += cl[r.first] + (r.first == 16 ? 2 : r.first == 17 ? 3 : r.first == 18 ? 7 : 0);
+    const uint64_t costDyn = 3 + hdr + dataDyn;
+    const uint64_t costFix = 3 + dataFix;
+    const size_t rawLen = b1 - b0;
+    const uint64_t costStored = ((uint64_t)rawLen + 5ull * ((rawLen + 65534) / 65535 + (rawLen == 0))) * 8 + 8;
+
+    if (costStored < costDyn && costStored < costFix) {
+        size_t pos = b0;
+        do {
+            const size_t k = std::min<size_t>(b1 - pos, 65535);
+            DeflatePut(w, (last && pos + k == b1) ? 1 : 0, 1);
+            DeflatePut(w, 0, 2);
+            DeflateAlign(w);
+            DeflatePut(w, (uint32_t)k, 16);
+            DeflatePut(w, (uint32_t)k ^ 0xFFFFu, 16);
+            w.out->insert(w.out->end(), data + pos, data + pos + k);
+            pos += k;
+        } while (pos < b1);
+        return;
+    }
+
+    const bool dyn = costDyn < costFix;
+    const uint8_t* L = dyn ? dl : fl;
+    const uint8_t* D = dyn ? dd : fd;
+    uint16_t lc[288], dc[30];
+    HuffmanCodes(L, dyn ? 286 : 288, lc);
+    HuffmanCodes(D, 30, dc);
+
+    DeflatePut(w, last ? 1 : 0, 1);
+    DeflatePut(w, dyn ? 2 : 1, 2);
+    if (dyn) {
+        uint16_t cc[19];
+        HuffmanCodes(cl, 19, cc);
+        DeflatePut(w, (uint32_t)(hlit - 257), 5);
+        DeflatePut(w, (uint32_t)(hdist - 1), 5);
+        DeflatePut(w, (uint32_t)(hclen - 4), 4);
+        for (int i = 0; i < hclen; ++i) DeflatePut(w, cl[kDeflateClOrder[i]], 3);
+        for (const auto& r : rle) {
+            DeflatePut(w, cc[r.first], cl[r.first]);
+            if (r.first == 16) DeflatePut(w, r.second, 2);
+            else if (r.first == 17) DeflatePut(w, r.second, 3);
+            else if (r.first == 18) DeflatePut(w, r.second, 7);
+        }
+    }
+    for (size_t i = 0; i < nt; ++i) {
+        const DeflateToken t = tok[i];
+        if (t.dist == 0) { DeflatePut(w, lc[t.litlen], L[t.litlen]); continue; }
+        const int li = DeflateLenCode(t.litlen);
+        DeflatePut(w, lc[257 + li], L[257 + li]);
+        DeflatePut(w, (uint32_t)(t.litlen - kDeflateLenBase[li]), kDeflateLenExtra[li]);
+        const int di = DeflateDistCode(t.dist);
+        DeflatePut(w, dc[di], D[di]);
+        DeflatePut(w, (uint32_t)(t.dist - kDeflateDistBase[di]), kDeflateDistExtra[di]);
+    }
+    DeflatePut(w, lc[256], L[256]);
+}
+
+static void DeflateZlibBegin(std::vector<uint8_t>& out, size_t n) {
+    out.clear();
+    out.reserve(n / 4 + 64);
+    out.push_back(0x78);
+    out.push_back(0xDA);   // maximale compressie
+}
+
+static void DeflateZlibEnd(DeflateBitWriter& w, const uint8_t* data, size_t n) {
+    DeflateAlign(w);
+    const uint32_t adler = Adler32(data, n);
+    w.out->push_back((uint8_t)(adler >> 24));
+    w.out->push_back((uint8_t)(adler >> 16));
+    w.out->push_back((uint8_t)(adler >> 8));
+    w.out->push_back((uint8_t)adler);
+}
+
+// data -> zlib-stream (CMF/FLG + deflate + Adler-32).
+static void DeflateZlib(const uint8_t* data, size_t n, std::vector<uint8_t>& out) {
+    DeflateZlibBegin(out, n);
+    DeflateBitWriter w{};
+    w.out = &out;
+
+    std::vector<int32_t> head((size_t)1 << 15, -1), prev((size_t)kDeflateWindow, -1);
+    auto hashAt = [&](size_t i) { return (uint32_t)(((uint32_t)data[i] | (uint32_t)data[i + 1] << 8 | (uint32_t)data[i + 2] << 16) * 2654435761u) >> 17; };
+    auto insert = [&](size_t i) {
+        if (i + 2 >= n) return;
+        const uint32_t h = hashAt(i);
+        prev[i & (kDeflateWindow - 1)] = head[h];
+        head[h] = (int32_t)i;
+    };
+    // langste match voor i (i zelf nog niet in de ketens)
+    auto longest = [&](size_t i, int& outDist) {
+        outDist = 0;
+        if (i + 2 >= n) return 0;
+        const int maxLen = (int)std::min<size_t>(258, n - i);
+        int best = 2;
+        int32_t j = head[hashAt(i)];
+        for (int chain = kDeflateMaxChain; j >= 0 && chain > 0; --chain) {
+            const size_t d = i - (size_t)j;
+            if (d > (size_t)kDeflateWindow - 1) break;
+            if (data[(size_t)j + best] == data[i + best] && data[j] == data[i]) {
+                int len = 0;
+                while (len < maxLen && data[(size_t)j + len] == data[i + len]) ++len;
+                if (len > best) {
+                    best = len;
+                    outDist = (int)d;
+                    if (len >= maxLen) break;
+                }
+            }
+            const int32_t nj = prev[(size_t)j & (kDeflateWindow - 1)];
+            if (nj >= j) break;
+            j = nj;
+        }
+        return best >= 3 ? best : 0;
+    };
+
+    std::vector<DeflateToken> tok;
+    tok.reserve(kDeflateBlockTokens + 2);
+    size_t blockStart = 0;
+    auto flush = [&](size_t blockEnd, bool last) {
+        DeflateEmitBlock(w, data, blockStart, blockEnd, tok.data(), tok.size(), last);
+        tok.clear();
+        blockStart = blockEnd;
+    };
+
+    // lazy matching: een match op i wordt pas genomen als i+1 geen langere heeft
+    int prevLen = 0, prevDist = 0;
+    bool havePrev = false;
+    size_t i = 0;
+    while (i < n) {
+        int curDist = 0;
+        const int curLen = (havePrev && prevLen >= kDeflateLazyLimit) ? 0 : longest(i, curDist);
+        insert(i);
+        if (havePrev && prevLen >= 3 && curLen <= prevLen) {
+            tok.push_back({ (uint16_t)prevLen, (uint16_t)prevDist });
+            const size_t end = i - 1 + (size_t)prevLen;
+            for (size_t k = i + 1; k < end; ++k) insert(k);
+            i = end;
+            havePrev = false;
+        }
+        else {
+            if (havePrev) tok.push_back({ data[i - 1], 0 });
+            havePrev = true;
+            prevLen = curLen;
+            prevDist = curDist;
+            ++i;
+        }
+        if (tok.size() >= kDeflateBlockTokens) flush(havePrev ? i - 1 : i, false);   // byte i-1 hangt nog
+    }
+    if (havePrev) tok.push_back({ data[n - 1], 0 });
+    flush(n, true);
+    DeflateZlibEnd(w, data, n);
+}
+
+// ---- exhaustief (achtergrond-recompressie)
+// Optimale parse zoals zopfli: per positie alle (lengte, kleinste afstand)-paren uit
+// lange hash-ketens, daarna kortste pad door de invoer met bitkosten uit de Huffman-
+// lengtes van de vorige ronde; een paar rondes, de goedkoopste wint. Per blok van
+// 1 MB (geheugen begrensd), matches mogen wel terugkijken in het vorige blok.
+// Tientallen keren trager dan DeflateZlib: alleen voor idle-werk.
+static constexpr int kDeflateOptimalChain = 1024;
+static constexpr int kDeflateOptimalIterations = 5;
+static constexpr size_t kDeflateOptimalChunk = (size_t)1 << 20;
+
+struct DeflateCostModel {
+    float lit[286];
+    float dist[30];
+};
+
+static void DeflateCostsFromLens(DeflateCostModel& m, const uint8_t* lit, const uint8_t* dist) {
+    for (int s = 0; s < 286; ++s) m.lit[s] = lit[s] ? (float)lit[s] : 15.0f;   // ongebruikt: duur, niet onmogelijk
+    for (int s = 0; s < 30; ++s) m.dist[s] = dist[s] ? (float)dist[s] : 15.0f;
+    for (int s = 257; s < 286; ++s) m.lit[s] += kDeflateLenExtra[s - 257];
+    for (int s = 0; s < 30; ++s) m.dist[s] += kDeflateDistExtra[s];
+}
+
+static void DeflateCostsFromTokens(DeflateCostModel& m, const std::vector<DeflateToken>& tok) {
+    uint32_t lf[286] = {}, df[30] = {};
+    for (const DeflateToken& t : tok) {
+        if (t.dist == 0) lf[t.litlen]++;
+        else { lf[257 + DeflateLenCode(t.litlen)]++; df[DeflateDistCode(t.dist)]++; }
+    }
+    lf[256] = 1;
+    uint8_t ll[286] = {}, dl[30] = {};
+    HuffmanLengths(lf, 286, 15, ll);
+    HuffmanLengths(df, 30, 15, dl);
+    DeflateCostsFromLens(m, ll, dl);
+}
+
+// Tokens als blokken van kDeflateBlockTokens; elk blok kiest zelf dynamisch/vast/stored.
+static void DeflateEmitTokens(DeflateBitWriter& w, const uint8_t* data, const std::vector<DeflateToken>& tok) {
+    size_t t0 = 0, b0 = 0;
+    do {
+        const size_t t1 = std::min(tok.size(), t0 + kDeflateBlockTokens);
+        size_t b1 = b0;
+        for (size_t i = t0; i < t1; ++i) b1 += tok[i].dist ? tok[i].litlen : 1;
+        DeflateEmitBlock(w, data, b0, b1, tok.data() + t0, t1 - t0, t1 == tok.size());
+        t0 = t1;
+        b0 = b1;
+    } while (t0 < tok.size());
+}
+
+// false = afgebroken via cancel (out is dan ongeldig).
+static bool DeflateZlibExhaustive(const uint8_t* data, size_t n, std::vector<uint8_t>& out,
+    const std::atomic<bool>* cancel = nullptr) {
+    DeflateZlibBegin(out, n);
+    DeflateBitWriter w{};
+    w.out = &out;
+
+    std::vector<int32_t> head((size_t)1 << 15, -1), prev((size_t)kDeflateWindow, -1);
+    auto hashAt = [&](size_t i) { return (uint32_t)(((uint32_t)data[i] | (uint32_t)data[i + 1] << 8 | (uint32_t)data[i + 2] << 16) * 2654435761u) >> 17; };
+
+    std::vector<DeflateToken> all;
+    std::vector<uint32_t> offs;                      // per positie: begin in pairs
+    std::vector<DeflateToken> pairs;                 // (lengte oplopend, kleinste afstand daarvoor)
+    std::vector<float> cost;
+    std::vector<DeflateToken> from;                  // beste stap naar positie i (dist 0 = literal)
+    std::vector<DeflateToken> tok, bestTok;
+
+    DeflateCostModel model{};
+    uint8_t fl[288], fd[30];
+    DeflateFixedLens(fl, fd);
+    DeflateCostsFromLens(model, fl, fd);
+
+    for (size_t c0 = 0; c0 < n; c0 += kDeflateOptimalChunk) {
+        const size_t c1 = std::min(n, c0 + kDeflateOptimalChunk);
+        const size_t len = c1 - c0;
+
+        // 1) matches zoeken (eenmalig per blok)
+        offs.assign(len + 1, 0);
+        pairs.clear();
+        for (size_t i = c0; i < c1; ++i) {
+            offs[i - c0] = (uint32_t)pairs.size();
+            if (i + 2 >= n) continue;
+            if (((i - c0) & 0xFFFF) == 0 && cancel && cancel->load(std::memory_order_relaxed)) return false;
+
+            const int maxLen = (int)std::min<size_t>(258, c1 - i);
+            const uint32_t hsh = hashAt(i);
+            int best = 2;
+            int32_t j = head[hsh];
+            for (int chain = kDeflateOptimalChain; j >= 0 && chain > 0 && best < maxLen; --chain) {
+                const size_t d = i - (size_t)j;
+                if (d > (size_t)kDeflateWindow - 1) break;
+                if (data[(size_t)j + best] == data[i + best]) {
+                    int l = 0;
+                    while (l < maxLen && data[(size_t)j + l] == data[i + l]) ++l;
+                    if (l > best) {
+                        pairs.push_back({ (uint16_t)l, (uint16_t)d });
+                        best = l;
+                    }
+                }
+                const int32_t nj = prev[(size_t)j & (kDeflateWindow - 1)];
+                if (nj >= j) break;
+                j = nj;
+            }
+            prev[i & (kDeflateWindow - 1)] = head[hsh];
+            head[hsh] = (int32_t)i;
+        }
+        offs[len] = (uint32_t)pairs.size();
+
+        // 2) kortste pad, een paar rondes met bijgewerkte kosten
+        float bestCost = 0;
+        bestTok.clear();
+        for (int it = 0; it < kDeflateOptimalIterations; ++it) {
+            if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+
+            float lenCost[259] = {};
+            for (int l = 3; l <= 258; ++l) lenCost[l] = model.lit[257 + DeflateLenCode(l)];
+
+            cost.assign(len + 1, 3.0e38f);
+            from.assign(len + 1, DeflateToken{ 0, 0 });
+            cost[0] = 0;
+            for (size_t i = 0; i < len; ++i) {
+                const float base = cost[i];
+                const float lc = base + model.lit[data[c0 + i]];
+                if (lc < cost[i + 1]) { cost[i + 1] = lc; from[i + 1] = { 1, 0 }; }
+
+                const uint32_t p0 = offs[i], p1 = offs[i + 1];
+                if (p0 == p1) continue;
+                // herhaling: de maximale match is vrijwel altijd de beste, de rest overslaan
+                const bool longest = pairs[p1 - 1].litlen == 258;
+                int lo = longest ? 258 : 3;
+                for (uint32_t k = p0; k < p1; ++k) {
+                    const int hi = pairs[k].litlen;
+                    const int d = pairs[k].dist;
+                    const float dc = base + model.dist[DeflateDistCode(d)];
+                    for (int l = lo; l <= hi; ++l) {
+                        const float c = dc + lenCost[l];
+                        if (c < cost[i + (size_t)l]) { cost[i + (size_t)l] = c; from[i + (size_t)l] = { (uint16_t)l, (uint16_t)d }; }
+                    }
+                    lo = std::max(lo, hi + 1);
+                }
+            }
+
+            tok.clear();
+            for (size_t i = len; i > 0; ) {
+                const DeflateToken f = from[i];
+                if (f.dist == 0) { tok.push_back({ data[c0 + i - 1], 0 }); --i; }
+                else { tok.push_back(f); i -= f.litlen; }
+            }
+            std::reverse(tok.begin(), tok.end());
+
+            if (bestTok.empty() || cost[len] < bestCost) { bestCost = cost[len]; bestTok = tok; }
+            DeflateCostsFromTokens(model, tok);
+        }
+        all.insert(all.end(), bestTok.begin(), bestTok.end());
+    }
+
+    DeflateEmitTokens(w, data, all);
+    DeflateZlibEnd(w, data, n);
+    return true;
+}
+
+// =========================================================
+// PNG/BMP: decoder + lossless PNG-encoder (portable, geen Win32)
+// =========================================================
+// Pixels gaan als top-down RGBA8 tussen decoder en encoder. De encoder kiest de
+// kleinste exacte vorm: palette (1/2/4/8 bit, tRNS alleen bij alpha), grijs of
+// RGB(A), met per rij het filter met de kleinste som van |bytes| (palette en
+// lage bitdieptes proberen ook 'geen filter'). Ancillary chunks die niet van het
+// kleurtype afhangen (pHYs, sRGB, tekst, ...) gaan ongewijzigd mee; iCCP alleen als
+// het profiel (GRAY of RGB) bij het gekozen kleurtype past.
+struct PngChunk {
+    char type[5] = {};
+    std::vector<uint8_t> data;
+};
+
+static uint32_t PngBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void PngPutBE32(std::vector<uint8_t>& b, uint32_t v) {
+    b.push_back((uint8_t)(v >> 24)); b.push_back((uint8_t)(v >> 16));
+    b.push_back((uint8_t)(v >> 8));  b.push_back((uint8_t)v);
+}
+
+static void PngPutChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t n) {
+    PngPutBE32(out, (uint32_t)n);
+    const size_t at = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (n) out.insert(out.end(), data, data + n);
+    PngPutBE32(out, Crc32Update(0, out.data() + at, n + 4));
+}
+
+static const uint8_t kPngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+// Bovengrens voor elke decoder (PNG, BMP, WIC): 2^28 pixels = 1 GB RGBA. Daarboven is
+// een bestand voor ons corrupt, ook als de header klopt.
+static constexpr uint64_t kDecodeMaxPixels = 1ull << 28;
+// deflate comprimeert hooguit ~1032:1; meer belofte dan dat in IHDR = corrupt
+static constexpr uint64_t kInflateMaxRatio = 1032;
+
+// Bevat hun betekenis ook na een ander kleurtype/bitdiepte? (anders weglaten)
+static bool PngKeepAncillary(const char* t) {
+    static const char* const drop[] = { "tRNS", "bKGD", "hIST", "sBIT", "sPLT" };
+    for (const char* d : drop) if (std::memcmp(t, d, 4) == 0) return false;
+    return (t[0] & 0x20) != 0;   // kleine eerste letter = ancillary
+}
+
+// iCCP-profiel met kleurruimte GRAY? (het profiel moet bij het kleurtype passen:
+// GRAY alleen bij grijs, RGB bij truecolour en palette)
+static bool PngIccpIsGray(const std::vector<uint8_t>& d) {
+    const size_t name = std::find(d.begin(), d.end(), (uint8_t)0) - d.begin();
+    if (name == 0 || name > 79 || name + 2 >= d.size() || d[name + 1] != 0) return false;
+    std::vector<uint8_t> prof;
+    if (!InflateZlib(d.data() + name + 2, d.size() - name - 2, prof, (size_t)1 << 24) || prof.size() < 20) return false;
+    return std::memcmp(prof.data() + 16, "GRAY", 4) == 0;
+}
+
+// keep zonder een iCCP dat niet bij het (nieuwe) kleurtype past
+static std::vector<PngChunk> PngKeepForColorType(const std::vector<PngChunk>& keep, bool grayType) {
+    std::vector<PngChunk> out;
+    for (const PngChunk& c : keep) {
+        if (std::memcmp(c.type, "iCCP", 4) == 0 && PngIccpIsGray(c.data) != grayType) continue;
+        out.push_back(c);
+    }
+    return out;
+}
+
+static inline uint8_t PngPaeth(int a, int b, int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return (uint8_t)((pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c));
+}
+
+// why: korte reden als het bestand niet (lossless) te lezen is.
+static bool PngDecode(const uint8_t* p, size_t n, std::vector<uint8_t>& rgba, int& outW, int& outH,
+    std::vector<PngChunk>* keep, const char*& why, uint64_t maxPixels = kDecodeMaxPixels) {
+    why = "corrupt PNG";
+    if (n < 8 + 25 || std::memcmp(p, kPngSignature, 8) != 0) return false;
+
+    int w = 0, h = 0, depth = 0, ctype = 0;
+    std::vector<uint8_t> plte, trns, idat;
+    bool sawIhdr = false, sawEnd = false;
+    for (size_t pos = 8; pos + 12 <= n; ) {
+        const uint32_t len = PngBE32(p + pos);
+        if (len > n - pos - 12) return false;
+        const uint8_t* type = p + pos + 4;
+        const uint8_t* d = type + 4;
+        if (Crc32Update(0, type, (size_t)len + 4) != PngBE32(d + len)) return false;
+
+        if (!sawIhdr) {
+            if (std::memcmp(type, "IHDR", 4) != 0 || len != 13) return false;
+            w = (int)PngBE32(d);
+            h = (int)PngBE32(d + 4);
+            depth = d[8];
+            ctype = d[9];
+            if (d[12] != 0) { why = "interlaced"; return false; }
+            if (depth == 16) { why = "16-bit"; return false; }
+            sawIhdr = true;
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0) idat.insert(idat.end(), d, d + len);
+        else if (std::memcmp(type, "PLTE", 4) == 0) plte.assign(d, d + len);
+        else if (std::memcmp(type, "tRNS", 4) == 0) trns.assign(d, d + len);
+        else if (std::memcmp(type, "IEND", 4) == 0) { sawEnd = true; break; }
+        else if (std::memcmp(type, "acTL", 4) == 0 || std::memcmp(type, "fcTL", 4) == 0) { why = "animated (APNG)"; return false; }
+        else if (!(type[0] & 0x20)) { why = "unknown critical chunk"; return false; }
+        else if (keep) {
+            char t[5] = {};
+            std::memcpy(t, type, 4);
+            if (PngKeepAncillary(t)) {
+                PngChunk c;
+                std::memcpy(c.type, t, 5);
+                c.data.assign(d, d + len);
+                keep->push_back(std::move(c));
+            }
+        }
+        pos += 12 + (size_t)len;
+    }
+    if (!sawIhdr || !sawEnd || w <= 0 || h <= 0 || w > 65535 || h > 65535) return false;
+    if ((uint64_t)w * (uint64_t)h > maxPixels) { why = "image too large"; return false; }
+
+    int channels = 0;
+    switch (ctype) {
+    case 0: channels = 1; if (depth != 1 && depth != 2 && depth != 4 && depth != 8) return false; break;
+    case 2: channels = 3; if (depth != 8) return false; break;
+    case 3: channels = 1; if (depth != 1 && depth != 2 && depth != 4 && depth != 8) return false; break;
+    case 4: channels = 2; if (depth != 8) return false; break;
+    case 6: channels = 4; if (depth != 8) return false; break;
+    default: return false;
+    }
+    if (ctype == 3 && (plte.empty() || plte.size() % 3 != 0 || plte.size() > 768)) return false;
+
+    const size_t rowBytes = ((size_t)w * channels * depth + 7) / 8;
+    const size_t bpp = std::max<size_t>(1, (size_t)channels * depth / 8);
+    if ((uint64_t)(rowBytes + 1) * (uint64_t)h > (uint64_t)idat.size() * kInflateMaxRatio + 1024) return false;
+    std::vector<uint8_t> raw;
+    if (!InflateZlib(idat.data(), idat.size(), raw, (rowBytes + 1) * (size_t)h) || raw.size() != (rowBytes + 1) * (size_t)h) return false;
+
+    // filters terugdraaien (in-place, rij voor rij)
+    for (int y = 0; y < h; ++y) {
+        uint8_t* r = raw.data() + (size_t)y * (rowBytes + 1);
+        const uint8_t f = r[0];
+        uint8_t* cur = r + 1;
+        const uint8_t* up = y ? cur - (rowBytes + 1) : nullptr;
+        if (f > 4) return false;
+        for (size_t x = 0; x < rowBytes; ++x) {
+            const int a = x >= bpp ? cur[x - bpp] : 0;
+            const int b = up ? up[x] : 0;
+            const int c = (up && x >= bpp) ? up[x - bpp] : 0;
+            switch (f) {
+            case 1: cur[x] = (uint8_t)(cur[x] + a); break;
+            case 2: cur[x] = (uint8_t)(cur[x] + b); break;
+            case 3: cur[x] = (uint8_t)(cur[x] + ((a + b) >> 1)); break;
+            case 4: cur[x] = (uint8_t)(cur[x] + PngPaeth(a, b, c)); break;
+            default: break;
+            }
+        }
+    }
+
+    rgba.resize((size_t)w * h * 4);
+    const int maxV = (1 << depth) - 1;
+    const int trGray = (ctype == 0 && trns.size() >= 2) ? (int)((trns[0] << 8) | trns[1]) : -1;
+    const bool trRgb = (ctype == 2 && trns.size() >= 6);
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* s = raw.data() + (size_t)y * (rowBytes + 1) + 1;
+        uint8_t* o = rgba.data() + (size_t)y * w * 4;
+        for (int x = 0; x < w; ++x, o += 4) {
+            switch (ctype) {
+            case 0:
+            case 3: {
+                const int v = depth == 8 ? s[x] : (s[(size_t)x * depth / 8] >> (8 - depth - (x * depth) % 8)) & maxV;
+                if (ctype == 3) {
+                    if ((size_t)v * 3 + 2 >= plte.size()) return false;
+                    o[0] = plte[(size_t)v * 3]; o[1] = plte[(size_t)v * 3 + 1]; o[2] = plte[(size_t)v * 3 + 2];
+                    o[3] = (size_t)v < trns.size() ? trns[(size_t)v] : 255;
+                }
+                else {
+                    const uint8_t g = (uint8_t)(v * 255 / maxV);
+                    o[0] = o[1] = o[2] = g;
+                    o[3] = (v == trGray) ? 0 : 255;
+                }
+                break;
+            }
+            case 2:
+                o[0] = s[x * 3]; o[1] = s[x * 3 + 1]; o[2] = s[x * 3 + 2];
+                o[3] = (trRgb && o[0] == trns[1] && o[1] == trns[3] && o[2] == trns[5] && !trns[0] && !trns[2] && !trns[4]) ? 0 : 255;
+                break;
+            case 4:
+                o[0] = o[1] = o[2] = s[x * 2];
+                o[3] = s[x * 2 + 1];
+                break;
+            default:
+                std::memcpy(o, s + (size_t)x * 4, 4);
+                break;
+            }
+        }
+    }
+    outW = w;
+    outH = h;
+    return true;
+}
+
+// BMP 24/32 bit (BI_RGB of BI_BITFIELDS met standaard maskers), bottom-up of top-down.
+static bool BmpDecode(const uint8_t* p, size_t n, std::vector<uint8_t>& rgba, int& outW, int& outH, const char*& why,
+    uint64_t maxPixels = kDecodeMaxPixels) {
+    why = "unsupported BMP";
+    if (n < 54 || p[0] != 'B' || p[1] != 'M') return false;
+    auto le32 = [&](size_t o) { return (uint32_t)p[o] | (uint32_t)p[o + 1] << 8 | (uint32_t)p[o + 2] << 16 | (uint32_t)p[o + 3] << 24; };
+    const uint32_t off = le32(10), hdr = le32(14);
+    const int w = (int)le32(18);
+    const int hs = (int)le32(22);
+    const int bpp = p[28] | p[29] << 8;
+    const uint32_t comp = le32(30);
+    if (hdr < 40 || w <= 0 || hs == 0 || w > 65535 || std::abs(hs) > 65535) return false;
+    if ((uint64_t)w * (uint64_t)std::abs(hs) > maxPixels) { why = "image too large"; return false; }
+    if (!(bpp == 24 || bpp == 32) || !(comp == 0 || (comp == 3 && bpp == 32))) return false;
+
+    bool useAlpha = false;
+    if (comp == 3) {
+        if (n < 14 + 40 + 12) return false;
+        if (le32(54) != 0x00FF0000u || le32(58) != 0x0000FF00u || le32(62) != 0x000000FFu) return false;
+        useAlpha = hdr >= 56 && n >= 70 && le32(66) == 0xFF000000u;
+    }
+
+    const int h = std::abs(hs);
+    const size_t stride = (((size_t)w * bpp + 31) / 32) * 4;
+    if (off > n || (n - off) / stride < (size_t)h) { why = "truncated BMP"; return false; }
+
+    rgba.resize((size_t)w * h * 4);
+    const int bytes = bpp / 8;
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* s = p + off + (size_t)(hs > 0 ? h - 1 - y : y) * stride;
+        uint8_t* o = rgba.data() + (size_t)y * w * 4;
+        for (int x = 0; x < w; ++x, s += bytes, o += 4) {
+            o[0] = s[2]; o[1] = s[1]; o[2] = s[0];
+            o[3] = useAlpha ? s[3] : 255;
+        }
+    }
+    outW = w;
+    outH = h;
+    return true;
+}
+
+// Gefilterde scanlines (filterbyte + rij) voor een al ingepakte afbeelding.
+// filter 0..4: overal hetzelfde; kPngFilterAdaptive: per rij het filter met de kleinste
+// som van |signed bytes|.
+static constexpr int kPngFilterAdaptive = -1;
+
+static void PngFilterRows(const std::vector<uint8_t>& packed, size_t rowBytes, int h, size_t bpp, int filter,
+    std::vector<uint8_t>& out) {
+    out.resize((rowBytes + 1) * (size_t)h);
+    std::vector<uint8_t> trial[5];
+    for (auto& t : trial) t.resize(rowBytes);
+    for (int y = 0; y < h; ++y) {
+        const uint8_t* cur = packed.data() + (size_t)y * rowBytes;
+        const uint8_t* up = y ? cur - rowBytes : nullptr;
+        uint8_t* dst = out.data() + (size_t)y * (rowBytes + 1);
+        if (filter == 0) {
+            dst[0] = 0;
+            std::memcpy(dst + 1, cur, rowBytes);
+            continue;
+        }
+        uint64_t bestSum = ~0ull;
+        int best = 0;
+        for (int f = 0; f < 5; ++f) {
+            if (filter != kPngFilterAdaptive && f != filter) continue;
+            uint8_t* t = trial[f].data();
+            uint64_t sum = 0;
+            for (size_t x = 0; x < rowBytes; ++x) {
+                const int a = x >= bpp ? cur[x - bpp] : 0;
+                const int b = up ? up[x] : 0;
+                const int c = (up && x >= bpp) ? up[x - bpp] : 0;
+                uint8_t v = cur[x];
+                switch (f) {
+                case 1: v = (uint8_t)(v - a); break;
+                case 2: v = (uint8_t)(v - b); break;
+                case 3: v = (uint8_t)(v - ((a + b) >> 1)); break;
+                case 4: v = (uint8_t)(v - PngPaeth(a, b, c)); break;
+                default: break;
+                }
+                t[x] = v;
+                sum += (uint64_t)std::abs((int)(int8_t)v);
+            }
+            if (sum < bestSum) { bestSum = sum; best = f; }
+        }
+        dst[0] = (uint8_t)best;
+        std::memcpy(dst + 1, trial[best].data(), rowBytes);
+    }
+}
+
+static void PngAssemble(int w, int h, int ctype, int depth, const std::vector<PngChunk>& keep,
+    const std::vector<uint32_t>& palette, const std::vector<uint8_t>& z, std::vector<uint8_t>& png) {
+    png.assign(kPngSignature, kPngSignature + 8);
+    uint8_t ihdr[13] = {};
+    ihdr[0] = (uint8_t)(w >> 24); ihdr[1] = (uint8_t)(w >> 16); ihdr[2] = (uint8_t)(w >> 8); ihdr[3] = (uint8_t)w;
+    ihdr[4] = (uint8_t)(h >> 24); ihdr[5] = (uint8_t)(h >> 16); ihdr[6] = (uint8_t)(h >> 8); ihdr[7] = (uint8_t)h;
+    ihdr[8] = (uint8_t)depth;
+    ihdr[9] = (uint8_t)ctype;
+    PngPutChunk(png, "IHDR", ihdr, 13);
+    for (const PngChunk& k : keep) PngPutChunk(png, k.type, k.data.data(), k.data.size());
+    if (ctype == 3) {
+        std::vector<uint8_t> plte, trns;
+        for (uint32_t col : palette) {
+            const uint8_t* b = (const uint8_t*)&col;
+            plte.insert(plte.end(), b, b + 3);
+            if (b[3] != 255) trns.push_back(b[3]);
+        }
+        PngPutChunk(png, "PLTE", plte.data(), plte.size());
+        if (!trns.empty()) PngPutChunk(png, "tRNS", trns.data(), trns.size());
+    }
+    PngPutChunk(png, "IDAT", z.data(), z.size());
+    PngPutChunk(png, "IEND", nullptr, 0);
+}
+
+// RGBA (top-down) -> kleinste lossless PNG. desc: korte omschrijving van de gekozen vorm.
+// exhaustive: ook vaste filters proberen en de winnaar daarna met DeflateZlibExhaustive
+// opnieuw comprimeren (achtergrondwerk; false als cancel gezet wordt).
+static bool PngEncodeLossless(const uint8_t* rgba, int w, int h, const std::vector<PngChunk>& keep,
+    std::vector<uint8_t>& out, const char*& desc, bool exhaustive = false, const std::atomic<bool>* cancel = nullptr) {
+    out.clear();
+    desc = "";
+    if (w <= 0 || h <= 0) return false;
+    const size_t px = (size_t)w * h;
+
+    bool opaque = true, gray = true;
+    std::unordered_map<uint32_t, uint32_t> colors;   // RGBA -> aantal, tot 257
+    bool fewColors = true;
+    uint32_t lastC = 0, lastN = 0;
+    for (size_t i = 0; i < px; ++i) {
+        const uint8_t* s = rgba + i * 4;
+        if (s[3] != 255) opaque = false;
+        if (s[0] != s[1] || s[1] != s[2]) gray = false;
+        if (!fewColors) continue;
+        uint32_t c;
+        std::memcpy(&c, s, 4);
+        if (lastN && c == lastC) { ++lastN; continue; }
+        if (lastN) colors[lastC] += lastN;
+        lastC = c;
+        lastN = 1;
+        if (colors.size() > 256) fewColors = false;
+    }
+    if (fewColors && lastN) colors[lastC] += lastN;
+    if (colors.size() > 256) fewColors = false;
+
+    struct Candidate { int ctype; int depth; int filter; const char* desc; };
+    std::vector<Candidate> cands;
+    std::vector<uint32_t> palette;   // RGBA, niet-opake kleuren eerst (korte tRNS), dan op frequentie
+    int palDepth = 8;
+    if (fewColors) {
+        std::vector<std::pair<uint32_t, uint32_t>> byUse(colors.begin(), colors.end());
+        std::sort(byUse.begin(), byUse.end(), [](const auto& a, const auto& b) {
+            const bool ta = (a.first >> 24) != 255, tb = (b.first >> 24) != 255;
+            if (ta != tb) return ta;
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+            });
+        for (const auto& e : byUse) palette.push_back(e.first);
+        const size_t k = palette.size();
+        palDepth = k <= 2 ? 1 : k <= 4 ? 2 : k <= 16 ? 4 : 8;
+        static const char* const palDesc[9] = { "", "palette 1-bit", "palette 2-bit", "", "palette 4-bit", "", "", "", "palette 8-bit" };
+        cands.push_back({ 3, palDepth, 0, palDesc[palDepth] });
+        cands.push_back({ 3, palDepth, kPngFilterAdaptive, palDesc[palDepth] });
+    }
+    if (gray) cands.push_back({ opaque ? 0 : 4, 8, kPngFilterAdaptive, opaque ? "gray" : "gray+alpha" });
+    else if (!fewColors) cands.push_back({ opaque ? 2 : 6, 8, kPngFilterAdaptive, opaque ? "rgb" : "rgba" });
+    if (exhaustive && !cands.empty()) {
+        const Candidate last = cands.back();
+        for (int f = last.ctype == 3 ? 1 : 0; f <= 4; ++f) cands.push_back({ last.ctype, last.depth, f, last.desc });
+    }
+
+    std::unordered_map<uint32_t, uint8_t> palIndex;
+    for (size_t i = 0; i < palette.size(); ++i) palIndex[palette[i]] = (uint8_t)i;
+    const std::vector<PngChunk> keepGray = PngKeepForColorType(keep, true);
+    const std::vector<PngChunk> keepColor = PngKeepForColorType(keep, false);
+
+    std::vector<uint8_t> packed, filtered, z, png, bestFiltered;
+    const Candidate* best = nullptr;
+    int packedType = -1;
+    size_t rowBytes = 0, bpp = 1;
+    for (const Candidate& c : cands) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+        if (c.ctype != packedType) {
+            const int ch = c.ctype == 0 ? 1 : c.ctype == 2 ? 3 : c.ctype == 3 ? 1 : c.ctype == 4 ? 2 : 4;
+            rowBytes = ((size_t)w * ch * c.depth + 7) / 8;
+            bpp = std::max<size_t>(1, (size_t)ch * c.depth / 8);
+            packed.assign(rowBytes * (size_t)h, 0);
+            for (int y = 0; y < h; ++y) {
+                const uint8_t* s = rgba + (size_t)y * w * 4;
+                uint8_t* d = packed.data() + (size_t)y * rowBytes;
+                for (int x = 0; x < w; ++x, s += 4) {
+                    switch (c.ctype) {
+                    case 0: d[x] = s[0]; break;
+                    case 2: d[x * 3] = s[0]; d[x * 3 + 1] = s[1]; d[x * 3 + 2] = s[2]; break;
+                    case 4: d[x * 2] = s[0]; d[x * 2 + 1] = s[3]; break;
+                    case 6: std::memcpy(d + (size_t)x * 4, s, 4); break;
+                    default: {
+                        uint32_t col;
+                        std::memcpy(&col, s, 4);
+                        const int v = palIndex[col];
+                        d[(size_t)x * c.depth / 8] |= (uint8_t)(v << (8 - c.depth - (x * c.depth) % 8));
+                        break;
+                    }
+                    }
+                }
+            }
+            packedType = c.ctype;
+        }
+        PngFilterRows(packed, rowBytes, h, bpp, c.filter, filtered);
+        DeflateZlib(filtered.data(), filtered.size(), z);
+        PngAssemble(w, h, c.ctype, c.depth, c.ctype == 0 || c.ctype == 4 ? keepGray : keepColor, palette, z, png);
+
+        if (out.empty() || png.size() < out.size()) {
+            out.swap(png);
+            desc = c.desc;
+            best = &c;
+            if (exhaustive) bestFiltered = filtered;
+        }
+    }
+    if (!exhaustive || !best) return !out.empty();
+
+    if (!DeflateZlibExhaustive(bestFiltered.data(), bestFiltered.size(), z, cancel)) return false;
+    PngAssemble(w, h, best->ctype, best->depth, best->ctype == 0 || best->ctype == 4 ? keepGray : keepColor, palette, z, png);
+    if (png.size() < out.size()) out.swap(png);
+    return true;
+}
+
+// =========================================================
+// Map optimaliseren: work-stealing pool + rapport (portable, geen Win32)
+// =========================================================
+// --optimize <map>: elke .png/.bmp opnieuw lossless encoderen. Een bestand wordt
+// alleen vervangen als het resultaat kleiner is én na opnieuw decoderen pixel-voor-
+// pixel gelijk is; de nieuwe versie gaat via <naam>.opt.tmp + rename (atomair), en
+// niet als het origineel intussen veranderd is. Een BMP wordt een .png met dezelfde
+// stam (alleen als die naam nog vrij is). APNG's (opnames) en 16-bit/interlaced
+// PNG's worden overgeslagen.
+//
+// Pool: elke worker heeft een eigen deque (grootste bestanden eerst, round-robin
+// verdeeld), pakt zelf achteraan en steelt vooraan bij de anderen als de eigen
+// deque leeg is. Er komen geen taken bij, dus leeg overal = klaar.
+struct StealQueue {
+    std::mutex mtx;
+    std::deque<size_t> tasks;
+};
+
+// fn(task, worker) voor elke index in order. Geeft het aantal gestolen taken terug.
+// fn mag niet gooien (in een worker-thread is dat std::terminate): vang per taak af.
+template <class Fn>
+static uint64_t RunWorkStealing(const std::vector<size_t>& order, int threads, Fn fn) {
+    if (threads < 1) threads = 1;
+    std::vector<StealQueue> queues((size_t)threads);
+    for (size_t i = 0; i < order.size(); ++i) queues[i % (size_t)threads].tasks.push_back(order[i]);
+
+    std::atomic<uint64_t> steals{ 0 };
+    auto worker = [&](int self) {
+        for (;;) {
+            size_t task = 0;
+            bool got = false;
+            {
+                StealQueue& own = queues[(size_t)self];
+                std::lock_guard<std::mutex> lk(own.mtx);
+                if (!own.tasks.empty()) { task = own.tasks.back(); own.tasks.pop_back(); got = true; }
+            }
+            for (int k = 1; !got && k < threads; ++k) {
+                StealQueue& victim = queues[(size_t)((self + k) % threads)];
+                std::lock_guard<std::mutex> lk(victim.mtx);
+                if (!victim.tasks.empty()) {
+                    task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                    got = true;
+                    steals.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            if (!got) return;
+            fn(task, self);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& th : pool) th.join();
+    return steals.load();
+}
+
+enum class OptimizeStatus { Smaller, NotSmaller, Skipped, Failed };
+
+struct OptimizeItem {
+    std::filesystem::path path;
+    std::filesystem::path outPath;   // == path, of de .png naast een .bmp
+    std::filesystem::path tmpPath;   // eigen (uniek) tijdelijk bestand naast outPath
+    uint64_t before = 0;
+    uint64_t after = 0;               // == before als er niets vervangen is
+    OptimizeStatus status = OptimizeStatus::Failed;
+    std::string note;                 // gekozen vorm of reden
+    double ms = 0;
+};
+
+struct OptimizeReport {
+    std::vector<OptimizeItem> items;
+    int threads = 0;
+    uint64_t steals = 0;
+    double wallMs = 0;
+};
+
+static bool ReadFileBytes(const std::filesystem::path& path, std::vector<uint8_t>& out) {
+    out.clear();
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    in.seekg(0, std::ios::end);
+    const std::streamoff size = in.tellg();
+    if (size < 0 || size > ((std::streamoff)1 << 30)) return false;
+    out.resize((size_t)size);
+    in.seekg(0, std::ios::beg);
+    return out.empty() || (bool)in.read((char*)out.data(), size);
+}
+
+static bool WriteFileBytes(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    out.write((const char*)data.data(), (std::streamsize)data.size());
+    out.close();
+    return !out.fail();
+}
+
+// Schrijft alleen als path nog niet bestaat (O_EXCL / CREATE_NEW): twee runs of een
+// opname met dezelfde naam krijgen nooit elkaars bestand. false = bestaat al of fout.
+static bool WriteFileBytesExclusive(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+    bool ok = true;
+#if defined(_WIN32)
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    for (size_t off = 0; ok && off < data.size();) {
+        DWORD n = 0;
+        ok = WriteFile(h, data.data() + off, (DWORD)std::min<size_t>(data.size() - off, 1u << 30), &n, nullptr) && n > 0;
+        off += n;
+    }
+    CloseHandle(h);
+#else
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    for (size_t off = 0; ok && off < data.size();) {
+        const ssize_t n = write(fd, data.data() + off, data.size() - off);
+        if (n < 0 && errno == EINTR) continue;
+        ok = n > 0;
+        if (ok) off += (size_t)n;
+    }
+    ok = close(fd) == 0 && ok;
+#endif
+    if (!ok) {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+    return ok;
+}
+
+// Uniek tijdelijk bestand naast target ("<naam>.opt<k>.tmp"), exclusief aangemaakt.
+static bool WriteTempBeside(const std::filesystem::path& target, const std::vector<uint8_t>& data, std::filesystem::path& tmp) {
+    static std::atomic<uint32_t> next{ 0 };
+    for (int tries = 0; tries < 64; ++tries) {
+        tmp = target;
+        tmp += L".opt" + std::to_wstring(next.fetch_add(1, std::memory_order_relaxed)) + L".tmp";
+        if (WriteFileBytesExclusive(tmp, data)) return true;
+        std::error_code ec;
+        if (!std::filesystem::exists(tmp, ec) || ec) break;   // echte fout, niet alleen een bezette naam
+    }
+    tmp.clear();
+    return false;
+}
+
+enum class MoveResult { Moved, Exists, Failed };
+
+// Hernoemen zonder ooit iets te overschrijven, atomair in het bestandssysteem (geen
+// exists-check vooraf): MoveFileExW zonder REPLACE_EXISTING, renameat2(RENAME_NOREPLACE)
+// op Linux, anders link() + unlink() van de bron.
+static MoveResult MoveFileNoReplace(const std::filesystem::path& from, const std::filesystem::path& to) {
+#if defined(_WIN32)
+    if (MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_WRITE_THROUGH)) return MoveResult::Moved;
+    const DWORD err = GetLastError();
+    return err == ERROR_ALREADY_EXISTS || err == ERROR_FILE_EXISTS ? MoveResult::Exists : MoveResult::Failed;
+#else
+#if defined(RENAME_NOREPLACE)
+    if (renameat2(AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_NOREPLACE) == 0) return MoveResult::Moved;
+    if (errno == EEXIST) return MoveResult::Exists;
+    if (errno != EINVAL && errno != ENOSYS) return MoveResult::Failed;   // anders: fs kent de vlag niet
+#endif
+    if (link(from.c_str(), to.c_str()) != 0) return errno == EEXIST ? MoveResult::Exists : MoveResult::Failed;
+    unlink(from.c_str());
+    return MoveResult::Moved;
+#endif
+}
+
+// PNG/BMP-bestand naar RGBA voor achtergrondthreads (diff, similar-indexer): gooit nooit
+// (bad_alloc op een kapot of te groot bestand = niet te lezen). maxPixels: zie kDecodeMaxPixels.
+static bool DecodeImageFile(const std::filesystem::path& path, bool bmp, std::vector<uint8_t>& rgba, int& w, int& h,
+    uint64_t maxPixels, const char*& why) {
+    why = "unreadable";
+    try {
+        std::vector<uint8_t> bytes;
+        if (!ReadFileBytes(path, bytes)) return false;
+        if (bmp ? BmpDecode(bytes.data(), bytes.size(), rgba, w, h, why, maxPixels)
+            : PngDecode(bytes.data(), bytes.size(), rgba, w, h, nullptr, why, maxPixels)) return true;
+    }
+    catch (const std::bad_alloc&) { why = "out of memory"; }
+    catch (...) { why = "decode failed"; }
+    rgba = {};
+    return false;
+}
+
+static void OptimizeOneUnguarded(OptimizeItem& it, std::chrono::steady_clock::time_point t0) {
+    namespace fs = std::filesystem;
+    auto done = [&](OptimizeStatus st, std::string note) {
+        it.status = st;
+        it.note = std::move(note);
+        it.ms = MsSince(t0);
+    };
+
+    std::error_code ec;
+    const fs::file_time_type mtime = fs::last_write_time(it.path, ec);
+    std::vector<uint8_t> src;
+    if (ec || !ReadFileBytes(it.path, src)) return done(OptimizeStatus::Failed, "read failed");
+    it.before = it.after = src.size();
+
+    std::wstring ext = it.path.extension().wstring();
+    for (auto& c : ext) if (c >= L'A' && c <= L'Z') c = (wchar_t)(c - L'A' + L'a');
+    const bool isBmp = ext == L".bmp";
+
+    std::vector<uint8_t> rgba;
+    std::vector<PngChunk> keep;
+    int w = 0, h = 0;
+    const char* why = "";
+    const bool decoded = isBmp ? BmpDecode(src.data(), src.size(), rgba, w, h, why)
+        : PngDecode(src.data(), src.size(), rgba, w, h, &keep, why);
+    if (!decoded) return done(OptimizeStatus::Skipped, why);
+
+    std::vector<uint8_t> png;
+    const char* desc = "";
+    if (!PngEncodeLossless(rgba.data(), w, h, keep, png, desc)) return done(OptimizeStatus::Failed, "encode failed");
+    if (png.size() >= src.size()) return done(OptimizeStatus::NotSmaller, desc);
+
+    // controle: het resultaat moet exact dezelfde pixels opleveren
+    std::vector<uint8_t> check;
+    int cw = 0, ch = 0;
+    if (!PngDecode(png.data(), png.size(), check, cw, ch, nullptr, why) || cw != w || ch != h || check != rgba)
+        return done(OptimizeStatus::Failed, "verify mismatch");
+
+    it.outPath = it.path;
+    if (isBmp) it.outPath.replace_extension(L".png");
+
+    if (!WriteTempBeside(it.outPath, png, it.tmpPath)) return done(OptimizeStatus::Failed, "write failed");
+    fs::last_write_time(it.tmpPath, mtime, ec);
+
+    // is het origineel onderweg aangepast (bijv. een nieuwe opname met dezelfde naam)? dan laten staan
+    auto unchanged = [&] {
+        std::error_code e1, e2;
+        return fs::file_size(it.path, e1) == src.size() && fs::last_write_time(it.path, e2) == mtime && !e1 && !e2;
+    };
+    if (!unchanged()) {
+        fs::remove(it.tmpPath, ec);
+        return done(OptimizeStatus::Skipped, "changed during optimize");
+    }
+
+    if (!isBmp) {
+        fs::rename(it.tmpPath, it.outPath, ec);
+        if (ec) {
+            fs::remove(it.tmpPath, ec);
+            return done(OptimizeStatus::Failed, "replace failed");
+        }
+    }
+    else {
+        // .png naast de .bmp: nooit een bestaand bestand vervangen (ook niet als het net
+        // tussen de controle en het hernoemen ontstaat)
+        const MoveResult mr = MoveFileNoReplace(it.tmpPath, it.outPath);
+        if (mr != MoveResult::Moved) {
+            fs::remove(it.tmpPath, ec);
+            return done(mr == MoveResult::Exists ? OptimizeStatus::Skipped : OptimizeStatus::Failed,
+                mr == MoveResult::Exists ? ".png name taken" : "rename failed");
+        }
+        // BMP intussen aangepast: de conversie terugdraaien, het origineel blijft de waarheid
+        if (!unchanged()) {
+            fs::remove(it.outPath, ec);
+            return done(OptimizeStatus::Skipped, "changed during optimize");
+        }
+        fs::remove(it.path, ec);
+    }
+    it.tmpPath.clear();
+    it.after = png.size();
+    done(OptimizeStatus::Smaller, desc);
+}
+
+// Per bestand afgevangen: een kapot of te groot bestand (bad_alloc) blijft staan en
+// komt als 'skipped' in het rapport, de rest van de map gaat door.
+static void OptimizeOne(OptimizeItem& it) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const char* why = nullptr;
+    try {
+        OptimizeOneUnguarded(it, t0);
+        return;
+    }
+    catch (const std::bad_alloc&) { why = "kept: out of memory (corrupt or too large)"; }
+    catch (...) { why = "kept: corrupt"; }
+    std::error_code ec;
+    if (!it.tmpPath.empty()) std::filesystem::remove(it.tmpPath, ec);
+    it.after = it.before;
+    it.status = OptimizeStatus::Skipped;
+    it.note = why;
+    it.ms = MsSince(t0);
+}
+
+// Alle .png onder dir (recursief), met convertBmp ook de .bmp's (die worden een .png
+// naast het origineel; alleen op verzoek, want het pad verandert). false = map niet leesbaar.
+static bool OptimizeFolder(const std::filesystem::path& dir, int threads, OptimizeReport& report, bool convertBmp = false) {
+    namespace fs = std::filesystem;
+    const auto t0 = std::chrono::steady_clock::now();
+    report = {};
+
+    std::error_code ec;
+    if (!fs::is_directory(dir, ec)) return false;
+    for (fs::recursive_directory_iterator itr(dir, fs::directory_options::skip_permission_denied, ec), end;
+        !ec && itr != end; itr.increment(ec)) {
+        if (!itr->is_regular_file(ec)) continue;
+        std::wstring ext = itr->path().extension().wstring();
+        for (auto& c : ext) if (c >= L'A' && c <= L'Z') c = (wchar_t)(c - L'A' + L'a');
+        if (ext != L".png" && !(convertBmp && ext == L".bmp")) continue;
+        OptimizeItem it;
+        it.path = itr->path();
+        it.before = itr->file_size(ec);
+        report.items.push_back(std::move(it));
+    }
+    if (ec) return false;
+
+    std::vector<size_t> order(report.items.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return report.items[a].before > report.items[b].before; });
+
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    threads = (int)std::min<size_t>((size_t)threads, std::max<size_t>(1, order.size()));
+    report.threads = threads;
+    report.steals = RunWorkStealing(order, threads, [&](size_t i, int) { OptimizeOne(report.items[i]); });
+    report.wallMs = MsSince(t0);
+    return true;
+}
+
+static std::wstring FormatOptimizeReport(const OptimizeReport& r) {
+    std::wstring out;
+    wchar_t line[1024];
+    uint64_t before = 0, after = 0, readBytes = 0;
+    double cpuMs = 0;
+    int counts[4] = {};
+    for (const OptimizeItem& it : r.items) {
+        before += it.before;
+        after += it.after;
+        readBytes += it.before;
+        cpuMs += it.ms;
+        counts[(int)it.status]++;
+        if (it.status == OptimizeStatus::NotSmaller) continue;
+
+        const wchar_t* tag = it.status == OptimizeStatus::Smaller ? L"saved  " : it.status == OptimizeStatus::Skipped ? L"skipped" : L"FAILED ";
+        const std::wstring note(it.note.begin(), it.note.end());
+        if (it.status == OptimizeStatus::Smaller) {
+            swprintf(line, 1024, L"%ls %ls: %llu -> %llu bytes (-%.1f%%, %ls, %.0f ms)\n", tag, it.outPath.wstring().c_str(),
+                (unsigned long long)it.before, (unsigned long long)it.after,
+                it.before ? 100.0 * (double)(it.before - it.after) / (double)it.before : 0.0, note.c_str(), it.ms);
+        }
+        else {
+            swprintf(line, 1024, L"%ls %ls: %ls\n", tag, it.path.wstring().c_str(), note.c_str());
+        }
+        out += line;
+    }
+
+    swprintf(line, 1024,
+        L"\n%zu files: %d smaller, %d already optimal, %d skipped, %d failed\n"
+        L"%llu -> %llu bytes, saved %llu (%.1f%%)\n"
+        L"%.0f ms wall, %.0f ms cpu, %d threads, %llu steals, %.1f MB/s\n",
+        r.items.size(), counts[0], counts[1], counts[2], counts[3],
+        (unsigned long long)before, (unsigned long long)after, (unsigned long long)(before - after),
+        before ? 100.0 * (double)(before - after) / (double)before : 0.0,
+        r.wallMs, cpuMs, r.threads, (unsigned long long)r.steals,
+        r.wallMs > 0 ? (double)readBytes / 1048576.0 / (r.wallMs / 1000.0) : 0.0);
+    out += line;
+    return out;
+}
+
+// =========================================================
+// Recompressie-wachtrij: journal + planning (portable, geen Win32)
+// =========================================================
+// Opslaan blijft snel (WIC); elke opgeslagen PNG komt daarna in deze rij voor een
+// exhaustieve pass (PngEncodeLossless met exhaustive) die alleen draait als de
+// gebruiker een tijd niets doet. Journal (UTF-16LE, alleen toevoegen):
+//   A <bytes> <writeTime> <pad>   in de rij (grootte + schrijftijd bij opslaan)
+//   F <pad>                       mislukte poging (na kRecompressMaxAttempts: opgeven)
+//   D <pad>                       klaar, vervallen of opgegeven
+// Opnieuw afspelen geeft de rij; veel D-regels -> compact herschrijven.
+struct RecompressJob {
+    std::wstring path;
+    uint64_t bytes = 0;
+    uint64_t writeTime = 0;   // FILETIME-ticks: anders = door iemand anders aangepast, overslaan
+    int attempts = 0;
+};
+
+static constexpr int kRecompressMaxAttempts = 3;
+static constexpr uint32_t kRecompressPollMs = 60 * 1000;     // op batterij: later nog eens kijken
+static constexpr uint32_t kRecompressWaitForever = 0xFFFFFFFFu;
+
+static std::wstring FormatRecompressLine(wchar_t op, const RecompressJob& j) {
+    if (op != L'A') return std::wstring(1, op) + L" " + j.path + L"\r\n";
+    wchar_t head[64]{};
+    swprintf(head, 64, L"A %llu %llu ", (unsigned long long)j.bytes, (unsigned long long)j.writeTime);
+    return head + j.path + L"\r\n";
+}
+
+// Journal -> rij (volgorde van toevoegen). outLines: aantal geldige regels (voor compactie).
+static std::vector<RecompressJob> ReplayRecompressJournal(const wchar_t* s, size_t n, size_t* outLines) {
+    std::vector<RecompressJob> jobs;
+    size_t lines = 0;
+    auto find = [&](const std::wstring& path) {
+        return std::find_if(jobs.begin(), jobs.end(), [&](const RecompressJob& j) { return j.path == path; });
+    };
+
+    size_t i = 0;
+    while (i < n) {
+        size_t end = i;
+        while (end < n && s[end] != L'\n') ++end;
+        std::wstring line(s + i, s + end);
+        if (!line.empty() && line.back() == L'\r') line.pop_back();
+        i = end + 1;
+        if (line.size() < 3 || line[1] != L' ') continue;
+
+        const wchar_t op = line[0];
+        if (op == L'A') {
+            RecompressJob j{};
+            wchar_t* p = nullptr;
+            j.bytes = wcstoull(line.c_str() + 2, &p, 10);
+            if (!p || *p != L' ') continue;
+            j.writeTime = wcstoull(p + 1, &p, 10);
+            if (!p || *p != L' ' || !p[1]) continue;
+            j.path = p + 1;
+            auto it = find(j.path);
+            if (it != jobs.end()) *it = std::move(j);   // opnieuw opgeslagen onder dezelfde naam
+            else jobs.push_back(std::move(j));
+        }
+        else if (op == L'F' || op == L'D') {
+            auto it = find(line.substr(2));
+            if (it == jobs.end()) continue;
+            if (op == L'D' || ++it->attempts >= kRecompressMaxAttempts) jobs.erase(it);
+        }
+        else {
+            continue;
+        }
+        ++lines;
+    }
+    if (outLines) *outLines = lines;
+    return jobs;
+}
+
+struct RecompressPlan {
+    bool run = false;
+    size_t job = 0;                           // index in de rij (als run)
+    uint32_t waitMs = kRecompressWaitForever;  // anders: zo lang wachten (of tot er iets bijkomt)
+};
+
+// Wat nu: een job draaien of wachten. Eerst-in-eerst-uit; alleen als de gebruiker al
+// idleMs niets gedaan heeft en niet op batterij.
+static RecompressPlan PlanRecompress(const std::vector<RecompressJob>& jobs, uint64_t userIdleMs, uint64_t idleMs, bool onBattery) {
+    RecompressPlan plan{};
+    if (jobs.empty()) return plan;
+    if (onBattery) { plan.waitMs = kRecompressPollMs; return plan; }
+    if (userIdleMs < idleMs) {
+        plan.waitMs = (uint32_t)std::min<uint64_t>(idleMs - userIdleMs + 250, kRecompressPollMs);
+        return plan;
+    }
+    plan.run = true;
+    plan.job = 0;
+    plan.waitMs = 0;
+    return plan;
+}
+
+#if !SNIP_CORE_ONLY
+// =========================================================
+// Recompressie op de achtergrond
+// =========================================================
+// Eén scheduler-thread (background-prioriteit, CPU + IO) kijkt naar GetLastInputInfo
+// en start per job een encode-thread met dezelfde prioriteit. Komt de gebruiker terug
+// (of sluit de app), dan zet de scheduler cancel: de job blijft in de rij en begint
+// later opnieuw. Is het resultaat kleiner en na decoderen pixel-gelijk, dan gaat het
+// via <pad>.rc.tmp + MoveFileEx over het origineel (schrijftijd blijft behouden);
+// de UI-thread werkt daarna de grootte in het duplicate-index bij.
+struct RecompressState {
+    std::mutex mu;                    // alles hieronder
+    std::vector<RecompressJob> jobs;
+    bool loaded = false;
+    size_t journalLines = 0;
+
+    std::thread scheduler;
+    std::condition_variable cv;
+    bool wake = false;
+    bool stop = false;
+};
+static RecompressState g_recompress;
+
+struct RecompressDone {               // scheduler -> UI (WM_RECOMPRESS_DONE, lParam, UI geeft vrij)
+    std::wstring path;
+    uint64_t before = 0;
+    uint64_t after = 0;
+};
+
+static std::wstring RecompressJournalFile() {
+    return SettingsDir() + L"\\recompress-journal.txt";
+}
+
+// mu moet vastgehouden worden.
+static void RecompressCompactLocked() {
+    std::wstring all;
+    for (const RecompressJob& j : g_recompress.jobs) all += FormatRecompressLine(L'A', j);
+
+    const std::wstring file = RecompressJournalFile();
+    const std::wstring tmp = file + L".tmp";
+    DeleteFileW(tmp.c_str());
+    if (all.empty()) DeleteFileW(file.c_str());
+    else if (AppendToFile(tmp, all.data(), (DWORD)(all.size() * sizeof(wchar_t))))
+        MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    // mislukte pogingen gaan bij compactie verloren: hooguit een paar extra pogingen
+    g_recompress.journalLines = g_recompress.jobs.size();
+}
+
+// mu moet vastgehouden worden.
+static void RecompressLoadLocked() {
+    if (g_recompress.loaded) return;
+    g_recompress.loaded = true;
+
+    std::vector<uint8_t> raw;
+    if (!ReadWholeFile(RecompressJournalFile(), raw)) return;
+    size_t lines = 0;
+    g_recompress.jobs = ReplayRecompressJournal((const wchar_t*)raw.data(), raw.size() / sizeof(wchar_t), &lines);
+    g_recompress.journalLines = lines;
+    if (lines > g_recompress.jobs.size()) RecompressCompactLocked();
+}
+
+// mu moet vastgehouden worden.
+static void RecompressAppendLocked(wchar_t op, const RecompressJob& j) {
+    EnsureDirectoryRecursive(SettingsDir() + L"\\");
+    const std::wstring line = FormatRecompressLine(op, j);
+    AppendToFile(RecompressJournalFile(), line.data(), (DWORD)(line.size() * sizeof(wchar_t)));
+    g_recompress.journalLines++;
+    if (g_recompress.journalLines > 2 * g_recompress.jobs.size() + 64) RecompressCompactLocked();
+}
+
+static uint64_t UserIdleMs() {
+    LASTINPUTINFO lii{};
+    lii.cbSize = sizeof(lii);
+    if (!GetLastInputInfo(&lii)) return 0;
+    return (uint64_t)(DWORD)(GetTickCount() - lii.dwTime);
+}
+
+static bool OnBatteryPower() {
+    SYSTEM_POWER_STATUS ps{};
+    return GetSystemPowerStatus(&ps) && ps.ACLineStatus == 0;
+}
+
+enum class RecompressResult { Replaced, Kept, Canceled, Failed };
+
+// Encode-thread. Kept = niets te winnen of het bestand is niet meer van ons (klaar).
+static RecompressResult RecompressOne(const RecompressJob& job, const std::atomic<bool>* cancel, RecompressDone& done) {
+    const auto t0 = std::chrono::steady_clock::now();
+    uint64_t bytes = 0, wt = 0;
+    if (!QueryFileSizeAndTime(job.path, bytes, wt) || bytes != job.bytes || wt != job.writeTime) return RecompressResult::Kept;
+
+    std::vector<uint8_t> src;
+    if (!ReadWholeFile(job.path, src)) return RecompressResult::Failed;
+    std::vector<uint8_t> rgba, check, png;
+    std::vector<PngChunk> keep;
+    int w = 0, h = 0, cw = 0, ch = 0;
+    const char* why = "";
+    if (!PngDecode(src.data(), src.size(), rgba, w, h, &keep, why)) return RecompressResult::Kept;
+
+    const char* desc = "";
+    if (!PngEncodeLossless(rgba.data(), w, h, keep, png, desc, true, cancel)) {
+        return (cancel && cancel->load()) ? RecompressResult::Canceled : RecompressResult::Failed;
+    }
+    DebugLog(L"[recompress] %llu -> %llu bytes (%S) in %.0f ms", (unsigned long long)src.size(), (unsigned long long)png.size(), desc, MsSince(t0));
+    if (png.size() >= src.size()) return RecompressResult::Kept;
+    if (!PngDecode(png.data(), png.size(), check, cw, ch, nullptr, why) || cw != w || ch != h || check != rgba) return RecompressResult::Failed;
+
+    // naast het origineel schrijven, schrijftijd overnemen, dan atomair erover
+    const std::wstring tmp = job.path + L".rc.tmp";
+    HANDLE hf = CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hf == INVALID_HANDLE_VALUE) return RecompressResult::Failed;
+    DWORD written = 0;
+    bool ok = WriteFile(hf, png.data(), (DWORD)png.size(), &written, nullptr) && written == png.size();
+    FILETIME ft{};
+    ft.dwLowDateTime = (DWORD)job.writeTime;
+    ft.dwHighDateTime = (DWORD)(job.writeTime >> 32);
+    ok = ok && SetFileTime(hf, nullptr, nullptr, &ft);
+    CloseHandle(hf);
+
+    // intussen aangepast (editor)? dan blijft het origineel staan
+    ok = ok && QueryFileSizeAndTime(job.path, bytes, wt) && bytes == job.bytes && wt == job.writeTime;
+    if (!ok || !MoveFileExW(tmp.c_str(), job.path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileW(tmp.c_str());
+        return ok ? RecompressResult::Failed : RecompressResult::Kept;
+    }
+    done.path = job.path;
+    done.before = src.size();
+    done.after = png.size();
+    return RecompressResult::Replaced;
+}
+
+static void RecompressSchedulerThread() {
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN); // CPU + IO laag
+
+    std::unique_lock<std::mutex> lock(g_recompress.mu);
+    RecompressLoadLocked();
+    while (!g_recompress.stop) {
+        const RecompressPlan plan = PlanRecompress(g_recompress.jobs, UserIdleMs(),
+            (uint64_t)g_recompressIdleSeconds * 1000ull, OnBatteryPower());
+        if (!plan.run) {
+            g_recompress.wake = false;
+            auto woken = [] { return g_recompress.stop || g_recompress.wake; };
+            if (plan.waitMs == kRecompressWaitForever) g_recompress.cv.wait(lock, woken);
+            else g_recompress.cv.wait_for(lock, std::chrono::milliseconds(plan.waitMs), woken);
+            continue;
+        }
+
+        const RecompressJob job = g_recompress.jobs[plan.job];
+        std::atomic<bool> cancel{ false };
+        bool finished = false;
+        RecompressResult result = RecompressResult::Failed;
+        RecompressDone done{};
+        std::thread encoder([&] {
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+            // kapot of te groot bestand (bad_alloc): niet opnieuw proberen, het origineel blijft
+            RecompressResult r = RecompressResult::Kept;
+            try { r = RecompressOne(job, &cancel, done); }
+            catch (...) { DebugLog(L"[recompress] decode/encode threw, kept"); }
+            std::lock_guard<std::mutex> g(g_recompress.mu);
+            result = r;
+            finished = true;
+            g_recompress.cv.notify_all();
+            });
+        // gebruiker terug of app dicht: afbreken (de job blijft staan)
+        while (!finished) {
+            g_recompress.cv.wait_for(lock, std::chrono::seconds(1));
+            if (g_recompress.stop || UserIdleMs() < 1000ull * (uint64_t)g_recompressIdleSeconds) cancel = true;
+        }
+        lock.unlock();
+        encoder.join();
+        lock.lock();
+
+        if (result == RecompressResult::Canceled) continue;
+        auto& jobs = g_recompress.jobs;
+        auto it = std::find_if(jobs.begin(), jobs.end(), [&](const RecompressJob& j) { return j.path == job.path; });
+        if (it == jobs.end() || it->bytes != job.bytes || it->writeTime != job.writeTime) continue; // intussen opnieuw in de rij
+        if (result == RecompressResult::Failed && ++it->attempts < kRecompressMaxAttempts) {
+            RecompressAppendLocked(L'F', job);
+            std::rotate(it, it + 1, jobs.end());   // eerst de rest
+            continue;
+        }
+        jobs.erase(it);
+        RecompressAppendLocked(L'D', job);
+        if (result == RecompressResult::Replaced && g_hwndMsg) {
+            PostMessageW(g_hwndMsg, WM_RECOMPRESS_DONE, 0, (LPARAM)new RecompressDone(std::move(done)));
+        }
+    }
+}
+
+// Start de scheduler (opstart: rij uit het journal) of maak hem wakker.
+static void RecompressRequest() {
+    if (!g_recompressEnabled) return;
+    std::lock_guard<std::mutex> lock(g_recompress.mu);
+    if (!g_recompress.scheduler.joinable()) {
+        g_recompress.stop = false;
+        g_recompress.scheduler = std::thread(RecompressSchedulerThread);
+        return;
+    }
+    g_recompress.wake = true;
+    g_recompress.cv.notify_all();
+}
+
+// UI-thread, na een geslaagde PNG-save.
+static void RecompressEnqueue(const std::wstring& path) {
+    if (!g_recompressEnabled) return;
+    RecompressJob j{};
+    j.path = path;
+    if (!QueryFileSizeAndTime(path, j.bytes, j.writeTime)) return;
+    {
+        std::lock_guard<std::mutex> lock(g_recompress.mu);
+        RecompressLoadLocked();
+        auto& jobs = g_recompress.jobs;
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const RecompressJob& o) { return o.path == path; }), jobs.end());
+        jobs.push_back(j);
+        RecompressAppendLocked(L'A', j);
+    }
+    RecompressRequest();
+}
+
+static void RecompressStop() {
+    {
+        std::lock_guard<std::mutex> lock(g_recompress.mu);
+        g_recompress.stop = true;
+    }
+    g_recompress.cv.notify_all();
+    if (g_recompress.scheduler.joinable()) g_recompress.scheduler.join();
+}
+
+// UI-thread: het duplicate-index kent het bestand met de oude grootte.
+static void RecompressApplyDone(RecompressDone* d) {
+    LoadHashIndex();
+    for (auto& kv : g_hashIndex) {
+        HashIndexEntry& e = kv.second;
+        if (e.bytes != d->before || _wcsicmp(e.path.c_str(), d->path.c_str()) != 0) continue;
+        if (!HashIndexRestamp(e)) continue;
+        const std::wstring line = FormatHashIndexLine(kv.first, e);
+        AppendToFile(HashIndexFile(), line.data(), (DWORD)(line.size() * sizeof(wchar_t)));
+        g_hashIndexLines++;
+    }
+    DebugLog(L"[recompress] %s: %llu -> %llu bytes", d->path.c_str(), (unsigned long long)d->before, (unsigned long long)d->after);
+    delete d;
+}
+
+#endif // !SNIP_CORE_ONLY
+
+// =========================================================
+// Capture-catalogus: bestandsformaat + zoekindex (portable, geen Win32)
+// =========================================================
+// Eén record per opgeslagen capture, alleen toevoegen. Little-endian, records op 8 bytes
+// uitgelijnd, zodat het bestand gemapt en zonder kopie doorlopen kan worden:
+//   header: "SNIPCAT1", u32 version, u32 0
+//   record: u32 'CREC', u32 size (incl. padding), u64 time (FILETIME-ticks, UTC),
+//           u64 hash, u64 bytes, i32 left/top/right/bottom (scherm), i16 utcOffsetMin,
+//           u8 mode, u8 fmt, u8 flags, 3x u8 0, u16 pathLen/titleLen/procLen, u16 0,
+//           UTF-16 pad + titel + proces, u32 CRC-32 (over alles ervoor), nullen tot 8
+// flags: 1 = hash geldig, 2 = tombstone (eerdere records met dit pad vervallen).
+// Een half geschreven laatste record (crash) wordt genegeerd; de schrijver kapt het
+// bestand eerst af tot het laatste geldige record.
+//
+// Zoeken: per entry één regel kleine letters (titel, proces, bestandsnaam, mode,
+// formaat, datum + weekdag + maand + tijd). Termen van 3+ tekens zoeken als substring
+// (over alle tekst, daarna alleen nog binnen de kandidaten); kortere termen als
+// woord-prefix via een gesorteerde lijst woordsleutels (binair zoeken), anders matcht
+// "b" vrijwel alles. Alle termen moeten passen; nieuwste eerst.
+static constexpr char kCatalogMagic[8] = { 'S','N','I','P','C','A','T','1' };
+static constexpr uint32_t kCatalogVersion = 1;
+static constexpr uint32_t kCatalogRecordTag = 0x43455243; // "CREC"
+static constexpr size_t kCatalogHeaderBytes = 16;
+static constexpr size_t kCatalogRecordFixed = 64;
+static constexpr size_t kCatalogMaxTitle = 512;           // langere titels worden afgekapt
+
+static constexpr uint8_t kCatalogHashValid = 1;
+static constexpr uint8_t kCatalogRemoved = 2;
+
+struct CatalogEntry {
+    uint64_t time = 0;          // FILETIME-ticks (UTC)
+    uint64_t hash = 0;
+    uint64_t bytes = 0;
+    int32_t left = 0, top = 0, right = 0, bottom = 0;
+    int16_t utcOffsetMin = 0;   // lokale tijd = UTC + offset (bij opslaan)
+    uint8_t mode = 0;           // Mode
+    uint8_t fmt = 0;            // SaveFormat (opgelost, dus nooit Auto)
+    uint8_t flags = 0;
+    std::wstring path;
+    std::wstring title;         // venstertitel van de bron (kan leeg zijn)
+    std::wstring process;       // exe-naam van de bron, bv "chrome.exe"
+};
+
+static void CatalogPutHeader(std::vector<uint8_t>& out) {
+    out.insert(out.end(), kCatalogMagic, kCatalogMagic + 8);
+    for (int i = 0; i < 4; ++i) out.push_back((uint8_t)(kCatalogVersion >> (8 * i)));
+    for (int i = 0; i < 4; ++i) out.push_back(0);
+}
+
+template <class T> static void CatalogPut(std::vector<uint8_t>& out, T v) {
+    for (size_t i = 0; i < sizeof(T); ++i) out.push_back((uint8_t)((uint64_t)v >> (8 * i)));
+}
+
+template <class T> static T CatalogGet(const uint8_t* p) {
+    uint64_t x = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) x |= (uint64_t)p[i] << (8 * i);
+    return (T)x;
+}
+
+static void CatalogPutString(std::vector<uint8_t>& out, const std::wstring& s, size_t n) {
+    for (size_t i = 0; i < n; ++i) CatalogPut<uint16_t>(out, (uint16_t)s[i]);
+}
+
+static void CatalogPutRecord(std::vector<uint8_t>& out, const CatalogEntry& e) {
+    const size_t at = out.size();
+    const size_t pathLen = std::min<size_t>(e.path.size(), 0x7FFF);
+    const size_t titleLen = std::min(e.title.size(), kCatalogMaxTitle);
+    const size_t procLen = std::min<size_t>(e.process.size(), 260);
+    const size_t raw = kCatalogRecordFixed + 2 * (pathLen + titleLen + procLen) + 4;
+    const size_t size = (raw + 7) & ~(size_t)7;
+
+    CatalogPut<uint32_t>(out, kCatalogRecordTag);
+    CatalogPut<uint32_t>(out, (uint32_t)size);
+    CatalogPut<uint64_t>(out, e.time);
+    CatalogPut<uint64_t>(out, e.hash);
+    CatalogPut<uint64_t>(out, e.bytes);
+    CatalogPut<int32_t>(out, e.left);
+    CatalogPut<int32_t>(out, e.top);
+    CatalogPut<int32_t>(out, e.right);
+    CatalogPut<int32_t>(out, e.bottom);
+    CatalogPut<int16_t>(out, e.utcOffsetMin);
+    out.push_back(e.mode);
+    out.push_back(e.fmt);
+    out.push_back(e.flags);
+    out.insert(out.end(), 3, (uint8_t)0);
+    CatalogPut<uint16_t>(out, (uint16_t)pathLen);
+    CatalogPut<uint16_t>(out, (uint16_t)titleLen);
+    CatalogPut<uint16_t>(out, (uint16_t)procLen);
+    CatalogPut<uint16_t>(out, 0);
+    CatalogPutString(out, e.path, pathLen);
+    CatalogPutString(out, e.title, titleLen);
+    CatalogPutString(out, e.process, procLen);
+    CatalogPut<uint32_t>(out, Crc32Update(0, out.data() + at, out.size() - at));
+    out.resize(at + size, 0);
+}
+
+static std::wstring CatalogGetString(const uint8_t* p, size_t n) {
+    std::wstring s(n, L'\0');
+    for (size_t i = 0; i < n; ++i) s[i] = (wchar_t)CatalogGet<uint16_t>(p + 2 * i);
+    return s;
+}
+
+// Bestand (of mapping) -> levende entries, oud -> nieuw. Geeft het aantal bytes tot en
+// met het laatste geldige record terug (0 = geen geldige header). outRecords: alle
+// gelezen records, inclusief tombstones en vervangen entries (voor compactie).
+static size_t CatalogParse(const uint8_t* p, size_t n, std::vector<CatalogEntry>& out, size_t* outRecords) {
+    out.clear();
+    if (outRecords) *outRecords = 0;
+    if (n < kCatalogHeaderBytes || std::memcmp(p, kCatalogMagic, 8) != 0 || CatalogGet<uint32_t>(p + 8) != kCatalogVersion) return 0;
+
+    // eerst alleen valideren en per pad (de ruwe UTF-16 bytes) het laatste record
+    // onthouden; strings worden daarna alleen voor de levende records gemaakt
+    std::unordered_map<std::string_view, size_t> byPath;
+    byPath.reserve(n / 128);
+    std::vector<size_t> offsets;
+    std::vector<uint8_t> live;
+    size_t pos = kCatalogHeaderBytes;
+    while (n - pos >= kCatalogRecordFixed) {
+        const uint8_t* r = p + pos;
+        const uint32_t size = CatalogGet<uint32_t>(r + 4);
+        if (CatalogGet<uint32_t>(r) != kCatalogRecordTag || size < kCatalogRecordFixed + 4 || (size & 7) || size > n - pos) break;
+        const size_t pathLen = CatalogGet<uint16_t>(r + 56), titleLen = CatalogGet<uint16_t>(r + 58), procLen = CatalogGet<uint16_t>(r + 60);
+        const size_t body = kCatalogRecordFixed + 2 * (pathLen + titleLen + procLen);
+        if (body + 4 > size || Crc32Update(0, r, body) != CatalogGet<uint32_t>(r + body)) break;
+
+        const std::string_view key((const char*)r + kCatalogRecordFixed, 2 * pathLen);
+        auto [it, fresh] = byPath.try_emplace(key, offsets.size());
+        if (!fresh) {
+            live[it->second] = 0;
+            it->second = offsets.size();
+        }
+        offsets.push_back(pos);
+        live.push_back((r[52] & kCatalogRemoved) ? 0 : 1);
+        pos += size;
+    }
+
+    size_t liveCount = 0;
+    for (uint8_t l : live) liveCount += l;
+    out.reserve(liveCount);
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (!live[i]) continue;
+        const uint8_t* r = p + offsets[i];
+        const size_t pathLen = CatalogGet<uint16_t>(r + 56), titleLen = CatalogGet<uint16_t>(r + 58), procLen = CatalogGet<uint16_t>(r + 60);
+        CatalogEntry& e = out.emplace_back();
+        e.time = CatalogGet<uint64_t>(r + 8);
+        e.hash = CatalogGet<uint64_t>(r + 16);
+        e.bytes = CatalogGet<uint64_t>(r + 24);
+        e.left = CatalogGet<int32_t>(r + 32);
+        e.top = CatalogGet<int32_t>(r + 36);
+        e.right = CatalogGet<int32_t>(r + 40);
+        e.bottom = CatalogGet<int32_t>(r + 44);
+        e.utcOffsetMin = CatalogGet<int16_t>(r + 48);
+        e.mode = r[50];
+        e.fmt = r[51];
+        e.flags = r[52];
+        e.path = CatalogGetString(r + kCatalogRecordFixed, pathLen);
+        e.title = CatalogGetString(r + kCatalogRecordFixed + 2 * pathLen, titleLen);
+        e.process = CatalogGetString(r + kCatalogRecordFixed + 2 * (pathLen + titleLen), procLen);
+    }
+    if (outRecords) *outRecords = offsets.size();
+    return pos;
+}
+
+// Alleen de levende entries, als nieuw bestand.
+static std::vector<uint8_t> CatalogBuildFile(const std::vector<CatalogEntry>& entries) {
+    std::vector<uint8_t> out;
+    out.reserve(kCatalogHeaderBytes + entries.size() * 160);
+    CatalogPutHeader(out);
+    for (const CatalogEntry& e : entries) CatalogPutRecord(out, e);
+    return out;
+}
+
+// ---- zoekindex
+struct CatalogIndex {
+    std::vector<CatalogEntry> entries;   // oud -> nieuw
+    std::wstring text;                   // per entry één regel, kleine letters, afgesloten met '\n'
+    std::vector<uint32_t> start;         // begin van regel i in text; start[size] = text.size()
+    std::vector<uint64_t> words;         // per woord (c0 << 48) | (c1 << 32) | entry, gesorteerd
+};
+
+static inline wchar_t CatalogLower(wchar_t c) {
+    if (c >= L'A' && c <= L'Z') return (wchar_t)(c + 32);
+    if (c >= 0xC0 && c <= 0xDE && c != 0xD7) return (wchar_t)(c + 32);   // Latin-1 (À..Þ)
+    return c;
+}
+
+static inline bool CatalogWordChar(wchar_t c) {
+    return (c >= L'a' && c <= L'z') || (c >= L'0' && c <= L'9') || c >= 0xC0;
+}
+
+static const wchar_t* const kCatalogWeekdays[7] = { L"sun", L"mon", L"tue", L"wed", L"thu", L"fri", L"sat" };
+static const wchar_t* const kCatalogMonths[12] = { L"jan", L"feb", L"mar", L"apr", L"may", L"jun", L"jul", L"aug", L"sep", L"oct", L"nov", L"dec" };
+
+struct CatalogLocalTime { int year, month, day, hour, minute, weekday; };
+
+static CatalogLocalTime CatalogTimeOf(const CatalogEntry& e) {
+    const int64_t secs = (int64_t)(e.time / 10000000ull) + (int64_t)e.utcOffsetMin * 60 - 11644473600ll; // 1601 -> 1970
+    int64_t days = secs >= 0 ? secs / 86400 : (secs - 86399) / 86400;
+    const int64_t sod = secs - days * 86400;
+    CatalogLocalTime t{};
+    t.hour = (int)(sod / 3600);
+    t.minute = (int)(sod / 60 % 60);
+    t.weekday = (int)(((days % 7) + 11) % 7);   // 1970-01-01 was een donderdag
+    // dagen -> datum (proleptisch Gregoriaans)
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const int64_t doe = days - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    t.day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    t.month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    t.year = (int)(yoe + era * 400 + (t.month <= 2));
+    return t;
+}
+
+static void CatalogAppendLower(std::wstring& out, const std::wstring& s) {
+    for (wchar_t c : s) {
+        c = CatalogLower(c);
+        out += c == L'\n' ? L' ' : c;
+    }
+}
+
+static void CatalogAppendNumber(std::wstring& out, int v, int digits) {
+    wchar_t buf[8]{};
+    for (int i = digits - 1; i >= 0; --i, v /= 10) buf[i] = (wchar_t)(L'0' + v % 10);
+    out.append(buf, (size_t)digits);
+}
+
+// Zonder swprintf: bij het laden gaat dit 100k keer.
+static void CatalogAppendLine(CatalogIndex& idx, const CatalogEntry& e) {
+    std::wstring& out = idx.text;
+    const size_t slash = e.path.find_last_of(L"\\/");
+    const CatalogLocalTime t = CatalogTimeOf(e);
+
+    CatalogAppendLower(out, e.title);
+    out += L'\x1';
+    CatalogAppendLower(out, e.process);
+    out += L'\x1';
+    CatalogAppendLower(out, slash == std::wstring::npos ? e.path : e.path.substr(slash + 1));
+    out += L'\x1';
+    CatalogAppendLower(out, ModeFileName((Mode)e.mode));
+    out += L' ';
+    CatalogAppendLower(out, SaveFormatText((SaveFormat)e.fmt));
+    out += L' ';
+    CatalogAppendNumber(out, t.year, 4);
+    out += L'-';
+    CatalogAppendNumber(out, t.month, 2);
+    out += L'-';
+    CatalogAppendNumber(out, t.day, 2);
+    out += L' ';
+    out += kCatalogWeekdays[t.weekday];
+    out += L' ';
+    out += kCatalogMonths[(t.month + 11) % 12];
+    out += L' ';
+    CatalogAppendNumber(out, t.hour, 2);
+    out += L':';
+    CatalogAppendNumber(out, t.minute, 2);
+    out += L'\n';
+    idx.start.back() = (uint32_t)out.size();
+}
+
+// Sleutel van een woord: de eerste twee tekens (c1 = 0 voor een woord van één teken).
+// Meer is niet nodig: alleen termen van 1-2 tekens zoeken via de woordenlijst.
+static inline uint64_t CatalogWordKey(wchar_t c0, wchar_t c1) {
+    return ((uint64_t)(uint16_t)c0 << 48) | ((uint64_t)(uint16_t)c1 << 32);
+}
+
+static void CatalogWordsOf(const CatalogIndex& idx, size_t i, std::vector<uint64_t>& out) {
+    const wchar_t* s = idx.text.c_str();
+    for (uint32_t p = idx.start[i]; p < idx.start[i + 1]; ++p) {
+        if (!CatalogWordChar(s[p]) || (p != idx.start[i] && CatalogWordChar(s[p - 1]))) continue;
+        out.push_back(CatalogWordKey(s[p], CatalogWordChar(s[p + 1]) ? s[p + 1] : 0) | i);
+    }
+}
+
+// De woorden komen per entry op volgorde binnen; stabiel sorteren op de sleutel (twee
+// radix-passes van 16 bits: c1, dan c0) geeft dan de volledige volgorde.
+static void CatalogSortWords(std::vector<uint64_t>& words) {
+    std::vector<uint64_t> tmp(words.size());
+    std::vector<uint32_t> count(65537);
+    for (int shift : { 32, 48 }) {
+        std::fill(count.begin(), count.end(), 0);
+        for (uint64_t k : words) count[((k >> shift) & 0xFFFF) + 1]++;
+        for (size_t i = 1; i < count.size(); ++i) count[i] += count[i - 1];
+        for (uint64_t k : words) tmp[count[(k >> shift) & 0xFFFF]++] = k;
+        words.swap(tmp);
+    }
+}
+
+static void CatalogIndexBuild(CatalogIndex& idx, std::vector<CatalogEntry> entries) {
+    idx.entries = std::move(entries);
+    idx.text.clear();
+    idx.text.reserve(idx.entries.size() * 96);
+    idx.start.assign(1, 0);
+    idx.start.reserve(idx.entries.size() + 1);
+    idx.words.clear();
+    for (const CatalogEntry& e : idx.entries) {
+        idx.start.push_back(0);
+        CatalogAppendLine(idx, e);
+    }
+    for (size_t i = 0; i < idx.entries.size(); ++i) CatalogWordsOf(idx, i, idx.words);
+    CatalogSortWords(idx.words);
+}
+
+// Nieuwe save: regel achteraan, woorden op hun plek invoegen.
+static void CatalogIndexAdd(CatalogIndex& idx, CatalogEntry e) {
+    idx.entries.push_back(std::move(e));
+    idx.start.push_back(0);
+    CatalogAppendLine(idx, idx.entries.back());
+    const size_t old = idx.words.size();
+    CatalogWordsOf(idx, idx.entries.size() - 1, idx.words);
+    std::sort(idx.words.begin() + (ptrdiff_t)old, idx.words.end());
+    std::inplace_merge(idx.words.begin(), idx.words.begin() + (ptrdiff_t)old, idx.words.end());
+}
+
+static inline size_t CatalogEntryAt(const CatalogIndex& idx, size_t textPos) {
+    return (size_t)(std::upper_bound(idx.start.begin(), idx.start.end(), (uint32_t)textPos) - idx.start.begin()) - 1;
+}
+
+// Eerste voorkomen van s in [from, to) van text; npos als niet gevonden. Zoekt eerst op
+// de eerste twee tekens (SSE2: 8 posities per stap) en vergelijkt dan de rest.
+static size_t CatalogFind(const wchar_t* text, size_t from, size_t to, const std::wstring& s) {
+    const size_t m = s.size();
+    if (m == 0 || to < from + m) return std::wstring::npos;
+    if (m == 1) {
+        const wchar_t* hit = std::wmemchr(text + from, s[0], to - from);
+        return hit ? (size_t)(hit - text) : std::wstring::npos;
+    }
+    const size_t last = to - m;   // laatste mogelijke beginpositie
+    size_t i = from;
+#if SNIP_HAS_SSE2
+    // wchar_t is 2 bytes op Windows (4 elders): lanes en maskerbits volgen daaruit
+    constexpr size_t kLanes = 16 / sizeof(wchar_t);
+    constexpr unsigned kLaneBits = (1u << sizeof(wchar_t)) - 1;
+    auto splat = [](wchar_t c) { return sizeof(wchar_t) == 2 ? _mm_set1_epi16((short)c) : _mm_set1_epi32((int)c); };
+    auto eq = [](__m128i x, __m128i y) { return sizeof(wchar_t) == 2 ? _mm_cmpeq_epi16(x, y) : _mm_cmpeq_epi32(x, y); };
+    const __m128i v0 = splat(s[0]);
+    const __m128i v1 = splat(s[1]);
+    for (; i + kLanes <= last + 1; i += kLanes) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(text + i));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(text + i + 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(eq(a, v0), eq(b, v1)));
+        while (mask) {
+            unsigned long bit = 0;
+#if defined(_MSC_VER)
+            _BitScanForward(&bit, mask);
+#else
+            bit = (unsigned long)__builtin_ctz(mask);
+#endif
+            const size_t at = i + bit / sizeof(wchar_t);
+            if (std::wmemcmp(text + at + 2, s.data() + 2, m - 2) == 0) return at;
+            mask &= ~(kLaneBits << bit);
+        }
+    }
+#endif
+    for (; i <= last; ++i) {
+        if (text[i] == s[0] && text[i + 1] == s[1] && std::wmemcmp(text + i + 2, s.data() + 2, m - 2) == 0) return i;
+    }
+    return std::wstring::npos;
+}
+
+static constexpr size_t kCatalogPrefixMaxLen = 2;   // termen tot zo lang: woord-prefix (zie CatalogWordKey)
+
+// query -> entry-indices (nieuwste eerst, max maxResults). outTotal: alle matches.
+static std::vector<size_t> CatalogQuery(const CatalogIndex& idx, const std::wstring& query, size_t maxResults, size_t* outTotal) {
+    const size_t n = idx.entries.size();
+    std::vector<std::wstring> terms;
+    std::wstring cur;
+    for (wchar_t c : query + L" ") {
+        if (c == L' ' || c == L'\t') { if (!cur.empty()) terms.push_back(std::move(cur)); cur.clear(); }
+        else cur += CatalogLower(c);
+    }
+    // langste (meest selectieve) substring-term eerst; prefix-termen zijn goedkoop
+    std::sort(terms.begin(), terms.end(), [](const std::wstring& a, const std::wstring& b) { return a.size() > b.size(); });
+
+    std::vector<uint8_t> cand(n, 1), hit;
+    size_t candCount = n;
+    const wchar_t* text = idx.text.c_str();
+    for (const std::wstring& t : terms) {
+        hit.assign(n, 0);
+        if (t.size() <= kCatalogPrefixMaxLen && std::all_of(t.begin(), t.end(), CatalogWordChar)) {
+            // "b": alle sleutels met c0 = 'b'; "q3": precies (q, 3)
+            const uint64_t lo = CatalogWordKey(t[0], t.size() > 1 ? t[1] : 0);
+            const uint64_t hi = t.size() > 1 ? lo + (1ull << 32) : lo + (1ull << 48);
+            for (auto it = std::lower_bound(idx.words.begin(), idx.words.end(), lo); it != idx.words.end() && *it < hi; ++it)
+                hit[(uint32_t)*it] = 1;
+        }
+        else {
+            if (candCount * 8 >= n) {
+                // hele tekst in één keer; na een match door naar de volgende regel
+                for (size_t pos = 0; ; ) {
+                    pos = CatalogFind(text, pos, idx.text.size(), t);
+                    if (pos == std::wstring::npos) break;
+                    const size_t e = CatalogEntryAt(idx, pos);
+                    hit[e] = 1;
+                    pos = idx.start[e + 1];
+                }
+            }
+            else {
+                for (size_t e = 0; e < n; ++e) {
+                    if (cand[e] && CatalogFind(text, idx.start[e], idx.start[e + 1], t) != std::wstring::npos) hit[e] = 1;
+                }
+            }
+        }
+        candCount = 0;
+        for (size_t e = 0; e < n; ++e) { cand[e] &= hit[e]; candCount += cand[e]; }
+        if (!candCount) break;
+    }
+
+    std::vector<size_t> out;
+    for (size_t e = n; e-- > 0 && out.size() < maxResults; ) if (cand[e]) out.push_back(e);
+    if (outTotal) *outTotal = candCount;
+    return out;
+}
+
+// =========================================================
+// Gelijkende captures: pHash + Hamming-index (portable, geen Win32)
+// =========================================================
+// pHash (64 bit): helderheid naar 32x32 (gemiddelde per vak), 2D-DCT, de 8x8 laagste
+// frequenties; bit = coëfficiënt boven de mediaan. Bijna-duplicaten (andere cursor,
+// klokje, een paar pixels verschoven, andere schaal of JPEG) liggen op een kleine
+// Hamming-afstand; de index daarvoor staat hieronder (HammingIndex).
+//
+// Opslag (similar.bin, alleen toevoegen, little-endian):
+//   header: "SNIPSIM1"
+//   record: u64 phash, u64 stamp (laatste wijziging van het bestand, filesystem-ticks),
+//           u16 pathLen, u8 flags, u8 0, UTF-16 pad, u32 CRC-32 (over alles ervoor)
+// flags: 1 = verwijderd. Het laatste record per pad telt; een half record achteraan
+// (crash) wordt genegeerd en bij de volgende append overschreven.
+static constexpr char kSimilarMagic[8] = { 'S','N','I','P','S','I','M','1' };
+static constexpr size_t kSimilarRecordFixed = 20;
+static constexpr uint8_t kSimilarRemoved = 1;
+static constexpr int kSimilarRadius = 10;           // bits (van 64) die nog "gelijkend" zijn
+static constexpr size_t kSimilarMaxResults = 200;
+
+// SWAR-popcount: geen POPCNT-instructie nodig (baseline blijft SSE2).
+static inline int HammingDistance(uint64_t a, uint64_t b) {
+    uint64_t v = a ^ b;
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return (int)((v * 0x0101010101010101ull) >> 56);
+}
+
+// px: top-down BGRA of RGBA view (helderheid is symmetrisch in R en B).
+static uint64_t PerceptualHash(const uint8_t* px, ptrdiff_t stride, int w, int h) {
+    constexpr int N = 32, K = 8;
+    if (!px || w <= 0 || h <= 0) return 0;
+
+    // vakgrenzen; bij minder dan 32 pixels delen vakken een pixel
+    int x0[N], x1[N];
+    for (int b = 0; b < N; ++b) {
+        x0[b] = (int)((int64_t)b * w / N);
+        x1[b] = std::max(x0[b] + 1, (int)((int64_t)(b + 1) * w / N));
+    }
+    float f[N][N];
+    for (int by = 0; by < N; ++by) {
+        const int y0 = (int)((int64_t)by * h / N), y1 = std::max(y0 + 1, (int)((int64_t)(by + 1) * h / N));
+        uint32_t sum[N] = {};
+        for (int y = y0; y < y1; ++y) {
+            const uint8_t* row = px + (ptrdiff_t)y * stride;
+            for (int bx = 0; bx < N; ++bx) {
+                uint32_t s = 0;
+                for (int x = x0[bx]; x < x1[bx]; ++x) s += row[x * 4] + 2u * row[x * 4 + 1] + row[x * 4 + 2];
+                sum[bx] += s;
+            }
+        }
+        for (int bx = 0; bx < N; ++bx) f[by][bx] = (float)sum[bx] / (4.0f * (float)((x1[bx] - x0[bx]) * (y1 - y0)));
+    }
+
+    static const std::vector<float> cosTab = [] {
+        std::vector<float> c((size_t)K * N);
+        for (int u = 0; u < K; ++u)
+            for (int x = 0; x < N; ++x) c[(size_t)u * N + x] = (float)std::cos((2 * x + 1) * u * 3.14159265358979323846 / (2 * N));
+        return c;
+    }();
+    // alleen de K x K laagste frequenties: eerst rijen, dan kolommen
+    float rows[N][K];
+    for (int y = 0; y < N; ++y)
+        for (int u = 0; u < K; ++u) {
+            float s = 0.0f;
+            for (int x = 0; x < N; ++x) s += f[y][x] * cosTab[(size_t)u * N + x];
+            rows[y][u] = s;
+        }
+    float coef[K * K];
+    for (int v = 0; v < K; ++v)
+        for (int u = 0; u < K; ++u) {
+            float s = 0.0f;
+            for (int y = 0; y < N; ++y) s += rows[y][u] * cosTab[(size_t)v * N + y];
+            coef[v * K + u] = s;
+        }
+
+    // mediaan zonder de DC-term (die zegt alleen iets over de gemiddelde helderheid)
+    float ac[K * K - 1];
+    std::copy(coef + 1, coef + K * K, ac);
+    std::nth_element(ac, ac + (K * K - 1) / 2, ac + K * K - 1);
+    const float median = ac[(K * K - 1) / 2];
+    uint64_t hash = 0;
+    for (int i = 1; i < K * K; ++i) {
+        if (coef[i] > median) hash |= 1ull << i;
+    }
+    return hash;
+}
+
+// Multi-index hashing: de 64 bits in 4 stukken van 16. Liggen twee hashes binnen r, dan
+// verschilt minstens één stuk hooguit r / 4 bits (duivenhok), dus per tabel alleen de
+// buckets binnen die kleine straal bekijken en de kandidaten exact narekenen.
+// Tabellen zijn CSR (start + items, counting sort); nieuwe items gaan eerst in een
+// lineair doorzochte staart en worden per kHammingPending in de tabellen gezet.
+static constexpr int kHammingTables = 4;
+static constexpr uint32_t kHammingPending = 4096;
+
+struct HammingIndex {
+    std::vector<uint64_t> hashes;                      // item = index
+    std::vector<uint32_t> start[kHammingTables];       // 65537 per tabel
+    std::vector<uint32_t> items[kHammingTables];
+    uint32_t built = 0;                                // [0, built) in de tabellen
+};
+
+static inline uint32_t HammingChunk(uint64_t h, int t) {
+    return (uint32_t)(h >> (16 * t)) & 0xFFFF;
+}
+
+static void HammingIndexBuild(HammingIndex& idx) {
+    const uint32_t n = (uint32_t)idx.hashes.size();
+    for (int t = 0; t < kHammingTables; ++t) {
+        std::vector<uint32_t>& start = idx.start[t];
+        start.assign(65537, 0);
+        for (uint32_t i = 0; i < n; ++i) ++start[HammingChunk(idx.hashes[i], t) + 1];
+        for (size_t k = 1; k < start.size(); ++k) start[k] += start[k - 1];
+        std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+        idx.items[t].resize(n);
+        for (uint32_t i = 0; i < n; ++i) idx.items[t][fill[HammingChunk(idx.hashes[i], t)]++] = i;
+    }
+    idx.built = n;
+}
+
+static uint32_t HammingIndexAdd(HammingIndex& idx, uint64_t hash) {
+    idx.hashes.push_back(hash);
+    if (idx.hashes.size() - idx.built >= kHammingPending) HammingIndexBuild(idx);
+    return (uint32_t)idx.hashes.size() - 1;
+}
+
+// Alle items binnen radius, (afstand, item) oplopend. visited: nagerekende kandidaten (meting).
+static void HammingIndexQuery(const HammingIndex& idx, uint64_t hash, int radius,
+    std::vector<std::pair<int, uint32_t>>& out, size_t* visited = nullptr) {
+    out.clear();
+    size_t checked = 0;
+    const int sub = std::min(16, std::max(0, radius) / kHammingTables);
+
+    // alle 16-bit maskers met hooguit sub bits (Gosper: volgende met evenveel bits)
+    std::vector<uint32_t> masks{ 0 };
+    for (int bits = 1; bits <= sub; ++bits) {
+        for (uint32_t m = (1u << bits) - 1; m < 65536;) {
+            masks.push_back(m);
+            const uint32_t low = m & (0u - m), up = m + low;
+            m = (((up ^ m) >> 2) / low) | up;
+        }
+    }
+
+    if (idx.built) {
+        for (int t = 0; t < kHammingTables; ++t) {
+            const uint32_t q = HammingChunk(hash, t);
+            for (uint32_t m : masks) {
+                const uint32_t key = q ^ m;
+                for (uint32_t k = idx.start[t][key]; k < idx.start[t][key + 1]; ++k) {
+                    const uint32_t item = idx.items[t][k];
+                    const uint64_t h = idx.hashes[item];
+                    // elk item maar één keer: alleen in de eerste tabel waar het binnen sub valt
+                    bool earlier = false;
+                    for (int e = 0; e < t && !earlier; ++e) earlier = HammingDistance(HammingChunk(h, e), HammingChunk(hash, e)) <= sub;
+                    if (earlier) continue;
+                    ++checked;
+                    const int d = HammingDistance(h, hash);
+                    if (d <= radius) out.emplace_back(d, item);
+                }
+            }
+        }
+    }
+    for (uint32_t i = idx.built; i < (uint32_t)idx.hashes.size(); ++i, ++checked) {
+        const int d = HammingDistance(idx.hashes[i], hash);
+        if (d <= radius) out.emplace_back(d, i);
+    }
+    if (visited) *visited = checked;
+    std::sort(out.begin(), out.end());
+}
+
+struct SimilarEntry {
+    uint64_t phash = 0;
+    uint64_t stamp = 0;
+    uint8_t flags = 0;
+    std::wstring path;
+};
+
+static void SimilarPutHeader(std::vector<uint8_t>& out) {
+    out.insert(out.end(), kSimilarMagic, kSimilarMagic + 8);
+}
+
+static void SimilarPutRecord(std::vector<uint8_t>& out, const SimilarEntry& e) {
+    const size_t at = out.size();
+    const size_t pathLen = std::min<size_t>(e.path.size(), 0x7FFF);
+    CatalogPut<uint64_t>(out, e.phash);
+    CatalogPut<uint64_t>(out, e.stamp);
+    CatalogPut<uint16_t>(out, (uint16_t)pathLen);
+    out.push_back(e.flags);
+    out.push_back(0);
+    CatalogPutString(out, e.path, pathLen);
+    CatalogPut<uint32_t>(out, Crc32Update(0, out.data() + at, out.size() - at));
+}
+
+// Levende entries (laatste record per pad, zonder verwijderde), oud -> nieuw.
+// Geeft het aantal bytes tot en met het laatste geldige record terug (0 = geen header).
+static size_t SimilarParse(const uint8_t* p, size_t n, std::vector<SimilarEntry>& out, size_t* outRecords) {
+    out.clear();
+    if (outRecords) *outRecords = 0;
+    if (n < 8 || std::memcmp(p, kSimilarMagic, 8) != 0) return 0;
+
+    std::vector<SimilarEntry> all;
+    std::unordered_map<std::wstring, size_t> byPath;
+    size_t pos = 8;
+    while (n - pos >= kSimilarRecordFixed + 4) {
+        const uint8_t* r = p + pos;
+        const size_t pathLen = CatalogGet<uint16_t>(r + 16);
+        const size_t body = kSimilarRecordFixed + 2 * pathLen;
+        if (body + 4 > n - pos || Crc32Update(0, r, body) != CatalogGet<uint32_t>(r + body)) break;
+        SimilarEntry e;
+        e.phash = CatalogGet<uint64_t>(r);
+        e.stamp = CatalogGet<uint64_t>(r + 8);
+        e.flags = r[18];
+        e.path = CatalogGetString(r + kSimilarRecordFixed, pathLen);
+        auto [it, fresh] = byPath.try_emplace(e.path, all.size());
+        if (!fresh) {
+            all[it->second].flags |= kSimilarRemoved;   // vervangen
+            it->second = all.size();
+        }
+        all.push_back(std::move(e));
+        pos += body + 4;
+    }
+    if (outRecords) *outRecords = all.size();
+    for (SimilarEntry& e : all) {
+        if (!(e.flags & kSimilarRemoved)) out.push_back(std::move(e));
+    }
+    return pos;
+}
+
+// Bulk-indexer: alle afbeeldingen in een map (recursief) die nog niet (of in een oudere
+// versie) in de index staan. known(path, stamp) -> true = al geïndexeerd.
+template <class Known>
+static void SimilarListFolder(const std::filesystem::path& dir, Known&& known, std::vector<SimilarEntry>& out) {
+    namespace fs = std::filesystem;
+    out.clear();
+    std::error_code ec;
+    for (fs::recursive_directory_iterator itr(dir, fs::directory_options::skip_permission_denied, ec), end;
+        !ec && itr != end; itr.increment(ec)) {
+        if (!itr->is_regular_file(ec)) continue;
+        std::wstring ext = itr->path().extension().wstring();
+        for (auto& c : ext) c = CatalogLower(c);
+        if (ext != L".png" && ext != L".bmp" && ext != L".jpg" && ext != L".jpeg") continue;
+        SimilarEntry e;
+        e.path = itr->path().wstring();
+        e.stamp = (uint64_t)itr->last_write_time(ec).time_since_epoch().count();
+        if (ec || known(e.path, e.stamp)) { ec.clear(); continue; }
+        out.push_back(std::move(e));
+    }
+}
+
+// items parallel hashen (dezelfde work-stealing pool als --optimize).
+// decode(path, pixels, w, h) -> false = overslaan (flags krijgt dan kSimilarRemoved);
+// een exceptie (bv. bad_alloc) telt als overslaan, de pool mag niet gooien.
+template <class Decode>
+static uint64_t SimilarHashFiles(std::vector<SimilarEntry>& items, int threads, Decode&& decode) {
+    if (threads <= 0) threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    threads = (int)std::min<size_t>((size_t)threads, std::max<size_t>(1, items.size()));
+    std::vector<size_t> order(items.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    return RunWorkStealing(order, threads, [&](size_t i, int) {
+        SimilarEntry& e = items[i];
+        try {
+            std::vector<uint8_t> px;
+            int w = 0, h = 0;
+            if (decode(e.path, px, w, h) && w > 0 && h > 0 && px.size() >= (size_t)w * h * 4) {
+                e.phash = PerceptualHash(px.data(), (ptrdiff_t)w * 4, w, h);
+                return;
+            }
+        }
+        catch (...) {}
+        e.flags |= kSimilarRemoved;
+        });
+}
+
+#if !SNIP_CORE_ONLY
+// =========================================================
+// Capture-catalogus (bestand + zoekvenster)
+// =========================================================
+// Alleen op de UI-thread. catalog.bin (settings-map) wordt bij het eerste gebruik gemapt
+// en in één keer ingelezen; daarna gaat elke save als één record achteraan het bestand
+// en in het index. Een bestand dat bij openen weg blijkt te zijn krijgt een tombstone.
+// Schrijven (afkappen op validBytes, compact) alleen als het bestand echt gelezen is:
+// een bestand dat we niet konden openen of mappen is niet 'leeg'.
+struct CatalogState {
+    CatalogIndex idx;
+    bool loaded = false;
+    bool parsed = false;       // bestand gelezen (of bestaat nog niet): validBytes klopt
+    uint64_t validBytes = 0;   // bestand is heel tot hier (daarna: afgebroken record)
+    size_t records = 0;        // records in het bestand, inclusief tombstones
+};
+static CatalogState g_catalog;
+static constexpr size_t kCatalogMaxResults = 500;
+
+static std::wstring CatalogFile() {
+    return SettingsDir() + L"\\catalog.bin";
+}
+
+static void CatalogCompact() {
+    if (!g_catalog.parsed) return;
+    const std::vector<uint8_t> all = CatalogBuildFile(g_catalog.idx.entries);
+    const std::wstring file = CatalogFile();
+    const std::wstring tmp = file + L".tmp";
+    if (!WriteWholeFile(tmp, all.data(), all.size())) return;
+    if (!MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileW(tmp.c_str());
+        return;
+    }
+    g_catalog.validBytes = all.size();
+    g_catalog.records = g_catalog.idx.entries.size();
+}
+
+static void CatalogLoad() {
+    if (g_catalog.loaded) return;
+    g_catalog.loaded = true;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    std::vector<CatalogEntry> entries;
+    uint64_t fileBytes = 0;
+    g_catalog.parsed = false;
+    g_catalog.validBytes = 0;
+    g_catalog.records = 0;
+    HANDLE hf = CreateFileW(CatalogFile().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hf == INVALID_HANDLE_VALUE) {
+        const DWORD err = GetLastError();
+        g_catalog.parsed = err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND;
+    }
+    else {
+        LARGE_INTEGER size{};
+        if (GetFileSizeEx(hf, &size) && size.QuadPart == 0) g_catalog.parsed = true;
+        else if (size.QuadPart > 0 && size.QuadPart < (LONGLONG)1 << 31) {
+            fileBytes = (uint64_t)size.QuadPart;
+            if (HANDLE map = CreateFileMappingW(hf, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+                if (const uint8_t* view = (const uint8_t*)MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0)) {
+                    g_catalog.validBytes = CatalogParse(view, (size_t)fileBytes, entries, &g_catalog.records);
+                    g_catalog.parsed = true;
+                    UnmapViewOfFile(view);
+                }
+                CloseHandle(map);
+            }
+        }
+        CloseHandle(hf);
+    }
+    if (!g_catalog.parsed) DebugLog(L"catalog: catalog.bin not readable, no writes until it is");
+    CatalogIndexBuild(g_catalog.idx, std::move(entries));
+    DebugLog(L"catalog: %zu entries (%zu records, %.1f MB) loaded + indexed in %.1f ms", g_catalog.idx.entries.size(),
+        g_catalog.records, fileBytes / 1048576.0, MsSince(t0));
+
+    // kapotte staart of veel vervallen records: één keer netjes herschrijven
+    if (g_catalog.parsed && fileBytes && (g_catalog.validBytes != fileBytes || g_catalog.records > 2 * g_catalog.idx.entries.size() + 64)) CatalogCompact();
+}
+
+// Eén record achteraan (na een eventueel afgebroken record: eerst afkappen).
+static bool CatalogAppend(const CatalogEntry& e) {
+    CatalogLoad();
+    if (!g_catalog.parsed) {   // vorige keer niet leesbaar (bv. gelockt): opnieuw proberen
+        g_catalog.loaded = false;
+        CatalogLoad();
+        if (!g_catalog.parsed) return false;
+    }
+    std::vector<uint8_t> rec;
+    if (g_catalog.validBytes == 0) CatalogPutHeader(rec);
+    CatalogPutRecord(rec, e);
+
+    EnsureDirectoryRecursive(SettingsDir() + L"\\");
+    HANDLE hf = CreateFileW(CatalogFile().c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hf == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER at{};
+    at.QuadPart = (LONGLONG)g_catalog.validBytes;
+    DWORD written = 0;
+    const bool ok = SetFilePointerEx(hf, at, nullptr, FILE_BEGIN) && SetEndOfFile(hf) &&
+        WriteFile(hf, rec.data(), (DWORD)rec.size(), &written, nullptr) && written == rec.size();
+    CloseHandle(hf);
+    if (ok) {
+        g_catalog.validBytes += rec.size();
+        g_catalog.records++;
+    }
+    return ok;
+}
+
+static void CatalogRefreshList(HWND hwnd);
+
+static int16_t LocalUtcOffsetMinutes() {
+    FILETIME utc{}, local{};
+    GetSystemTimeAsFileTime(&utc);
+    if (!FileTimeToLocalFileTime(&utc, &local)) return 0;
+    return (int16_t)(((int64_t)FileTimeTicks(local) - (int64_t)FileTimeTicks(utc)) / (int64_t)(60 * kTicksPerSecond));
+}
+
+// Na een geslaagde save (UI-thread).
+static void CatalogRecordSave(const CaptureSession& ses, const std::wstring& path, SaveFormat fmt) {
+    CatalogEntry e{};
+    e.time = NowTicks();
+    e.utcOffsetMin = LocalUtcOffsetMinutes();
+    e.hash = ses.hash;
+    e.flags = ses.hashValid ? kCatalogHashValid : 0;
+    uint64_t bytes = 0;
+    if (QueryFileSize(path, bytes)) e.bytes = bytes;
+    e.left = ses.srcRect.left;
+    e.top = ses.srcRect.top;
+    e.right = ses.srcRect.right;
+    e.bottom = ses.srcRect.bottom;
+    e.mode = (uint8_t)ses.mode;
+    e.fmt = (uint8_t)fmt;
+    e.path = path;
+    e.title = ses.srcTitle;
+    e.process = ses.srcProcess;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    if (!CatalogAppend(e)) return;
+    CatalogIndexAdd(g_catalog.idx, std::move(e));
+    DebugLog(L"catalog append: %.2f ms (%zu entries)", MsSince(t0), g_catalog.idx.entries.size());
+    if (g_hwndCatalog) CatalogRefreshList(g_hwndCatalog);
+}
+
+// Bestand bestaat niet meer: tombstone + uit het index.
+static void CatalogForget(size_t entry) {
+    if (entry >= g_catalog.idx.entries.size()) return;
+    CatalogEntry t{};
+    t.time = NowTicks();
+    t.flags = kCatalogRemoved;
+    t.path = g_catalog.idx.entries[entry].path;
+    if (!CatalogAppend(t)) return;
+    std::vector<CatalogEntry> rest = std::move(g_catalog.idx.entries);
+    rest.erase(rest.begin() + (ptrdiff_t)entry);
+    CatalogIndexBuild(g_catalog.idx, std::move(rest));
+}
+
+// ---- zoekvenster
+static constexpr int kCatalogEditId = 101;
+static constexpr int kCatalogStatusId = 102;
+static constexpr int kCatalogListId = 103;
+static constexpr UINT kCatalogCmdOpen = 1;
+static constexpr UINT kCatalogCmdShow = 2;
+
+// "Find similar" uit de preview: de lijst toont dan de treffers (afstand + pad) in
+// plaats van de zoekresultaten; typen in het zoekveld gaat terug naar gewoon zoeken.
+struct CatalogSimilarView {
+    bool active = false;
+    std::vector<std::pair<int, std::wstring>> hits;   // (afstand in bits, pad), dichtst eerst
+    size_t indexed = 0;                               // doorzochte hashes
+    double ms = 0;
+};
+static CatalogSimilarView g_catalogSimilar;
+
+static void SimilarForget(const std::wstring& path);
+
+static std::wstring CatalogListText(const CatalogEntry& e) {
+    const CatalogLocalTime t = CatalogTimeOf(e);
+    wchar_t head[64]{};
+    swprintf_s(head, L"%04d-%02d-%02d %02d:%02d   %-9s ", t.year, t.month, t.day, t.hour, t.minute, ModeFileName((Mode)e.mode));
+    std::wstring s = head;
+    if (!e.process.empty()) s += e.process + L"   ";
+    if (!e.title.empty()) s += e.title + L"   ";
+    const size_t slash = e.path.find_last_of(L"\\/");
+    s += slash == std::wstring::npos ? e.path : e.path.substr(slash + 1);
+    return s;
+}
+
+static void CatalogRefreshSimilar(HWND hwnd) {
+    HWND list = GetDlgItem(hwnd, kCatalogListId);
+    SendMessageW(list, WM_SETREDRAW, FALSE, 0);
+    SendMessageW(list, LB_RESETCONTENT, 0, 0);
+    for (size_t k = 0; k < g_catalogSimilar.hits.size(); ++k) {
+        wchar_t head[32]{};
+        swprintf_s(head, L"%2d bits   ", g_catalogSimilar.hits[k].first);
+        const LRESULT i = SendMessageW(list, LB_ADDSTRING, 0, (LPARAM)(head + g_catalogSimilar.hits[k].second).c_str());
+        if (i >= 0) SendMessageW(list, LB_SETITEMDATA, (WPARAM)i, (LPARAM)k);
+    }
+    if (!g_catalogSimilar.hits.empty()) SendMessageW(list, LB_SETCURSEL, 0, 0);
+    SendMessageW(list, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(list, nullptr, TRUE);
+
+    wchar_t status[160]{};
+    swprintf_s(status, L"%zu similar captures (at most %d of 64 bits differ), %zu indexed  (%.2f ms)",
+        g_catalogSimilar.hits.size(), kSimilarRadius, g_catalogSimilar.indexed, g_catalogSimilar.ms);
+    SetDlgItemTextW(hwnd, kCatalogStatusId, status);
+}
+
+static void CatalogRefreshList(HWND hwnd) {
+    if (g_catalogSimilar.active) {
+        CatalogRefreshSimilar(hwnd);
+        return;
+    }
+    HWND edit = GetDlgItem(hwnd, kCatalogEditId);
+    HWND list = GetDlgItem(hwnd, kCatalogListId);
+    std::wstring q((size_t)GetWindowTextLengthW(edit), L'\0');
+    if (!q.empty()) GetWindowTextW(edit, q.data(), (int)q.size() + 1);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    size_t total = 0;
+    const std::vector<size_t> hits = CatalogQuery(g_catalog.idx, q, kCatalogMaxResults, &total);
+    const double ms = MsSince(t0);
+
+    SendMessageW(list, WM_SETREDRAW, FALSE, 0);
+    SendMessageW(list, LB_RESETCONTENT, 0, 0);
+    for (size_t e : hits) {
+        const LRESULT i = SendMessageW(list, LB_ADDSTRING, 0, (LPARAM)CatalogListText(g_catalog.idx.entries[e]).c_str());
+        if (i >= 0) SendMessageW(list, LB_SETITEMDATA, (WPARAM)i, (LPARAM)e);
+    }
+    if (!hits.empty()) SendMessageW(list, LB_SETCURSEL, 0, 0);
+    SendMessageW(list, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(list, nullptr, TRUE);
+
+    wchar_t status[128]{};
+    swprintf_s(status, L"%zu of %zu captures%s  (%.2f ms)", total, g_catalog.idx.entries.size(),
+        total > hits.size() ? L", newest shown" : L"", ms);
+    SetDlgItemTextW(hwnd, kCatalogStatusId, status);
+    DebugLog(L"catalog query (%zu chars): %zu/%zu in %.3f ms", q.size(), total, g_catalog.idx.entries.size(), ms);
+}
+
+static void CatalogOpenSelected(HWND hwnd, UINT cmd) {
+    HWND list = GetDlgItem(hwnd, kCatalogListId);
+    const LRESULT sel = SendMessageW(list, LB_GETCURSEL, 0, 0);
+    if (sel < 0) return;
+    const size_t e = (size_t)SendMessageW(list, LB_GETITEMDATA, (WPARAM)sel, 0);
+    auto& hits = g_catalogSimilar.hits;
+    if (g_catalogSimilar.active ? e >= hits.size() : e >= g_catalog.idx.entries.size()) return;
+
+    const std::wstring path = g_catalogSimilar.active ? hits[e].second : g_catalog.idx.entries[e].path;
+    if (GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES) {
+        if (g_catalogSimilar.active) {
+            SimilarForget(path);
+            hits.erase(hits.begin() + (ptrdiff_t)e);
+        }
+        else {
+            CatalogForget(e);
+        }
+        CatalogRefreshList(hwnd);
+        SetDlgItemTextW(hwnd, kCatalogStatusId, L"File no longer exists (removed from the catalog)");
+        return;
+    }
+    if (cmd == kCatalogCmdShow) {
+        const std::wstring params = L"/select,\"" + path + L"\"";
+        ShellExecuteW(nullptr, L"open", L"explorer.exe", params.c_str(), nullptr, SW_SHOWNORMAL);
+    }
+    else {
+        OpenPath(path);
+    }
+}
+
+static LRESULT CALLBACK CatalogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_CREATE: {
+        const HFONT font = (HFONT)GetStockObject(DEFAULT_GUI_FONT);
+        const HWND edit = CreateWindowExW(WS_EX_CLIENTEDGE, L"EDIT", L"", WS_CHILD | WS_VISIBLE | WS_TABSTOP | ES_AUTOHSCROLL,
+            0, 0, 0, 0, hwnd, (HMENU)(INT_PTR)kCatalogEditId, g_hInst, nullptr);
+        const HWND status = CreateWindowExW(0, L"STATIC", L"", WS_CHILD | WS_VISIBLE,
+            0, 0, 0, 0, hwnd, (HMENU)(INT_PTR)kCatalogStatusId, g_hInst, nullptr);
+        const HWND list = CreateWindowExW(WS_EX_CLIENTEDGE, L"LISTBOX", L"",
+            WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_VSCROLL | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT,
+            0, 0, 0, 0, hwnd, (HMENU)(INT_PTR)kCatalogListId, g_hInst, nullptr);
+        for (HWND c : { edit, status, list }) SendMessageW(c, WM_SETFONT, (WPARAM)font, FALSE);
+        return 0;
+    }
+
+    case WM_SIZE: {
+        const int w = LOWORD(lParam), h = HIWORD(lParam);
+        const int m = 8, editH = 24, statusH = 18;
+        MoveWindow(GetDlgItem(hwnd, kCatalogEditId), m, m, w - 2 * m, editH, TRUE);
+        MoveWindow(GetDlgItem(hwnd, kCatalogStatusId), m, m + editH + 4, w - 2 * m, statusH, TRUE);
+        const int listY = m + editH + 4 + statusH + 4;
+        MoveWindow(GetDlgItem(hwnd, kCatalogListId), m, listY, w - 2 * m, std::max(0, h - listY - m), TRUE);
+        return 0;
+    }
+
+    case WM_SETFOCUS:
+        SetFocus(GetDlgItem(hwnd, kCatalogEditId));
+        return 0;
+
+    case WM_COMMAND: {
+        const int id = LOWORD(wParam), code = HIWORD(wParam);
+        if (id == kCatalogEditId && code == EN_CHANGE) {
+            g_catalogSimilar.active = false;   // typen: terug naar gewoon zoeken
+            CatalogRefreshList(hwnd);
+            return 0;
+        }
+        if (id == kCatalogListId && code == LBN_DBLCLK) { CatalogOpenSelected(hwnd, kCatalogCmdOpen); return 0; }
+        if (id == IDOK) { CatalogOpenSelected(hwnd, kCatalogCmdOpen); return 0; }        // Enter (IsDialogMessage)
+        if (id == IDCANCEL) { DestroyWindow(hwnd); return 0; }                           // Esc
+        return 0;
+    }
+
+    case WM_CONTEXTMENU: {
+        HWND list = GetDlgItem(hwnd, kCatalogListId);
+        if ((HWND)wParam != list) break;
+        POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        POINT client = pt;
+        ScreenToClient(list, &client);
+        const LRESULT hit = SendMessageW(list, LB_ITEMFROMPOINT, 0, MAKELPARAM(client.x, client.y));
+        if (HIWORD(hit) != 0) return 0;   // niet op een regel
+        SendMessageW(list, LB_SETCURSEL, LOWORD(hit), 0);
+
+        HMENU menu = CreatePopupMenu();
+        AppendMenuW(menu, MF_STRING, kCatalogCmdOpen, L"Open");
+        AppendMenuW(menu, MF_STRING, kCatalogCmdShow, L"Show in folder");
+        const UINT cmd = TrackPopupMenu(menu, TPM_RIGHTBUTTON | TPM_RETURNCMD, pt.x, pt.y, 0, hwnd, nullptr);
+        DestroyMenu(menu);
+        if (cmd) CatalogOpenSelected(hwnd, cmd);
+        return 0;
+    }
+
+    case WM_DESTROY:
+        g_hwndCatalog = nullptr;
+        return 0;
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+static void CatalogShowWindow() {
+    CatalogLoad();
+    if (g_hwndCatalog) {
+        ShowWindow(g_hwndCatalog, SW_SHOWNORMAL);
+        SetForegroundWindow(g_hwndCatalog);
+        return;
+    }
+
+    static bool registered = false;
+    if (!registered) {
+        WNDCLASSW wc{};
+        wc.lpfnWndProc = CatalogProc;
+        wc.hInstance = g_hInst;
+        wc.lpszClassName = L"SnipLiteCatalog";
+        wc.hCursor = LoadCursorW(nullptr, IDC_ARROW);
+        wc.hbrBackground = (HBRUSH)(COLOR_BTNFACE + 1);
+        wc.hIcon = AppIconBig();
+        RegisterClassW(&wc);
+        registered = true;
+    }
+
+    RECT wa{};
+    SystemParametersInfoW(SPI_GETWORKAREA, 0, &wa, 0);
+    const int w = std::min(900, (int)(wa.right - wa.left) - 40);
+    const int h = std::min(560, (int)(wa.bottom - wa.top) - 40);
+    g_hwndCatalog = CreateWindowExW(0, L"SnipLiteCatalog", L"snip-lite: find capture", WS_OVERLAPPEDWINDOW,
+        wa.left + (wa.right - wa.left - w) / 2, wa.top + (wa.bottom - wa.top - h) / 2, w, h,
+        nullptr, nullptr, g_hInst, nullptr);
+    if (!g_hwndCatalog) {
+        MessageBeep(MB_ICONERROR);
+        return;
+    }
+    ShowWindow(g_hwndCatalog, SW_SHOW);
+    SetForegroundWindow(g_hwndCatalog);
+    CatalogRefreshList(g_hwndCatalog);
+}
+
+// Zoekvenster openen met de treffers van "Find similar".
+static void CatalogShowSimilar(std::vector<std::pair<int, std::wstring>> hits, size_t indexed, double ms) {
+    CatalogShowWindow();
+    if (!g_hwndCatalog) return;
+    SetDlgItemTextW(g_hwndCatalog, kCatalogEditId, L"");   // EN_CHANGE zet de modus eerst uit
+    g_catalogSimilar.active = true;
+    g_catalogSimilar.hits = std::move(hits);
+    g_catalogSimilar.indexed = indexed;
+    g_catalogSimilar.ms = ms;
+    CatalogRefreshList(g_hwndCatalog);
+}
+
+// =========================================================
+// Visuele diff (Win32: vorige capture zoeken, heat-map in de preview)
+// =========================================================
+// "Diff with previous" (D) vergelijkt de capture met de vorige van hetzelfde doel:
+// eerst in het geheugen (open previews en de laatst gesloten captures), anders de
+// nieuwste opgeslagen PNG/BMP uit de catalogus. Annotaties tellen niet mee (base).
+static constexpr size_t kDiffKeepClosed = 4;     // gesloten captures die bewaard blijven
+static constexpr uint64_t kDiffKeepClosedBytes = 128ull << 20;   // samen hooguit (4x 4K is al 128 MB)
+static constexpr uint64_t kDiffKeepClosedMs = 10 * 60 * 1000;   // en niet langer dan dit
+static constexpr uint64_t kDiffMaxPixels = 1ull << 26;   // opgeslagen capture die nog vergeleken wordt (64 MP)
+static constexpr int kDiffMaxCandidates = 8;     // bestanden die de lader probeert
+static constexpr int kDiffMaxShift = 32;          // px, uitlijnen
+static constexpr uint8_t kDiffTolerance = 24;     // kanaalverschil dat nog gelijk is (ClearType, JPEG)
+
+struct DiffTarget {
+    Mode mode = Mode::Region;
+    RECT rect{};
+    std::wstring title, process;
+};
+
+struct DiffClosed {                   // bitmap van een gesloten preview (overgenomen, geen kopie)
+    uint32_t sessionId = 0;
+    HBITMAP bmp = nullptr;
+    DiffTarget target;
+    uint64_t bytes = 0;
+    uint64_t closedAt = 0;            // GetTickCount64
+};
+static std::deque<DiffClosed> g_diffClosed;   // oud -> nieuw
+
+struct DiffLoaded {                   // diff-lader -> UI (WM_DIFF_LOADED, lParam, UI geeft vrij)
+    uint32_t sessionId = 0;
+    std::vector<uint8_t> px;          // BGRA top-down; leeg = geen bruikbaar bestand
+    int w = 0, h = 0;
+    std::wstring label;
+    double ms = 0;
+};
+
+struct DiffLoaderState {
+    uint32_t sessionId = 0;           // UI-thread; 0 = lader loopt niet
+    std::atomic<bool> cancel{ false };
+    std::thread worker;
+};
+static DiffLoaderState g_diffLoader;
+
+static DiffTarget DiffTargetOf(const CaptureSession& ses) {
+    return { ses.mode, ses.srcRect, ses.srcTitle, ses.srcProcess };
+}
+
+// Zelfde schermrechthoek, of hetzelfde venster (proces + titel; bij Window mag het
+// verplaatst of van maat veranderd zijn, anders moet de maat gelijk zijn).
+static bool DiffSameTarget(const DiffTarget& a, const DiffTarget& b) {
+    if (EqualRect(&a.rect, &b.rect)) return true;
+    if (a.process.empty() || a.process != b.process || a.title != b.title) return false;
+    if (a.mode == Mode::Window && b.mode == Mode::Window) return true;
+    return a.rect.right - a.rect.left == b.rect.right - b.rect.left && a.rect.bottom - a.rect.top == b.rect.bottom - b.rect.top;
+}
+
+// Originele pixels van een sessie: base als er geannoteerd is, anders de bitmap.
+static bool DiffSessionView(const CaptureSession& ses, const uint8_t*& top, ptrdiff_t& stride, int& w, int& h) {
+    if (ses.annot.bmp == ses.bmp && !ses.annot.base.empty()) {
+        top = ses.annot.base.data();
+        stride = (ptrdiff_t)ses.annot.w * 4;
+        w = ses.annot.w;
+        h = ses.annot.h;
+        return true;
+    }
+    uint8_t* p = nullptr;
+    if (!DibTopDownView(ses.bmp, p, stride, w, h)) return false;
+    top = p;
+    return true;
+}
+
+// Te oude of te veel gesloten captures weggooien; zolang er iets over is, kijkt
+// TIMER_DIFF_EXPIRE (g_hwndMsg) later nog eens.
+static void DiffPruneClosed() {
+    const size_t drop = DiffKeepExcess(g_diffClosed, GetTickCount64(), kDiffKeepClosed, kDiffKeepClosedBytes, kDiffKeepClosedMs);
+    for (size_t i = 0; i < drop; ++i) {
+        DeleteObject(g_diffClosed.front().bmp);
+        g_diffClosed.pop_front();
+    }
+    if (!g_hwndMsg) return;
+    if (g_diffClosed.empty()) KillTimer(g_hwndMsg, TIMER_DIFF_EXPIRE);
+    else {
+        const uint64_t age = GetTickCount64() - g_diffClosed.front().closedAt;
+        SetTimer(g_hwndMsg, TIMER_DIFF_EXPIRE, (UINT)(kDiffKeepClosedMs - std::min(age, kDiffKeepClosedMs) + 1000), nullptr);
+    }
+}
+
+// WM_NCDESTROY: de bitmap (zonder annotaties) blijft bewaard als "vorige capture".
+static void DiffRememberClosed(CaptureSession& ses) {
+    if (!ses.bmp) return;
+    uint8_t* top = nullptr; ptrdiff_t stride = 0; int w = 0, h = 0;
+    if (!DibTopDownView(ses.bmp, top, stride, w, h)) return;
+    if (ses.annot.bmp == ses.bmp && !ses.annot.base.empty()) {
+        if (w != ses.annot.w || h != ses.annot.h) return;
+        for (int y = 0; y < h; ++y) std::memcpy(top + (ptrdiff_t)y * stride, ses.annot.base.data() + (size_t)y * w * 4, (size_t)w * 4);
+    }
+    g_diffClosed.push_back({ ses.id, ses.bmp, DiffTargetOf(ses), (uint64_t)w * h * 4, GetTickCount64() });
+    ses.bmp = nullptr;
+    DiffPruneClosed();
+}
+
+// Bestaande heat-map hoort niet meer bij de pixels (redactie): weg, bij D opnieuw.
+static void DiffInvalidate(CaptureSession& ses) {
+    if (ses.diffBmp) DeleteObject(ses.diffBmp);
+    ses.diffBmp = nullptr;
+    ses.diffBoxes.clear();
+    ses.diffText.clear();
+    if (ses.diffShown) {
+        ses.diffShown = false;
+        ses.statusText.clear();
+        InvalidateRect(ses.hwnd, nullptr, TRUE);
+    }
+}
+
+struct DiffPrevious {
+    const uint8_t* top = nullptr;
+    ptrdiff_t stride = 0;
+    int w = 0, h = 0;
+    std::wstring label;             // voor de statusbalk
+};
+
+// 1) nieuwste eerdere capture in het geheugen (ids lopen op)
+static bool DiffFindInMemory(const CaptureSession& ses, DiffPrevious& out) {
+    DiffPruneClosed();
+    const DiffTarget me = DiffTargetOf(ses);
+    uint32_t bestId = 0;
+    for (const auto& s : g_sessions.items) {
+        if (s->id >= ses.id || s->id <= bestId || !DiffSameTarget(me, DiffTargetOf(*s))) continue;
+        if (DiffSessionView(*s, out.top, out.stride, out.w, out.h)) bestId = s->id;
+    }
+    for (const DiffClosed& c : g_diffClosed) {
+        if (c.sessionId >= ses.id || c.sessionId <= bestId || !DiffSameTarget(me, c.target)) continue;
+        uint8_t* p = nullptr;
+        if (DibTopDownView(c.bmp, p, out.stride, out.w, out.h)) {
+            out.top = p;
+            bestId = c.sessionId;
+        }
+    }
+    out.label = L"previous capture";
+    return bestId != 0;
+}
+
+// 2) opgeslagen captures van hetzelfde doel, nieuwste eerst (JPEG niet: geen decoder).
+// Alleen paden: lezen en decoderen doet de lader.
+static std::vector<std::pair<std::wstring, bool>> DiffFileCandidates(const CaptureSession& ses) {
+    const DiffTarget me = DiffTargetOf(ses);
+    std::vector<std::pair<std::wstring, bool>> out;   // pad, BMP
+    CatalogLoad();
+    const auto& entries = g_catalog.idx.entries;
+    for (size_t i = entries.size(); i-- > 0 && out.size() < (size_t)kDiffMaxCandidates; ) {
+        const CatalogEntry& e = entries[i];
+        if (e.fmt != (uint8_t)SaveFormat::Png && e.fmt != (uint8_t)SaveFormat::Bmp) continue;
+        if (ses.hashValid && (e.flags & kCatalogHashValid) && e.hash == ses.hash) continue;   // deze capture zelf
+        const DiffTarget t{ (Mode)e.mode, RECT{ e.left, e.top, e.right, e.bottom }, e.title, e.process };
+        if (DiffSameTarget(me, t)) out.emplace_back(e.path, e.fmt == (uint8_t)SaveFormat::Bmp);
+    }
+    return out;
+}
+
+// Diff uitrekenen en als heat-map-bitmap in de sessie zetten. false = status gezet.
+static bool DiffCompute(CaptureSession& ses, const DiffPrevious& prev, double loadMs) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const uint8_t* cur = nullptr; ptrdiff_t curStride = 0; int w = 0, h = 0;
+    if (!DiffSessionView(ses, cur, curStride, w, h)) return false;
+
+    DiffResult d;
+    const DiffOffset off = DiffAlign(cur, curStride, w, h, prev.top, prev.stride, prev.w, prev.h, kDiffMaxShift);
+    DiffImages(cur, curStride, w, h, prev.top, prev.stride, prev.w, prev.h, off, kDiffTolerance, d);
+    const double diffMs = MsSince(t0);
+
+    BITMAPINFO bmi{};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = w;
+    bmi.bmiHeader.biHeight = -h;   // alleen voor de preview: top-down mag
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    void* bits = nullptr;
+    HBITMAP heat = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    uint8_t* outTop = nullptr; ptrdiff_t outStride = 0; int ow = 0, oh = 0;
+    if (!heat || !DibTopDownView(heat, outTop, outStride, ow, oh)) {
+        if (heat) DeleteObject(heat);
+        SetStatus(ses, L"Diff failed");
+        return false;
+    }
+    DiffHeatmap(cur, curStride, d, outTop, outStride);
+
+    if (ses.diffBmp) DeleteObject(ses.diffBmp);
+    ses.diffBmp = heat;
+    ses.diffBoxes = std::move(d.boxes);
+
+    wchar_t text[256]{};
+    const double pct = 100.0 * (double)d.changed / ((double)w * h);
+    if (!d.changed) swprintf_s(text, L"Diff vs %s: identical", prev.label.c_str());
+    else swprintf_s(text, L"Diff vs %s: %zu area%s, %.2f%% changed", prev.label.c_str(),
+        ses.diffBoxes.size(), ses.diffBoxes.size() == 1 ? L"" : L"s", pct);
+    ses.diffText = text;
+    if (off.dx || off.dy) {
+        swprintf_s(text, L" (shifted %+d,%+d)", -off.dx, -off.dy);
+        ses.diffText += text;
+    }
+    DebugLog(L"diff %dx%d vs %dx%d: load %.1f ms, align+diff %.1f ms, total %.1f ms, %zu boxes",
+        w, h, prev.w, prev.h, loadMs, diffMs, MsSince(t0), ses.diffBoxes.size());
+    return true;
+}
+
+static void DiffShow(CaptureSession& ses) {
+    ses.diffShown = true;
+    KillTimer(ses.hwnd, TIMER_STATUS_CLEAR);   // samenvatting blijft staan zolang de diff zichtbaar is
+    ses.statusText = ses.diffText;
+    InvalidateRect(ses.hwnd, nullptr, TRUE);
+}
+
+// Opgeslagen capture op een achtergrondthread lezen en decoderen (pixelgrens, nooit een
+// exceptie); het resultaat komt als WM_DIFF_LOADED terug. Eén lader tegelijk.
+static void DiffLoadStart(CaptureSession& ses) {
+    if (g_diffLoader.sessionId) {
+        SetStatus(ses, g_diffLoader.sessionId == ses.id ? L"Loading previous capture..." : L"Diff: another preview is still loading");
+        return;
+    }
+    auto candidates = DiffFileCandidates(ses);
+    if (candidates.empty()) {
+        SetStatus(ses, L"No previous capture of this target");
+        return;
+    }
+    if (g_diffLoader.worker.joinable()) g_diffLoader.worker.join();
+    g_diffLoader.cancel = false;
+    g_diffLoader.sessionId = ses.id;
+    g_diffLoader.worker = std::thread([id = ses.id, candidates = std::move(candidates)] {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+        const auto t0 = std::chrono::steady_clock::now();
+        auto* r = new DiffLoaded;
+        r->sessionId = id;
+        for (const auto& [path, bmp] : candidates) {
+            if (g_diffLoader.cancel) break;
+            const char* why = "";
+            if (!DecodeImageFile(path, bmp, r->px, r->w, r->h, kDiffMaxPixels, why)) {
+                DebugLog(L"diff: skipped %s (%S)", path.c_str(), why);
+                continue;
+            }
+            for (size_t p = 0; p + 3 < r->px.size(); p += 4) std::swap(r->px[p], r->px[p + 2]);   // RGBA -> BGRA
+            const size_t slash = path.find_last_of(L"\\/");
+            r->label = slash == std::wstring::npos ? path : path.substr(slash + 1);
+            break;
+        }
+        r->ms = MsSince(t0);
+        if (g_diffLoader.cancel || !g_hwndMsg || !PostMessageW(g_hwndMsg, WM_DIFF_LOADED, 0, (LPARAM)r)) delete r;
+        });
+    SetStatus(ses, L"Loading previous capture...");
+}
+
+static void DiffApplyLoaded(DiffLoaded* r) {
+    std::unique_ptr<DiffLoaded> own(r);
+    if (g_diffLoader.worker.joinable()) g_diffLoader.worker.join();
+    g_diffLoader.sessionId = 0;
+    CaptureSession* ses = SessionFind(g_sessions, r->sessionId);
+    if (!ses || ses->diffBmp) return;   // intussen gesloten (of al uitgerekend)
+    if (r->px.empty()) {
+        SetStatus(*ses, L"No previous capture of this target");
+        return;
+    }
+    const DiffPrevious prev{ r->px.data(), (ptrdiff_t)r->w * 4, r->w, r->h, r->label };
+    if (DiffCompute(*ses, prev, r->ms)) DiffShow(*ses);
+}
+
+static void DiffLoadStop() {
+    g_diffLoader.cancel = true;
+    if (g_diffLoader.worker.joinable()) g_diffLoader.worker.join();
+    g_diffLoader.sessionId = 0;
+}
+
+// D / menu: heat-map aan en uit (eenmaal uitgerekend blijft hij bewaard). Zonder vorige
+// capture in het geheugen gaat het via de lader (asynchroon).
+static void DiffToggle(CaptureSession& ses) {
+    if (ses.diffShown) {
+        ses.diffShown = false;
+        ses.statusText.clear();
+        InvalidateRect(ses.hwnd, nullptr, TRUE);
+        return;
+    }
+    if (!ses.diffBmp) {
+        DiffPrevious prev;
+        if (!DiffFindInMemory(ses, prev)) {
+            DiffLoadStart(ses);
+            return;
+        }
+        if (!DiffCompute(ses, prev, 0.0)) return;
+    }
+    DiffShow(ses);
+}
+
+// =========================================================
+// Gelijkende captures (Win32: index bij save, Find similar, bulk-indexer)
+// =========================================================
+// similar.bin (settings-map) wordt bij het eerste gebruik ingelezen en in een
+// HammingIndex gezet; elke save voegt één record toe. Entries blijven op hun plek
+// staan (item in de index = positie), vervangen of verdwenen bestanden krijgen alleen
+// de removed-vlag. De bulk-indexer (tray) hasht wat nog niet in de index staat op een
+// achtergrondthread en geeft het resultaat in één keer aan de UI-thread.
+struct SimilarIndexed {               // bulk-indexer -> UI (WM_SIMILAR_INDEXED, lParam, UI geeft vrij)
+    std::vector<SimilarEntry> items;
+    double ms = 0;
+};
+
+struct SimilarState {
+    std::vector<SimilarEntry> entries;
+    std::unordered_map<std::wstring, uint32_t> byPath;   // SimilarPathKey -> entry
+    HammingIndex index;
+    bool loaded = false;
+    bool parsed = false;                                 // bestand gelezen (of bestaat nog niet): validBytes klopt
+    uint64_t validBytes = 0;
+    size_t records = 0;
+    bool indexing = false;                               // UI-thread
+    std::atomic<bool> cancel{ false };
+    std::thread worker;
+};
+static SimilarState g_similar;
+
+static std::wstring SimilarFile() {
+    return SettingsDir() + L"\\similar.bin";
+}
+
+// Zelfde bestand via de save en via de map-scan: één sleutel.
+static std::wstring SimilarPathKey(const std::wstring& path) {
+    std::wstring k = std::filesystem::path(path).lexically_normal().wstring();
+    for (auto& c : k) c = CatalogLower(c);
+    return k;
+}
+
+static uint64_t SimilarStamp(const std::wstring& path) {
+    std::error_code ec;
+    const auto t = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : (uint64_t)t.time_since_epoch().count();
+}
+
+static void SimilarAdd(SimilarEntry e) {
+    const uint32_t at = (uint32_t)g_similar.entries.size();
+    auto [it, fresh] = g_similar.byPath.try_emplace(SimilarPathKey(e.path), at);
+    if (!fresh) {
+        g_similar.entries[it->second].flags |= kSimilarRemoved;
+        it->second = at;
+    }
+    HammingIndexAdd(g_similar.index, e.phash);
+    g_similar.entries.push_back(std::move(e));
+}
+
+static void SimilarLoad() {
+    if (g_similar.loaded) return;
+    g_similar.loaded = true;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    std::vector<uint8_t> bytes;
+    std::vector<SimilarEntry> entries;
+    g_similar.entries.clear();
+    g_similar.byPath.clear();
+    g_similar.index = HammingIndex{};
+    g_similar.validBytes = 0;
+    g_similar.records = 0;
+    const std::wstring file = SimilarFile();
+    if (ReadWholeFile(file, bytes)) {
+        g_similar.validBytes = SimilarParse(bytes.data(), bytes.size(), entries, &g_similar.records);
+        g_similar.parsed = true;
+    }
+    else {   // bestaat niet: leeg beginnen; wel maar niet leesbaar: niet schrijven (zou afkappen)
+        const DWORD attr = GetFileAttributesW(file.c_str());
+        const DWORD err = GetLastError();
+        g_similar.parsed = attr == INVALID_FILE_ATTRIBUTES && (err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND);
+        if (!g_similar.parsed) DebugLog(L"similar: similar.bin not readable, no writes until it is");
+    }
+
+    g_similar.index.hashes.reserve(entries.size());
+    for (uint32_t i = 0; i < (uint32_t)entries.size(); ++i) {
+        g_similar.byPath[SimilarPathKey(entries[i].path)] = i;
+        g_similar.index.hashes.push_back(entries[i].phash);
+    }
+    HammingIndexBuild(g_similar.index);
+    g_similar.entries = std::move(entries);
+    DebugLog(L"similar: %zu hashes (%zu records) loaded + indexed in %.1f ms", g_similar.entries.size(), g_similar.records, MsSince(t0));
+
+    // kapotte staart of veel vervallen records: één keer netjes herschrijven
+    if (g_similar.parsed && !bytes.empty() && (g_similar.validBytes != bytes.size() || g_similar.records > 2 * g_similar.entries.size() + 64)) {
+        std::vector<uint8_t> all;
+        SimilarPutHeader(all);
+        for (const SimilarEntry& e : g_similar.entries) SimilarPutRecord(all, e);
+        const std::wstring tmp = file + L".tmp";
+        if (WriteWholeFile(tmp, all.data(), all.size()) && MoveFileExW(tmp.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            g_similar.validBytes = all.size();
+            g_similar.records = g_similar.entries.size();
+        }
+        else {
+            DeleteFileW(tmp.c_str());
+        }
+    }
+}
+
+// Geladen en gelezen; een eerder onleesbaar similar.bin (bv. gelockt) opnieuw proberen.
+// Daarna kunnen entries/byPath vervangen zijn: pas daarna iterators pakken.
+static bool SimilarReady() {
+    SimilarLoad();
+    if (!g_similar.parsed) {
+        g_similar.loaded = false;
+        SimilarLoad();
+    }
+    return g_similar.parsed;
+}
+
+// Records achteraan, in één write (na een eventueel afgebroken record: eerst afkappen).
+// Alleen na SimilarReady(): zonder gelezen bestand is validBytes geen afkappunt.
+static bool SimilarAppend(const std::vector<SimilarEntry>& recs) {
+    if (recs.empty()) return true;
+    if (!g_similar.parsed) return false;
+    std::vector<uint8_t> out;
+    if (g_similar.validBytes == 0) SimilarPutHeader(out);
+    for (const SimilarEntry& e : recs) SimilarPutRecord(out, e);
+
+    EnsureDirectoryRecursive(SettingsDir() + L"\\");
+    HANDLE hf = CreateFileW(SimilarFile().c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hf == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER at{};
+    at.QuadPart = (LONGLONG)g_similar.validBytes;
+    DWORD written = 0;
+    const bool ok = SetFilePointerEx(hf, at, nullptr, FILE_BEGIN) && SetEndOfFile(hf) &&
+        WriteFile(hf, out.data(), (DWORD)out.size(), &written, nullptr) && written == out.size();
+    CloseHandle(hf);
+    if (ok) {
+        g_similar.validBytes += out.size();
+        g_similar.records += recs.size();
+    }
+    return ok;
+}
+
+// Na een geslaagde save (UI-thread): de pHash van wat er op schijf staat.
+static void SimilarRecordSave(const CaptureSession& ses, const std::wstring& path) {
+    uint8_t* top = nullptr;
+    ptrdiff_t stride = 0;
+    int w = 0, h = 0;
+    if (!DibTopDownView(ses.bmp, top, stride, w, h) || !SimilarReady()) return;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    SimilarEntry e;
+    e.phash = PerceptualHash(top, stride, w, h);
+    e.stamp = SimilarStamp(path);
+    e.path = path;
+    const double hashMs = MsSince(t0);
+    if (!SimilarAppend({ e })) return;
+    SimilarAdd(std::move(e));
+    DebugLog(L"similar: pHash %dx%d in %.2f ms, %zu hashes", w, h, hashMs, g_similar.entries.size());
+}
+
+static void SimilarForget(const std::wstring& path) {
+    if (!SimilarReady()) return;
+    auto it = g_similar.byPath.find(SimilarPathKey(path));
+    if (it == g_similar.byPath.end()) return;
+    SimilarEntry t;
+    t.flags = kSimilarRemoved;
+    t.path = g_similar.entries[it->second].path;
+    if (!SimilarAppend({ t })) return;
+    g_similar.entries[it->second].flags |= kSimilarRemoved;
+    g_similar.byPath.erase(it);
+}
+
+// Find similar (preview, F): treffers in het zoekvenster.
+static void SimilarFindFor(CaptureSession& ses) {
+    uint8_t* top = nullptr;
+    ptrdiff_t stride = 0;
+    int w = 0, h = 0;
+    if (!DibTopDownView(ses.bmp, top, stride, w, h)) return;
+    SimilarLoad();
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const uint64_t hash = PerceptualHash(top, stride, w, h);
+    const double hashMs = MsSince(t0);
+    const auto t1 = std::chrono::steady_clock::now();
+    std::vector<std::pair<int, uint32_t>> found;
+    size_t checked = 0;
+    HammingIndexQuery(g_similar.index, hash, kSimilarRadius, found, &checked);
+    std::vector<std::pair<int, std::wstring>> hits;
+    for (const auto& [d, item] : found) {
+        if (g_similar.entries[item].flags & kSimilarRemoved) continue;
+        hits.emplace_back(d, g_similar.entries[item].path);
+        if (hits.size() == kSimilarMaxResults) break;
+    }
+    const double queryMs = MsSince(t1);
+    DebugLog(L"similar: %zu hits of %zu (checked %zu), pHash %.2f ms, query %.3f ms", hits.size(), g_similar.entries.size(),
+        checked, hashMs, queryMs);
+
+    wchar_t text[64]{};
+    swprintf_s(text, L"%zu similar captures", hits.size());
+    SetStatus(ses, text);
+    CatalogShowSimilar(std::move(hits), g_similar.byPath.size(), queryMs);
+}
+
+// Worker-threads: PNG/BMP met de eigen decoders, JPEG via WIC. Pixels RGBA of BGRA
+// (de pHash maakt geen onderscheid).
+static bool SimilarDecodeFile(const std::wstring& path, std::vector<uint8_t>& px, int& w, int& h) {
+    std::wstring ext = std::filesystem::path(path).extension().wstring();
+    for (auto& c : ext) c = CatalogLower(c);
+    if (ext == L".png" || ext == L".bmp") {
+        const char* why = "";
+        return DecodeImageFile(path, ext == L".bmp", px, w, h, kDecodeMaxPixels, why);
+    }
+
+    const HRESULT hrCo = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    IWICImagingFactory* factory = nullptr;
+    IWICBitmapDecoder* decoder = nullptr;
+    IWICBitmapFrameDecode* frame = nullptr;
+    IWICFormatConverter* conv = nullptr;
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+    if (SUCCEEDED(hr)) hr = factory->CreateDecoderFromFilename(path.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+    if (SUCCEEDED(hr)) hr = decoder->GetFrame(0, &frame);
+    if (SUCCEEDED(hr)) hr = factory->CreateFormatConverter(&conv);
+    if (SUCCEEDED(hr)) hr = conv->Initialize(frame, GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+    UINT uw = 0, uh = 0;
+    if (SUCCEEDED(hr)) hr = conv->GetSize(&uw, &uh);
+    if (SUCCEEDED(hr) && (uw == 0 || uh == 0 || (uint64_t)uw * uh > kDecodeMaxPixels)) hr = E_FAIL;
+    if (SUCCEEDED(hr)) {
+        try { px.resize((size_t)uw * uh * 4); }
+        catch (const std::bad_alloc&) { hr = E_OUTOFMEMORY; }   // COM-objecten hieronder nog vrijgeven
+    }
+    if (SUCCEEDED(hr)) {
+        hr = conv->CopyPixels(nullptr, uw * 4, (UINT)px.size(), px.data());
+        w = (int)uw;
+        h = (int)uh;
+    }
+    if (conv) conv->Release();
+    if (frame) frame->Release();
+    if (decoder) decoder->Release();
+    if (factory) factory->Release();
+    if (SUCCEEDED(hrCo)) CoUninitialize();
+    return SUCCEEDED(hr);
+}
+
+// Tray: alles in de save-map dat nog niet (of in een oudere versie) geïndexeerd is.
+static void SimilarIndexFolderStart() {
+    if (g_similar.indexing) return;
+    if (!SimilarReady()) {
+        TrayNotify(L"snip-lite", L"similar.bin is not readable (in use?)");
+        return;
+    }
+    if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
+
+    std::unordered_map<std::wstring, uint64_t> known;   // snapshot: de worker raakt g_similar niet aan
+    for (const auto& [key, i] : g_similar.byPath) known.emplace(key, g_similar.entries[i].stamp);
+
+    if (g_similar.worker.joinable()) g_similar.worker.join();
+    g_similar.cancel = false;
+    g_similar.indexing = true;
+    g_similar.worker = std::thread([dir = g_saveDir, known = std::move(known)] {
+        const auto t0 = std::chrono::steady_clock::now();
+        auto* r = new SimilarIndexed;
+        SimilarListFolder(dir, [&](const std::wstring& path, uint64_t stamp) {
+            auto it = known.find(SimilarPathKey(path));
+            return it != known.end() && it->second == stamp;
+            }, r->items);
+        // één core over voor de UI; workers op achtergrondprioriteit
+        const int threads = (int)std::max(2u, std::thread::hardware_concurrency()) - 1;
+        SimilarHashFiles(r->items, threads, [](const std::wstring& path, std::vector<uint8_t>& px, int& w, int& h) {
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+            return !g_similar.cancel && SimilarDecodeFile(path, px, w, h);
+            });
+        r->ms = MsSince(t0);
+        if (g_similar.cancel || !g_hwndMsg || !PostMessageW(g_hwndMsg, WM_SIMILAR_INDEXED, 0, (LPARAM)r)) delete r;
+        });
+    TrayNotify(L"snip-lite", L"Indexing the save folder for similar search...");
+}
+
+static void SimilarApplyIndexed(SimilarIndexed* r) {
+    if (g_similar.worker.joinable()) g_similar.worker.join();
+    g_similar.indexing = false;
+
+    std::vector<SimilarEntry> ok;
+    size_t skipped = 0;
+    for (SimilarEntry& e : r->items) {
+        if (e.flags & kSimilarRemoved) ++skipped;
+        else ok.push_back(std::move(e));
+    }
+    if (SimilarAppend(ok)) {
+        for (SimilarEntry& e : ok) SimilarAdd(std::move(e));
+    }
+    DebugLog(L"similar: bulk index %zu new, %zu skipped in %.0f ms (%zu hashes)", ok.size(), skipped, r->ms, g_similar.entries.size());
+
+    wchar_t text[160]{};
+    swprintf_s(text, L"%zu images indexed in %.1f s%s", ok.size(), r->ms / 1000.0, skipped ? L" (some could not be read)" : L"");
+    TrayNotify(L"snip-lite", text);
+    delete r;
+}
+
+static void SimilarIndexStop() {
+    g_similar.cancel = true;
+    if (g_similar.worker.joinable()) g_similar.worker.join();
+}
+
+// =========================================================
+// Burst (interval capture)
+// =========================================================
+struct BurstState {
+    bool active = false;
+    RECT rect{};
+    int w = 0, h = 0;
+    HDC memDC = nullptr;
+    HBITMAP dib = nullptr;      // top-down, blijft de hele burst bestaan
+    HGDIOBJ oldBmp = nullptr;
+    uint8_t* bits = nullptr;
+    std::vector<uint8_t> prev;
+    std::vector<uint8_t> changed;
+    DeltaWriter writer;
+    std::wstring path;
+    uint32_t captured = 0;      // incl. identieke (niet opgeslagen) frames
+    std::chrono::steady_clock::time_point t0;
+};
+static BurstState g_burst;
+
+static void TraySetTip(const wchar_t* tip);
+
+static void BurstReleaseDib() {
+    if (g_burst.memDC) {
+        SelectObject(g_burst.memDC, g_burst.oldBmp);
+        DeleteDC(g_burst.memDC);
+    }
+    if (g_burst.dib) DeleteObject(g_burst.dib);
+    g_burst.memDC = nullptr;
+    g_burst.dib = nullptr;
+    g_burst.oldBmp = nullptr;
+    g_burst.bits = nullptr;
+}
+
+static void BurstTick() {
+    if (!g_burst.active) return;
+
+    HDC hdcScreen = GetDC(nullptr);
+    if (!hdcScreen) return;
+    const BOOL ok = BitBlt(g_burst.memDC, 0, 0, g_burst.w, g_burst.h, hdcScreen,
+        g_burst.rect.left, g_burst.rect.top, SRCCOPY | CAPTUREBLT);
+    ReleaseDC(nullptr, hdcScreen);
+    GdiFlush();
+    if (!ok) return;
+
+    const size_t stride = (size_t)g_burst.w * 4;
+    const uint64_t timeMs = (uint64_t)MsSince(g_burst.t0);
+    const auto t0 = std::chrono::steady_clock::now();
+    g_burst.captured++;
+
+    if (g_burst.writer.frames == 0) {
+        DeltaWriterAddFrame(g_burst.writer, g_burst.bits, stride, nullptr, timeMs);
+    }
+    else {
+        const int n = DiffTiles(g_burst.bits, g_burst.prev.data(), g_burst.w, g_burst.h, stride, kBurstTile, g_burst.changed);
+        if (n == 0) return; // identiek: niets opslaan
+        DeltaWriterAddFrame(g_burst.writer, g_burst.bits, stride, &g_burst.changed, timeMs);
+        DebugLog(L"burst frame %u: %d/%zu tiles changed (%.2f ms)", g_burst.writer.frames, n, g_burst.changed.size(), MsSince(t0));
+    }
+    std::memcpy(g_burst.prev.data(), g_burst.bits, g_burst.prev.size());
+
+    wchar_t tip[128]{};
+    swprintf_s(tip, L"snip-lite - burst: %u frames (%.1f MB)", g_burst.writer.frames, g_burst.writer.bytes / 1048576.0);
+    TraySetTip(tip);
+}
+
+static bool BurstStart(const RECT& sr) {
+    if (g_burst.active) return false;
+
+    const int w = sr.right - sr.left;
+    const int h = sr.bottom - sr.top;
+    if (w <= 0 || h <= 0) return false;
+
+    if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
+    EnsureDirectoryRecursive(g_saveDir + L"\\");
+
+    SYSTEMTIME st{};
+    GetLocalTime(&st);
+    wchar_t name[64]{};
+    swprintf_s(name, L"burst_%04u-%02u-%02u_%02u%02u%02u.snipburst",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+    std::wstring path = g_saveDir;
+    if (path.back() != L'\\') path += L"\\";
+    path += name;
+
+    BITMAPINFO bmi{};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = w;
+    bmi.bmiHeader.biHeight = -h;          // top-down: zelfde layout als het container-formaat
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    HDC hdcScreen = GetDC(nullptr);
+    void* bits = nullptr;
+    g_burst.dib = CreateDIBSection(hdcScreen, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    g_burst.memDC = g_burst.dib ? CreateCompatibleDC(hdcScreen) : nullptr;
+    ReleaseDC(nullptr, hdcScreen);
+    if (!g_burst.memDC || !bits) { BurstReleaseDib(); return false; }
+    g_burst.oldBmp = SelectObject(g_burst.memDC, g_burst.dib);
+    g_burst.bits = (uint8_t*)bits;
+
+    if (!DeltaWriterOpen(g_burst.writer, std::filesystem::path(path), w, h, kBurstTile)) {
+        BurstReleaseDib();
+        return false;
+    }
+
+    g_burst.rect = sr;
+    g_burst.w = w;
+    g_burst.h = h;
+    g_burst.prev.assign((size_t)w * h * 4, 0);
+    g_burst.path = path;
+    g_burst.captured = 0;
+    g_burst.t0 = std::chrono::steady_clock::now();
+    g_burst.active = true;
+
+    BurstTick();
+    SetTimer(g_hwndMsg, TIMER_BURST, (UINT)g_burstIntervalMs, nullptr);
+    return true;
+}
+
+static void BurstStop() {
+    if (!g_burst.active) return;
+    KillTimer(g_hwndMsg, TIMER_BURST);
+    g_burst.active = false;
+
+    DeltaWriterClose(g_burst.writer);
+    BurstReleaseDib();
+    g_burst.prev.clear();
+    g_burst.prev.shrink_to_fit();
+
+    const double raw = (double)g_burst.captured * g_burst.w * g_burst.h * 4.0;
+    const double pct = raw > 0.0 ? 100.0 * (double)g_burst.writer.bytes / raw : 0.0;
+
+    wchar_t msg[256]{};
+    swprintf_s(msg, L"%u captures, %u stored, %.1f MB (%.1f%% of raw)",
+        g_burst.captured, g_burst.writer.frames, g_burst.writer.bytes / 1048576.0, pct);
+    DebugLog(L"burst stopped: %s -> %s", msg, g_burst.path.c_str());
+
+    g_lastBurstFile = g_burst.path;
+    SaveSettings();
+
+    TraySetTip(L"snip-lite");
+    TrayNotify(L"Burst saved", msg);
+    SessionsShowLater();
+}
+
+// Burst -> losse PNG's in "<bestand>_frames\frame_0001.png" (voor delen/bekijken).
+static bool BurstExportFrames(const std::wstring& burstFile, int& outFrames) {
+    outFrames = 0;
+
+    DeltaReader dr;
+    if (!DeltaReaderOpen(dr, std::filesystem::path(burstFile))) return false;
+
+    std::wstring dir = burstFile;
+    const size_t dot = dir.find_last_of(L'.');
+    if (dot != std::wstring::npos) dir.resize(dot);
+    dir += L"_frames";
+    EnsureDirectoryRecursive(dir + L"\\");
+
+    while (DeltaReaderNext(dr)) {
+        HBITMAP bmp = CreateDibFromPixels(dr.canvas.data(), dr.w, dr.h, (size_t)dr.w * 4, true);
+        if (!bmp) return false;
+
+        wchar_t name[32]{};
+        swprintf_s(name, L"\\frame_%04d.png", outFrames + 1);
+        const bool ok = SaveBitmapWic(bmp, dir + name, SaveFormat::Png);
+        DeleteObject(bmp);
+        if (!ok) return false;
+        outFrames++;
+    }
+    return outFrames > 0;
+}
+
+// =========================================================
+// Record (APNG, capture- en encode-thread)
+// =========================================================
+// Capture-thread: BitBlt op vaste fps naar een vrije buffer uit de pool.
+// Encode-thread: diff t.o.v. vorig frame -> bounding box -> PNG (WIC) -> fdAT.
+// Queue is begrensd: loopt de encoder achter, dan vervalt het nieuwe frame
+// (telt als "dropped") in plaats van dat het geheugen oploopt.
+static constexpr int kRecordPoolFrames = 4;
+
+struct RecordFrame {
+    std::vector<uint8_t> px;    // top-down BGRA, stride = w*4
+    uint64_t timeMs = 0;
+};
+
+struct RecordState {
+    bool active = false;        // alleen UI-thread
+    RECT rect{};
+    int w = 0, h = 0;
+    std::wstring path;
+    std::chrono::steady_clock::time_point t0;
+
+    std::thread captureThread;
+    std::thread encodeThread;
+    std::atomic<bool> stopCapture{ false };
+    std::atomic<bool> failed{ false };
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<RecordFrame*> freeList;  // pool
+    std::deque<RecordFrame*> queue;      // klaar voor encode
+    bool captureDone = false;
+    RecordFrame frames[kRecordPoolFrames];
+
+    // statistiek (geschreven door de threads, gelezen na join)
+    uint32_t captured = 0, dropped = 0, unchanged = 0;
+    double encodeMsTotal = 0.0;
+    uint64_t endTimeMs = 0;
+    ApngWriter writer;
+};
+static RecordState g_rec;
+
+static void RecordCaptureThread() {
+    HDC hdcScreen = GetDC(nullptr);
+    HDC memDC = hdcScreen ? CreateCompatibleDC(hdcScreen) : nullptr;
+
+    BITMAPINFO bmi{};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = g_rec.w;
+    bmi.bmiHeader.biHeight = -g_rec.h;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = nullptr;
+    HBITMAP dib = memDC ? CreateDIBSection(hdcScreen, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0) : nullptr;
+    HGDIOBJ oldBmp = dib ? SelectObject(memDC, dib) : nullptr;
+
+    const auto period = std::chrono::microseconds(1000000 / g_recordFps);
+    auto next = g_rec.t0;
+
+    while (dib && bits && !g_rec.stopCapture.load()) {
+        const BOOL ok = BitBlt(memDC, 0, 0, g_rec.w, g_rec.h, hdcScreen, g_rec.rect.left, g_rec.rect.top, SRCCOPY | CAPTUREBLT);
+        GdiFlush();
+        const uint64_t timeMs = (uint64_t)MsSince(g_rec.t0);
+
+        if (ok) {
+            RecordFrame* f = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(g_rec.mtx);
+                g_rec.captured++;
+                if (!g_rec.freeList.empty()) {
+                    f = g_rec.freeList.back();
+                    g_rec.freeList.pop_back();
+                }
+                else {
+                    g_rec.dropped++;
+                }
+            }
+            if (f) {
+                std::memcpy(f->px.data(), bits, f->px.size());
+                f->timeMs = timeMs;
+                {
+                    std::lock_guard<std::mutex> lock(g_rec.mtx);
+                    g_rec.queue.push_back(f);
+                }
+                g_rec.cv.notify_one();
+            }
+        }
+
+        // vaste klok; na een hapering niet "inhalen" met een salvo frames
+        next += period;
+        const auto now = std::chrono::steady_clock::now();
+        if (next < now) next = now;
+        std::this_thread::sleep_until(next);
+    }
+
+    if (oldBmp) SelectObject(memDC, oldBmp);
+    if (dib) DeleteObject(dib);
+    if (memDC) DeleteDC(memDC);
+    if (hdcScreen) ReleaseDC(nullptr, hdcScreen);
+
+    {
+        std::lock_guard<std::mutex> lock(g_rec.mtx);
+        g_rec.endTimeMs = (uint64_t)MsSince(g_rec.t0);
+        g_rec.captureDone = true;
+        if (!dib || !bits) g_rec.failed = true;
+    }
+    g_rec.cv.notify_one();
+}
+
+static void RecordEncodeThread() {
+    const HRESULT hrCo = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    IWICImagingFactory* factory = nullptr;
+    CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+    if (!factory) g_rec.failed = true;
+
+    const size_t stride = (size_t)g_rec.w * 4;
+    std::vector<uint8_t> prev((size_t)g_rec.w * g_rec.h * 4);
+    std::vector<uint8_t> png;
+    bool first = true;
+
+    for (;;) {
+        RecordFrame* f = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(g_rec.mtx);
+            g_rec.cv.wait(lock, [] { return !g_rec.queue.empty() || g_rec.captureDone; });
+            if (g_rec.queue.empty()) break; // captureDone + leeg
+            f = g_rec.queue.front();
+            g_rec.queue.pop_front();
+        }
+
+        if (factory && !g_rec.failed) {
+            const auto t0 = std::chrono::steady_clock::now();
+
+            PixRect r{ 0, 0, g_rec.w, g_rec.h };
+            const bool changed = first || DiffBounds(f->px.data(), prev.data(), g_rec.w, g_rec.h, stride, r);
+            if (!changed) {
+                g_rec.unchanged++; // vorig frame duurt gewoon langer
+            }
+            else {
+                const uint8_t* sub = f->px.data() + (size_t)r.y0 * stride + (size_t)r.x0 * 4;
+                if (!EncodePixelsWicToMemory(factory, sub, r.Width(), r.Height(), stride, SaveFormat::Png, png) ||
+                    !ApngWriterAddFrame(g_rec.writer, png, r, f->timeMs)) {
+                    g_rec.failed = true;
+                    PostMessageW(g_hwndMsg, WM_RECORD_STOP, 0, 0);
+                }
+                std::memcpy(prev.data(), f->px.data(), prev.size());
+                first = false;
+            }
+            g_rec.encodeMsTotal += MsSince(t0);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(g_rec.mtx);
+            g_rec.freeList.push_back(f);
+        }
+    }
+
+    if (factory) factory->Release();
+    if (SUCCEEDED(hrCo)) CoUninitialize();
+}
+
+static bool RecordStart(const RECT& sr) {
+    if (g_rec.active || g_burst.active) return false;
+
+    const int w = sr.right - sr.left;
+    const int h = sr.bottom - sr.top;
+    if (w <= 0 || h <= 0) return false;
+
+    if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
+    EnsureDirectoryRecursive(g_saveDir + L"\\");
+
+    SYSTEMTIME st{};
+    GetLocalTime(&st);
+    wchar_t name[64]{};
+    swprintf_s(name, L"rec_%04u-%02u-%02u_%02u%02u%02u.png",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+    std::wstring path = g_saveDir;
+    if (path.back() != L'\\') path += L"\\";
+    path += name;
+
+    if (!ApngWriterOpen(g_rec.writer, std::filesystem::path(path), w, h)) return false;
+
+    g_rec.rect = sr;
+    g_rec.w = w;
+    g_rec.h = h;
+    g_rec.path = path;
+    g_rec.freeList.clear();
+    g_rec.queue.clear();
+    for (RecordFrame& f : g_rec.frames) {
+        f.px.assign((size_t)w * h * 4, 0);
+        g_rec.freeList.push_back(&f);
+    }
+    g_rec.captureDone = false;
+    g_rec.stopCapture = false;
+    g_rec.failed = false;
+    g_rec.captured = g_rec.dropped = g_rec.unchanged = 0;
+    g_rec.encodeMsTotal = 0.0;
+    g_rec.endTimeMs = 0;
+    g_rec.t0 = std::chrono::steady_clock::now();
+
+    g_rec.encodeThread = std::thread(RecordEncodeThread);
+    g_rec.captureThread = std::thread(RecordCaptureThread);
+    g_rec.active = true;
+
+    TraySetTip(L"snip-lite - recording (hotkey stops)");
+    return true;
+}
+
+static void RecordStop() {
+    if (!g_rec.active) return;
+    g_rec.active = false;
+
+    // capture stopt eerst; encoder werkt de queue nog af
+    g_rec.stopCapture = true;
+    if (g_rec.captureThread.joinable()) g_rec.captureThread.join();
+    if (g_rec.encodeThread.joinable()) g_rec.encodeThread.join();
+
+    const bool ok = ApngWriterClose(g_rec.writer, g_rec.endTimeMs) && !g_rec.failed;
+    for (RecordFrame& f : g_rec.frames) {
+        f.px.clear();
+        f.px.shrink_to_fit();
+    }
+    g_rec.freeList.clear();
+
+    const double secs = g_rec.endTimeMs / 1000.0;
+    const uint32_t encoded = g_rec.captured - g_rec.dropped - g_rec.unchanged;
+    wchar_t msg[256]{};
+    swprintf_s(msg, L"%.1f s, %u frames (%u unchanged, %u dropped), %.1f MB",
+        secs, g_rec.writer.frames, g_rec.unchanged, g_rec.dropped, g_rec.writer.bytes / 1048576.0);
+    DebugLog(L"record stopped: %s, %.1f fps captured, avg encode %.2f ms -> %s",
+        msg, secs > 0.0 ? g_rec.captured / secs : 0.0,
+        encoded ? g_rec.encodeMsTotal / encoded : 0.0, g_rec.path.c_str());
+
+    TraySetTip(L"snip-lite");
+    SessionsShowLater();
+    if (ok) {
+        g_lastSavedFile = g_rec.path;
+        SaveSettings();
+        TrayNotify(L"Recording saved", msg);
+    }
+    else {
+        DeleteFileW(g_rec.path.c_str());
+        TrayNotify(L"Recording failed", msg);
+    }
+}
+
+// =========================================================
+// Scroll capture (window scrollt, frames worden gestitcht)
+// =========================================================
+// Tick: viewport grabben -> stitcher -> muiswiel omlaag. Klaar bij einde van de
+// pagina (twee keer geen beweging), geen overlap meer, max hoogte of hotkey.
+static constexpr int kScrollTickMs = 200;       // scrollen + repaint afwachten
+static constexpr int kScrollMaxRows = 30000;
+static constexpr int kScrollWheelNotches = 3;
+
+static void BringWindowToFrontForCapture(HWND h);
+
+struct ScrollState {
+    bool active = false;
+    RECT rect{};
+    int w = 0, h = 0;
+    HDC memDC = nullptr;
+    HBITMAP dib = nullptr;      // top-down viewport-buffer
+    HGDIOBJ oldBmp = nullptr;
+    uint8_t* bits = nullptr;
+    POINT cursorBefore{};
+    int stillTicks = 0;
+    double stitchMsTotal = 0.0;
+    ScrollStitcher stitcher;
+};
+static ScrollState g_scroll;
+
+static void ScrollReleaseDib() {
+    if (g_scroll.memDC) {
+        SelectObject(g_scroll.memDC, g_scroll.oldBmp);
+        DeleteDC(g_scroll.memDC);
+    }
+    if (g_scroll.dib) DeleteObject(g_scroll.dib);
+    g_scroll.memDC = nullptr;
+    g_scroll.dib = nullptr;
+    g_scroll.oldBmp = nullptr;
+    g_scroll.bits = nullptr;
+}
+
+static void ScrollSendWheel() {
+    INPUT in{};
+    in.type = INPUT_MOUSE;
+    in.mi.dwFlags = MOUSEEVENTF_WHEEL;
+    in.mi.mouseData = (DWORD)(-kScrollWheelNotches * WHEEL_DELTA);
+    SendInput(1, &in, sizeof(INPUT));
+}
+
+static void ScrollFinish() {
+    if (!g_scroll.active) return;
+    KillTimer(g_hwndMsg, TIMER_SCROLL);
+    g_scroll.active = false;
+    ScrollReleaseDib();
+    SetCursorPos(g_scroll.cursorBefore.x, g_scroll.cursorBefore.y);
+    SessionsShowLater();
+
+    ScrollStitcher& st = g_scroll.stitcher;
+    DebugLog(L"scroll capture: %d frames -> %dx%d, stitch %.1f ms total (%.2f ms/frame)",
+        st.frames, st.w, st.out.rows, g_scroll.stitchMsTotal,
+        st.frames ? g_scroll.stitchMsTotal / st.frames : 0.0);
+
+    std::vector<uint8_t> px;
+    RowBufFlatten(st.out, px);
+    const int outH = st.out.rows;
+    st = ScrollStitcher{}; // chunks vrijgeven
+
+    HBITMAP bmp = outH > 0 ? CreateDibFromPixels(px.data(), g_scroll.w, outH, (size_t)g_scroll.w * 4, true) : nullptr;
+    px.clear();
+    px.shrink_to_fit();
+    if (!bmp) {
+        MessageBeep(MB_ICONERROR);
+        return;
+    }
+
+    FreeCapture();
+    g_captureBmp = bmp;
+    g_captureW = g_scroll.w;
+    g_captureH = outH;
+    g_captureHasAlpha = false;
+    g_captureSrcRect = g_scroll.rect;
+
+    if (!CopyBitmapToClipboard(g_captureBmp)) MessageBeep(MB_ICONWARNING);
+    UpdateCaptureHash();
+    OpenCaptureSession();
+}
+
+static void ScrollTick() {
+    if (!g_scroll.active) return;
+
+    HDC hdcScreen = GetDC(nullptr);
+    if (!hdcScreen) return;
+    const BOOL ok = BitBlt(g_scroll.memDC, 0, 0, g_scroll.w, g_scroll.h, hdcScreen,
+        g_scroll.rect.left, g_scroll.rect.top, SRCCOPY | CAPTUREBLT);
+    ReleaseDC(nullptr, hdcScreen);
+    GdiFlush();
+    if (!ok) { ScrollFinish(); return; }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const StitchResult r = StitchAddFrame(g_scroll.stitcher, g_scroll.bits, (size_t)g_scroll.w * 4);
+    g_scroll.stitchMsTotal += MsSince(t0);
+
+    if (r == StitchResult::NoMatch) {
+        // te ver gescrold of de inhoud veranderde: stoppen met wat er is
+        DebugLog(L"scroll capture: no overlap found, stopping");
+        ScrollFinish();
+        return;
+    }
+    g_scroll.stillTicks = (r == StitchResult::NoMovement) ? g_scroll.stillTicks + 1 : 0;
+    if (g_scroll.stillTicks >= 2 || g_scroll.stitcher.out.rows >= kScrollMaxRows) {
+        ScrollFinish();
+        return;
+    }
+
+    ScrollSendWheel();
+}
+
+// sr = window-rect (scherm), target = window onder de cursor bij de klik.
+static bool ScrollStart(HWND target, const RECT& sr) {
+    if (g_scroll.active || g_burst.active || g_rec.active) return false;
+
+    const int w = sr.right - sr.left;
+    const int h = sr.bottom - sr.top;
+    if (w <= 0 || h <= 0) return false;
+
+    BITMAPINFO bmi{};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = w;
+    bmi.bmiHeader.biHeight = -h;          // top-down: stitcher werkt in leesrichting
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    HDC hdcScreen = GetDC(nullptr);
+    void* bits = nullptr;
+    g_scroll.dib = CreateDIBSection(hdcScreen, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    g_scroll.memDC = g_scroll.dib ? CreateCompatibleDC(hdcScreen) : nullptr;
+    ReleaseDC(nullptr, hdcScreen);
+    if (!g_scroll.memDC || !bits) { ScrollReleaseDib(); return false; }
+    g_scroll.oldBmp = SelectObject(g_scroll.memDC, g_scroll.dib);
+    g_scroll.bits = (uint8_t*)bits;
+
+    g_scroll.rect = sr;
+    g_scroll.w = w;
+    g_scroll.h = h;
+    g_scroll.stillTicks = 0;
+    g_scroll.stitchMsTotal = 0.0;
+    StitchInit(g_scroll.stitcher, w, h, kScrollMaxRows);
+
+    BringWindowToFrontForCapture(target);
+
+    // wiel-events gaan naar het window onder de cursor: midden van het window
+    GetCursorPos(&g_scroll.cursorBefore);
+    SetCursorPos((sr.left + sr.right) / 2, (sr.top + sr.bottom) / 2);
+
+    g_scroll.active = true;
+    ScrollTick();
+    if (g_scroll.active) SetTimer(g_hwndMsg, TIMER_SCROLL, (UINT)kScrollTickMs, nullptr);
+    return true;
+}
+
+#endif // !SNIP_CORE_ONLY
+
+// =========================================================
+// Loupe: integer zoom kernel (portable, geen Win32)
+// =========================================================
+// Nearest-neighbour met gehele factor: per bronrij één uitgerekte doelrij,
+// de overige zoom-1 rijen zijn memcpy's daarvan. Geen allocaties; buiten de
+// bron wordt 'outside' ingevuld. grid=true: eerste rij/kolom van elke cel 25% donkerder.
+static inline uint32_t LoupeGridShade(uint32_t px) {
+    return (((px >> 1) & 0x007F7F7Fu) + ((px >> 2) & 0x003F3F3Fu)) | 0xFF000000u;
+}
+
+static void ZoomNearestInt(const uint8_t* src, int sw, int sh, size_t srcStride, int srcX0, int srcY0, int zoom,
+    uint8_t* dst, int dw, int dh, size_t dstStride, uint32_t outside, bool grid) {
+    if (zoom < 1 || dw <= 0 || dh <= 0) return;
+    const bool drawGrid = grid && zoom >= 4;
+
+    for (int dy = 0; dy < dh; dy += zoom) {
+        const int sy = srcY0 + dy / zoom;
+        uint32_t* row = (uint32_t*)(dst + (size_t)dy * dstStride);
+        const bool rowIn = (sy >= 0 && sy < sh);
+        const uint32_t* s = rowIn ? (const uint32_t*)(src + (size_t)sy * srcStride) : nullptr;
+
+        // 1 doelrij opbouwen
+        for (int dx = 0; dx < dw; dx += zoom) {
+            const int sx = srcX0 + dx / zoom;
+            const uint32_t px = (rowIn && sx >= 0 && sx < sw) ? (s[sx] | 0xFF000000u) : outside;
+            const int n = std::min(zoom, dw - dx);
+            uint32_t* d = row + dx;
+#if SNIP_HAS_SSE2
+            int k = 0;
+            const __m128i v = _mm_set1_epi32((int)px);
+            for (; k + 4 <= n; k += 4) _mm_storeu_si128((__m128i*)(d + k), v);
+            for (; k < n; ++k) d[k] = px;
+#else
+            for (int k = 0; k < n; ++k) d[k] = px;
+#endif
+            if (drawGrid) d[0] = LoupeGridShade(px);
+        }
+
+        // rest van de cel: kopie (grid: eerste rij van de cel donker)
+        const int rows = std::min(zoom, dh - dy);
+        for (int k = 1; k < rows; ++k) {
+            std::memcpy(dst + (size_t)(dy + k) * dstStride, row, (size_t)dw * 4);
+        }
+        if (drawGrid) {
+            for (int x = 0; x < dw; ++x) row[x] = LoupeGridShade(row[x]);
+        }
+    }
+}
+
+// =========================================================
+// Edge snapping: edge map + nearest-edge lookup (portable, geen Win32)
+// =========================================================
+// Eén gradient-pass over het desktop-frame (SSE2: 4 pixels per stap):
+// - horizontale randen (grens tussen rij y-1 en y), geteld per kolom-band
+// - verticale randen (grens tussen kolom x-1 en x), geteld per rij-band
+// Een grens is "sterk" als hij het grootste deel van de band overspant
+// (paneel-/knoprand). Per band staat voor elke positie de dichtstbijzijnde
+// sterke grens al klaar: lookup tijdens WM_MOUSEMOVE is O(1).
+static constexpr int kEdgeBand = 32;            // pixels per band (veelvoud van 4)
+static constexpr int kEdgeMinRun = 20;          // van de 32 pixels moeten randpixel zijn
+static constexpr int kEdgeThreshold = 24;       // max kanaalverschil
+
+struct EdgeMap {
+    int w = 0, h = 0;
+    int colBands = 0, rowBands = 0;
+    // nearestY[b * (h + 1) + y]: dichtstbijzijnde sterke horizontale grens in kolom-band b (-1 = geen)
+    std::vector<int32_t> nearestY;
+    // nearestX[b * (w + 1) + x]: idem voor verticale grenzen in rij-band b
+    std::vector<int32_t> nearestX;
+};
+
+// bit i (0..3): pixel i heeft een kanaalverschil > drempel (alpha genegeerd)
+static inline unsigned EdgeMask4(const uint8_t* a, const uint8_t* b) {
+#if SNIP_HAS_SSE2
+    const __m128i va = _mm_loadu_si128((const __m128i*)a);
+    const __m128i vb = _mm_loadu_si128((const __m128i*)b);
+    const __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+    const __m128i over = _mm_subs_epu8(diff, _mm_set1_epi8((char)kEdgeThreshold));
+    const unsigned zero = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(over, _mm_setzero_si128()));
+    const unsigned hit = ~zero & 0x7777u;     // B,G,R per pixel
+    return ((hit & 0x000Fu) ? 1u : 0u) | ((hit & 0x00F0u) ? 2u : 0u) | ((hit & 0x0F00u) ? 4u : 0u) | ((hit & 0xF000u) ? 8u : 0u);
+#else
+    unsigned m = 0;
+    for (int i = 0; i < 4; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            const int d = (int)a[i * 4 + c] - (int)b[i * 4 + c];
+            if (d > kEdgeThreshold || -d > kEdgeThreshold) { m |= 1u << i; break; }
+        }
+    }
+    return m;
+#endif
+}
+
+static inline int EdgePopcount4(unsigned m) {
+    return (int)((m & 1u) + ((m >> 1) & 1u) + ((m >> 2) & 1u) + ((m >> 3) & 1u));
+}
+
+// strong[0..n] (n+1 grenzen) -> per positie de dichtstbijzijnde sterke grens
+static void EdgeNearestPass(const uint8_t* strong, int n, int32_t* out) {
+    int last = -1;
+    for (int i = 0; i <= n; ++i) {
+        if (strong[i]) last = i;
+        out[i] = last;
+    }
+    int next = -1;
+    for (int i = n; i >= 0; --i) {
+        if (strong[i]) next = i;
+        if (next >= 0 && (out[i] < 0 || next - i < i - out[i])) out[i] = next;
+    }
+}
+
+// px: top-down BGRA. cancel (optioneel) wordt per rij gecontroleerd.
+static bool BuildEdgeMap(const uint8_t* px, int w, int h, size_t stride, EdgeMap& em, const std::atomic<bool>* cancel = nullptr) {
+    em = EdgeMap{};
+    if (!px || w < 8 || h < 8) return false;
+
+    const int w4 = w & ~3;                      // rest-kolommen (<4) doen niet mee
+    em.w = w;
+    em.h = h;
+    em.colBands = (w + kEdgeBand - 1) / kEdgeBand;
+    em.rowBands = (h + kEdgeBand - 1) / kEdgeBand;
+
+    // tellers: grens y per kolom-band, grens x per rij-band
+    std::vector<uint16_t> rowCount((size_t)em.colBands * (h + 1), 0);
+    std::vector<uint16_t> colCount((size_t)em.rowBands * (w + 1), 0);
+
+    for (int y = 0; y < h; ++y) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+
+        const uint8_t* row = px + (size_t)y * stride;
+        const uint8_t* up = (y > 0) ? row - stride : nullptr;
+        uint16_t* cc = colCount.data() + (size_t)(y / kEdgeBand) * (w + 1);
+
+        for (int x = 0; x < w4; x += 4) {
+            if (up) {
+                const unsigned mv = EdgeMask4(row + (size_t)x * 4, up + (size_t)x * 4);
+                rowCount[(size_t)(x / kEdgeBand) * (h + 1) + y] += (uint16_t)EdgePopcount4(mv);
+            }
+            if (x > 0) {
+                // pixel x..x+3 t.o.v. x-1..x+2
+                const unsigned mh = EdgeMask4(row + (size_t)x * 4, row + (size_t)x * 4 - 4);
+                cc[x] += (uint16_t)(mh & 1u);
+                cc[x + 1] += (uint16_t)((mh >> 1) & 1u);
+                cc[x + 2] += (uint16_t)((mh >> 2) & 1u);
+                cc[x + 3] += (uint16_t)((mh >> 3) & 1u);
+            }
+            else {
+                const unsigned mh = EdgeMask4(row + 4, row); // x = 1..4 t.o.v. 0..3
+                cc[1] += (uint16_t)(mh & 1u);
+                cc[2] += (uint16_t)((mh >> 1) & 1u);
+                cc[3] += (uint16_t)((mh >> 2) & 1u);
+            }
+        }
+    }
+
+    // sterke grenzen -> nearest-tabellen
+    std::vector<uint8_t> strong((size_t)std::max(w, h) + 1);
+
+    em.nearestY.resize((size_t)em.colBands * (h + 1));
+    for (int b = 0; b < em.colBands; ++b) {
+        const int bandW = std::min(kEdgeBand, w4 - b * kEdgeBand);
+        const int need = std::max(1, kEdgeMinRun * bandW / kEdgeBand);
+        const uint16_t* c = rowCount.data() + (size_t)b * (h + 1);
+        for (int y = 0; y <= h; ++y) strong[(size_t)y] = (bandW > 0 && c[y] >= need);
+        EdgeNearestPass(strong.data(), h, em.nearestY.data() + (size_t)b * (h + 1));
+    }
+
+    em.nearestX.resize((size_t)em.rowBands * (w + 1));
+    for (int b = 0; b < em.rowBands; ++b) {
+        const int bandH = std::min(kEdgeBand, h - b * kEdgeBand);
+        const int need = std::max(1, kEdgeMinRun * bandH / kEdgeBand);
+        const uint16_t* c = colCount.data() + (size_t)b * (w + 1);
+        for (int x = 0; x <= w; ++x) strong[(size_t)x] = (c[x] >= need);
+        EdgeNearestPass(strong.data(), w, em.nearestX.data() + (size_t)b * (w + 1));
+    }
+    return true;
+}
+
+// Dichtstbijzijnde sterke grens binnen radius (anders p zelf). O(1).
+static int EdgeSnapY(const EdgeMap& em, int x, int y, int radius) {
+    if (em.nearestY.empty() || x < 0 || x >= em.w || y < 0 || y > em.h) return y;
+    const int n = em.nearestY[(size_t)(x / kEdgeBand) * (em.h + 1) + y];
+    return (n >= 0 && std::abs(n - y) <= radius) ? n : y;
+}
+
+static int EdgeSnapX(const EdgeMap& em, int x, int y, int radius) {
+    if (em.nearestX.empty() || y < 0 || y >= em.h || x < 0 || x > em.w) return x;
+    const int n = em.nearestX[(size_t)(y / kEdgeBand) * (em.w + 1) + x];
+    return (n >= 0 && std::abs(n - x) <= radius) ? n : x;
+}
+
+#if !SNIP_CORE_ONLY
+// =========================================================
+// Overlay desktop cache (loupe + edge snapping)
+// =========================================================
+// Eén BitBlt van het virtuele scherm. Die kost bij 4K of meerdere monitoren tientallen
+// ms, dus niet op de hotkey-route: is de overlay uitgesloten van capture
+// (WDA_EXCLUDEFROMCAPTURE) dan grijpt een worker het scherm terwijl de overlay al
+// verschijnt, en meldt zich met WM_DESKTOP_CACHED. Anders (ouder Windows) synchroon
+// vlak voordat de overlay verschijnt, zoals vroeger.
+// Overlay-client coords = pixel-coords in deze buffer.
+struct DesktopCache {
+    RECT vr{};
+    int w = 0, h = 0;
+    HDC dc = nullptr;
+    HBITMAP dib = nullptr;          // top-down
+    HGDIOBJ old = nullptr;
+    uint8_t* bits = nullptr;
+};
+// g_desk alleen lezen na g_deskReady (acquire); blijft staan tot DesktopCacheRelease
+static DesktopCache g_desk;
+static std::thread g_deskWorker;
+static std::atomic<bool> g_deskReady{ false };
+static uint32_t g_deskGen = 0;      // verouderde WM_DESKTOP_CACHED herkennen
+
+static HBITMAP CreateTopDownDibDC(HDC ref, int w, int h, HDC& outDC, HGDIOBJ& outOld, uint8_t*& outBits) {
+    BITMAPINFO bmi{};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = w;
+    bmi.bmiHeader.biHeight = -h;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = nullptr;
+    HBITMAP dib = CreateDIBSection(ref, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    outDC = dib ? CreateCompatibleDC(ref) : nullptr;
+    if (!outDC || !bits) {
+        if (dib) DeleteObject(dib);
+        outDC = nullptr;
+        return nullptr;
+    }
+    outOld = SelectObject(outDC, dib);
+    outBits = (uint8_t*)bits;
+    return dib;
+}
+
+static void ReleaseDibDC(HDC& dc, HBITMAP& dib, HGDIOBJ& old, uint8_t*& bits) {
+    if (dc) {
+        SelectObject(dc, old);
+        DeleteDC(dc);
+    }
+    if (dib) DeleteObject(dib);
+    dc = nullptr;
+    dib = nullptr;
+    old = nullptr;
+    bits = nullptr;
+}
+
+static bool DesktopCacheReady() {
+    return g_deskReady.load(std::memory_order_acquire);
+}
+
+static void DesktopCacheRelease() {
+    if (g_deskWorker.joinable()) g_deskWorker.join();
+    g_deskReady = false;
+    ReleaseDibDC(g_desk.dc, g_desk.dib, g_desk.old, g_desk.bits);
+    g_desk = DesktopCache{};
+    ++g_deskGen;
+}
+
+// Elke thread; vult 'out' alleen bij succes.
+static bool DesktopCacheGrab(const RECT& vr, DesktopCache& out) {
+    const int w = vr.right - vr.left;
+    const int h = vr.bottom - vr.top;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    HDC hdcScreen = GetDC(nullptr);
+    if (!hdcScreen) return false;
+    DesktopCache d;
+    d.dib = CreateTopDownDibDC(hdcScreen, w, h, d.dc, d.old, d.bits);
+    const BOOL ok = d.dc && BitBlt(d.dc, 0, 0, w, h, hdcScreen, vr.left, vr.top, SRCCOPY | CAPTUREBLT);
+    ReleaseDC(nullptr, hdcScreen);
+    GdiFlush();
+    if (!ok) {
+        ReleaseDibDC(d.dc, d.dib, d.old, d.bits);
+        return false;
+    }
+    d.vr = vr;
+    d.w = w;
+    d.h = h;
+    out = d;
+    DebugLog(L"desktop %dx%d cached in %.2f ms", w, h, MsSince(t0));
+    return true;
+}
+
+// Synchroon (UI-thread): alleen als de overlay nog niet zichtbaar is.
+static bool DesktopCacheCapture(const RECT& vr) {
+    DesktopCacheRelease();
+    if (!DesktopCacheGrab(vr, g_desk)) return false;
+    g_deskReady.store(true, std::memory_order_release);
+    return true;
+}
+
+// Op een worker; de overlay moet uitgesloten zijn van capture (zie CreateOverlay).
+static void DesktopCacheStart(const RECT& vr) {
+    DesktopCacheRelease();
+    g_deskWorker = std::thread([vr, gen = g_deskGen] {
+        if (DesktopCacheGrab(vr, g_desk)) g_deskReady.store(true, std::memory_order_release);
+        if (g_hwndMsg) PostMessageW(g_hwndMsg, WM_DESKTOP_CACHED, gen, 0);
+    });
+}
+
+static bool OverlayExcludedFromCapture(HWND hwnd) {
+    DWORD affinity = 0;
+    return hwnd && GetWindowDisplayAffinity(hwnd, &affinity) && affinity == WDA_EXCLUDEFROMCAPTURE;
+}
+
+// =========================================================
+// Loupe (vergrootglas bij de cursor in de overlay)
+// =========================================================
+// Eigen klein topmost window (klik-door, niet activerend): de overlay heeft
+// window-brede alpha, dus daarin zou de loupe doorschijnen. Bron is g_desk;
+// per muisbeweging alleen de kernel naar een vooraf gemaakte DIB + BitBlt.
+// Pennen zijn ook gecachet.
+static constexpr int kLoupePx = 168;            // zoomgebied (vierkant)
+static constexpr int kLoupeInfoH = 18;          // tekstregel eronder
+static constexpr int kLoupeOffset = 24;         // afstand tot de cursor
+static constexpr int kLoupeZooms[] = { 4, 6, 8, 12, 16 };
+
+struct LoupeState {
+    HWND hwnd = nullptr;
+    // scratch tile (top-down, kLoupePx x kLoupePx + info)
+    HDC tileDC = nullptr;
+    HBITMAP tileDib = nullptr;
+    HGDIOBJ tileOld = nullptr;
+    uint8_t* tileBits = nullptr;
+    HPEN penFrame = nullptr;
+    HPEN penCenter = nullptr;
+    POINT pt{};                     // cursor in overlay-client coords
+    bool ptValid = false;
+    uint32_t frames = 0;
+    double kernelMsTotal = 0.0;
+};
+static LoupeState g_loupe;
+
+static void LoupeRender() {
+    const int w = g_desk.w;
+    const int h = g_desk.h;
+    const int zoom = g_loupeZoom;
+    const int span = kLoupePx / zoom;               // bronpixels per as
+    const int x0 = g_loupe.pt.x - span / 2;
+    const int y0 = g_loupe.pt.y - span / 2;
+    const size_t tileStride = (size_t)kLoupePx * 4;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    ZoomNearestInt(g_desk.bits, w, h, (size_t)w * 4, x0, y0, zoom,
+        g_loupe.tileBits, kLoupePx, kLoupePx, tileStride, 0xFF202020u, true);
+    g_loupe.kernelMsTotal += MsSince(t0);
+    g_loupe.frames++;
+
+    HDC dc = g_loupe.tileDC;
+
+    // info: kleur + schermcoördinaat van de pixel onder de cursor
+    RECT info{ 0, kLoupePx, kLoupePx, kLoupePx + kLoupeInfoH };
+    FillRect(dc, &info, (HBRUSH)GetStockObject(BLACK_BRUSH));
+    wchar_t txt[48]{};
+    if (g_loupe.pt.x >= 0 && g_loupe.pt.y >= 0 && g_loupe.pt.x < w && g_loupe.pt.y < h) {
+        const uint8_t* p = g_desk.bits + ((size_t)g_loupe.pt.y * w + g_loupe.pt.x) * 4;
+        swprintf_s(txt, L"#%02X%02X%02X  %d,%d", p[2], p[1], p[0],
+            g_desk.vr.left + g_loupe.pt.x, g_desk.vr.top + g_loupe.pt.y);
+    }
+    SetBkMode(dc, TRANSPARENT);
+    SetTextColor(dc, RGB(255, 255, 255));
+    DrawTextW(dc, txt, -1, &info, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+
+    // middelste cel + rand
+    HGDIOBJ oldPen = SelectObject(dc, g_loupe.penCenter);
+    HGDIOBJ oldBrush = SelectObject(dc, GetStockObject(NULL_BRUSH));
+    const int cx = (g_loupe.pt.x - x0) * zoom;
+    const int cy = (g_loupe.pt.y - y0) * zoom;
+    Rectangle(dc, cx - 1, cy - 1, cx + zoom + 1, cy + zoom + 1);
+    SelectObject(dc, g_loupe.penFrame);
+    Rectangle(dc, 0, 0, kLoupePx, kLoupePx + kLoupeInfoH);
+    SelectObject(dc, oldBrush);
+    SelectObject(dc, oldPen);
+}
+
+static LRESULT CALLBACK LoupeProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_NCHITTEST:
+        return HTTRANSPARENT;
+
+    case WM_ERASEBKGND:
+        return 1;
+
+    case WM_PAINT: {
+        PAINTSTRUCT ps{};
+        HDC hdc = BeginPaint(hwnd, &ps);
+        if (g_loupe.ptValid && g_loupe.tileDC && DesktopCacheReady()) {
+            LoupeRender();
+            BitBlt(hdc, 0, 0, kLoupePx, kLoupePx + kLoupeInfoH, g_loupe.tileDC, 0, 0, SRCCOPY);
+        }
+        EndPaint(hwnd, &ps);
+        return 0;
+    }
+    }
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+static bool LoupeWanted() {
+    return g_loupeEnabled && (IsRectSelectMode(g_mode) || g_mode == Mode::Polygon || g_mode == Mode::Freestyle);
+}
+
+static void LoupeDestroy() {
+    if (g_loupe.frames) {
+        DebugLog(L"loupe: %u frames, kernel avg %.1f us", g_loupe.frames, 1000.0 * g_loupe.kernelMsTotal / g_loupe.frames);
+    }
+    if (g_loupe.hwnd) DestroyWindow(g_loupe.hwnd);
+    g_loupe.hwnd = nullptr;
+    ReleaseDibDC(g_loupe.tileDC, g_loupe.tileDib, g_loupe.tileOld, g_loupe.tileBits);
+    if (g_loupe.penFrame) DeleteObject(g_loupe.penFrame);
+    if (g_loupe.penCenter) DeleteObject(g_loupe.penCenter);
+    g_loupe = LoupeState{};
+}
+
+// Vóór de overlay (dan ligt de loupe erboven); tot de desktop-cache klaar is blijft
+// de loupe verborgen.
+static void LoupeCreate() {
+    LoupeDestroy();
+
+    static bool registered = false;
+    if (!registered) {
+        WNDCLASSW wc{};
+        wc.lpfnWndProc = LoupeProc;
+        wc.hInstance = g_hInst;
+        wc.lpszClassName = L"SnipLiteLoupe";
+        RegisterClassW(&wc);
+        registered = true;
+    }
+
+    HDC hdcScreen = GetDC(nullptr);
+    if (!hdcScreen) return;
+    g_loupe.tileDib = CreateTopDownDibDC(hdcScreen, kLoupePx, kLoupePx + kLoupeInfoH, g_loupe.tileDC, g_loupe.tileOld, g_loupe.tileBits);
+    ReleaseDC(nullptr, hdcScreen);
+    if (!g_loupe.tileDC) { LoupeDestroy(); return; }
+
+    g_loupe.penFrame = CreatePen(PS_SOLID, 1, RGB(255, 255, 255));
+    g_loupe.penCenter = CreatePen(PS_SOLID, 2, RGB(255, 64, 64));
+
+    g_loupe.hwnd = CreateWindowExW(
+        WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE | WS_EX_LAYERED | WS_EX_TRANSPARENT,
+        L"SnipLiteLoupe", L"", WS_POPUP,
+        0, 0, kLoupePx, kLoupePx + kLoupeInfoH,
+        nullptr, nullptr, g_hInst, nullptr);
+    if (!g_loupe.hwnd) { LoupeDestroy(); return; }
+    SetLayeredWindowAttributes(g_loupe.hwnd, 0, (BYTE)255, LWA_ALPHA);
+}
+
+// Overlay-client coords; verplaatst het window en invalideert alleen de loupe zelf.
+static void LoupeMove(POINT clientPt) {
+    if (!g_loupe.hwnd) return;
+    if (!LoupeWanted() || !DesktopCacheReady()) {
+        if (IsWindowVisible(g_loupe.hwnd)) ShowWindow(g_loupe.hwnd, SW_HIDE);
+        return;
+    }
+
+    g_loupe.pt = clientPt;
+    g_loupe.ptValid = true;
+
+    // rechtsonder van de cursor; bij de rand van het virtuele scherm omklappen
+    const int lw = kLoupePx, lh = kLoupePx + kLoupeInfoH;
+    int x = g_desk.vr.left + clientPt.x + kLoupeOffset;
+    int y = g_desk.vr.top + clientPt.y + kLoupeOffset;
+    if (x + lw > g_desk.vr.right) x = g_desk.vr.left + clientPt.x - kLoupeOffset - lw;
+    if (y + lh > g_desk.vr.bottom) y = g_desk.vr.top + clientPt.y - kLoupeOffset - lh;
+
+    SetWindowPos(g_loupe.hwnd, HWND_TOPMOST, x, y, 0, 0, SWP_NOSIZE | SWP_NOACTIVATE | SWP_SHOWWINDOW);
+    InvalidateRect(g_loupe.hwnd, nullptr, FALSE);
+}
+
+static void LoupeHide() {
+    if (g_loupe.hwnd) ShowWindow(g_loupe.hwnd, SW_HIDE);
+}
+
+// =========================================================
+// Edge snapping (Region-rubberband)
+// =========================================================
+// Edge map wordt per overlay-sessie op een worker gebouwd uit g_desk; tot hij
+// klaar is wordt er simpelweg niet gesnapt. Alt ingedrukt = tijdelijk uit.
+static constexpr int kSnapRadius = 8;
+
+struct SnapState {
+    std::thread worker;
+    std::atomic<bool> cancel{ false };
+    std::atomic<bool> ready{ false };
+    EdgeMap map;                    // alleen lezen na ready
+};
+static SnapState g_snap;
+
+static void SnapStop() {
+    g_snap.cancel = true;
+    if (g_snap.worker.joinable()) g_snap.worker.join();
+    g_snap.ready = false;
+    g_snap.map = EdgeMap{};
+}
+
+// Zodra de desktop-cache klaar is; g_desk blijft bestaan tot SnapStop() (DestroyOverlay).
+static void SnapStartBuild() {
+    SnapStop();
+    if (!DesktopCacheReady()) return;
+
+    g_snap.cancel = false;
+    g_snap.worker = std::thread([] {
+        const auto t0 = std::chrono::steady_clock::now();
+        if (BuildEdgeMap(g_desk.bits, g_desk.w, g_desk.h, (size_t)g_desk.w * 4, g_snap.map, &g_snap.cancel)) {
+            g_snap.ready.store(true, std::memory_order_release);
+            DebugLog(L"edge map %dx%d: %.2f ms", g_desk.w, g_desk.h, MsSince(t0));
+        }
+    });
+}
+
+// Overlay-client coords.
+static POINT EdgeSnapPoint(POINT p) {
+    if (!g_snapEnabled || !g_snap.ready.load(std::memory_order_acquire)) return p;
+    if (GetKeyState(VK_MENU) & 0x8000) return p;
+    return POINT{ EdgeSnapX(g_snap.map, p.x, p.y, kSnapRadius), EdgeSnapY(g_snap.map, p.x, p.y, kSnapRadius) };
+}
+
+// Loupe of snapping pas tijdens de overlay aangezet: desktop alsnog (op de worker) grijpen.
+static void OverlayDesktopWanted() {
+    if (!g_hwndOverlay || DesktopCacheReady() || g_deskWorker.joinable()) return;
+    if (!OverlayExcludedFromCapture(g_hwndOverlay)) return;   // zou de overlay zelf grijpen
+    RECT wr{};
+    GetWindowRect(g_hwndOverlay, &wr);
+    DesktopCacheStart(wr);
+}
+
+// WM_DESKTOP_CACHED: edge map bouwen en de loupe tonen op de huidige cursorplek.
+static void OverlayDesktopCached(uint32_t gen) {
+    if (gen != g_deskGen || !g_hwndOverlay || !DesktopCacheReady()) return;
+    if (g_snapEnabled && !g_snap.ready && !g_snap.worker.joinable()) SnapStartBuild();
+    if (g_loupeEnabled && g_cursorValid) LoupeMove(g_cursorPt);
+}
+
+// =========================================================
+// Overlay
+// =========================================================
+static RECT CursorDirtyRect(POINT p) {
+    const int L = 14;     // lengte van crosshair
+    const int pad = 6;    // extra marge voor dikke lijn
+    RECT rc{ p.x - L - pad, p.y - L - pad, p.x + L + pad + 1, p.y + L + pad + 1 };
+    return rc;
+}
+
+static void DrawOutlinedCrosshair(HDC hdc, int x, int y)
+{
+    const int L = 14;
+
+    // pennen eenmalig maken (elke muisbeweging tekent dit opnieuw)
+    static HPEN penB = CreatePen(PS_SOLID, 3, RGB(0, 0, 0));       // zwarte "rand" (dikker)
+    static HPEN penW = CreatePen(PS_SOLID, 1, RGB(255, 255, 255)); // witte kern (dun)
+
+    HGDIOBJ oldPen = SelectObject(hdc, penB);
+
+    MoveToEx(hdc, x - L, y, nullptr); LineTo(hdc, x + L + 1, y);
+    MoveToEx(hdc, x, y - L, nullptr); LineTo(hdc, x, y + L + 1);
+
+    SelectObject(hdc, penW);
+
+    MoveToEx(hdc, x - L, y, nullptr); LineTo(hdc, x + L + 1, y);
+    MoveToEx(hdc, x, y - L, nullptr); LineTo(hdc, x, y + L + 1);
+
+    // klein centrum-puntje (extra zichtbaar)
+    SetPixel(hdc, x, y, RGB(255, 255, 255));
+
+    SelectObject(hdc, oldPen);
+}
+
+static void LassoReset() {
+    g_lassoSelecting = false;
+    g_lassoPtsClient.clear();
+    ZeroMemory(&g_lassoBoundsClient, sizeof(g_lassoBoundsClient));
+}
+static bool IsShiftDown() {
+    return (GetKeyState(VK_SHIFT) & 0x8000) != 0;
+}
+
+static bool NearPoint(POINT a, POINT b, int rPx) {
+    int dx = a.x - b.x;
+    int dy = a.y - b.y;
+    return (dx * dx + dy * dy) <= (rPx * rPx);
+}
+
+static POINT SnapPoint45(POINT origin, POINT raw) {
+    const double dx = (double)raw.x - (double)origin.x;
+    const double dy = (double)raw.y - (double)origin.y;
+
+    const double len = std::sqrt(dx * dx + dy * dy);
+    if (len < 1.0) return raw;
+
+    const double ang = std::atan2(dy, dx);
+    const double PI = 3.14159265358979323846;
+    const double step = PI / 4.0; // 45 graden
+
+    const double snapped = std::round(ang / step) * step;
+
+    const double nx = std::cos(snapped) * len;
+    const double ny = std::sin(snapped) * len;
+
+    POINT out{
+        origin.x + (int)std::lround(nx),
+        origin.y + (int)std::lround(ny)
+    };
+    return out;
+}
+
+static void PolyReset() {
+    g_polySelecting = false;
+    g_polyPtsClient.clear();
+    ZeroMemory(&g_polyBoundsClient, sizeof(g_polyBoundsClient));
+    g_polyHoverValid = false;
+    g_polyHoverClient = { 0,0 };
+}
+
+static void PolyRecalcBounds() {
+    if (g_polyPtsClient.empty()) {
+        ZeroMemory(&g_polyBoundsClient, sizeof(g_polyBoundsClient));
+        return;
+    }
+    int minx = g_polyPtsClient[0].x, maxx = g_polyPtsClient[0].x;
+    int miny = g_polyPtsClient[0].y, maxy = g_polyPtsClient[0].y;
+
+    for (auto p : g_polyPtsClient) {
+        if (p.x < minx) minx = p.x;
+        if (p.x > maxx) maxx = p.x;
+        if (p.y < miny) miny = p.y;
+        if (p.y > maxy) maxy = p.y;
+    }
+    g_polyBoundsClient = { minx, miny, maxx + 1, maxy + 1 };
+}
+
+static void PolyAddPoint(POINT p) {
+    if (!g_polyPtsClient.empty()) {
+        POINT last = g_polyPtsClient.back();
+        if (last.x == p.x && last.y == p.y) return;
+    }
+    g_polyPtsClient.push_back(p);
+
+    if (g_polyPtsClient.size() == 1) {
+        g_polyBoundsClient = { p.x, p.y, p.x + 1, p.y + 1 };
+    }
+    else {
+        if (p.x < g_polyBoundsClient.left) g_polyBoundsClient.left = p.x;
+        if (p.y < g_polyBoundsClient.top) g_polyBoundsClient.top = p.y;
+        if (p.x + 1 > g_polyBoundsClient.right) g_polyBoundsClient.right = p.x + 1;
+        if (p.y + 1 > g_polyBoundsClient.bottom) g_polyBoundsClient.bottom = p.y + 1;
+    }
+}
+
+static void PolyUndoLast() {
+    if (g_polyPtsClient.empty()) return;
+    g_polyPtsClient.pop_back();
+    if (g_polyPtsClient.empty()) {
+        PolyReset();
+        return;
+    }
+    PolyRecalcBounds();
+}
+
+static void DestroyOverlay() {
+    LoupeDestroy();
+    SnapStop();
+    DesktopCacheRelease();
+    LassoReset();
+	PolyReset();
+    g_selecting = false;
+    g_hasSelection = false;
+    ZeroMemory(&g_selRectClient, sizeof(g_selRectClient));
+	ClearHover();
+
+    if (g_hwndOverlay) {
+        // verborgen bewaren als reserve: de volgende hotkey hoeft niets aan te maken
+        if (GetCapture() == g_hwndOverlay) ReleaseCapture();
+        if (!g_hwndOverlaySpare) {
+            ShowWindow(g_hwndOverlay, SW_HIDE);
+            g_hwndOverlaySpare = g_hwndOverlay;
+        }
+        else DestroyWindow(g_hwndOverlay);
+        g_hwndOverlay = nullptr;
+    }
+    SessionsShowLater();
+}
+
+#endif // !SNIP_CORE_ONLY
+
+// =========================================================
+// Window-capture: bron kiezen (portable, geen Win32)
+// =========================================================
+// Window-mode wil de inhoud van het venster zelf, ook als er iets overheen ligt.
+// Eerst tekent het venster zichzelf in een bitmap (Render: occlusion-vrij, er
+// verschuift niets op het scherm); alleen als dat niet kan of niets bruikbaars
+// oplevert de oude weg: naar voren halen en van het scherm grabben (Screen).
+// Een bron levert:
+//   bool Renderable()              kan het venster zichzelf tekenen (niet geminimaliseerd)
+//   bool Render(WindowPixels& out) hele venster op WindowRect-maten, top-down BGRA
+//   PixRect WindowRect()           schermcoördinaten van wat Render tekent
+//   PixRect FrameRect()            schermcoördinaten van wat we willen (zonder schaduw)
+//   bool Screen()                  fallback mogelijk? (grabt zelf, of laat het aan de
+//                                  capture-sequencer over zoals de Win32-bron)
+// Win32WindowSource doet het echt, SyntheticWindowSource speelt het na zonder vensters.
+enum class WindowCaptureVia { Render, Screen, Failed };
+
+struct WindowPixels {
+    const uint8_t* top = nullptr;
+    ptrdiff_t stride = 0;
+    int w = 0, h = 0;
+};
+
+struct WindowCaptureResult {
+    WindowCaptureVia via = WindowCaptureVia::Failed;
+    WindowPixels px;   // alleen bij Render
+    PixRect crop;      // het frame binnen px
+};
+
+// Helemaal zwart (alpha telt niet mee): het renderen is "gelukt" zonder dat er iets
+// getekend is (beschermde of hardware-content die niet meedoet).
+static bool WindowPixelsBlank(const WindowPixels& px, const PixRect& r) {
+    const int n = r.Width();
+    for (int y = r.y0; y < r.y1; ++y) {
+        const uint8_t* row = px.top + (ptrdiff_t)y * px.stride + (ptrdiff_t)r.x0 * 4;
+        int x = 0;
+#if SNIP_HAS_SSE2
+        const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+        for (; x + 4 <= n; x += 4) {
+            const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + (size_t)x * 4)), rgb);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, _mm_setzero_si128())) != 0xFFFF) return false;
+        }
+#endif
+        for (; x < n; ++x) {
+            if (row[x * 4] | row[x * 4 + 1] | row[x * 4 + 2]) return false;
+        }
+    }
+    return true;
+}
+
+// Frame (scherm) -> rechthoek in de render van window; leeg als het frame er niet
+// helemaal in valt (venster intussen verkleind of verschoven).
+static PixRect WindowCaptureCrop(const PixRect& window, const PixRect& frame, int pxW, int pxH) {
+    const PixRect r{ frame.x0 - window.x0, frame.y0 - window.y0, frame.x1 - window.x0, frame.y1 - window.y0 };
+    const PixRect c = PixRectIntersect(r, PixRect{ 0, 0, pxW, pxH });
+    if (c.Width() != frame.Width() || c.Height() != frame.Height()) return PixRect{};
+    return c;
+}
+
+template <class Source>
+static WindowCaptureResult WindowCaptureSelect(Source& src) {
+    WindowCaptureResult r;
+    if (src.Renderable() && src.Render(r.px)) {
+        r.crop = WindowCaptureCrop(src.WindowRect(), src.FrameRect(), r.px.w, r.px.h);
+        if (!r.crop.Empty() && !WindowPixelsBlank(r.px, r.crop)) {
+            r.via = WindowCaptureVia::Render;
+            return r;
+        }
+    }
+    r.px = WindowPixels{};
+    r.crop = PixRect{};
+    r.via = src.Screen() ? WindowCaptureVia::Screen : WindowCaptureVia::Failed;
+    return r;
+}
+
+// Nagespeeld venster: patroon (of zwart) op WindowRect-maten, telt renders en fallbacks.
+struct SyntheticWindowSource {
+    PixRect window, frame;
+    bool renderable = true;    // false = "geminimaliseerd"
+    bool renderOk = true;      // false = renderen mislukt
+    bool renderBlack = false;  // true = gelukt, maar niets getekend
+    bool screenOk = true;
+    int renders = 0, screens = 0;
+    std::vector<uint8_t> pixels;
+
+    bool Renderable() const { return renderable; }
+    PixRect WindowRect() const { return window; }
+    PixRect FrameRect() const { return frame; }
+
+    bool Render(WindowPixels& out) {
+        ++renders;
+        if (!renderOk || window.Empty()) return false;
+        const int w = window.Width(), h = window.Height();
+        pixels.assign((size_t)w * h * 4, 0);
+        if (!renderBlack) {
+            for (int y = 0; y < h; ++y) {
+                for (int x = 0; x < w; ++x) {
+                    uint8_t* p = pixels.data() + ((size_t)y * w + x) * 4;
+                    p[0] = (uint8_t)(x * 7 + y);
+                    p[1] = (uint8_t)(y * 3);
+                    p[2] = (uint8_t)(x ^ y);
+                    p[3] = 255;
+                }
+            }
+        }
+        out = WindowPixels{ pixels.data(), (ptrdiff_t)w * 4, w, h };
+        return true;
+    }
+
+    bool Screen() {
+        ++screens;
+        return screenOk;
+    }
+};
+
+// =========================================================
+// Capture-sequencer (portable, geen Win32)
+// =========================================================
+// Verbergen -> wachten tot DWM een frame zonder overlay heeft gecomponeerd -> grabben
+// -> nabewerken (worker) -> preview. De UI-thread blokkeert nergens: elke stap komt
+// binnen als bericht (compositie klaar, timer, worker klaar) en zet de machine één
+// stap verder. Tijden in ms op een monotone klok (UI: steady_clock, tests: nep-klok).
+// Een CaptureSeqOut zegt wat de aanroeper nu moet doen; gen filtert late meldingen
+// van een afgebroken capture.
+struct CaptureSeqConfig {
+    int flushes = 1;           // composities afwachten na verbergen/raisen (0 = meteen grabben)
+    double settleMs = 20;      // geen DWM (compositie uit): zo lang wachten, als de oude Sleep
+    double timeoutMs = 250;    // DWM meldt niets: dan toch grabben
+    bool postProcess = false;  // na de grab nog een worker-stap
+};
+
+enum class CaptureSeqState { Idle, Composing, Settling, Grabbing, Processing };
+
+struct CaptureSeqOut {
+    bool hide = false;              // overlay/previews weg (en eventueel venster naar voren)
+    bool waitComposition = false;   // één compositie afwachten, dan CaptureSeqComposed
+    double timerMs = -1;            // >= 0: timer (opnieuw) zetten
+    bool killTimer = false;
+    bool grab = false;              // nu grabben, dan CaptureSeqGrabbed
+    bool postProcess = false;       // worker starten, dan CaptureSeqProcessed
+    bool finish = false;            // klaar: preview openen
+    bool fail = false;              // mislukt: overlay terug + beep
+};
+
+struct CaptureSequencer {
+    CaptureSeqState state = CaptureSeqState::Idle;
+    CaptureSeqConfig cfg;
+    uint32_t gen = 0;
+    int flushesSeen = 0;
+    bool timedOut = false;     // gegrabd op de deadline, zonder compositie-melding
+    double startMs = 0;
+    double deadlineMs = 0;
+    double waitedMs = 0;       // start -> grab
+};
+
+static bool CaptureSeqBusy(const CaptureSequencer& s) {
+    return s.state != CaptureSeqState::Idle;
+}
+
+static CaptureSeqOut CaptureSeqGoGrab(CaptureSequencer& s, double now) {
+    CaptureSeqOut o;
+    s.state = CaptureSeqState::Grabbing;
+    s.waitedMs = now - s.startMs;
+    o.killTimer = true;
+    o.grab = true;
+    return o;
+}
+
+static CaptureSeqOut CaptureSeqStart(CaptureSequencer& s, const CaptureSeqConfig& cfg, double now) {
+    ++s.gen;
+    s.cfg = cfg;
+    s.flushesSeen = 0;
+    s.timedOut = false;
+    s.startMs = now;
+    if (cfg.flushes <= 0) {
+        CaptureSeqOut o = CaptureSeqGoGrab(s, now);
+        o.hide = true;
+        return o;
+    }
+    s.state = CaptureSeqState::Composing;
+    s.deadlineMs = now + cfg.timeoutMs;
+    CaptureSeqOut o;
+    o.hide = true;
+    o.waitComposition = true;
+    o.timerMs = cfg.timeoutMs;
+    return o;
+}
+
+// ok = false: compositie staat uit (DwmFlush faalt) -> vaste wachttijd vanaf het verbergen.
+static CaptureSeqOut CaptureSeqComposed(CaptureSequencer& s, uint32_t gen, bool ok, double now) {
+    CaptureSeqOut o;
+    if (gen != s.gen || s.state != CaptureSeqState::Composing) return o;
+    if (!ok) {
+        s.state = CaptureSeqState::Settling;
+        s.deadlineMs = s.startMs + s.cfg.settleMs;
+        if (now >= s.deadlineMs) return CaptureSeqGoGrab(s, now);
+        o.timerMs = s.deadlineMs - now;
+        return o;
+    }
+    if (++s.flushesSeen < s.cfg.flushes) {
+        o.waitComposition = true;
+        return o;
+    }
+    return CaptureSeqGoGrab(s, now);
+}
+
+static CaptureSeqOut CaptureSeqTimer(CaptureSequencer& s, double now) {
+    CaptureSeqOut o;
+    if (s.state != CaptureSeqState::Composing && s.state != CaptureSeqState::Settling) {
+        o.killTimer = true;
+        return o;
+    }
+    if (now < s.deadlineMs) {   // timer ging te vroeg af: rest opnieuw zetten
+        o.timerMs = s.deadlineMs - now;
+        return o;
+    }
+    s.timedOut = s.state == CaptureSeqState::Composing;
+    return CaptureSeqGoGrab(s, now);
+}
+
+static CaptureSeqOut CaptureSeqGrabbed(CaptureSequencer& s, bool ok) {
+    CaptureSeqOut o;
+    if (s.state != CaptureSeqState::Grabbing) return o;
+    if (ok && s.cfg.postProcess) {
+        s.state = CaptureSeqState::Processing;
+        o.postProcess = true;
+        return o;
+    }
+    s.state = CaptureSeqState::Idle;
+    if (ok) o.finish = true;
+    else o.fail = true;
+    return o;
+}
+
+static CaptureSeqOut CaptureSeqProcessed(CaptureSequencer& s, uint32_t gen, bool ok) {
+    CaptureSeqOut o;
+    if (gen != s.gen || s.state != CaptureSeqState::Processing) return o;
+    s.state = CaptureSeqState::Idle;
+    if (ok) o.finish = true;
+    else o.fail = true;
+    return o;
+}
+
+static CaptureSeqOut CaptureSeqCancel(CaptureSequencer& s) {
+    CaptureSeqOut o;
+    if (s.state == CaptureSeqState::Idle) return o;
+    ++s.gen;
+    s.state = CaptureSeqState::Idle;
+    o.killTimer = true;
+    return o;
+}
+
+#if !SNIP_CORE_ONLY
+// =========================================================
+// Window-capture (Win32: venster naar voren, PrintWindow of schermkopie)
+// =========================================================
+static void BringWindowToFrontForCapture(HWND h) {
+    if (!h) return;
+
+    // pak root window
+    h = GetAncestor(h, GA_ROOT);
+    if (!h) return;
+
+    // als geminimaliseerd -> herstellen
+    if (IsIconic(h)) ShowWindow(h, SW_RESTORE);
+
+    // naar top in z-order (boven normale windows)
+    SetWindowPos(h, HWND_TOP, 0, 0, 0, 0,
+        SWP_NOMOVE | SWP_NOSIZE | SWP_NOOWNERZORDER | SWP_SHOWWINDOW);
+
+    // activeer (meestal toegestaan omdat jij net klikte in jouw overlay)
+    SetForegroundWindow(h);
+    // repaint afwachten doet de capture-sequencer (kCaptureRaiseFlushes composities)
+}
+
+static PixRect PixRectFromRect(const RECT& r) {
+    return PixRect{ (int)r.left, (int)r.top, (int)r.right, (int)r.bottom };
+}
+
+// Echte bron: PrintWindow(PW_RENDERFULLCONTENT) in een top-down DIB (DWM tekent ook
+// DirectX/browser-inhoud mee). De fallback (overlay weg, naar voren, BitBlt) loopt
+// asynchroon via de capture-sequencer; Screen() zegt alleen dat die kan.
+struct Win32WindowSource {
+    HWND hwnd = nullptr;
+    RECT window{};       // GetWindowRect: maat van de render
+    RECT frame{};        // extended frame bounds, niet geclipt (render kent geen schermrand)
+    HBITMAP renderBmp = nullptr;
+
+    ~Win32WindowSource() {
+        if (renderBmp) DeleteObject(renderBmp);
+    }
+
+    bool Renderable() const { return IsWindowVisible(hwnd) && !IsIconic(hwnd); }
+    PixRect WindowRect() const { return PixRectFromRect(window); }
+    PixRect FrameRect() const { return PixRectFromRect(frame); }
+
+    bool Render(WindowPixels& out) {
+        const int w = window.right - window.left;
+        const int h = window.bottom - window.top;
+        if (w <= 0 || h <= 0) return false;
+
+        BITMAPINFO bmi{};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = w;
+        bmi.bmiHeader.biHeight = -h;     // top-down
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+
+        HDC hdcScreen = GetDC(nullptr);
+        void* bits = nullptr;
+        renderBmp = CreateDIBSection(hdcScreen, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+        HDC hdcMem = renderBmp ? CreateCompatibleDC(hdcScreen) : nullptr;
+        ReleaseDC(nullptr, hdcScreen);
+        if (!hdcMem || !bits) return false;
+
+        HGDIOBJ old = SelectObject(hdcMem, renderBmp);
+        const BOOL ok = PrintWindow(hwnd, hdcMem, PW_RENDERFULLCONTENT);
+        SelectObject(hdcMem, old);
+        DeleteDC(hdcMem);
+        GdiFlush();
+        if (!ok) return false;
+
+        out = WindowPixels{ (const uint8_t*)bits, (ptrdiff_t)w * 4, w, h };
+        return true;
+    }
+
+    bool Screen() const { return hwnd != nullptr; }
+};
+
+// Window-mode: het venster tekent zichzelf terwijl de overlay nog staat; geen
+// z-order/focus-wijziging en geen wachttijd. Render: outBmp gevuld, outRect = wat er
+// werkelijk in zit. Screen: de sequencer moet het venster naar voren halen en grabben.
+static WindowCaptureVia CaptureWindowRender(HWND target, const RECT& sr,
+    HBITMAP& outBmp, int& outW, int& outH, RECT& outRect) {
+    const auto t0 = std::chrono::steady_clock::now();
+
+    Win32WindowSource src;
+    src.hwnd = GetAncestor(target, GA_ROOT);
+    if (!src.hwnd) src.hwnd = target;
+    if (!GetWindowRect(src.hwnd, &src.window)) src.window = sr;
+    if (!GetWindowRectSafe(src.hwnd, src.frame)) src.frame = sr;
+
+    WindowCaptureResult r = WindowCaptureSelect(src);
+    if (r.via == WindowCaptureVia::Render) {
+        const uint8_t* top = r.px.top + (ptrdiff_t)r.crop.y0 * r.px.stride + (ptrdiff_t)r.crop.x0 * 4;
+        outBmp = CreateDibFromPixels(top, r.crop.Width(), r.crop.Height(), (size_t)r.px.stride, true);
+        if (outBmp) {
+            outW = r.crop.Width();
+            outH = r.crop.Height();
+            outRect = src.frame;
+        }
+        else r.via = WindowCaptureVia::Screen;
+    }
+    DebugLog(L"window capture: %s in %.1f ms",
+        r.via == WindowCaptureVia::Render ? L"rendered" : r.via == WindowCaptureVia::Screen ? L"screen fallback" : L"failed",
+        MsSince(t0));
+    return r.via;
+}
+
+// =========================================================
+// Capture-sequencer (Win32: overlay, DwmFlush-worker, nabewerking)
+// =========================================================
+// Eén capture tegelijk. De compositie-wacht is een DwmFlush op een worker (meldt zich
+// met WM_CAPTURE_COMPOSED), de nabewerking (rijband-pipeline) en de hash gaan naar
+// een tweede worker (WM_CAPTURE_PROCESSED); de UI-thread doet alleen grabben en het
+// clipboard zetten.
+static constexpr int kCaptureRaiseFlushes = 3;      // naar voren gehaald venster: eerst laten repainten
+static constexpr double kCaptureRaiseSettleMs = 80;
+
+enum class CaptureKind { Rect, Window, Masked, Burst, Record, Scroll, Pipe };
+
+struct PipeJob;
+static void PipeCaptureDone(const std::shared_ptr<PipeJob>& job, bool grabbed, CaptureSession* ses);
+
+struct CaptureJob {                 // UI -> worker -> UI (WM_CAPTURE_PROCESSED, lParam)
+    uint32_t gen = 0;
+    HBITMAP bmp = nullptr;          // de capture; tijdens de job van de worker
+    bool hasAlpha = false;
+    std::vector<POINT> mask;        // Masked: client-coördinaten van de overlay
+    RECT maskBounds{};
+    int smooth = 0;                 // Chaikin-iteraties (lasso)
+    int feather = 0;
+    int scaleW = 0, scaleH = 0;     // output-schaling; 0 = niet schalen
+    bool opaque = false;            // alpha op 255 (BitBlt-grab)
+    bool ok = false;
+    int w = 0, h = 0;               // uiteindelijke maat
+    HGLOBAL clip = nullptr;         // CF_DIB / CF_DIBV5, klaar om te zetten
+    HBITMAP clipBmp = nullptr;      // extra CF_BITMAP
+    uint64_t hash = 0;
+    bool hashValid = false;
+    double ms = 0;
+};
+
+static void CaptureJobFree(CaptureJob* job) {
+    if (job->bmp) DeleteObject(job->bmp);
+    if (job->clip) GlobalFree(job->clip);
+    if (job->clipBmp) DeleteObject(job->clipBmp);
+    delete job;
+}
+
+// Alles na de grab in één rijband-pipeline: alpha/masker, feather en schalen, met de
+// clipboard-DIB en de CF_BITMAP-kopie als sinks. Resultaat in job->bmp en job->w/h.
+static bool CaptureJobPipeline(CaptureJob* job) {
+    uint8_t* top = nullptr; ptrdiff_t stride = 0; int w = 0, h = 0;
+    if (!DibTopDownView(job->bmp, top, stride, w, h)) return false;
+
+    BandPipeline p{ w, h, {}, {} };
+    if (!job->mask.empty()) {
+        if (job->smooth > 0) job->mask = LassoSmoothClosed_Chaikin(std::move(job->mask), job->smooth);
+        std::vector<PixPoint> poly;
+        poly.reserve(job->mask.size());
+        for (POINT pt : job->mask) poly.push_back({ (int)(pt.x - job->maskBounds.left), (int)(pt.y - job->maskBounds.top) });
+        if (!BandAddMask(p, std::move(poly))) return false;
+    }
+    else if (job->opaque) BandAddOpaque(p);
+    BandAddFeather(p, job->feather);
+    if (job->scaleW > 0 && !BandAddScale(p, job->scaleW, job->scaleH, job->hasAlpha)) {
+        DebugLog(L"output scale: failed, keeping %dx%d", w, h);
+    }
+    const int ow = p.OutW(), oh = p.OutH();
+
+    // alleen alpha/masker: in-place, anders naar een nieuwe DIB
+    HBITMAP out = job->bmp;
+    uint8_t* dTop = top; ptrdiff_t dStride = stride;
+    if (!BandPipelineInPlace(p)) {
+        void* bits = nullptr;
+        int dw = 0, dh = 0;
+        out = CreateDib32(ow, oh, bits);
+        if (!out || !DibTopDownView(out, dTop, dStride, dw, dh)) {
+            if (out) DeleteObject(out);
+            return false;
+        }
+    }
+    uint8_t* clipBits = nullptr;
+    job->clip = ClipboardDibAlloc(ow, oh, job->hasAlpha, clipBits);
+    if (job->clip) p.sinks.push_back(BandCopySink(clipBits + (ptrdiff_t)(oh - 1) * ow * 4, -(ptrdiff_t)ow * 4));
+    void* copyBits = nullptr;
+    job->clipBmp = CreateDib32(ow, oh, copyBits);
+    if (job->clipBmp) p.sinks.push_back(BandCopySink((uint8_t*)copyBits + (ptrdiff_t)(oh - 1) * ow * 4, -(ptrdiff_t)ow * 4));
+
+    GdiFlush();
+    const auto t0 = std::chrono::steady_clock::now();
+    const int bands = BandPipelineRun(p, top, stride, dTop, dStride);
+    if (job->clip) GlobalUnlock(job->clip);
+    if (out != job->bmp) {
+        DeleteObject(job->bmp);
+        job->bmp = out;
+    }
+    DebugLog(L"post-process: %S, %dx%d -> %dx%d, %d bands in %.1f ms", BandPipelineDescribe(p).c_str(), w, h, ow, oh, bands, MsSince(t0));
+    job->w = ow;
+    job->h = oh;
+    return bands > 0;
+}
+
+static void CaptureJobThread(CaptureJob* job) {
+    const auto t0 = std::chrono::steady_clock::now();
+    job->ok = CaptureJobPipeline(job);
+    // de hash is sequentieel over het hele geheugen (en opgeslagen): blijft een eigen pass
+    if (job->ok) job->hashValid = BitmapContentHash(job->bmp, job->hasAlpha, job->hash);
+    job->ms = MsSince(t0);
+    if (!PostMessageW(g_hwndMsg, WM_CAPTURE_PROCESSED, 0, (LPARAM)job)) CaptureJobFree(job);
+}
+
+struct CaptureFlowState {
+    CaptureSequencer seq;
+    CaptureKind kind = CaptureKind::Rect;
+    HWND overlay = nullptr;
+    HWND raise = nullptr;           // Window-fallback/Scroll: naar voren halen vóór de wacht
+    RECT sr{};
+    std::vector<POINT> mask;
+    RECT maskBounds{};
+    int smooth = 0;
+    int feather = 0;
+    bool opaque = false;            // BitBlt-grab: alpha nog zetten
+    bool hidPreviews = false;       // Pipe
+    std::shared_ptr<PipeJob> pipe;
+    std::chrono::steady_clock::time_point t0{};
+};
+static CaptureFlowState g_capFlow;
+
+static double CaptureFlowNow() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool CaptureFlowBusy() {
+    return CaptureSeqBusy(g_capFlow.seq);
+}
+
+// Nieuwe capture: staat leeg, capture-globals klaar. De sequencer zelf (gen) blijft.
+static CaptureFlowState& CaptureFlowBegin(CaptureKind kind, HWND overlay, const RECT& sr) {
+    CaptureFlowState& f = g_capFlow;
+    f.kind = kind;
+    f.overlay = overlay;
+    f.raise = nullptr;
+    f.sr = sr;
+    f.mask.clear();
+    f.maskBounds = {};
+    f.smooth = 0;
+    f.feather = 0;
+    f.opaque = false;
+    f.hidPreviews = false;
+    f.pipe.reset();
+    f.t0 = std::chrono::steady_clock::now();
+    return f;
+}
+
+static void CaptureFlowHide() {
+    CaptureFlowState& f = g_capFlow;
+    if (f.overlay && f.overlay == g_hwndOverlay) ShowWindow(f.overlay, SW_HIDE);
+    if (f.hidPreviews) SessionsShow(false);
+    if (f.raise) BringWindowToFrontForCapture(f.raise);
+}
+
+static void CaptureFlowWaitComposition() {
+    const uint32_t gen = g_capFlow.seq.gen;
+    const HWND notify = g_hwndMsg;
+    try {
+        std::thread([gen, notify] {
+            const bool composed = SUCCEEDED(DwmFlush());
+            PostMessageW(notify, WM_CAPTURE_COMPOSED, (WPARAM)gen, composed ? 1 : 0);
+            }).detach();
+    }
+    catch (...) {
+        PostMessageW(notify, WM_CAPTURE_COMPOSED, (WPARAM)gen, 0);   // geen thread: vaste wachttijd
+    }
+}
+
+// UI-thread, zodra het scherm klaar is: grabben, of Burst/Record/Scroll starten.
+static bool CaptureFlowGrab() {
+    CaptureFlowState& f = g_capFlow;
+    switch (f.kind) {
+    case CaptureKind::Burst:
+        DestroyOverlay();
+        return !g_rec.active && BurstStart(f.sr);
+    case CaptureKind::Record:
+        DestroyOverlay();
+        return RecordStart(f.sr);
+    case CaptureKind::Scroll:
+        DestroyOverlay();
+        return ScrollStart(f.raise, f.sr);
+    default:
+        break;
+    }
+    if (g_captureBmp) return true;   // Window: al gerenderd
+    GdiFlush();
+    f.opaque = true;
+    return CaptureRectToBitmap(f.sr, g_captureBmp, g_captureW, g_captureH);
+}
+
+static void CaptureFlowPostProcess() {
+    CaptureFlowState& f = g_capFlow;
+    CaptureJob* job = new CaptureJob;
+    job->gen = f.seq.gen;
+    job->bmp = g_captureBmp;
+    g_captureBmp = nullptr;          // tijdens de job van de worker
+    job->hasAlpha = g_captureHasAlpha;
+    job->mask = std::move(f.mask);
+    job->maskBounds = f.maskBounds;
+    job->smooth = f.smooth;
+    job->feather = f.feather;
+    job->opaque = f.opaque;
+    job->w = g_captureW;
+    job->h = g_captureH;
+    int dw = g_captureW, dh = g_captureH;
+    const int value = (OutputScaleMode)g_outputScale == OutputScaleMode::Percent ? g_outputPercent : g_outputMaxEdge;
+    OutputScaleSize((OutputScaleMode)g_outputScale, value, MonitorDpiScaleForRect(f.sr), g_captureW, g_captureH, dw, dh);
+    if (dw != g_captureW || dh != g_captureH) {
+        job->scaleW = dw;
+        job->scaleH = dh;
+    }
+    try {
+        std::thread(CaptureJobThread, job).detach();
+    }
+    catch (...) {
+        CaptureJobThread(job);       // geen thread: dan maar hier (het bericht komt toch)
+    }
+}
+
+static void CaptureFlowFinish() {
+    CaptureFlowState& f = g_capFlow;
+    DebugLog(L"capture: %.1f ms waiting for composition%s, %.1f ms total",
+        f.seq.waitedMs, f.seq.timedOut ? L" (timed out)" : L"", MsSince(f.t0));
+    switch (f.kind) {
+    case CaptureKind::Burst:
+    case CaptureKind::Record:
+    case CaptureKind::Scroll:
+        break;
+    case CaptureKind::Pipe: {
+        std::shared_ptr<PipeJob> job = std::move(f.pipe);
+        PipeCaptureDone(job, true, OpenCaptureSession());
+        break;
+    }
+    default:
+        DestroyOverlay();
+        OpenCaptureSession();
+        break;
+    }
+}
+
+static void CaptureFlowFail() {
+    CaptureFlowState& f = g_capFlow;
+    FreeCapture();
+    switch (f.kind) {
+    case CaptureKind::Burst:
+    case CaptureKind::Record:
+    case CaptureKind::Scroll:
+        MessageBeep(MB_ICONERROR);   // overlay is al weg
+        break;
+    case CaptureKind::Pipe: {
+        if (f.hidPreviews) SessionsShow(true);
+        std::shared_ptr<PipeJob> job = std::move(f.pipe);
+        PipeCaptureDone(job, false, nullptr);
+        break;
+    }
+    default:
+        MessageBeep(MB_ICONERROR);
+        if (f.overlay && f.overlay == g_hwndOverlay) {
+            ShowWindow(f.overlay, SW_SHOW);
+            InvalidateRect(f.overlay, nullptr, TRUE);
+        }
+        break;
+    }
+}
+
+static void CaptureFlowRun(CaptureSeqOut o) {
+    CaptureFlowState& f = g_capFlow;
+    for (;;) {
+        if (o.killTimer) KillTimer(g_hwndMsg, TIMER_CAPTURE_SEQ);
+        if (o.timerMs >= 0) SetTimer(g_hwndMsg, TIMER_CAPTURE_SEQ, (UINT)std::ceil(o.timerMs), nullptr);
+        if (o.hide) CaptureFlowHide();
+        if (o.waitComposition) CaptureFlowWaitComposition();
+        if (o.postProcess) CaptureFlowPostProcess();
+        if (o.finish) CaptureFlowFinish();
+        if (o.fail) CaptureFlowFail();
+        if (!o.grab) break;
+        o = CaptureSeqGrabbed(f.seq, CaptureFlowGrab());
+    }
+}
+
+// WM_CAPTURE_PROCESSED: bitmap terug naar de capture-globals, clipboard zetten.
+static void CaptureFlowProcessed(CaptureJob* job) {
+    CaptureFlowState& f = g_capFlow;
+    if (job->gen != f.seq.gen || f.seq.state != CaptureSeqState::Processing) {
+        CaptureJobFree(job);         // afgebroken capture
+        return;
+    }
+    bool ok = job->ok;
+    if (ok) {
+        g_captureBmp = job->bmp;
+        job->bmp = nullptr;
+        g_captureW = job->w;
+        g_captureH = job->h;
+        g_captureHash = job->hash;
+        g_captureHashValid = job->hashValid;
+        const bool clipOk = ClipboardPublish(job->clip, job->hasAlpha ? CF_DIBV5 : CF_DIB, job->clipBmp);
+        job->clip = nullptr;
+        job->clipBmp = nullptr;
+        if (!clipOk) {
+            if (f.kind == CaptureKind::Pipe) DebugLog(L"pipe: clipboard busy, capture not copied");
+            else ok = false;
+        }
+    }
+    DebugLog(L"capture post-process: %.1f ms on worker", job->ms);
+    const uint32_t gen = job->gen;
+    CaptureJobFree(job);
+    CaptureFlowRun(CaptureSeqProcessed(f.seq, gen, ok));
+}
+
+// Afsluiten: late meldingen negeren, een wachtende pipe-client meteen antwoorden.
+static void CaptureFlowCancel() {
+    CaptureFlowRun(CaptureSeqCancel(g_capFlow.seq));
+    std::shared_ptr<PipeJob> job = std::move(g_capFlow.pipe);
+    PipeCaptureDone(job, false, nullptr);
+}
+
+static void CaptureFlowStart(const CaptureSeqConfig& cfg) {
+    CaptureFlowRun(CaptureSeqStart(g_capFlow.seq, cfg, CaptureFlowNow()));
+}
+
+// Region/Monitor/Window -> preview.
+static void CaptureScreenRectAndShowPreview(HWND hwndOverlay, const RECT& sr, HWND bringHwnd = nullptr) {
+    if (CaptureFlowBusy()) return;
+    FreeCapture();
+    g_captureHasAlpha = false;  // belangrijk: normale captures zijn opaque
+    g_captureSrcRect = sr;
+    g_captureSrcHwnd = bringHwnd;
+
+    CaptureFlowState& f = CaptureFlowBegin(bringHwnd ? CaptureKind::Window : CaptureKind::Rect, hwndOverlay, sr);
+    CaptureSeqConfig cfg;
+    cfg.postProcess = true;
+    if (bringHwnd) {
+        const WindowCaptureVia via = CaptureWindowRender(bringHwnd, sr, g_captureBmp, g_captureW, g_captureH, g_captureSrcRect);
+        if (via == WindowCaptureVia::Render) cfg.flushes = 0;   // al binnen: niets af te wachten
+        else {
+            f.raise = bringHwnd;
+            cfg.flushes = kCaptureRaiseFlushes;
+            cfg.settleMs = kCaptureRaiseSettleMs;
+        }
+    }
+    CaptureFlowStart(cfg);
+}
+
+// Lasso/Polygon: buiten de vorm transparant (mask + feather op de worker).
+static void CaptureMaskedSelection(HWND hwndOverlay, const RECT& sr, const std::vector<POINT>& ptsClient,
+    const RECT& boundsClient, int smooth, int feather) {
+    if (CaptureFlowBusy()) return;
+    FreeCapture();
+    g_captureHasAlpha = true;
+    g_captureSrcRect = sr;
+
+    CaptureFlowState& f = CaptureFlowBegin(CaptureKind::Masked, hwndOverlay, sr);
+    f.mask = ptsClient;
+    f.maskBounds = boundsClient;
+    f.smooth = smooth;
+    f.feather = feather;
+    CaptureSeqConfig cfg;
+    cfg.postProcess = true;
+    CaptureFlowStart(cfg);
+}
+
+// Burst/Record/Scroll: overlay weg, compositie afwachten, dan de modus starten.
+static void CaptureStartMode(CaptureKind kind, HWND hwndOverlay, const RECT& sr, HWND target = nullptr) {
+    if (CaptureFlowBusy()) return;
+    CaptureFlowState& f = CaptureFlowBegin(kind, hwndOverlay, sr);
+    CaptureSeqConfig cfg;
+    if (target) {
+        f.raise = target;
+        cfg.flushes = kCaptureRaiseFlushes;
+        cfg.settleMs = kCaptureRaiseSettleMs;
+    }
+    CaptureFlowStart(cfg);
+}
+
+static void LassoAddPoint(POINT p) {
+    // punten uitdunnen: scheelt CPU bij masken
+    if (!g_lassoPtsClient.empty()) {
+        POINT last = g_lassoPtsClient.back();
+        int dx = p.x - last.x, dy = p.y - last.y;
+        if (dx * dx + dy * dy < 9) return; // <3px: negeren
+    }
+
+    g_lassoPtsClient.push_back(p);
+
+    if (g_lassoPtsClient.size() == 1) {
+        g_lassoBoundsClient = { p.x, p.y, p.x + 1, p.y + 1 };
+    }
+    else {
+        if (p.x < g_lassoBoundsClient.left)   g_lassoBoundsClient.left = p.x;
+        if (p.y < g_lassoBoundsClient.top)    g_lassoBoundsClient.top = p.y;
+        if (p.x + 1 > g_lassoBoundsClient.right)  g_lassoBoundsClient.right = p.x + 1;
+        if (p.y + 1 > g_lassoBoundsClient.bottom) g_lassoBoundsClient.bottom = p.y + 1;
+    }
+}
+
+static void PolygonFinalize(HWND hwnd) {
+    ReleaseCapture();
+    g_polySelecting = false;
+
+    if (g_polyPtsClient.size() < 3) {
+        MessageBeep(MB_ICONWARNING);
+        PolyReset();
+        InvalidateRect(hwnd, nullptr, TRUE);
+        return;
+    }
+
+    // bounds iets ruimer
+    RECT b = g_polyBoundsClient;
+    b.left -= 2; b.top -= 2; b.right += 2; b.bottom += 2;
+
+    if ((b.right - b.left) < 5 || (b.bottom - b.top) < 5) {
+        MessageBeep(MB_ICONWARNING);
+        PolyReset();
+        InvalidateRect(hwnd, nullptr, TRUE);
+        return;
+    }
+
+    RECT ow{};
+    GetWindowRect(hwnd, &ow);
+
+    RECT sr{
+        ow.left + b.left,
+        ow.top + b.top,
+        ow.left + b.right,
+        ow.top + b.bottom
+    };
+
+    // mask: alpha buiten polygon = 0. Polygon is “strak”; feather optioneel (laatste
+    // argument op 1 als je het net iets zachter wil).
+    CaptureMaskedSelection(hwnd, sr, g_polyPtsClient, b, 0, 0);
+
+    PolyReset();
+}
+
+// Hotkey -> eerste paint van de overlay (DebugLog). queueMs = hoe lang WM_HOTKEY in de
+// wachtrij stond voordat MsgProc hem zag; de gemiddelden lopen apart voor warm/koud.
+struct OverlayLatency {
+    std::chrono::steady_clock::time_point t0{};
+    double queueMs = 0;
+    bool pending = false;
+    bool warm = false;
+    double sumMs[2]{};     // [0] koud, [1] warm
+    int count[2]{};
+};
+static OverlayLatency g_overlayLatency;
+
+static void OverlayLatencyReport() {
+    OverlayLatency& l = g_overlayLatency;
+    l.pending = false;
+    const double ms = MsSince(l.t0);
+    l.sumMs[l.warm] += ms;
+    ++l.count[l.warm];
+    DebugLog(L"overlay first paint: %.1f ms after hotkey (+%.0f ms queued, %s; avg warm %.1f ms/%d, cold %.1f ms/%d)",
+        ms, l.queueMs, l.warm ? L"warm" : L"cold",
+        l.count[1] ? l.sumMs[1] / l.count[1] : 0.0, l.count[1],
+        l.count[0] ? l.sumMs[0] / l.count[0] : 0.0, l.count[0]);
+}
+
+static LRESULT CALLBACK OverlayProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_SETCURSOR:
+        if ((HWND)wParam == hwnd && LOWORD(lParam) == HTCLIENT) {
+            SetCursor(nullptr); // cursor verbergen
+            return TRUE;
+        }
+        break;
+
+    case WM_SHOWWINDOW:
+        if (!wParam) LoupeHide(); // overlay weg voor de capture: loupe ook
+        break;
+
+    case WM_MOUSEWHEEL: {
+        // loupe-zoom
+        if (!g_loupe.hwnd) return 0;
+        int i = 0;
+        while (i + 1 < (int)_countof(kLoupeZooms) && kLoupeZooms[i] < g_loupeZoom) ++i;
+        i += (GET_WHEEL_DELTA_WPARAM(wParam) > 0) ? 1 : -1;
+        i = std::clamp(i, 0, (int)_countof(kLoupeZooms) - 1);
+        g_loupeZoom = kLoupeZooms[i];
+        SaveSettings();
+        InvalidateRect(g_loupe.hwnd, nullptr, FALSE);
+        return 0;
+    }
+
+    case WM_MOUSELEAVE:
+        LoupeHide();
+        g_cursorValid = false;
+        g_trackLeave = false;
+        InvalidateRect(hwnd, nullptr, FALSE);
+        return 0;
+
+    case WM_RBUTTONUP:
+        if (g_polySelecting) {
+            PolyUndoLast();
+            InvalidateRect(hwnd, nullptr, TRUE);
+            return 0;
+        }
+        if (g_lassoSelecting) return 0;
+        if (g_selecting) return 0;
+        ShowModeMenu(hwnd);
+        InvalidateRect(hwnd, nullptr, TRUE);
+        return 0;
+
+    case WM_LBUTTONDOWN:
+        if (g_mode == Mode::Polygon) {
+            SetFocus(hwnd);
+
+            POINT raw{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+
+            if (!g_polySelecting) {
+                SetCapture(hwnd);
+                PolyReset();
+                g_polySelecting = true;
+
+                g_polyHoverClient = raw;
+                g_polyHoverValid = true;
+
+                PolyAddPoint(raw);
+                InvalidateRect(hwnd, nullptr, TRUE);
+                return 0;
+            }
+
+            // bestaand polygon: bepaal klikpunt (Shift = snap 45° t.o.v. laatste punt)
+            POINT p = raw;
+            if (!g_polyPtsClient.empty() && IsShiftDown()) {
+                p = SnapPoint45(g_polyPtsClient.back(), raw);
+            }
+
+            // close door te klikken dichtbij het eerste punt
+            if (g_polyPtsClient.size() >= 3 && NearPoint(p, g_polyPtsClient.front(), 10)) {
+                PolygonFinalize(hwnd);
+                return 0;
+            }
+
+            PolyAddPoint(p);
+            InvalidateRect(hwnd, nullptr, TRUE);
+            return 0;
+        }
+
+        if (g_mode == Mode::Freestyle) {
+            SetCapture(hwnd);
+            LassoReset();
+            g_lassoSelecting = true;
+
+            POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+            LassoAddPoint(p);
+
+            InvalidateRect(hwnd, nullptr, TRUE);
+            return 0;
+        }
+
+        if (!IsRectSelectMode(g_mode)) return 0;
+
+        ClearHover();
+        SetCapture(hwnd);
+        g_selecting = true;
+        g_hasSelection = false;
+        g_selStart = EdgeSnapPoint({ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) });
+        g_selCur = g_selStart;
+        g_selRectClient = MakeNormalizedRect(g_selStart, g_selCur);
+        InvalidateRect(hwnd, nullptr, TRUE);
+        return 0;
+
+    case WM_MOUSEMOVE: {
+        POINT newPt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+
+        RECT r1{};
+        if (g_cursorValid) r1 = CursorDirtyRect(g_cursorPt);
+
+        g_cursorPt = newPt;
+        g_cursorValid = true;
+
+        RECT r2 = CursorDirtyRect(g_cursorPt);
+
+        // mouse-leave aanzetten (zodat cursor verdwijnt als je overlay verlaat)
+        if (!g_trackLeave) {
+            TRACKMOUSEEVENT tme{};
+            tme.cbSize = sizeof(tme);
+            tme.dwFlags = TME_LEAVE;
+            tme.hwndTrack = hwnd;
+            TrackMouseEvent(&tme);
+            g_trackLeave = true;
+        }
+
+        // repaint alleen oude + nieuwe cursor-plek (loupe is een eigen window)
+        InvalidateRect(hwnd, &r2, FALSE);
+        if (r1.right > r1.left) InvalidateRect(hwnd, &r1, FALSE);
+        LoupeMove(newPt);
+
+        if (g_mode == Mode::Polygon && g_polySelecting) {
+            POINT raw{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+            POINT h = raw;
+
+            if (!g_polyPtsClient.empty() && IsShiftDown()) {
+                h = SnapPoint45(g_polyPtsClient.back(), raw);
+            }
+
+            g_polyHoverClient = h;
+            g_polyHoverValid = true;
+
+            InvalidateRect(hwnd, nullptr, TRUE);
+            return 0;
+        }
+
+        if (g_mode == Mode::Freestyle && g_lassoSelecting) {
+            POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+            LassoAddPoint(p);
+            InvalidateRect(hwnd, nullptr, TRUE);
+            return 0;
+        }
+
+        // Region/Burst: rubberband rectangle
+        if (IsRectSelectMode(g_mode)) {
+            if (!g_selecting) return 0;
+            g_selCur = EdgeSnapPoint({ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) });
+            g_selRectClient = MakeNormalizedRect(g_selStart, g_selCur);
+            InvalidateRect(hwnd, nullptr, TRUE);
+            return 0;
+        }
+
+        // Window/Monitor: hover highlight under cursor
+        POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        ClientToScreen(hwnd, &pt);
+
+        if (g_mode == Mode::Window || g_mode == Mode::Scroll) {
+            RECT wr{};
+            HWND h = PickTopWindowAtPoint(pt, wr);
+            if (h) SetHoverFromScreenRect(hwnd, h, wr);
+            else ClearHover();
+        }
+        else if (g_mode == Mode::Monitor) {
+            RECT mr{};
+            if (GetMonitorRectAtPoint(pt, mr)) SetHoverFromScreenRect(hwnd, nullptr, mr);
+            else ClearHover();
+        }
+        else {
+            // Freestyle: later
+            ClearHover();
+        }
+
+        InvalidateRect(hwnd, nullptr, TRUE);
+        return 0;
+    }
+
+    case WM_LBUTTONUP: {
+        if (g_mode == Mode::Polygon) {
+            return 0;
+        }
+        if (g_mode == Mode::Freestyle && g_lassoSelecting) {
+            ReleaseCapture();
+            g_lassoSelecting = false;
+
+            if (g_lassoPtsClient.size() < 3) {
+                MessageBeep(MB_ICONWARNING);
+                LassoReset();
+                InvalidateRect(hwnd, nullptr, TRUE);
+                return 0;
+            }
+
+            // bounds iets ruimer
+            RECT b = g_lassoBoundsClient;
+            b.left -= 2; b.top -= 2; b.right += 2; b.bottom += 2;
+
+            if ((b.right - b.left) < 5 || (b.bottom - b.top) < 5) {
+                MessageBeep(MB_ICONWARNING);
+                LassoReset();
+                InvalidateRect(hwnd, nullptr, TRUE);
+                return 0;
+            }
+
+            RECT ow{};
+            GetWindowRect(hwnd, &ow);
+
+            RECT sr{
+                ow.left + b.left,
+                ow.top + b.top,
+                ow.left + b.right,
+                ow.top + b.bottom
+            };
+
+            // mask: alpha buiten lasso = 0 (2x Chaikin-smoothing, feather 1 = subtiel; 2 = zachter)
+            CaptureMaskedSelection(hwnd, sr, g_lassoPtsClient, b, 2, 1);
+
+            LassoReset();
+            return 0;
+        }
+
+        // Region mode: capture dragged rectangle (Burst: start interval-capture)
+        if (IsRectSelectMode(g_mode)) {
+            if (!g_selecting) return 0;
+
+            g_selCur = EdgeSnapPoint({ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) });
+            g_selRectClient = MakeNormalizedRect(g_selStart, g_selCur);
+
+            g_selecting = false;
+            ReleaseCapture();
+
+            const int rw = g_selRectClient.right - g_selRectClient.left;
+            const int rh = g_selRectClient.bottom - g_selRectClient.top;
+            g_hasSelection = (rw >= 5 && rh >= 5);
+
+            if (!g_hasSelection) { InvalidateRect(hwnd, nullptr, TRUE); return 0; }
+
+            RECT ow{};
+            GetWindowRect(hwnd, &ow);
+
+            RECT sr{};
+            sr.left = ow.left + g_selRectClient.left;
+            sr.top = ow.top + g_selRectClient.top;
+            sr.right = ow.left + g_selRectClient.right;
+            sr.bottom = ow.top + g_selRectClient.bottom;
+
+            if (g_mode == Mode::Burst) {
+                CaptureStartMode(CaptureKind::Burst, hwnd, sr);
+                return 0;
+            }
+            if (g_mode == Mode::Record) {
+                CaptureStartMode(CaptureKind::Record, hwnd, sr);
+                return 0;
+            }
+
+        CaptureScreenRectAndShowPreview(hwnd, sr);
+        return 0;
+        }
+
+        // Window/Monitor: capture on click
+        POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+        ClientToScreen(hwnd, &pt);
+
+        RECT sr{};
+        bool have = false;
+        HWND picked = nullptr;
+
+        if (g_mode == Mode::Window || g_mode == Mode::Scroll) {
+            picked = PickTopWindowAtPoint(pt, sr);
+            have = (picked != nullptr);
+        }
+else if (g_mode == Mode::Monitor) {
+            have = GetMonitorRectAtPoint(pt, sr);
+        }
+        else {
+            // Freestyle (Lasso) is added to the menu, implementation follows later.
+            MessageBeep(MB_ICONWARNING);
+            ClearHover();
+            InvalidateRect(hwnd, nullptr, TRUE);
+            return 0;
+        }
+
+        if (!have) {
+            MessageBeep(MB_ICONWARNING);
+            ClearHover();
+            InvalidateRect(hwnd, nullptr, TRUE);
+            return 0;
+        }
+
+        if (g_mode == Mode::Scroll) {
+            CaptureStartMode(CaptureKind::Scroll, hwnd, sr, picked);
+            return 0;
+        }
+
+        CaptureScreenRectAndShowPreview(hwnd, sr, picked);
+        return 0;
+    }
+
+    case WM_KEYDOWN:
+        if (wParam == VK_ESCAPE) {
+            if (g_polySelecting) {
+                PolyReset();
+                ReleaseCapture();
+                InvalidateRect(hwnd, nullptr, TRUE);
+                return 0;
+            }
+            if (g_lassoSelecting) {
+                LassoReset();
+                ReleaseCapture();
+                InvalidateRect(hwnd, nullptr, TRUE);
+                return 0;
+            }
+            if (g_selecting) {
+                g_selecting = false;
+                g_hasSelection = false;
+                ReleaseCapture();
+                InvalidateRect(hwnd, nullptr, TRUE);
+            }
+            else {
+                DestroyOverlay();
+            }
+            return 0;
+        }
+
+        if (wParam == 'M') {
+            g_loupeEnabled = !g_loupeEnabled;
+            SaveSettings();
+            if (g_loupeEnabled && !g_loupe.hwnd) LoupeCreate();
+            if (g_loupeEnabled) OverlayDesktopWanted();
+            if (g_loupeEnabled && g_cursorValid) LoupeMove(g_cursorPt);
+            else LoupeHide();
+            return 0;
+        }
+        if (wParam == 'S') {
+            g_snapEnabled = !g_snapEnabled;
+            SaveSettings();
+            if (g_snapEnabled) OverlayDesktopWanted();
+            if (g_snapEnabled && !g_snap.ready && !g_snap.worker.joinable()) SnapStartBuild();
+            return 0;
+        }
+
+        if (g_mode == Mode::Polygon && g_polySelecting) {
+            if (wParam == VK_RETURN) {
+                PolygonFinalize(hwnd);
+                return 0;
+            }
+            if (wParam == VK_BACK) {
+                PolyUndoLast();
+                InvalidateRect(hwnd, nullptr, TRUE);
+                return 0;
+            }
+        }
+
+        return 0;
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam)) {
+        case 1001: g_mode = g_lastMode = Mode::Region;    ClearHover(); SaveSettings(); break;
+        case 1002: g_mode = g_lastMode = Mode::Window;    ClearHover(); SaveSettings(); break;
+        case 1003: g_mode = g_lastMode = Mode::Monitor;   ClearHover(); SaveSettings(); break;
+        case 1004: g_mode = g_lastMode = Mode::Freestyle; ClearHover(); SaveSettings(); break;
+        case 1005: g_mode = g_lastMode = Mode::Polygon;  ClearHover(); SaveSettings(); break;
+        case 1006: g_mode = g_lastMode = Mode::Burst;    ClearHover(); SaveSettings(); break;
+        case 1007: g_mode = g_lastMode = Mode::Record;   ClearHover(); SaveSettings(); break;
+        case 1008: g_mode = g_lastMode = Mode::Scroll;   ClearHover(); SaveSettings(); break;
+        default: break;
+        }
+        InvalidateRect(hwnd, nullptr, TRUE);
+        return 0;
+
+    case WM_PAINT: {
+        PAINTSTRUCT ps{};
+        HDC hdc = BeginPaint(hwnd, &ps);
+
+        RECT r{};
+        GetClientRect(hwnd, &r);
+        HBRUSH bg = CreateSolidBrush(RGB(0, 0, 0));
+        FillRect(hdc, &r, bg);
+        DeleteObject(bg);
+
+        SetBkMode(hdc, TRANSPARENT);
+        SetTextColor(hdc, RGB(255, 255, 255));
+        RECT tr = r;
+        tr.left += 20; tr.top += 20;
+        DrawTextW(hdc, ModeText(g_mode), -1, &tr, DT_LEFT | DT_TOP | DT_SINGLELINE);
+
+        if (g_mode == Mode::Freestyle && (g_lassoSelecting || g_lassoPtsClient.size() >= 2)) {
+            if (g_lassoPtsClient.size() >= 2) {
+                HPEN pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
+                HGDIOBJ oldPen = SelectObject(hdc, pen);
+                HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+
+                Polyline(hdc, g_lassoPtsClient.data(), (int)g_lassoPtsClient.size());
+
+                // optioneel: bounding box (handig bij debug)
+                // Rectangle(hdc, g_lassoBoundsClient.left, g_lassoBoundsClient.top,
+                //           g_lassoBoundsClient.right, g_lassoBoundsClient.bottom);
+
+                SelectObject(hdc, oldBrush);
+                SelectObject(hdc, oldPen);
+                DeleteObject(pen);
+            }
+        }
+
+        if (g_mode == Mode::Polygon && (g_polySelecting || g_polyPtsClient.size() >= 1)) {
+            HPEN pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
+            HGDIOBJ oldPen = SelectObject(hdc, pen);
+            HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+
+            // vaste edges
+            if (g_polyPtsClient.size() >= 2) {
+                Polyline(hdc, g_polyPtsClient.data(), (int)g_polyPtsClient.size());
+            }
+
+            // rubber-band (laatste punt -> hover), met “close hint” (hover -> eerste)
+            if (g_polySelecting && g_polyHoverValid && !g_polyPtsClient.empty()) {
+                POINT last = g_polyPtsClient.back();
+                MoveToEx(hdc, last.x, last.y, nullptr);
+                LineTo(hdc, g_polyHoverClient.x, g_polyHoverClient.y);
+
+                if (g_polyPtsClient.size() >= 3 && NearPoint(g_polyHoverClient, g_polyPtsClient.front(), 10)) {
+                    MoveToEx(hdc, g_polyHoverClient.x, g_polyHoverClient.y, nullptr);
+                    LineTo(hdc, g_polyPtsClient.front().x, g_polyPtsClient.front().y);
+                }
+            }
+
+            // vertices (kleine cirkels)
+            SelectObject(hdc, GetStockObject(NULL_BRUSH));
+            constexpr int kVtxR = 3;
+            for (auto p : g_polyPtsClient) {
+                Ellipse(hdc,
+                    p.x - kVtxR, p.y - kVtxR,
+                    p.x + kVtxR + 1, p.y + kVtxR + 1);
+            }
+
+            SelectObject(hdc, oldBrush);
+            SelectObject(hdc, oldPen);
+            DeleteObject(pen);
+        }
+
+        if (IsRectSelectMode(g_mode) && g_selecting) {
+
+            // clamp naar client
+            RECT client{};
+            GetClientRect(hwnd, &client);
+
+            RECT s = g_selRectClient;
+            RECT ss{};
+            if (IntersectRect(&ss, &s, &client)) {
+
+                // (A) Oplichten: vulling binnen selectie
+                // Kies een kleur die duidelijk lichter is dan jouw overlay-achtergrond
+                HBRUSH lit = CreateSolidBrush(RGB(60, 60, 60));
+                FillRect(hdc, &ss, lit);
+                DeleteObject(lit);
+
+                // (B) Witte outline zoals nu
+                HPEN pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
+                HGDIOBJ oldPen = SelectObject(hdc, pen);
+                HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+                Rectangle(hdc, ss.left, ss.top, ss.right, ss.bottom);
+
+                SelectObject(hdc, oldBrush);
+                SelectObject(hdc, oldPen);
+                DeleteObject(pen);
+            }
+        }
+        else if (g_hoverValid) {
+            HPEN pen = CreatePen(PS_SOLID, 2, RGB(100, 200, 255));
+            HGDIOBJ oldPen = SelectObject(hdc, pen);
+            HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+            Rectangle(hdc, g_hoverRectClient.left, g_hoverRectClient.top, g_hoverRectClient.right, g_hoverRectClient.bottom);
+            SelectObject(hdc, oldBrush);
+            SelectObject(hdc, oldPen);
+            DeleteObject(pen);
+        }
+        if (g_cursorValid) {
+            DrawOutlinedCrosshair(hdc, g_cursorPt.x, g_cursorPt.y);
+        }
+
+        EndPaint(hwnd, &ps);
+        if (g_overlayLatency.pending) OverlayLatencyReport();
+        return 0;
+    }
+
+    case WM_DISPLAYCHANGE:
+        // reserve-overlay meteen op de nieuwe desktopgrootte, niet pas bij de hotkey
+        if (hwnd == g_hwndOverlaySpare) {
+            const RECT vr = VirtualScreenRect();
+            SetWindowPos(hwnd, nullptr, vr.left, vr.top, vr.right - vr.left, vr.bottom - vr.top,
+                SWP_NOZORDER | SWP_NOACTIVATE);
+        }
+        return 0;
+
+    case WM_DESTROY:
+        if (hwnd == g_hwndOverlaySpare) g_hwndOverlaySpare = nullptr;
+        return 0;
+		}
+   return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+    
+// Verborgen overlay-venster over de hele virtuele desktop (nog niet getoond).
+static HWND OverlayCreateWindow(const RECT& vr) {
+    static bool registered = false;
+    if (!registered) {
+        WNDCLASSW wc{};
+        wc.lpfnWndProc = OverlayProc;
+        wc.hInstance = g_hInst;
+        wc.lpszClassName = L"SnipLiteOverlay";
+        wc.hCursor = LoadCursorW(nullptr, IDC_CROSS);
+        RegisterClassW(&wc);
+        registered = true;
+    }
+
+    HWND hwnd = CreateWindowExW(
+        WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TOOLWINDOW,
+        L"SnipLiteOverlay",
+        L"",
+        WS_POPUP,
+        vr.left, vr.top,
+        vr.right - vr.left, vr.bottom - vr.top,
+        nullptr, nullptr, g_hInst, nullptr
+    );
+    if (hwnd) {
+        SetLayeredWindowAttributes(hwnd, 0, (BYTE)120, LWA_ALPHA);
+        // niet in schermcaptures: de desktop-cache mag na het tonen gegrepen worden
+        SetWindowDisplayAffinity(hwnd, WDA_EXCLUDEFROMCAPTURE);
+    }
+    return hwnd;
+}
+
+// Bij het opstarten (en na elke capture via DestroyOverlay) ligt er een reserve klaar.
+static void OverlayEnsureSpare() {
+    if (g_hwndOverlaySpare && IsWindow(g_hwndOverlaySpare)) return;
+    g_hwndOverlaySpare = OverlayCreateWindow(VirtualScreenRect());
+}
+
+static void CreateOverlay() {
+    if (g_hwndOverlay || CaptureFlowBusy()) return;
+	ClearHover();
+
+    SessionsShow(false);
+
+    const RECT vr = VirtualScreenRect();
+
+    const bool warm = g_hwndOverlaySpare && IsWindow(g_hwndOverlaySpare);
+    if (warm) {
+        g_hwndOverlay = g_hwndOverlaySpare;
+        g_hwndOverlaySpare = nullptr;
+        // WM_DISPLAYCHANGE houdt de reserve normaal al op maat; dit vangt het gemiste geval
+        RECT wr{};
+        GetWindowRect(g_hwndOverlay, &wr);
+        if (!EqualRect(&wr, &vr)) {
+            SetWindowPos(g_hwndOverlay, nullptr, vr.left, vr.top, vr.right - vr.left, vr.bottom - vr.top,
+                SWP_NOZORDER | SWP_NOACTIVATE);
+        }
+        g_cursorValid = false;
+        g_trackLeave = false;
+    }
+    else {
+        g_hwndOverlay = OverlayCreateWindow(vr);
+    }
+    if (!g_hwndOverlay) {
+        g_overlayLatency.pending = false;
+        MessageBeep(MB_ICONERROR);
+        SessionsShowLater();
+        return;
+    }
+    g_overlayLatency.warm = warm;
+
+    // desktop voor loupe/snapping: op een worker als de overlay niet in captures komt,
+    // anders synchroon zolang de overlay er nog niet is
+    if (g_loupeEnabled || g_snapEnabled) {
+        if (OverlayExcludedFromCapture(g_hwndOverlay)) DesktopCacheStart(vr);
+        else if (DesktopCacheCapture(vr) && g_snapEnabled) SnapStartBuild();
+    }
+    if (g_loupeEnabled) LoupeCreate();
+
+    // eerst onzichtbaar tonen en synchroon schilderen, dan pas dekking: geen flits van
+    // een ongeschilderd (of nog met de vorige selectie gevuld) venster
+    SetLayeredWindowAttributes(g_hwndOverlay, 0, 0, LWA_ALPHA);
+    ShowWindow(g_hwndOverlay, SW_SHOW);
+    UpdateWindow(g_hwndOverlay);
+    SetLayeredWindowAttributes(g_hwndOverlay, 0, (BYTE)120, LWA_ALPHA);
+    SetForegroundWindow(g_hwndOverlay);
+    SetFocus(g_hwndOverlay);
+}
+
+#endif // !SNIP_CORE_ONLY
+
+// =========================================================
+// Command-kanaal: protocol (portable, geen Win32)
+// =========================================================
+// Scripts sturen de draaiende instance commando's via een named pipe (de tweede
+// start van de exe zou anders stil stoppen). Byte-stroom met frames, little-endian:
+//   frame:    u32 len (bytes na dit veld), dan payload
+//   request:  u8 op, u32 id, argumenten per op:
+//               Ping, GetLastPath: -
+//               CaptureRegion:     i32 x, i32 y, i32 w, i32 h, u8 flags
+//               CaptureMonitor:    i32 index (-1 = monitor onder de cursor), u8 flags
+//               SetFormat:         u8 SaveFormat
+//   response: u8 status, u32 id (van het request), u16 n, n UTF-16 code units
+//             (pad, formaat of foutmelding)
+// flags: 1 = meteen opslaan (antwoord = pad) en de preview sluiten.
+// Een request met een onbekende op of verkeerde lengte krijgt BadRequest; een frame-
+// lengte buiten de grenzen maakt de stroom onbruikbaar (verbinding dicht).
+enum class PipeOp : uint8_t { Ping = 0, CaptureRegion = 1, CaptureMonitor = 2, SetFormat = 3, GetLastPath = 4 };
+enum class PipeStatus : uint8_t { Ok = 0, Error = 1, Busy = 2, BadRequest = 3 };
+enum class PipeDecode { Ok, NeedMore, BadPayload, BadFrame };
+
+static constexpr uint8_t kPipeFlagSave = 1;
+static constexpr size_t kPipeMaxRequest = 64;                    // payload
+static constexpr size_t kPipeMaxResponse = 1 + 4 + 2 + 2 * 0xFFFF; // payload
+
+struct PipeRequest {
+    PipeOp op = PipeOp::Ping;
+    uint32_t id = 0;
+    int32_t x = 0, y = 0, w = 0, h = 0;   // CaptureRegion (scherm-pixels)
+    int32_t monitor = -1;                 // CaptureMonitor
+    uint8_t flags = 0;
+    uint8_t format = 0;                   // SetFormat
+};
+
+struct PipeResponse {
+    PipeStatus status = PipeStatus::Ok;
+    uint32_t id = 0;
+    std::wstring text;
+};
+
+static size_t PipeArgBytes(PipeOp op) {
+    switch (op) {
+    case PipeOp::Ping:           return 0;
+    case PipeOp::GetLastPath:    return 0;
+    case PipeOp::CaptureRegion:  return 17;
+    case PipeOp::CaptureMonitor: return 5;
+    case PipeOp::SetFormat:      return 1;
+    }
+    return SIZE_MAX;
+}
+
+static void PipePut32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static uint32_t PipeGet32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void PipeEncodeRequest(const PipeRequest& r, std::vector<uint8_t>& out) {
+    const size_t len = 5 + PipeArgBytes(r.op);
+    PipePut32(out, (uint32_t)len);
+    out.push_back((uint8_t)r.op);
+    PipePut32(out, r.id);
+    switch (r.op) {
+    case PipeOp::CaptureRegion:
+        for (int32_t v : { r.x, r.y, r.w, r.h }) PipePut32(out, (uint32_t)v);
+        out.push_back(r.flags);
+        break;
+    case PipeOp::CaptureMonitor:
+        PipePut32(out, (uint32_t)r.monitor);
+        out.push_back(r.flags);
+        break;
+    case PipeOp::SetFormat:
+        out.push_back(r.format);
+        break;
+    default:
+        break;
+    }
+}
+
+// p/n = ongelezen bytes. used = grootte van het frame (bij Ok en BadPayload).
+static PipeDecode PipeDecodeRequest(const uint8_t* p, size_t n, PipeRequest& out, size_t& used) {
+    used = 0;
+    if (n < 4) return PipeDecode::NeedMore;
+    const size_t len = PipeGet32(p);
+    if (len == 0 || len > kPipeMaxRequest) return PipeDecode::BadFrame;
+    if (n - 4 < len) return PipeDecode::NeedMore;
+    used = 4 + len;
+
+    const uint8_t* q = p + 4;
+    out = PipeRequest{};
+    if (len < 5) return PipeDecode::BadPayload;
+    out.op = (PipeOp)q[0];
+    out.id = PipeGet32(q + 1);
+    if (PipeArgBytes(out.op) != len - 5) return PipeDecode::BadPayload;
+    q += 5;
+    switch (out.op) {
+    case PipeOp::CaptureRegion:
+        out.x = (int32_t)PipeGet32(q);
+        out.y = (int32_t)PipeGet32(q + 4);
+        out.w = (int32_t)PipeGet32(q + 8);
+        out.h = (int32_t)PipeGet32(q + 12);
+        out.flags = q[16];
+        break;
+    case PipeOp::CaptureMonitor:
+        out.monitor = (int32_t)PipeGet32(q);
+        out.flags = q[4];
+        break;
+    case PipeOp::SetFormat:
+        out.format = q[0];
+        if (out.format > (uint8_t)SaveFormat::Auto) return PipeDecode::BadPayload;
+        break;
+    default:
+        break;
+    }
+    return PipeDecode::Ok;
+}
+
+static void PipeEncodeResponse(const PipeResponse& r, std::vector<uint8_t>& out) {
+    const size_t n = std::min<size_t>(r.text.size(), 0xFFFF);
+    PipePut32(out, (uint32_t)(7 + 2 * n));
+    out.push_back((uint8_t)r.status);
+    PipePut32(out, r.id);
+    out.push_back((uint8_t)n);
+    out.push_back((uint8_t)(n >> 8));
+    for (size_t i = 0; i < n; ++i) {
+        out.push_back((uint8_t)r.text[i]);
+        out.push_back((uint8_t)((uint16_t)r.text[i] >> 8));
+    }
+}
+
+static PipeDecode PipeDecodeResponse(const uint8_t* p, size_t n, PipeResponse& out, size_t& used) {
+    used = 0;
+    if (n < 4) return PipeDecode::NeedMore;
+    const size_t len = PipeGet32(p);
+    if (len < 7 || len > kPipeMaxResponse) return PipeDecode::BadFrame;
+    if (n - 4 < len) return PipeDecode::NeedMore;
+    used = 4 + len;
+
+    const uint8_t* q = p + 4;
+    const size_t count = (size_t)q[5] | ((size_t)q[6] << 8);
+    if (q[0] > (uint8_t)PipeStatus::BadRequest || len != 7 + 2 * count) return PipeDecode::BadPayload;
+    out.status = (PipeStatus)q[0];
+    out.id = PipeGet32(q + 1);
+    out.text.resize(count);
+    for (size_t i = 0; i < count; ++i) out.text[i] = (wchar_t)(q[7 + 2 * i] | (q[8 + 2 * i] << 8));
+    return PipeDecode::Ok;
+}
+
+// Server-kant, los van het transport: alle complete frames uit in afhandelen
+// (handler(request) -> PipeResponse) en de antwoorden achter out zetten.
+// false = stroom onbruikbaar, verbinding sluiten.
+template <class Handler>
+static bool PipeServeFrames(std::vector<uint8_t>& in, std::vector<uint8_t>& out, Handler&& handler) {
+    size_t pos = 0;
+    for (;;) {
+        PipeRequest req;
+        size_t used = 0;
+        const PipeDecode d = PipeDecodeRequest(in.data() + pos, in.size() - pos, req, used);
+        if (d == PipeDecode::NeedMore) break;
+        if (d == PipeDecode::BadFrame) return false;
+        pos += used;
+        if (d == PipeDecode::Ok) PipeEncodeResponse(handler(req), out);
+        else PipeEncodeResponse(PipeResponse{ PipeStatus::BadRequest, req.id, L"bad request" }, out);
+    }
+    in.erase(in.begin(), in.begin() + (ptrdiff_t)pos);
+    return true;
+}
+
+// Client: "capture-region 0 0 800 600 --save" enz. -> request. false + err bij onzin.
+static bool PipeParseCommand(const std::vector<std::wstring>& args, PipeRequest& out, std::wstring& err) {
+    out = PipeRequest{};
+    if (args.empty()) { err = L"missing command"; return false; }
 
-            RECT ow{};
-            GetWindowRect(hwnd, &ow);
+    std::vector<std::wstring> a;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == L"--save") out.flags |= kPipeFlagSave;
+        else a.push_back(args[i]);
+    }
+    auto number = [&](const std::wstring& s, int32_t& v) {
+        wchar_t* end = nullptr;
+        const long r = wcstol(s.c_str(), &end, 10);
+        if (s.empty() || *end) { err = L"not a number: " + s; return false; }
+        v = (int32_t)r;
+        return true;
+    };
 
-            RECT sr{
-                ow.left + b.left,
-                ow.top + b.top,
-                ow.left + b.right,
-                ow.top + b.bottom
-            };
+    const std::wstring& cmd = args[0];
+    if (cmd == L"ping" && a.empty()) out.op = PipeOp::Ping;
+    else if (cmd == L"get-last-path" && a.empty()) out.op = PipeOp::GetLastPath;
+    else if (cmd == L"capture-region" && a.size() == 4) {
+        out.op = PipeOp::CaptureRegion;
+        if (!number(a[0], out.x) || !number(a[1], out.y) || !number(a[2], out.w) || !number(a[3], out.h)) return false;
+        if (out.w <= 0 || out.h <= 0) { err = L"width and height must be positive"; return false; }
+    }
+    else if (cmd == L"capture-monitor" && a.size() <= 1) {
+        out.op = PipeOp::CaptureMonitor;
+        if (!a.empty() && !number(a[0], out.monitor)) return false;
+    }
+    else if (cmd == L"set-format" && a.size() == 1) {
+        out.op = PipeOp::SetFormat;
+        std::wstring f = a[0];
+        for (auto& c : f) c = CatalogLower(c);
+        if (f == L"png") out.format = (uint8_t)SaveFormat::Png;
+        else if (f == L"jpg" || f == L"jpeg") out.format = (uint8_t)SaveFormat::Jpeg;
+        else if (f == L"bmp") out.format = (uint8_t)SaveFormat::Bmp;
+        else if (f == L"auto") out.format = (uint8_t)SaveFormat::Auto;
+        else { err = L"unknown format: " + a[0]; return false; }
+    }
+    else {
+        err = L"unknown command or wrong arguments: " + cmd;
+        return false;
+    }
+    if (out.flags && out.op != PipeOp::CaptureRegion && out.op != PipeOp::CaptureMonitor) {
+        err = L"--save only applies to captures";
+        return false;
+    }
+    return true;
+}
 
-            ShowWindow(hwnd, SW_HIDE);
-            Sleep(20);
-            GdiFlush();
+// Benchmark-client: round-trip tijden (µs) -> één regel min/p50/p90/p99/max/gemiddeld.
+static std::wstring FormatLatencyReport(std::vector<double> us) {
+    if (us.empty()) return L"no samples\n";
+    std::sort(us.begin(), us.end());
+    double sum = 0;
+    for (double v : us) sum += v;
+    auto pct = [&](double q) { return us[std::min(us.size() - 1, (size_t)(q * (double)us.size()))]; };
+    wchar_t line[256];
+    swprintf(line, 256, L"%zu round trips: min %.1f, p50 %.1f, p90 %.1f, p99 %.1f, max %.1f, mean %.1f us\n",
+        us.size(), us.front(), pct(0.50), pct(0.90), pct(0.99), us.back(), sum / (double)us.size());
+    return line;
+}
 
-            FreeCapture();
-            g_captureHasAlpha = false;
+#if !SNIP_CORE_ONLY
+// =========================================================
+// Command-kanaal: named pipe (server + client)
+// =========================================================
+// \\.\pipe\snip-lite-<sessie>: één instance van de pipe, één client tegelijk (de
+// volgende wacht in WaitNamedPipe). De pipe-thread leest frames en zet elk request
+// via WM_PIPE_COMMAND op de UI-thread (captures en sessies zijn van de UI); het
+// antwoord komt terug via een event. Alleen lokale clients.
+// state: Queued -> Running (UI-thread pakt hem op) of Queued -> Cancelled (pipe-thread
+// gaf het op na kPipeUiTimeoutMs); wie de overgang wint, beslist.
+enum class PipeJobState : int { Queued, Running, Cancelled };
+
+struct PipeJob {
+    PipeRequest req;
+    PipeResponse resp;
+    std::atomic<PipeJobState> state{ PipeJobState::Queued };
+    HANDLE done = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    ~PipeJob() { if (done) CloseHandle(done); }
+};
+
+struct PipeServerState {
+    std::thread thread;
+    HANDLE stop = nullptr;   // manual-reset
+};
+static PipeServerState g_pipe;
+static constexpr DWORD kPipeUiTimeoutMs = 15000;   // capture + opslaan van een groot scherm
+static constexpr DWORD kPipeConnectWaitMs = 2000;
+
+static std::wstring PipeName() {
+    DWORD session = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &session);
+    return L"\\\\.\\pipe\\snip-lite-" + std::to_wstring(session);
+}
 
-            bool capOk = CaptureRectToBitmap(sr, g_captureBmp, g_captureW, g_captureH);
-            if (!capOk) {
-                MessageBeep(MB_ICONERROR);
-                ShowWindow(hwnd, SW_SHOW);
-                InvalidateRect(hwnd, nullptr, TRUE);
-                return 0;
-            }
+// Eén overlapped read/write; false bij fout, verbroken client of stop.
+static bool PipeIo(HANDLE pipe, OVERLAPPED& ov, bool write, void* buf, DWORD n, DWORD& done) {
+    done = 0;
+    ResetEvent(ov.hEvent);
+    const BOOL ok = write ? WriteFile(pipe, buf, n, nullptr, &ov) : ReadFile(pipe, buf, n, nullptr, &ov);
+    if (!ok && GetLastError() != ERROR_IO_PENDING) return false;
+    HANDLE waits[2] = { ov.hEvent, g_pipe.stop };
+    if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+        CancelIoEx(pipe, &ov);
+        GetOverlappedResult(pipe, &ov, &done, TRUE);
+        return false;
+    }
+    return GetOverlappedResult(pipe, &ov, &done, FALSE) && (write ? done == n : done > 0);
+}
 
-            // mask: alpha buiten lasso = 0
-            auto smoothPts = LassoSmoothClosed_Chaikin(g_lassoPtsClient, 2);
-            if (!ApplyLassoAlphaMask(g_captureBmp, smoothPts, b)) {
-                MessageBeep(MB_ICONERROR);
-                ShowWindow(hwnd, SW_SHOW);
-                InvalidateRect(hwnd, nullptr, TRUE);
-                return 0;
-            }
-            g_captureHasAlpha = true;
-            FeatherAlpha3x3(g_captureBmp, 1);  // 1 = subtiel; 2 = zachter
+// Pipe-thread -> UI-thread en wachten op het antwoord.
+static PipeResponse PipeDispatchToUi(const PipeRequest& req) {
+    auto job = std::make_shared<PipeJob>();
+    job->req = req;
+    auto* msg = new std::shared_ptr<PipeJob>(job);
+    if (!job->done || !PostMessageW(g_hwndMsg, WM_PIPE_COMMAND, 0, (LPARAM)msg)) {
+        delete msg;
+        return PipeResponse{ PipeStatus::Busy, req.id, L"instance not responding" };
+    }
+    HANDLE waits[2] = { job->done, g_pipe.stop };
+    if (WaitForMultipleObjects(2, waits, FALSE, kPipeUiTimeoutMs) != WAIT_OBJECT_0) {
+        // nog niet begonnen: de UI-thread slaat hem over, de client mag het opnieuw proberen
+        PipeJobState queued = PipeJobState::Queued;
+        if (job->state.compare_exchange_strong(queued, PipeJobState::Cancelled))
+            return PipeResponse{ PipeStatus::Busy, req.id, L"instance busy" };
+        return PipeResponse{ PipeStatus::Error, req.id, L"timed out (the capture may still finish)" };
+    }
+    return job->resp;
+}
 
-            bool clipOk = CopyBitmapToClipboardAlphaV5(g_captureBmp);
+static void PipeServeClient(HANDLE pipe, OVERLAPPED& ov) {
+    std::vector<uint8_t> in, out;
+    uint8_t buf[512];
+    for (;;) {
+        DWORD got = 0;
+        if (!PipeIo(pipe, ov, false, buf, sizeof(buf), got)) return;
+        in.insert(in.end(), buf, buf + got);
+        out.clear();
+        const bool keep = PipeServeFrames(in, out, PipeDispatchToUi);
+        if (!out.empty() && !PipeIo(pipe, ov, true, out.data(), (DWORD)out.size(), got)) return;
+        if (!keep) return;
+    }
+}
 
-            if (clipOk) {
-                DestroyOverlay();
-                g_tempEditFile.clear();
-                CreatePreviewWindow();
-            }
-            else {
-                MessageBeep(MB_ICONERROR);
-                ShowWindow(hwnd, SW_SHOW);
-                InvalidateRect(hwnd, nullptr, TRUE);
+static void PipeServerThread(std::wstring name) {
+    // FIRST_PIPE_INSTANCE: bestaat de naam al (ander proces), dan niet meeluisteren
+    HANDLE pipe = CreateNamedPipeW(name.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, 4096, 4096, 0, nullptr);
+    if (pipe == INVALID_HANDLE_VALUE) {
+        DebugLog(L"pipe: CreateNamedPipe %s failed (%lu)", name.c_str(), GetLastError());
+        return;
+    }
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    while (ov.hEvent && WaitForSingleObject(g_pipe.stop, 0) == WAIT_TIMEOUT) {
+        ResetEvent(ov.hEvent);
+        bool connected = ConnectNamedPipe(pipe, &ov) != FALSE;
+        if (!connected) {
+            const DWORD err = GetLastError();
+            if (err == ERROR_PIPE_CONNECTED) connected = true;
+            else if (err == ERROR_IO_PENDING) {
+                HANDLE waits[2] = { ov.hEvent, g_pipe.stop };
+                if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                    CancelIoEx(pipe, &ov);
+                    DWORD dummy = 0;
+                    GetOverlappedResult(pipe, &ov, &dummy, TRUE);
+                    break;
+                }
+                DWORD dummy = 0;
+                connected = GetOverlappedResult(pipe, &ov, &dummy, FALSE) != FALSE;
             }
-
-            LassoReset();
-            return 0;
         }
+        if (connected) PipeServeClient(pipe, ov);
+        FlushFileBuffers(pipe);
+        DisconnectNamedPipe(pipe);
+    }
 
-        // Region mode: capture dragged rectangle
-        if (g_mode == Mode::Region) {
-            if (!g_selecting) return 0;
+    if (ov.hEvent) CloseHandle(ov.hEvent);
+    CloseHandle(pipe);
+}
 
-            g_selCur = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-            g_selRectClient = MakeNormalizedRect(g_selStart, g_selCur);
+static void PipeServerStart() {
+    if (g_pipe.thread.joinable()) return;
+    g_pipe.stop = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!g_pipe.stop) return;
+    g_pipe.thread = std::thread(PipeServerThread, PipeName());
+}
 
-            g_selecting = false;
-            ReleaseCapture();
+static void PipeServerStop() {
+    if (!g_pipe.thread.joinable()) return;
+    SetEvent(g_pipe.stop);
+    g_pipe.thread.join();
+    CloseHandle(g_pipe.stop);
+    g_pipe.stop = nullptr;
+}
 
-            const int rw = g_selRectClient.right - g_selRectClient.left;
-            const int rh = g_selRectClient.bottom - g_selRectClient.top;
-            g_hasSelection = (rw >= 5 && rh >= 5);
+// ---- UI-thread: de commando's zelf
+static std::vector<RECT> MonitorRects() {
+    std::vector<RECT> rects;
+    EnumDisplayMonitors(nullptr, nullptr, [](HMONITOR mon, HDC, LPRECT, LPARAM lp) -> BOOL {
+        MONITORINFO mi{};
+        mi.cbSize = sizeof(mi);
+        if (GetMonitorInfoW(mon, &mi)) ((std::vector<RECT>*)lp)->push_back(mi.rcMonitor);
+        return TRUE;
+        }, (LPARAM)&rects);
+    return rects;
+}
 
-            if (!g_hasSelection) { InvalidateRect(hwnd, nullptr, TRUE); return 0; }
+// Zoals een hotkey-capture, maar zonder overlay: open previews gaan even weg. false =
+// het antwoord volgt later (PipeCaptureDone, als de capture-sequencer klaar is).
+static bool PipeCapture(const std::shared_ptr<PipeJob>& job, RECT sr) {
+    PipeResponse& resp = job->resp;
+    if (g_hwndOverlay || g_burst.active || g_rec.active || g_scroll.active || CaptureFlowBusy()) {
+        resp.status = PipeStatus::Busy;
+        resp.text = L"capture in progress";
+        return true;
+    }
+    const RECT vs = VirtualScreenRect();
+    if (!IntersectRect(&sr, &sr, &vs)) {
+        resp.status = PipeStatus::Error;
+        resp.text = L"rectangle is off screen";
+        return true;
+    }
 
-            RECT ow{};
-            GetWindowRect(hwnd, &ow);
+    FreeCapture();
+    g_captureHasAlpha = false;
+    g_captureSrcRect = sr;
+
+    CaptureFlowState& f = CaptureFlowBegin(CaptureKind::Pipe, nullptr, sr);
+    for (const auto& s : g_sessions.items) f.hidPreviews |= s->hwnd && IsWindowVisible(s->hwnd);
+    f.pipe = job;
+    CaptureSeqConfig cfg;
+    cfg.flushes = f.hidPreviews ? 1 : 0;
+    cfg.postProcess = true;
+    CaptureFlowStart(cfg);
+    return false;
+}
 
-            RECT sr{};
-            sr.left = ow.left + g_selRectClient.left;
-            sr.top = ow.top + g_selRectClient.top;
-            sr.right = ow.left + g_selRectClient.right;
-            sr.bottom = ow.top + g_selRectClient.bottom;
+// Einde van een pipe-capture (ses = nullptr: mislukt); maakt de wachtende pipe-thread los.
+static void PipeCaptureDone(const std::shared_ptr<PipeJob>& job, bool grabbed, CaptureSession* ses) {
+    if (!job) return;
+    PipeResponse& resp = job->resp;
+    if (!ses) {
+        resp.status = PipeStatus::Error;
+        resp.text = !grabbed ? L"capture failed"
+            : g_sessions.items.size() >= kMaxCaptureSessions ? L"too many previews with unsaved captures" : L"preview failed";
+        DebugLog(L"pipe: %s", resp.text.c_str());
+        SetEvent(job->done);
+        return;
+    }
+    ses->mode = job->req.op == PipeOp::CaptureMonitor ? Mode::Monitor : Mode::Region;
 
-            g_tempEditFile.clear();
-        CaptureScreenRectAndShowPreview(hwnd, sr);
-        return 0;
+    if (job->req.flags & kPipeFlagSave) {
+        if (!SaveSession(*ses, &resp.text)) {
+            resp.status = PipeStatus::Error;
+            resp.text = L"save failed";
         }
+        DestroyPreview(*ses);
+    }
+    else {
+        wchar_t size[64];
+        swprintf_s(size, L"%dx%d", ses->w, ses->h);
+        resp.text = size;
+    }
+    DebugLog(L"pipe: capture -> status %d", (int)resp.status);
+    SetEvent(job->done);
+}
 
-        // Window/Monitor: capture on click
-        POINT pt{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-        ClientToScreen(hwnd, &pt);
+// false = antwoord volgt later (capture loopt nog).
+static bool PipeRunCommand(const std::shared_ptr<PipeJob>& job) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const PipeRequest& req = job->req;
+    PipeResponse& resp = job->resp;
+    resp = PipeResponse{ PipeStatus::Ok, req.id, L"" };
+    bool answered = true;
+    switch (req.op) {
+    case PipeOp::Ping:
+        resp.text = L"pong";
+        break;
 
-        RECT sr{};
-        bool have = false;
-        HWND picked = nullptr;
+    case PipeOp::GetLastPath:
+        resp.text = g_lastSavedFile;
+        if (resp.text.empty()) {
+            resp.status = PipeStatus::Error;
+            resp.text = L"nothing saved yet";
+        }
+        break;
 
-        if (g_mode == Mode::Window) {
-            picked = PickTopWindowAtPoint(pt, sr);
-            have = (picked != nullptr);
+    case PipeOp::SetFormat:
+        g_saveFormat = (SaveFormat)req.format;
+        SaveSettings();
+        resp.text = SaveFormatText(g_saveFormat);
+        break;
+
+    case PipeOp::CaptureRegion: {
+        if (req.w <= 0 || req.h <= 0) {
+            resp.status = PipeStatus::BadRequest;
+            resp.text = L"empty rectangle";
+            break;
         }
-else if (g_mode == Mode::Monitor) {
-            have = GetMonitorRectAtPoint(pt, sr);
+        const RECT sr{ req.x, req.y, (LONG)((int64_t)req.x + req.w), (LONG)((int64_t)req.y + req.h) };
+        answered = PipeCapture(job, sr);
+        break;
+    }
+
+    case PipeOp::CaptureMonitor: {
+        RECT mr{};
+        if (req.monitor < 0) {
+            POINT pt{};
+            GetCursorPos(&pt);
+            if (!GetMonitorRectAtPoint(pt, mr)) mr = {};
         }
         else {
-            // Freestyle (Lasso) is added to the menu, implementation follows later.
-            MessageBeep(MB_ICONWARNING);
-            ClearHover();
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return 0;
+            const std::vector<RECT> mons = MonitorRects();
+            if ((size_t)req.monitor < mons.size()) mr = mons[(size_t)req.monitor];
         }
-
-        if (!have) {
-            MessageBeep(MB_ICONWARNING);
-            ClearHover();
-            InvalidateRect(hwnd, nullptr, TRUE);
-            return 0;
+        if (IsRectEmpty(&mr)) {
+            resp.status = PipeStatus::Error;
+            resp.text = L"no such monitor";
+            break;
         }
-
-        g_tempEditFile.clear();
-        CaptureScreenRectAndShowPreview(hwnd, sr, picked);
-        return 0;
+        answered = PipeCapture(job, mr);
+        break;
     }
 
-    case WM_KEYDOWN:
-        if (wParam == VK_ESCAPE) {
-            if (g_polySelecting) {
-                PolyReset();
-                ReleaseCapture();
-                InvalidateRect(hwnd, nullptr, TRUE);
-                return 0;
-            }
-            if (g_lassoSelecting) {
-                LassoReset();
-                ReleaseCapture();
-                InvalidateRect(hwnd, nullptr, TRUE);
-                return 0;
-            }
-            if (g_selecting) {
-                g_selecting = false;
-                g_hasSelection = false;
-                ReleaseCapture();
-                InvalidateRect(hwnd, nullptr, TRUE);
-            }
-            else {
-                DestroyOverlay();
-            }
-            return 0;
-        }
+    default:
+        resp.status = PipeStatus::BadRequest;
+        break;
+    }
+    if (answered) DebugLog(L"pipe: op %d -> status %d in %.2f ms", (int)req.op, (int)resp.status, MsSince(t0));
+    else DebugLog(L"pipe: op %d -> capture started in %.2f ms", (int)req.op, MsSince(t0));
+    return answered;
+}
 
-        if (g_mode == Mode::Polygon && g_polySelecting) {
-            if (wParam == VK_RETURN) {
-                PolygonFinalize(hwnd);
-                return 0;
-            }
-            if (wParam == VK_BACK) {
-                PolyUndoLast();
-                InvalidateRect(hwnd, nullptr, TRUE);
-                return 0;
-            }
-        }
+// WM_PIPE_COMMAND (lParam = new std::shared_ptr<PipeJob>)
+static void PipeHandleMessage(LPARAM lParam) {
+    std::unique_ptr<std::shared_ptr<PipeJob>> msg((std::shared_ptr<PipeJob>*)lParam);
+    PipeJobState queued = PipeJobState::Queued;
+    if (!(*msg)->state.compare_exchange_strong(queued, PipeJobState::Running)) {
+        DebugLog(L"pipe: op %d cancelled (client got 'busy'), skipped", (int)(*msg)->req.op);
+        return;
+    }
+    if (PipeRunCommand(*msg)) SetEvent((*msg)->done);
+}
 
-        return 0;
+// ---- client (tweede start van de exe)
+static HANDLE PipeConnect() {
+    const std::wstring name = PipeName();
+    for (int attempt = 0; attempt < 10; ++attempt) {
+        HANDLE h = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (h != INVALID_HANDLE_VALUE) return h;
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(name.c_str(), kPipeConnectWaitMs)) break;
+    }
+    return INVALID_HANDLE_VALUE;
+}
 
-    case WM_COMMAND:
-        switch (LOWORD(wParam)) {
-        case 1001: g_mode = g_lastMode = Mode::Region;    ClearHover(); SaveSettings(); break;
-        case 1002: g_mode = g_lastMode = Mode::Window;    ClearHover(); SaveSettings(); break;
-        case 1003: g_mode = g_lastMode = Mode::Monitor;   ClearHover(); SaveSettings(); break;
-        case 1004: g_mode = g_lastMode = Mode::Freestyle; ClearHover(); SaveSettings(); break;
-        case 1005: g_mode = g_lastMode = Mode::Polygon;  ClearHover(); SaveSettings(); break;
-        default: break;
-        }
-        InvalidateRect(hwnd, nullptr, TRUE);
-        return 0;
+static bool PipeTransact(HANDLE h, const PipeRequest& req, PipeResponse& resp) {
+    std::vector<uint8_t> frame;
+    PipeEncodeRequest(req, frame);
+    DWORD n = 0;
+    if (!WriteFile(h, frame.data(), (DWORD)frame.size(), &n, nullptr) || n != frame.size()) return false;
+
+    std::vector<uint8_t> in;
+    uint8_t buf[4096];
+    for (;;) {
+        size_t used = 0;
+        const PipeDecode d = PipeDecodeResponse(in.data(), in.size(), resp, used);
+        if (d == PipeDecode::Ok) return resp.id == req.id;
+        if (d != PipeDecode::NeedMore) return false;
+        if (!ReadFile(h, buf, sizeof(buf), &n, nullptr) || n == 0) return false;
+        in.insert(in.end(), buf, buf + n);
+    }
+}
 
-    case WM_PAINT: {
-        PAINTSTRUCT ps{};
-        HDC hdc = BeginPaint(hwnd, &ps);
+#endif // !SNIP_CORE_ONLY
 
-        RECT r{};
-        GetClientRect(hwnd, &r);
-        HBRUSH bg = CreateSolidBrush(RGB(0, 0, 0));
-        FillRect(hdc, &r, bg);
-        DeleteObject(bg);
+#if !defined(_WIN32)
+// =========================================================
+// Command-kanaal: Unix-socket (POSIX)
+// =========================================================
+// Zelfde frames als de named pipe, voor een niet-Windows bouw van de kern (en de tests
+// in tests/). Gebruikt accept4/MSG_NOSIGNAL (Linux, de BSD's). $XDG_RUNTIME_DIR/snip-lite.sock, anders /tmp/snip-lite-<uid>.sock; de
+// socket is alleen voor de eigenaar (0600). Eén client tegelijk, zoals bij de pipe; de
+// handler draait op de server-thread.
+struct UnixCommandServer {
+    std::string path;
+    int listenFd = -1;
+    int wake[2] = { -1, -1 };   // stop: één byte naar wake[1]
+    std::thread thread;
+};
+
+static std::string UnixCommandSocketPath() {
+    const char* dir = std::getenv("XDG_RUNTIME_DIR");
+    if (dir && *dir) return std::string(dir) + "/snip-lite.sock";
+    return "/tmp/snip-lite-" + std::to_string((unsigned long)getuid()) + ".sock";
+}
 
-        SetBkMode(hdc, TRANSPARENT);
-        SetTextColor(hdc, RGB(255, 255, 255));
-        RECT tr = r;
-        tr.left += 20; tr.top += 20;
-        DrawTextW(hdc, ModeText(g_mode), -1, &tr, DT_LEFT | DT_TOP | DT_SINGLELINE);
+static bool UnixFillAddress(const std::string& path, sockaddr_un& addr) {
+    addr = sockaddr_un{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
 
-        if (g_mode == Mode::Freestyle && (g_lassoSelecting || g_lassoPtsClient.size() >= 2)) {
-            if (g_lassoPtsClient.size() >= 2) {
-                HPEN pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
-                HGDIOBJ oldPen = SelectObject(hdc, pen);
-                HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+static bool UnixWriteAll(int fd, const uint8_t* p, size_t n) {
+    while (n > 0) {
+        const ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return false;
+        p += k;
+        n -= (size_t)k;
+    }
+    return true;
+}
 
-                Polyline(hdc, g_lassoPtsClient.data(), (int)g_lassoPtsClient.size());
+// Wacht tot fd leesbaar is; false bij stop of fout.
+static bool UnixWaitReadable(const UnixCommandServer& srv, int fd) {
+    pollfd fds[2] = { { fd, POLLIN, 0 }, { srv.wake[0], POLLIN, 0 } };
+    for (;;) {
+        const int r = poll(fds, 2, -1);
+        if (r < 0 && errno == EINTR) continue;
+        return r > 0 && !(fds[1].revents & POLLIN) && (fds[0].revents & (POLLIN | POLLHUP | POLLERR));
+    }
+}
 
-                // optioneel: bounding box (handig bij debug)
-                // Rectangle(hdc, g_lassoBoundsClient.left, g_lassoBoundsClient.top,
-                //           g_lassoBoundsClient.right, g_lassoBoundsClient.bottom);
+template <class Handler>
+static void UnixServeClient(const UnixCommandServer& srv, int fd, Handler& handler) {
+    std::vector<uint8_t> in, out;
+    uint8_t buf[512];
+    while (UnixWaitReadable(srv, fd)) {
+        const ssize_t got = recv(fd, buf, sizeof(buf), 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return;
+        in.insert(in.end(), buf, buf + got);
+        out.clear();
+        const bool keep = PipeServeFrames(in, out, handler);
+        if (!out.empty() && !UnixWriteAll(fd, out.data(), out.size())) return;
+        if (!keep) return;
+    }
+}
 
-                SelectObject(hdc, oldBrush);
-                SelectObject(hdc, oldPen);
-                DeleteObject(pen);
-            }
+// handler(const PipeRequest&) -> PipeResponse. false als de socket niet te maken is
+// (pad te lang, of er luistert al een server op dit pad).
+static bool UnixCommandServerStart(UnixCommandServer& srv, const std::string& path,
+    std::function<PipeResponse(const PipeRequest&)> handler) {
+    sockaddr_un addr{};
+    if (srv.thread.joinable() || !UnixFillAddress(path, addr)) return false;
+
+    // een achtergebleven socket van een gecrasht proces opruimen, een levende niet
+    const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) return false;
+    const bool alive = connect(probe, (const sockaddr*)&addr, sizeof(addr)) == 0;
+    close(probe);
+    if (alive) return false;
+    unlink(path.c_str());
+
+    srv.listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (srv.listenFd < 0) return false;
+    if (bind(srv.listenFd, (const sockaddr*)&addr, sizeof(addr)) != 0 || chmod(path.c_str(), 0600) != 0 ||
+        listen(srv.listenFd, 8) != 0 || pipe(srv.wake) != 0) {
+        close(srv.listenFd);
+        srv.listenFd = -1;
+        unlink(path.c_str());
+        return false;
+    }
+    srv.path = path;
+    srv.thread = std::thread([&srv, handler = std::move(handler)]() mutable {
+        while (UnixWaitReadable(srv, srv.listenFd)) {
+            const int fd = accept4(srv.listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) continue;
+            UnixServeClient(srv, fd, handler);
+            close(fd);
         }
+        });
+    return true;
+}
 
-        if (g_mode == Mode::Polygon && (g_polySelecting || g_polyPtsClient.size() >= 1)) {
-            HPEN pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
-            HGDIOBJ oldPen = SelectObject(hdc, pen);
-            HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
-
-            // vaste edges
-            if (g_polyPtsClient.size() >= 2) {
-                Polyline(hdc, g_polyPtsClient.data(), (int)g_polyPtsClient.size());
-            }
+static void UnixCommandServerStop(UnixCommandServer& srv) {
+    if (!srv.thread.joinable()) return;
+    const uint8_t one = 1;
+    while (write(srv.wake[1], &one, 1) < 0 && errno == EINTR) {}
+    srv.thread.join();
+    close(srv.listenFd);
+    close(srv.wake[0]);
+    close(srv.wake[1]);
+    srv.listenFd = srv.wake[0] = srv.wake[1] = -1;
+    unlink(srv.path.c_str());
+}
 
-            // rubber-band (laatste punt -> hover), met “close hint” (hover -> eerste)
-            if (g_polySelecting && g_polyHoverValid && !g_polyPtsClient.empty()) {
-                POINT last = g_polyPtsClient.back();
-                MoveToEx(hdc, last.x, last.y, nullptr);
-                LineTo(hdc, g_polyHoverClient.x, g_polyHoverClient.y);
+// ---- client; -1 = geen server op dit pad
+static int UnixCommandConnect(const std::string& path) {
+    sockaddr_un addr{};
+    if (!UnixFillAddress(path, addr)) return -1;
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
-                if (g_polyPtsClient.size() >= 3 && NearPoint(g_polyHoverClient, g_polyPtsClient.front(), 10)) {
-                    MoveToEx(hdc, g_polyHoverClient.x, g_polyHoverClient.y, nullptr);
-                    LineTo(hdc, g_polyPtsClient.front().x, g_polyPtsClient.front().y);
-                }
-            }
+static bool UnixCommandTransact(int fd, const PipeRequest& req, PipeResponse& resp) {
+    std::vector<uint8_t> frame;
+    PipeEncodeRequest(req, frame);
+    if (!UnixWriteAll(fd, frame.data(), frame.size())) return false;
+
+    std::vector<uint8_t> in;
+    uint8_t buf[4096];
+    for (;;) {
+        size_t used = 0;
+        const PipeDecode d = PipeDecodeResponse(in.data(), in.size(), resp, used);
+        if (d == PipeDecode::Ok) return resp.id == req.id;
+        if (d != PipeDecode::NeedMore) return false;
+        const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        in.insert(in.end(), buf, buf + n);
+    }
+}
+#endif // !_WIN32
 
-            // vertices (kleine cirkels)
-            SelectObject(hdc, GetStockObject(NULL_BRUSH));
-            constexpr int kVtxR = 3;
-            for (auto p : g_polyPtsClient) {
-                Ellipse(hdc,
-                    p.x - kVtxR, p.y - kVtxR,
-                    p.x + kVtxR + 1, p.y + kVtxR + 1);
-            }
+// =========================================================
+// Gedeelde laatste capture: layout + seqlock (portable, geen Win32)
+// =========================================================
+// Lokale tools lezen de nieuwste capture rechtstreeks uit gedeeld geheugen (geen
+// clipboard, geen PNG decoderen, geen kopie). Layout, little-endian:
+//   0         ShmHeader (64 bytes)
+//   64        ShmSlot[2] (2 x 64 bytes)
+//   65536     pixels slot 0; slot 1 op 65536 + slotBytes. BGRA, top-down, stride = w * 4.
+//             64K-grens: een lezer kan ook alleen de header en één slot mappen.
+// Dubbel gebufferd: frame n gaat naar slot n & 1, dus het slot van het nieuwste frame
+// wordt pas bij frame n + 2 weer beschreven. Per slot een seqlock: seq is oneven tijdens
+// het schrijven en 2n als frame n compleet is; daarna pas header.published = n.
+// Lezer: n = published, slot n & 1, seq == 2n -> pixels ter plekke gebruiken -> seq nog
+// steeds 2n? Dan waren ze heel; anders weggooien (de schrijver is twee frames verder).
+static constexpr char kShmMagic[8] = { 'S','N','I','P','S','H','M','1' };
+static constexpr uint32_t kShmVersion = 1;
+static constexpr uint64_t kShmPixelsOffset = 65536;
+static constexpr uint32_t kShmFlagAlpha = 1;       // alpha-kanaal telt (Freestyle/Polygon)
+static constexpr int kShmCopyMinRows = 256;        // per band bij het kopiëren
+
+struct ShmHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotCount;                  // 2
+    uint64_t pixelsOffset;
+    uint64_t slotBytes;                  // capaciteit per slot
+    std::atomic<uint64_t> published;     // nieuwste complete frame, 0 = nog niets
+    uint64_t reserved[3];
+};
+
+struct ShmSlot {
+    std::atomic<uint64_t> seq;
+    uint64_t frame;
+    uint32_t w, h, stride, flags;
+    int32_t left, top;                   // schermpositie van de capture
+    uint64_t time;                       // FILETIME-ticks (UTC) van de capture
+    uint64_t reserved[2];
+};
+static_assert(sizeof(ShmHeader) == 64 && sizeof(ShmSlot) == 64, "shm layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm atomics moeten lock-free zijn (tussen processen)");
+
+static inline ShmHeader* ShmHeaderOf(uint8_t* base) { return reinterpret_cast<ShmHeader*>(base); }
+static inline const ShmHeader* ShmHeaderOf(const uint8_t* base) { return reinterpret_cast<const ShmHeader*>(base); }
+static inline ShmSlot* ShmSlotOf(uint8_t* base, uint64_t frame) { return reinterpret_cast<ShmSlot*>(base + 64) + (frame & 1); }
+static inline const ShmSlot* ShmSlotOf(const uint8_t* base, uint64_t frame) { return reinterpret_cast<const ShmSlot*>(base + 64) + (frame & 1); }
+
+static uint64_t ShmTotalBytes(uint64_t slotBytes) {
+    return kShmPixelsOffset + 2 * slotBytes;
+}
 
-            SelectObject(hdc, oldBrush);
-            SelectObject(hdc, oldPen);
-            DeleteObject(pen);
-        }
+// Klopt de header (magic, versie, past alles in mapped bytes)?
+static bool ShmHeaderValid(const uint8_t* base, uint64_t mapped) {
+    const ShmHeader* hd = ShmHeaderOf(base);
+    return mapped >= kShmPixelsOffset && std::memcmp(hd->magic, kShmMagic, 8) == 0 && hd->version == kShmVersion &&
+        hd->slotCount == 2 && hd->pixelsOffset == kShmPixelsOffset && hd->slotBytes <= (mapped - kShmPixelsOffset) / 2;
+}
 
-        if (g_mode == Mode::Region && g_selecting) {
+// Nieuw (nul-gevuld) blok.
+static void ShmInit(uint8_t* base, uint64_t slotBytes) {
+    std::memset(base, 0, 64 * 3);
+    ShmHeader* hd = ShmHeaderOf(base);
+    hd->version = kShmVersion;
+    hd->slotCount = 2;
+    hd->pixelsOffset = kShmPixelsOffset;
+    hd->slotBytes = slotBytes;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(hd->magic, kShmMagic, 8);   // als laatste: een lezer ziet geen half blok
+}
 
-            // clamp naar client
-            RECT client{};
-            GetClientRect(hwnd, &client);
+// Alleen de schrijver (één proces). Kopieert de pixels naar het volgende slot (rijbanden
+// parallel) en publiceert. 0 = past niet in een slot, anders het framenummer.
+static uint64_t ShmPublish(uint8_t* base, const uint8_t* top, ptrdiff_t stride, int w, int h, uint32_t flags,
+    int32_t left, int32_t topY, uint64_t time) {
+    ShmHeader* hd = ShmHeaderOf(base);
+    const size_t rowBytes = (size_t)w * 4;
+    if (w <= 0 || h <= 0 || (uint64_t)rowBytes * (uint64_t)h > hd->slotBytes) return 0;
+
+    const uint64_t frame = hd->published.load(std::memory_order_relaxed) + 1;
+    ShmSlot* s = ShmSlotOf(base, frame);
+    s->seq.store(2 * frame - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s->frame = frame;
+    s->w = (uint32_t)w;
+    s->h = (uint32_t)h;
+    s->stride = (uint32_t)rowBytes;
+    s->flags = flags;
+    s->left = left;
+    s->top = topY;
+    s->time = time;
+    uint8_t* dst = base + hd->pixelsOffset + (frame & 1) * hd->slotBytes;
+    ParallelForBands(h, kShmCopyMinRows, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y) std::memcpy(dst + (size_t)y * rowBytes, top + (ptrdiff_t)y * stride, rowBytes);
+        });
+
+    s->seq.store(2 * frame, std::memory_order_release);
+    hd->published.store(frame, std::memory_order_release);
+    return frame;
+}
 
-            RECT s = g_selRectClient;
-            RECT ss{};
-            if (IntersectRect(&ss, &s, &client)) {
+// Lezer-kant: ShmReadBegin, pixels gebruiken (niet vasthouden), dan ShmReadValid.
+struct ShmFrame {
+    const uint8_t* px = nullptr;         // in de mapping (geen kopie)
+    int w = 0, h = 0;
+    uint32_t stride = 0, flags = 0;
+    int32_t left = 0, top = 0;
+    uint64_t frame = 0, time = 0;
+    uint64_t seq = 0;
+    const ShmSlot* slot = nullptr;
+};
+
+// false = nog niets gepubliceerd, of het slot wordt net overschreven (opnieuw proberen).
+static bool ShmReadBegin(const uint8_t* base, uint64_t mapped, ShmFrame& out) {
+    out = ShmFrame{};
+    if (!ShmHeaderValid(base, mapped)) return false;
+    const ShmHeader* hd = ShmHeaderOf(base);
+    const uint64_t slotBytes = hd->slotBytes;   // één keer lezen: de schrijver is een ander proces
+    if (slotBytes > (mapped - kShmPixelsOffset) / 2) return false;
+    const uint64_t frame = hd->published.load(std::memory_order_acquire);
+    if (frame == 0) return false;
+    const ShmSlot* s = ShmSlotOf(base, frame);
+    const uint64_t seq = s->seq.load(std::memory_order_acquire);
+    if (seq != 2 * frame) return false;
+
+    out.w = (int)s->w;
+    out.h = (int)s->h;
+    out.stride = s->stride;
+    out.flags = s->flags;
+    out.left = s->left;
+    out.top = s->top;
+    out.frame = s->frame;
+    out.time = s->time;
+    out.seq = seq;
+    out.slot = s;
+    if (out.frame != frame || (uint64_t)out.stride != (uint64_t)(uint32_t)out.w * 4 || (uint64_t)out.stride * (uint32_t)out.h > slotBytes) return false;
+    out.px = base + kShmPixelsOffset + (frame & 1) * slotBytes;
+    return true;
+}
 
-                // (A) Oplichten: vulling binnen selectie
-                // Kies een kleur die duidelijk lichter is dan jouw overlay-achtergrond
-                HBRUSH lit = CreateSolidBrush(RGB(60, 60, 60));
-                FillRect(hdc, &ss, lit);
-                DeleteObject(lit);
+// Na het lezen: true = wat er gelezen is hoort bij één compleet frame.
+static bool ShmReadValid(const ShmFrame& f) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return f.slot && f.slot->seq.load(std::memory_order_relaxed) == f.seq;
+}
 
-                // (B) Witte outline zoals nu
-                HPEN pen = CreatePen(PS_SOLID, 2, RGB(255, 255, 255));
-                HGDIOBJ oldPen = SelectObject(hdc, pen);
-                HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
-                Rectangle(hdc, ss.left, ss.top, ss.right, ss.bottom);
+#if !defined(_WIN32)
+// =========================================================
+// Gedeelde laatste capture: POSIX shm (shm_open + mmap)
+// =========================================================
+// Zelfde layout en seqlock als hierboven, in een POSIX shared-memory-object (Linux:
+// /dev/shm). ftruncate maakt het object sparse: alleen beschreven pagina's kosten
+// geheugen, zoals SEC_RESERVE. Geen events: een lezer kijkt elke kShmPollMs naar
+// published. Heeft een bestaand object een andere maat (oudere build), dan maakt de
+// schrijver een nieuw aan onder dezelfde naam; lezers van het oude houden dat tot ze sluiten.
+static constexpr int kShmPollMs = 1;
+
+struct ShmPosixMap {
+    int fd = -1;
+    uint8_t* base = nullptr;
+    uint64_t bytes = 0;                  // werkelijke grootte (fstat), niet aangenomen
+};
+
+static std::string ShmPosixName() {
+    return "/snip-lite-latest-" + std::to_string((unsigned long)getuid());
+}
 
-                SelectObject(hdc, oldBrush);
-                SelectObject(hdc, oldPen);
-                DeleteObject(pen);
-            }
-        }
-        else if (g_hoverValid) {
-            HPEN pen = CreatePen(PS_SOLID, 2, RGB(100, 200, 255));
-            HGDIOBJ oldPen = SelectObject(hdc, pen);
-            HGDIOBJ oldBrush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
-            Rectangle(hdc, g_hoverRectClient.left, g_hoverRectClient.top, g_hoverRectClient.right, g_hoverRectClient.bottom);
-            SelectObject(hdc, oldBrush);
-            SelectObject(hdc, oldPen);
-            DeleteObject(pen);
-        }
-        if (g_cursorValid) {
-            DrawOutlinedCrosshair(hdc, g_cursorPt.x, g_cursorPt.y);
-        }
+static void ShmPosixClose(ShmPosixMap& m) {
+    if (m.base) munmap(m.base, (size_t)m.bytes);
+    if (m.fd >= 0) close(m.fd);
+    m = ShmPosixMap{};
+}
 
-        EndPaint(hwnd, &ps);
-        return 0;
+static bool ShmPosixOpenWriter(ShmPosixMap& m, const std::string& name, uint64_t slotBytes) {
+    ShmPosixClose(m);
+    const uint64_t total = ShmTotalBytes(slotBytes);
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    struct stat st {};
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    bool fresh = st.st_size == 0;
+    if (!fresh && (uint64_t)st.st_size != total) {   // andere maat: opnieuw aanmaken
+        close(fd);
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        fresh = true;
     }
+    if (fd < 0 || (fresh && ftruncate(fd, (off_t)total) != 0)) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, (size_t)total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    m.fd = fd;
+    m.base = (uint8_t*)p;
+    m.bytes = total;
+    // bestaand blok van een vorige run: framenummers lopen door
+    if (fresh || !ShmHeaderValid(m.base, m.bytes) || ShmHeaderOf(m.base)->slotBytes != slotBytes) ShmInit(m.base, slotBytes);
+    return true;
+}
 
-    case WM_DESTROY:
-        return 0;
-		}
-   return DefWindowProcW(hwnd, msg, wParam, lParam);
+// Alleen-lezen, met de maat die het object werkelijk heeft. false = (nog) geen geldig blok.
+static bool ShmPosixOpenReader(ShmPosixMap& m, const std::string& name) {
+    ShmPosixClose(m);
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    struct stat st {};
+    if (fd < 0 || fstat(fd, &st) != 0 || (uint64_t)st.st_size < kShmPixelsOffset) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    m.fd = fd;
+    m.base = (uint8_t*)p;
+    m.bytes = (uint64_t)st.st_size;
+    if (ShmHeaderValid(m.base, m.bytes)) return true;
+    ShmPosixClose(m);
+    return false;
 }
-    
-static void CreateOverlay() {
-    if (g_hwndOverlay) return;
-	ClearHover();
 
-    static bool registered = false;
-    if (!registered) {
-        WNDCLASSW wc{};
-        wc.lpfnWndProc = OverlayProc;
-        wc.hInstance = g_hInst;
-        wc.lpszClassName = L"SnipLiteOverlay";
-        wc.hCursor = LoadCursorW(nullptr, IDC_CROSS);
-        RegisterClassW(&wc);
-        registered = true;
+// Wachten op een frame nieuwer dan 'after' (pollen). true = out is gelezen met
+// ShmReadBegin; de aanroeper gebruikt de pixels en controleert met ShmReadValid.
+static bool ShmPosixWait(const ShmPosixMap& m, uint64_t after, int timeoutMs, ShmFrame& out) {
+    const auto t0 = std::chrono::steady_clock::now();
+    for (;;) {
+        if (ShmHeaderOf(m.base)->published.load(std::memory_order_acquire) > after && ShmReadBegin(m.base, m.bytes, out)) return true;
+        if (MsSince(t0) >= timeoutMs) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(kShmPollMs));
     }
+}
+#endif // !_WIN32
 
-    const RECT vr = VirtualScreenRect();
+#if !SNIP_CORE_ONLY
+// =========================================================
+// Gedeelde laatste capture (Win32: section + events; lezer: --shm-wait)
+// =========================================================
+// Local\snip-lite-latest: pagefile-backed section met SEC_RESERVE. De 2 slots worden
+// gereserveerd en pas gecommit tot de grootste capture tot nu toe, dus kost het geen
+// commit-geheugen voor captures die nooit komen. Events Local\snip-lite-latest-0/-1
+// (manual-reset): frame n zet event n & 1 en reset het andere, zodat een lezer die
+// frame n heeft gezien op event (n + 1) & 1 wacht (één event per pariteit: meerdere
+// lezers, geen PulseEvent). Alleen de UI-thread publiceert.
+static constexpr uint64_t kShmSlotBytes = 256ull << 20;   // 8192 x 8192 BGRA; groter wordt overgeslagen
+static constexpr wchar_t kShmName[] = L"Local\\snip-lite-latest";
+static constexpr DWORD kShmWaitSliceMs = 250;             // lezer: seq opnieuw bekijken (gemiste wake-up)
+
+struct ShmState {
+    HANDLE section = nullptr;
+    uint8_t* view = nullptr;
+    HANDLE ready[2]{};
+    uint64_t committed = 0;   // per slot
+};
+static ShmState g_shm;
+
+static std::wstring ShmEventName(uint64_t parity) {
+    return std::wstring(kShmName) + L"-" + std::to_wstring(parity & 1);
+}
 
-    g_hwndOverlay = CreateWindowExW(
-        WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TOOLWINDOW,
-        L"SnipLiteOverlay",
-        L"",
-        WS_POPUP,
-        vr.left, vr.top,
-        vr.right - vr.left, vr.bottom - vr.top,
-        nullptr, nullptr, g_hInst, nullptr
-    );
+static void ShmClose() {
+    if (g_shm.view) UnmapViewOfFile(g_shm.view);
+    if (g_shm.section) CloseHandle(g_shm.section);
+    for (HANDLE& e : g_shm.ready) {
+        if (e) CloseHandle(e);
+        e = nullptr;
+    }
+    g_shm.view = nullptr;
+    g_shm.section = nullptr;
+    g_shm.committed = 0;
+}
 
-    SetLayeredWindowAttributes(g_hwndOverlay, 0, (BYTE)120, LWA_ALPHA);
+// Werkelijke grootte van een view: alle regio's vanaf de basis met dezelfde AllocationBase
+// (gereserveerd en gecommit). Een bestaande section hoeft niet onze maat te hebben.
+static uint64_t ShmViewBytes(const void* view) {
+    uint64_t total = 0;
+    MEMORY_BASIC_INFORMATION mbi{};
+    while (VirtualQuery((const uint8_t*)view + total, &mbi, sizeof(mbi)) == sizeof(mbi) && mbi.AllocationBase == view && mbi.RegionSize)
+        total += mbi.RegionSize;
+    return total;
+}
 
-    ShowWindow(g_hwndOverlay, SW_SHOW);
-    SetForegroundWindow(g_hwndOverlay);
-    SetFocus(g_hwndOverlay);
+static bool ShmOpenWriter() {
+    if (g_shm.view) return true;
+    const uint64_t total = ShmTotalBytes(kShmSlotBytes);
+    g_shm.section = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE | SEC_RESERVE,
+        (DWORD)(total >> 32), (DWORD)total, kShmName);
+    const bool existed = GetLastError() == ERROR_ALREADY_EXISTS;   // een lezer hield hem open
+    if (g_shm.section) g_shm.view = (uint8_t*)MapViewOfFile(g_shm.section, FILE_MAP_WRITE, 0, 0, 0);
+    // Een lezer van een oudere build kan een kleinere section openhouden: dan niet publiceren
+    // en loslaten. Zodra die lezer sluit, maakt de volgende capture hem opnieuw aan.
+    const uint64_t mapped = g_shm.view ? ShmViewBytes(g_shm.view) : 0;
+    if (g_shm.view && mapped < total) {
+        DebugLog(L"shm: existing section is %llu bytes (need %llu), held by a reader; not published",
+            (unsigned long long)mapped, (unsigned long long)total);
+        ShmClose();
+        return false;
+    }
+    if (!g_shm.view || !VirtualAlloc(g_shm.view, kShmPixelsOffset, MEM_COMMIT, PAGE_READWRITE)) {
+        DebugLog(L"shm: section not available (%lu)", GetLastError());
+        ShmClose();
+        return false;
+    }
+    // bestaand blok van een vorige run: framenummers lopen door
+    if (!existed || !ShmHeaderValid(g_shm.view, mapped) || ShmHeaderOf(g_shm.view)->slotBytes != kShmSlotBytes) {
+        ShmInit(g_shm.view, kShmSlotBytes);
+    }
+    for (uint64_t p = 0; p < 2; ++p) g_shm.ready[p] = CreateEventW(nullptr, TRUE, FALSE, ShmEventName(p).c_str());
+    return true;
+}
+
+// OpenCaptureSession: elke nieuwe capture (origineel, zonder latere annotaties).
+static void ShmPublishCapture(const CaptureSession& ses) {
+    if (!g_publishShm) return;
+    uint8_t* top = nullptr;
+    ptrdiff_t stride = 0;
+    int w = 0, h = 0;
+    if (!DibTopDownView(ses.bmp, top, stride, w, h)) return;
+    const uint64_t bytes = (uint64_t)w * 4 * (uint64_t)h;
+    if (bytes > kShmSlotBytes) {
+        DebugLog(L"shm: %dx%d does not fit a slot, not published", w, h);
+        return;
+    }
+    if (!ShmOpenWriter()) return;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    if (bytes > g_shm.committed) {
+        for (uint64_t s = 0; s < 2; ++s) {
+            if (!VirtualAlloc(g_shm.view + kShmPixelsOffset + s * kShmSlotBytes, (SIZE_T)bytes, MEM_COMMIT, PAGE_READWRITE)) {
+                DebugLog(L"shm: commit of %llu bytes failed (%lu)", (unsigned long long)bytes, GetLastError());
+                return;
+            }
+        }
+        g_shm.committed = bytes;
+    }
+    const uint64_t frame = ShmPublish(g_shm.view, top, stride, w, h, ses.hasAlpha ? kShmFlagAlpha : 0,
+        ses.srcRect.left, ses.srcRect.top, NowTicks());
+    if (!frame) return;
+    if (g_shm.ready[(frame + 1) & 1]) ResetEvent(g_shm.ready[(frame + 1) & 1]);
+    if (g_shm.ready[frame & 1]) SetEvent(g_shm.ready[frame & 1]);
+    DebugLog(L"shm: frame %llu (%dx%d) published in %.2f ms", (unsigned long long)frame, w, h, MsSince(t0));
 }
 
 // =========================================================
@@ -2683,7 +13514,6 @@ static void CreateOverlay() {
 // =========================================================
 static void StartCapture(Mode m) {
     g_mode = m;
-    if (g_hwndPreview) DestroyPreview();
     if (g_hwndOverlay) DestroyOverlay();
     CreateOverlay();
 }
@@ -2722,6 +13552,22 @@ static void TrayAdd(HWND hwnd) {
     g_trayAdded = Shell_NotifyIconW(NIM_ADD, &g_nid) != FALSE;
 }
 
+static void TraySetTip(const wchar_t* tip) {
+    if (!g_trayAdded) return;
+    g_nid.uFlags = NIF_TIP;
+    StringCchCopyW(g_nid.szTip, _countof(g_nid.szTip), tip);
+    Shell_NotifyIconW(NIM_MODIFY, &g_nid);
+}
+
+static void TrayNotify(const wchar_t* title, const wchar_t* text) {
+    if (!g_trayAdded) return;
+    g_nid.uFlags = NIF_INFO;
+    g_nid.dwInfoFlags = NIIF_INFO;
+    StringCchCopyW(g_nid.szInfoTitle, _countof(g_nid.szInfoTitle), title);
+    StringCchCopyW(g_nid.szInfo, _countof(g_nid.szInfo), text);
+    Shell_NotifyIconW(NIM_MODIFY, &g_nid);
+}
+
 static void TrayRemove() {
     if (!g_trayAdded) return;
     Shell_NotifyIconW(NIM_DELETE, &g_nid);
@@ -2731,6 +13577,17 @@ static void TrayRemove() {
 static void TrayShowMenu(HWND hwnd) {
     HMENU menu = CreatePopupMenu();
 
+    if (g_burst.active) {
+        wchar_t stopText[64]{};
+        swprintf_s(stopText, L"Stop burst (%u frames)", g_burst.writer.frames);
+        AppendMenuW(menu, MF_STRING, TRAY_BURST_STOP, stopText);
+        AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    }
+    if (g_rec.active) {
+        AppendMenuW(menu, MF_STRING, TRAY_REC_STOP, L"Stop recording");
+        AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
+    }
+
     AppendMenuW(menu, MF_STRING, TRAY_CAPTURE_NOW, L"Capture now");
     AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
 
@@ -2741,9 +13598,48 @@ static void TrayShowMenu(HWND hwnd) {
     AppendMenuW(mode, MF_STRING | MF_RADIOCHECK | (g_lastMode == Mode::Monitor ? MF_CHECKED : 0), TRAY_CAP_MONITOR, L"Monitor");
     AppendMenuW(mode, MF_STRING | MF_RADIOCHECK | (g_lastMode == Mode::Freestyle ? MF_CHECKED : 0), TRAY_CAP_FREE, L"Freestyle");
     AppendMenuW(mode, MF_STRING | MF_RADIOCHECK | (g_lastMode == Mode::Polygon  ? MF_CHECKED : 0), TRAY_CAP_POLY,    L"Polygon");
+    AppendMenuW(mode, MF_STRING | MF_RADIOCHECK | (g_lastMode == Mode::Burst    ? MF_CHECKED : 0), TRAY_CAP_BURST,   L"Burst (interval)");
+    AppendMenuW(mode, MF_STRING | MF_RADIOCHECK | (g_lastMode == Mode::Record   ? MF_CHECKED : 0), TRAY_CAP_RECORD,  L"Record (APNG)");
+    AppendMenuW(mode, MF_STRING | MF_RADIOCHECK | (g_lastMode == Mode::Scroll   ? MF_CHECKED : 0), TRAY_CAP_SCROLL,  L"Scrolling window");
 
     AppendMenuW(menu, MF_POPUP, (UINT_PTR)mode, L"Select Mode");
 
+    // --- Burst submenu (interval + export)
+    HMENU burst = CreatePopupMenu();
+    for (UINT i = 0; i < (UINT)_countof(kBurstIntervalsMs); ++i) {
+        wchar_t txt[32]{};
+        swprintf_s(txt, L"Every %d s", kBurstIntervalsMs[i] / 1000);
+        AppendMenuW(burst, MF_STRING | MF_RADIOCHECK | (g_burstIntervalMs == kBurstIntervalsMs[i] ? MF_CHECKED : 0),
+            TRAY_BURST_INT1 + i, txt);
+    }
+    AppendMenuW(burst, MF_SEPARATOR, 0, nullptr);
+    AppendMenuW(burst, MF_STRING | (g_lastBurstFile.empty() || g_burst.active ? MF_GRAYED : 0),
+        TRAY_BURST_EXPORT, L"Export last burst as PNG frames");
+    AppendMenuW(menu, MF_POPUP, (UINT_PTR)burst, L"Burst");
+
+    // --- Record submenu (fps)
+    HMENU rec = CreatePopupMenu();
+    for (UINT i = 0; i < (UINT)_countof(kRecordFpsPresets); ++i) {
+        wchar_t txt[32]{};
+        swprintf_s(txt, L"%d fps", kRecordFpsPresets[i]);
+        AppendMenuW(rec, MF_STRING | MF_RADIOCHECK | (g_recordFps == kRecordFpsPresets[i] ? MF_CHECKED : 0),
+            TRAY_REC_FPS1 + i, txt);
+    }
+    AppendMenuW(menu, MF_POPUP, (UINT_PTR)rec, L"Record");
+
+    // --- Output size submenu (verkleinen vóór clipboard/opslaan)
+    HMENU outSize = CreatePopupMenu();
+    static const wchar_t* const kOutputLabels[] = {
+        L"Original pixels", L"Logical size (undo display scaling)", L"75%", L"50%", L"Max edge 1920 px", L"Max edge 1280 px" };
+    for (UINT i = 0; i < (UINT)_countof(kOutputPresets); ++i) {
+        const int mode = kOutputPresets[i][0], value = kOutputPresets[i][1];
+        const bool on = g_outputScale == mode &&
+            (mode == (int)OutputScaleMode::Percent ? g_outputPercent == value :
+             mode == (int)OutputScaleMode::MaxEdge ? g_outputMaxEdge == value : true);
+        AppendMenuW(outSize, MF_STRING | MF_RADIOCHECK | (on ? MF_CHECKED : 0), TRAY_OUTPUT1 + i, kOutputLabels[i]);
+    }
+    AppendMenuW(menu, MF_POPUP, (UINT_PTR)outSize, L"Output size");
+
     // --- File name format submenu (date + counter)
     HMENU fn = CreatePopupMenu();
     AppendMenuW(fn, MF_STRING | MF_RADIOCHECK | (g_namePreset == 1 ? MF_CHECKED : 0), TRAY_NAME_PRESET1, L"Preset 1  (snip_YYYY-MM-DD_####)");
@@ -2757,14 +13653,18 @@ static void TrayShowMenu(HWND hwnd) {
     AppendMenuW(sf, MF_STRING | MF_RADIOCHECK | (g_saveFormat == SaveFormat::Png ? MF_CHECKED : 0), TRAY_FMT_PNG, L"PNG");
     AppendMenuW(sf, MF_STRING | MF_RADIOCHECK | (g_saveFormat == SaveFormat::Jpeg ? MF_CHECKED : 0), TRAY_FMT_JPEG, L"JPEG");
     AppendMenuW(sf, MF_STRING | MF_RADIOCHECK | (g_saveFormat == SaveFormat::Bmp ? MF_CHECKED : 0), TRAY_FMT_BMP, L"BMP");
+    AppendMenuW(sf, MF_STRING | MF_RADIOCHECK | (g_saveFormat == SaveFormat::Auto ? MF_CHECKED : 0), TRAY_FMT_AUTO, L"Auto (by content)");
     AppendMenuW(menu, MF_POPUP, (UINT_PTR)sf, L"Save format");
 
     // --- Auto-dismiss toggle
     AppendMenuW(menu, MF_STRING | (g_autoDismissAfterSave ? MF_CHECKED : 0),
         TRAY_TOGGLE_AUTODISMISS, L"Auto-dismiss after Save");
+    AppendMenuW(menu, MF_STRING | (g_publishShm ? MF_CHECKED : 0), TRAY_TOGGLE_SHM, L"Publish captures to shared memory");
 
     AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
     AppendMenuW(menu, MF_STRING, TRAY_OPEN_SAVEDIR, L"Open save folder");
+    AppendMenuW(menu, MF_STRING, TRAY_FIND_CAPTURE, L"Find capture...");
+    AppendMenuW(menu, MF_STRING | (g_similar.indexing ? MF_GRAYED : 0), TRAY_SIMILAR_INDEX, L"Index save folder for similar search");
     AppendMenuW(menu, MF_STRING, TRAY_SET_SAVEDIR, L"Set save folder...");
     AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
     AppendMenuW(menu, MF_STRING, TRAY_EXIT, L"Exit");
@@ -2788,6 +13688,9 @@ static bool TryModeFromTrayCmd(UINT cmd, Mode& outMode)
     case TRAY_CAP_MONITOR: outMode = Mode::Monitor;  return true;
     case TRAY_CAP_FREE:    outMode = Mode::Freestyle; return true;
     case TRAY_CAP_POLY:    outMode = Mode::Polygon;  return true;
+    case TRAY_CAP_BURST:   outMode = Mode::Burst;    return true;
+    case TRAY_CAP_RECORD:  outMode = Mode::Record;   return true;
+    case TRAY_CAP_SCROLL:  outMode = Mode::Scroll;   return true;
     default: return false;
     }
 }
@@ -2796,13 +13699,27 @@ static LRESULT CALLBACK MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
     switch (msg) {
     case WM_HOTKEY:
         if (wParam == HOTKEY_ID) {
-            if (g_hwndPreview) {
-                DestroyPreview();
-                CreateOverlay();
+            // lopende burst: hotkey = stoppen
+            if (g_burst.active) {
+                BurstStop();
+                return 0;
+            }
+            if (g_rec.active) {
+                RecordStop();
                 return 0;
             }
+            if (g_scroll.active) {
+                ScrollFinish();
+                return 0;
+            }
+            if (CaptureFlowBusy()) return 0;   // capture loopt nog (overlay al verborgen)
             if (g_hwndOverlay) DestroyOverlay();
-            else CreateOverlay();
+            else {
+                g_overlayLatency.t0 = std::chrono::steady_clock::now();
+                g_overlayLatency.queueMs = (double)(DWORD)(GetTickCount() - (DWORD)GetMessageTime());
+                g_overlayLatency.pending = true;
+                CreateOverlay();
+            }
         }
         return 0;
     
@@ -2810,11 +13727,72 @@ static LRESULT CALLBACK MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
         TrayAdd(hwnd);
         return 0;
 
+    case WM_TIMER:
+        if (wParam == TIMER_BURST) BurstTick();
+        if (wParam == TIMER_SCROLL) ScrollTick();
+        if (wParam == TIMER_CAPTURE_SEQ) CaptureFlowRun(CaptureSeqTimer(g_capFlow.seq, CaptureFlowNow()));
+        if (wParam == TIMER_DIFF_EXPIRE) DiffPruneClosed();
+        return 0;
+
+    case WM_CAPTURE_COMPOSED:
+        CaptureFlowRun(CaptureSeqComposed(g_capFlow.seq, (uint32_t)wParam, lParam != 0, CaptureFlowNow()));
+        return 0;
+
+    case WM_CAPTURE_PROCESSED:
+        CaptureFlowProcessed((CaptureJob*)lParam);
+        return 0;
+
+    case WM_RECORD_STOP:
+        RecordStop();
+        return 0;
+
+    case WM_SESSIONS_SHOW:
+        if (!g_hwndOverlay && !g_burst.active && !g_rec.active && !g_scroll.active && !CaptureFlowBusy()) SessionsShow(true);
+        return 0;
+
+    case WM_RECOMPRESS_DONE:
+        RecompressApplyDone((RecompressDone*)lParam);
+        return 0;
+
+    case WM_SIMILAR_INDEXED:
+        SimilarApplyIndexed((SimilarIndexed*)lParam);
+        return 0;
+
+    case WM_DIFF_LOADED:
+        DiffApplyLoaded((DiffLoaded*)lParam);
+        return 0;
+
+    case WM_DESKTOP_CACHED:
+        OverlayDesktopCached((uint32_t)wParam);
+        return 0;
+
+    case WM_PIPE_COMMAND:
+        PipeHandleMessage(lParam);
+        return 0;
+
+    case WM_PREVIEW_SPARE:
+        PreviewEnsureSpare();
+        return 0;
+
     case WM_DESTROY:
+        CaptureFlowCancel();
+        PipeServerStop();
+        BurstStop();
+        RecordStop();
+        TempSweepStop();
+        RecompressStop();
+        SimilarIndexStop();
+        DiffLoadStop();
+        ShmClose();
+        if (g_scroll.active) {          // afbreken, geen preview meer
+            KillTimer(hwnd, TIMER_SCROLL);
+            g_scroll.active = false;
+            ScrollReleaseDib();
+        }
         if (g_hotkeyOk) UnregisterHotKey(hwnd, HOTKEY_ID);
         TrayRemove();
         SaveSettings();       // laatste flush
-        DestroyPreview();
+        DestroyAllPreviews();
         DestroyOverlay();
         PostQuitMessage(0);
         return 0;
@@ -2851,12 +13829,65 @@ static LRESULT CALLBACK MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             StartCapture(m);   // direct starten na mode keuze
             return 0;
         }
+        if (cmd == TRAY_BURST_STOP) {
+            BurstStop();
+            return 0;
+        }
+        if (cmd == TRAY_REC_STOP) {
+            RecordStop();
+            return 0;
+        }
+        if (cmd >= TRAY_REC_FPS1 && cmd <= TRAY_REC_FPS4) {
+            g_recordFps = kRecordFpsPresets[cmd - TRAY_REC_FPS1];
+            SaveSettings(); // geldt vanaf de volgende opname
+            return 0;
+        }
+
+        if (cmd >= TRAY_OUTPUT1 && cmd <= TRAY_OUTPUT6) {
+            const int* preset = kOutputPresets[cmd - TRAY_OUTPUT1];
+            g_outputScale = preset[0];
+            if (preset[0] == (int)OutputScaleMode::Percent) g_outputPercent = preset[1];
+            if (preset[0] == (int)OutputScaleMode::MaxEdge) g_outputMaxEdge = preset[1];
+            SaveSettings(); // geldt vanaf de volgende capture
+            return 0;
+        }
+
+        if (cmd >= TRAY_BURST_INT1 && cmd <= TRAY_BURST_INT5) {
+            g_burstIntervalMs = kBurstIntervalsMs[cmd - TRAY_BURST_INT1];
+            SaveSettings();
+            if (g_burst.active) SetTimer(g_hwndMsg, TIMER_BURST, (UINT)g_burstIntervalMs, nullptr);
+            return 0;
+        }
+
+        if (cmd == TRAY_BURST_EXPORT) {
+            int frames = 0;
+            if (BurstExportFrames(g_lastBurstFile, frames)) {
+                wchar_t msg[64]{};
+                swprintf_s(msg, L"%d frames exported", frames);
+                TrayNotify(L"Burst export", msg);
+            }
+            else {
+                MessageBeep(MB_ICONERROR);
+            }
+            return 0;
+        }
+
         if (cmd == TRAY_OPEN_SAVEDIR) {
             if (g_saveDir.empty()) g_saveDir = DefaultSaveDir();
             OpenPath(g_saveDir);
             return 0;
         }
 
+        if (cmd == TRAY_FIND_CAPTURE) {
+            CatalogShowWindow();
+            return 0;
+        }
+
+        if (cmd == TRAY_SIMILAR_INDEX) {
+            SimilarIndexFolderStart();
+            return 0;
+        }
+
         if (cmd == TRAY_SET_SAVEDIR) {
             std::wstring picked;
             std::wstring start = g_saveDir.empty() ? DefaultSaveDir() : g_saveDir;
@@ -2880,10 +13911,18 @@ static LRESULT CALLBACK MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
             return 0;
         }
 
-        if (cmd == TRAY_FMT_PNG || cmd == TRAY_FMT_JPEG || cmd == TRAY_FMT_BMP) {
+        if (cmd == TRAY_TOGGLE_SHM) {
+            g_publishShm = !g_publishShm;
+            if (!g_publishShm) ShmClose();   // lezers houden hun mapping tot ze hem sluiten
+            SaveSettings();
+            return 0;
+        }
+
+        if (cmd == TRAY_FMT_PNG || cmd == TRAY_FMT_JPEG || cmd == TRAY_FMT_BMP || cmd == TRAY_FMT_AUTO) {
             if (cmd == TRAY_FMT_PNG)  g_saveFormat = SaveFormat::Png;
             if (cmd == TRAY_FMT_JPEG) g_saveFormat = SaveFormat::Jpeg;
             if (cmd == TRAY_FMT_BMP)  g_saveFormat = SaveFormat::Bmp;
+            if (cmd == TRAY_FMT_AUTO) g_saveFormat = SaveFormat::Auto;
 
             SaveSettings();
             return 0;
@@ -2894,6 +13933,242 @@ static LRESULT CALLBACK MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lPara
     return DefWindowProcW(hwnd, msg, wParam, lParam);
 }
 
+// snip-lite is een GUI-app: voor --optimize de console van de aanroeper lenen
+// (of er een openen als die er niet is, en dan wachten zodat het rapport leesbaar blijft).
+static void ConsoleWrite(const std::wstring& s) {
+    HANDLE out = CreateFileW(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (out == INVALID_HANDLE_VALUE) return;
+    DWORD written = 0;
+    WriteConsoleW(out, s.c_str(), (DWORD)s.size(), &written, nullptr);
+    CloseHandle(out);
+}
+
+// Vervangen bestanden: het duplicate-index kent ze met de oude grootte, en een BMP
+// die een PNG werd (--bmp-to-png; Smaller = de .bmp is weg) ook nog onder het oude pad. Zelfde aanpak als RecompressApplyDone:
+// entry bijwerken en de nieuwe regel toevoegen (de oude valt bij het opzoeken af).
+static void HashIndexApplyOptimize(const OptimizeReport& r) {
+    std::unordered_map<std::wstring, const OptimizeItem*> replaced;
+    for (const OptimizeItem& it : r.items) {
+        if (it.status != OptimizeStatus::Smaller) continue;
+        std::wstring key = it.path.wstring();
+        for (auto& c : key) c = (wchar_t)towlower(c);
+        replaced[key] = &it;
+    }
+    if (replaced.empty()) return;
+
+    LoadHashIndex();
+    std::wstring lines;
+    std::wstring key;
+    for (auto& kv : g_hashIndex) {
+        HashIndexEntry& e = kv.second;
+        key = e.path;
+        for (auto& c : key) c = (wchar_t)towlower(c);
+        const auto hit = replaced.find(key);
+        if (hit == replaced.end() || e.bytes != hit->second->before) continue;
+        if (hit->second->outPath != hit->second->path) {
+            e.path = hit->second->outPath.wstring();
+            e.fmt = (int)SaveFormat::Png;
+        }
+        if (!HashIndexRestamp(e)) continue;
+        lines += FormatHashIndexLine(kv.first, e);
+        g_hashIndexLines++;
+    }
+    if (!lines.empty()) AppendToFile(HashIndexFile(), lines.data(), (DWORD)(lines.size() * sizeof(wchar_t)));
+}
+
+// --optimize <map> [--threads N] [--bmp-to-png]. -1 = geen optimize-aanroep (gewoon starten).
+static int RunOptimizeCommand(int argc, wchar_t** argv) {
+    std::wstring dir;
+    int threads = 0;
+    bool optimize = false, convertBmp = false;
+    for (int i = 1; i < argc; ++i) {
+        if (wcscmp(argv[i], L"--optimize") == 0 && i + 1 < argc) { optimize = true; dir = argv[++i]; }
+        else if (wcscmp(argv[i], L"--threads") == 0 && i + 1 < argc) threads = (int)wcstol(argv[++i], nullptr, 10);
+        else if (wcscmp(argv[i], L"--bmp-to-png") == 0) convertBmp = true;
+    }
+    if (!optimize) return -1;
+
+    const bool ownConsole = !AttachConsole(ATTACH_PARENT_PROCESS) && AllocConsole();
+    ConsoleWrite(L"\r\nsnip-lite --optimize " + dir + L"\r\n");
+
+    OptimizeReport report;
+    int rc = 0;
+    if (!OptimizeFolder(dir, threads, report, convertBmp)) {
+        ConsoleWrite(L"Map niet leesbaar: " + dir + L"\r\n");
+        rc = 2;
+    }
+    else {
+        std::wstring text = FormatOptimizeReport(report);
+        std::wstring crlf;
+        for (wchar_t c : text) { if (c == L'\n') crlf += L'\r'; crlf += c; }
+        ConsoleWrite(crlf);
+        for (const OptimizeItem& it : report.items) if (it.status == OptimizeStatus::Failed) rc = 1;
+        HashIndexApplyOptimize(report);
+    }
+    DebugLog(L"[optimize] %zu bestanden, %.0f ms, rc=%d", report.items.size(), report.wallMs, rc);
+
+    if (ownConsole) {
+        ConsoleWrite(L"\r\nDruk op Enter om te sluiten.");
+        HANDLE in = CreateFileW(L"CONIN$", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (in != INVALID_HANDLE_VALUE) {
+            wchar_t buf[8];
+            DWORD read = 0;
+            ReadConsoleW(in, buf, 8, &read, nullptr);
+            CloseHandle(in);
+        }
+    }
+    FreeConsole();
+    return rc;
+}
+
+// Client-uitvoer: naar stdout als die omgeleid is (scripts: $p = snip-lite --send ...),
+// anders naar de console van de aanroeper.
+static void ClientWrite(const std::wstring& s) {
+    HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (out && out != INVALID_HANDLE_VALUE && GetFileType(out) != FILE_TYPE_CHAR && GetFileType(out) != FILE_TYPE_UNKNOWN) {
+        const int n = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), (int)s.size(), nullptr, 0, nullptr, nullptr);
+        std::string utf8((size_t)std::max(0, n), '\0');
+        if (n > 0) WideCharToMultiByte(CP_UTF8, 0, s.c_str(), (int)s.size(), utf8.data(), n, nullptr, nullptr);
+        DWORD written = 0;
+        WriteFile(out, utf8.data(), (DWORD)utf8.size(), &written, nullptr);
+        return;
+    }
+    ConsoleWrite(s);
+}
+
+// --send <commando> [argumenten] | --bench [N]: praat met de draaiende instance.
+// -1 = geen client-aanroep. Exit: 0 ok, 1 fout van de instance, 2 verkeerde aanroep,
+// 3 geen instance bereikbaar, 4 verbinding verbroken (instance weg tijdens het commando).
+static int RunPipeClient(int argc, wchar_t** argv) {
+    bool send = false;
+    int bench = -1;
+    std::vector<std::wstring> args;
+    for (int i = 1; i < argc; ++i) {
+        if (wcscmp(argv[i], L"--send") == 0) {
+            send = true;
+            for (++i; i < argc; ++i) args.push_back(argv[i]);
+        }
+        else if (wcscmp(argv[i], L"--bench") == 0) {
+            bench = 1000;
+            if (i + 1 < argc && iswdigit(argv[i + 1][0])) bench = (int)wcstol(argv[++i], nullptr, 10);
+        }
+    }
+    if (!send && bench < 0) return -1;
+    AttachConsole(ATTACH_PARENT_PROCESS);
+
+    PipeRequest req;
+    std::wstring err;
+    if (send && !PipeParseCommand(args, req, err)) {
+        ClientWrite(L"snip-lite: " + err + L"\r\n"
+            L"commands: ping | get-last-path | set-format png|jpg|bmp|auto |\r\n"
+            L"          capture-region X Y W H [--save] | capture-monitor [N] [--save]\r\n");
+        FreeConsole();
+        return 2;
+    }
+
+    const auto tConnect = std::chrono::steady_clock::now();
+    HANDLE h = PipeConnect();
+    if (h == INVALID_HANDLE_VALUE) {
+        ClientWrite(L"snip-lite: no running instance\r\n");
+        FreeConsole();
+        return 3;
+    }
+    const double connectMs = MsSince(tConnect);
+
+    int rc = 0;
+    PipeResponse resp;
+    if (send) {
+        req.id = 1;
+        if (!PipeTransact(h, req, resp)) {
+            ClientWrite(L"snip-lite: connection lost\r\n");
+            rc = 4;
+        }
+        else if (resp.status == PipeStatus::Ok) ClientWrite(resp.text + L"\r\n");
+        else {
+            ClientWrite(L"snip-lite: " + resp.text + L"\r\n");
+            rc = resp.status == PipeStatus::BadRequest ? 2 : 1;
+        }
+    }
+    else {
+        // ping over één verbinding: meet de hele weg pipe -> UI-thread -> pipe
+        std::vector<double> us;
+        us.reserve((size_t)std::max(0, bench));
+        PipeRequest ping;
+        for (int i = 0; i < bench && rc == 0; ++i) {
+            ping.id = (uint32_t)i + 1;
+            const auto t0 = std::chrono::steady_clock::now();
+            if (!PipeTransact(h, ping, resp)) rc = 4;
+            else if (resp.status != PipeStatus::Ok) rc = 1;
+            else us.push_back(MsSince(t0) * 1000.0);
+        }
+        wchar_t head[96];
+        swprintf_s(head, L"connect %.2f ms\r\n", connectMs);
+        std::wstring report = FormatLatencyReport(us);
+        if (!report.empty() && report.back() == L'\n') report.insert(report.size() - 1, L"\r");
+        ClientWrite(head + report);
+    }
+    CloseHandle(h);
+    FreeConsole();
+    return rc;
+}
+
+// --shm-wait [ms]: wacht op de volgende gedeelde capture en print "frame N WxH at X,Y".
+// Ook een voorbeeld van een lezer. -1 = geen aanroep. Exit: 0 frame, 1 time-out,
+// 3 niets gedeeld (geen instance, of Publish staat uit).
+static int RunShmClient(int argc, wchar_t** argv) {
+    DWORD timeoutMs = 0;
+    bool wait = false;
+    for (int i = 1; i < argc; ++i) {
+        if (wcscmp(argv[i], L"--shm-wait") == 0) {
+            wait = true;
+            timeoutMs = 30000;
+            if (i + 1 < argc && iswdigit(argv[i + 1][0])) timeoutMs = (DWORD)wcstoul(argv[++i], nullptr, 10);
+        }
+    }
+    if (!wait) return -1;
+    AttachConsole(ATTACH_PARENT_PROCESS);
+
+    HANDLE section = OpenFileMappingW(FILE_MAP_READ, FALSE, kShmName);
+    const uint8_t* view = section ? (const uint8_t*)MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    const uint64_t mapped = view ? ShmViewBytes(view) : 0;   // section kan van een andere build zijn
+    HANDLE ready[2] = { OpenEventW(SYNCHRONIZE, FALSE, ShmEventName(0).c_str()), OpenEventW(SYNCHRONIZE, FALSE, ShmEventName(1).c_str()) };
+
+    int rc = 3;
+    if (!view || !ready[0] || !ready[1] || !ShmHeaderValid(view, mapped)) {
+        ClientWrite(L"snip-lite: no shared capture (tray: Publish captures to shared memory)\r\n");
+    }
+    else {
+        const uint64_t seen = ShmHeaderOf(view)->published.load(std::memory_order_acquire);
+        const auto t0 = std::chrono::steady_clock::now();
+        rc = 1;
+        for (;;) {
+            ShmFrame f;
+            if (ShmHeaderOf(view)->published.load(std::memory_order_acquire) > seen && ShmReadBegin(view, mapped, f)) {
+                // pixels zouden hier ter plekke gebruikt worden; dan nakijken
+                wchar_t line[128];
+                swprintf_s(line, L"frame %llu %dx%d at %d,%d\r\n", (unsigned long long)f.frame, f.w, f.h, f.left, f.top);
+                if (ShmReadValid(f)) {
+                    ClientWrite(line);
+                    rc = 0;
+                    break;
+                }
+                continue;
+            }
+            const double left = (double)timeoutMs - MsSince(t0);
+            if (left <= 0) {
+                ClientWrite(L"snip-lite: timeout\r\n");
+                break;
+            }
+            WaitForSingleObject(ready[(seen + 1) & 1], std::min<DWORD>(kShmWaitSliceMs, (DWORD)left + 1));
+        }
+    }
+    for (HANDLE e : ready) if (e) CloseHandle(e);
+    if (view) UnmapViewOfFile(view);
+    if (section) CloseHandle(section);
+    FreeConsole();
+    return rc;
+}
+
 // =========================================================
 // Entry point
 // =========================================================
@@ -2903,6 +14178,17 @@ int WINAPI wWinMain(_In_ HINSTANCE hInst,
     _In_ int nCmdShow) {
     g_hInst = hInst;
 
+    // --optimize, de pipe-client (--send/--bench) en --shm-wait draaien los van de tray-instance
+    // (geen single-instance check, geen vensters)
+    int argc = 0;
+    if (wchar_t** argv = CommandLineToArgvW(GetCommandLineW(), &argc)) {
+        int rc = RunOptimizeCommand(argc, argv);
+        if (rc < 0) rc = RunPipeClient(argc, argv);
+        if (rc < 0) rc = RunShmClient(argc, argv);
+        LocalFree(argv);
+        if (rc >= 0) return rc;
+    }
+
     InitDpiAwareness();
     if (!EnsureSingleInstance()) {
         // Er draait al een instance: stilletjes stoppen (geen extra tray icon / hotkey-conflict)
@@ -2932,6 +14218,12 @@ int WINAPI wWinMain(_In_ HINSTANCE hInst,
         HWND_MESSAGE, nullptr, hInst, nullptr
     );
     TrayAdd(g_hwndMsg);
+    TempSweepRequest(); // eerste ronde na kTempSweepStartDelayMs
+    RecompressRequest(); // rij uit het journal van de vorige keer
+    PipeServerStart();
+    // overlay en preview vooraf aanmaken (verborgen): hotkey/capture tonen alleen nog
+    OverlayEnsureSpare();
+    PreviewEnsureSpare();
 
     g_hotkeyOk = RegisterHotKey(g_hwndMsg, HOTKEY_ID, HOTKEY_MOD, HOTKEY_VK) != FALSE;
     if (!g_hotkeyOk) {
@@ -2940,6 +14232,7 @@ int WINAPI wWinMain(_In_ HINSTANCE hInst,
 
     MSG m{};
     while (GetMessageW(&m, nullptr, 0, 0)) {
+        if (g_hwndCatalog && IsDialogMessageW(g_hwndCatalog, &m)) continue; // Tab/Enter/Esc in het zoekvenster
         TranslateMessage(&m);
         DispatchMessageW(&m);
     }
@@ -2950,3 +14243,5 @@ int WINAPI wWinMain(_In_ HINSTANCE hInst,
     }
     return 0;
 }
+
+#endif // !SNIP_CORE_ONLY
@@ -0,0 +1,532 @@
+// Benchmarks voor de portable kern. `snip_bench` draait alles, `snip_bench naam...`
+// een selectie; `--quick` gebruikt kleine beelden (smoke-test in ctest).
+#include "snip_test.h"
+
+#include <cstring>
+
+static bool g_quick = false;
+
+// mediaan van 'reps' runs in ms
+template <class Fn>
+static double BenchMs(int reps, Fn&& fn) {
+    std::vector<double> ms;
+    for (int i = 0; i < (g_quick ? 1 : reps); ++i) {
+        const auto t0 = std::chrono::steady_clock::now();
+        fn();
+        ms.push_back(MsSince(t0));
+    }
+    std::sort(ms.begin(), ms.end());
+    return ms[ms.size() / 2];
+}
+
+static void BenchAutoFormat() {
+    const int w = g_quick ? 640 : 7680, h = g_quick ? 360 : 4320;
+    auto photo = TestImagePhoto(w, h, 1);
+    auto ui = TestImageBlocks(w, h);
+    ContentStats st{};
+    const double photoMs = BenchMs(9, [&] { st = AnalyzeContentSampled(photo.data(), w, h, w * 4, 1000.0); });
+    std::printf("auto-format: analyze %dx%d photo %.3f ms (%d samples)\n", w, h, photoMs, st.samples);
+    std::vector<uint32_t> pal;
+    std::vector<uint8_t> idx;
+    const double palMs = BenchMs(5, [&] { BuildExactPalette(ui.data(), w, h, w * 4, pal, idx); });
+    std::printf("auto-format: exact palette %dx%d UI %.2f ms (%zu colours)\n", w, h, palMs, pal.size());
+
+    // gelabeld corpus: trefkans en analysetijd per soort
+    const int cw = g_quick ? 640 : 1920, ch = g_quick ? 360 : 1080;
+    const auto corpus = TestAutoCorpus(cw, ch, g_quick ? 2 : 8);
+    for (const char* label : { "text", "photo", "ui", "gradient" }) {
+        int hits = 0, total = 0;
+        std::vector<double> ms;
+        for (const TestLabelledImage& img : corpus) {
+            if (std::strcmp(img.label, label) != 0) continue;
+            ms.push_back(BenchMs(5, [&] { st = AnalyzeContentSampled(img.px.data(), img.w, img.h, img.w * 4, 1000.0); }));
+            hits += ClassifyContent(st).fmt == img.expect;
+            ++total;
+        }
+        std::sort(ms.begin(), ms.end());
+        std::printf("auto-format: corpus %dx%d %-8s %d/%d correct, analyze %.3f ms\n", cw, ch, label, hits, total, ms[ms.size() / 2]);
+    }
+}
+
+// Eén shape verplaatsen (alleen de damage-rect) tegenover de hele scene opnieuw.
+static void BenchAnnotations() {
+    const int w = g_quick ? 640 : 7680, h = g_quick ? 360 : 4320;
+    auto base = TestImageNoise(w, h, 5);
+    std::vector<uint8_t> dst = base;
+    std::mt19937 rng(5);
+    AnnotScene sc;
+    for (int i = 0; i < 60; ++i) {
+        AnnotShape s;
+        s.kind = (AnnotKind)(i % 3);
+        s.x0 = (int)(rng() % w); s.y0 = (int)(rng() % h);
+        s.x1 = s.x0 + (int)(rng() % 1200) - 600; s.y1 = s.y0 + (int)(rng() % 800) - 400;
+        s.thickness = 2 + (int)(rng() % 20);
+        s.color = 0xFF000000u | (rng() & 0xFFFFFFu);
+        sc.shapes.push_back(s);
+    }
+    AnnotRecomposite(sc, base.data(), w * 4, dst.data(), w * 4, w, h, PixRect{ 0, 0, w, h });
+    size_t k = 0;
+    const double incMs = BenchMs(21, [&] {
+        AnnotShape& s = sc.shapes[k++ % sc.shapes.size()];
+        const PixRect before = AnnotBounds(s);
+        s.x0 += 7; s.x1 += 7;
+        AnnotRecomposite(sc, base.data(), w * 4, dst.data(), w * 4, w, h, PixRectUnion(before, AnnotBounds(s)));
+    });
+    const double fullMs = BenchMs(5, [&] {
+        AnnotRecomposite(sc, base.data(), w * 4, dst.data(), w * 4, w, h, PixRect{ 0, 0, w, h });
+    });
+    std::printf("annotations: %dx%d, %zu shapes: move one %.2f ms, full recomposite %.2f ms\n",
+        w, h, sc.shapes.size(), incMs, fullMs);
+}
+
+// Fallback-scan van een map met 100k captures: alleen het parsen van de namen.
+static void BenchNaming() {
+    const int count = g_quick ? 1000 : 100000;
+    const std::wstring today = NamePresetPrefix(1, 2026, 10, 19, L""), other = NamePresetPrefix(1, 2026, 10, 18, L"");
+    std::vector<std::wstring> names;
+    for (int i = 0; i < count; ++i) names.push_back(NameWithCounter(i % 2 ? today : other, i, L".png"));
+    int best = 0;
+    const double ms = BenchMs(9, [&] {
+        best = 0;
+        for (const auto& s : names) best = std::max(best, ParseNameCounter(s.c_str(), today.c_str(), today.size()));
+    });
+    std::printf("naming: parse %d names %.2f ms (%.1f ns/name, max %d)\n", count, ms, ms * 1e6 / count, best);
+}
+
+// Catalogus met 100k captures: catalog.bin parsen, index bouwen, één save toevoegen en
+// zoeken (woord, prefix, proces, datum).
+static void BenchCatalog() {
+    const size_t count = g_quick ? 2000 : 100000;
+    static const wchar_t* const titles[] = { L"Invoice billing portal - Chrome", L"Quarterly report draft.docx - Word",
+        L"snip-lite main.cpp - Visual Studio", L"Inbox (42) - Outlook", L"Build pipeline #1832 failed" };
+    static const wchar_t* const procs[] = { L"chrome.exe", L"WINWORD.EXE", L"devenv.exe", L"OUTLOOK.EXE", L"firefox.exe" };
+    std::vector<CatalogEntry> entries;
+    for (size_t i = 0; i < count; ++i) {
+        CatalogEntry e{};
+        e.time = 133700000000000000ull + i * 6000000000ull;
+        wchar_t path[64];
+        std::swprintf(path, 64, L"C:\\Shots\\snip_%06zu.png", i);
+        e.path = path;
+        e.title = titles[i % 5];
+        e.process = procs[i * 7 % 5];
+        entries.push_back(std::move(e));
+    }
+    const std::vector<uint8_t> file = CatalogBuildFile(entries);
+    std::vector<CatalogEntry> parsed;
+    size_t records = 0;
+    const double parseMs = BenchMs(5, [&] { parsed.clear(); CatalogParse(file.data(), file.size(), parsed, &records); });
+    CatalogIndex idx;
+    const double buildMs = BenchMs(3, [&] { CatalogIndexBuild(idx, parsed); });
+    CatalogEntry extra = entries[0];
+    extra.title = L"One more capture";
+    const double addMs = BenchMs(9, [&] { CatalogIndexAdd(idx, extra); });
+    std::printf("catalog: %zu entries (%.1f MB): parse %.1f ms, index %.1f ms, append %.3f ms\n",
+        count, file.size() / 1048576.0, parseMs, buildMs, addMs);
+    for (const wchar_t* q : { L"invoice", L"rep", L"chrome.exe", L"pipeline failed", L"2024" }) {
+        size_t total = 0;
+        const double ms = BenchMs(21, [&] { CatalogQuery(idx, q, 500, &total); });
+        std::printf("catalog: query \"%ls\" %zu hits %.3f ms\n", q, total, ms);
+    }
+}
+
+// Output-schaling: 4K naar 1080p en 1440p (ook voorvermenigvuldigd), MP/s van de bron.
+static void BenchResample() {
+    const int sw = g_quick ? 640 : 3840, sh = g_quick ? 360 : 2160;
+    const auto img = TestImagePhoto(sw, sh, 3);
+    struct Target { int dw, dh; bool alpha; };
+    const Target targets[] = { { sw / 2, sh / 2, false }, { sw * 2 / 3, sh * 2 / 3, false }, { sw / 2, sh / 2, true } };
+    for (const Target& t : targets) {
+        std::vector<uint8_t> dst((size_t)t.dw * t.dh * 4);
+        const double ms = BenchMs(7, [&] {
+            ResampleLanczos(img.data(), (ptrdiff_t)sw * 4, sw, sh, dst.data(), (ptrdiff_t)t.dw * 4, t.dw, t.dh, t.alpha);
+        });
+        std::printf("resample: %dx%d -> %dx%d%s %.1f ms (%.0f MP/s)\n", sw, sh, t.dw, t.dh,
+            t.alpha ? " alpha" : "", ms, (double)sw * sh / 1e6 / (ms / 1000.0));
+    }
+}
+
+// Gelijkende captures: pHash van een schermvullende capture, similar.bin inlezen, en de
+// Hamming-index (geclusterde hashes, zoals echte reeksen captures) tegen lineair zoeken.
+static void BenchSimilar() {
+    const int w = g_quick ? 640 : 3840, h = g_quick ? 360 : 2160;
+    const auto img = TestImagePhoto(w, h, 48);
+    volatile uint64_t sink = 0;
+    const double hashMs = BenchMs(7, [&] { sink = PerceptualHash(img.data(), (ptrdiff_t)w * 4, w, h); });
+    std::printf("similar: pHash %dx%d %.2f ms\n", w, h, hashMs);
+
+    const size_t clusters = g_quick ? 500 : 10000;
+    std::mt19937_64 rng(48);
+    std::vector<uint64_t> hashes;
+    std::vector<uint8_t> file;
+    SimilarPutHeader(file);
+    for (size_t c = 0; c < clusters; ++c) {
+        const uint64_t base = rng();
+        for (int v = 0; v < 10; ++v) {
+            uint64_t x = base;
+            for (int f = 0; f < (int)(rng() % 8); ++f) x ^= 1ull << (rng() % 64);
+            hashes.push_back(x);
+            wchar_t path[64];
+            std::swprintf(path, 64, L"C:\\Shots\\snip_%06zu.png", hashes.size());
+            SimilarPutRecord(file, SimilarEntry{ x, hashes.size(), 0, path });
+        }
+    }
+    std::vector<SimilarEntry> parsed;
+    const double parseMs = BenchMs(5, [&] { SimilarParse(file.data(), file.size(), parsed, nullptr); });
+    HammingIndex idx;
+    const double buildMs = BenchMs(3, [&] {
+        idx = HammingIndex{};
+        for (uint64_t x : hashes) HammingIndexAdd(idx, x);
+        HammingIndexBuild(idx);
+    });
+    std::printf("similar: %zu hashes (%.1f MB): parse %.1f ms, index %.1f ms\n", hashes.size(), file.size() / 1048576.0, parseMs, buildMs);
+
+    std::vector<uint64_t> queries;
+    for (int q = 0; q < 200; ++q) queries.push_back(hashes[rng() % hashes.size()] ^ (1ull << (rng() % 64)));
+    std::vector<std::pair<int, uint32_t>> hits;
+    size_t found = 0;
+    const double indexMs = BenchMs(5, [&] {
+        found = 0;
+        for (uint64_t q : queries) { HammingIndexQuery(idx, q, kSimilarRadius, hits); found += hits.size(); }
+    }) / (double)queries.size();
+    const double linearMs = BenchMs(5, [&] {
+        size_t n = 0;
+        for (uint64_t q : queries)
+            for (uint64_t x : hashes) n += HammingDistance(x, q) <= kSimilarRadius;
+        sink = n;
+    }) / (double)queries.size();
+    std::printf("similar: query r=%d %.3f ms (linear %.3f ms), %.1f hits\n", kSimilarRadius, indexMs, linearMs,
+        (double)found / (double)queries.size());
+}
+
+// Content hash van een 4K-frame (SSE2 en scalar) en het in-memory deel van
+// FindDuplicateCapture: index-regels parsen en opzoeken op hash.
+static void BenchHash() {
+    const int w = g_quick ? 640 : 3840, h = g_quick ? 360 : 2160;
+    const auto img = TestImageNoise(w, h, 27);
+    const double mb = img.size() / 1048576.0;
+    uint64_t hash = 0;
+    const double sseMs = BenchMs(9, [&] { hash = ContentHash64(img.data(), img.size(), 1); });
+    const double scalarMs = BenchMs(9, [&] { hash ^= ContentHash64(img.data(), img.size(), 1, false); });
+    std::printf("hash: %dx%d (%.1f MB) %.2f ms (%.1f GB/s), scalar %.2f ms\n", w, h, mb, sseMs,
+        img.size() / (sseMs * 1e6), scalarMs);
+
+    const int n = g_quick ? 5000 : 100000;
+    std::mt19937_64 rng(27);
+    std::wstring file;
+    std::vector<uint64_t> hashes;
+    for (int i = 0; i < n; ++i) {
+        HashIndexEntry e{};
+        e.fmt = i % 4;
+        e.bytes = 100000 + rng() % 5000000;
+        e.writeTime = 133500000000000000ull + rng() % 10000000000ull;
+        e.path = L"C:\\Users\\me\\Pictures\\snips\\2026-06-" + std::to_wstring(i % 30 + 1) + L"\\region_" + std::to_wstring(i) + L".png";
+        hashes.push_back(rng());
+        file += FormatHashIndexLine(hashes.back(), e);
+    }
+    std::unordered_multimap<uint64_t, HashIndexEntry> index;
+    const double parseMs = BenchMs(5, [&] {
+        index.clear();
+        size_t i = 0;
+        std::wstring line;
+        while (i < file.size()) {
+            const size_t end = file.find(L'\n', i);
+            line.assign(file, i, end - i - 1);   // zonder \r\n
+            i = end + 1;
+            uint64_t hh = 0;
+            HashIndexEntry e{};
+            if (ParseHashIndexLine(line, hh, e)) index.emplace(hh, std::move(e));
+        }
+        });
+    size_t found = 0;
+    const int queries = 100000;
+    const double lookupMs = BenchMs(5, [&] {
+        found = 0;
+        for (int q = 0; q < queries; ++q) {
+            const uint64_t key = (q & 1) ? hashes[(size_t)q % hashes.size()] : rng();   // helft raak
+            const auto range = index.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) found += it->second.fmt == 1;
+        }
+        });
+    std::printf("hash: index of %d lines: parse %.1f ms, lookup %.3f us (%zu hits)\n", n, parseMs,
+        lookupMs * 1000.0 / queries, found);
+}
+
+// Schermopname: N frames waarin telkens een klein stuk verandert (typen, cursor) en af en
+// toe een groot stuk (scrollen). Per frame DiffBounds + FramePng + ApngWriterAddFrame,
+// tegenover elk frame volledig encoderen.
+static void BenchApng() {
+    const int w = g_quick ? 640 : 1920, h = g_quick ? 360 : 1080, frames = g_quick ? 8 : 60;
+    const size_t stride = (size_t)w * 4;
+    const auto screen = TestImageUi(w, h, 29);
+    const auto path = TestTempPath("bench_rec.png");
+    for (const bool diff : { true, false }) {
+        std::vector<uint8_t> cur = screen, prev = screen;
+        ApngWriter aw;
+        double diffMs = 0, encodeMs = 0, addMs = 0;
+        uint64_t pixels = 0;
+        if (!ApngWriterOpen(aw, path, w, h)) { std::printf("apng: cannot write %s\n", path.string().c_str()); return; }
+        for (int f = 0; f < frames; ++f) {
+            if (f % 15 == 14) {
+                // grote wijziging: bovenste helft een stuk opgeschoven
+                std::memmove(&cur[0], &cur[stride * 40], stride * (h / 2 - 40));
+            } else if (f > 0) {
+                const int x0 = (f * 37) % (w - 200), y0 = (f * 23) % (h - 20);
+                for (int y = y0; y < y0 + 16; ++y)
+                    for (int x = x0; x < x0 + 8 * (1 + f % 20); ++x) cur[y * stride + x * 4] ^= 0x3C;
+            }
+            PixRect r{ 0, 0, w, h };
+            auto t0 = std::chrono::steady_clock::now();
+            if (diff && f > 0 && !DiffBounds(cur.data(), prev.data(), w, h, stride, r)) continue;
+            diffMs += MsSince(t0);
+            t0 = std::chrono::steady_clock::now();
+            const auto png = FramePng(cur, w, r);
+            encodeMs += MsSince(t0);
+            t0 = std::chrono::steady_clock::now();
+            ApngWriterAddFrame(aw, png, r, (uint64_t)f * 100);
+            addMs += MsSince(t0);
+            pixels += (uint64_t)r.Width() * r.Height();
+            prev = cur;
+        }
+        ApngWriterClose(aw, (uint64_t)frames * 100);
+        std::printf("apng: %d frames %dx%d %s: diff %.2f ms, encode %.1f ms, write %.2f ms per frame, "
+            "%.1f%% of pixels encoded, %.2f MB\n", frames, w, h, diff ? "diffed" : "full", diffMs / frames,
+            encodeMs / frames, addMs / frames, 100.0 * pixels / ((double)w * h * frames), aw.bytes / 1048576.0);
+    }
+    std::filesystem::remove(path);
+}
+
+// Scroll-capture van een ~20k px hoge pagina: viewport met sticky header/footer, elk
+// frame een paar honderd rijen verder. Tijd per StitchAddFrame (row-hashes + offset
+// zoeken + rijen toevoegen) en het platslaan van de uitvoer.
+static void BenchStitch() {
+    const int w = g_quick ? 640 : 1920, h = g_quick ? 360 : 1080, pageRows = g_quick ? 3000 : 20000;
+    const int header = h / 18, footer = h / 27, band = h - header - footer;
+    const size_t stride = (size_t)w * 4;
+    auto pageRow = [&](int r, uint8_t* row) {
+        const bool blank = r % 61 >= 50;   // witregels tussen alinea's
+        for (int x = 0; x < w; ++x) {
+            const uint32_t v = (blank || (x / 7 + r / 4) % 6 == 0) ? 0xFFFFFFFFu : ((uint32_t)r * 2654435761u) ^ ((uint32_t)x * 40503u);
+            std::memcpy(row + (size_t)x * 4, &v, 4);
+        }
+    };
+    std::vector<uint8_t> frame(stride * h);
+    auto viewport = [&](int off) {
+        for (int y = 0; y < h; ++y) {
+            uint8_t* row = &frame[(size_t)y * stride];
+            if (y < header || y >= h - footer) std::memset(row, 0x30 + (y & 15), stride);
+            else pageRow(off + y - header, row);
+        }
+    };
+    ScrollStitcher st;
+    StitchInit(st, w, h, 30000);
+    std::mt19937 rng(30);
+    std::vector<double> ms;
+    int appended = 0;
+    for (int off = 0; off + band <= pageRows; off += band / 4 + (int)(rng() % (band / 2))) {
+        viewport(off);
+        const auto t0 = std::chrono::steady_clock::now();
+        appended += StitchAddFrame(st, frame.data(), stride) == StitchResult::Appended;
+        ms.push_back(MsSince(t0));
+    }
+    std::vector<uint8_t> out;
+    const auto t0 = std::chrono::steady_clock::now();
+    RowBufFlatten(st.out, out);
+    const double flattenMs = MsSince(t0);
+    double total = 0;
+    for (double m : ms) total += m;
+    std::sort(ms.begin(), ms.end());
+    std::printf("stitch: %zu frames %dx%d -> %d rows (%d appended): %.2f ms/frame median, %.2f max, "
+        "%.0f ms total, flatten %.1f ms\n", ms.size(), w, h, st.out.rows, appended, ms[ms.size() / 2], ms.back(), total, flattenMs);
+}
+
+// Loupe: één tile per muisbeweging (168 px, zoom 4-16, met grid), ook half buiten de
+// desktop, plus een grote tile voor de doorvoer.
+static void BenchLoupe() {
+    const int w = g_quick ? 640 : 3840, h = g_quick ? 360 : 2160;
+    const auto desk = TestImageUi(w, h, 31);
+    const int reps = g_quick ? 100 : 20000;
+    std::vector<uint8_t> tile((size_t)1024 * 1024 * 4);
+    for (int zoom : { 4, 8, 16 }) {
+        const int span = 168 / zoom;
+        const double inMs = BenchMs(5, [&] {
+            for (int i = 0; i < reps; ++i)
+                ZoomNearestInt(desk.data(), w, h, (size_t)w * 4, (i * 7) % (w - span), (i * 3) % (h - span), zoom,
+                    tile.data(), 168, 168, 168 * 4, 0xFF202020u, true);
+        });
+        const double edgeMs = BenchMs(5, [&] {
+            for (int i = 0; i < reps; ++i)
+                ZoomNearestInt(desk.data(), w, h, (size_t)w * 4, w - span / 2, -span / 2, zoom,
+                    tile.data(), 168, 168, 168 * 4, 0xFF202020u, true);
+        });
+        std::printf("loupe: 168x168 zoom %2d %.2f us/tile, at desktop corner %.2f us/tile\n", zoom,
+            inMs * 1000.0 / reps, edgeMs * 1000.0 / reps);
+    }
+    const double bigMs = BenchMs(21, [&] {
+        ZoomNearestInt(desk.data(), w, h, (size_t)w * 4, 100, 100, 4, tile.data(), 1024, 1024, 1024 * 4, 0xFF202020u, false);
+    });
+    std::printf("loupe: 1024x1024 zoom 4 %.3f ms (%.1f GB/s written)\n", bigMs, 4.0 * 1024 * 1024 / (bigMs * 1e6));
+}
+
+// Edge map van een UI-achtige desktop op 4K en 8K, de lookup per muisbeweging, en het
+// cancel-pad: hoe lang BuildEdgeMap nog doorloopt nadat een andere thread annuleert
+// (de overlay sluit terwijl de worker bouwt).
+static void BenchEdgeMap() {
+    const int sizes[][2] = { { 3840, 2160 }, { 7680, 4320 } };
+    for (const auto& sz : sizes) {
+        const int w = g_quick ? sz[0] / 6 : sz[0], h = g_quick ? sz[1] / 6 : sz[1];
+        const auto desk = TestImageUi(w, h, 32);
+        EdgeMap em;
+        const double buildMs = BenchMs(7, [&] { BuildEdgeMap(desk.data(), w, h, (size_t)w * 4, em); });
+        const int lookups = 1000000;
+        volatile int sink = 0;
+        const double lookupMs = BenchMs(5, [&] {
+            int acc = 0;
+            for (int i = 0; i < lookups; ++i) {
+                const int x = (int)((int64_t)i * 7919 % w), y = (int)((int64_t)i * 104729 % h);
+                acc += EdgeSnapX(em, x, y, 8) + EdgeSnapY(em, x, y, 8);
+            }
+            sink = acc;
+        });
+
+        // al geannuleerd: meteen terug; halverwege geannuleerd: latentie na de cancel
+        std::atomic<bool> cancel{ true };
+        const double preMs = BenchMs(9, [&] { BuildEdgeMap(desk.data(), w, h, (size_t)w * 4, em, &cancel); });
+        std::vector<double> lagMs;
+        bool cancelled = true;
+        for (int r = 0; r < (g_quick ? 1 : 9); ++r) {
+            cancel = false;
+            std::atomic<int64_t> setAt{ 0 };
+            std::thread t([&] {
+                std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(buildMs * 400)));   // ~40% van de bouw
+                setAt = std::chrono::steady_clock::now().time_since_epoch().count();
+                cancel = true;
+            });
+            const bool built = BuildEdgeMap(desk.data(), w, h, (size_t)w * 4, em, &cancel);
+            const int64_t end = std::chrono::steady_clock::now().time_since_epoch().count();
+            t.join();
+            cancelled = cancelled && !built;
+            lagMs.push_back(built ? 0.0 : std::max<int64_t>(0, end - setAt) / 1e6);
+        }
+        std::sort(lagMs.begin(), lagMs.end());
+        std::printf("edge-map: %dx%d build %.2f ms, lookup %.1f ns, cancel before %.3f ms, cancel mid-build returns after %.3f ms%s\n",
+            w, h, buildMs, lookupMs * 1e6 / lookups / 2, preMs, lagMs[lagMs.size() / 2], cancelled ? "" : " (finished first)");
+    }
+}
+
+// Redactie op een 4K-capture: een typisch gebied (regel tekst, 800x120) en het hele
+// frame, pixelate (blok 16) en blur (sigma 8 en 24). De rijbanden lopen over alle cores.
+static void BenchRedact() {
+    const int w = g_quick ? 640 : 3840, h = g_quick ? 360 : 2160;
+    const auto img = TestImageText(w, h, 34, false);
+    std::vector<uint8_t> px = img;
+    const PixRect rects[] = { { 200, 150, std::min(w, 1000), 270 }, { 0, 0, w, h } };
+    for (const PixRect& r : rects) {
+        const double pixMs = BenchMs(9, [&] { PixelateRect(px.data(), (ptrdiff_t)w * 4, w, h, r, 16); });
+        px = img;
+        const double blur8Ms = BenchMs(5, [&] { BlurRect(px.data(), (ptrdiff_t)w * 4, w, h, r, 8.0f); });
+        px = img;
+        const double blur24Ms = BenchMs(5, [&] { BlurRect(px.data(), (ptrdiff_t)w * 4, w, h, r, 24.0f); });
+        px = img;
+        std::printf("redact: %dx%d in %dx%d: pixelate %.2f ms, blur sigma 8 %.2f ms, sigma 24 %.2f ms (%u threads)\n",
+            r.Width(), r.Height(), w, h, pixMs, blur8Ms, blur24Ms, std::max(1u, std::thread::hardware_concurrency()));
+    }
+}
+
+// Save-latency (pre-encode): wat de gebruiker na de klik merkt. "on click" = Auto-keuze +
+// encoderen + wegschrijven; "pre-encoded" = alleen de bytes van de idle-job wegschrijven;
+// "click during job" = de job loopt nog (klik na 'idle' ms), wachten op de rest + schrijven.
+// PngEncodeLossless staat in voor de WIC-encoder (die is alleen op Windows te meten).
+static void BenchSaveEncode() {
+    const int w = g_quick ? 640 : 3840, h = g_quick ? 360 : 2160;
+    const auto path = TestTempPath("bench_save.png");
+    struct Content { const char* name; std::vector<uint8_t> px; };
+    const Content contents[] = { { "ui", TestImageUi(w, h, 36) }, { "text", TestImageText(w, h, 36, true) },
+                                 { "photo", TestImagePhoto(w, h, 36) } };
+    for (const Content& c : contents) {
+        std::vector<uint8_t> png;
+        const char* desc = "";
+        const double clickMs = BenchMs(3, [&] {
+            (void)ClassifyContent(AnalyzeContentSampled(c.px.data(), w, h, w * 4, 1000.0));
+            PngEncodeLossless(c.px.data(), w, h, {}, png, desc);
+            WriteFileBytes(path, png);
+            });
+        const double writeMs = BenchMs(5, [&] { WriteFileBytes(path, png); });
+
+        // klik halverwege de job: de UI wacht alleen de rest af
+        std::vector<double> waits;
+        for (int i = 0; i < (g_quick ? 1 : 3); ++i) {
+            std::vector<uint8_t> bytes;
+            std::thread job([&] {
+                const char* d = "";
+                (void)ClassifyContent(AnalyzeContentSampled(c.px.data(), w, h, w * 4, 1000.0));
+                PngEncodeLossless(c.px.data(), w, h, {}, bytes, d);
+                });
+            std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(clickMs / 2));
+            const auto t0 = std::chrono::steady_clock::now();
+            job.join();
+            WriteFileBytes(path, bytes);
+            waits.push_back(MsSince(t0));
+        }
+        std::sort(waits.begin(), waits.end());
+        std::printf("save-encode: %dx%d %-5s %.2f MB (%s): on click %.1f ms, click during job %.1f ms, "
+            "pre-encoded %.2f ms\n", w, h, c.name, png.size() / 1048576.0, desc, clickMs, waits[waits.size() / 2], writeMs);
+    }
+    std::filesystem::remove(path);
+}
+
+// Nabewerking als rijband-pipeline ("fused") tegen een volledige pass per stap
+// ("staged"), met twee kopie-sinks zoals het clipboard: gewone capture en lasso-keten.
+static void BenchPipeline() {
+    const int w = g_quick ? 640 : 3840, h = g_quick ? 360 : 2160;
+    const double mb = (double)w * h * 4 / 1048576.0;
+    for (bool lasso : { false, true }) {
+        const BandBenchResult r = BandPipelineBenchmark(w, h, lasso, g_quick ? 1 : 5);
+        std::printf("pipeline: %dx%d -> %dx%d %s, 2 copy sinks, %u threads: fused %.1f ms (%.0f MB/s, %d bands), "
+            "staged %.1f ms (%.0f MB/s), %.2fx, output %s\n", w, h, r.outW, r.outH, r.chain.c_str(),
+            std::max(1u, std::thread::hardware_concurrency()), r.fusedMs, mb / (r.fusedMs / 1000.0), r.bands,
+            r.stagedMs, mb / (r.stagedMs / 1000.0), r.stagedMs / r.fusedMs, r.identical ? "identical" : "DIFFERS");
+    }
+}
+
+struct BenchEntry {
+    const char* name;
+    void (*fn)();
+};
+
+static const BenchEntry kBenches[] = {
+    { "auto-format", BenchAutoFormat },
+    { "hash", BenchHash },
+    { "annotations", BenchAnnotations },
+    { "redact", BenchRedact },
+    { "save-encode", BenchSaveEncode },
+    { "apng", BenchApng },
+    { "stitch", BenchStitch },
+    { "loupe", BenchLoupe },
+    { "edge-map", BenchEdgeMap },
+    { "naming", BenchNaming },
+    { "catalog", BenchCatalog },
+    { "resample", BenchResample },
+    { "pipeline", BenchPipeline },
+    { "similar", BenchSimilar },
+};
+
+int main(int argc, char** argv) {
+    std::vector<std::string> only;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) g_quick = true;
+        else only.push_back(argv[i]);
+    }
+    int ran = 0;
+    for (const BenchEntry& b : kBenches) {
+        if (!only.empty() && std::find(only.begin(), only.end(), b.name) == only.end()) continue;
+        b.fn();
+        ++ran;
+    }
+    if (ran == 0) {
+        std::fprintf(stderr, "snip_bench: unknown benchmark; available:");
+        for (const BenchEntry& b : kBenches) std::fprintf(stderr, " %s", b.name);
+        std::fprintf(stderr, "\n");
+        return 1;
+    }
+    return 0;
+}
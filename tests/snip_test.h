@@ -0,0 +1,207 @@
+// Gemeenschappelijk voor tests/: de portable kern van main.cpp (zonder Win32),
+// een paar CHECK-macro's en synthetische beelden.
+#pragma once
+
+#define SNIP_CORE_ONLY 1
+#include "main.cpp"
+
+#include <cstdio>
+#include <random>
+
+static int g_checkFailures = 0;
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++g_checkFailures;                                                      \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                              \
+    do {                                                                            \
+        const long long va_ = (long long)(a), vb_ = (long long)(b);                 \
+        if (va_ != vb_) {                                                           \
+            std::fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",  \
+                __FILE__, __LINE__, #a, #b, va_, vb_);                              \
+            ++g_checkFailures;                                                      \
+        }                                                                           \
+    } while (0)
+
+static int TestExit(const char* name) {
+    if (g_checkFailures) std::fprintf(stderr, "%s: %d check(s) failed\n", name, g_checkFailures);
+    else std::printf("%s: ok\n", name);
+    return g_checkFailures ? 1 : 0;
+}
+
+// uniek per proces, zodat parallelle ctest-runs elkaar niet raken
+static std::filesystem::path TestTempPath(const char* name) {
+    static const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    return std::filesystem::temp_directory_path() / (std::string("snip_test_") + std::to_string(stamp) + "_" + name);
+}
+
+// BGRA top-down, stride w*4
+static std::vector<uint8_t> TestImageNoise(int w, int h, uint32_t seed) {
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    std::mt19937 rng(seed);
+    for (auto& b : img) b = (uint8_t)rng();
+    return img;
+}
+
+// UI-achtig: vlakke blokken in een handvol kleuren
+static std::vector<uint8_t> TestImageBlocks(int w, int h) {
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            uint8_t* p = &img[((size_t)y * w + x) * 4];
+            const uint8_t c = (uint8_t)(((x / 100) + (y / 50)) % 5 * 40);
+            p[0] = c; p[1] = c; p[2] = 200; p[3] = 255;
+        }
+    return img;
+}
+
+// foto-achtig: gradienten met ruis
+static std::vector<uint8_t> TestImagePhoto(int w, int h, uint32_t seed) {
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    std::mt19937 rng(seed);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            uint8_t* p = &img[((size_t)y * w + x) * 4];
+            p[0] = (uint8_t)((x + rng() % 40) & 255);
+            p[1] = (uint8_t)((y + rng() % 40) & 255);
+            p[2] = (uint8_t)(((x + y) / 2 + rng() % 30) & 255);
+            p[3] = 255;
+        }
+    return img;
+}
+
+// tekst-screenshot: regels "woorden" van anti-aliased streepjes op een lichte achtergrond;
+// subpixel = ClearType-achtige kleurranden (andere dekking per kanaal)
+static std::vector<uint8_t> TestImageText(int w, int h, uint32_t seed, bool subpixel) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    const uint8_t bg = (uint8_t)(235 + rng() % 21), fg = (uint8_t)(rng() % 60);
+    for (size_t i = 0; i < img.size(); i += 4) { img[i] = img[i + 1] = img[i + 2] = bg; img[i + 3] = 255; }
+    const int lineH = 14 + (int)(rng() % 8), glyphW = 6 + (int)(rng() % 4);
+    for (int y0 = 6; y0 + lineH <= h; y0 += lineH + 4) {
+        int x = 8 + (int)(rng() % 20);
+        while (x + glyphW < w - 8) {
+            const int letters = 2 + (int)(rng() % 9);
+            for (int g = 0; g < letters && x + glyphW < w - 8; ++g, x += glyphW) {
+                const int strokes = 1 + (int)(rng() % 3);
+                for (int s = 0; s < strokes; ++s) {
+                    // verticale streep met een fractionele linkerrand (dekking 0..1)
+                    const double sx = x + (rng() % (glyphW * 8)) / 8.0;
+                    const int top = y0 + (int)(rng() % 4), bottom = y0 + lineH - (int)(rng() % 4);
+                    for (int yy = top; yy < bottom; ++yy)
+                        for (int xx = (int)sx - 1; xx <= (int)sx + 2 && xx < w; ++xx) {
+                            uint8_t* p = &img[((size_t)yy * w + xx) * 4];
+                            for (int c = 0; c < 3; ++c) {
+                                const double shift = subpixel ? (c - 1) / 3.0 : 0.0;
+                                const double cov = std::clamp(std::min(xx + 1 - (sx + shift), sx + shift + 1.4 - xx), 0.0, 1.0);
+                                const int v = (int)std::lround(p[c] + (fg - p[c]) * cov);
+                                p[c] = (uint8_t)std::min<int>(p[c], v);
+                            }
+                        }
+                }
+            }
+            x += glyphW;   // spatie
+        }
+    }
+    return img;
+}
+
+// vloeiende gradient (lineair in twee richtingen), zoals een achtergrond of een venstertitel
+static std::vector<uint8_t> TestImageGradient(int w, int h, uint32_t seed) {
+    std::mt19937 rng(seed);
+    const int c0[3] = { (int)(rng() % 256), (int)(rng() % 256), (int)(rng() % 256) };
+    const int c1[3] = { (int)(rng() % 256), (int)(rng() % 256), (int)(rng() % 256) };
+    const double tilt = (rng() % 100) / 100.0;
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            const double t = ((double)x / w + tilt * y / h) / (1.0 + tilt);
+            uint8_t* p = &img[((size_t)y * w + x) * 4];
+            for (int c = 0; c < 3; ++c) p[c] = (uint8_t)std::lround(c0[c] + (c1[c] - c0[c]) * t);
+            p[3] = 255;
+        }
+    return img;
+}
+
+// UI met variatie: panelen, randen en iconen in een paar kleuren
+static std::vector<uint8_t> TestImageUi(int w, int h, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    const uint32_t palette[] = { 0xF3F3F3, 0xFFFFFF, 0x2B579A, 0xE1E1E1, 0x333333, 0x0078D4, 0xC42B1C, 0x107C10 };
+    auto fill = [&](int x0, int y0, int x1, int y1, uint32_t c) {
+        for (int y = std::max(0, y0); y < std::min(h, y1); ++y)
+            for (int x = std::max(0, x0); x < std::min(w, x1); ++x) {
+                uint8_t* p = &img[((size_t)y * w + x) * 4];
+                p[0] = (uint8_t)c; p[1] = (uint8_t)(c >> 8); p[2] = (uint8_t)(c >> 16); p[3] = 255;
+            }
+    };
+    fill(0, 0, w, h, palette[0]);
+    fill(0, 0, w, 32, palette[2]);                   // titelbalk
+    for (int i = 0; i < 12; ++i) {
+        const int x0 = (int)(rng() % w), y0 = 40 + (int)(rng() % h);
+        const int x1 = x0 + 80 + (int)(rng() % (w / 3)), y1 = y0 + 24 + (int)(rng() % (h / 4));
+        fill(x0, y0, x1, y1, palette[3]);                // rand
+        fill(x0 + 1, y0 + 1, x1 - 1, y1 - 1, palette[1 + rng() % 2]);
+        for (int k = 0; k < 6; ++k) {                    // iconen / knoppen
+            const int ix = x0 + 6 + k * 22;
+            fill(ix, y0 + 6, ix + 16, y0 + 22, palette[4 + rng() % 4]);
+        }
+    }
+    return img;
+}
+
+// zachte foto: lage frequenties (lucht, huid, onscherpe achtergrond) met lichte sensorruis
+static std::vector<uint8_t> TestImagePhotoSmooth(int w, int h, uint32_t seed) {
+    std::mt19937 rng(seed);
+    double f[3][4];
+    for (auto& ch : f)
+        for (double& v : ch) v = 1.0 + (rng() % 600) / 100.0;
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            const double u = (double)x / w * 6.2832, v = (double)y / h * 6.2832;
+            uint8_t* p = &img[((size_t)y * w + x) * 4];
+            for (int c = 0; c < 3; ++c) {
+                const double s = 128 + 50 * std::sin(u * f[c][0] + v * f[c][1]) + 40 * std::cos(u * f[c][2] - v * f[c][3]);
+                p[c] = (uint8_t)std::clamp((int)std::lround(s) + (int)(rng() % 9) - 4, 0, 255);
+            }
+            p[3] = 255;
+        }
+    return img;
+}
+
+struct TestLabelledImage {
+    const char*          label;
+    SaveFormat           expect;
+    int                  w, h;
+    std::vector<uint8_t> px;
+};
+
+// Auto-format corpus met de verwachte keuze: tekst, UI en gradient -> PNG, foto -> JPEG
+static std::vector<TestLabelledImage> TestAutoCorpus(int w, int h, int perLabel) {
+    std::vector<TestLabelledImage> out;
+    for (int i = 0; i < perLabel; ++i) {
+        const uint32_t s = (uint32_t)i + 1;
+        out.push_back({ "text", SaveFormat::Png, w, h, TestImageText(w, h, s, i % 2 == 1) });
+        out.push_back({ "photo", SaveFormat::Jpeg, w, h, i % 2 ? TestImagePhotoSmooth(w, h, s) : TestImagePhoto(w, h, s) });
+        out.push_back({ "ui", SaveFormat::Png, w, h, i % 2 ? TestImageUi(w, h, s) : TestImageBlocks(w, h) });
+        out.push_back({ "gradient", SaveFormat::Png, w, h, TestImageGradient(w, h, s) });
+    }
+    return out;
+}
+
+// RGBA-frame als PNG met vast kleurtype (alle APNG-frames delen de IHDR)
+static std::vector<uint8_t> FramePng(const std::vector<uint8_t>& img, int w, const PixRect& r) {
+    std::vector<uint8_t> packed((size_t)r.Width() * r.Height() * 4), filtered, z, png;
+    for (int y = 0; y < r.Height(); ++y)
+        std::memcpy(&packed[(size_t)y * r.Width() * 4], &img[((size_t)(r.y0 + y) * w + r.x0) * 4], (size_t)r.Width() * 4);
+    PngFilterRows(packed, (size_t)r.Width() * 4, r.Height(), 4, kPngFilterAdaptive, filtered);
+    DeflateZlib(filtered.data(), filtered.size(), z);
+    PngAssemble(r.Width(), r.Height(), 6, 8, {}, {}, z, png);
+    return png;
+}
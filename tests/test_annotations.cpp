@@ -0,0 +1,125 @@
+// Annotaties: incrementeel hercomponeren == alles opnieuw, shapes blijven binnen
+// AnnotBounds, hit-test en markeerstift.
+#include "snip_test.h"
+
+static AnnotShape RandomShape(std::mt19937& rng, int w, int h) {
+    AnnotShape s;
+    s.kind = (AnnotKind)(rng() % 3);
+    s.x0 = (int)(rng() % w); s.y0 = (int)(rng() % h);
+    s.x1 = s.x0 + (int)(rng() % 400) - 200; s.y1 = s.y0 + (int)(rng() % 300) - 150;
+    s.thickness = 1 + (int)(rng() % 20);
+    s.color = (rng() % 2 ? 0xFF000000u : 0x80000000u) | (rng() & 0xFFFFFFu);
+    return s;
+}
+
+static void TestIncrementalMatchesFull() {
+    const int w = 1200, h = 800;
+    auto base = TestImageNoise(w, h, 7);
+    // dst bottom-up (zoals een DIB), base top-down
+    std::vector<uint8_t> dst = base;
+    const ptrdiff_t st = -(ptrdiff_t)w * 4;
+    uint8_t* top = dst.data() + (size_t)(h - 1) * w * 4;
+    for (int y = 0; y < h; ++y) std::memcpy(top + (ptrdiff_t)y * st, &base[(size_t)y * w * 4], (size_t)w * 4);
+
+    std::mt19937 rng(33);
+    AnnotScene sc;
+    for (int i = 0; i < 80; ++i) {
+        const int op = (int)(rng() % 4);
+        if (op < 2 || sc.shapes.empty()) {
+            sc.shapes.push_back(RandomShape(rng, w, h));
+            AnnotRecomposite(sc, base.data(), w * 4, top, st, w, h, AnnotBounds(sc.shapes.back()));
+        }
+        else if (op == 2) {
+            // verplaatsen: oude + nieuwe plek
+            AnnotShape& s = sc.shapes[rng() % sc.shapes.size()];
+            const PixRect before = AnnotBounds(s);
+            const int dx = (int)(rng() % 120) - 60, dy = (int)(rng() % 120) - 60;
+            s.x0 += dx; s.x1 += dx; s.y0 += dy; s.y1 += dy;
+            AnnotRecomposite(sc, base.data(), w * 4, top, st, w, h, PixRectUnion(before, AnnotBounds(s)));
+        }
+        else {
+            const size_t k = rng() % sc.shapes.size();
+            const PixRect gone = AnnotBounds(sc.shapes[k]);
+            sc.shapes.erase(sc.shapes.begin() + (ptrdiff_t)k);
+            AnnotRecomposite(sc, base.data(), w * 4, top, st, w, h, gone);
+        }
+    }
+    std::vector<uint8_t> full((size_t)w * h * 4);
+    AnnotRecomposite(sc, base.data(), w * 4, full.data(), w * 4, w, h, PixRect{ 0, 0, w, h });
+    size_t rowsDiffer = 0;
+    for (int y = 0; y < h; ++y)
+        rowsDiffer += std::memcmp(top + (ptrdiff_t)y * st, &full[(size_t)y * w * 4], (size_t)w * 4) != 0;
+    CHECK_EQ(rowsDiffer, 0);
+    CHECK(full != base); // er is echt getekend
+}
+
+static void TestShapesStayInBounds() {
+    const int w = 300, h = 200;
+    std::mt19937 rng(34);
+    for (int i = 0; i < 200; ++i) {
+        AnnotScene one;
+        one.shapes.push_back(RandomShape(rng, w, h));
+        one.shapes[0].color |= 0xFF000000u;
+        std::vector<uint8_t> base((size_t)w * h * 4, 0x80), img((size_t)w * h * 4);
+        AnnotRecomposite(one, base.data(), w * 4, img.data(), w * 4, w, h, PixRect{ 0, 0, w, h });
+        const PixRect b = AnnotBounds(one.shapes[0]);
+        bool inside = true;
+        for (int y = 0; y < h && inside; ++y)
+            for (int x = 0; x < w && inside; ++x)
+                if (std::memcmp(&img[((size_t)y * w + x) * 4], &base[((size_t)y * w + x) * 4], 4) != 0)
+                    inside = x >= b.x0 && x < b.x1 && y >= b.y0 && y < b.y1;
+        CHECK(inside);
+    }
+}
+
+static void TestArrowAndHitTest() {
+    const int w = 200, h = 100;
+    AnnotScene sc;
+    AnnotShape a;
+    a.x0 = 10; a.y0 = 10; a.x1 = 100; a.y1 = 60; a.thickness = 4;
+    a.color = 0xFFFF0000u;
+    sc.shapes.push_back(a);
+    std::vector<uint8_t> base((size_t)w * h * 4, 0), img((size_t)w * h * 4);
+    AnnotRecomposite(sc, base.data(), w * 4, img.data(), w * 4, w, h, PixRect{ 0, 0, w, h });
+    auto red = [&](int x, int y) { return img[((size_t)y * w + x) * 4 + 2]; };
+    CHECK(red(10, 10) > 128);  // staart
+    CHECK(red(55, 35) > 128);  // schacht
+    CHECK(red(97, 58) > 128);  // punt
+    CHECK_EQ(red(150, 20), 0);
+
+    AnnotShape box;
+    box.kind = AnnotKind::Box;
+    box.x0 = 50; box.y0 = 20; box.x1 = 150; box.y1 = 80;
+    sc.shapes.push_back(box);
+    CHECK_EQ(AnnotHitTest(sc, 90, 50), 1);  // bovenste wint
+    CHECK_EQ(AnnotHitTest(sc, 12, 12), 0);
+    CHECK_EQ(AnnotHitTest(sc, 199, 99), -1);
+}
+
+static void TestHighlightMultiplies() {
+    const int w = 20, h = 10;
+    AnnotScene sc;
+    AnnotShape hl;
+    hl.kind = AnnotKind::Highlight;
+    hl.x0 = 2; hl.y0 = 2; hl.x1 = 9; hl.y1 = 5;
+    hl.color = 0xFFFFEB3Bu;
+    sc.shapes.push_back(hl);
+    std::vector<uint8_t> base((size_t)w * h * 4, 255), img((size_t)w * h * 4);
+    base[((size_t)3 * w + 3) * 4 + 0] = 0; // zwart 'tekst'-pixel blijft zwart
+    base[((size_t)3 * w + 3) * 4 + 1] = 0;
+    base[((size_t)3 * w + 3) * 4 + 2] = 0;
+    AnnotRecomposite(sc, base.data(), w * 4, img.data(), w * 4, w, h, PixRect{ 0, 0, w, h });
+    const uint8_t* p = &img[((size_t)4 * w + 5) * 4];
+    CHECK(p[0] == 0x3B && p[1] == 0xEB && p[2] == 0xFF);
+    const uint8_t* t = &img[((size_t)3 * w + 3) * 4];
+    CHECK(t[0] == 0 && t[1] == 0 && t[2] == 0);
+    CHECK(img[((size_t)6 * w + 5) * 4] == 255); // onder de rechthoek
+}
+
+int main() {
+    TestIncrementalMatchesFull();
+    TestShapesStayInBounds();
+    TestArrowAndHitTest();
+    TestHighlightMultiplies();
+    return TestExit("test_annotations");
+}
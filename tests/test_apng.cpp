@@ -0,0 +1,142 @@
+// APNG: DiffBounds + writer. De test leest het bestand chunk voor chunk terug en
+// decodeert elk frame (fcTL-rechthoek + IDAT/fdAT) los met PngDecode.
+#include "snip_test.h"
+
+struct ApngFrame {
+    PixRect rect;
+    uint16_t delayNum = 0, delayDen = 0;
+    std::vector<uint8_t> rgba;
+};
+
+static bool ReadApng(const std::vector<uint8_t>& f, int& w, int& h, uint32_t& numFrames, std::vector<ApngFrame>& frames) {
+    if (f.size() < 8 || std::memcmp(f.data(), kPngSignature, 8) != 0) return false;
+    std::vector<uint8_t> ihdr;
+    uint32_t nextSeq = 0;
+    bool end = false;
+    auto finish = [&](std::vector<uint8_t>& data) {
+        if (frames.empty()) return false;
+        ApngFrame& fr = frames.back();
+        std::vector<uint8_t> single(kPngSignature, kPngSignature + 8), hd = ihdr;
+        for (int i = 0; i < 4; ++i) { hd[i] = (uint8_t)(fr.rect.Width() >> (24 - 8 * i)); hd[4 + i] = (uint8_t)(fr.rect.Height() >> (24 - 8 * i)); }
+        PngPutChunk(single, "IHDR", hd.data(), hd.size());
+        PngPutChunk(single, "IDAT", data.data(), data.size());
+        PngPutChunk(single, "IEND", nullptr, 0);
+        int fw = 0, fh = 0;
+        const char* why = "";
+        data.clear();
+        return PngDecode(single.data(), single.size(), fr.rgba, fw, fh, nullptr, why) && fw == fr.rect.Width() && fh == fr.rect.Height();
+    };
+    std::vector<uint8_t> data;
+    for (size_t p = 8; p + 12 <= f.size() && !end; ) {
+        const uint32_t len = PngBE32(&f[p]);
+        if (len > f.size() - p - 12) return false;
+        const uint8_t* type = &f[p + 4];
+        const uint8_t* d = type + 4;
+        if (Crc32Update(0, type, len + 4) != PngBE32(d + len)) return false;
+        if (!std::memcmp(type, "IHDR", 4)) { ihdr.assign(d, d + len); w = (int)PngBE32(d); h = (int)PngBE32(d + 4); }
+        else if (!std::memcmp(type, "acTL", 4)) numFrames = PngBE32(d);
+        else if (!std::memcmp(type, "fcTL", 4)) {
+            if (!data.empty() && !finish(data)) return false;
+            if (PngBE32(d) != nextSeq++) return false;
+            ApngFrame fr;
+            fr.rect.x0 = (int)PngBE32(d + 12); fr.rect.y0 = (int)PngBE32(d + 16);
+            fr.rect.x1 = fr.rect.x0 + (int)PngBE32(d + 4); fr.rect.y1 = fr.rect.y0 + (int)PngBE32(d + 8);
+            fr.delayNum = (uint16_t)(d[20] << 8 | d[21]); fr.delayDen = (uint16_t)(d[22] << 8 | d[23]);
+            if (d[24] != 0 || d[25] != 0) return false; // dispose NONE, blend SOURCE
+            frames.push_back(std::move(fr));
+        }
+        else if (!std::memcmp(type, "IDAT", 4)) data.insert(data.end(), d, d + len);
+        else if (!std::memcmp(type, "fdAT", 4)) {
+            if (PngBE32(d) != nextSeq++) return false;
+            data.insert(data.end(), d + 4, d + len);
+        }
+        else if (!std::memcmp(type, "IEND", 4)) end = true;
+        p += 12 + len;
+    }
+    return end && !data.empty() && finish(data);
+}
+
+static void TestDiffBounds() {
+    const int w = 64, h = 40;
+    auto a = TestImageNoise(w, h, 3);
+    auto b = a;
+    PixRect r{};
+    CHECK(!DiffBounds(b.data(), a.data(), w, h, (size_t)w * 4, r));
+    b[((size_t)5 * w + 7) * 4] ^= 1;
+    b[((size_t)20 * w + 50) * 4 + 2] ^= 1;
+    CHECK(DiffBounds(b.data(), a.data(), w, h, (size_t)w * 4, r));
+    CHECK(r.x0 == 7 && r.y0 == 5 && r.x1 == 51 && r.y1 == 21);
+    b[((size_t)(h - 1) * w + (w - 1)) * 4 + 3] ^= 1;
+    CHECK(DiffBounds(b.data(), a.data(), w, h, (size_t)w * 4, r));
+    CHECK(r.x1 == w && r.y1 == h);
+}
+
+static void TestWriter() {
+    const int w = 97, h = 61;
+    const size_t stride = (size_t)w * 4;
+    std::vector<uint8_t> cur(stride * h), prev;
+    for (size_t i = 0; i < cur.size(); ++i) cur[i] = (uint8_t)(i * 7);
+
+    const auto path = TestTempPath("rec.png");
+    ApngWriter aw;
+    CHECK(ApngWriterOpen(aw, path, w, h));
+    std::vector<std::vector<uint8_t>> canvases;
+    std::vector<uint64_t> times;
+    uint64_t t = 0;
+    for (int f = 0; f < 8; ++f, t += 100) {
+        if (f > 0 && f != 3) {
+            const int x0 = (f * 13) % w, y0 = (f * 7) % h;
+            for (int y = y0; y < std::min(h, y0 + 10); ++y)
+                for (int x = x0; x < std::min(w, x0 + f * 5); ++x) cur[y * stride + x * 4 + 1] ^= 0x5A;
+        }
+        PixRect r{ 0, 0, w, h };
+        if (f > 0 && !DiffBounds(cur.data(), prev.data(), w, h, stride, r)) { prev = cur; continue; }
+        CHECK(ApngWriterAddFrame(aw, FramePng(cur, w, r), r, t));
+        canvases.push_back(cur);
+        times.push_back(t);
+        prev = cur;
+    }
+    CHECK(ApngWriterClose(aw, t));
+    CHECK_EQ(aw.frames, 7);
+
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    CHECK_EQ(file.size(), aw.bytes);
+
+    int fw = 0, fh = 0;
+    uint32_t num = 0;
+    std::vector<ApngFrame> frames;
+    CHECK(ReadApng(file, fw, fh, num, frames));
+    CHECK(fw == w && fh == h);
+    CHECK_EQ(num, canvases.size());
+    CHECK_EQ(frames.size(), canvases.size());
+
+    // canvas opbouwen zoals een viewer (dispose NONE, blend SOURCE)
+    std::vector<uint8_t> canvas(stride * h, 0);
+    for (size_t i = 0; i < frames.size() && i < canvases.size(); ++i) {
+        const ApngFrame& fr = frames[i];
+        CHECK(fr.rect.x1 <= w && fr.rect.y1 <= h);
+        if (i == 0) CHECK(fr.rect.x0 == 0 && fr.rect.y0 == 0 && fr.rect.Width() == w && fr.rect.Height() == h);
+        for (int y = 0; y < fr.rect.Height(); ++y)
+            std::memcpy(&canvas[(size_t)(fr.rect.y0 + y) * stride + (size_t)fr.rect.x0 * 4],
+                &fr.rgba[(size_t)y * fr.rect.Width() * 4], (size_t)fr.rect.Width() * 4);
+        CHECK(canvas == canvases[i]);
+        const uint64_t next = i + 1 < times.size() ? times[i + 1] : t;
+        CHECK(fr.delayDen == 1000 && fr.delayNum == next - times[i]);
+    }
+    std::filesystem::remove(path);
+
+    // eerste frame moet het hele canvas zijn
+    ApngWriter bad;
+    CHECK(ApngWriterOpen(bad, path, w, h));
+    CHECK(!ApngWriterAddFrame(bad, FramePng(cur, w, PixRect{ 0, 0, 10, 10 }), PixRect{ 0, 0, 10, 10 }, 0));
+    CHECK(!ApngWriterClose(bad, 0));
+    std::filesystem::remove(path);
+}
+
+int main() {
+    TestDiffBounds();
+    TestWriter();
+    return TestExit("test_apng");
+}
@@ -0,0 +1,93 @@
+// Auto format: content-analyse, classificatie (ook de trefkans op een gelabeld corpus)
+// en exacte palette.
+#include "snip_test.h"
+
+#include <map>
+
+static void TestClassify() {
+    const int w = 1920, h = 1080;
+    auto ui = TestImageBlocks(w, h);
+    ContentStats st = AnalyzeContentSampled(ui.data(), w, h, w * 4, 1000.0);
+    CHECK(st.samples >= 64);
+    CHECK(st.distinctColors <= 256);
+    CHECK(ClassifyContent(st).enc == AutoEncoding::PngIndexed);
+
+    auto photo = TestImagePhoto(w, h, 1);
+    st = AnalyzeContentSampled(photo.data(), w, h, w * 4, 1000.0);
+    CHECK_EQ(st.distinctColors, kAutoMaxColors);
+    const AutoChoice c = ClassifyContent(st);
+    CHECK(c.fmt == SaveFormat::Jpeg);
+    CHECK(c.jpegQuality >= 0.85f && c.jpegQuality <= 0.95f);
+
+    // te weinig samples: veilige keuze (truecolour PNG)
+    ContentStats few{};
+    few.samples = 10;
+    CHECK(ClassifyContent(few).fmt == SaveFormat::Png);
+    CHECK(ClassifyContent(few).enc == AutoEncoding::PngTrue);
+
+    // te klein om te analyseren
+    CHECK_EQ(AnalyzeContentSampled(photo.data(), 1, 1, 4, 1000.0).samples, 0);
+}
+
+// Tekst, foto (ruisig en zacht), UI en gradient: per soort moet bijna alles goed zijn.
+static void TestCorpusHitRate() {
+    for (const auto& [w, h] : { std::pair{ 640, 360 }, std::pair{ 1920, 1080 } }) {
+        std::map<std::string, std::pair<int, int>> rate;   // label -> (goed, totaal)
+        for (const TestLabelledImage& img : TestAutoCorpus(w, h, 6)) {
+            const ContentStats st = AnalyzeContentSampled(img.px.data(), img.w, img.h, img.w * 4, 1000.0);
+            auto& r = rate[img.label];
+            r.first += ClassifyContent(st).fmt == img.expect;
+            ++r.second;
+        }
+        for (const auto& [label, r] : rate) {
+            std::printf("auto-format %dx%d %-8s %d/%d\n", w, h, label.c_str(), r.first, r.second);
+            CHECK(r.first * 10 >= r.second * 9);
+        }
+    }
+}
+
+static void TestBudget() {
+    // budget 0: stopt na de eerste rij, maar levert wel samples
+    auto photo = TestImagePhoto(2000, 2000, 2);
+    const ContentStats st = AnalyzeContentSampled(photo.data(), 2000, 2000, 2000 * 4, 0.0);
+    CHECK(st.timedOut);
+    CHECK(st.samples > 0);
+}
+
+static void TestPalette() {
+    const int w = 300, h = 200;
+    auto ui = TestImageBlocks(w, h);
+    std::vector<uint32_t> pal;
+    std::vector<uint8_t> idx;
+    CHECK(BuildExactPalette(ui.data(), w, h, w * 4, pal, idx));
+    CHECK(pal.size() <= 256);
+    bool exact = idx.size() == (size_t)w * h;
+    for (int y = 0; y < h && exact; ++y)
+        for (int x = 0; x < w && exact; ++x) {
+            const uint8_t* p = &ui[((size_t)y * w + x) * 4];
+            const uint32_t c = pal[idx[(size_t)y * w + x]];
+            exact = (c & 0xFFFFFFu) == ((uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0]) && (c >> 24) == 0xFF;
+        }
+    CHECK(exact);
+
+    // bottom-up: zelfde indices als top-down
+    std::vector<uint8_t> bu(ui.size());
+    for (int y = 0; y < h; ++y) std::memcpy(&bu[(size_t)(h - 1 - y) * w * 4], &ui[(size_t)y * w * 4], (size_t)w * 4);
+    std::vector<uint32_t> pal2;
+    std::vector<uint8_t> idx2;
+    CHECK(BuildExactPalette(bu.data() + (size_t)(h - 1) * w * 4, w, h, -(ptrdiff_t)w * 4, pal2, idx2));
+    CHECK(pal2 == pal && idx2 == idx);
+
+    // 257 kleuren: geen palette
+    std::vector<uint8_t> many((size_t)257 * 4, 0);
+    for (int i = 0; i < 257; ++i) { many[(size_t)i * 4] = (uint8_t)i; many[(size_t)i * 4 + 1] = (uint8_t)(i >> 8); }
+    CHECK(!BuildExactPalette(many.data(), 257, 1, 257 * 4, pal, idx));
+}
+
+int main() {
+    TestClassify();
+    TestCorpusHitRate();
+    TestBudget();
+    TestPalette();
+    return TestExit("test_auto_format");
+}
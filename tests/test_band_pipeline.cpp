@@ -0,0 +1,123 @@
+// Rijband-pipeline: schalen bit-gelijk aan ResampleLanczos, crop/opaque/pixelate tegen de
+// losse bewerking, willekeurige ketens en bandhoogtes gelijk aan de staged run (ook de
+// sinks), in-place alleen als alles pointwise is.
+#include "snip_test.h"
+
+static void TestBandPipelineMatches() {
+    std::mt19937 rng(46);
+    for (int iter = 0; iter < 40; ++iter) {
+        const int sw = 8 + (int)(rng() % 300), sh = 8 + (int)(rng() % 300);
+        const int dw = 1 + (int)(rng() % sw), dh = 1 + (int)(rng() % sh);
+        const bool alpha = rng() & 1;
+        const auto img = TestImageNoise(sw, sh, (uint32_t)iter);
+        std::vector<uint8_t> ref((size_t)dw * dh * 4), out(ref.size());
+        ResampleLanczos(img.data(), sw * 4, sw, sh, ref.data(), dw * 4, dw, dh, alpha);
+        BandPipeline p{ sw, sh, {}, {} };
+        CHECK(BandAddScale(p, dw, dh, alpha));
+        CHECK(BandPipelineRun(p, img.data(), sw * 4, out.data(), dw * 4, 1 + (int)(rng() % 40)) > 0);
+        CHECK(out == ref);
+    }
+}
+
+static void TestSimpleStages() {
+    const int w = 257, h = 131;
+    const auto img = TestImageNoise(w, h, 7);
+
+    // crop: precies het deelbeeld; geklemd op het beeld, leeg = false
+    BandPipeline p{ w, h, {}, {} };
+    CHECK(BandAddCrop(p, PixRect{ 13, 9, 13 + 100, 9 + 77 }));
+    CHECK(p.OutW() == 100 && p.OutH() == 77);
+    std::vector<uint8_t> out((size_t)100 * 77 * 4);
+    CHECK(BandPipelineRun(p, img.data(), w * 4, out.data(), 100 * 4, 5) > 0);
+    bool same = true;
+    for (int y = 0; y < 77; ++y) same = same && std::memcmp(&out[(size_t)y * 400], &img[((size_t)(y + 9) * w + 13) * 4], 400) == 0;
+    CHECK(same);
+    BandPipeline q{ w, h, {}, {} };
+    CHECK(BandAddCrop(q, PixRect{ 200, 100, 400, 400 }) && q.OutW() == w - 200 && q.OutH() == h - 100);
+    CHECK(!BandAddCrop(q, PixRect{ 500, 0, 600, 10 }));
+
+    // pixelate: gelijk aan PixelateRect op het hele beeld
+    for (int block : { 2, 7, 16 }) {
+        auto ref = img;
+        const PixRect r{ 20, 11, 230, 120 };
+        PixelateRect(ref.data(), (ptrdiff_t)w * 4, w, h, r, block);
+        BandPipeline px{ w, h, {}, {} };
+        CHECK(BandAddPixelate(px, r, block));
+        std::vector<uint8_t> got(img.size());
+        CHECK(BandPipelineRun(px, img.data(), w * 4, got.data(), w * 4, 3) > 0);
+        CHECK(got == ref);
+    }
+
+    // opaque in-place: RGB blijft, alpha 255; een niet-pointwise keten weigert in-place
+    auto inplace = img;
+    BandPipeline op{ w, h, {}, {} };
+    BandAddOpaque(op);
+    CHECK(BandPipelineInPlace(op));
+    CHECK(BandPipelineRun(op, inplace.data(), w * 4, inplace.data(), w * 4, 10) > 0);
+    bool opaque = true;
+    for (size_t i = 0; i < img.size(); i += 4)
+        opaque = opaque && inplace[i + 3] == 255 && std::memcmp(&inplace[i], &img[i], 3) == 0;
+    CHECK(opaque);
+    BandAddFeather(op, 1);
+    CHECK(!BandPipelineInPlace(op));
+    CHECK_EQ(BandPipelineRun(op, inplace.data(), w * 4, inplace.data(), w * 4), 0);
+
+    // lege keten = kopie; ongeldige bron = niets
+    BandPipeline copy{ w, h, {}, {} };
+    std::vector<uint8_t> dup(img.size());
+    CHECK(BandPipelineRun(copy, img.data(), w * 4, dup.data(), w * 4, 9) > 0 && dup == img);
+    CHECK_EQ(BandPipelineRun(copy, nullptr, w * 4, dup.data(), w * 4), 0);
+    CHECK_EQ(BandPipelineRun(BandPipeline{ 0, h, {}, {} }, img.data(), w * 4, dup.data(), w * 4), 0);
+}
+
+// Willekeurige ketens (crop, masker, feather, pixelate, schalen) met willekeurige
+// bandhoogtes: eindbeeld en beide sinks (waarvan één bottom-up) gelijk aan de staged run,
+// waarin elke stap een eigen pass over het hele beeld is.
+static void TestFusedMatchesStaged() {
+    std::mt19937 rng(50);
+    for (int iter = 0; iter < 30; ++iter) {
+        const int w = 40 + (int)(rng() % 400), h = 40 + (int)(rng() % 300);
+        auto img = TestImagePhoto(w, h, (uint32_t)iter);
+        for (size_t i = 3; i < img.size(); i += 4) img[i] = (uint8_t)rng();
+
+        BandPipeline p{ w, h, {}, {} };
+        if (rng() & 1) BandAddCrop(p, PixRect{ (int)(rng() % 10), (int)(rng() % 10), w - (int)(rng() % 10), h - (int)(rng() % 10) });
+        if (rng() & 1) BandAddOpaque(p);
+        if (rng() & 1) {
+            const int cw = p.OutW(), ch = p.OutH();
+            std::vector<PixPoint> poly;
+            const int n = 3 + (int)(rng() % 12);
+            for (int i = 0; i < n; ++i) poly.push_back({ (int)(rng() % (cw + 20)) - 10, (int)(rng() % (ch + 20)) - 10 });
+            BandAddMask(p, std::move(poly));
+        }
+        if (rng() & 1) BandAddFeather(p, 1 + (int)(rng() % 3));
+        if (rng() & 1) {
+            const int cw = p.OutW(), ch = p.OutH();
+            const int x0 = (int)(rng() % cw), y0 = (int)(rng() % ch);
+            BandAddPixelate(p, PixRect{ x0, y0, x0 + 1 + (int)(rng() % cw), y0 + 1 + (int)(rng() % ch) }, 2 + (int)(rng() % 20));
+        }
+        if (rng() & 1) BandAddScale(p, 1 + (int)(rng() % p.OutW()), 1 + (int)(rng() % p.OutH()), rng() & 1);
+
+        const int ow = p.OutW(), oh = p.OutH();
+        const ptrdiff_t os = (ptrdiff_t)ow * 4;
+        const size_t bytes = (size_t)os * oh;
+        std::vector<uint8_t> fused(bytes), staged(bytes), a0(bytes), a1(bytes), b0(bytes), b1(bytes);
+        p.sinks = { BandCopySink(a0.data() + (ptrdiff_t)(oh - 1) * os, -os), BandCopySink(a1.data(), os) };
+        CHECK(BandPipelineRun(p, img.data(), (ptrdiff_t)w * 4, fused.data(), os, 1 + (int)(rng() % 50)) > 0);
+        p.sinks = { BandCopySink(b0.data() + (ptrdiff_t)(oh - 1) * os, -os), BandCopySink(b1.data(), os) };
+        CHECK(BandPipelineRunStaged(p, img.data(), (ptrdiff_t)w * 4, staged.data(), os));
+        CHECK(fused == staged);
+        CHECK(a0 == b0 && a1 == b1);
+        CHECK(a1 == fused);
+        bool flipped = true;
+        for (int y = 0; y < oh; ++y) flipped = flipped && std::memcmp(&a0[(size_t)(oh - 1 - y) * os], &fused[(size_t)y * os], (size_t)os) == 0;
+        CHECK(flipped);
+    }
+}
+
+int main() {
+    TestBandPipelineMatches();
+    TestSimpleStages();
+    TestFusedMatchesStaged();
+    return TestExit("test_band_pipeline");
+}
@@ -0,0 +1,91 @@
+// Burst: tile-diff + delta-container (schrijven, teruglezen, corrupte staart).
+#include "snip_test.h"
+
+static void TestDiffTiles() {
+    const int w = 100, h = 70, tile = 32; // 4 x 3 tiles, rand-tiles zijn smal
+    auto a = TestImageNoise(w, h, 1);
+    auto b = a;
+    std::vector<uint8_t> ch;
+    CHECK_EQ(DiffTiles(b.data(), a.data(), w, h, (size_t)w * 4, tile, ch), 0);
+    CHECK_EQ(ch.size(), 12);
+
+    b[((size_t)69 * w + 99) * 4] ^= 1;   // laatste pixel: rechtsonder-tile
+    b[((size_t)33 * w + 40) * 4 + 3] ^= 1; // alleen alpha: tile (1,1)
+    CHECK_EQ(DiffTiles(b.data(), a.data(), w, h, (size_t)w * 4, tile, ch), 2);
+    CHECK(ch[11] == 1 && ch[5] == 1);
+    CHECK(ch[0] == 0 && ch[10] == 0);
+}
+
+static void TestRoundTrip() {
+    const int w = 333, h = 201, tile = 32;
+    const size_t stride = (size_t)w * 4;
+    std::mt19937 rng(5);
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> f(stride * h, 0);
+    for (size_t i = 0; i < f.size(); ++i) if (rng() % 4 == 0) f[i] = (uint8_t)rng();
+    for (int i = 0; i < 6; ++i) {
+        if (i == 4) {
+            // vlakke tile: wordt als één kleur opgeslagen
+            for (int y = 32; y < 64; ++y)
+                for (int x = 64; x < 96; ++x) std::memcpy(&f[y * stride + x * 4], "\x10\x20\x30\xFF", 4);
+        }
+        else if (i != 3) {
+            const int x0 = rng() % w, y0 = rng() % h;
+            for (int y = y0; y < std::min(h, y0 + 40); ++y)
+                for (int x = x0; x < std::min(w, x0 + 50); ++x) f[y * stride + x * 4 + 1] = (uint8_t)rng();
+        }
+        frames.push_back(f);
+    }
+
+    const auto path = TestTempPath("burst.snipburst");
+    DeltaWriter dw;
+    CHECK(DeltaWriterOpen(dw, path, w, h, tile));
+    std::vector<uint8_t> ch;
+    std::vector<size_t> stored;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (i == 0) { CHECK(DeltaWriterAddFrame(dw, frames[0].data(), stride, nullptr, 0)); stored.push_back(0); continue; }
+        if (DiffTiles(frames[i].data(), frames[i - 1].data(), w, h, stride, tile, ch) == 0) continue;
+        CHECK(DeltaWriterAddFrame(dw, frames[i].data(), stride, &ch, i * 100));
+        stored.push_back(i);
+    }
+    CHECK(DeltaWriterClose(dw));
+    CHECK_EQ(stored.size(), 5); // frame 3 is gelijk aan 2
+    CHECK(dw.bytes < stride * h * stored.size() / 2);
+    CHECK_EQ(std::filesystem::file_size(path), dw.bytes);
+
+    DeltaReader dr;
+    CHECK(DeltaReaderOpen(dr, path));
+    CHECK(dr.w == w && dr.h == h && dr.tile == tile);
+    size_t k = 0;
+    while (DeltaReaderNext(dr)) {
+        CHECK(k < stored.size());
+        if (k >= stored.size()) break;
+        CHECK_EQ(dr.timeMs, stored[k] * 100);
+        CHECK(dr.canvas == frames[stored[k]]);
+        ++k;
+    }
+    CHECK_EQ(k, stored.size());
+    dr.in.close();
+
+    // afgekapt bestand: het laatste frame faalt, de eerdere blijven leesbaar
+    std::filesystem::resize_file(path, dw.bytes - 7);
+    DeltaReader cut;
+    CHECK(DeltaReaderOpen(cut, path));
+    k = 0;
+    while (DeltaReaderNext(cut)) ++k;
+    CHECK_EQ(k, stored.size() - 1);
+    cut.in.close();
+
+    // verkeerde magic
+    { std::ofstream bad(path, std::ios::binary | std::ios::trunc); bad << "NOTBURST........"; }
+    DeltaReader nope;
+    CHECK(!DeltaReaderOpen(nope, path));
+    nope.in.close();
+    std::filesystem::remove(path);
+}
+
+int main() {
+    TestDiffTiles();
+    TestRoundTrip();
+    return TestExit("test_burst");
+}
@@ -0,0 +1,210 @@
+// Capture-sequencer op een nep-klok: een kleine event-loop speelt DWM (composities op
+// vsync), de timer en de worker na en voert de CaptureSeqOut-opdrachten uit, zoals
+// de UI-thread dat doet.
+#include "snip_test.h"
+
+struct FakeLoop {
+    CaptureSequencer seq;
+    double now = 0;
+    double vsyncMs = 1000.0 / 60.0;
+    bool dwm = true;            // false: compositie uit (DwmFlush faalt meteen)
+    bool dwmSilent = false;     // true: er komt nooit een compositie-melding
+    double timerSkewMs = 0;     // timer gaat zoveel te vroeg af (maar niet eerder dan 1 ms)
+    double workerMs = 5;
+    bool grabOk = true, processOk = true;
+
+    double timerAt = -1, composeAt = -1, processedAt = -1;
+    uint32_t composeGen = 0, processGen = 0;
+    int hides = 0, grabs = 0, finishes = 0, fails = 0;
+    double grabAt = -1;
+
+    void Apply(const CaptureSeqOut& o) {
+        if (o.hide) ++hides;
+        if (o.killTimer) timerAt = -1;
+        if (o.timerMs >= 0) timerAt = now + std::max(std::min(1.0, o.timerMs), o.timerMs - timerSkewMs);
+        if (o.waitComposition) {
+            composeGen = seq.gen;
+            if (!dwm) composeAt = now;
+            else if (!dwmSilent) composeAt = (std::floor(now / vsyncMs) + 1) * vsyncMs;
+        }
+        if (o.grab) {
+            ++grabs;
+            grabAt = now;
+            Apply(CaptureSeqGrabbed(seq, grabOk));
+        }
+        if (o.postProcess) {
+            processGen = seq.gen;
+            processedAt = now + workerMs;
+        }
+        if (o.finish) ++finishes;
+        if (o.fail) ++fails;
+    }
+
+    // volgende gebeurtenis afhandelen; false als er niets meer komt
+    bool Step() {
+        double next = -1;
+        for (double t : { timerAt, composeAt, processedAt })
+            if (t >= 0 && (next < 0 || t < next)) next = t;
+        if (next < 0) return false;
+        now = std::max(now, next);
+        if (composeAt == next) {
+            composeAt = -1;
+            Apply(CaptureSeqComposed(seq, composeGen, dwm, now));
+        }
+        else if (processedAt == next) {
+            processedAt = -1;
+            Apply(CaptureSeqProcessed(seq, processGen, processOk));
+        }
+        else {
+            timerAt = -1;
+            Apply(CaptureSeqTimer(seq, now));
+        }
+        return true;
+    }
+
+    void Run(const CaptureSeqConfig& cfg, int maxSteps = 100) {
+        Apply(CaptureSeqStart(seq, cfg, now));
+        for (int i = 0; i < maxSteps && Step(); ++i) {}
+    }
+};
+
+static void TestNormalCapture() {
+    FakeLoop l;
+    l.now = 1000.0;
+    CaptureSeqConfig cfg;
+    cfg.postProcess = true;
+    l.Run(cfg);
+    CHECK(l.hides == 1 && l.grabs == 1 && l.finishes == 1 && l.fails == 0);
+    CHECK(!CaptureSeqBusy(l.seq));
+    CHECK(!l.seq.timedOut);
+    // grab op de eerste vsync na het verbergen, ruim voor de time-out
+    CHECK(l.seq.waitedMs > 0 && l.seq.waitedMs <= l.vsyncMs + 1e-9);
+    CHECK(l.timerAt < 0);
+}
+
+static void TestRaiseWaitsForFlushes() {
+    FakeLoop l;
+    CaptureSeqConfig cfg;
+    cfg.flushes = 3;
+    l.Run(cfg);
+    CHECK(l.grabs == 1 && l.finishes == 1);
+    CHECK(l.seq.waitedMs > 2 * l.vsyncMs && l.seq.waitedMs <= 3 * l.vsyncMs + 1e-9);
+}
+
+static void TestSilentDwmTimesOut() {
+    FakeLoop l;
+    l.dwmSilent = true;
+    CaptureSeqConfig cfg;
+    l.Run(cfg);
+    CHECK(l.grabs == 1 && l.finishes == 1);
+    CHECK(l.seq.timedOut);
+    CHECK(std::fabs(l.seq.waitedMs - cfg.timeoutMs) < 1e-9);
+}
+
+static void TestNoCompositionSettles() {
+    FakeLoop l;
+    l.dwm = false;
+    l.timerSkewMs = 4;   // timer vuurt te vroeg: de rest wordt opnieuw gezet
+    CaptureSeqConfig cfg;
+    cfg.settleMs = 20;
+    l.Run(cfg);
+    CHECK(l.grabs == 1 && l.finishes == 1);
+    CHECK(!l.seq.timedOut);
+    CHECK(l.seq.waitedMs >= cfg.settleMs - 1e-9);
+}
+
+static void TestFailures() {
+    {
+        FakeLoop l;
+        l.grabOk = false;
+        CaptureSeqConfig cfg;
+        cfg.postProcess = true;
+        l.Run(cfg);
+        CHECK(l.grabs == 1 && l.fails == 1 && l.finishes == 0);
+        CHECK(l.processedAt < 0);   // geen worker na een mislukte grab
+    }
+    {
+        FakeLoop l;
+        l.processOk = false;
+        CaptureSeqConfig cfg;
+        cfg.postProcess = true;
+        l.Run(cfg);
+        CHECK(l.fails == 1 && l.finishes == 0 && !CaptureSeqBusy(l.seq));
+    }
+    {
+        FakeLoop l;
+        CaptureSeqConfig cfg;
+        cfg.flushes = 0;
+        l.Run(cfg);
+        CHECK(l.grabs == 1 && l.finishes == 1 && l.seq.waitedMs == 0);
+    }
+}
+
+// Afbreken terwijl de worker loopt, meteen een nieuwe capture: de late meldingen van
+// de oude (compositie, worker) mogen de nieuwe niet vooruit helpen.
+static void TestCancelIgnoresLateEvents() {
+    FakeLoop l;
+    l.workerMs = 40;
+    CaptureSeqConfig cfg;
+    cfg.postProcess = true;
+    l.Apply(CaptureSeqStart(l.seq, cfg, l.now));
+    while (l.processedAt < 0 && l.Step()) {}
+    const uint32_t oldGen = l.seq.gen;
+    l.Apply(CaptureSeqCancel(l.seq));
+    CHECK(!CaptureSeqBusy(l.seq));
+
+    l.now += 1;
+    l.Apply(CaptureSeqStart(l.seq, cfg, l.now));
+    CHECK(l.seq.gen != oldGen);
+    CHECK(l.seq.state == CaptureSeqState::Composing);
+    CaptureSeqOut o = CaptureSeqProcessed(l.seq, oldGen, true);
+    CHECK(!o.finish && !o.fail);
+    o = CaptureSeqComposed(l.seq, oldGen, true, l.now);
+    CHECK(!o.grab);
+    CHECK(l.seq.state == CaptureSeqState::Composing);
+    // de echte worker-melding van de oude capture komt ook nog binnen
+    for (int i = 0; i < 100 && l.Step(); ++i) {}
+    CHECK_EQ(l.finishes, 1);
+    CHECK_EQ(l.grabs, 2);
+}
+
+// Willekeurige klokken en storingen: elke capture eindigt precies één keer (finish of
+// fail), grabt hooguit één keer en nooit na de deadline (plus de 1 ms van de nep-timer).
+static void TestRandomized() {
+    std::mt19937 rng(45);
+    for (int iter = 0; iter < 2000; ++iter) {
+        FakeLoop l;
+        l.now = (double)(rng() % 100000) / 7.0;
+        l.vsyncMs = 1000.0 / (30 + rng() % 215);
+        l.dwm = rng() % 5 != 0;
+        l.dwmSilent = rng() % 6 == 0;
+        l.timerSkewMs = (double)(rng() % 10);
+        l.workerMs = (double)(rng() % 50);
+        l.grabOk = rng() % 10 != 0;
+        l.processOk = rng() % 10 != 0;
+        CaptureSeqConfig cfg;
+        cfg.flushes = (int)(rng() % 4);
+        cfg.settleMs = (double)(rng() % 60);
+        cfg.timeoutMs = 50 + (double)(rng() % 300);
+        cfg.postProcess = rng() & 1;
+        l.Run(cfg, 1000);
+        CHECK(!CaptureSeqBusy(l.seq));
+        CHECK_EQ(l.finishes + l.fails, 1);
+        CHECK(l.grabs <= 1);
+        if (l.grabs == 1) {
+            const double limit = l.dwm ? cfg.timeoutMs : cfg.settleMs + 1.0;
+            CHECK(l.seq.waitedMs <= limit + 1e-6);
+        }
+    }
+}
+
+int main() {
+    TestNormalCapture();
+    TestRaiseWaitsForFlushes();
+    TestSilentDwmTimesOut();
+    TestNoCompositionSettles();
+    TestFailures();
+    TestCancelIgnoresLateEvents();
+    TestRandomized();
+    return TestExit("test_capture_sequencer");
+}
@@ -0,0 +1,73 @@
+// Content hash: SSE2- en scalar-variant gelijk (oneven lengtes, niet-uitgelijnde
+// start, staarten rond stripe- en blokgrenzen) en de regels van het duplicate-index.
+#include "snip_test.h"
+
+static void TestSse2MatchesScalar() {
+    std::mt19937 rng(27);
+    std::vector<uint8_t> buf(3 * 1024 + 200);
+    for (auto& b : buf) b = (uint8_t)rng();
+    // alle lengtes tot ruim drie blokken (1024 bytes), elke start 0..15 bytes verschoven
+    bool same = true;
+    for (size_t len = 0; len <= 3 * 1024 + 130 && same; ++len)
+        for (size_t off = 0; off < 16 && same; off += (len % 7) + 1) {
+            const uint64_t seed = ((uint64_t)len << 32) ^ off;
+            same = ContentHash64(buf.data() + off, len, seed) == ContentHash64(buf.data() + off, len, seed, false);
+            if (!same) std::fprintf(stderr, "len %zu offset %zu differs\n", len, off);
+        }
+    CHECK(same);
+
+    // grote buffer met een oneven staart (4K-frame + 13 bytes)
+    std::vector<uint8_t> big((size_t)3840 * 2160 * 4 + 13 + 1);
+    for (size_t i = 0; i < big.size(); ++i) big[i] = (uint8_t)(i * 2654435761u >> 13);
+    CHECK(ContentHash64(big.data() + 1, big.size() - 1, 7) == ContentHash64(big.data() + 1, big.size() - 1, 7, false));
+}
+
+static void TestSensitivity() {
+    std::vector<uint8_t> a(4096 + 37);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = (uint8_t)(i * 31);
+    const uint64_t h = ContentHash64(a.data(), a.size(), 1);
+    CHECK(h != ContentHash64(a.data(), a.size(), 2));          // seed (maat/alpha) telt mee
+    CHECK(h != ContentHash64(a.data(), a.size() - 1, 1));      // lengte telt mee
+    // elke bit van het eerste blok, de staartstripe en de losse staartbytes telt
+    int missed = 0;
+    for (size_t pos : { (size_t)0, (size_t)63, (size_t)1023, (size_t)4095, a.size() - 1 })
+        for (int bit = 0; bit < 8; ++bit) {
+            a[pos] ^= (uint8_t)(1u << bit);
+            missed += ContentHash64(a.data(), a.size(), 1) == h;
+            missed += ContentHash64(a.data(), a.size(), 1, false) == h;
+            a[pos] ^= (uint8_t)(1u << bit);
+        }
+    CHECK_EQ(missed, 0);
+}
+
+static void TestIndexLines() {
+    HashIndexEntry e{};
+    e.fmt = 3;
+    e.bytes = 123456789;
+    e.writeTime = 133512345678901234ull;
+    e.path = L"C:\\Shots\\2026 06\\region 0001.png";
+    std::wstring line = FormatHashIndexLine(0x0123456789abcdefull, e);
+    CHECK(line.size() > 2 && line.substr(line.size() - 2) == L"\r\n");
+    line.resize(line.size() - 2);
+    uint64_t hash = 0;
+    HashIndexEntry r{};
+    CHECK(ParseHashIndexLine(line, hash, r));
+    CHECK(hash == 0x0123456789abcdefull && r.fmt == 3 && r.bytes == e.bytes && r.writeTime == e.writeTime && r.path == e.path);
+
+    // oud formaat (zonder write time): writeTime 0, pad intact
+    CHECK(ParseHashIndexLine(L"00000000000000ff 0 42 C:\\a b\\c.png", hash, r));
+    CHECK(hash == 0xff && r.bytes == 42 && r.writeTime == 0 && r.path == L"C:\\a b\\c.png");
+    CHECK(ParseHashIndexLine(L"00000000000000ff 0 42 \\\\server\\share\\c.png", hash, r));
+    CHECK(r.writeTime == 0 && r.path == L"\\\\server\\share\\c.png");
+
+    // kapot of afgekapt: overslaan
+    for (const wchar_t* bad : { L"", L"xyz", L"00ff", L"00ff 1", L"00ff 1 42", L"00ff 1 42 ", L"00ff x 42 C:\\a.png" })
+        CHECK(!ParseHashIndexLine(bad, hash, r));
+}
+
+int main() {
+    TestSse2MatchesScalar();
+    TestSensitivity();
+    TestIndexLines();
+    return TestExit("test_content_hash");
+}
@@ -0,0 +1,199 @@
+// Visuele diff: DiffRow tegen een scalaire referentie, gebieden, uitlijnen, andere maten,
+// heat-map, het opruimen van bewaarde captures en DecodeImageFile (lader).
+#include "snip_test.h"
+
+// blokken plus losse ruis: genoeg structuur om uit te lijnen
+static std::vector<uint8_t> Scene(int w, int h, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            uint8_t* p = &img[((size_t)y * w + x) * 4];
+            const int v = ((x / 37) * 13 + (y / 23) * 29) % 200;
+            p[0] = (uint8_t)v; p[1] = (uint8_t)((v * 3 + x) & 255); p[2] = (uint8_t)((v + y) & 255); p[3] = 255;
+        }
+    for (int i = 0; i < w * h / 50; ++i) {
+        uint8_t* p = &img[((size_t)(rng() % h) * w + rng() % w) * 4];
+        p[0] = p[1] = p[2] = (uint8_t)rng();
+    }
+    return img;
+}
+
+static void TestRowAgainstScalar() {
+    std::mt19937 rng(47);
+    for (int iter = 0; iter < 200; ++iter) {
+        const int n = 1 + (int)(rng() % 100);   // SSE2-blokken van 16 plus een staart
+        std::vector<uint8_t> a((size_t)n * 4), b(a.size()), mag((size_t)n);
+        for (auto& v : a) v = (uint8_t)rng();
+        for (size_t i = 0; i < a.size(); ++i) b[i] = (uint8_t)(a[i] + (int)(rng() % 21) - 10);
+        const uint8_t tol = (uint8_t)(rng() % 12);
+        DiffRow(a.data(), b.data(), mag.data(), n, tol);
+        bool same = true;
+        for (int x = 0; x < n; ++x) {
+            int m = 0;
+            for (int c = 0; c < 4; ++c) m = std::max(m, std::abs(a[(size_t)x * 4 + c] - b[(size_t)x * 4 + c]));
+            same = same && mag[(size_t)x] == (m > tol ? m : 0);
+        }
+        CHECK(same);
+    }
+}
+
+static void TestIdenticalAndAreas() {
+    const int w = 400, h = 300;
+    const auto a = Scene(w, h, 1);
+    DiffResult d;
+    const DiffOffset o = DiffAlign(a.data(), w * 4, w, h, a.data(), w * 4, w, h, 32);
+    CHECK(o.dx == 0 && o.dy == 0);
+    DiffImages(a.data(), w * 4, w, h, a.data(), w * 4, w, h, o, 8, d);
+    CHECK(d.changed == 0 && d.boxes.empty());
+
+    // ruis binnen de tolerantie, één blok en twee losse pixels ver weg
+    auto b = a;
+    for (size_t i = 1; i < b.size(); i += 4) b[i] = (uint8_t)std::min(255, b[i] + 3);
+    for (int y = 50; y < 70; ++y)
+        for (int x = 30; x < 91; ++x) b[((size_t)y * w + x) * 4 + 2] ^= 0x80;
+    b[((size_t)200 * w + 300) * 4] ^= 0x40;
+    b[((size_t)200 * w + 301) * 4] ^= 0x40;
+    DiffImages(b.data(), w * 4, w, h, a.data(), w * 4, w, h, {}, 8, d);
+    CHECK_EQ(d.changed, 20 * 61 + 2);
+    CHECK_EQ(d.boxes.size(), 2);
+    if (d.boxes.size() == 2) {   // groot -> klein
+        CHECK(d.boxes[0].x0 == 30 && d.boxes[0].x1 == 91 && d.boxes[0].y0 == 50 && d.boxes[0].y1 == 70);
+        CHECK(d.boxes[1].x0 == 300 && d.boxes[1].x1 == 302 && d.boxes[1].y0 == 200 && d.boxes[1].y1 == 201);
+    }
+}
+
+// Tegels die op kDiffGapTiles van elkaar liggen worden één gebied, verder weg niet.
+static void TestBoxesFromTiles() {
+    const int tx = 8, ty = 4;
+    std::vector<DiffTileBox> tiles((size_t)tx * ty);
+    auto mark = [&](int cx, int cy, PixRect r) {
+        DiffTileBox& t = tiles[(size_t)cy * tx + cx];
+        t.r = r;
+        t.count = 1;
+    };
+    mark(0, 0, PixRect{ 2, 3, 5, 6 });
+    mark(2, 0, PixRect{ 33, 1, 40, 4 });          // één tegel ertussen: samen
+    mark(6, 3, PixRect{ 100, 50, 101, 51 });      // los
+    const auto boxes = DiffBoxesFromTiles(tiles, tx, ty);
+    CHECK_EQ(boxes.size(), 2);
+    if (boxes.size() == 2) {
+        CHECK(boxes[0].x0 == 2 && boxes[0].y0 == 1 && boxes[0].x1 == 40 && boxes[0].y1 == 6);
+        CHECK(boxes[1].x0 == 100 && boxes[1].y0 == 50 && boxes[1].x1 == 101 && boxes[1].y1 == 51);
+    }
+    CHECK(DiffBoxesFromTiles(std::vector<DiffTileBox>((size_t)tx * ty), tx, ty).empty());
+}
+
+// prev is cur verschoven: uitlijnen vindt de verschuiving, alleen de rand is gewijzigd.
+// Ook met een bottom-up view (negatieve stride), zoals een DIB.
+static void TestAlignShift() {
+    const int bw = 500, bh = 400, w = 460, h = 360;
+    const auto big = Scene(bw, bh, 4);
+    std::vector<uint8_t> cur((size_t)w * h * 4), prev(cur.size());
+    for (int y = 0; y < h; ++y) {
+        std::memcpy(&cur[(size_t)y * w * 4], &big[((size_t)(y + 10) * bw + 10) * 4], (size_t)w * 4);
+        std::memcpy(&prev[(size_t)y * w * 4], &big[((size_t)(y + 7) * bw + 15) * 4], (size_t)w * 4);
+    }
+    // cur(x, y) = prev(x - 5, y + 3)
+    DiffOffset o = DiffAlign(cur.data(), w * 4, w, h, prev.data(), w * 4, w, h, 16);
+    CHECK(o.dx == -5 && o.dy == 3);
+    DiffResult d;
+    DiffImages(cur.data(), w * 4, w, h, prev.data(), w * 4, w, h, o, 8, d);
+    CHECK_EQ(d.changed, (size_t)w * h - (size_t)(w - 5) * (h - 3));
+
+    std::vector<uint8_t> flipped(prev.size());
+    for (int y = 0; y < h; ++y) std::memcpy(&flipped[(size_t)(h - 1 - y) * w * 4], &prev[(size_t)y * w * 4], (size_t)w * 4);
+    const uint8_t* topDown = flipped.data() + (size_t)(h - 1) * w * 4;
+    o = DiffAlign(cur.data(), w * 4, w, h, topDown, -(ptrdiff_t)w * 4, w, h, 16);
+    CHECK(o.dx == -5 && o.dy == 3);
+    DiffResult d2;
+    DiffImages(cur.data(), w * 4, w, h, topDown, -(ptrdiff_t)w * 4, w, h, o, 8, d2);
+    CHECK(d2.mag == d.mag);
+
+    // buiten maxShift: niet uitgelijnd
+    o = DiffAlign(cur.data(), w * 4, w, h, prev.data(), w * 4, w, h, 2);
+    CHECK(std::abs(o.dx) <= 2 && std::abs(o.dy) <= 2);
+}
+
+// Venster gegroeid: het nieuwe deel telt als gewijzigd en kleurt rood in de heat-map.
+static void TestGrownAndHeatmap() {
+    const int w = 300, h = 200, w2 = 320;
+    const auto a = Scene(w, h, 5);
+    std::vector<uint8_t> b((size_t)w2 * h * 4);
+    for (int y = 0; y < h; ++y) {
+        std::memcpy(&b[(size_t)y * w2 * 4], &a[(size_t)y * w * 4], (size_t)w * 4);
+        for (int x = w; x < w2; ++x) b[((size_t)y * w2 + x) * 4 + 3] = 255;
+    }
+    const DiffOffset o = DiffAlign(b.data(), w2 * 4, w2, h, a.data(), w * 4, w, h, 16);
+    CHECK(o.dx == 0 && o.dy == 0);
+    DiffResult d;
+    DiffImages(b.data(), w2 * 4, w2, h, a.data(), w * 4, w, h, o, 8, d);
+    CHECK_EQ(d.changed, 20 * h);
+    CHECK_EQ(d.boxes.size(), 1);
+
+    std::vector<uint8_t> hm((size_t)w2 * h * 4);
+    DiffHeatmap(b.data(), w2 * 4, d, hm.data(), w2 * 4);
+    const uint8_t* changed = &hm[((size_t)5 * w2 + 310) * 4];
+    const uint8_t* same = &hm[((size_t)5 * w2 + 10) * 4];
+    CHECK(changed[2] > 180 && changed[2] > changed[0] + 100);   // rood
+    CHECK(same[0] == same[1] && same[1] == same[2]);            // grijs
+    CHECK(changed[3] == 255 && same[3] == 255);
+
+    // leeg beeld: geen werk, geen gebieden
+    DiffImages(b.data(), w2 * 4, 0, 0, a.data(), w * 4, w, h, {}, 8, d);
+    CHECK(d.changed == 0 && d.boxes.empty() && d.mag.empty());
+}
+
+struct KeptCapture { uint64_t bytes = 0, closedAt = 0; };
+
+static void TestKeepExcess() {
+    std::deque<KeptCapture> q;
+    CHECK_EQ(DiffKeepExcess(q, 1000, 4, 100, 60), 0);
+    for (uint64_t t = 0; t < 6; ++t) q.push_back({ 10, 1000 + t * 10 });
+    CHECK_EQ(DiffKeepExcess(q, 1050, 4, 1000, 1000), 2);      // aantal
+    CHECK_EQ(DiffKeepExcess(q, 1050, 10, 35, 1000), 3);       // bytes: 60 -> 30
+    CHECK_EQ(DiffKeepExcess(q, 1075, 10, 1000, 50), 3);       // leeftijd: 1000, 1010, 1020 te oud
+    CHECK_EQ(DiffKeepExcess(q, 5000, 10, 1000, 50), 6);
+    CHECK_EQ(DiffKeepExcess(q, 10, 10, 1000, 50), 0);         // klok achter: niets is oud
+    q.push_back({ 500, 1060 });                               // één grote: alles ervoor weg
+    CHECK_EQ(DiffKeepExcess(q, 1060, 10, 500, 1000), 6);
+    CHECK_EQ(DiffKeepExcess(q, 1060, 10, 499, 1000), 7);
+}
+
+static void TestDecodeImageFile() {
+    const int w = 37, h = 19;
+    const auto img = TestImagePhoto(w, h, 8);
+    std::vector<uint8_t> png;
+    const char* desc = "";
+    CHECK(PngEncodeLossless(img.data(), w, h, {}, png, desc));
+    const auto path = TestTempPath("diff.png");
+    CHECK(WriteFileBytes(path, png));
+
+    std::vector<uint8_t> px;
+    int dw = 0, dh = 0;
+    const char* why = "";
+    CHECK(DecodeImageFile(path, false, px, dw, dh, kDecodeMaxPixels, why));
+    CHECK(dw == w && dh == h && px == img);
+    // boven de pixelgrens van de lader: overslaan, niets vastgehouden
+    CHECK(!DecodeImageFile(path, false, px, dw, dh, (uint64_t)w * h - 1, why));
+    CHECK(std::strcmp(why, "image too large") == 0 && px.empty());
+    // verkeerd formaat, kapot en ontbrekend bestand: false, geen exceptie
+    CHECK(!DecodeImageFile(path, true, px, dw, dh, kDecodeMaxPixels, why));
+    png.resize(png.size() / 2);
+    CHECK(WriteFileBytes(path, png));
+    CHECK(!DecodeImageFile(path, false, px, dw, dh, kDecodeMaxPixels, why));
+    std::filesystem::remove(path);
+    CHECK(!DecodeImageFile(path, false, px, dw, dh, kDecodeMaxPixels, why));
+    CHECK(std::strcmp(why, "unreadable") == 0);
+}
+
+int main() {
+    TestRowAgainstScalar();
+    TestIdenticalAndAreas();
+    TestBoxesFromTiles();
+    TestAlignShift();
+    TestGrownAndHeatmap();
+    TestKeepExcess();
+    TestDecodeImageFile();
+    return TestExit("test_diff");
+}
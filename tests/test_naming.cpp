@@ -0,0 +1,44 @@
+// Bestandsnamen: presets, teller (ook voorbij 9999) en teller terugparsen.
+#include "snip_test.h"
+
+static void TestPresets() {
+    CHECK(NamePresetPrefix(1, 2026, 10, 19, L"region") == L"snip_2026-10-19_");
+    CHECK(NamePresetPrefix(2, 2026, 10, 19, L"region") == L"snip_region_2026-10-19_");
+    CHECK(NamePresetPrefix(3, 2026, 1, 2, L"region") == L"2026-01-02\\snip_");
+    CHECK(NamePresetPrefix(4, 2026, 10, 19, L"region") == L"snip_20261019_");
+    CHECK(NamePresetPrefix(99, 2026, 10, 19, L"region") == NamePresetPrefix(1, 2026, 10, 19, L"region"));
+
+    const std::wstring pre = NamePresetPrefix(1, 2026, 10, 19, L"");
+    CHECK(NameWithCounter(pre, 7, L".png") == L"snip_2026-10-19_0007.png");
+    CHECK(NameWithCounter(pre, 123456, L".jpg") == L"snip_2026-10-19_123456.jpg");
+}
+
+static void TestParse() {
+    const std::wstring pre = L"snip_2026-10-19_";
+    const wchar_t* fp = pre.c_str();
+    const size_t n = pre.size();
+    CHECK_EQ(ParseNameCounter(L"snip_2026-10-19_0042.png", fp, n), 42);
+    CHECK_EQ(ParseNameCounter(L"SNIP_2026-10-19_0042.png", fp, n), 42); // NTFS: hoofdletterongevoelig
+    CHECK_EQ(ParseNameCounter(L"snip_2026-10-19_10000.bmp", fp, n), 10000);
+    CHECK_EQ(ParseNameCounter(L"snip_2026-10-19_.png", fp, n), -1);
+    CHECK_EQ(ParseNameCounter(L"snip_2026-10-19_12a.png", fp, n), -1);
+    CHECK_EQ(ParseNameCounter(L"snip_2026-10-19_12", fp, n), -1);
+    CHECK_EQ(ParseNameCounter(L"snip_2026-10-18_0001.png", fp, n), -1);
+    CHECK_EQ(ParseNameCounter(L"snip_2026", fp, n), -1);
+    CHECK_EQ(ParseNameCounter(L"snip_2026-10-19_1234567890.png", fp, n), -1); // overflow
+    CHECK_EQ(ParseNameCounter(L"snip_2026-10-19_999999999.png", fp, n), 999999999);
+
+    // round trip + hoogste teller in een gemengde map
+    std::vector<std::wstring> names;
+    for (int i = 0; i < 20000; ++i) names.push_back(NameWithCounter(i % 2 ? pre : L"snip_2026-10-18_", i, i % 3 ? L".png" : L".jpg"));
+    int best = 0;
+    for (const auto& s : names) best = std::max(best, ParseNameCounter(s.c_str(), fp, n));
+    CHECK_EQ(best, 19999);
+    CHECK_EQ(ParseNameCounter(NameWithCounter(pre, 5, L".png").c_str(), fp, n), 5);
+}
+
+int main() {
+    TestPresets();
+    TestParse();
+    return TestExit("test_naming");
+}
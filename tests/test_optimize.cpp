@@ -0,0 +1,213 @@
+// --optimize: decoders tegen onbetrouwbare headers, iCCP bij een ander kleurtype, een
+// map met PNG + BMP die lossless kleiner moet worden (BMP alleen met convertBmp) en het
+// hernoemen zonder overschrijven.
+#include "snip_test.h"
+
+// PNG met een gegeven IHDR en een willekeurige (kleine) IDAT
+static std::vector<uint8_t> PngWithHeader(uint32_t w, uint32_t h, int depth, int ctype, const std::vector<uint8_t>& idat) {
+    std::vector<uint8_t> png(kPngSignature, kPngSignature + 8), ihdr;
+    PngPutBE32(ihdr, w);
+    PngPutBE32(ihdr, h);
+    ihdr.insert(ihdr.end(), { (uint8_t)depth, (uint8_t)ctype, 0, 0, 0 });
+    PngPutChunk(png, "IHDR", ihdr.data(), ihdr.size());
+    PngPutChunk(png, "IDAT", idat.data(), idat.size());
+    PngPutChunk(png, "IEND", nullptr, 0);
+    return png;
+}
+
+static void TestHostileHeaders() {
+    std::vector<uint8_t> row(64, 0), z;
+    DeflateZlib(row.data(), row.size(), z);
+    std::vector<uint8_t> rgba;
+    int w = 0, h = 0;
+    const char* why = "";
+    // 65535x65535 RGBA: boven de pixelgrens, zonder eerst 16 GB te reserveren
+    auto png = PngWithHeader(65535, 65535, 8, 6, z);
+    CHECK(!PngDecode(png.data(), png.size(), rgba, w, h, nullptr, why));
+    CHECK(rgba.capacity() < (1u << 20));
+    // onder de pixelgrens, maar de IDAT kan nooit zoveel opleveren
+    png = PngWithHeader(16000, 16000, 8, 6, z);
+    CHECK(!PngDecode(png.data(), png.size(), rgba, w, h, nullptr, why));
+    CHECK(rgba.capacity() < (1u << 20));
+
+    // BMP met 65535x65535 in de header en bijna geen data
+    std::vector<uint8_t> bmp(54 + 16, 0);
+    auto le = [&](size_t o, uint32_t v) { for (int i = 0; i < 4; ++i) bmp[o + i] = (uint8_t)(v >> (8 * i)); };
+    bmp[0] = 'B'; bmp[1] = 'M';
+    le(2, (uint32_t)bmp.size()); le(10, 54); le(14, 40); le(18, 65535); le(22, 65535);
+    bmp[26] = 1; bmp[28] = 32;
+    CHECK(!BmpDecode(bmp.data(), bmp.size(), rgba, w, h, why));
+
+    // inflate met een enorme bovengrens reserveert niet vooraf
+    std::vector<uint8_t> out;
+    CHECK(InflateZlib(z.data(), z.size(), out, (size_t)1 << 40));
+    CHECK_EQ(out.size(), row.size());
+    CHECK(out.capacity() < (1u << 20));
+}
+
+static PngChunk IccpChunk(const char* space) {
+    std::vector<uint8_t> prof(128, 0);
+    std::memcpy(&prof[12], "mntr", 4);
+    std::memcpy(&prof[16], space, 4);
+    std::memcpy(&prof[20], "XYZ ", 4);
+    std::vector<uint8_t> z;
+    DeflateZlib(prof.data(), prof.size(), z);
+    PngChunk c;
+    std::memcpy(c.type, "iCCP", 4);
+    c.data = { 'p', 'r', 'o', 'f', 0, 0 };
+    c.data.insert(c.data.end(), z.begin(), z.end());
+    return c;
+}
+
+static bool HasChunk(const std::vector<uint8_t>& png, const char* type) {
+    for (size_t p = 8; p + 12 <= png.size(); p += 12 + PngBE32(&png[p]))
+        if (std::memcmp(&png[p + 4], type, 4) == 0) return true;
+    return false;
+}
+
+static void TestIccpFollowsColorType() {
+    const int w = 40, h = 30;
+    std::vector<uint8_t> gray((size_t)w * h * 4), color = TestImagePhoto(w, h, 5);
+    for (size_t i = 0; i < gray.size(); i += 4) {
+        gray[i] = gray[i + 1] = gray[i + 2] = (uint8_t)(i * 7 / 4);
+        gray[i + 3] = 255;
+    }
+    PngChunk phys;
+    std::memcpy(phys.type, "pHYs", 4);
+    phys.data = { 0, 0, 0x0e, 0xc4, 0, 0, 0x0e, 0xc4, 1 };
+    std::vector<uint8_t> png;
+    const char* desc = "";
+
+    // RGB-profiel bij een beeld dat grijs wordt: iCCP weg, pHYs blijft
+    CHECK(PngEncodeLossless(gray.data(), w, h, { IccpChunk("RGB "), phys }, png, desc));
+    CHECK(png[25] == 0);
+    CHECK(!HasChunk(png, "iCCP"));
+    CHECK(HasChunk(png, "pHYs"));
+    // GRAY-profiel bij grijs en RGB-profiel bij kleur blijven
+    CHECK(PngEncodeLossless(gray.data(), w, h, { IccpChunk("GRAY") }, png, desc));
+    CHECK(HasChunk(png, "iCCP"));
+    CHECK(PngEncodeLossless(color.data(), w, h, { IccpChunk("RGB ") }, png, desc));
+    CHECK(HasChunk(png, "iCCP"));
+    CHECK(PngEncodeLossless(color.data(), w, h, { IccpChunk("GRAY") }, png, desc));
+    CHECK(!HasChunk(png, "iCCP"));
+}
+
+static void TestOptimizeFolder() {
+    namespace fs = std::filesystem;
+    const fs::path dir = TestTempPath("optimize");
+    fs::create_directories(dir);
+
+    // RGBA-PNG zonder filters: het palet-formaat is veel kleiner
+    const int w = 120, h = 80;
+    const auto img = TestImageBlocks(w, h);
+    std::vector<uint8_t> raw, z;
+    for (int y = 0; y < h; ++y) {
+        raw.push_back(0);
+        raw.insert(raw.end(), img.begin() + (ptrdiff_t)y * w * 4, img.begin() + (ptrdiff_t)(y + 1) * w * 4);
+    }
+    DeflateZlib(raw.data(), raw.size(), z);
+    const auto png = PngWithHeader(w, h, 8, 6, z);
+    CHECK(WriteFileBytes(dir / "a.png", png));
+
+    // 32-bit BMP bottom-up
+    std::vector<uint8_t> bmp(54 + (size_t)w * h * 4, 0);
+    auto le = [&](size_t o, uint32_t v) { for (int i = 0; i < 4; ++i) bmp[o + i] = (uint8_t)(v >> (8 * i)); };
+    bmp[0] = 'B'; bmp[1] = 'M';
+    le(2, (uint32_t)bmp.size()); le(10, 54); le(14, 40); le(18, w); le(22, h);
+    bmp[26] = 1; bmp[28] = 32;
+    for (int y = 0; y < h; ++y) std::memcpy(&bmp[54 + (size_t)(h - 1 - y) * w * 4], &img[(size_t)y * w * 4], (size_t)w * 4);
+    CHECK(WriteFileBytes(dir / "b.bmp", bmp));
+
+    // kapotte header: moet blijven staan, niet de hele run stoppen
+    const auto bad = PngWithHeader(65535, 65535, 8, 6, z);
+    CHECK(WriteFileBytes(dir / "c.png", bad));
+
+    // zonder convertBmp: de BMP staat niet eens in het rapport en blijft zoals hij was
+    OptimizeReport rep;
+    CHECK(OptimizeFolder(dir, 2, rep));
+    CHECK_EQ(rep.items.size(), 2);
+    for (const OptimizeItem& it : rep.items) CHECK(it.path.extension() == ".png");
+    std::vector<uint8_t> still;
+    CHECK(ReadFileBytes(dir / "b.bmp", still) && still == bmp);
+    CHECK(!fs::exists(dir / "b.png"));
+    CHECK(WriteFileBytes(dir / "a.png", png));
+
+    CHECK(OptimizeFolder(dir, 2, rep, true));
+    CHECK_EQ(rep.items.size(), 3);
+    for (const OptimizeItem& it : rep.items) {
+        const auto name = it.path.filename().string();
+        if (name == "c.png") {
+            CHECK(it.status == OptimizeStatus::Skipped);
+            CHECK_EQ(it.after, it.before);
+            CHECK(ReadFileBytes(it.path, still) && still == bad);
+            continue;
+        }
+        CHECK(it.status == OptimizeStatus::Smaller);
+        CHECK(it.after < it.before);
+        std::vector<uint8_t> file, rgba;
+        CHECK(ReadFileBytes(it.outPath, file));
+        CHECK_EQ(file.size(), it.after);
+        int dw = 0, dh = 0;
+        const char* why = "";
+        CHECK(PngDecode(file.data(), file.size(), rgba, dw, dh, nullptr, why) && dw == w && dh == h);
+        if (name == "b.bmp") {
+            CHECK(it.outPath.filename() == "b.png");
+            CHECK(!fs::exists(it.path));
+        }
+    }
+
+    // .png-naam bezet: de BMP blijft staan, de bestaande .png wordt niet aangeraakt
+    CHECK(WriteFileBytes(dir / "b.bmp", bmp));
+    const std::vector<uint8_t> other = { 'n', 'o', 't', ' ', 'm', 'i', 'n', 'e' };
+    CHECK(WriteFileBytes(dir / "b.png", other));
+    CHECK(OptimizeFolder(dir, 2, rep, true));
+    for (const OptimizeItem& it : rep.items) {
+        if (it.path.filename() != "b.bmp") continue;
+        CHECK(it.status == OptimizeStatus::Skipped && it.note == ".png name taken" && it.after == it.before);
+    }
+    CHECK(ReadFileBytes(dir / "b.png", still) && still == other);
+    CHECK(ReadFileBytes(dir / "b.bmp", still) && still == bmp);
+
+    // geen tijdelijke bestanden achtergebleven
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(dir, ec)) CHECK(e.path().extension() != ".tmp");
+    fs::remove_all(dir, ec);
+}
+
+// Hernoemen zonder overschrijven en exclusief schrijven: een bestaand doel blijft heel,
+// de bron blijft dan ook staan.
+static void TestNoReplace() {
+    namespace fs = std::filesystem;
+    const fs::path dir = TestTempPath("noreplace");
+    fs::create_directories(dir);
+    const std::vector<uint8_t> a = { 1, 2, 3 }, b = { 4, 5 };
+    CHECK(WriteFileBytesExclusive(dir / "a", a));
+    CHECK(!WriteFileBytesExclusive(dir / "a", b));
+    CHECK(WriteFileBytes(dir / "b", b));
+
+    CHECK(MoveFileNoReplace(dir / "b", dir / "a") == MoveResult::Exists);
+    std::vector<uint8_t> got;
+    CHECK(ReadFileBytes(dir / "a", got) && got == a);
+    CHECK(ReadFileBytes(dir / "b", got) && got == b);
+    CHECK(MoveFileNoReplace(dir / "b", dir / "c") == MoveResult::Moved);
+    CHECK(!fs::exists(dir / "b"));
+    CHECK(ReadFileBytes(dir / "c", got) && got == b);
+    CHECK(MoveFileNoReplace(dir / "missing", dir / "d") == MoveResult::Failed);
+
+    // WriteTempBeside: elke aanroep een eigen naam naast het doel
+    fs::path t1, t2;
+    CHECK(WriteTempBeside(dir / "x.png", a, t1) && WriteTempBeside(dir / "x.png", b, t2));
+    CHECK(t1 != t2 && t1.parent_path() == dir && t1.extension() == ".tmp");
+    CHECK(ReadFileBytes(t1, got) && got == a);
+    CHECK(ReadFileBytes(t2, got) && got == b);
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+int main() {
+    TestHostileHeaders();
+    TestIccpFollowsColorType();
+    TestOptimizeFolder();
+    TestNoReplace();
+    return TestExit("test_optimize");
+}
@@ -0,0 +1,194 @@
+// Command-kanaal: frame-codec en PipeServeFrames tegen willekeurige bytes (fuzz),
+// PipeParseCommand, en de Unix-socket-server met echte clients.
+#include "snip_test.h"
+
+static PipeResponse EchoHandler(const PipeRequest& r) {
+    return PipeResponse{ PipeStatus::Ok, r.id, std::to_wstring((int)r.op) + L":" + std::to_wstring(r.x) };
+}
+
+static PipeRequest RandomRequest(std::mt19937& rng) {
+    PipeRequest r;
+    r.op = (PipeOp)(rng() % 5);
+    r.id = rng();
+    r.x = (int32_t)rng(); r.y = (int32_t)rng(); r.w = (int32_t)rng(); r.h = (int32_t)rng();
+    r.monitor = (int32_t)rng();
+    r.flags = (uint8_t)(rng() & 1);
+    r.format = (uint8_t)(rng() % 4);
+    return r;
+}
+
+static void TestCodecRoundTrip() {
+    std::mt19937 rng(42);
+    for (int i = 0; i < 2000; ++i) {
+        const PipeRequest r = RandomRequest(rng);
+        std::vector<uint8_t> frame;
+        PipeEncodeRequest(r, frame);
+        PipeRequest back;
+        size_t used = 0;
+        CHECK(PipeDecodeRequest(frame.data(), frame.size(), back, used) == PipeDecode::Ok);
+        CHECK_EQ(used, frame.size());
+        CHECK(back.op == r.op && back.id == r.id);
+        // elke kortere prefix is 'meer nodig', nooit een fout
+        const size_t cut = rng() % frame.size();
+        CHECK(PipeDecodeRequest(frame.data(), cut, back, used) == PipeDecode::NeedMore);
+
+        PipeResponse resp{ (PipeStatus)(rng() % 4), r.id, std::wstring(rng() % 300, (wchar_t)(L'a' + rng() % 26)) };
+        frame.clear();
+        PipeEncodeResponse(resp, frame);
+        PipeResponse rb;
+        CHECK(PipeDecodeResponse(frame.data(), frame.size(), rb, used) == PipeDecode::Ok);
+        CHECK(rb.status == resp.status && rb.id == resp.id && rb.text == resp.text);
+    }
+}
+
+// Geldige frames in willekeurige stukken: dezelfde antwoorden als in één keer.
+static void TestSplitStream() {
+    std::mt19937 rng(7);
+    std::vector<uint8_t> stream, whole, pieces;
+    for (int i = 0; i < 200; ++i) PipeEncodeRequest(RandomRequest(rng), stream);
+    std::vector<uint8_t> in = stream;
+    CHECK(PipeServeFrames(in, whole, EchoHandler));
+    CHECK(in.empty());
+    in.clear();
+    for (size_t pos = 0; pos < stream.size(); ) {
+        const size_t n = std::min(stream.size() - pos, (size_t)(1 + rng() % 40));
+        in.insert(in.end(), stream.begin() + (ptrdiff_t)pos, stream.begin() + (ptrdiff_t)(pos + n));
+        pos += n;
+        CHECK(PipeServeFrames(in, pieces, EchoHandler));
+    }
+    CHECK(in.empty());
+    CHECK(pieces == whole);
+}
+
+// Willekeurige en verminkte bytes: nooit crashen, de invoer moet altijd krimpen of
+// compleet blijven, en een afgewezen stroom is echt onbruikbaar (frame-lengte).
+static void TestFuzzServeFrames() {
+    std::mt19937 rng(1234);
+    size_t rejected = 0, answered = 0;
+    for (int iter = 0; iter < 20000; ++iter) {
+        std::vector<uint8_t> in;
+        const int kind = iter % 3;
+        if (kind == 0) {
+            in.resize(rng() % 80);
+            for (auto& b : in) b = (uint8_t)rng();
+        }
+        else {
+            for (int k = 0; k < 1 + (int)(rng() % 4); ++k) PipeEncodeRequest(RandomRequest(rng), in);
+            const int flips = 1 + (int)(rng() % 4);
+            for (int f = 0; f < flips && !in.empty(); ++f) in[rng() % in.size()] ^= (uint8_t)(1u << (rng() % 8));
+            if (kind == 2 && !in.empty()) in.resize(rng() % in.size());
+        }
+        const size_t before = in.size();
+        std::vector<uint8_t> out;
+        const bool keep = PipeServeFrames(in, out, EchoHandler);
+        CHECK(in.size() <= before);
+        if (!keep) ++rejected;
+        // elk antwoord is zelf een geldig frame
+        size_t pos = 0;
+        while (pos < out.size()) {
+            PipeResponse r;
+            size_t used = 0;
+            const PipeDecode d = PipeDecodeResponse(out.data() + pos, out.size() - pos, r, used);
+            CHECK(d == PipeDecode::Ok);
+            if (d != PipeDecode::Ok) break;
+            pos += used;
+            ++answered;
+        }
+    }
+    CHECK(rejected > 0);
+    CHECK(answered > 0);
+}
+
+static void TestParseCommand() {
+    PipeRequest r;
+    std::wstring err;
+    CHECK(PipeParseCommand({ L"capture-region", L"10", L"-20", L"800", L"600", L"--save" }, r, err));
+    CHECK(r.op == PipeOp::CaptureRegion && r.x == 10 && r.y == -20 && r.w == 800 && r.h == 600 && r.flags == kPipeFlagSave);
+    CHECK(PipeParseCommand({ L"capture-monitor" }, r, err) && r.monitor == -1);
+    CHECK(PipeParseCommand({ L"set-format", L"JPEG" }, r, err) && r.format == (uint8_t)SaveFormat::Jpeg);
+    CHECK(!PipeParseCommand({}, r, err));
+    CHECK(!PipeParseCommand({ L"capture-region", L"1", L"2", L"0", L"4" }, r, err));
+    CHECK(!PipeParseCommand({ L"capture-region", L"1", L"2", L"3x", L"4" }, r, err));
+    CHECK(!PipeParseCommand({ L"ping", L"--save" }, r, err));
+    CHECK(!PipeParseCommand({ L"set-format", L"gif" }, r, err));
+
+    // willekeurige argumenten: geen crash, en 'ok' betekent een coderbaar request
+    std::mt19937 rng(99);
+    static const wchar_t* const words[] = { L"ping", L"get-last-path", L"capture-region", L"capture-monitor",
+        L"set-format", L"--save", L"png", L"0", L"-1", L"99999999999", L"", L"x", L"12", L"auto" };
+    for (int i = 0; i < 5000; ++i) {
+        std::vector<std::wstring> args;
+        for (int k = 0; k < (int)(rng() % 7); ++k) args.push_back(words[rng() % (sizeof(words) / sizeof(words[0]))]);
+        if (PipeParseCommand(args, r, err)) {
+            std::vector<uint8_t> frame;
+            PipeEncodeRequest(r, frame);
+            PipeRequest back;
+            size_t used = 0;
+            CHECK(PipeDecodeRequest(frame.data(), frame.size(), back, used) == PipeDecode::Ok);
+        }
+    }
+}
+
+#if !defined(_WIN32)
+static void TestUnixSocket() {
+    const std::string path = TestTempPath("cmd.sock").string();
+    UnixCommandServer srv;
+    std::atomic<int> handled{ 0 };
+    CHECK(UnixCommandServerStart(srv, path, [&](const PipeRequest& r) { ++handled; return EchoHandler(r); }));
+    // een tweede server op hetzelfde pad weigert (er luistert er al een)
+    UnixCommandServer second;
+    CHECK(!UnixCommandServerStart(second, path, EchoHandler));
+
+    // meerdere clients na elkaar en tegelijk (de server neemt ze één voor één)
+    std::vector<std::thread> clients;
+    std::atomic<int> ok{ 0 };
+    for (int c = 0; c < 4; ++c) {
+        clients.emplace_back([&, c] {
+            const int fd = UnixCommandConnect(path);
+            if (fd < 0) return;
+            for (int i = 0; i < 250; ++i) {
+                PipeRequest req;
+                req.op = PipeOp::CaptureRegion;
+                req.id = (uint32_t)(c * 1000 + i + 1);
+                req.x = i;
+                PipeResponse resp;
+                if (UnixCommandTransact(fd, req, resp) && resp.text == L"1:" + std::to_wstring(i)) ++ok;
+            }
+            close(fd);
+            });
+    }
+    for (auto& t : clients) t.join();
+    CHECK_EQ(ok.load(), 1000);
+    CHECK_EQ(handled.load(), 1000);
+
+    // een onbruikbaar frame sluit alleen die verbinding
+    int fd = UnixCommandConnect(path);
+    CHECK(fd >= 0);
+    const uint8_t junk[4] = { 0xFF, 0xFF, 0xFF, 0x7F };
+    CHECK(UnixWriteAll(fd, junk, sizeof(junk)));
+    uint8_t b = 0;
+    CHECK(recv(fd, &b, 1, 0) == 0);
+    close(fd);
+    fd = UnixCommandConnect(path);
+    PipeResponse resp;
+    CHECK(fd >= 0 && UnixCommandTransact(fd, PipeRequest{}, resp) && resp.status == PipeStatus::Ok);
+
+    // stop met een open verbinding: de server wacht niet op de client
+    UnixCommandServerStop(srv);
+    CHECK(!UnixCommandTransact(fd, PipeRequest{}, resp));
+    close(fd);
+    CHECK(!std::filesystem::exists(path));
+    CHECK_EQ(UnixCommandConnect(path), -1);
+}
+#endif
+
+int main() {
+    TestCodecRoundTrip();
+    TestSplitStream();
+    TestFuzzServeFrames();
+    TestParseCommand();
+#if !defined(_WIN32)
+    TestUnixSocket();
+#endif
+    return TestExit("test_pipe");
+}
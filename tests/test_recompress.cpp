@@ -0,0 +1,113 @@
+// Recompressie: PNG-encoder (vormen, exacte round trip, exhaustive), deflate tegen
+// inflate, afbreken, en het journal + de planning van de wachtrij.
+#include "snip_test.h"
+
+static int IhdrColorType(const std::vector<uint8_t>& png) { return png.size() > 25 ? png[25] : -1; }
+static int IhdrDepth(const std::vector<uint8_t>& png) { return png.size() > 24 ? png[24] : -1; }
+
+static void CheckRoundTrip(const std::vector<uint8_t>& rgba, int w, int h, int ctype, int depth, bool exhaustive) {
+    std::vector<uint8_t> png, back;
+    const char* desc = "";
+    CHECK(PngEncodeLossless(rgba.data(), w, h, {}, png, desc, exhaustive));
+    CHECK_EQ(IhdrColorType(png), ctype);
+    CHECK_EQ(IhdrDepth(png), depth);
+    int dw = 0, dh = 0;
+    const char* why = "";
+    CHECK(PngDecode(png.data(), png.size(), back, dw, dh, nullptr, why));
+    CHECK(dw == w && dh == h && back == rgba);
+}
+
+// RGBA-beeld met precies 'colors' kleuren (alpha 255 tenzij translucent)
+static std::vector<uint8_t> PaletteImage(int w, int h, int colors, bool translucent) {
+    std::vector<uint8_t> img((size_t)w * h * 4);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) {
+            const int k = (x * 7 + y * 3) % colors;
+            uint8_t* p = &img[((size_t)y * w + x) * 4];
+            p[0] = (uint8_t)(k * 37); p[1] = (uint8_t)(k * 11 + 5); p[2] = (uint8_t)(255 - k);
+            p[3] = translucent && k == 0 ? 0 : 255;
+        }
+    return img;
+}
+
+static void TestEncoderForms() {
+    // oneven breedte: de laatste byte van elke rij is maar half gevuld
+    const int w = 37, h = 23;
+    for (bool exhaustive : { false, true }) {
+        CheckRoundTrip(PaletteImage(w, h, 2, false), w, h, 3, 1, exhaustive);
+        CheckRoundTrip(PaletteImage(w, h, 4, true), w, h, 3, 2, exhaustive);
+        CheckRoundTrip(PaletteImage(w, h, 16, false), w, h, 3, 4, exhaustive);
+
+        auto gray = TestImagePhoto(w, h, 9);
+        for (size_t i = 0; i < gray.size(); i += 4) gray[i + 1] = gray[i + 2] = gray[i];
+        CheckRoundTrip(gray, w, h, 0, 8, exhaustive);
+        for (size_t i = 3; i < gray.size(); i += 8) gray[i] = 128;
+        CheckRoundTrip(gray, w, h, 4, 8, exhaustive);
+
+        auto rgb = TestImagePhoto(w, h, 10);
+        CheckRoundTrip(rgb, w, h, 2, 8, exhaustive);
+        auto rgba = TestImageNoise(w, h, 11);
+        CheckRoundTrip(rgba, w, h, 6, 8, exhaustive);
+    }
+    // 1x1 en een enkele rij
+    CheckRoundTrip(PaletteImage(1, 1, 1, false), 1, 1, 3, 1, false);
+    CheckRoundTrip(TestImageNoise(300, 1, 2), 300, 1, 6, 8, false);
+}
+
+static void TestExhaustiveNotWorse() {
+    const int w = 400, h = 200;
+    const auto img = TestImagePhoto(w, h, 12);
+    std::vector<uint8_t> normal, best;
+    const char* desc = "";
+    CHECK(PngEncodeLossless(img.data(), w, h, {}, normal, desc));
+    CHECK(PngEncodeLossless(img.data(), w, h, {}, best, desc, true));
+    CHECK(best.size() <= normal.size());
+
+    std::atomic<bool> cancel{ true };
+    CHECK(!PngEncodeLossless(img.data(), w, h, {}, best, desc, true, &cancel));
+}
+
+static void TestDeflateRoundTrip() {
+    std::mt19937 rng(3);
+    for (int t = 0; t < 9; ++t) {
+        const size_t n = t < 3 ? rng() % 50 : 20000 + rng() % 200000;
+        std::vector<uint8_t> d(n), z, back;
+        for (size_t i = 0; i < n; ++i)
+            d[i] = t % 3 == 0 ? (uint8_t)(rng() % 7) : t % 3 == 1 ? (uint8_t)(i / 37 % 5) : (uint8_t)((i % 3000 < 700) ? rng() % 4 : (i * 7) >> 3);
+        DeflateZlib(d.data(), n, z);
+        CHECK(InflateZlib(z.data(), z.size(), back, n) && back == d);
+        CHECK(DeflateZlibExhaustive(d.data(), n, z));
+        CHECK(InflateZlib(z.data(), z.size(), back, n) && back == d);
+    }
+}
+
+static void TestJournalAndPlan() {
+    const RecompressJob a{ L"C:\\x\\a.png", 100, 5, 0 }, b{ L"C:\\x\\b c.png", 200, 6, 0 }, c{ L"C:\\c.png", 1, 2, 0 };
+    std::wstring j;
+    j += FormatRecompressLine(L'A', a);
+    j += FormatRecompressLine(L'A', b);
+    j += FormatRecompressLine(L'F', a);
+    j += L"garbage\r\n";
+    j += FormatRecompressLine(L'A', c);
+    j += FormatRecompressLine(L'D', c);
+    for (int i = 0; i < kRecompressMaxAttempts; ++i) j += FormatRecompressLine(L'F', b);
+    j += L"A 12 3";   // afgebroken laatste regel
+    size_t lines = 0;
+    auto jobs = ReplayRecompressJournal(j.data(), j.size(), &lines);
+    CHECK(jobs.size() == 1 && jobs[0].path == a.path && jobs[0].attempts == 1 && jobs[0].bytes == 100);
+
+    CHECK(!PlanRecompress({}, 999999, 1000, false).run);
+    CHECK(PlanRecompress({}, 0, 1000, false).waitMs == kRecompressWaitForever);
+    CHECK(!PlanRecompress(jobs, 999999, 1000, true).run);
+    const RecompressPlan wait = PlanRecompress(jobs, 400, 1000, false);
+    CHECK(!wait.run && wait.waitMs == 850);
+    CHECK(PlanRecompress(jobs, 1000, 1000, false).run);
+}
+
+int main() {
+    TestEncoderForms();
+    TestExhaustiveNotWorse();
+    TestDeflateRoundTrip();
+    TestJournalAndPlan();
+    return TestExit("test_recompress");
+}
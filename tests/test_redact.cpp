@@ -0,0 +1,176 @@
+// Redactie: pixelate (elk blok één kleur, het afgeronde gemiddelde; randblokken en
+// rechthoeken buiten het beeld geklemd) en blur (alleen binnen de rechthoek, leest niets
+// daarbuiten, tekst is daarna niet meer te lezen). Buiten de rechthoek verandert niets.
+#include "snip_test.h"
+
+// beeld met padding achter elke rij (stride > w*4), zoals een DIB met uitgelijnde rijen
+struct Padded {
+    int w = 0, h = 0;
+    ptrdiff_t stride = 0;
+    std::vector<uint8_t> px;
+    uint8_t* At(int x, int y) { return px.data() + (ptrdiff_t)y * stride + (size_t)x * 4; }
+};
+
+static Padded MakePadded(const std::vector<uint8_t>& img, int w, int h, int pad) {
+    Padded p;
+    p.w = w;
+    p.h = h;
+    p.stride = (ptrdiff_t)w * 4 + pad;
+    p.px.assign((size_t)p.stride * h, 0xA5);
+    for (int y = 0; y < h; ++y) std::memcpy(p.At(0, y), &img[(size_t)y * w * 4], (size_t)w * 4);
+    return p;
+}
+
+// alle bytes buiten r (inclusief de padding) gelijk aan het origineel
+static bool OutsideUnchanged(const Padded& a, const Padded& b, const PixRect& rIn) {
+    const PixRect r = PixRectIntersect(rIn, PixRect{ 0, 0, a.w, a.h });
+    for (int y = 0; y < a.h; ++y)
+        for (ptrdiff_t i = 0; i < a.stride; ++i) {
+            const int x = (int)(i / 4);
+            const bool inside = !r.Empty() && y >= r.y0 && y < r.y1 && x >= r.x0 && x < r.x1;
+            if (!inside && a.px[(size_t)(y * a.stride + i)] != b.px[(size_t)(y * b.stride + i)]) return false;
+        }
+    return true;
+}
+
+// Elk blok (uitgelijnd op de linkerbovenhoek van de geklemde rechthoek) is één kleur:
+// het per kanaal afgeronde gemiddelde van de bronpixels in dat blok.
+static bool BlocksAreAverages(Padded& src, Padded& out, const PixRect& rIn, int block) {
+    const PixRect r = PixRectIntersect(rIn, PixRect{ 0, 0, src.w, src.h });
+    for (int by = r.y0; by < r.y1; by += block)
+        for (int bx = r.x0; bx < r.x1; bx += block) {
+            const int x1 = std::min(r.x1, bx + block), y1 = std::min(r.y1, by + block);
+            uint32_t sum[4] = {};
+            for (int y = by; y < y1; ++y)
+                for (int x = bx; x < x1; ++x)
+                    for (int c = 0; c < 4; ++c) sum[c] += src.At(x, y)[c];
+            const uint32_t n = (uint32_t)((x1 - bx) * (y1 - by));
+            uint8_t avg[4];
+            for (int c = 0; c < 4; ++c) avg[c] = (uint8_t)((sum[c] + n / 2) / n);
+            for (int y = by; y < y1; ++y)
+                for (int x = bx; x < x1; ++x)
+                    if (std::memcmp(out.At(x, y), avg, 4) != 0) return false;
+        }
+    return true;
+}
+
+static void TestPixelate() {
+    const int w = 700, h = 500;
+    const auto img = TestImageNoise(w, h, 34);
+    const PixRect rects[] = {
+        { 13, 7, 13 + 101, 7 + 67 },          // randblokken rechts en onder
+        { 0, 0, w, h },                        // hele beeld, meerdere banden
+        { 650, 480, 703, 529 },               // steekt rechtsonder uit
+        { -40, -9, 30, 20 },                  // steekt linksboven uit
+        { 5, 5, 6, 6 },                        // één pixel
+    };
+    for (const PixRect& r : rects)
+        for (int block : { 2, 3, 16, 31, 64 }) {
+            Padded src = MakePadded(img, w, h, 12), out = src;
+            PixelateRect(out.px.data(), out.stride, w, h, r, block);
+            CHECK(BlocksAreAverages(src, out, r, block));
+            CHECK(OutsideUnchanged(src, out, r));
+        }
+
+    // uitstekende rechthoek = de geklemde rechthoek (blokken vanaf de geklemde hoek)
+    Padded a = MakePadded(img, w, h, 0), b = a;
+    PixelateRect(a.px.data(), a.stride, w, h, PixRect{ -20, -5, w + 30, 40 }, 16);
+    PixelateRect(b.px.data(), b.stride, w, h, PixRect{ 0, 0, w, 40 }, 16);
+    CHECK(a.px == b.px);
+
+    // blok > 256 wordt 256; blok < 2, lege of volledig externe rechthoek: niets
+    a = MakePadded(img, w, h, 0);
+    Padded big = a;
+    PixelateRect(big.px.data(), big.stride, w, h, PixRect{ 0, 0, w, h }, 1000);
+    CHECK(BlocksAreAverages(a, big, PixRect{ 0, 0, w, h }, 256));
+    for (const auto& [r, block] : { std::pair{ PixRect{ 0, 0, w, h }, 1 }, std::pair{ PixRect{ 10, 10, 10, 50 }, 8 },
+                                     std::pair{ PixRect{ w, 0, w + 50, h }, 8 }, std::pair{ PixRect{ -50, -50, -1, -1 }, 8 } }) {
+        b = a;
+        PixelateRect(b.px.data(), b.stride, w, h, r, block);
+        CHECK(a.px == b.px);
+    }
+
+    // bottom-up view (negatieve stride): zelfde resultaat als top-down
+    a = MakePadded(img, w, h, 0);
+    b = a;
+    std::vector<uint8_t> flipped(a.px.size());
+    for (int y = 0; y < h; ++y) std::memcpy(&flipped[(size_t)(h - 1 - y) * w * 4], a.At(0, y), (size_t)w * 4);
+    const PixRect r{ 33, 21, 410, 377 };
+    PixelateRect(b.px.data(), b.stride, w, h, r, 12);
+    PixelateRect(flipped.data() + (size_t)(h - 1) * w * 4, -(ptrdiff_t)w * 4, w, h, r, 12);
+    bool same = true;
+    for (int y = 0; y < h; ++y) same = same && std::memcmp(&flipped[(size_t)(h - 1 - y) * w * 4], b.At(0, y), (size_t)w * 4) == 0;
+    CHECK(same);
+}
+
+static void TestBlurBounds() {
+    const int w = 640, h = 420;
+    const auto img = TestImagePhoto(w, h, 34);
+    const PixRect rects[] = { { 50, 40, 350, 300 }, { 600, 400, 700, 500 }, { -30, -30, 20, 20 }, { 0, 0, w, h } };
+    for (const PixRect& r : rects)
+        for (float sigma : { 0.5f, 3.0f, 12.0f, 80.0f }) {
+            Padded src = MakePadded(img, w, h, 20), out = src;
+            BlurRect(out.px.data(), out.stride, w, h, r, sigma);
+            CHECK(OutsideUnchanged(src, out, r));
+        }
+
+    // leest niets buiten de rechthoek: andere pixels eromheen, zelfde resultaat binnenin
+    const PixRect r{ 100, 80, 300, 260 };
+    Padded a = MakePadded(img, w, h, 0), b = MakePadded(TestImageNoise(w, h, 9), w, h, 0);
+    for (int y = r.y0; y < r.y1; ++y) std::memcpy(b.At(r.x0, y), a.At(r.x0, y), (size_t)r.Width() * 4);
+    BlurRect(a.px.data(), a.stride, w, h, r, 6.0f);
+    BlurRect(b.px.data(), b.stride, w, h, r, 6.0f);
+    bool same = true;
+    for (int y = r.y0; y < r.y1; ++y) same = same && std::memcmp(a.At(r.x0, y), b.At(r.x0, y), (size_t)r.Width() * 4) == 0;
+    CHECK(same);
+
+    // vlak blijft vlak; sigma <= 0 of lege rechthoek: niets
+    std::vector<uint8_t> flat((size_t)w * h * 4);
+    for (size_t i = 0; i < flat.size(); i += 4) { flat[i] = 40; flat[i + 1] = 120; flat[i + 2] = 200; flat[i + 3] = 255; }
+    Padded f = MakePadded(flat, w, h, 0), g = f;
+    BlurRect(g.px.data(), g.stride, w, h, PixRect{ 0, 0, w, h }, 9.0f);
+    CHECK(f.px == g.px);
+    a = MakePadded(img, w, h, 0);
+    b = a;
+    BlurRect(b.px.data(), b.stride, w, h, PixRect{ 0, 0, w, h }, 0.0f);
+    BlurRect(b.px.data(), b.stride, w, h, PixRect{ 10, 10, 10, 90 }, 5.0f);
+    CHECK(a.px == b.px);
+}
+
+static double Luma(const uint8_t* p) { return 0.114 * p[0] + 0.587 * p[1] + 0.299 * p[2]; }
+
+// Geblurde tekst lijkt niet meer op de bron: de randen (horizontale gradiënt) zijn grotendeels
+// weg en geen pixel komt nog in de buurt van de inktkleur.
+static void TestBlurHidesText() {
+    const int w = 800, h = 240;
+    for (bool subpixel : { false, true }) {
+        const auto img = TestImageText(w, h, 3, subpixel);
+        Padded src = MakePadded(img, w, h, 0), out = src;
+        const PixRect r{ 0, 0, w, h };
+        BlurRect(out.px.data(), out.stride, w, h, r, 8.0f);
+
+        double gradSrc = 0, gradOut = 0, minSrc = 255, minOut = 255, maxSrc = 0, diff = 0;
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x) {
+                const double ls = Luma(src.At(x, y)), lo = Luma(out.At(x, y));
+                if (x + 1 < w) {
+                    gradSrc += std::abs(Luma(src.At(x + 1, y)) - ls);
+                    gradOut += std::abs(Luma(out.At(x + 1, y)) - lo);
+                }
+                minSrc = std::min(minSrc, ls);
+                maxSrc = std::max(maxSrc, ls);
+                minOut = std::min(minOut, lo);
+                diff += std::abs(ls - lo);
+            }
+        CHECK(gradOut < 0.05 * gradSrc);
+        CHECK(minOut > minSrc + 0.5 * (maxSrc - minSrc));   // streepjes halen de inkt niet meer
+        CHECK(diff / ((double)w * h) > 5.0);
+    }
+}
+
+int main() {
+    TestPixelate();
+    TestBlurBounds();
+    TestBlurHidesText();
+    return TestExit("test_redact");
+}
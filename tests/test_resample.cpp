@@ -0,0 +1,133 @@
+// Lanczos-resampler: tegen een double-referentie zonder tussentijds afkappen, alpha
+// zonder kleurlek en doelmaten.
+#include "snip_test.h"
+
+// Separabel Lanczos-3 in double, zelfde kernel als ResampleBuildTaps; alleen het
+// eindresultaat wordt geklemd. Alleen het binnengebied wordt vergeleken (aan de randen
+// schuift het tap-venster van de resampler op, de referentie herhaalt de randpixel).
+static void ReferenceResample(const std::vector<uint8_t>& src, int sw, int sh, std::vector<double>& out, int dw, int dh) {
+    auto taps = [](int s, int d) {
+        std::vector<std::vector<std::pair<int, double>>> t((size_t)d);
+        const double scale = (double)s / d, stretch = std::max(1.0, scale), support = 3.0 * stretch;
+        for (int i = 0; i < d; ++i) {
+            const double c = (i + 0.5) * scale - 0.5;
+            double sum = 0;
+            for (int k = (int)std::floor(c - support) + 1; k <= (int)std::ceil(c + support); ++k) {
+                const double f = Lanczos3((k - c) / stretch);
+                t[(size_t)i].push_back({ std::clamp(k, 0, s - 1), f });
+                sum += f;
+            }
+            for (auto& p : t[(size_t)i]) p.second /= sum;
+        }
+        return t;
+    };
+    const auto tx = taps(sw, dw), ty = taps(sh, dh);
+    std::vector<double> mid((size_t)sh * dw * 4, 0.0);
+    for (int y = 0; y < sh; ++y)
+        for (int x = 0; x < dw; ++x)
+            for (const auto& p : tx[(size_t)x])
+                for (int c = 0; c < 4; ++c) mid[((size_t)y * dw + x) * 4 + c] += src[((size_t)y * sw + p.first) * 4 + c] * p.second;
+    out.assign((size_t)dh * dw * 4, 0.0);
+    for (int y = 0; y < dh; ++y)
+        for (const auto& p : ty[(size_t)y])
+            for (int x = 0; x < dw; ++x)
+                for (int c = 0; c < 4; ++c) out[((size_t)y * dw + x) * 4 + c] += mid[((size_t)p.first * dw + x) * 4 + c] * p.second;
+}
+
+static double MaxInteriorError(const std::vector<uint8_t>& img, int sw, int sh, int dw, int dh) {
+    std::vector<uint8_t> d((size_t)dw * dh * 4);
+    ResampleLanczos(img.data(), (ptrdiff_t)sw * 4, sw, sh, d.data(), (ptrdiff_t)dw * 4, dw, dh, false);
+    std::vector<double> ref;
+    ReferenceResample(img, sw, sh, ref, dw, dh);
+    const int bx = (int)std::ceil(3.0 * sw / dw) + 2, by = (int)std::ceil(3.0 * sh / dh) + 2;
+    double worst = 0;
+    for (int y = by; y < dh - by; ++y)
+        for (int x = bx; x < dw - bx; ++x)
+            for (int c = 0; c < 3; ++c) {
+                const size_t i = ((size_t)y * dw + x) * 4 + c;
+                worst = std::max(worst, std::fabs(d[i] - std::clamp(ref[i], 0.0, 255.0)));
+            }
+    return worst;
+}
+
+static void TestAgainstReference() {
+    struct Case { int sw, sh, dw, dh, kind; };
+    const Case cases[] = {
+        { 400, 300, 200, 150, 0 }, { 400, 300, 200, 150, 1 }, { 400, 300, 133, 101, 0 },
+        { 300, 300, 290, 290, 0 }, { 300, 300, 290, 290, 2 }, { 640, 480, 160, 120, 2 }, { 257, 99, 256, 33, 0 },
+    };
+    for (const Case& c : cases) {
+        std::vector<uint8_t> img = c.kind == 1 ? TestImagePhoto(c.sw, c.sh, 1) : TestImageNoise(c.sw, c.sh, 1);
+        if (c.kind == 2) {   // zwart-wit dambord van 3 px: maximale ringing
+            for (int y = 0; y < c.sh; ++y)
+                for (int x = 0; x < c.sw; ++x)
+                    std::memset(&img[((size_t)y * c.sw + x) * 4], ((x / 3 + y / 3) & 1) ? 255 : 0, 3);
+        }
+        for (size_t i = 3; i < img.size(); i += 4) img[i] = 255;
+        // Q14-gewichten en Q6-tussenwaarden: binnen een afrondingsstap van de referentie
+        const double err = MaxInteriorError(img, c.sw, c.sh, c.dw, c.dh);
+        if (err > 0.6) std::fprintf(stderr, "%dx%d -> %dx%d kind %d: max error %.2f\n", c.sw, c.sh, c.dw, c.dh, c.kind, err);
+        CHECK(err <= 0.6);
+    }
+}
+
+static void TestFlatAndIdentity() {
+    const int sw = 123, sh = 77;
+    std::vector<uint8_t> flat((size_t)sw * sh * 4);
+    for (size_t i = 0; i < flat.size(); i += 4) { flat[i] = 10; flat[i + 1] = 200; flat[i + 2] = 255; flat[i + 3] = 255; }
+    std::vector<uint8_t> d((size_t)50 * 31 * 4);
+    ResampleLanczos(flat.data(), sw * 4, sw, sh, d.data(), 50 * 4, 50, 31, false);
+    bool same = true;
+    for (size_t i = 0; i < d.size(); i += 4) same = same && d[i] == 10 && d[i + 1] == 200 && d[i + 2] == 255 && d[i + 3] == 255;
+    CHECK(same);
+
+    // zelfde maat: elk gewicht valt op één tap
+    const auto img = TestImageNoise(sw, sh, 4);
+    std::vector<uint8_t> id(img.size());
+    ResampleLanczos(img.data(), sw * 4, sw, sh, id.data(), sw * 4, sw, sh, false);
+    bool rgbSame = true;
+    for (size_t i = 0; i < img.size(); ++i) if (i % 4 != 3) rgbSame = rgbSame && id[i] == img[i];
+    CHECK(rgbSame);
+}
+
+// Transparante pixels (rood, alpha 0) naast opaak blauw: voorvermenigvuldigd mag er
+// geen rood in de rand komen.
+static void TestAlphaNoBleed() {
+    const int sw = 64, sh = 64, dw = 21, dh = 21;
+    std::vector<uint8_t> img((size_t)sw * sh * 4);
+    for (int y = 0; y < sh; ++y)
+        for (int x = 0; x < sw; ++x) {
+            uint8_t* p = &img[((size_t)y * sw + x) * 4];
+            if (x < sw / 2) { p[0] = 0; p[1] = 0; p[2] = 255; p[3] = 0; }
+            else { p[0] = 255; p[1] = 0; p[2] = 0; p[3] = 255; }
+        }
+    std::vector<uint8_t> d((size_t)dw * dh * 4);
+    ResampleLanczos(img.data(), sw * 4, sw, sh, d.data(), dw * 4, dw, dh, true);
+    int worstRed = 0;
+    for (size_t i = 0; i < d.size(); i += 4) if (d[i + 3] > 8) worstRed = std::max(worstRed, (int)d[i + 2]);
+    CHECK(worstRed <= 2);
+}
+
+static void TestScaleSize() {
+    int w = 0, h = 0;
+    OutputScaleSize(OutputScaleMode::Logical, 0, 2.0, 3840, 2160, w, h);
+    CHECK(w == 1920 && h == 1080);
+    OutputScaleSize(OutputScaleMode::Logical, 0, 1.0, 3840, 2160, w, h);
+    CHECK(w == 3840 && h == 2160);
+    OutputScaleSize(OutputScaleMode::Percent, 50, 1.0, 101, 51, w, h);
+    CHECK(w == 51 && h == 26);
+    OutputScaleSize(OutputScaleMode::MaxEdge, 1000, 1.0, 4000, 100, w, h);
+    CHECK(w == 1000 && h == 25);
+    OutputScaleSize(OutputScaleMode::MaxEdge, 1000, 1.0, 800, 600, w, h);
+    CHECK(w == 800 && h == 600);
+    OutputScaleSize(OutputScaleMode::Percent, 1, 1.0, 10, 10, w, h);
+    CHECK(w == 1 && h == 1);
+}
+
+int main() {
+    TestAgainstReference();
+    TestFlatAndIdentity();
+    TestAlphaNoBleed();
+    TestScaleSize();
+    return TestExit("test_resample");
+}
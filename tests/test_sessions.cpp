@@ -0,0 +1,97 @@
+// Capture-sessies: eigenaarschap (SessionList) en plaats maken zonder onbewaard werk
+// weg te gooien.
+#include "snip_test.h"
+
+static int g_alive = 0;
+
+struct FakeSession {
+    uint32_t id = 0;
+    bool unsaved = true;
+    FakeSession() { ++g_alive; }
+    ~FakeSession() { --g_alive; }
+    FakeSession(const FakeSession&) = delete;
+    FakeSession& operator=(const FakeSession&) = delete;
+};
+
+static FakeSession* Add(SessionList<FakeSession>& list, bool unsaved) {
+    auto s = std::make_unique<FakeSession>();
+    s->unsaved = unsaved;
+    return SessionAdd(list, std::move(s));
+}
+
+static void TestOwnership() {
+    {
+        SessionList<FakeSession> list;
+        FakeSession* a = Add(list, true);
+        FakeSession* b = Add(list, true);
+        CHECK(a && b && a->id == 1 && b->id == 2);
+        CHECK_EQ(g_alive, 2);
+        CHECK(SessionFind(list, 2) == b);
+        CHECK(SessionAdd(list, std::unique_ptr<FakeSession>()) == nullptr);
+
+        // Take: aanroeper wordt eigenaar, loslaten ruimt op
+        {
+            std::unique_ptr<FakeSession> taken = SessionTake(list, 1);
+            CHECK(taken.get() == a);
+            CHECK_EQ(list.items.size(), 1);
+            CHECK_EQ(g_alive, 2);
+        }
+        CHECK_EQ(g_alive, 1);
+
+        // ids worden niet hergebruikt: een verlopen id vindt niets
+        CHECK(SessionTake(list, 1) == nullptr);
+        CHECK(SessionFind(list, 1) == nullptr);
+        FakeSession* c = Add(list, true);
+        CHECK_EQ(c->id, 3);
+        CHECK(SessionFind(list, 2) == b);
+    }
+    CHECK_EQ(g_alive, 0); // lijst weg = alles opgeruimd
+}
+
+static void TestMakeRoom() {
+    SessionList<FakeSession> list;
+    auto keep = [](const FakeSession& s) { return s.unsaved; };
+    std::vector<uint32_t> close;
+
+    // ruimte genoeg: niets sluiten
+    for (int i = 0; i < 3; ++i) Add(list, i != 1);
+    CHECK(SessionMakeRoom(list, 4, keep, close));
+    CHECK(close.empty());
+
+    // vol: de oudste bewaarde sessie (id 2) wijkt, niet de oudste (id 1, onbewaard)
+    Add(list, true);   // id 4, nu 4 van 4
+    CHECK(SessionMakeRoom(list, 4, keep, close));
+    CHECK(close.size() == 1 && close[0] == 2);
+
+    // alles onbewaard: weigeren, niets sluiten
+    list.items[1]->unsaved = true;
+    CHECK(!SessionMakeRoom(list, 4, keep, close));
+    CHECK(close.empty());
+
+    // over de limiet (bv. limiet verlaagd): meerdere bewaarde, oudste eerst
+    for (auto& s : list.items) s->unsaved = false;
+    list.items[0]->unsaved = true;
+    CHECK(SessionMakeRoom(list, 2, keep, close));
+    CHECK(close == std::vector<uint32_t>({ 2, 3, 4 }));
+
+    // niet genoeg bewaarde voor de hele overschrijding: ook dan niets half doen
+    list.items[2]->unsaved = true;
+    CHECK(!SessionMakeRoom(list, 2, keep, close));
+    CHECK(close.empty());
+
+    CHECK(!SessionMakeRoom(list, 0, keep, close));
+
+    // sluiten zoals OpenCaptureSession doet, daarna past er een nieuwe bij
+    list.items[2]->unsaved = false;
+    CHECK(SessionMakeRoom(list, 4, keep, close));
+    const int before = g_alive;
+    for (uint32_t id : close) SessionTake(list, id);
+    CHECK_EQ(g_alive, before - (int)close.size());
+    CHECK(list.items.size() < 4);
+}
+
+int main() {
+    TestOwnership();
+    TestMakeRoom();
+    return TestExit("test_sessions");
+}
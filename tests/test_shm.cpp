@@ -0,0 +1,190 @@
+// Gedeelde laatste capture: layout en seqlock in een gewone buffer (header, te groot,
+// geknoeide header), en op POSIX shm_open met de echte maat, opnieuw aanmaken bij een
+// andere maat, en een stresstest met een schrijver en lezers in aparte processen.
+#include "snip_test.h"
+
+#if !defined(_WIN32)
+#include <sys/wait.h>
+#endif
+
+// pixel (x, y) van frame n: elk frame en elke rij anders, dus halve frames vallen op
+static uint32_t Pattern(uint64_t frame, int y, int x) {
+    return (uint32_t)(frame * 2654435761u) ^ (uint32_t)(y * 40503u) ^ (uint32_t)x;
+}
+
+static int FrameW(uint64_t n) { return 64 + (int)(n % 97) * 7; }
+static int FrameH(uint64_t n) { return 16 + (int)(n % 61) * 5; }
+
+static uint64_t PublishPattern(uint8_t* base, uint64_t n, std::vector<uint32_t>& img) {
+    const int w = FrameW(n), h = FrameH(n);
+    img.resize((size_t)w * h);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) img[(size_t)y * w + x] = Pattern(n, y, x);
+    return ShmPublish(base, (const uint8_t*)img.data(), (ptrdiff_t)w * 4, w, h, 0, (int32_t)n, -(int32_t)n, n * 10);
+}
+
+// Gelezen frame (na ShmReadBegin): pixels en metadata horen bij hetzelfde frame.
+static bool FrameMatches(const ShmFrame& f) {
+    if (f.w != FrameW(f.frame) || f.h != FrameH(f.frame) || f.left != (int32_t)f.frame || f.top != -(int32_t)f.frame || f.time != f.frame * 10)
+        return false;
+    for (int y = 0; y < f.h; ++y) {
+        const uint32_t* row = (const uint32_t*)(f.px + (size_t)y * f.stride);
+        for (int x = 0; x < f.w; ++x)
+            if (row[x] != Pattern(f.frame, y, x)) return false;
+    }
+    return true;
+}
+
+static void TestLayout() {
+    const uint64_t slot = 1ull << 20, total = ShmTotalBytes(slot);
+    std::vector<uint64_t> mem(total / 8, 0);   // 8-uitgelijnd, zoals een mapping
+    uint8_t* base = (uint8_t*)mem.data();
+    ShmFrame f;
+    CHECK(!ShmReadBegin(base, total, f));      // nog geen header
+    ShmInit(base, slot);
+    CHECK(ShmHeaderValid(base, total));
+    CHECK(!ShmHeaderValid(base, total - 1));   // slots passen niet in de mapping
+    CHECK(!ShmHeaderValid(base, kShmPixelsOffset - 1));
+    CHECK(!ShmReadBegin(base, total, f));      // nog niets gepubliceerd
+
+    std::vector<uint32_t> img;
+    for (uint64_t n = 1; n <= 5; ++n) CHECK_EQ(PublishPattern(base, n, img), n);
+    CHECK(ShmReadBegin(base, total, f) && f.frame == 5 && FrameMatches(f) && ShmReadValid(f));
+    CHECK(!ShmReadBegin(base, total - 1, f));  // kleinere mapping: niet lezen
+
+    // past niet in een slot: niet gepubliceerd, het vorige frame blijft staan
+    std::vector<uint8_t> big((size_t)1024 * 512 * 4);
+    CHECK_EQ(ShmPublish(base, big.data(), 1024 * 4, 1024, 512, 0, 0, 0, 0), 0);
+    CHECK(ShmReadBegin(base, total, f) && f.frame == 5);
+
+    // lezer houdt frame 5 vast, schrijver schrijft 6 en 7 (zelfde slot als 5): weggooien
+    CHECK(ShmReadBegin(base, total, f));
+    CHECK_EQ(PublishPattern(base, 6, img), 6);
+    CHECK(ShmReadValid(f));
+    CHECK_EQ(PublishPattern(base, 7, img), 7);
+    CHECK(!ShmReadValid(f));
+
+    // geknoeide header of slot (ander proces): nooit buiten de mapping lezen
+    ShmHeader* hd = ShmHeaderOf(base);
+    hd->slotBytes = total;
+    CHECK(!ShmReadBegin(base, total, f));
+    hd->slotBytes = slot;
+    ShmSlot* s = ShmSlotOf(base, 7);
+    const uint32_t w = s->w;
+    s->w = 0x40000000u + w;                    // w * 4 loopt over in 32 bit
+    CHECK(!ShmReadBegin(base, total, f));
+    s->w = w;
+    s->h = (uint32_t)(slot / s->stride) + 1;
+    CHECK(!ShmReadBegin(base, total, f));
+}
+
+#if !defined(_WIN32)
+static std::string TestShmName(const char* tag) {
+    return "/snip-test-" + std::string(tag) + "-" + std::to_string((long)getpid());
+}
+
+// Bestaand object van een andere maat: de schrijver maakt een nieuw aan; een lezer van
+// het oude blijft zijn eigen (geldige) mapping houden, een nieuwe lezer ziet de nieuwe maat.
+static void TestPosixRecreate() {
+    const std::string name = TestShmName("size");
+    shm_unlink(name.c_str());
+    ShmPosixMap reader;
+    CHECK(!ShmPosixOpenReader(reader, name));   // bestaat nog niet
+
+    ShmPosixMap w1, w2;
+    CHECK(ShmPosixOpenWriter(w1, name, 1ull << 20));
+    std::vector<uint32_t> img;
+    CHECK_EQ(PublishPattern(w1.base, 1, img), 1);
+    CHECK(ShmPosixOpenReader(reader, name) && reader.bytes == ShmTotalBytes(1ull << 20));
+    ShmPosixClose(w1);
+
+    // zelfde maat: zelfde blok, framenummers lopen door
+    CHECK(ShmPosixOpenWriter(w1, name, 1ull << 20));
+    CHECK_EQ(PublishPattern(w1.base, 2, img), 2);
+    ShmPosixClose(w1);
+
+    CHECK(ShmPosixOpenWriter(w2, name, 2ull << 20));
+    CHECK_EQ(w2.bytes, ShmTotalBytes(2ull << 20));
+    CHECK_EQ(PublishPattern(w2.base, 1, img), 1);   // nieuw blok: begint opnieuw
+    ShmFrame f;
+    CHECK(ShmReadBegin(reader.base, reader.bytes, f) && f.frame == 2 && FrameMatches(f) && ShmReadValid(f));
+    ShmPosixMap fresh;
+    CHECK(ShmPosixOpenReader(fresh, name) && fresh.bytes == w2.bytes);
+    CHECK(ShmPosixWait(fresh, 0, 1000, f) && f.frame == 1 && FrameMatches(f) && ShmReadValid(f));
+    CHECK(!ShmPosixWait(fresh, 1, 20, f));   // niets nieuws: time-out
+
+    // afgekapt object (kleiner dan de header belooft): lezer weigert
+    CHECK_EQ(ftruncate(w2.fd, (off_t)ShmTotalBytes(1ull << 19)), 0);
+    ShmPosixMap small;
+    CHECK(!ShmPosixOpenReader(small, name));
+    ShmPosixClose(fresh);
+    ShmPosixClose(reader);
+    ShmPosixClose(w2);
+    shm_unlink(name.c_str());
+}
+
+// Eén schrijver, drie lezers in eigen processen die elk frame ter plekke controleren:
+// elk frame dat ShmReadValid goedkeurt moet heel zijn, en frames lopen nooit terug.
+static void TestPosixStress() {
+    const std::string name = TestShmName("stress");
+    shm_unlink(name.c_str());
+    ShmPosixMap w;
+    CHECK(ShmPosixOpenWriter(w, name, 8ull << 20));
+    auto* stop = (std::atomic<int>*)mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    CHECK(stop != MAP_FAILED);
+    if (stop == MAP_FAILED) return;
+    new (stop) std::atomic<int>(0);
+
+    std::vector<pid_t> readers;
+    for (int r = 0; r < 3; ++r) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            ShmPosixMap m;
+            if (!ShmPosixOpenReader(m, name)) _exit(2);
+            uint64_t ok = 0, bad = 0, last = 0, backwards = 0;
+            while (!stop->load()) {
+                ShmFrame f;
+                if (!ShmPosixWait(m, last, 50, f)) continue;
+                const bool match = FrameMatches(f);
+                if (!ShmReadValid(f)) continue;   // overschreven tijdens het lezen: weggooien
+                if (!match) ++bad;
+                else ++ok;
+                if (f.frame < last) ++backwards;
+                last = f.frame;
+            }
+            _exit(bad || backwards || ok == 0 ? 1 : 0);
+        }
+        CHECK(pid > 0);
+        if (pid > 0) readers.push_back(pid);
+    }
+
+    const uint64_t frames = 3000;
+    std::vector<uint32_t> img;
+    bool published = true;
+    for (uint64_t n = 1; n <= frames; ++n) {
+        published = published && PublishPattern(w.base, n, img) == n;
+        if (n % 500 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(5));   // lezers laten bijkomen
+    }
+    CHECK(published);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    stop->store(1);
+    for (pid_t pid : readers) {
+        int st = 0;
+        CHECK(waitpid(pid, &st, 0) == pid && WIFEXITED(st) && WEXITSTATUS(st) == 0);
+    }
+    ShmFrame f;
+    CHECK(ShmReadBegin(w.base, w.bytes, f) && f.frame == frames && FrameMatches(f) && ShmReadValid(f));
+    munmap(stop, 4096);
+    ShmPosixClose(w);
+    shm_unlink(name.c_str());
+}
+#endif
+
+int main() {
+#if !defined(_WIN32)
+    TestPosixStress();   // eerst: fork voordat er worker-threads zijn
+    TestPosixRecreate();
+#endif
+    TestLayout();
+    return TestExit("test_shm");
+}
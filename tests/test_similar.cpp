@@ -0,0 +1,194 @@
+// Gelijkende captures: pHash-afstanden (kleine wijziging, schaal, ruis, ander scherm),
+// de Hamming-index tegen lineair zoeken, similar.bin, de map-scan en het parallel
+// hashen met een decoder die faalt of gooit.
+#include "snip_test.h"
+
+// vensterachtig: vlakke panelen en tekstregels op wit
+static std::vector<uint8_t> Screen(int w, int h, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> img((size_t)w * h * 4, 255);
+    const int panels = 5 + (int)(rng() % 6);
+    for (int b = 0; b < panels; ++b) {
+        const int x0 = (int)(rng() % w), y0 = (int)(rng() % h);
+        const int x1 = std::min(w, x0 + 50 + (int)(rng() % (w / 2))), y1 = std::min(h, y0 + 30 + (int)(rng() % (h / 2)));
+        const uint8_t c0 = (uint8_t)rng(), c1 = (uint8_t)rng(), c2 = (uint8_t)rng();
+        for (int y = y0; y < y1; ++y)
+            for (int x = x0; x < x1; ++x) {
+                uint8_t* p = &img[((size_t)y * w + x) * 4];
+                p[0] = c0; p[1] = c1; p[2] = c2;
+            }
+    }
+    for (int l = 0; l < h / 20; ++l)
+        for (int x = 10; x < w - 10; ++x) {
+            if (!((x / 7 + l) % 3)) continue;
+            for (int y = l * 20 + 5; y < std::min(h, l * 20 + 13); ++y) {
+                uint8_t* p = &img[((size_t)y * w + x) * 4];
+                p[0] = p[1] = p[2] = (uint8_t)(p[0] / 3);
+            }
+        }
+    return img;
+}
+
+static void TestHashDistances() {
+    const int w = 1280, h = 800;
+    const auto a = Screen(w, h, 1);
+    const uint64_t ha = PerceptualHash(a.data(), w * 4, w, h);
+
+    auto cursor = a;   // muiscursor-grote wijziging
+    for (int y = 300; y < 320; ++y)
+        for (int x = 400; x < 412; ++x) cursor[((size_t)y * w + x) * 4] = 0;
+    CHECK(HammingDistance(ha, PerceptualHash(cursor.data(), w * 4, w, h)) <= kSimilarRadius);
+
+    std::vector<uint8_t> half((size_t)(w / 2) * (h / 2) * 4);
+    ResampleLanczos(a.data(), w * 4, w, h, half.data(), (w / 2) * 4, w / 2, h / 2, false);
+    CHECK(HammingDistance(ha, PerceptualHash(half.data(), (w / 2) * 4, w / 2, h / 2)) <= kSimilarRadius);
+
+    auto noisy = a;
+    std::mt19937 rng(9);
+    for (auto& v : noisy) v = (uint8_t)std::clamp((int)v + (int)(rng() % 13) - 6, 0, 255);
+    CHECK(HammingDistance(ha, PerceptualHash(noisy.data(), w * 4, w, h)) <= kSimilarRadius);
+
+    int nearest = 64;
+    for (uint32_t k = 2; k < 30; ++k) {
+        const auto other = Screen(w, h, k);
+        nearest = std::min(nearest, HammingDistance(ha, PerceptualHash(other.data(), w * 4, w, h)));
+    }
+    CHECK(nearest > kSimilarRadius);
+
+    // kleiner dan het DCT-raster, en bottom-up (negatieve stride): geen crash, zelfde hash
+    uint8_t tiny[3 * 2 * 4];
+    for (int i = 0; i < 24; ++i) tiny[i] = (uint8_t)(i * 10);
+    (void)PerceptualHash(tiny, 12, 3, 2);
+    std::vector<uint8_t> flipped(a.size());
+    for (int y = 0; y < h; ++y) std::memcpy(&flipped[(size_t)(h - 1 - y) * w * 4], &a[(size_t)y * w * 4], (size_t)w * 4);
+    CHECK_EQ(PerceptualHash(flipped.data() + (size_t)(h - 1) * w * 4, -(ptrdiff_t)w * 4, w, h), ha);
+}
+
+static void CheckQueryMatchesLinear(const HammingIndex& idx, const std::vector<uint64_t>& hashes, uint64_t q, int radius) {
+    std::vector<std::pair<int, uint32_t>> hits, linear;
+    HammingIndexQuery(idx, q, radius, hits);
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        const int d = HammingDistance(hashes[i], q);
+        if (d <= radius) linear.emplace_back(d, (uint32_t)i);
+    }
+    std::sort(linear.begin(), linear.end());
+    CHECK(hits == linear);
+}
+
+static void TestIndexMatchesLinear() {
+    // geclusterd, deels nog niet in de tabellen (pending na de laatste build)
+    std::mt19937_64 rng(5);
+    std::vector<uint64_t> hashes;
+    HammingIndex idx;
+    for (int c = 0; c < 2000; ++c) {
+        const uint64_t base = rng();
+        for (int v = 0; v < 5; ++v) {
+            uint64_t x = base;
+            for (int f = 0; f < (int)(rng() % 8); ++f) x ^= 1ull << (rng() % 64);
+            hashes.push_back(x);
+            HammingIndexAdd(idx, x);
+        }
+    }
+    CHECK(idx.built > 0 && idx.built < hashes.size());
+    for (int r : { 0, 3, 7, kSimilarRadius, 13, 22, 64 })
+        for (int q = 0; q < 20; ++q) {
+            uint64_t x = hashes[rng() % hashes.size()];
+            for (int f = 0; f < r / 2; ++f) x ^= 1ull << (rng() % 64);
+            CheckQueryMatchesLinear(idx, hashes, x, r);
+        }
+    CheckQueryMatchesLinear(HammingIndex{}, {}, 42, kSimilarRadius);
+}
+
+static void TestStore() {
+    std::vector<uint8_t> file;
+    SimilarPutHeader(file);
+    const SimilarEntry recs[] = {
+        { 1, 10, 0, L"C:\\a.png" }, { 2, 20, 0, L"C:\\b.png" }, { 3, 30, 0, L"C:\\a.png" },
+        { 0, 0, kSimilarRemoved, L"C:\\b.png" }, { 5, 50, 0, L"C:\\c.png" },
+    };
+    for (const SimilarEntry& e : recs) SimilarPutRecord(file, e);
+    std::vector<SimilarEntry> out;
+    size_t records = 0;
+    CHECK_EQ(SimilarParse(file.data(), file.size(), out, &records), file.size());
+    CHECK_EQ(records, 5);
+    CHECK(out.size() == 2 && out[0].path == L"C:\\a.png" && out[0].phash == 3 && out[1].phash == 5);
+
+    // afgebroken laatste record: alles ervoor blijft, validBytes wijst naar het afkappunt
+    file.resize(file.size() - 3);
+    const size_t valid = SimilarParse(file.data(), file.size(), out, &records);
+    CHECK_EQ(records, 4);
+    CHECK(out.size() == 1 && out[0].path == L"C:\\a.png" && out[0].stamp == 30);
+    CHECK(valid > 8 && valid < file.size());
+    // geen (of een vreemde) header: niets, 0
+    file[0] = 'X';
+    CHECK_EQ(SimilarParse(file.data(), file.size(), out, &records), 0);
+    CHECK(out.empty() && records == 0);
+}
+
+static void TestListFolder() {
+    namespace fs = std::filesystem;
+    const fs::path dir = TestTempPath("similar_dir");
+    fs::create_directories(dir / "sub");
+    for (const char* name : { "a.png", "B.PNG", "c.jpg", "d.txt", "sub/e.bmp", "sub/f.jpeg" })
+        CHECK(WriteFileBytes(dir / name, { 1, 2, 3 }));
+    std::vector<SimilarEntry> items;
+    SimilarListFolder(dir, [](const std::wstring&, uint64_t) { return false; }, items);
+    CHECK_EQ(items.size(), 5);
+    SimilarListFolder(dir, [](const std::wstring& p, uint64_t) { return p.find(L"a.png") != std::wstring::npos; }, items);
+    CHECK_EQ(items.size(), 4);
+    fs::remove_all(dir);
+    SimilarListFolder(dir, [](const std::wstring&, uint64_t) { return false; }, items);
+    CHECK(items.empty());
+}
+
+// Decoder die faalt of gooit (bad_alloc op een enorm bestand): alleen dat item valt af.
+static void TestHashFiles() {
+    std::vector<SimilarEntry> items(60);
+    for (size_t i = 0; i < items.size(); ++i) items[i].path = std::to_wstring(i);
+    SimilarHashFiles(items, 4, [](const std::wstring& path, std::vector<uint8_t>& px, int& w, int& h) {
+        const int i = std::stoi(path);
+        if (i % 7 == 0) return false;
+        if (i % 11 == 0) throw std::bad_alloc();
+        if (i % 13 == 0) { w = 64; h = 48; return true; }   // te weinig pixels
+        w = 64; h = 48;
+        px = Screen(64, 48, (uint32_t)i);
+        return true;
+        });
+    for (size_t i = 0; i < items.size(); ++i) {
+        const bool skip = i % 7 == 0 || i % 11 == 0 || i % 13 == 0;
+        CHECK(((items[i].flags & kSimilarRemoved) != 0) == skip);
+        if (skip) continue;
+        const auto px = Screen(64, 48, (uint32_t)i);
+        CHECK_EQ(items[i].phash, PerceptualHash(px.data(), 64 * 4, 64, 48));
+    }
+
+    // echte bestanden via DecodeImageFile: een kapotte PNG valt af, de rest niet
+    const auto img = TestImagePhoto(40, 30, 3);
+    std::vector<uint8_t> png;
+    const char* desc = "";
+    CHECK(PngEncodeLossless(img.data(), 40, 30, {}, png, desc));
+    const auto good = TestTempPath("similar_good.png"), bad = TestTempPath("similar_bad.png");
+    CHECK(WriteFileBytes(good, png));
+    png.resize(png.size() / 2);
+    CHECK(WriteFileBytes(bad, png));
+    std::vector<SimilarEntry> files(2);
+    files[0].path = good.wstring();
+    files[1].path = bad.wstring();
+    SimilarHashFiles(files, 2, [](const std::wstring& path, std::vector<uint8_t>& px, int& w, int& h) {
+        const char* why = "";
+        return DecodeImageFile(path, false, px, w, h, kDecodeMaxPixels, why);
+        });
+    CHECK(!(files[0].flags & kSimilarRemoved) && files[0].phash == PerceptualHash(img.data(), 40 * 4, 40, 30));
+    CHECK(files[1].flags & kSimilarRemoved);
+    std::filesystem::remove(good);
+    std::filesystem::remove(bad);
+}
+
+int main() {
+    TestHashDistances();
+    TestIndexMatchesLinear();
+    TestStore();
+    TestListFolder();
+    TestHashFiles();
+    return TestExit("test_similar");
+}
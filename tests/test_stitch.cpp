@@ -0,0 +1,168 @@
+// Scroll-stitching: synthetische pagina achter een viewport met sticky header/footer en
+// een scrollbar die elk frame verspringt. Gevonden offsets, de gestitchte uitvoer,
+// de minimale overlap, frames zonder beweging, frames zonder match en de hoogtegrens.
+#include "snip_test.h"
+
+static constexpr int kW = 300, kH = 200, kHeader = 20, kFooter = 12;
+static constexpr int kBand = kH - kHeader - kFooter;
+static constexpr int kScrollbar = 32;   // StitchInit: rechter strook telt niet mee
+
+// pagina-rij r: tekstachtig, af en toe een paar lege rijen (zelfde hash)
+static void PageRow(int r, uint8_t* row) {
+    const bool blank = r % 97 >= 40 && r % 97 < 44;
+    for (int x = 0; x < kW; ++x) {
+        uint32_t v = 0xFFFFFFFFu;
+        if (!blank && ((x / 6 + r / 3) % 5 != 0)) v = ((uint32_t)r * 2654435761u) ^ ((uint32_t)x * 40503u);
+        std::memcpy(row + (size_t)x * 4, &v, 4);
+    }
+}
+
+// Viewport met de pagina vanaf rij 'off' tussen header en footer; de scrollbar-thumb
+// staat op rij 'thumb' (en verandert dus ook bij frames die verder gelijk zijn).
+static std::vector<uint8_t> Viewport(int off, size_t stride, int thumb) {
+    std::vector<uint8_t> img(stride * kH, 0);
+    for (int y = 0; y < kH; ++y) {
+        uint8_t* row = &img[(size_t)y * stride];
+        if (y < kHeader || y >= kH - kFooter) {
+            for (int x = 0; x < kW; ++x) { row[x * 4] = (uint8_t)(y * 9); row[x * 4 + 1] = (uint8_t)x; row[x * 4 + 3] = 255; }
+        } else {
+            PageRow(off + y - kHeader, row);
+        }
+        for (int x = kW - kScrollbar; x < kW; ++x) row[x * 4 + 2] = (y >= thumb && y < thumb + 30) ? 200 : 40;
+    }
+    return img;
+}
+
+// Verwachte uitvoer: header, pagina-rijen [from, to), footer (scrollbar zoals het laatste
+// frame; die kolommen vergelijken we niet).
+static bool OutputMatches(ScrollStitcher& st, int from, int to, size_t stride, int lastOff) {
+    std::vector<uint8_t> out;
+    RowBufFlatten(st.out, out);
+    if (st.out.rows != kHeader + (to - from) + kFooter) return false;
+    const auto last = Viewport(lastOff, stride, 0);
+    std::vector<uint8_t> expect((size_t)kW * 4);
+    const size_t cmp = (size_t)(kW - kScrollbar) * 4;
+    for (int y = 0; y < st.out.rows; ++y) {
+        const uint8_t* got = &out[(size_t)y * kW * 4];
+        if (y < kHeader) std::memcpy(expect.data(), &last[(size_t)y * stride], expect.size());
+        else if (y < st.out.rows - kFooter) PageRow(from + y - kHeader, expect.data());
+        else std::memcpy(expect.data(), &last[(size_t)(kH - (st.out.rows - y)) * stride], expect.size());
+        if (std::memcmp(got, expect.data(), cmp) != 0) return false;
+    }
+    return true;
+}
+
+static void TestScrollSequence() {
+    // stride met padding, zoals een DIB-sectie met uitgelijnde rijen
+    const size_t stride = (size_t)kW * 4 + 16;
+    ScrollStitcher st;
+    StitchInit(st, kW, kH, 30000);
+    int off = 0, thumb = 0;
+    auto frame = Viewport(off, stride, thumb);
+    CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::Appended);
+    CHECK_EQ(st.out.rows, kH);
+
+    for (int step : { 23, 1, 60, 7, 150, 33, 90, 5 }) {
+        off += step;
+        thumb = (thumb + 9) % (kH - 30);
+        frame = Viewport(off, stride, thumb);
+        CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::Appended);
+        CHECK_EQ(st.lastDy, step);
+        CHECK_EQ(st.lastHeader, kHeader);
+        CHECK_EQ(st.lastFooter, kFooter);
+    }
+    CHECK(OutputMatches(st, 0, off + kBand, stride, off));
+
+    // zelfde frame, en alleen de scrollbar bewogen: geen beweging, uitvoer blijft
+    const int rows = st.out.rows;
+    CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::NoMovement);
+    frame = Viewport(off, stride, (thumb + 50) % (kH - 30));
+    CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::NoMovement);
+    CHECK_EQ(st.out.rows, rows);
+
+    // terug omhoog gescrold: geen positieve offset, geen match
+    frame = Viewport(off - 40, stride, thumb);
+    CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::NoMatch);
+    // ander venster (header en footer blijven, inhoud heel anders): geen match
+    frame = Viewport(off + 5000, stride, thumb);
+    CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::NoMatch);
+    CHECK_EQ(st.out.rows, rows);
+    CHECK(OutputMatches(st, 0, off + kBand, stride, off));
+
+    // na mislukte frames gaat het verder vanaf het laatst geaccepteerde frame
+    frame = Viewport(off + 12, stride, thumb);
+    CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::Appended);
+    CHECK_EQ(st.lastDy, 12);
+    CHECK(OutputMatches(st, 0, off + 12 + kBand, stride, off + 12));
+}
+
+// Overlap van minOverlap rijen wordt nog herkend, één rij minder niet.
+static void TestMinimalOverlap() {
+    const size_t stride = (size_t)kW * 4;
+    const int minOverlap = std::max(kStitchWindowRows, kBand / 16);
+    const int start = 200;   // weg van de lege rijen rond de grens
+    for (int extra : { 0, 1 }) {
+        ScrollStitcher st;
+        StitchInit(st, kW, kH, 30000);
+        auto frame = Viewport(start, stride, 0);
+        CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::Appended);
+        const int dy = kBand - minOverlap + extra;
+        frame = Viewport(start + dy, stride, 0);
+        const StitchResult r = StitchAddFrame(st, frame.data(), stride);
+        if (extra == 0) {
+            CHECK(r == StitchResult::Appended);
+            CHECK_EQ(st.lastDy, dy);
+            CHECK(OutputMatches(st, start, start + dy + kBand, stride, start + dy));
+        } else {
+            CHECK(r == StitchResult::NoMatch);
+            CHECK_EQ(st.out.rows, kH);
+        }
+    }
+}
+
+// maxRows: de uitvoer groeit nooit voorbij de grens; daarna alleen nog NoMovement.
+static void TestHeightCap() {
+    const size_t stride = (size_t)kW * 4;
+    const int maxRows = 700;
+    ScrollStitcher st;
+    StitchInit(st, kW, kH, maxRows);
+    int off = 0;
+    auto frame = Viewport(off, stride, 0);
+    CHECK(StitchAddFrame(st, frame.data(), stride) == StitchResult::Appended);
+    StitchResult r = StitchResult::Appended;
+    for (int i = 0; i < 20; ++i) {
+        off += 70;
+        frame = Viewport(off, stride, 0);
+        r = StitchAddFrame(st, frame.data(), stride);
+        CHECK(r != StitchResult::NoMatch);
+        CHECK(st.out.rows <= maxRows);
+    }
+    CHECK(r == StitchResult::NoMovement);
+    CHECK_EQ(st.out.rows, maxRows);
+    // de laatste rijen zijn de footer, daarboven een doorlopend stuk pagina vanaf 0
+    CHECK(OutputMatches(st, 0, maxRows - kHeader - kFooter, stride, off));
+}
+
+// Smal venster (geen scrollbar-strook) en een viewport die te klein is voor de overlap.
+static void TestSmallFrames() {
+    ScrollStitcher st;
+    StitchInit(st, 100, 50, 30000);
+    CHECK_EQ(st.hashX1, 100);
+    std::vector<uint8_t> a((size_t)100 * 50 * 4, 7);
+    CHECK(StitchAddFrame(st, a.data(), 400) == StitchResult::Appended);
+    CHECK(StitchAddFrame(st, a.data(), 400) == StitchResult::NoMovement);
+
+    StitchInit(st, kW, 12, 30000);
+    std::vector<uint8_t> b((size_t)kW * 12 * 4), c(b.size());
+    for (int y = 0; y < 12; ++y) { PageRow(y, &b[(size_t)y * kW * 4]); PageRow(y + 5, &c[(size_t)y * kW * 4]); }
+    CHECK(StitchAddFrame(st, b.data(), (size_t)kW * 4) == StitchResult::Appended);
+    CHECK(StitchAddFrame(st, c.data(), (size_t)kW * 4) == StitchResult::NoMatch);
+}
+
+int main() {
+    TestScrollSequence();
+    TestMinimalOverlap();
+    TestHeightCap();
+    TestSmallFrames();
+    return TestExit("test_stitch");
+}
@@ -0,0 +1,150 @@
+// Temp-edit cache: index-regels (formatteren, teruglezen, kapotte en afgebroken regels,
+// latere regel wint) en het sweep-plan (leeftijdsgrens, oudste eerst onder maxBytes,
+// vastgepinde bestanden, lege invoer).
+#include "snip_test.h"
+
+static std::vector<TempCacheEntry> ParseIndex(const std::wstring& s) {
+    return ParseTempCacheIndex(s.data(), s.size());
+}
+
+static void TestRoundTrip() {
+    const TempCacheEntry entries[] = {
+        { 0x0123456789abcdefull, 1, 4096, 133500000000000000ull, 133500000012345678ull, L"edit_0123456789abcdef.png" },
+        { 0, 0, 0, 0, 0, L"a" },
+        { ~0ull, 2, ~0ull, ~0ull, ~0ull, L"edit met spaties é中.bmp" },
+    };
+    std::wstring file;
+    for (const TempCacheEntry& e : entries) {
+        const std::wstring line = FormatTempCacheLine(e);
+        CHECK(line.size() > 2 && line.substr(line.size() - 2) == L"\r\n");
+        TempCacheEntry back{};
+        CHECK(ParseTempCacheLine(line.substr(0, line.size() - 2), back));
+        CHECK(back.hash == e.hash && back.fmt == e.fmt && back.bytes == e.bytes && back.writeTime == e.writeTime &&
+            back.lastUse == e.lastUse && back.name == e.name);
+        file += line;
+    }
+    const auto parsed = ParseIndex(file);
+    CHECK_EQ(parsed.size(), 3);
+    for (size_t i = 0; i < parsed.size() && i < 3; ++i) CHECK(parsed[i].name == entries[i].name && parsed[i].hash == entries[i].hash);
+}
+
+static void TestMalformed() {
+    TempCacheEntry e{};
+    for (const wchar_t* bad : {
+             L"", L" ", L"zz 1 2 3 4 name", L"0123 1 2 3 4", L"0123 1 2 3 4 ", L"0123,1 2 3 4 name",
+             L"0123 1 2 3 name", L"0123 x 2 3 4 name", L"0123 1 2 3 4 ..\\escape.png", L"0123 1 2 3 4 sub/f.png",
+             L"0123 1 2 3 4 C:evil.png", L"0123 1 2 3 4 ..", L"0123 1 2 3 4 ." })
+        CHECK(!ParseTempCacheLine(bad, e));
+
+    // elke afgebroken versie van een regel: weigeren zolang de naam nog niet begonnen is,
+    // daarna (niet te zien) een kortere naam met dezelfde velden
+    const TempCacheEntry full{ 0xfeedull, 1, 1234567, 133400000000000000ull, 133400000100000000ull, L"edit_000000000000feed.png" };
+    std::wstring line = FormatTempCacheLine(full);
+    line.resize(line.size() - 2);
+    const size_t nameStart = line.size() - full.name.size();
+    for (size_t cut = 0; cut < line.size(); ++cut) {
+        TempCacheEntry t{};
+        const bool ok = ParseTempCacheLine(line.substr(0, cut), t);
+        if (cut <= nameStart) CHECK(!ok);
+        else CHECK(ok && t.bytes == full.bytes && t.lastUse == full.lastUse && t.name == full.name.substr(0, cut - nameStart));
+    }
+
+    // kapotte regels tussen goede: alleen die vallen weg; laatste regel zonder \r\n en
+    // een afgebroken laatste regel (schrijven onderbroken)
+    std::wstring file = FormatTempCacheLine({ 1, 0, 10, 20, 30, L"one.png" });
+    file += L"garbage\r\n\r\n\n";
+    file += FormatTempCacheLine({ 2, 0, 10, 20, 30, L"two.png" });
+    file += L"0003 0 10 20 30 three.png";
+    auto parsed = ParseIndex(file);
+    CHECK(parsed.size() == 3 && parsed[0].name == L"one.png" && parsed[1].name == L"two.png" && parsed[2].name == L"three.png");
+    file += L"\r\n0004 0 1";
+    parsed = ParseIndex(file);
+    CHECK_EQ(parsed.size(), 3);
+}
+
+static void TestLaterLineWins() {
+    std::wstring file;
+    file += FormatTempCacheLine({ 1, 0, 100, 5, 5, L"a.png" });
+    file += FormatTempCacheLine({ 2, 0, 200, 6, 6, L"b.png" });
+    file += FormatTempCacheLine({ 1, 0, 150, 7, 9, L"a.png" });   // opnieuw geschreven + gebruikt
+    const auto parsed = ParseIndex(file);
+    CHECK_EQ(parsed.size(), 2);
+    if (parsed.size() == 2) {
+        CHECK(parsed[0].name == L"a.png" && parsed[0].bytes == 150 && parsed[0].lastUse == 9);
+        CHECK(parsed[1].name == L"b.png" && parsed[1].bytes == 200);
+    }
+}
+
+static void TestEmpty() {
+    CHECK(ParseTempCacheIndex(nullptr, 0).empty());
+    CHECK(ParseIndex(L"\r\n\n\r\n").empty());
+    CHECK(PlanTempSweep({}, 1000, 10, 0).empty());
+}
+
+static void TestFileName() {
+    CHECK(TempCacheFileName(0xabcull, L".png", 1) == L"edit_0000000000000abc.png");
+    CHECK(TempCacheFileName(0xabcull, L".png", 0) == TempCacheFileName(0xabcull, L".png", 1));
+    CHECK(TempCacheFileName(0xabcull, L".bmp", 3) == L"edit_0000000000000abc-3.bmp");
+    // eigen namen komen ongeschonden door het index
+    TempCacheEntry e{};
+    const std::wstring name = TempCacheFileName(~0ull, L".png", 99);
+    const std::wstring line = FormatTempCacheLine({ ~0ull, 1, 1, 1, 1, name });
+    CHECK(ParseTempCacheLine(line.substr(0, line.size() - 2), e) && e.name == name);
+}
+
+static std::vector<std::wstring> Names(const std::vector<TempFileInfo>& files, const std::vector<size_t>& idx) {
+    std::vector<std::wstring> out;
+    for (size_t i : idx) out.push_back(files[i].name);
+    return out;
+}
+
+static void TestSweepAge() {
+    const uint64_t now = 1000 * kTicksPerSecond, maxAge = 100 * kTicksPerSecond;
+    const std::vector<TempFileInfo> files = {
+        { L"fresh", 10, now - 5 * kTicksPerSecond, false },
+        { L"edge", 10, now - maxAge, false },                 // precies maxAge: blijft
+        { L"old", 10, now - maxAge - 1, false },
+        { L"ancient", 10, 0, false },
+        { L"future", 10, now + 50 * kTicksPerSecond, false }, // klok teruggezet: niet oud
+        { L"pinned-old", 10, 1, true },
+    };
+    const auto del = PlanTempSweep(files, now, maxAge, ~0ull);
+    CHECK(Names(files, del) == (std::vector<std::wstring>{ L"ancient", L"old" }));
+}
+
+static void TestSweepBytes() {
+    const uint64_t now = 1000, maxAge = ~0ull;
+    const std::vector<TempFileInfo> files = {
+        { L"c", 300, 30, false },
+        { L"a", 100, 10, false },
+        { L"pin", 500, 5, true },   // oudste, maar in gebruik: telt mee, gaat nooit weg
+        { L"d", 400, 40, false },
+        { L"b2", 200, 20, false },
+        { L"b1", 200, 20, false },  // zelfde lastUse: op naam
+    };
+    // totaal 1700 (pin telt mee); oudste eerst tot het onder 1000 zit: 1600, 1400, 1200, 900
+    auto del = PlanTempSweep(files, now, maxAge, 1000);
+    CHECK(Names(files, del) == (std::vector<std::wstring>{ L"a", L"b1", L"b2", L"c" }));
+    del = PlanTempSweep(files, now, maxAge, 1700);
+    CHECK(del.empty());
+    del = PlanTempSweep(files, now, maxAge, 1699);
+    CHECK(Names(files, del) == (std::vector<std::wstring>{ L"a" }));
+    // 0 bytes toegestaan: alles behalve het vastgepinde bestand, oudste eerst
+    del = PlanTempSweep(files, now, maxAge, 0);
+    CHECK(Names(files, del) == (std::vector<std::wstring>{ L"a", L"b1", L"b2", L"c", L"d" }));
+
+    // leeftijd en bytes samen: a is te oud, daarna b1 en b2 voor de bytes (1600 -> 1200)
+    del = PlanTempSweep(files, now, now - 15, 1300);
+    CHECK(Names(files, del) == (std::vector<std::wstring>{ L"a", L"b1", L"b2" }));
+}
+
+int main() {
+    TestRoundTrip();
+    TestMalformed();
+    TestLaterLineWins();
+    TestEmpty();
+    TestFileName();
+    TestSweepAge();
+    TestSweepBytes();
+    return TestExit("test_temp_cache");
+}
@@ -0,0 +1,79 @@
+// Window-capture: WindowCaptureSelect met SyntheticWindowSource (render, zwarte render,
+// geminimaliseerd, mislukt, frame buiten de render) en WindowPixelsBlank.
+#include "snip_test.h"
+
+static void TestRenderCropsShadow() {
+    // venster met schaduw rondom: het frame valt er 7 px links/rechts en 7 px onder binnen
+    SyntheticWindowSource s;
+    s.window = PixRect{ 100, 100, 420, 340 };
+    s.frame = PixRect{ 107, 100, 413, 333 };
+    const WindowCaptureResult r = WindowCaptureSelect(s);
+    CHECK(r.via == WindowCaptureVia::Render);
+    CHECK(r.crop.x0 == 7 && r.crop.y0 == 0 && r.crop.Width() == 306 && r.crop.Height() == 233);
+    CHECK(r.px.top == s.pixels.data() && r.px.w == 320 && r.px.h == 240);
+    CHECK_EQ(s.renders, 1);
+    CHECK_EQ(s.screens, 0);
+}
+
+static void TestFallbacks() {
+    {   // gelukt maar zwart (beschermde content): schermkopie
+        SyntheticWindowSource s;
+        s.window = s.frame = PixRect{ 0, 0, 50, 50 };
+        s.renderBlack = true;
+        const WindowCaptureResult r = WindowCaptureSelect(s);
+        CHECK(r.via == WindowCaptureVia::Screen);
+        CHECK(r.px.top == nullptr && r.crop.Empty());
+        CHECK(s.renders == 1 && s.screens == 1);
+    }
+    {   // geminimaliseerd: niet eens proberen te renderen
+        SyntheticWindowSource s;
+        s.window = s.frame = PixRect{ 0, 0, 50, 50 };
+        s.renderable = false;
+        CHECK(WindowCaptureSelect(s).via == WindowCaptureVia::Screen);
+        CHECK(s.renders == 0 && s.screens == 1);
+    }
+    {   // renderen en schermkopie mislukken allebei
+        SyntheticWindowSource s;
+        s.window = s.frame = PixRect{ 0, 0, 50, 50 };
+        s.renderOk = false;
+        s.screenOk = false;
+        CHECK(WindowCaptureSelect(s).via == WindowCaptureVia::Failed);
+    }
+    {   // frame steekt buiten de render uit (venster intussen verschoven)
+        SyntheticWindowSource s;
+        s.window = PixRect{ 0, 0, 50, 50 };
+        s.frame = PixRect{ 40, 0, 60, 50 };
+        CHECK(WindowCaptureSelect(s).via == WindowCaptureVia::Screen);
+    }
+    {   // leeg venster
+        SyntheticWindowSource s;
+        CHECK(WindowCaptureSelect(s).via == WindowCaptureVia::Screen);
+    }
+}
+
+static void TestBlank() {
+    // 37 breed: SSE2-blokken van 4 plus een staart van 1
+    SyntheticWindowSource s;
+    s.window = s.frame = PixRect{ 0, 0, 37, 5 };
+    s.renderBlack = true;
+    WindowPixels px;
+    CHECK(s.Render(px));
+    const PixRect all{ 0, 0, 37, 5 };
+    CHECK(WindowPixelsBlank(px, all));
+    s.pixels[((size_t)4 * 37 + 36) * 4 + 1] = 1;      // laatste pixel, in de staart
+    CHECK(!WindowPixelsBlank(px, all));
+    CHECK(WindowPixelsBlank(px, PixRect{ 0, 0, 36, 5 }));
+    s.pixels[((size_t)4 * 37 + 36) * 4 + 1] = 0;
+    s.pixels[((size_t)2 * 37 + 3) * 4 + 3] = 255;     // alpha telt niet mee
+    CHECK(WindowPixelsBlank(px, all));
+    s.pixels[((size_t)2 * 37 + 3) * 4 + 2] = 9;       // in een SSE2-blok
+    CHECK(!WindowPixelsBlank(px, all));
+    CHECK(WindowPixelsBlank(px, PixRect{ 4, 0, 37, 5 }));
+}
+
+int main() {
+    TestRenderCropsShadow();
+    TestFallbacks();
+    TestBlank();
+    return TestExit("test_window_capture");
+}